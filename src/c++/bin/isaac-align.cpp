@@ -45,6 +45,12 @@ void align(const isaac::options::AlignOptions &options)
     {
         ISAAC_THREAD_CERR << "align: NUMA-aware memory management disabled." << std::endl;
     }
+    isaac::common::hugePagesInitialize(options.hugePages);
+    isaac::io::asyncFileIoInitialize(options.asyncIo, options.asyncIoQueueDepth);
+    isaac::common::cpuIsaInitialize(options.cpuIsa);
+    ISAAC_THREAD_CERR << "align: Using " << isaac::common::getCpuIsaName(options.cpuIsa) <<
+        " vectorized kernels. Best supported by the cpu: " <<
+        isaac::common::getCpuIsaName(isaac::common::getBestCpuIsa()) << std::endl;
 
     const uint64_t availableMemory = options.memoryLimit * 1024 * 1024 * 1024;
     if (isaac::options::AlignOptions::memoryLimitUnlimited !=  options.memoryLimit)
@@ -108,14 +114,17 @@ void align(const isaac::options::AlignOptions &options)
         options.gapExtendScore,
         options.minGapExtendScore,
         options.splitGapLength,
+        options.smithWatermanBandWidth,
         options.dodgyAlignmentScore,
         options.inputLoadersMax,
+        options.parallelGzip,
         options.tempSaversMax,
         options.tempLoadersMax,
         options.outputSaversMax,
         options.realignGaps,
         options.knownIndelsPath,
         options.bamGzipLevel,
+        options.bamDeflateBackend,
         options.bamPuFormat,
         options.bamProduceMd5,
         options.bamHeaderTags,
@@ -124,16 +133,22 @@ void align(const isaac::options::AlignOptions &options)
         options.keepDuplicates,
         options.markDuplicates,
         options.anchorMate,
+        options.duplicateGrouping,
         options.binRegexString,
         options.memoryControl,
         options.clusterIdList,
         options.userTemplateLengthStatistics,
         options.statsImageFormat,
         options.bufferBins,
+        options.referenceHashCache,
+        options.referenceHashNumaReplicas,
+        options.annotationCache,
+        options.annotationNumaReplicas,
         options.qScoreBin,
         options.fullBclQScoreTable,
         options.optionalFeatures,
-        options.pessimisticMapQ);
+        options.pessimisticMapQ,
+        options.pipelineBuild);
 
     const boost::filesystem::path stateFilePath = options.tempDirectory / "AlignerState.txt";
 
@@ -0,0 +1,66 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file isaac-bench.cpp
+ **
+ ** \brief User-facing executable for benchmarking the alignment engines on synthetic data
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstring>
+
+#include "common/Debug.hh"
+#include "options/BenchOptions.hh"
+#include "workflow/BenchWorkflow.hh"
+#include "workflow/benchWorkflow/BclPackingBenchmark.hh"
+#include "workflow/benchWorkflow/RadixSortBenchmark.hh"
+#include "workflow/benchWorkflow/SeedLookupBenchmark.hh"
+
+void bench(const isaac::options::BenchOptions &options)
+{
+    isaac::workflow::BenchWorkflow workflow(
+        options.tempDirectory_,
+        options.outputFile_,
+        options.threads_,
+        options.seed_,
+        options.repeats_,
+        options.referenceLength_,
+        options.contigs_,
+        options.clusters_,
+        options.readLength_,
+        options.bamGzipLevel_
+        );
+
+    workflow.run();
+}
+
+int main(int argc, char *argv[])
+{
+    // the first argument selects a single engine benchmark. The subcommand takes the place of the program name.
+    if (1 < argc && !strcmp("seed-lookup", argv[1]))
+    {
+        isaac::common::run(isaac::workflow::benchWorkflow::benchmarkSeedLookup, argc - 1, argv + 1);
+    }
+    else if (1 < argc && !strcmp("bcl-packing", argv[1]))
+    {
+        isaac::common::run(isaac::workflow::benchWorkflow::benchmarkBclPacking, argc - 1, argv + 1);
+    }
+    else if (1 < argc && !strcmp("radix-sort", argv[1]))
+    {
+        isaac::common::run(isaac::workflow::benchWorkflow::benchmarkRadixSort, argc - 1, argv + 1);
+    }
+    else
+    {
+        isaac::common::run(bench, argc, argv);
+    }
+}
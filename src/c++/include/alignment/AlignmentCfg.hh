@@ -33,7 +33,8 @@ struct AlignmentCfg
         const int gapOpenScore,
         const int gapExtendScore,
         const int minGapExtendScore,
-        const unsigned splitGapLength)
+        const unsigned splitGapLength,
+        const unsigned smithWatermanBandWidth)
     : gapMatchScore_(gapMatchScore)
     , gapMismatchScore_(gapMismatchScore)
     , gapOpenScore_(gapOpenScore)
@@ -44,6 +45,7 @@ struct AlignmentCfg
     , normalizedGapExtendScore_(gapMatchScore - gapExtendScore)
     , normalizedMaxGapExtendScore_(-minGapExtendScore)
     , splitGapLength_(splitGapLength)
+    , smithWatermanBandWidth_(smithWatermanBandWidth)
     {
     }
 
@@ -58,6 +60,8 @@ struct AlignmentCfg
     const unsigned normalizedGapExtendScore_;
     const unsigned normalizedMaxGapExtendScore_;
     const unsigned splitGapLength_;
+    // width of the band for the BandedSmithWaterman
+    const unsigned smithWatermanBandWidth_;
 };
 
 } // namespace alignment
@@ -20,7 +20,9 @@
 #ifndef iSAAC_ALIGNMENT_BANDED_SMITH_WATERMAN_HH
 #define iSAAC_ALIGNMENT_BANDED_SMITH_WATERMAN_HH
 
+#include <stdint.h>
 #include <string>
+#include <vector>
 #include <boost/noncopyable.hpp>
 
 #include "alignment/Cigar.hh"
@@ -35,14 +37,20 @@ namespace alignment
  ** \brief global optimization for alignments with a maximum gap size
  ** 
  ** Assumes that the scores fit into a short integer (2 bytes).
- ** Requires SSE4 for "v8hi __builtin_ia32_pmaxsw128 (v8hi, v8hi)".
- ** _mm_max_pi16 is probably an mmx instruction
+ **
+ ** The matrix fill is compiled for each of the common::CpuIsa levels. The
+ ** one matching common::getCpuIsa() is picked at construction.
  ** 
- ** This implementation is limited to a maximum gap width of 15 bases
- ** (+/-7 bands) so that all operations can be done over two registers.
+ ** The band is WIDEST_GAP_SIZE wide by default, which for a single
+ ** alignment fits into two SSE registers. Bands of 32 and 64 allow longer
+ ** gaps and take advantage of AVX2 and AVX-512 registers.
  **
  ** The registers are aligned to the database.
  **
+ ** alignBatch fills the matrices of up to BATCH_SIZE alignments at once.
+ ** Each register holds the same band position of all alignments in the
+ ** batch, so even the serial part of the fill is vectorized.
+ **
  ** Note: this is non-copyable because of the dynamically-allocated internal
  ** buffer.
  ** 
@@ -57,12 +65,12 @@ public:
      * \param mismatchScore - Expected to be negative. The lower the value, the less likely the mismatches are chosen
      * \param gapOpenScore - Expected to be positive. The higher the value, the less likely the gaps are opened
      * \param gapOpenScore - Expected to be positive. The higher the value, the less likely the gaps are extended
+     * \param widestGapSize - Width of the band. One of 16, 32 or 64
+     * \param batch - Reserve the traceback for alignBatch. Otherwise only align can be used
      */
     BandedSmithWaterman(
         int matchScore, int mismatchScore, int gapOpenScore,
-        int gapExtendScore, int maxReadLength);
-    /// \brief delete the pre-allocated re-usable buffer
-    ~BandedSmithWaterman();
+        int gapExtendScore, int maxReadLength, unsigned widestGapSize = WIDEST_GAP_SIZE, bool batch = false);
     /**
      ** \brief align the query to the database and store the descriptor of the best match.
      **
@@ -73,7 +81,16 @@ public:
      ** Note: this operation is not 'const' because it uses a pre-allocated internal buffer.
      **/
     static const unsigned WIDEST_GAP_SIZE = 16;
+    /// widest band supported
+    static const unsigned WIDEST_GAP_SIZE_MAX = 64;
+    /// number of alignments alignBatch can do at once
+    static const unsigned BATCH_SIZE = 16;
+    /// smaller batches are faster aligned one by one than with most of the lanes idle
+    static const unsigned BATCH_SIZE_MIN = 6;
 
+    unsigned getWidestGapSize() const {return widestGapSize_;}
+    /// \return bytes of the traceback and database buffers
+    uint64_t getReservedMemory() const {return T_.capacity() * sizeof(int16_t) + database_.capacity();}
 
     unsigned align(
         const std::vector<char> &query,
@@ -89,6 +106,24 @@ public:
         const reference::Contig::const_iterator databaseEnd,
         Cigar &cigar) const;
 
+    /// query and the database it has to be aligned against. Database must be getWidestGapSize() - 1 longer than query
+    struct BatchItem
+    {
+        std::vector<char>::const_iterator queryBegin;
+        std::vector<char>::const_iterator queryEnd;
+        reference::Contig::const_iterator databaseBegin;
+        reference::Contig::const_iterator databaseEnd;
+    };
+
+    /**
+     ** \brief aligns up to BATCH_SIZE queries at once. The results are the same as if align was called for
+     **        each of them.
+     **
+     ** \param cigars cigar of items[i] is appended to cigars[i]
+     ** \param offsets offsets[i] receives the value align would return for items[i]
+     **/
+    void alignBatch(const BatchItem *items, const unsigned count, Cigar *cigars, unsigned *offsets) const;
+
 // the widest gap-size handled by this implementation
     // if we know there are no reference matching kmers within cutoffDistance,
     // there is no point to do the gapped alignment.
@@ -101,14 +136,36 @@ private:
     const int gapOpenScore_;
     const int gapExtendScore_;
     const int maxReadLength_;
+    const unsigned widestGapSize_;
+    const bool batch_;
     const short initialValue_; // minimal usable value to initialize the matrices
-    typedef unsigned short ScoreType;
-    static const unsigned int registerLength_ = 16 / sizeof(ScoreType);
-    char *T_;
+    // traceback of all alignments in the batch. [query offset][G, E or F][band position][batch lane]
+    // Single lane unless batch_ is set
+    mutable std::vector<int16_t> T_;
+    // unpacked database of each batch lane. [batch lane][database offset]. Single lane unless batch_ is set
+    mutable std::vector<char> database_;
+
+    struct Kernels;
+    /**
+     * \brief fills the traceback and stores the scores for the last base of each query in G, E and F.
+     *        The layout of G, E and F is [band position][lane]
+     */
+    typedef void (*FillMatrices)(
+        const BandedSmithWaterman &sw,
+        const BatchItem *items, const unsigned count,
+        int16_t *G, int16_t *E, int16_t *F);
+    const FillMatrices fillMatrices_;
+    const FillMatrices fillMatricesBatch_;
+
+    unsigned getDatabaseSizeMax() const {return maxReadLength_ + widestGapSize_ - 1;}
+    /// decodes the item database into the lane slot of database_ so that the fill does not go through the packed contig
+    const char *unpackDatabase(const BatchItem &item, const unsigned lane) const;
 
+    unsigned traceback(
+        const unsigned querySize, const unsigned lanes, const unsigned lane,
+        const int16_t *G, const int16_t *E, const int16_t *F, Cigar &cigar) const;
     unsigned trimTailIndels(Cigar& cigar, const size_t beginOffset) const;
     void removeAdjacentIndels(Cigar& cigar, const size_t beginOffset) const;
-    void cp(int16_t source[WIDEST_GAP_SIZE], int16_t destination[WIDEST_GAP_SIZE]) const;
 };  
 
 } // namespace alignment
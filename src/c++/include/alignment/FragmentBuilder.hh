@@ -30,6 +30,7 @@
 #include "alignment/Match.hh"
 #include "alignment/SeedMetadata.hh"
 #include "alignment/matchSelector/FragmentSequencingAdapterClipper.hh"
+#include "common/StageCounters.hh"
 #include "reference/Contig.hh"
 #include "flowcell/ReadMetadata.hh"
 
@@ -98,6 +99,12 @@ public:
         FragmentMetadataList &fragments);
 
     const Cigar &getCigarBuffer() const {return cigarBuffer_;}
+    /// \return bytes the builder keeps allocated outside of its own footprint. Does not include the cigar buffer
+    uint64_t getReservedMemory() const
+    {
+        return gappedAligner_.getReservedMemory() +
+            matches_.capacity() * sizeof(Match) + offsetMismatches_.capacity() * sizeof(OffsetMismatchFlags::value_type);
+    }
 
     struct SequencingAdapterRange
     {
@@ -217,8 +224,12 @@ FragmentBuilder::AlignmentType FragmentBuilder::build(
             ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(cluster.getId(), "    trying " << seedMetadata);
 
             matches_.clear();
-            matchFinder.findSeedMatches(cluster, seedMetadata, readMetadata, matches_, repeatSeeds);
+            {
+                common::StageTimer timer(common::STAGE_SEED_LOOKUP);
+                matchFinder.findSeedMatches(cluster, seedMetadata, readMetadata, matches_, repeatSeeds);
+            }
 
+            common::StageTimer timer(common::STAGE_UNGAPPED_ALIGNMENT);
             BOOST_FOREACH(const Match &match, matches_)
             {
                 if (!match.isTooManyMatch())
@@ -291,6 +302,7 @@ FragmentBuilder::AlignmentType FragmentBuilder::build(
     // having perfect alignments means no need to spend time on trying to improve the imperfect ones.
     if (withGaps && !perfectFound)
     {
+        common::StageTimer timer(common::STAGE_GAPPED_ALIGNMENT);
         if (splitAlignments_)
         {
             splitReadAligner_.alignSimpleSv(cigarBuffer_, contigList, kUniqenessAnnotation, readMetadata, templateLengthStatistics, fragments);
@@ -20,6 +20,7 @@
 #ifndef iSAAC_ALIGNMENT_HASH_MATCH_FINDER_HH
 #define iSAAC_ALIGNMENT_HASH_MATCH_FINDER_HH
 
+#include "alignment/BclClusters.hh"
 #include "alignment/Cluster.hh"
 #include "alignment/Seed.hh"
 #include "alignment/SeedMetadata.hh"
@@ -66,12 +67,29 @@ public:
         Matches& matches,
         std::size_t& repeatSeeds) const;
 
+    /**
+     * \brief Prefetches the hash data findSeedMatches will need for all seeds of the cluster. Intended to be called
+     *        for clusters a few iterations ahead of the one being aligned: first with positions == false to bring in
+     *        the offsets and then, closer to the lookup, with positions == true to bring in the positions they point at.
+     */
+    void prefetchSeedMatches(
+        const BclClusters::const_iterator clusterBcl,
+        const flowcell::ReadMetadataList &readMetadataList,
+        const alignment::SeedMetadataList &seedMetadataList,
+        const unsigned barcodeLength,
+        const bool positions) const;
+
 private:
     const ReferenceHash& referenceHash_;
     const unsigned seedBaseQualityMin_;
     const unsigned repeatThreshold_;
     const unsigned noExtendRepeatThreshold_;
 
+    void prefetch(const KmerT &kmer, const bool positions) const
+    {
+        positions ? referenceHash_.prefetchPositions(kmer) : referenceHash_.prefetchOffsets(kmer);
+    }
+
     bool extendSeed(
         const Cluster& cluster,
         alignment::Seed<KmerT> seed,
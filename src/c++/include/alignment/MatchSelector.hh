@@ -42,6 +42,7 @@
 #include "alignment/matchSelector/OverlappingEndsClipper.hh"
 #include "alignment/matchSelector/TemplateDetector.hh"
 #include "common/Threads.hpp"
+#include "common/WorkStealingScheduler.hh"
 #include "flowcell/BarcodeMetadata.hh"
 #include "reference/AnnotationLoader.hh"
 #include "reference/Contig.hh"
@@ -90,6 +91,7 @@ public:
         const int gapExtendScore,
         const int minGapExtendScore,
         const unsigned splitGapLength,
+        const unsigned smithWatermanBandWidth,
         const TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore,
         const bool reserveBuffers);
 
@@ -103,6 +105,11 @@ public:
         std::vector<matchSelector::MatchSelectorStats>().swap(threadStats_);
     }
 
+    /**
+     * \brief bytes of the per-thread buffers that stay allocated until unreserve
+     */
+    uint64_t getReservedMemory() const;
+
     void dumpStats(const boost::filesystem::path &statsXmlPath);
     void reserveMemory(
         const flowcell::TileMetadataList &tileMetadataList);
@@ -155,14 +162,14 @@ private:
 
     matchSelector::TemplateDetector templateDetector_;
 
-    mutable boost::mutex mutex_;
+    // hands out cluster blocks of the current tile to the compute threads
+    common::WorkStealingScheduler clusterScheduler_;
 
     template <typename MatchFinderT>
     void alignThread(
         const unsigned threadNumber,
         const flowcell::TileMetadata & tileMetadata,
         const matchFinder::ClusterInfos &clusterInfos,
-        unsigned &clusterId,
         const MatchFinderT &matchFinder,
         const BclClusters &bclData,
         const std::vector<TemplateLengthStatistics> & templateLengthStatistics,
@@ -211,6 +218,8 @@ private:
         std::vector<alignment::TemplateLengthStatistics>& templateLengthStatistics);
 
     static const unsigned CLUSTERS_AT_A_TIME = 10000;
+    // distance at which alignThread prefetches reference hash data for the upcoming clusters
+    static const unsigned PREFETCH_CLUSTERS_AHEAD = 4;
     typedef std::pair<unsigned, TemplateLengthDistribution::AlignmentModel> BarcodeAlignmentModel;
     void collectModels(
         const unsigned clusterRangeBegin,
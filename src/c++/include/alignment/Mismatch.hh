@@ -29,6 +29,7 @@
 
 #include "alignment/Read.hh"
 #include "alignment/Quality.hh"
+#include "common/CpuIsa.hh"
 #include "common/FastIo.hh"
 #include "oligo/Nucleotides.hh"
 #include "reference/Contig.hh"
@@ -94,6 +95,27 @@ std::pair<unsigned, unsigned> clipMismatches(
         std::make_pair(0U,0U);
 }
 
+typedef std::pair<unsigned, unsigned> (*CountMatchesAndDifferences)(
+    const char *sequence, const char *reference, const unsigned length);
+
+/**
+ * \return the widest implementation of countMatchesAndDifferences that does not exceed isa
+ */
+CountMatchesAndDifferences getCountMatchesAndDifferences(const common::CpuIsa isa);
+
+/**
+ * \brief Single pass over sequence and reference producing the number of matches as defined by isMatch and the number
+ *        of positions where sequence and reference bases differ (which includes Ns).
+ *
+ * \return pair(matches, differences)
+ */
+inline std::pair<unsigned, unsigned> countMatchesAndDifferences(
+    const char *sequence, const char *reference, const unsigned length)
+{
+    static const CountMatchesAndDifferences kernel = getCountMatchesAndDifferences(common::getCpuIsa());
+    return kernel(sequence, reference, length);
+}
+
 template <typename SequenceIteratorT, typename BaseExtractor>
 unsigned countMatches(
     SequenceIteratorT sequenceBegin,
@@ -158,6 +180,41 @@ unsigned countMismatches(
                            [](typename std::iterator_traits<SequenceIteratorT>::value_type c){return c;});
 }
 
+/**
+ * \brief countMatchesAndDifferences against the packed reference. The reference is unpacked in blocks into a buffer
+ *        on the stack for the vectorized kernel.
+ */
+inline std::pair<unsigned, unsigned> countMatchesAndDifferences(
+    const char *sequence, const reference::Contig::const_iterator reference, const unsigned length)
+{
+    static const unsigned UNPACK_BLOCK_BASES = 256;
+    char unpacked[UNPACK_BLOCK_BASES];
+    std::pair<unsigned, unsigned> ret(0, 0);
+    for (unsigned offset = 0; length != offset;)
+    {
+        const unsigned blockLength = std::min(length - offset, UNPACK_BLOCK_BASES);
+        (reference + offset).unpack(blockLength, unpacked);
+        const std::pair<unsigned, unsigned> block = countMatchesAndDifferences(sequence + offset, unpacked, blockLength);
+        ret.first += block.first;
+        ret.second += block.second;
+        offset += blockLength;
+    }
+    return ret;
+}
+
+/**
+ * \brief packed version for contiguous char sequence. Compares one word of packed bases at a time.
+ */
+inline unsigned countMismatches(
+    const std::vector<char>::const_iterator sequenceBegin,
+    const std::vector<char>::const_iterator sequenceEnd,
+    const reference::Contig::const_iterator referenceBegin,
+    const reference::Contig::const_iterator referenceEnd)
+{
+    const unsigned length = std::min(std::distance(sequenceBegin, sequenceEnd), std::distance(referenceBegin, referenceEnd));
+    return referenceBegin.getContig().countMismatches(sequenceBegin, sequenceBegin + length, referenceBegin.getPosition());
+}
+
 
 template <typename SequenceIteratorT, typename ReferenceIteratorT, typename BaseExtractor>
 unsigned countMismatches(
@@ -88,6 +88,13 @@ public:
         const matchSelector::SequencingAdapterList &sequencingAdapters,
         const TemplateLengthStatistics &templateLengthStatistics);
     const Cigar &getCigarBuffer() const {return shadowCigarBuffer_;}
+    /// \return bytes the aligner keeps allocated outside of its own footprint
+    uint64_t getReservedMemory() const
+    {
+        return gappedAligner_.getReservedMemory() +
+            shadowCigarBuffer_.capacity() * sizeof(Cigar::value_type) +
+            shadowCandidatePositions_.capacity() * sizeof(int64_t);
+    }
 private:
     static const unsigned unreasonablyHighDifferenceBetweenMaxAndMinInsertSizePlusFlanks_ = 10000;
 
@@ -87,6 +87,7 @@ public:
         const int gapExtendScore,
         const int minGapExtendScore,
         const unsigned splitGapLength,
+        const unsigned smithWatermanBandWidth,
         const DodgyAlignmentScore dodgyAlignmentScore,
         const bool reserveBuffers);
 
@@ -159,6 +160,9 @@ public:
      **/
     const BamTemplate &getBamTemplate() const {return bamTemplate_;}
     BamTemplate &getBamTemplate() {return bamTemplate_;}
+
+    /// \return bytes the builder keeps allocated outside of its own footprint
+    uint64_t getReservedMemory() const;
 private:
     // when considering orphans for shadow alignment, don't look at those that are further than
     // orphanLogProbabilitySlack_ away from the best orphan
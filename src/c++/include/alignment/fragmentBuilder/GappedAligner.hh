@@ -34,11 +34,15 @@ namespace fragmentBuilder
 class GappedAligner: public AlignerBase
 {
 public:
+    /**
+     * \param batch  realignBadUngappedAlignments will be used. Reserves the batch buffers
+     */
     GappedAligner(
         const bool collectMismatchCycles,
         const flowcell::FlowcellLayoutList &flowcellLayoutList,
         const bool smartSmithWaterman,
-        const AlignmentCfg &alignmentCfg);
+        const AlignmentCfg &alignmentCfg,
+        const bool batch);
 
     void realignBadUngappedAlignments(
         const unsigned gappedMismatchesMax,
@@ -61,6 +65,10 @@ public:
         const reference::ContigList &contigList,
         const isaac::reference::ContigAnnotations &kUniqenessAnnotation);
 
+    unsigned getWidestGapSize() const {return bandedSmithWaterman_.getWidestGapSize();}
+    /// \return bytes the aligner keeps allocated outside of its own footprint
+    uint64_t getReservedMemory() const;
+
 protected:
     static const unsigned HASH_KMER_LENGTH = 7;
     static const unsigned QUERY_LENGTH_MAX = 65536;
@@ -92,6 +100,46 @@ protected:
         const reference::Contig::const_iterator databaseEnd);
 
 private:
+    /// what gets clipped off the fragment sequence and where the reference for the gapped alignment begins
+    struct GappedClipping
+    {
+        unsigned firstMappedBaseOffset;
+        unsigned clipEndBases;
+        int64_t strandPosition;
+        unsigned leftFlank;
+    };
+
+    /// copies of the fragments being gap-aligned by realignBadUngappedAlignments
+    FragmentMetadataList batchFragments_;
+    std::vector<Cigar> batchCigars_;
+
+    bool prepareGapped(
+        FragmentMetadata &fragmentMetadata,
+        const matchSelector::FragmentSequencingAdapterClipper &adapterClipper,
+        const reference::ContigList &contigList,
+        GappedClipping &clipping,
+        BandedSmithWaterman::BatchItem &item);
+
+    unsigned finishGapped(
+        FragmentMetadata &fragmentMetadata,
+        const GappedClipping &clipping,
+        const unsigned smithWatermanOffset,
+        const unsigned cigarOffset,
+        Cigar &cigarBuffer,
+        const flowcell::ReadMetadata &readMetadata,
+        const reference::ContigList &contigList,
+        const isaac::reference::ContigAnnotations &kUniqenessAnnotation);
+
+    void realignBatch(
+        const unsigned smitWatermanGapsMax,
+        const reference::ContigList &contigList,
+        const isaac::reference::ContigAnnotations &kUniqenessAnnotation,
+        const flowcell::ReadMetadata &readMetadata,
+        FragmentMetadata **originals,
+        const GappedClipping *clippings,
+        const BandedSmithWaterman::BatchItem *items,
+        Cigar &cigarBuffer);
+
     void updateComponent(const unsigned cigarOffset, uint64_t len,
                          const Cigar::OpCode op, Cigar& cigarBuffer);
 };
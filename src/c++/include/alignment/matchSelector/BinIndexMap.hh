@@ -20,6 +20,8 @@
 #ifndef iSAAC_ALIGNMENT_MATCH_SELECTOR_BIN_INDEX_MAP_HH
 #define iSAAC_ALIGNMENT_MATCH_SELECTOR_BIN_INDEX_MAP_HH
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
 
 #include "alignment/MatchDistribution.hh"
@@ -45,11 +47,25 @@ class BinIndexMap : public std::vector<std::vector<unsigned> >
 {
     /// the binSize from the MatchDistribution
     const unsigned distributionBinSize_;
+    /// group of each barcode. Empty when all barcodes share the bins
+    const std::vector<unsigned> barcodeBinGroups_;
+    /// number of sets of aligned bins. The unaligned bin is shared by all of them
+    unsigned binGroups_;
+    /// aligned bins in one group
+    unsigned groupBins_;
 public:
+    /**
+     * \param barcodeBinGroups group of each barcode. Each group gets its own set of aligned bins covering the whole
+     *                         reference, so that a group's bins receive the fragments of its barcodes only.
+     */
     BinIndexMap(const MatchDistribution &matchDistribution,
                 const uint64_t matchesPerBin,
-                const bool skipEmptyBins)
-        : distributionBinSize_(matchDistribution.getBinSize())
+                const bool skipEmptyBins,
+                const std::vector<unsigned> &barcodeBinGroups = std::vector<unsigned>())
+        : distributionBinSize_(matchDistribution.getBinSize()),
+          barcodeBinGroups_(barcodeBinGroups),
+          binGroups_(barcodeBinGroups_.empty() ? 1 : *std::max_element(barcodeBinGroups_.begin(), barcodeBinGroups_.end()) + 1),
+          groupBins_(0)
     {
         reserve(matchDistribution.size());
         size_t currentBinIndex = 0;
@@ -86,6 +102,7 @@ public:
                 ++currentBinIndex;
             }
         }
+        groupBins_ = back().back();
     }
 
     /**
@@ -103,11 +120,48 @@ public:
         return binIndexList[index];
     }
 
+    /**
+     * \brief bin of the reference position in the set of bins of the barcode group
+     */
+    std::size_t getBinIndex(const isaac::reference::ReferencePosition &referencePosition, const unsigned barcode) const
+    {
+        return getGroupBinIndex(getBinIndex(referencePosition), getBarcodeBinGroup(barcode));
+    }
+
+    unsigned getBarcodeBinGroup(const unsigned barcode) const
+    {
+        return barcodeBinGroups_.empty() ? 0 : barcodeBinGroups_.at(barcode);
+    }
+
+    unsigned getBinGroups() const {return binGroups_;}
+
+    /**
+     * \param positionBin bin index as if there was only one group
+     */
+    unsigned getGroupBinIndex(const unsigned positionBin, const unsigned group) const
+    {
+        return positionBin ? positionBin + group * groupBins_ : 0;
+    }
+
+    unsigned getBinGroup(const unsigned bin) const
+    {
+        return bin ? (bin - 1) / groupBins_ : 0;
+    }
+
+    /**
+     * \return bin index as if there was only one group
+     */
+    unsigned getPositionBin(const unsigned bin) const
+    {
+        return bin ? (bin - 1) % groupBins_ + 1 : 0;
+    }
+
     /**
      * \return The first reference position that can be found in the bin
      */
-    isaac::reference::ReferencePosition getBinFirstPos(const unsigned bin) const
+    isaac::reference::ReferencePosition getBinFirstPos(const unsigned groupBin) const
     {
+        const unsigned bin = getPositionBin(groupBin);
         std::vector<unsigned>::const_reference (std::vector<unsigned>::*f)() const = &std::vector<unsigned>::front;
 
         // user upper_bound to skip all the contigs that were so empty that they did not get mapped to a bin
@@ -132,8 +186,9 @@ public:
      *         there is not guarantee that no alignments will exist at this position and beyond. However, the amount
      *         of data aligning there should be considered minor and belonging to the last bin.
      */
-    isaac::reference::ReferencePosition getBinFirstInvalidPos(const unsigned bin) const
+    isaac::reference::ReferencePosition getBinFirstInvalidPos(const unsigned groupBin) const
     {
+        const unsigned bin = getPositionBin(groupBin);
         std::vector<unsigned>::const_reference (std::vector<unsigned>::*f)() const = &std::vector<unsigned>::front;
 
         // user upper_bound to skip all the contigs that were so empty that they did not get mapped to a bin
@@ -157,7 +212,7 @@ public:
      */
     unsigned getHighestBinIndex() const
     {
-        return back().back();
+        return groupBins_ * binGroups_;
     }
 
     unsigned getTotalBins() const
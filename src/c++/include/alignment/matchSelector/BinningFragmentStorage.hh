@@ -49,24 +49,32 @@ public:
         const bool keepUnaligned,
         const BinIndexMap &binIndexMap,
         alignment::BinMetadataList &binMetadataList,
-        const uint64_t expectedBinSize);
+        const uint64_t expectedBinSize,
+        const unsigned maxThreads);
 
     ~BinningFragmentStorage();
 
     virtual void store(
         const BamTemplate &bamTemplate,
-        const unsigned barcodeIdx);
+        const unsigned barcodeIdx,
+        const unsigned threadNumber);
 
     virtual void reset(const uint64_t clusterId, const bool paired)
     {
 
     }
 
+    /**
+     * \brief Called between tiles when no stores are in progress. The buffered fragments are written out by
+     *        flush while the threads store the next tile.
+     */
     virtual void prepareFlush() noexcept
     {
+        sealThreadBuffers();
     }
     virtual void flush()
     {
+        flushSealedBuffers();
     }
     virtual void resize(const uint64_t clusters)
     {
@@ -74,6 +82,14 @@ public:
     virtual void reserve(const uint64_t clusters)
     {
     }
+    virtual void expectLane(const std::vector<unsigned> &laneBins)
+    {
+        FragmentBinner::expectLane(laneBins);
+    }
+    virtual void sealLane(const std::vector<unsigned> &laneBins, std::vector<unsigned> &sealedBins)
+    {
+        FragmentBinner::sealLane(binMetadataList_.begin(), laneBins, sealedBins);
+    }
 
 private:
     /// Maximum number of bytes a packed fragment is expected to take. Change and recompile when needed
@@ -56,7 +56,7 @@ public:
 
     ~BufferingFragmentStorage();
 
-    virtual void store(const BamTemplate &bamTemplate, const unsigned barcodeIdx);
+    virtual void store(const BamTemplate &bamTemplate, const unsigned barcodeIdx, const unsigned threadNumber);
     virtual void reset(const uint64_t clusterId, const bool paired);
     virtual void prepareFlush() noexcept;
     virtual void flush();
@@ -71,6 +71,16 @@ public:
         storeBuffer_.reserve(clusters);
     }
 
+    virtual void expectLane(const std::vector<unsigned> &laneBins)
+    {
+        FragmentBinner::expectLane(laneBins);
+    }
+
+    virtual void sealLane(const std::vector<unsigned> &laneBins, std::vector<unsigned> &sealedBins)
+    {
+        FragmentBinner::sealLane(binMetadataList_.begin(), laneBins, sealedBins);
+    }
+
 private:
     static const unsigned READS_MAX = 2;
 
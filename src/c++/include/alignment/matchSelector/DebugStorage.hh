@@ -64,7 +64,8 @@ public:
 private:
     virtual void store(
         const BamTemplate &bamTemplate,
-        const unsigned barcodeIdx);
+        const unsigned barcodeIdx,
+        const unsigned threadNumber);
 
     virtual void reset(const uint64_t clusterId, const bool paired)
     {
@@ -87,6 +88,14 @@ private:
     {
         actualStorage_.reserve(clusters);
     }
+    virtual void expectLane(const std::vector<unsigned> &laneBins)
+    {
+        actualStorage_.expectLane(laneBins);
+    }
+    virtual void sealLane(const std::vector<unsigned> &laneBins, std::vector<unsigned> &sealedBins)
+    {
+        actualStorage_.sealLane(laneBins, sealedBins);
+    }
 
 private:
     bool updateMapqStats(const BamTemplate& bamTemplate);
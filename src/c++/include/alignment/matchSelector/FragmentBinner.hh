@@ -20,12 +20,18 @@
 #ifndef iSAAC_ALIGNMENT_MATCH_SELECTOR_FRAGMENT_BINNER_HH
 #define iSAAC_ALIGNMENT_MATCH_SELECTOR_FRAGMENT_BINNER_HH
 
+#include <sys/uio.h>
+
+#include <boost/bind.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
 
 #include "alignment/BinMetadata.hh"
 #include "BinIndexMap.hh"
+#include "common/Threads.hpp"
+#include "io/AsyncFileIo.hh"
 #include "io/FileBufCache.hh"
 #include "io/Fragment.hh"
 
@@ -129,6 +135,13 @@ private:
     }
 };
 
+/**
+ * \brief Fragments are first appended to the buffer of the storing thread. A thread buffer is written out when it
+ *        fills up or when the owner of the binner says so. The write out groups the records by bin and, for each
+ *        bin, does the chunk accounting and the file offset reservation under a single lock acquisition. The
+ *        data is then handed to AsyncFileIo outside of the lock. Writes of all bins in the buffer are in flight
+ *        together and are waited for once per write out.
+ */
 class FragmentBinner: boost::noncopyable
 {
 public:
@@ -137,7 +150,16 @@ public:
         const unsigned maxSavers,
         const BinIndexMap &binIndexMap,
         const std::size_t binFiles,
-        const uint64_t expectedBinSize);
+        const uint64_t expectedBinSize,
+        const unsigned maxThreads);
+
+    ~FragmentBinner();
+
+    /**
+     * \brief Memory the thread buffers of a binner with maxThreads threads occupy for its whole lifetime.
+     *        Each thread has an active and a sealed buffer.
+     */
+    static std::size_t getMemoryRequirements(const unsigned maxThreads);
 
     // opens a range of bins. Multiple opens are called over the lifetime of FragmentBinner
     void open(
@@ -150,23 +172,70 @@ public:
         common::ThreadVector &threads);
 
     /**
-     * \brief reclaims any unused storage.
+     * \brief reclaims any unused storage. Anything still buffered is discarded.
      */
     void reclaimStorage(
         const alignment::BinMetadataList::const_iterator binsBegin,
         const alignment::BinMetadataList::const_iterator binsEnd) noexcept;
 
+    /**
+     * \brief Declares a lane that stores fragments into laneBins. All lanes must be declared before the first of
+     *        them gets sealed.
+     */
+    void expectLane(const std::vector<unsigned> &laneBins);
+
+    /**
+     * \brief Called once every tile of the lane has been written out and no stores or flushes are in progress.
+     *        The bins none of the remaining lanes store into get truncated to their data size and their files
+     *        released. The indexes of such bins are appended to sealedBins. Sealed bins don't get reopened.
+     */
+    void sealLane(
+        const alignment::BinMetadataList::const_iterator binsBegin,
+        const std::vector<unsigned> &laneBins,
+        std::vector<unsigned> &sealedBins);
+
     void storeSingle(
-        const io::FragmentAccessor &fragment);
+        const io::FragmentAccessor &fragment,
+        const unsigned threadNumber);
 
     void storePaired(
         const io::FragmentAccessor &fragment0,
-        const io::FragmentAccessor &fragment1);
+        const io::FragmentAccessor &fragment1,
+        const unsigned threadNumber);
+
+    /**
+     * \brief writes out the fragments buffered by the thread. Must not overlap with stores by the same thread.
+     */
+    void flushThreadBuffer(const unsigned threadNumber)
+    {
+        flushBuffer(threadBuffers_.at(threadNumber));
+    }
+
+    /**
+     * \brief Sets aside the buffered fragments of all threads and gives the threads empty buffers. Must not overlap
+     *        with any stores or with flushSealedBuffers.
+     */
+    void sealThreadBuffers() noexcept
+    {
+        threadBuffers_.swap(sealedBuffers_);
+    }
+
+    /**
+     * \brief writes out the fragments set aside by sealThreadBuffers. Can overlap with stores.
+     */
+    void flushSealedBuffers()
+    {
+        std::for_each(sealedBuffers_.begin(), sealedBuffers_.end(), boost::bind(&FragmentBinner::flushBuffer, this, _1));
+    }
 
 private:
     /// Maximum number of bins a fragment is expected to cover. In theory this can be up to total number of bins.
     static const unsigned FRAGMENT_BINS_MAX = 10*1024;
     static const unsigned UNMAPPED_BIN = -1U;
+    /// Bytes of fragment data each thread accumulates before writing out. Must fit the largest pair of fragments.
+    static const unsigned THREAD_BUFFER_BYTES = 2 * 1024 * 1024;
+    /// Maximum number of buffers given to a single write request
+    static const unsigned IOVECS_MAX = 1024;
 
     static const unsigned READS_MAX = 2;
     const bool keepUnaligned_;
@@ -175,24 +244,72 @@ private:
     const BinIndexMap &binIndexMap_;
 
     uint64_t binZeroRecordsBinned_;
-    // number of mutexes is arbitrary. It allows reducing the synchronization collisions between threads requesting write
+    // number of mutexes is arbitrary. It allows reducing the synchronization collisions between threads
+    // accounting for the data they are about to write
     boost::array<boost::mutex, 64> binMutex_;
-    std::vector<io::FileBufWithReopen> files_;
+    // file descriptors. /dev/null when the slot does not have a bin open
+    std::vector<int> files_;
     std::vector<unsigned> binFiles_;
+    // number of declared lanes not sealed yet that store into the bin
+    std::vector<unsigned> binPendingLanes_;
+    std::vector<bool> binSealed_;
+    io::AsyncFileIo asyncIo_;
+
+    struct BufferedRecord
+    {
+        BufferedRecord(const unsigned file, const unsigned offset, const bool splitRead) :
+            file_(file), offset_(offset), splitRead_(splitRead) {}
+        unsigned file_;
+        // offset of the fragment in ThreadBuffer::data_
+        unsigned offset_;
+        bool splitRead_;
+    };
+
+    struct ThreadBuffer
+    {
+        ThreadBuffer() : used_(0) {}
+        std::vector<char> data_;
+        std::size_t used_;
+        std::vector<BufferedRecord> records_;
+        // record indexes grouped by file during the write out
+        std::vector<unsigned> order_;
+        // one per record. Must stay intact until batch_ completes
+        std::vector<iovec> iovecs_;
+        io::AsyncFileIo::Batch batch_;
+
+        void reserve();
+        std::size_t available() const {return data_.size() - used_;}
+        bool empty() const {return records_.empty();}
+    };
+    std::vector<ThreadBuffer> threadBuffers_;
+    std::vector<ThreadBuffer> sealedBuffers_;
 
     // range of currently open bins
     alignment::BinMetadataList::iterator binsBegin_;
     alignment::BinMetadataList::iterator binsEnd_;
 
-    void storeFragment(
+    void countFragment(
         const io::FragmentAccessor &fragment,
         const bool splitRead,
         BinMetadata &binMetadata);
 
+    void bufferFragment(
+        ThreadBuffer &buffer,
+        const unsigned file,
+        const io::FragmentAccessor &fragment,
+        const bool splitRead);
+
+    void flushBuffer(ThreadBuffer &buffer);
+    void writeRecords(
+        ThreadBuffer &buffer,
+        std::vector<unsigned>::const_iterator begin,
+        const std::vector<unsigned>::const_iterator end);
+
     typedef common::StaticVector<unsigned, FRAGMENT_BINS_MAX * 2> FragmentBins;
     void getFragmentStorageBins(const io::FragmentAccessor &fragment, FragmentBins &bins);
 
     void reopenBin(const BinMetadata &binMetadata, std::size_t file);
+    void releaseFile(const std::size_t file) noexcept;
 };
 
 } // namespace matchSelector
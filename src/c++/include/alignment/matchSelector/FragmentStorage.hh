@@ -39,15 +39,30 @@ class FragmentStorage
 public:
     virtual ~FragmentStorage(){}
 
+    /**
+     * \brief threadNumber is unique among the threads storing concurrently
+     */
     virtual void store(
         const BamTemplate &bamTemplate,
-        const unsigned barcodeIdx) = 0;
+        const unsigned barcodeIdx,
+        const unsigned threadNumber) = 0;
     virtual void reset(const uint64_t clusterId, const bool paired) = 0;
 
     virtual void prepareFlush() noexcept = 0;
     virtual void flush() = 0;
     virtual void resize(const uint64_t clusters) = 0;
     virtual void reserve(const uint64_t clusters) = 0;
+
+    /**
+     * \brief laneBins are the bins the fragments of the lane can go into. All lanes are declared up front.
+     */
+    virtual void expectLane(const std::vector<unsigned> &laneBins) = 0;
+
+    /**
+     * \brief Called once the last tile of the lane has been flushed. Appends to sealedBins the bins that will not
+     *        receive any more fragments.
+     */
+    virtual void sealLane(const std::vector<unsigned> &laneBins, std::vector<unsigned> &sealedBins) = 0;
 };
 
 } // namespace matchSelector
@@ -163,6 +163,11 @@ public:
         std::for_each(tileBarcodeStats_.begin(), tileBarcodeStats_.end(), boost::bind(&TileBarcodeStats::finalize, _1));
     }
 
+    uint64_t getReservedMemory() const
+    {
+        return tileStats_.capacity() * sizeof(TileStats) + tileBarcodeStats_.capacity() * sizeof(TileBarcodeStats);
+    }
+
 private:
     static const unsigned filterStates_ = 2;
     static const unsigned maxReads_ = 2;
@@ -170,6 +170,14 @@ struct BestPairInfo
         repeats_.reserve(TRACKED_REPEATS_MAX_ONE_READ * READS_IN_A_PAIR);
     }
 
+    /// \return bytes taken by the reserve above
+    uint64_t getReservedMemory() const
+    {
+        return (readProbabilities_[0].capacity() + readProbabilities_[1].capacity()) * sizeof(templateBuilder::ShadowProbability) +
+            pairProbabilities_.capacity() * sizeof(templateBuilder::PairProbability) +
+            repeats_.capacity() * sizeof(BamTemplate);
+    }
+
     void clear()
     {
         info_.clear();
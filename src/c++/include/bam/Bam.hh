@@ -92,40 +92,49 @@ struct zTag
 
 void serialize(std::ostream &os, const char* bytes, std::size_t size);
 
-inline void serialize(std::ostream &os, const char* pStr, const char* pEnd) {
+// The overloads below work for any OsT for which serialize(OsT &, const char*, std::size_t) is available.
+template <typename OsT>
+inline void serialize(OsT &os, const char* pStr, const char* pEnd) {
     serialize(os, pStr, std::distance(pStr, pEnd));
 }
 
-inline void serialize(std::ostream &os, const char* pStr) {
+template <typename OsT>
+inline void serialize(OsT &os, const char* pStr) {
     serialize(os, pStr, strlen(pStr) + 1);
 }
 
-inline void serialize(std::ostream &os, const std::string &str) {
+template <typename OsT>
+inline void serialize(OsT &os, const std::string &str) {
     serialize(os, str.c_str(), str.length() + 1);
 }
 
 //todo: provide proper implementation with byte flipping
-inline void serialize(std::ostream &os, const int &i) {
+template <typename OsT>
+inline void serialize(OsT &os, const int &i) {
     serialize(os, reinterpret_cast<const char*>(&i), sizeof(i));
 }
 
-inline void serialize(std::ostream &os, const char &c) {
+template <typename OsT>
+inline void serialize(OsT &os, const char &c) {
     serialize(os, &c, sizeof(c));
 }
 
 //todo: provide proper implementation with byte flipping
-inline void serialize(std::ostream &os, const unsigned &ui) {
+template <typename OsT>
+inline void serialize(OsT &os, const unsigned &ui) {
     serialize(os, reinterpret_cast<const char*>(&ui), sizeof(ui));
 }
 
-inline void serialize(std::ostream &os, const iTag &tag) {
+template <typename OsT>
+inline void serialize(OsT &os, const iTag &tag) {
     serialize(os, tag.tag_, sizeof(tag.tag_));
     const char val_type = tag.val_type_;
     serialize(os, val_type);
     serialize(os, tag.value_);
 }
 
-inline void serialize(std::ostream &os, const zTag &tag) {
+template <typename OsT>
+inline void serialize(OsT &os, const zTag &tag) {
     if (tag.value_)
     {
         serialize(os, tag.tag_, sizeof(tag.tag_));
@@ -136,13 +145,13 @@ inline void serialize(std::ostream &os, const zTag &tag) {
 }
 
 
-template <typename T>
-void serialize(std::ostream &os, const std::vector<T> &vector) {
+template <typename OsT, typename T>
+void serialize(OsT &os, const std::vector<T> &vector) {
     serialize(os, reinterpret_cast<const char*>(&vector.front()), vector.size() * sizeof(T));
 }
 
-template <typename IteratorT>
-void serialize(std::ostream &os, const std::pair<IteratorT, IteratorT> &pairBeginEnd) {
+template <typename OsT, typename IteratorT>
+void serialize(OsT &os, const std::pair<IteratorT, IteratorT> &pairBeginEnd) {
     serialize(os, reinterpret_cast<const char*>(&*pairBeginEnd.first),
               std::distance(pairBeginEnd.first, pairBeginEnd.second) * sizeof(*pairBeginEnd.first));
 }
@@ -253,8 +262,8 @@ inline int bam_reg2bin(unsigned beg, unsigned end)
 
 typedef std::vector<flowcell::TileMetadata> TileMetadataList;
 
-template <typename T>
-unsigned serializeAlignment(std::ostream &os, T&alignment)
+template <typename OsT, typename T>
+unsigned serializeAlignment(OsT &os, T&alignment)
 {
     const int refID(alignment.refId());
     const int pos(alignment.pos());
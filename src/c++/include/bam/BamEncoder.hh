@@ -0,0 +1,133 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BamEncoder.hh
+ **
+ ** Serialization of bam records straight into bgzf blocks.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BAM_BAM_ENCODER_HH
+#define iSAAC_BAM_BAM_ENCODER_HH
+
+#include <cstring>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "bam/BamIndexer.hh"
+#include "bam/BgzfBlockPool.hh"
+#include "bgzf/BgzfDeflater.hh"
+
+namespace isaac
+{
+namespace bam
+{
+
+/**
+ * \brief Replacement for the filtering_ostream with BgzfCompressor and back_insert_device. Records are copied into
+ *        the block buffer and each full block is submitted into the BgzfBlockPool which appends it to the output
+ *        buffer once compressed. Block boundaries are the same as BgzfCompressor ones, so the bgzf data is identical
+ *        when the zlib backend is used.
+ */
+class BamEncoder: boost::noncopyable
+{
+public:
+    explicit BamEncoder(BgzfBlockPool &blockPool) :
+        blockPool_(blockPool), block_(bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX), blockSize_(0), deflater_(0)
+    {
+    }
+
+    /**
+     * \brief subsequent blocks get appended to output. The output must have enough capacity reserved.
+     *
+     * \param deflater  used to compress the waiting blocks while the pool has no free ones. Must not be used by
+     *                  other threads until the encoder is closed.
+     */
+    void open(BgzfBuffer &output, bgzf::BgzfDeflater &deflater)
+    {
+        ISAAC_ASSERT_MSG(!blockSize_, "Data left from previous use");
+        blockPool_.open(queue_, output);
+        deflater_ = &deflater;
+    }
+
+    bool isOpen() const {return deflater_;}
+
+    void write(const char *bytes, std::size_t size)
+    {
+        while (size)
+        {
+            const std::size_t chunk = std::min(size, block_.size() - blockSize_);
+            memcpy(&block_[blockSize_], bytes, chunk);
+            blockSize_ += chunk;
+            bytes += chunk;
+            size -= chunk;
+            if (block_.size() == blockSize_)
+            {
+                flushBlock();
+            }
+        }
+    }
+
+    /**
+     * \brief submits the incomplete block if there is one and waits until all the data is in the output
+     */
+    void flush()
+    {
+        if (blockSize_)
+        {
+            flushBlock();
+        }
+        blockPool_.flush(queue_, *deflater_);
+    }
+
+    void close()
+    {
+        flush();
+        deflater_ = 0;
+    }
+
+    /**
+     * \brief drops the buffered data. Only valid if nothing has been submitted since open
+     */
+    void discard()
+    {
+        ISAAC_ASSERT_MSG(queue_.empty(), "Blocks are being compressed");
+        blockSize_ = 0;
+        deflater_ = 0;
+    }
+
+private:
+    BgzfBlockPool &blockPool_;
+    BgzfBlockPool::Queue queue_;
+    std::vector<char> block_;
+    std::size_t blockSize_;
+    bgzf::BgzfDeflater *deflater_;
+
+    void flushBlock()
+    {
+        ISAAC_ASSERT_MSG(deflater_, "BamEncoder is not open");
+        blockPool_.submit(queue_, &block_.front(), blockSize_, *deflater_);
+        blockSize_ = 0;
+    }
+};
+
+inline void serialize(BamEncoder &encoder, const char* bytes, std::size_t size)
+{
+    encoder.write(bytes, size);
+}
+
+} // namespace bam
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BAM_BAM_ENCODER_HH
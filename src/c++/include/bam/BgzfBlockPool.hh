@@ -0,0 +1,146 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BgzfBlockPool.hh
+ **
+ ** Uncompressed bgzf blocks waiting to be compressed by any thread that has nothing better to do.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BAM_BGZF_BLOCK_POOL_HH
+#define iSAAC_BAM_BGZF_BLOCK_POOL_HH
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "bam/BamIndexer.hh"
+#include "bgzf/BgzfDeflater.hh"
+
+namespace isaac
+{
+namespace bam
+{
+
+/**
+ * \brief Fixed number of block buffers shared by all producers of bgzf data. Producers submit full uncompressed
+ *        blocks into their Queue. Any thread calling compress, submit or flush picks up the oldest waiting block
+ *        and compresses it with its own deflater. Compressed blocks are appended to the Queue output in the order
+ *        they were submitted, so the output is the same as if the producer compressed the blocks itself.
+ *
+ *        No memory gets allocated after construction.
+ */
+class BgzfBlockPool: boost::noncopyable
+{
+    static const unsigned NO_BLOCK = -1U;
+public:
+    /**
+     * \brief Blocks of a single producer. Only one thread at a time is expected to submit into a Queue.
+     */
+    class Queue: boost::noncopyable
+    {
+        friend class BgzfBlockPool;
+        BgzfBuffer *output_;
+        unsigned head_;
+        unsigned tail_;
+    public:
+        Queue() : output_(0), head_(NO_BLOCK), tail_(NO_BLOCK) {}
+        bool empty() const {return NO_BLOCK == head_;}
+    };
+
+    explicit BgzfBlockPool(const unsigned blocks);
+
+    /**
+     * \brief compressed blocks of the queue will be appended to output
+     */
+    void open(Queue &queue, BgzfBuffer &output);
+
+    /**
+     * \brief copies the data into a free block. While there are no free blocks, compresses the waiting ones.
+     */
+    void submit(Queue &queue, const char *data, const std::size_t size, bgzf::BgzfDeflater &deflater);
+
+    /**
+     * \brief returns when all blocks of the queue have been appended to its output. Compresses the waiting
+     *        blocks meanwhile.
+     */
+    void flush(Queue &queue, bgzf::BgzfDeflater &deflater);
+
+    /**
+     * \brief compresses the waiting blocks. Returns as soon as there is nothing left waiting.
+     */
+    void compress(bgzf::BgzfDeflater &deflater);
+
+    /**
+     * \brief blocks until there is something to compress. Does not compress anything, so that the caller can
+     *        give up whatever resources it holds while waiting.
+     *
+     * \return false if stop was set with the call to the stop method or compression failed on another thread
+     */
+    bool waitForBlocks(const bool &stop);
+
+    /**
+     * \brief sets stop to true and releases the threads blocked in waitForBlocks
+     */
+    void stop(bool &stop);
+
+    /**
+     * \brief Returns all blocks to the pool and clears the failure of a previous use. The queues that still hold
+     *        blocks are emptied, their data is lost. No thread may be using the pool during the call.
+     */
+    void reset();
+
+private:
+    enum BlockState
+    {
+        BlockFree,
+        BlockWaiting,
+        BlockCompressing,
+        BlockCompressed
+    };
+    struct Block
+    {
+        Block() : state_(BlockFree), queue_(0), next_(NO_BLOCK), size_(0), compressedSize_(0) {}
+        BlockState state_;
+        Queue *queue_;
+        // next block of the same queue
+        unsigned next_;
+        std::size_t size_;
+        std::size_t compressedSize_;
+    };
+
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    std::vector<Block> blocks_;
+    std::vector<char> uncompressed_;
+    std::vector<char> compressed_;
+    std::vector<unsigned> freeBlocks_;
+    // ring of blocks in the order of submission
+    std::vector<unsigned> waiting_;
+    std::size_t waitingBegin_;
+    std::size_t waitingCount_;
+    // compression of one of the blocks failed. The data is incomplete.
+    bool failed_;
+
+    char *uncompressed(const unsigned block) {return &uncompressed_[block * bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX];}
+    char *compressed(const unsigned block) {return &compressed_[block * bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX];}
+    bool compressWaiting(boost::unique_lock<boost::mutex> &lock, bgzf::BgzfDeflater &deflater);
+    void append(Queue &queue);
+    void checkFailed() const;
+};
+
+} // namespace bam
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BAM_BGZF_BLOCK_POOL_HH
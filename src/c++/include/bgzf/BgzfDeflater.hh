@@ -0,0 +1,105 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BgzfDeflater.hh
+ **
+ ** Compression of complete bgzf blocks with a choice of deflate implementations.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BGZF_BGZF_DEFLATER_HH
+#define iSAAC_BGZF_BGZF_DEFLATER_HH
+
+#include <zlib.h>
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "bgzf/Bgzf.hh"
+#include "common/Exceptions.hh"
+
+namespace isaac
+{
+namespace bgzf
+{
+
+enum DeflateBackend
+{
+    DeflateZlib,
+    // libdeflate. Only available if found at configuration time
+    DeflateLibdeflate,
+    DeflateBackendCount
+};
+
+const char *getDeflateBackendName(const DeflateBackend backend);
+
+bool isDeflateBackendSupported(const DeflateBackend backend);
+
+/**
+ ** \brief Exception thrown when a deflate implementation fails to compress a block.
+ **
+ **/
+class BgzfDeflateException: public common::IsaacException
+{
+public:
+    BgzfDeflateException(const std::string &message) : IsaacException(EINVAL, message)
+    {
+    }
+};
+
+/**
+ * \brief Turns up to UNCOMPRESSED_BLOCK_MAX bytes into a complete bgzf block. The zlib backend produces the same
+ *        bytes as the BgzfCompressor filter given the same level and block boundaries. The exception is level 0
+ *        where the split into stored deflate blocks differs, and data that does not compress, which is stored in
+ *        one deflate block instead of overflowing the bgzf block. Other backends produce valid bgzf that
+ *        decompresses to the same data.
+ *
+ *        Not thread safe. No memory gets allocated after construction.
+ */
+class BgzfDeflater: boost::noncopyable
+{
+public:
+    /// uncompressed bytes BgzfCompressor puts in a block
+    static const unsigned UNCOMPRESSED_BLOCK_MAX = 0xFFFF - 41;
+    /// bgzf block including header and footer cannot be longer than this
+    static const unsigned COMPRESSED_BLOCK_MAX = 0x10000;
+    /// overhead of the deflate block that keeps data uncompressed
+    static const unsigned STORED_HEADER_BYTES = 5;
+
+    BgzfDeflater(const DeflateBackend backend, const int level);
+    ~BgzfDeflater();
+
+    DeflateBackend getBackend() const {return backend_;}
+
+    /**
+     * \return length of the block stored in out. out must have COMPRESSED_BLOCK_MAX bytes available
+     */
+    std::size_t compress(const char *data, const std::size_t size, char *out);
+
+private:
+    const DeflateBackend backend_;
+    const int level_;
+    z_stream zstream_;
+    // libdeflate_compressor
+    void *libdeflate_;
+
+    std::size_t deflateZlib(const char *data, const std::size_t size, char *out, const std::size_t capacity);
+    std::size_t deflateLibdeflate(const char *data, const std::size_t size, char *out, const std::size_t capacity);
+    static std::size_t store(const char *data, const std::size_t size, char *out);
+};
+
+} // namespace bgzf
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BGZF_BGZF_DEFLATER_HH
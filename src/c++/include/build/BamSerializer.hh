@@ -20,10 +20,10 @@
 #ifndef iSAAC_BUILD_BAM_SERIALIZER_HH
 #define iSAAC_BUILD_BAM_SERIALIZER_HH
 
-#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "bam/Bam.hh"
+#include "bam/BamEncoder.hh"
 #include "bam/BamIndexer.hh"
 #include "build/BarcodeBamMapping.hh"
 #include "build/BinData.hh"
@@ -49,12 +49,12 @@ public:
 
     void storeAligned(
         const io::FragmentAccessor &fragment,
-        boost::ptr_vector<boost::iostreams::filtering_ostream> &streams,
+        boost::ptr_vector<bam::BamEncoder> &encoders,
         boost::ptr_vector<bam::BamIndexPart> &bamIndexParts,
         FragmentAccessorBamAdapter& adapter)
     {
         unsigned serializedLength = bam::serializeAlignment(
-            streams.at(barcodeOutputFileIndexMap_.at(fragment.barcode_)), adapter);
+            encoders.at(barcodeOutputFileIndexMap_.at(fragment.barcode_)), adapter);
         bam::BamIndexPart& bamIndexPart = bamIndexParts.at(barcodeOutputFileIndexMap_.at(fragment.barcode_));
         bamIndexPart.processFragment( adapter, serializedLength );
 //        ISAAC_THREAD_CERR << "Serialized to bam pos_: " << idx.pos_ << " dataOffset_: " << idx.dataOffset_ << std::endl;
@@ -62,12 +62,12 @@ public:
 
     void storeUnaligned(
         const io::FragmentAccessor &fragment,
-        boost::ptr_vector<boost::iostreams::filtering_ostream> &streams,
+        boost::ptr_vector<bam::BamEncoder> &encoders,
         boost::ptr_vector<bam::BamIndexPart> &bamIndexParts,
         FragmentAccessorBamAdapter& adapter)
     {
         unsigned serializedLength = bam::serializeAlignment(
-            streams.at(barcodeOutputFileIndexMap_.at(fragment.barcode_)), adapter);
+            encoders.at(barcodeOutputFileIndexMap_.at(fragment.barcode_)), adapter);
         bam::BamIndexPart& bamIndexPart = bamIndexParts.at(barcodeOutputFileIndexMap_.at(fragment.barcode_));
         bamIndexPart.processFragment( adapter, serializedLength );
 //        ISAAC_THREAD_CERR << "Serialized unaligned pos_: " << fragment << std::endl;
@@ -76,12 +76,13 @@ public:
     void prepareForBam(
         PackedFragmentBuffer &data,
         BinData::IndexType &dataIndex,
-        alignment::Cigar &splitCigars);
+        alignment::Cigar &splitCigars,
+        common::RadixSortRecords &sortRecords);
 
 private:
     void splitIfNeeded(
         PackedFragmentBuffer &data,
-        PackedFragmentBuffer::Index &index,
+        PackedFragmentBuffer::CompactIndex &compactIndex,
         BinData::IndexType &splitIndexEntries,
         alignment::Cigar &splitCigars);
 
@@ -32,7 +32,9 @@
 #include "build/FragmentIndex.hh"
 #include "build/PackedFragmentBuffer.hh"
 #include "build/gapRealigner/RealignerGaps.hh"
+#include "common/RadixSort.hpp"
 #include "io/FileBufCache.hh"
+#include "io/ReadAheadFileBuf.hh"
 
 namespace isaac
 {
@@ -51,13 +53,15 @@ enum GapRealignerMode
     REALIGN_ALL
 };
 
-struct BinData : public std::vector<PackedFragmentBuffer::Index, common::NumaAllocator<PackedFragmentBuffer::Index, common::numa::defaultNodeLocal> >
+struct BinData : public std::vector<PackedFragmentBuffer::CompactIndex, common::NumaAllocator<PackedFragmentBuffer::CompactIndex, common::numa::defaultNodeLocal> >
 {
-    typedef std::vector<PackedFragmentBuffer::Index, common::NumaAllocator<PackedFragmentBuffer::Index, common::numa::defaultNodeLocal> > BaseType;
+    typedef std::vector<PackedFragmentBuffer::CompactIndex, common::NumaAllocator<PackedFragmentBuffer::CompactIndex, common::numa::defaultNodeLocal> > BaseType;
     typedef BaseType IndexType;
     typedef std::vector<SeFragmentIndex, common::NumaAllocator<SeFragmentIndex, common::numa::defaultNodeLocal> > SeIdx;
     typedef std::vector<RStrandOrShadowFragmentIndex, common::NumaAllocator<RStrandOrShadowFragmentIndex, common::numa::defaultNodeLocal> > RIdx;
     typedef std::vector<FStrandFragmentIndex, common::NumaAllocator<FStrandFragmentIndex, common::numa::defaultNodeLocal> > FIdx;
+    // deduplicated index entries reserved per fragment to leave room for the entries of split reads
+    static const unsigned INDEX_ELEMENTS_PER_FRAGMENT = 2;
 
 public:
     BinData(
@@ -76,7 +80,8 @@ public:
         const flowcell::FlowcellLayoutList &flowCellLayoutList,
         const IncludeTags includeTags,
         const bool pessimisticMapQ,
-        const unsigned splitGapLength) :
+        const unsigned splitGapLength,
+        io::AsyncFileIo &asyncIo) :
             bin_(bin),
             binStatsIndex_(binStatsIndex),
             barcodeBamMapping_(barcodeBamMapping),
@@ -84,17 +89,22 @@ public:
             knownIndels_(knownIndels),
             realignerGaps_(getGapGroupsCount()),
             dataDistribution_(bin_.getDataDistribution()),
-            inputFileBuf_(),
+            inputFileBuf_(asyncIo),
             bamAdapter_(
                 maxReadLength, tileMetadataList, barcodeMetadataList,
                 contigMap, contigLists, forcedDodgyAlignmentScore, flowCellLayoutList, includeTags, pessimisticMapQ, splitGapLength)
     {
+        if (PackedFragmentBuffer::needsWideOffsets(bin_))
+        {
+            ISAAC_THREAD_CERR << "WARNING: Bin data does not fit 32 bit offsets. Using wide fragment offsets for " << bin_ << std::endl;
+        }
         data_.reserve(bin_);
 
-        BaseType::reserve(bin_.getTotalElements() * 2);
+        BaseType::reserve(bin_.getTotalElements() * INDEX_ELEMENTS_PER_FRAGMENT);
         seIdx_.reserve(bin_.getSeIdxElements());
         rIdx_.reserve(bin_.getRIdxElements());
         fIdx_.reserve(bin_.getFIdxElements());
+        sortRecords_.reserve(getSortRecordsCount(bin_));
         if (REALIGN_NONE != realignGaps_)
         {
             reserveGaps(bin_, knownIndels_, barcodeMetadataList);
@@ -106,6 +116,8 @@ public:
         additionalCigars_.reserve(
             // Assuming each split read will result in two separate fragments
             SINGLE_SPLIT_LEFTOVER_COMPONENTS * bin.getTotalSplitCount() * 2 +
+            // each stored CIGAR is preceded by its length
+            bin.getTotalSplitCount() * 2 + bin.getTotalElements() +
             // assume each existing cigar gets realignedGapsPerFragment_ gaps introduced...
             (bin.getTotalCigarLength() + bin.getTotalElements() *
                 // assume that to introduce k gaps one will need to have k+1 operations between the gaps
@@ -113,7 +125,7 @@ public:
 
         // summarize chunk sizes to get offsets
         dataDistribution_.tallyOffsets();
-        if (!inputFileBuf_.open(bin_.getPathString().c_str(), std::ios_base::binary|std::ios_base::in))
+        if (!inputFileBuf_.open(bin_.getPathString().c_str()))
         {
             BOOST_THROW_EXCEPTION(
                 common::IoException(errno, (boost::format("Failed to open file %s: %s") % bin_.getPathString() % strerror(errno)).str()));
@@ -125,10 +137,30 @@ public:
     static uint64_t getMemoryRequirements(const alignment::BinMetadata& bin)
     {
         return PackedFragmentBuffer::getMemoryRequirements(bin) +
-            bin.getSeIdxElements() * sizeof(SeFragmentIndex) +
-            bin.getRIdxElements() * sizeof(RStrandOrShadowFragmentIndex) +
-            bin.getFIdxElements() * sizeof(FStrandFragmentIndex) +
-            bin.getTotalElements() * sizeof(PackedFragmentBuffer::Index);
+            bin.getTotalElements() * getFragmentIndexMemoryRequirements() +
+            bin.getTotalSplitCount() * 2 * sizeof(common::RadixSortRecord) +
+            io::ReadAheadFileBuf::MEMORY_REQUIREMENTS;
+    }
+
+    /**
+     * \brief Index memory reserved for each fragment of the bin: the loaded index at its widest entry type, the
+     *        deduplicated index with room for split entries and the sort records. Build::estimateOptimumFragmentsPerBin
+     *        uses the same figure.
+     */
+    static std::size_t getFragmentIndexMemoryRequirements()
+    {
+        return std::max(sizeof(SeFragmentIndex), std::max(sizeof(RStrandOrShadowFragmentIndex), sizeof(FStrandFragmentIndex))) +
+            INDEX_ELEMENTS_PER_FRAGMENT * sizeof(PackedFragmentBuffer::CompactIndex) +
+            2 * sizeof(common::RadixSortRecord);
+    }
+
+    /**
+     * \brief keys and buffer for radix-sorting the duplicate filtering indexes and the bam index, with some room
+     *        for the entries produced by splitting the reads.
+     */
+    static uint64_t getSortRecordsCount(const alignment::BinMetadata& bin)
+    {
+        return (bin.getTotalElements() + bin.getTotalSplitCount()) * 2;
     }
 
     void unreserveIndexes()
@@ -157,13 +189,14 @@ public:
     SeIdx seIdx_;
     RIdx rIdx_;
     FIdx fIdx_;
+    common::RadixSortRecords sortRecords_;
     PackedFragmentBuffer data_;
     const GapRealignerMode realignGaps_;
     const gapRealigner::Gaps &knownIndels_;
     alignment::Cigar additionalCigars_;
     std::vector<gapRealigner::RealignerGaps> realignerGaps_;
     alignment::BinDataDistribution dataDistribution_;
-    std::filebuf inputFileBuf_;
+    io::ReadAheadFileBuf inputFileBuf_;
     FragmentAccessorBamAdapter bamAdapter_;
 
 private:
@@ -0,0 +1,126 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BinQueue.hh
+ **
+ ** Hand over of the bins from alignment to Build when the two run at the same time.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BUILD_BIN_QUEUE_HH
+#define iSAAC_BUILD_BIN_QUEUE_HH
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "alignment/BinMetadata.hh"
+#include "flowcell/TileMetadata.hh"
+
+namespace isaac
+{
+namespace build
+{
+
+/**
+ * \brief Alignment seals the bins as the lanes storing into them are done. Build takes any sealed aligned bin
+ *        that fits the memory budget. The bins sealed together go in the order of their indexes, the unaligned
+ *        bins go last. Alignment and Build take their memory from the same budget.
+ */
+class BinQueue: boost::noncopyable
+{
+public:
+    explicit BinQueue(const uint64_t memoryBudget);
+
+    /**
+     * \brief bins is the final list of bins. Their metadata is valid only once they are sealed.
+     */
+    void open(const alignment::BinMetadataList &bins);
+
+    /**
+     * \param tiles tiles processed so far. Fragments of the sealed bins come from these tiles only.
+     */
+    void seal(const std::vector<unsigned> &binIndexes, const flowcell::TileMetadataList &tiles);
+
+    /**
+     * \brief Alignment is done. All bins are sealed and the tile metadata is final.
+     */
+    void close(const flowcell::TileMetadataList &tiles);
+
+    /**
+     * \brief Alignment has failed. Build fails as soon as it waits for anything.
+     */
+    void terminate() noexcept;
+
+    const alignment::BinMetadataList &waitOpen();
+
+    /**
+     * \brief Blocks until a sealed bin fits the budget. The memory is not reserved. A bin too big for the budget
+     *        goes when nothing else is reserved.
+     *
+     * \param getBinMemory memory the bin will take once Build reserves it
+     *
+     * \return the next bin, 0 when all bins have been taken
+     */
+    const alignment::BinMetadata *pop(const boost::function<uint64_t(const alignment::BinMetadata &)> &getBinMemory);
+
+    /**
+     * \return the tiles the bin was sealed with
+     */
+    const flowcell::TileMetadataList &getTiles(const alignment::BinMetadata &bin) const;
+
+    void waitClosed();
+
+    /**
+     * \brief Never blocks. Bins held by Build don't get released before alignment is done.
+     */
+    void reserveAlignmentMemory(const uint64_t bytes);
+
+    /**
+     * \brief Blocks until the bin fits the budget. A bin too big for the budget goes when nothing else is reserved.
+     */
+    void reserveBinMemory(const uint64_t bytes);
+
+    void releaseMemory(const uint64_t bytes);
+
+private:
+    const uint64_t memoryBudget_;
+    uint64_t reservedMemory_;
+    const alignment::BinMetadataList *bins_;
+    // tiles snapshot of each sealed bin. Bins sealed in the same call share it
+    std::vector<boost::shared_ptr<const flowcell::TileMetadataList> > tiles_;
+    // seal call that sealed the bin, 0 for bins not sealed yet
+    std::vector<unsigned> batches_;
+    unsigned lastBatch_;
+    std::vector<bool> taken_;
+    // aligned bins in the order of indexes followed by the unaligned bins
+    std::vector<unsigned> order_;
+    std::size_t takenBins_;
+    bool closed_;
+    bool terminated_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+
+    void checkTerminated() const;
+    void sealBins(const std::vector<unsigned> &binIndexes, const flowcell::TileMetadataList &tiles);
+    bool fitsBudget(const uint64_t bytes) const;
+    const alignment::BinMetadata *findNextBin(
+        const boost::function<uint64_t(const alignment::BinMetadata &)> &getBinMemory) const;
+};
+
+} // namespace build
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BUILD_BIN_QUEUE_HH
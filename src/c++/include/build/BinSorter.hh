@@ -34,8 +34,10 @@
 #include "build/DuplicatePairEndFilter.hh"
 #include "build/FragmentIndex.hh"
 #include "build/GapRealigner.hh"
+#include "build/HashDuplicatePairEndFilter.hh"
 #include "build/NotAFilter.hh"
 #include "build/ParallelGapRealigner.hh"
+#include "common/ParallelFor.hh"
 #include "flowcell/TileMetadata.hh"
 #include "io/FileBufCache.hh"
 #include "io/WigLoader.hh"
@@ -54,6 +56,7 @@ public:
         const bool keepDuplicates,
         const bool markDuplicates,
         const bool anchorMate,
+        const DuplicateGroupingMode duplicateGrouping,
         const BarcodeBamMapping &barcodeBamMapping,
         const flowcell::BarcodeMetadataList &barcodeMetadataList,
         const isaac::reference::NumaContigLists &contigLists,
@@ -63,6 +66,7 @@ public:
             keepDuplicates_(keepDuplicates),
             markDuplicates_(markDuplicates),
             anchorMate_(anchorMate),
+            duplicateGrouping_(duplicateGrouping),
             barcodeMetadataList_(barcodeMetadataList),
             contigLists_(contigLists),
             bamSerializer_(barcodeBamMapping.getSampleIndexMap(), splitGapLength),
@@ -70,13 +74,17 @@ public:
     {
     }
 
+    /**
+     * \param parallelFor runs the parts of duplicate resolution that can use more than one thread
+     */
     void resolveDuplicates(
         BinData &binData,
-        BuildStats &buildStats);
+        BuildStats &buildStats,
+        common::ParallelFor &parallelFor);
 
     std::size_t serialize(
         BinData &binData,
-        boost::ptr_vector<boost::iostreams::filtering_ostream> &bgzfStreams,
+        boost::ptr_vector<bam::BamEncoder> &bamEncoders,
         boost::ptr_vector<bam::BamIndexPart> &bamIndexParts);
 
 private:
@@ -84,6 +92,7 @@ private:
     const bool keepDuplicates_;
     const bool markDuplicates_;
     const bool anchorMate_;
+    const DuplicateGroupingMode duplicateGrouping_;
     const flowcell::BarcodeMetadataList &barcodeMetadataList_;
     const reference::NumaContigLists &contigLists_;
     BamSerializer bamSerializer_;
@@ -91,6 +100,14 @@ private:
 
     typedef boost::iterator_range<const unsigned char *> AnchorRange;
 
+    template <typename FilterT, typename IndexT>
+    void filterDuplicates(
+        const FilterT &filter,
+        IndexT &index,
+        BinData &binData,
+        BuildStats &buildStats,
+        common::ParallelFor &parallelFor);
+
     template <typename BclIteratorT>
     bool isAnchored(
         const isaac::reference::ContigList &reference,
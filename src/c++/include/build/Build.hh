@@ -27,14 +27,20 @@
 
 #include "alignment/BinMetadata.hh"
 #include "alignment/TemplateLengthStatistics.hh"
+#include "bam/BamEncoder.hh"
+#include "bam/BgzfBlockPool.hh"
+#include "bgzf/BgzfDeflater.hh"
 #include "build/BarcodeBamMapping.hh"
+#include "build/BinQueue.hh"
 #include "build/BinSorter.hh"
 #include "build/BuildStats.hh"
 #include "build/BuildContigMap.hh"
+#include "common/ParallelFor.hh"
 #include "common/Threads.hpp"
 #include "flowcell/BarcodeMetadata.hh"
 #include "flowcell/Layout.hh"
 #include "flowcell/TileMetadata.hh"
+#include "io/AsyncFileIo.hh"
 #include "io/FileSinkWithMd5.hh"
 #include "reference/ReferenceMetadata.hh"
 #include "reference/SortedReferenceMetadata.hh"
@@ -45,15 +51,23 @@ namespace isaac
 namespace build
 {
 
+BarcodeBamMapping mapBarcodesToFiles(
+    const boost::filesystem::path &outputDirectory,
+    const flowcell::BarcodeMetadataList &barcodeMetadataList);
+
 class Build
 {
+    // enough to keep the compute threads busy while the serializing thread fills more blocks
+    static const unsigned BGZF_BLOCKS_PER_COMPUTER = 4;
+
     const std::vector<std::string> &argv_;
     const std::string &description_;
     const flowcell::FlowcellLayoutList &flowcellLayoutList_;
     const flowcell::TileMetadataList &tileMetadataList_;
     const flowcell::BarcodeMetadataList &barcodeMetadataList_;
     alignment::BinMetadataList unalignedBinParts_;
-    const alignment::BinMetadataCRefList bins_;
+    // grows as the bins come out of binQueue_ when Build runs alongside alignment
+    alignment::BinMetadataCRefList bins_;
     const reference::SortedReferenceMetadataList &sortedReferenceMetadataList_;
     const BuildContigMap contigMap_;
     const boost::filesystem::path outputDirectory_;
@@ -73,6 +87,7 @@ class Build
     const bool keepDuplicates_;
     const bool markDuplicates_;
     const bool anchorMate_;
+    const DuplicateGroupingMode duplicateGrouping_;
     const bool realignGapsVigorously_;
     const bool realignDodgyFragments_;
     const unsigned realignedGapsPerFragment_;
@@ -83,12 +98,26 @@ class Build
     const IncludeTags includeTags_;
     const bool pessimisticMapQ_;
     const unsigned splitGapLength_;
+    // 0 unless the bins are taken from alignment as they get sealed
+    BinQueue *const binQueue_;
+    const std::string binRegexString_;
+    const bool keepUnaligned_;
+    // number of parts to break the unaligned bin into
+    const unsigned computeThreads_;
 
     boost::mutex stateMutex_;
     boost::condition_variable stateChangedCondition_;
     bool forceTermination_;
+    // a thread is waiting for binQueue_ to give out the next bin
+    bool binQueueWaiting_;
+    // binQueue_ has no more aligned bins to give out
+    bool alignedBinsQueued_;
+    // the unaligned bin gets broken up and processed once the aligned bins are done
+    const alignment::BinMetadata *unalignedBin_;
 
     common::ThreadVector threads_;
+    // bin data reads of all loader threads
+    io::AsyncFileIo asyncIo_;
 
     const reference::NumaContigLists &contigLists_;
 
@@ -99,13 +128,19 @@ class Build
     std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > bamFileStreams_;
 
     BuildStats stats_;
+    // [thread] binQueue_ memory held by the bin of the thread
+    std::vector<uint64_t> threadReservedMemory_;
 
     //[thread][bam file][byte]
     typedef std::vector<bam::BgzfBuffer> BgzfBuffers;
     typedef std::vector<BgzfBuffers> ThreadBgzfBuffers;
     ThreadBgzfBuffers threadBgzfBuffers_;
-    // Geometry: [thread][bam file]. Streams for compressing bam data into threadBgzfBuffers_
-    boost::ptr_vector<boost::ptr_vector<boost::iostreams::filtering_ostream> > threadBgzfStreams_;
+    // blocks of the bins being serialized, compressed by the threads that have nothing better to do
+    bam::BgzfBlockPool bgzfBlockPool_;
+    // one per thread, used by whatever compression the thread does
+    boost::ptr_vector<bgzf::BgzfDeflater> threadDeflaters_;
+    // Geometry: [thread][bam file]. Encoders compressing bam data into threadBgzfBuffers_
+    boost::ptr_vector<boost::ptr_vector<bam::BamEncoder> > threadBamEncoders_;
     boost::ptr_vector<boost::ptr_vector<bam::BamIndexPart> > threadBamIndexParts_;
 
     const build::gapRealigner::Gaps knownIndels_;
@@ -148,6 +183,7 @@ public:
           const build::GapRealignerMode realignGaps,
           const boost::filesystem::path &knownIndelsPath,
           const int bamGzipLevel,
+          const bgzf::DeflateBackend bamDeflateBackend,
           const std::string &bamPuFormat,
           const bool bamProduceMd5,
           const std::vector<std::string> &bamHeaderTags,
@@ -156,6 +192,7 @@ public:
           const bool keepDuplicates,
           const bool markDuplicates,
           const bool anchorMate,
+          const DuplicateGroupingMode duplicateGrouping,
           const bool realignGapsVigorously,
           const bool realignDodgyFragments,
           const unsigned realignedGapsPerFragment,
@@ -167,7 +204,8 @@ public:
           const bool putUnalignedInTheBack,
           const IncludeTags includeTags,
           const bool pessimisticMapQ,
-          const unsigned splitGapLength);
+          const unsigned splitGapLength,
+          BinQueue *binQueue);
 
     void run(common::ScopedMallocBlock &mallocBlock);
 
@@ -179,6 +217,16 @@ public:
         const double expectedBgzfCompressionRatio,
         const unsigned computeThreads);
 
+    /**
+     * \brief Bam encoder blocks of each thread and output file and the bgzf block pool. Allocated by the
+     *        constructor, so they are not part of the bin memory.
+     */
+    static uint64_t getBuffersMemoryRequirements(
+        const unsigned maxLoaders,
+        const unsigned maxComputers,
+        const unsigned maxSavers,
+        const unsigned outputFiles);
+
     const BarcodeBamMapping &getBarcodeBamMapping() const {return barcodeBamMapping_;}
 private:
     std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> >  createOutputFileStreams(
@@ -186,6 +234,17 @@ private:
         const flowcell::BarcodeMetadataList &barcodeMetadataList,
         boost::ptr_vector<bam::BamIndex> &bamIndexes) const;
 
+    void openOutputFiles();
+    void waitAlignmentDone(boost::unique_lock<boost::mutex> &lock);
+    void terminateOnFailure(const bool exceptionUnwinding);
+
+    bool waitForBin(
+        boost::unique_lock<boost::mutex> &lock,
+        const alignment::BinMetadataCRefList::const_iterator nextUnprocessedBinIt,
+        const std::size_t threadNumber);
+
+    void returnBinQueue(const bool exceptionUnwinding);
+
     void reserveBuffers(
         boost::unique_lock<boost::mutex> &lock,
         const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
@@ -198,7 +257,6 @@ private:
         const alignment::BinMetadata &bin,
         const unsigned binStatsIndex,
         const reference::ContigLists &contigLists,
-        boost::ptr_vector<boost::iostreams::filtering_ostream> &bgzfStreams,
         boost::ptr_vector<bam::BamIndexPart> &bamIndexParts,
         BgzfBuffers &bgzfBuffers,
         boost::shared_ptr<BinData> &binDataPtr);
@@ -246,6 +304,28 @@ private:
         const unsigned threadNumber);
 
     void returnComputeSlot(const bool exceptionUnwinding);
+    void waitForComputeSlot(boost::unique_lock<boost::mutex> &lock);
+    void compressBgzfBlocks(boost::unique_lock<boost::mutex> &lock, const bool &serialized, const unsigned threadNumber);
+
+    /**
+     * \brief Runs the blocks as a compute slot task. The caller must be running unlocked on a compute slot.
+     */
+    class ComputeSlotFor : public common::ParallelFor
+    {
+        Build &build_;
+        boost::unique_lock<boost::mutex> &lock_;
+        const std::size_t priority_;
+        const unsigned threadNumber_;
+    public:
+        ComputeSlotFor(
+            Build &build,
+            boost::unique_lock<boost::mutex> &lock,
+            const std::size_t priority,
+            const unsigned threadNumber) :
+                build_(build), lock_(lock), priority_(priority), threadNumber_(threadNumber){}
+    protected:
+        virtual void run(const std::size_t count, const std::size_t blockSize, Executor &executor);
+    };
 
     void waitForSaveSlot(
         boost::unique_lock<boost::mutex> &lock,
@@ -280,6 +360,8 @@ private:
         const alignment::BinMetadata & binMetadata,
         const unsigned outputFileIndex) const;
 
+    uint64_t estimateBinMemoryRequirements(const alignment::BinMetadata & binMetadata) const;
+
     bool executePreemptTask(
         boost::unique_lock<boost::mutex>& lock,
         Task& task,
@@ -287,7 +369,6 @@ private:
 
     void cleanupBinAllocationFailure(
         const alignment::BinMetadata& bin,
-        boost::ptr_vector<boost::iostreams::filtering_ostream>& bgzfStreams,
         boost::ptr_vector<bam::BamIndexPart>& bamIndexParts,
         boost::shared_ptr<BinData>& binDataPtr, BgzfBuffers& bgzfBuffers);
 };
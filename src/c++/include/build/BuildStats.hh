@@ -69,6 +69,14 @@ public:
     {
     }
 
+    /**
+     * \brief Makes room for the bins added after construction
+     */
+    void resize(const std::size_t bins)
+    {
+        binBarcodeStats_.resize(barcodeMetadataList_.size() * bins);
+    }
+
     void incrementTotalFragments(
         const unsigned binIndex,
         const unsigned barcodeIndex)
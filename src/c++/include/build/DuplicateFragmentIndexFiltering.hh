@@ -28,6 +28,36 @@ namespace isaac
 namespace build
 {
 
+/**
+ * \brief The fields on which less orders first and which equal_to requires to match. Fragments with different
+ *        signatures are never duplicates of each other.
+ */
+struct DuplicateSignature
+{
+    DuplicateSignature(const uint64_t key, const uint64_t mateAnchor, const unsigned mateInfo, const uint64_t library) :
+        key_(key), mateAnchor_(mateAnchor), mateInfo_(mateInfo), library_(library){}
+    uint64_t key_;
+    uint64_t mateAnchor_;
+    unsigned mateInfo_;
+    uint64_t library_;
+
+    bool operator ==(const DuplicateSignature &that) const
+    {
+        return key_ == that.key_ && mateAnchor_ == that.mateAnchor_ && mateInfo_ == that.mateInfo_ && library_ == that.library_;
+    }
+
+    uint64_t hash() const
+    {
+        // fmix64 from MurmurHash3. Positions differ mostly in the low bits, so everything needs to be mixed well
+        uint64_t h = key_;
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdUL + mateAnchor_;
+        h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53UL + ((library_ << 32) | mateInfo_);
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdUL;
+        h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53UL;
+        return h ^ (h >> 33);
+    }
+};
+
 /**
  * \brief Order and compares reads to identify duplicates.
  *
@@ -40,6 +70,15 @@ struct FDuplicateFilter
     const BarcodeBamMapping::BarcodeSampleIndexMap &barcodeSampleIndex_;
     FDuplicateFilter(const BarcodeBamMapping::BarcodeSampleIndexMap &barcodeSampleIndex):
         barcodeSampleIndex_(barcodeSampleIndex){}
+    /// less orders by this first
+    uint64_t key(const FStrandFragmentIndex &index) const {return index.fStrandPos_.getValue();}
+    DuplicateSignature signature(const PackedFragmentBuffer &fragments, const FStrandFragmentIndex &index) const
+    {
+        const io::FragmentAccessor &fragment = fragments.getFragment(index);
+        return DuplicateSignature(
+            key(index), index.mate_.anchor_.value_, index.mate_.info_.value_,
+            singleLibrarySamples ? barcodeSampleIndex_.at(fragment.barcode_) : fragment.barcode_);
+    }
     bool less(const PackedFragmentBuffer &fragments,
                      const FStrandFragmentIndex &left,
                      const FStrandFragmentIndex &right) const
@@ -122,6 +161,15 @@ struct RSDuplicateFilter
     const BarcodeBamMapping::BarcodeSampleIndexMap &barcodeSampleIndex_;
     RSDuplicateFilter(const BarcodeBamMapping::BarcodeSampleIndexMap &barcodeSampleIndex):
         barcodeSampleIndex_(barcodeSampleIndex){}
+    /// less orders by this first
+    uint64_t key(const RStrandOrShadowFragmentIndex &index) const {return index.anchor_.value_;}
+    DuplicateSignature signature(const PackedFragmentBuffer &fragments, const RStrandOrShadowFragmentIndex &index) const
+    {
+        const io::FragmentAccessor &fragment = fragments.getFragment(index);
+        return DuplicateSignature(
+            key(index), index.mate_.anchor_.value_, index.mate_.info_.value_,
+            singleLibrarySamples ? barcodeSampleIndex_.at(fragment.barcode_) : fragment.barcode_);
+    }
     bool less(const PackedFragmentBuffer &fragments,
                      const RStrandOrShadowFragmentIndex &left,
                      const RStrandOrShadowFragmentIndex &right) const
@@ -20,10 +20,14 @@
 #ifndef iSAAC_BUILD_DUPLICATE_PAIR_END_FILTER_HH
 #define iSAAC_BUILD_DUPLICATE_PAIR_END_FILTER_HH
 
+#include <boost/iterator/permutation_iterator.hpp>
+#include <boost/iterator/transform_iterator.hpp>
+
 #include "build/BuildStats.hh"
 #include "build/FragmentIndex.hh"
 #include "build/PackedFragmentBuffer.hh"
 #include "common/Debug.hh"
+#include "common/RadixSort.hpp"
 
 namespace isaac
 {
@@ -40,7 +44,13 @@ namespace build
 class DuplicatePairEndFilter
 {
 public:
-    DuplicatePairEndFilter(const bool keepDuplicates) : keepDuplicates_(keepDuplicates){}
+    DuplicatePairEndFilter(const bool keepDuplicates) : keepDuplicates_(keepDuplicates), sortRecords_(0){}
+    /**
+     * \param sortRecords  when big enough, the ranking is done by radix sort on FilterT::key with FilterT::less
+     *                     resolving the equal keys only.
+     */
+    DuplicatePairEndFilter(const bool keepDuplicates, common::RadixSortRecords &sortRecords) :
+        keepDuplicates_(keepDuplicates), sortRecords_(&sortRecords){}
     template <typename FilterT, typename InputIteratorT, typename InsertIteratorT>
     void filterInput(
         const FilterT& filter,
@@ -57,58 +67,95 @@ public:
             ISAAC_THREAD_CERR << "Sorting duplicates" << std::endl;
             const clock_t startSort = clock();
 
-            std::sort(duplicatesBegin, duplicatesEnd,
-                      boost::bind(&FilterT::less, &filter,
-                                  boost::ref(fragments), _1, _2));
+            if (sortRecords_ && sortRecords_->capacity() >= std::size_t(std::distance(duplicatesBegin, duplicatesEnd)) * 2)
+            {
+                const common::RadixSortRecord *recordsEnd = common::sortRecords(
+                    duplicatesBegin, duplicatesEnd,
+                    boost::bind(&FilterT::key, &filter, _1),
+                    boost::bind(&FilterT::less, &filter, boost::ref(fragments), _1, _2),
+                    *sortRecords_);
+                ISAAC_THREAD_CERR << "Sorting duplicates" << " done in " << (clock() - startSort) / 1000 << "ms" << std::endl;
+
+                // the index entries are not needed after filtering. Visit them in the order of the records instead of moving them around.
+                const common::RadixSortRecord *recordsBegin = &sortRecords_->front();
+                filterSorted(
+                    filter, fragments,
+                    boost::make_permutation_iterator(duplicatesBegin, boost::make_transform_iterator(recordsBegin, &common::getRadixSortRecordOffset)),
+                    boost::make_permutation_iterator(duplicatesBegin, boost::make_transform_iterator(recordsEnd, &common::getRadixSortRecordOffset)),
+                    buildStats, binIndex, results);
+                sortRecords_->clear();
+            }
+            else
+            {
+                std::sort(duplicatesBegin, duplicatesEnd,
+                          boost::bind(&FilterT::less, &filter,
+                                      boost::ref(fragments), _1, _2));
+                ISAAC_THREAD_CERR << "Sorting duplicates" << " done in " << (clock() - startSort) / 1000 << "ms" << std::endl;
 
-            ISAAC_THREAD_CERR << "Sorting duplicates" << " done in " << (clock() - startSort) / 1000 << "ms" << std::endl;
+                filterSorted(filter, fragments, duplicatesBegin, duplicatesEnd, buildStats, binIndex, results);
+            }
+        }
+    }
+private:
+    /**
+     * \brief populates results with the unique fragments of a range ordered by the duplicate ranking
+     */
+    template <typename FilterT, typename SortedIteratorT, typename InsertIteratorT>
+    void filterSorted(
+        const FilterT& filter,
+        PackedFragmentBuffer &fragments,
+        SortedIteratorT sortedBegin,
+        SortedIteratorT sortedEnd,
+        BuildStats &buildStats,
+        const unsigned binIndex,
+        InsertIteratorT results)
+    {
+        // populate self with the unique fragments
+        ISAAC_THREAD_CERR << "Filtering duplicates" << std::endl;
+        const clock_t startFilter = clock();
 
-            // populate self with the unique fragments
-            ISAAC_THREAD_CERR << "Filtering duplicates" << std::endl;
-            const clock_t startFilter = clock();
 
+        // Range is guaranteed to be not empty
+        uint64_t unique = 1;
+        const io::FragmentAccessor &firstBestFragment = fragments.getFragment(*sortedBegin);
+        results++ = fragments.getCompactIndex(*sortedBegin, firstBestFragment);
+        ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(firstBestFragment.clusterId_, "Selected as the first duplicate best: " << *sortedBegin  << ":" << firstBestFragment);
+        for (SortedIteratorT it(sortedBegin + 1), itLast(sortedBegin); sortedEnd != it; ++it)
+        {
+            io::FragmentAccessor &fragment = fragments.getFragment(*it);
+            ISAAC_DEV_TRACE_BLOCK(const io::FragmentAccessor &lastFragment = fragments.getFragment(*itLast);)
 
-            // Range is guaranteed to be not empty
-            uint64_t unique = 1;
-            const io::FragmentAccessor &firstBestFragment = fragments.getFragment(*duplicatesBegin);
-            results++ = PackedFragmentBuffer::Index(*duplicatesBegin, firstBestFragment);
-            ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(firstBestFragment.clusterId_, "Selected as the first duplicate best: " << *duplicatesBegin  << ":" << firstBestFragment);
-            for (InputIteratorT it(duplicatesBegin + 1), itLast(duplicatesBegin); duplicatesEnd != it; ++it)
+            if (!filter.equal_to(fragments, *itLast, *it))
             {
-                io::FragmentAccessor &fragment = fragments.getFragment(*it);
-                ISAAC_DEV_TRACE_BLOCK(const io::FragmentAccessor &lastFragment = fragments.getFragment(*itLast);)
-
-                if (!filter.equal_to(fragments, *itLast, *it))
-                {
-                    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Selected as a duplicate best:         " << *it << ":" << fragment);
-                    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Selected as a duplicate best prev:    " << *itLast << ":" << fragments.getFragment(*itLast));
-                    results++ = PackedFragmentBuffer::Index(*it, fragment);
-                    unique++;
-                    itLast = it;
-                    buildStats.incrementUniqueFragments(binIndex, fragment.barcode_);
-                }
-                else if (keepDuplicates_)
-                {
-                    fragment.flags_.duplicate_ = true;
-                    results++ = PackedFragmentBuffer::Index(*it, fragment);
-                    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Marked as a duplicate of:             " << lastFragment << ":" << *it << ":" << fragment);
-                    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(lastFragment.clusterId_, "Marked as a duplicate of:             " << lastFragment << ":" << *it << ":" << fragment);
-                }
-                else
-                {
-                    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Discarded as a duplicate of:          " << lastFragment << ":" << *it << ":" << fragment);
-                    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(lastFragment.clusterId_, "Discarded as a duplicate of:          " << lastFragment << ":" << *it << ":" << fragment);
-                }
-                buildStats.incrementTotalFragments(binIndex, fragments.getFragment(*it).barcode_);
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Selected as a duplicate best:         " << *it << ":" << fragment);
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Selected as a duplicate best prev:    " << *itLast << ":" << fragments.getFragment(*itLast));
+                results++ = fragments.getCompactIndex(*it, fragment);
+                unique++;
+                itLast = it;
+                buildStats.incrementUniqueFragments(binIndex, fragment.barcode_);
             }
-
-            ISAAC_THREAD_CERR << "Filtering duplicates"
-                << " done in " << (clock() - startFilter) / 1000 << "ms. found " << unique
-                << " unique out of " << duplicatesEnd - duplicatesBegin << " fragments" << std::endl;
+            else if (keepDuplicates_)
+            {
+                fragment.flags_.duplicate_ = true;
+                results++ = fragments.getCompactIndex(*it, fragment);
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Marked as a duplicate of:             " << lastFragment << ":" << *it << ":" << fragment);
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(lastFragment.clusterId_, "Marked as a duplicate of:             " << lastFragment << ":" << *it << ":" << fragment);
+            }
+            else
+            {
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Discarded as a duplicate of:          " << lastFragment << ":" << *it << ":" << fragment);
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(lastFragment.clusterId_, "Discarded as a duplicate of:          " << lastFragment << ":" << *it << ":" << fragment);
+            }
+            buildStats.incrementTotalFragments(binIndex, fragments.getFragment(*it).barcode_);
         }
+
+        ISAAC_THREAD_CERR << "Filtering duplicates"
+            << " done in " << (clock() - startFilter) / 1000 << "ms. found " << unique
+            << " unique out of " << sortedEnd - sortedBegin << " fragments" << std::endl;
     }
-private:
+
     const bool keepDuplicates_;
+    common::RadixSortRecords *sortRecords_;
 };
 
 
@@ -0,0 +1,261 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file HashDuplicatePairEndFilter.hh
+ **
+ ** Duplicate detection by grouping the fragments on their duplicate signature hash.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BUILD_HASH_DUPLICATE_PAIR_END_FILTER_HH
+#define iSAAC_BUILD_HASH_DUPLICATE_PAIR_END_FILTER_HH
+
+#include "build/BuildStats.hh"
+#include "build/DuplicateFragmentIndexFiltering.hh"
+#include "build/PackedFragmentBuffer.hh"
+#include "common/Debug.hh"
+#include "common/ParallelFor.hh"
+#include "common/RadixSort.hpp"
+
+namespace isaac
+{
+namespace build
+{
+
+enum DuplicateGroupingMode
+{
+    /// sort candidates by FilterT::less and compare the neighbours
+    GROUP_DUPLICATES_BY_SORT,
+    /// hash candidates on FilterT::signature
+    GROUP_DUPLICATES_BY_HASH
+};
+
+/**
+ * \brief Selects the same fragments, flags the same duplicates and counts the same stats as DuplicatePairEndFilter
+ *        without ordering the whole range. Fragments are chained into hash buckets by their DuplicateSignature.
+ *        Each group of equal signatures is resolved on its own, so FilterT::less only gets to compare
+ *        the fragments that are duplicates of each other. Results are produced in the input order.
+ *
+ *        The records keep a (signature hash, next in bucket) entry for each fragment followed by the bucket
+ *        heads. Buckets are resolved concurrently by parallelFor. Does not allocate memory.
+ **/
+class HashDuplicatePairEndFilter
+{
+    static const uint64_t NO_ENTRY = -1UL;
+    // decisions replace the hashes once the group of the fragment is resolved
+    static const uint64_t BEST_OF_GROUP = 0;
+    static const uint64_t UNIQUE = 1;
+    static const uint64_t DUPLICATE = 2;
+
+    static const std::size_t HASH_BLOCK = 64 * 1024;
+    static const std::size_t BUCKETS_BLOCK = 16 * 1024;
+
+public:
+    HashDuplicatePairEndFilter(const bool keepDuplicates, common::RadixSortRecords &records) :
+        keepDuplicates_(keepDuplicates), records_(records){}
+
+    /**
+     * \return false if the records don't have enough capacity to group the range. Nothing is done in this case.
+     */
+    template <typename FilterT, typename RandomAccessIteratorT, typename InsertIteratorT>
+    bool filterInput(
+        const FilterT& filter,
+        PackedFragmentBuffer &fragments,
+        RandomAccessIteratorT duplicatesBegin,
+        RandomAccessIteratorT duplicatesEnd,
+        BuildStats &buildStats,
+        const unsigned binIndex,
+        InsertIteratorT results,
+        common::ParallelFor &parallelFor)
+    {
+        const std::size_t size = std::distance(duplicatesBegin, duplicatesEnd);
+        if (!size)
+        {
+            return true;
+        }
+        if (records_.capacity() < size * 2)
+        {
+            return false;
+        }
+
+        std::size_t buckets = 1;
+        while (buckets * 2 <= size)
+        {
+            buckets *= 2;
+        }
+        records_.resize(size + buckets);
+        common::RadixSortRecord *entries = &records_.front();
+        common::RadixSortRecord *heads = entries + size;
+
+        ISAAC_THREAD_CERR << "Grouping duplicates" << std::endl;
+        const clock_t startGroup = clock();
+
+        parallelFor(size, HASH_BLOCK,
+            [&](const std::size_t begin, const std::size_t end)
+            {
+                for (std::size_t i = begin; end != i; ++i)
+                {
+                    entries[i] = common::RadixSortRecord(filter.signature(fragments, duplicatesBegin[i]).hash(), NO_ENTRY);
+                }
+            });
+
+        std::fill(heads, heads + buckets, common::RadixSortRecord(0, NO_ENTRY));
+        // backwards so that each chain lists the fragments in the input order
+        for (std::size_t i = size; i; --i)
+        {
+            common::RadixSortRecord &head = heads[entries[i - 1].key_ & (buckets - 1)];
+            entries[i - 1].offset_ = head.offset_;
+            head.offset_ = i - 1;
+        }
+
+        parallelFor(buckets, BUCKETS_BLOCK,
+            [&](const std::size_t begin, const std::size_t end)
+            {
+                for (std::size_t bucket = begin; end != bucket; ++bucket)
+                {
+                    resolveBucket(filter, fragments, duplicatesBegin, entries, heads[bucket]);
+                }
+            });
+
+        ISAAC_THREAD_CERR << "Grouping duplicates" << " done in " << (clock() - startGroup) / 1000 << "ms" << std::endl;
+
+        storeResults(filter, fragments, duplicatesBegin, entries, size, buildStats, binIndex, results);
+
+        records_.clear();
+        return true;
+    }
+
+private:
+    const bool keepDuplicates_;
+    common::RadixSortRecords &records_;
+
+    /**
+     * \brief Takes the groups of equal signatures out of the bucket chain one by one, starting from the one that
+     *        has the earliest fragment. Within a group, the fragment DuplicatePairEndFilter would have seen first is
+     *        the best. The rest are duplicates unless equal_to says otherwise.
+     */
+    template <typename FilterT, typename RandomAccessIteratorT>
+    void resolveBucket(
+        const FilterT& filter,
+        const PackedFragmentBuffer &fragments,
+        RandomAccessIteratorT duplicates,
+        common::RadixSortRecord *entries,
+        common::RadixSortRecord &head) const
+    {
+        while (NO_ENTRY != head.offset_)
+        {
+            const std::size_t first = head.offset_;
+            head.offset_ = entries[first].offset_;
+            const uint64_t hash = entries[first].key_;
+            const DuplicateSignature signature = filter.signature(fragments, duplicates[first]);
+
+            // unlink the rest of the group and thread it through the freed links
+            std::size_t last = first;
+            entries[first].offset_ = NO_ENTRY;
+            for (uint64_t *link = &head.offset_; NO_ENTRY != *link;)
+            {
+                const std::size_t current = *link;
+                if (hash == entries[current].key_ && signature == filter.signature(fragments, duplicates[current]))
+                {
+                    *link = entries[current].offset_;
+                    entries[current].offset_ = NO_ENTRY;
+                    entries[last].offset_ = current;
+                    last = current;
+                }
+                else
+                {
+                    link = &entries[current].offset_;
+                }
+            }
+
+            std::size_t best = first;
+            for (std::size_t member = entries[first].offset_; NO_ENTRY != member; member = entries[member].offset_)
+            {
+                if (filter.less(fragments, duplicates[member], duplicates[best]))
+                {
+                    best = member;
+                }
+            }
+
+            for (std::size_t member = first; NO_ENTRY != member; member = entries[member].offset_)
+            {
+                entries[member].key_ =
+                    best == member ? BEST_OF_GROUP :
+                        filter.equal_to(fragments, duplicates[best], duplicates[member]) ? DUPLICATE : UNIQUE;
+            }
+        }
+    }
+
+    /**
+     * \brief The sort-based filter does not count the fragment that comes first in FilterT::less order. This
+     *        is the best of the group with the lowest signature. Keep the stats identical.
+     */
+    template <typename FilterT, typename RandomAccessIteratorT, typename InsertIteratorT>
+    void storeResults(
+        const FilterT& filter,
+        PackedFragmentBuffer &fragments,
+        RandomAccessIteratorT duplicates,
+        const common::RadixSortRecord *entries,
+        const std::size_t size,
+        BuildStats &buildStats,
+        const unsigned binIndex,
+        InsertIteratorT results) const
+    {
+        std::size_t uncounted = size;
+        for (std::size_t i = 0; size != i; ++i)
+        {
+            if (BEST_OF_GROUP == entries[i].key_ &&
+                (size == uncounted || filter.less(fragments, duplicates[i], duplicates[uncounted])))
+            {
+                uncounted = i;
+            }
+        }
+
+        uint64_t unique = 0;
+        for (std::size_t i = 0; size != i; ++i)
+        {
+            io::FragmentAccessor &fragment = fragments.getFragment(duplicates[i]);
+            if (DUPLICATE != entries[i].key_)
+            {
+                results++ = fragments.getCompactIndex(duplicates[i], fragment);
+                ++unique;
+                if (uncounted != i)
+                {
+                    buildStats.incrementUniqueFragments(binIndex, fragment.barcode_);
+                }
+            }
+            else if (keepDuplicates_)
+            {
+                fragment.flags_.duplicate_ = true;
+                results++ = fragments.getCompactIndex(duplicates[i], fragment);
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Marked as a duplicate: " << duplicates[i] << ":" << fragment);
+            }
+            else
+            {
+                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Discarded as a duplicate: " << duplicates[i] << ":" << fragment);
+            }
+
+            if (uncounted != i)
+            {
+                buildStats.incrementTotalFragments(binIndex, fragment.barcode_);
+            }
+        }
+
+        ISAAC_THREAD_CERR << "Filtering duplicates found " << unique << " unique out of " << size << " fragments" << std::endl;
+    }
+};
+
+} // namespace build
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BUILD_HASH_DUPLICATE_PAIR_END_FILTER_HH
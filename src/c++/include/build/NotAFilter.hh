@@ -50,7 +50,7 @@ public:
             const io::FragmentAccessor &fragment = fragments.getFragment(idx);
             buildStats.incrementUniqueFragments(binIndex, fragment.barcode_);
             buildStats.incrementTotalFragments(binIndex, fragment.barcode_);
-            results++ = PackedFragmentBuffer::Index(idx, fragment);
+            results++ = fragments.getCompactIndex(idx, fragment);
         }
     }
 };
@@ -40,11 +40,11 @@ public:
         Index(
             const isaac::reference::ReferencePosition pos,
             uint64_t dataOffset,
-            uint64_t mateDataOffset_,
+            uint64_t mateDataOffset,
             const unsigned *cigarBegin,
             const unsigned *cigarEnd,
             const bool reverse):
-                pos_(pos), dataOffset_(dataOffset), mateDataOffset_(dataOffset),
+                pos_(pos), dataOffset_(dataOffset), mateDataOffset_(mateDataOffset),
                 cigarBegin_(cigarBegin), cigarEnd_(cigarEnd), reverse_(reverse)
         {}
 
@@ -96,6 +96,58 @@ public:
         bool reverse_;
     };
 
+    /**
+     * \brief The form in which BinData keeps the fragment index. The mate offset and, unless the fragment has been
+     *        realigned or split, the CIGAR are found through the fragment. Use getIndex to get the full Index.
+     *        In bins that don't fit 32 bit data offsets, dataOffset_ is the slot of the fragment in the wide offsets
+     *        of the buffer.
+     */
+    struct CompactIndex
+    {
+        /// CIGAR is the one stored in the fragment
+        static const uint32_t FRAGMENT_CIGAR = 0x7fffffff;
+        /// Fragment data offsets must stay below this
+        static const uint64_t MAX_DATA_OFFSET = 0xffffffffUL;
+
+        CompactIndex(
+            const isaac::reference::ReferencePosition pos,
+            const uint32_t dataOffset,
+            const uint32_t cigarOffset,
+            const bool reverse) :
+                pos_(pos), dataOffset_(dataOffset), cigarOffset_(cigarOffset), reverse_(reverse){}
+        CompactIndex(const FStrandFragmentIndex &idx, const io::FragmentAccessor &fragment) :
+            pos_(idx.fStrandPos_), dataOffset_(idx.dataOffset_), cigarOffset_(FRAGMENT_CIGAR), reverse_(fragment.isReverse()){}
+        CompactIndex(const RStrandOrShadowFragmentIndex &idx, const io::FragmentAccessor &fragment) :
+            pos_(idx.fStrandPos_), dataOffset_(idx.dataOffset_), cigarOffset_(FRAGMENT_CIGAR), reverse_(fragment.isReverse()){}
+        CompactIndex(const SeFragmentIndex &idx, const io::FragmentAccessor &fragment) :
+            pos_(idx.fStrandPos_), dataOffset_(idx.dataOffset_), cigarOffset_(FRAGMENT_CIGAR), reverse_(fragment.isReverse()){}
+
+        // same meaning as Index::pos_
+        isaac::reference::ReferencePosition pos_;
+        uint32_t dataOffset_;
+        // FRAGMENT_CIGAR or offset of the length that precedes the CIGAR operations in the bin CIGAR buffer
+        uint32_t cigarOffset_ : 31;
+        uint32_t reverse_ : 1;
+    };
+    BOOST_STATIC_ASSERT(16 == sizeof(CompactIndex));
+
+    /**
+     * \brief Data offsets of a fragment and its mate in a bin that does not fit 32 bit offsets. FragmentHeader
+     *        mateDataOffset_ holds the slot of the fragment in such bins.
+     */
+    struct WideOffsets
+    {
+        WideOffsets(const uint64_t dataOffset, const uint64_t mateDataOffset) :
+            dataOffset_(dataOffset), mateDataOffset_(mateDataOffset){}
+        uint64_t dataOffset_;
+        uint64_t mateDataOffset_;
+    };
+    typedef std::vector<WideOffsets, common::NumaAllocator<WideOffsets, common::numa::defaultNodeLocal> > WideOffsetsList;
+
+    PackedFragmentBuffer() : wide_(false)
+    {
+    }
+
 
     using BaseT::front;
     using BaseT::size;
@@ -117,16 +169,83 @@ public:
     void reserve(const alignment::BinMetadata& bin)
     {
         BaseT::reserve(bin.getDataSize());
+        reserveWideOffsets(bin);
+    }
+
+    /**
+     * \brief Switches between 32 bit data offsets and the wide offsets depending on the size of the bin.
+     *        Does not touch the fragment data.
+     */
+    void reserveWideOffsets(const alignment::BinMetadata& bin)
+    {
+        wide_ = needsWideOffsets(bin);
+        wideOffsets_.clear();
+        if (wide_)
+        {
+            wideOffsets_.reserve(bin.getTotalElements());
+        }
     }
 
     void unreserve()
     {
         BaseT().swap(*this);
+        WideOffsetsList().swap(wideOffsets_);
+    }
+
+    /**
+     * \return true if the bin data offsets don't fit CompactIndex::dataOffset_
+     */
+    static bool needsWideOffsets(const alignment::BinMetadata& bin)
+    {
+        return !bin.isUnalignedBin() && CompactIndex::MAX_DATA_OFFSET < bin.getDataSize();
+    }
+
+    bool hasWideOffsets() const {return wide_;}
+
+    /**
+     * \brief Makes the mate of the fragment at offset reachable for getIndex
+     */
+    void storeMateDataOffset(const uint64_t offset, const uint64_t mateOffset)
+    {
+        io::FragmentAccessor &fragment = getFragment(offset);
+        if (wide_)
+        {
+            ISAAC_ASSERT_MSG(wideOffsets_.size() < wideOffsets_.capacity(), "Wide offsets must not cause buffer reallocation");
+            fragment.mateDataOffset_ = wideOffsets_.size();
+            wideOffsets_.push_back(WideOffsets(offset, mateOffset));
+        }
+        else
+        {
+            fragment.mateDataOffset_ = mateOffset;
+        }
+    }
+
+    /**
+     * \brief Compacts an index produced by BinLoader. storeMateDataOffset must have been called for the fragment.
+     */
+    template <typename FragmentIndexT>
+    CompactIndex getCompactIndex(const FragmentIndexT &idx, const io::FragmentAccessor &fragment) const
+    {
+        CompactIndex ret(idx, fragment);
+        if (wide_)
+        {
+            ret.dataOffset_ = fragment.mateDataOffset_;
+        }
+        return ret;
     }
 
     io::FragmentAccessor &getFragment(const Index& fragmentIndex)
         {return getFragment(fragmentIndex.dataOffset_);}
 
+    io::FragmentAccessor &getFragment(const CompactIndex& fragmentIndex)
+        {return getFragment(getDataOffset(fragmentIndex));}
+
+    const io::FragmentAccessor &getFragment(const CompactIndex& fragmentIndex) const
+        {return getFragment(getDataOffset(fragmentIndex));}
+
+    uint64_t getDataOffset(const CompactIndex& fragmentIndex) const
+        {return wide_ ? wideOffsets_.at(fragmentIndex.dataOffset_).dataOffset_ : fragmentIndex.dataOffset_;}
+
     io::FragmentAccessor &getMate(const Index& fragmentIndex)
         {return getFragment(fragmentIndex.mateDataOffset_);}
 
@@ -160,10 +279,63 @@ public:
 
     static uint64_t getMemoryRequirements(const alignment::BinMetadata& bin)
     {
-        return bin.getDataSize();
+        return bin.getDataSize() + (needsWideOffsets(bin) ? bin.getTotalElements() * sizeof(WideOffsets) : 0);
+    }
+
+    /**
+     * \param cigars  the buffer the CompactIndex::cigarOffset_ refers to
+     */
+    Index getIndex(const CompactIndex &compactIndex, const alignment::Cigar &cigars) const
+    {
+        const io::FragmentAccessor &fragment = getFragment(compactIndex);
+        const uint64_t dataOffset = getDataOffset(compactIndex);
+        const uint64_t mateDataOffset =
+            wide_ ? wideOffsets_.at(compactIndex.dataOffset_).mateDataOffset_ : fragment.mateDataOffset_;
+        if (CompactIndex::FRAGMENT_CIGAR == compactIndex.cigarOffset_)
+        {
+            return Index(compactIndex.pos_, dataOffset, mateDataOffset,
+                         fragment.cigarBegin(), fragment.cigarEnd(), compactIndex.reverse_);
+        }
+        const uint32_t *cigarBegin = &cigars.at(compactIndex.cigarOffset_) + 1;
+        return Index(compactIndex.pos_, dataOffset, mateDataOffset,
+                     cigarBegin, cigarBegin + cigarBegin[-1], compactIndex.reverse_);
+    }
+
+    /**
+     * \brief Reverse of getIndex. The index CIGAR must be either the one of the fragment or the one stored by storeCigar
+     */
+    CompactIndex getCompactIndex(const Index &index, const alignment::Cigar &cigars) const
+    {
+        const io::FragmentAccessor &fragment = getFragment(index);
+        CompactIndex ret(index.pos_, wide_ ? fragment.mateDataOffset_ : index.dataOffset_,
+                         CompactIndex::FRAGMENT_CIGAR, index.reverse_);
+        if (fragment.cigarBegin() != index.cigarBegin_ || fragment.cigarEnd() != index.cigarEnd_)
+        {
+            ISAAC_ASSERT_MSG(!cigars.empty() && &cigars.front() < index.cigarBegin_ && &cigars.back() + 1 >= index.cigarEnd_ &&
+                             uint32_t(index.cigarEnd_ - index.cigarBegin_) == index.cigarBegin_[-1],
+                             "CIGAR must be stored by storeCigar. Fragment data offset: " << index.dataOffset_);
+            const uint64_t cigarOffset = index.cigarBegin_ - &cigars.front() - 1;
+            ISAAC_ASSERT_MSG(CompactIndex::FRAGMENT_CIGAR > cigarOffset,
+                             "CIGAR offset " << cigarOffset << " does not fit CompactIndex. Fragment data offset: " << index.dataOffset_);
+            ret.cigarOffset_ = cigarOffset;
+        }
+        return ret;
     }
 
-    bool orderForBam(const Index &left, const Index &right) const
+    /**
+     * \brief Appends the index CIGAR to cigars in the form getIndex understands and points the index to the copy
+     */
+    static void storeCigar(Index &index, alignment::Cigar &cigars)
+    {
+        const std::size_t before = cigars.size();
+        cigars.push_back(std::distance(index.cigarBegin_, index.cigarEnd_));
+        cigars.addOperations(index.cigarBegin_, index.cigarEnd_);
+        index.cigarBegin_ = &cigars.at(before) + 1;
+        index.cigarEnd_ = &cigars.back() + 1;
+    }
+
+    template <typename IndexT>
+    bool orderForBam(const IndexT &left, const IndexT &right) const
     {
         if (left.pos_ < right.pos_)
         {
@@ -191,6 +363,11 @@ public:
 
         return false;
     }
+
+private:
+    // true when the bin data does not fit the 32 bit CompactIndex::dataOffset_
+    bool wide_;
+    WideOffsetsList wideOffsets_;
 };
 
 inline std::ostream & operator <<(std::ostream &os, const PackedFragmentBuffer::Index &index)
@@ -200,6 +377,12 @@ inline std::ostream & operator <<(std::ostream &os, const PackedFragmentBuffer::
     return alignment::Cigar::toStream(index.cigarBegin_, index.cigarEnd_, os) << ")";
 }
 
+inline std::ostream & operator <<(std::ostream &os, const PackedFragmentBuffer::CompactIndex &index)
+{
+    return os << "PackedFragmentBuffer::CompactIndex(" <<
+        index.pos_ << "," << index.dataOffset_ << "do " << index.cigarOffset_ << "co " << index.reverse_ << ")";
+}
+
 } // namespace build
 } // namespace isaac
 
@@ -43,6 +43,10 @@ inline std::size_t getTotalGapsCount(const std::vector<gapRealigner::RealignerGa
 class ParallelGapRealigner
 {
 public:
+    /**
+     * \param logTemplateLengthStatistics  false when the statistics are still being detected by the alignment running
+     *                                     alongside. They can't be read before the lanes are done
+     */
     ParallelGapRealigner(
         const unsigned threads,
         const bool realignGapsVigorously,
@@ -51,7 +55,8 @@ public:
         const bool clipSemialigned,
         const flowcell::BarcodeMetadataList &barcodeMetadataList,
         const std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
-        const isaac::reference::NumaContigLists &contigLists) :
+        const isaac::reference::NumaContigLists &contigLists,
+        const bool logTemplateLengthStatistics) :
             contigLists_(contigLists),
             barcodeTemplateLengthStatistics_(barcodeTemplateLengthStatistics),
             threadCigars_(threads),
@@ -63,9 +68,12 @@ public:
         std::for_each(threadCigars_.begin(), threadCigars_.end(), boost::bind(&alignment::Cigar::reserve, _1, THREAD_CIGAR_MAX));
         std::for_each(threadGapRealigners_.begin(), threadGapRealigners_.end(), boost::bind(&GapRealigner::reserve, _1));
 
-        BOOST_FOREACH(const alignment::TemplateLengthStatistics &barcodeTls, barcodeTemplateLengthStatistics)
+        if (logTemplateLengthStatistics)
         {
-            ISAAC_THREAD_CERR << "ParallelGapRealigner " << barcodeTls << std::endl;
+            BOOST_FOREACH(const alignment::TemplateLengthStatistics &barcodeTls, barcodeTemplateLengthStatistics)
+            {
+                ISAAC_THREAD_CERR << "ParallelGapRealigner " << barcodeTls << std::endl;
+            }
         }
     }
 
@@ -80,7 +88,7 @@ private:
 
     void realign(
         isaac::build::GapRealigner& realigner,
-        io::FragmentAccessor& fragment, PackedFragmentBuffer::Index &index,
+        io::FragmentAccessor& fragment, PackedFragmentBuffer::CompactIndex &compactIndex,
         BinData& binData, isaac::alignment::Cigar& cigars);
 };
 
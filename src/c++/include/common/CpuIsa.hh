@@ -0,0 +1,72 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CpuIsa.hh
+ **
+ ** Selection of the instruction set used by the vectorized kernels at runtime.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_CPU_ISA_HH
+#define iSAAC_COMMON_CPU_ISA_HH
+
+#ifdef __SSE2__
+/// kernels for the wider x86 instruction sets get compiled with __attribute__((target))
+#define iSAAC_CPU_ISA_X86
+#endif //__SSE2__
+
+namespace isaac
+{
+namespace common
+{
+
+/**
+ * \brief Ordered from the least to the most capable. Kernels pick the widest implementation they have that does not
+ *        exceed getCpuIsa().
+ */
+enum CpuIsa
+{
+    // plain c++, whatever the compiler flags allow
+    CpuIsaGeneric,
+    CpuIsaSse2,
+    CpuIsaSse41,
+    CpuIsaAvx2,
+    // avx512f and avx512bw
+    CpuIsaAvx512,
+    CpuIsaCount
+};
+
+const char *getCpuIsaName(const CpuIsa isa);
+
+/**
+ * \return true if both the build and the cpu support isa
+ */
+bool isCpuIsaSupported(const CpuIsa isa);
+
+/**
+ * \brief the most capable isa supported by the build and the cpu
+ */
+CpuIsa getBestCpuIsa();
+
+/**
+ * \brief Call this once at the process startup, before any kernels are used. Without the call getCpuIsa returns
+ *        getBestCpuIsa().
+ */
+void cpuIsaInitialize(const CpuIsa isa);
+
+CpuIsa getCpuIsa();
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_CPU_ISA_HH
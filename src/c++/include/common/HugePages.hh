@@ -0,0 +1,76 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file HugePages.hh
+ **
+ ** Huge page backed anonymous memory for large static data structures.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_HUGE_PAGES_HH
+#define iSAAC_COMMON_HUGE_PAGES_HH
+
+#include <cstddef>
+
+namespace isaac
+{
+namespace common
+{
+
+enum HugePagesMode
+{
+    // regular pages
+    HugePagesOff,
+    // 2 megabyte aligned mappings advised with MADV_HUGEPAGE
+    HugePagesTransparent,
+    // MAP_HUGETLB mappings from the preallocated pool, falls back to HugePagesTransparent when the pool is exhausted
+    HugePagesExplicit
+};
+
+/**
+ * \brief Call this once at the process startup, before the large structures get allocated.
+ *        Allocations made while huge pages are off are released the regular way regardless of the mode.
+ */
+void hugePagesInitialize(const HugePagesMode mode);
+
+HugePagesMode getHugePagesMode();
+
+namespace hugePages
+{
+
+static const std::size_t HUGE_PAGE_SIZE = 2UL * 1024 * 1024;
+/// smaller allocations are not worth the rounding up to the huge page size
+static const std::size_t ALLOCATION_SIZE_MIN = 16 * HUGE_PAGE_SIZE;
+
+/**
+ * \return  anonymous mapping of at least size bytes or 0 if huge pages are off, the allocation is too small or the
+ *          mapping could not be made. The memory is not touched, so NUMA policy can be applied before the first use.
+ */
+void *hugePageAllocate(const std::size_t size);
+
+/**
+ * \return  false if p was not allocated by hugePageAllocate and has to be released by the caller
+ */
+bool hugePageDeallocate(void *p, const std::size_t size);
+
+/**
+ * \return  number of bytes in [p, p + size) that are currently backed by huge pages, as reported by /proc/self/smaps
+ */
+std::size_t getHugePageBackedBytes(const void *p, const std::size_t size);
+
+} // namespace hugePages
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_HUGE_PAGES_HH
@@ -0,0 +1,77 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MemoryMappedFile.hh
+ **
+ ** Read-only memory mapping of a whole file.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_MEMORY_MAPPED_FILE_HH
+#define iSAAC_COMMON_MEMORY_MAPPED_FILE_HH
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace isaac
+{
+namespace common
+{
+
+/**
+ * \brief Maps the whole file read-only and shared, so that all processes mapping the same file share one copy
+ *        of it in the page cache.
+ */
+class MemoryMappedFile : boost::noncopyable
+{
+public:
+    enum Advice
+    {
+        Normal,
+        Sequential,
+        Random,
+        WillNeed,
+        DontNeed
+    };
+
+    MemoryMappedFile() : data_(0), size_(0) {}
+    explicit MemoryMappedFile(const boost::filesystem::path &path, const Advice advice = Normal);
+    MemoryMappedFile(MemoryMappedFile &&that);
+    ~MemoryMappedFile();
+
+    MemoryMappedFile &operator =(MemoryMappedFile &&that);
+
+    const char *data() const {return data_;}
+    std::size_t size() const {return size_;}
+    const boost::filesystem::path &path() const {return path_;}
+    bool empty() const {return !size_;}
+
+    /**
+     * \brief Tells the kernel about the expected access pattern for a range of the mapping. The range is expanded
+     *        to page boundaries. Failures are ignored as advice is never required for correctness.
+     */
+    void advise(const Advice advice, const std::size_t offset, const std::size_t length) const;
+    void advise(const Advice advice) const {advise(advice, 0, size_);}
+
+private:
+    boost::filesystem::path path_;
+    const char *data_;
+    std::size_t size_;
+
+    void unmap();
+};
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_MEMORY_MAPPED_FILE_HH
@@ -32,8 +32,11 @@ namespace common
 namespace numa
 {
 
-void* numaAllocate(std::size_t size, const int node);
-void numaDeallocate(void * __p, std::size_t size, const int node);
+/**
+ * \param hugePages    try hugePages::hugePageAllocate first
+ */
+void* numaAllocate(std::size_t size, const int node, const bool hugePages);
+void numaDeallocate(void * __p, std::size_t size, const int node, const bool hugePages);
 
 static const int defaultNodeLocal = -1;
 static const int defaultNodeInterleave = -2;
@@ -76,7 +79,11 @@ int bindCurrentThreadToNumaNode(const std::size_t threadNumber);
  */
 int getNumaNodeCount();
 
-template<typename Tp, int defaultNode = numa::defaultNodeLocal>
+/**
+ * \tparam hugePages   allocations are attempted with huge pages when enabled by hugePagesInitialize. Meant only for the
+ *                     few large long-lived structures such as the reference hash and contigs
+ */
+template<typename Tp, int defaultNode = numa::defaultNodeLocal, bool hugePages = false>
 class NumaAllocator
 {
     int node_;
@@ -91,15 +98,15 @@ public:
     typedef Tp        value_type;
 
     template<typename Tp1>
-    struct rebind { typedef NumaAllocator<Tp1, defaultNode> other; };
+    struct rebind { typedef NumaAllocator<Tp1, defaultNode, hugePages> other; };
 
     NumaAllocator() throw() :node_(defaultNode) { }
     explicit NumaAllocator(const int node) throw() :node_(node) { }
 
     NumaAllocator(const NumaAllocator& that) throw() :node_(that.node_) { }
 
-    template<typename Tp1>
-    NumaAllocator(const NumaAllocator<Tp1, defaultNode>& that) throw() :node_(that.node_) { }
+    template<typename Tp1, bool hugePages1>
+    NumaAllocator(const NumaAllocator<Tp1, defaultNode, hugePages1>& that) throw() :node_(that.node_) { }
 
     ~NumaAllocator() throw() { }
 
@@ -114,7 +121,7 @@ public:
         if (__builtin_expect(n > this->max_size(), false))
             std::__throw_bad_alloc();
 
-        Tp* ret = static_cast<Tp*>(numa::numaAllocate(n * sizeof(Tp), node_));
+        Tp* ret = static_cast<Tp*>(numa::numaAllocate(n * sizeof(Tp), node_, hugePages));
         if (!ret)
         {
             ISAAC_THREAD_CERR << "numaAllocate failed for " << n * sizeof(Tp) << " bytes on node " << node_ << " for type " << typeid(Tp).name() << std::endl;
@@ -130,7 +137,7 @@ public:
     // __p is not permitted to be a null pointer.
     void deallocate(pointer p, size_type n)
     {
-        numa::numaDeallocate(p, n * sizeof(Tp), node_);
+        numa::numaDeallocate(p, n * sizeof(Tp), node_, hugePages);
     }
 
     size_type max_size() const throw() {return size_t(-1) / sizeof(Tp);}
@@ -149,15 +156,15 @@ public:
     bool operator != (const NumaAllocator &that) const {return that.node_ != node_;}
 //    template<typename _T> friend bool operator==(const NumaAllocator<_T, defaultNode>& left, const NumaAllocator<_T, defaultNode>& right);
 
-    template<typename Tp1, int dN> friend class NumaAllocator;
-    template<typename Tp1, int dN>
-        friend std::ostream operator << (std::ostream &os, const NumaAllocator<Tp1, dN> &allocator);
+    template<typename Tp1, int dN, bool hP> friend class NumaAllocator;
+    template<typename Tp1, int dN, bool hP>
+        friend std::ostream operator << (std::ostream &os, const NumaAllocator<Tp1, dN, hP> &allocator);
 
 //    typedef std::true_type propagate_on_container_copy_assignment;
 };
 
-template<int defaultNode>
-class NumaAllocator<void, defaultNode>
+template<int defaultNode, bool hugePages>
+class NumaAllocator<void, defaultNode, hugePages>
 {
     const int node_;
 
@@ -166,15 +173,15 @@ public:
     typedef std::ptrdiff_t  difference_type;
 
     template<typename Tp1>
-    struct rebind { typedef NumaAllocator<Tp1, defaultNode> other; };
+    struct rebind { typedef NumaAllocator<Tp1, defaultNode, hugePages> other; };
 
     NumaAllocator() throw() :node_(defaultNode) { }
     explicit NumaAllocator(const int node) throw() :node_(node) { }
 
     NumaAllocator(const NumaAllocator&) throw() { }
 
-    template<typename Tp1>
-    NumaAllocator(const NumaAllocator<Tp1, defaultNode>& that) throw(): node_(that.node_) { }
+    template<typename Tp1, bool hugePages1>
+    NumaAllocator(const NumaAllocator<Tp1, defaultNode, hugePages1>& that) throw(): node_(that.node_) { }
 
     ~NumaAllocator() throw() { }
 
@@ -187,23 +194,23 @@ public:
     bool operator == (const NumaAllocator &that) const {return that.node_ == node_;}
     bool operator != (const NumaAllocator &that) const {return that.node_ != node_;}
 //    template<typename T> friend bool operator==(const NumaAllocator<T, defaultNode>& left, const NumaAllocator<T, defaultNode>& right);
-    template<typename Tp, int dN> friend class NumaAllocator;
-    template<typename Tp, int dN>
-        friend std::ostream operator << (std::ostream &os, const NumaAllocator<Tp, dN> &allocator);
+    template<typename Tp, int dN, bool hP> friend class NumaAllocator;
+    template<typename Tp, int dN, bool hP>
+        friend std::ostream operator << (std::ostream &os, const NumaAllocator<Tp, dN, hP> &allocator);
 
 //    typedef std::true_type propagate_on_container_copy_assignment;
 };
 
-template<typename Tp, int defaultNode>
-std::ostream &operator << (std::ostream &&os, const NumaAllocator<Tp, defaultNode> &allocator)
+template<typename Tp, int defaultNode, bool hugePages>
+std::ostream &operator << (std::ostream &&os, const NumaAllocator<Tp, defaultNode, hugePages> &allocator)
 {
     os << "NumaAllocator<" << typeid(Tp).name() <<
         ">(" << allocator.node_  << ")" << std::endl;
     return os;
 }
 
-template<int defaultNode>
-std::ostream &operator << (std::ostream &os, const NumaAllocator<void, defaultNode> &allocator)
+template<int defaultNode, bool hugePages>
+std::ostream &operator << (std::ostream &os, const NumaAllocator<void, defaultNode, hugePages> &allocator)
 {
     os << "NumaAllocator<" << typeid(void).name() <<
         ">(" << allocator.node_  << ")" << std::endl;
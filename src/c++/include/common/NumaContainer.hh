@@ -44,9 +44,12 @@ class NumaContainerReplicas
 {
     std::vector<ReplicaT> nodeContainers_;
 public:
-    NumaContainerReplicas(ReplicaT &&node0Container)
+    /**
+     * \param replicate when false, all nodes share the node 0 container
+     */
+    NumaContainerReplicas(ReplicaT &&node0Container, const bool replicate = true)
     {
-        if (common::isNumaAvailable())
+        if (replicate && common::isNumaAvailable())
         {
             const int nodes = getNumaNodeCount();
 
@@ -68,7 +71,12 @@ public:
     }
 
     const ReplicaT &node0Container() const {return nodeContainers_.front();}
-    const ReplicaT &threadNodeContainer() const {return nodeContainers_.at(common::ThreadVector::getThreadNumaNode());}
+    const ReplicaT &threadNodeContainer() const
+    {
+        return 1 == nodeContainers_.size() ?
+            nodeContainers_.front() : nodeContainers_.at(common::ThreadVector::getThreadNumaNode());
+    }
+    std::size_t replicasCount() const {return nodeContainers_.size();}
 //        return hashes_[(common::ThreadVector::getThreadNumaNode()+1) % 2].findMatches(kmer);
 };
 
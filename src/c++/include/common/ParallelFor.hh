@@ -0,0 +1,83 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ParallelFor.hh
+ **
+ ** Lets the code that splits the work into blocks stay unaware of who runs the blocks.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_PARALLEL_FOR_HH
+#define iSAAC_COMMON_PARALLEL_FOR_HH
+
+#include <cstddef>
+
+namespace isaac
+{
+namespace common
+{
+
+/**
+ * \brief Calls body(begin, end) for consecutive blocks of up to blockSize indexes covering [0, count).
+ *        Returns when all blocks are done. Blocks may run concurrently and in any order. Implementations
+ *        don't allocate memory.
+ */
+class ParallelFor
+{
+public:
+    template <typename BodyT> void operator()(const std::size_t count, const std::size_t blockSize, BodyT body)
+    {
+        struct BodyExecutor : public Executor
+        {
+            BodyT &body_;
+            BodyExecutor(BodyT &body) : body_(body){}
+            virtual void execute(const std::size_t begin, const std::size_t end)
+            {
+                body_(begin, end);
+            }
+        } executor(body);
+
+        run(count, blockSize, executor);
+    }
+
+    virtual ~ParallelFor() {}
+
+protected:
+    struct Executor
+    {
+        virtual void execute(const std::size_t begin, const std::size_t end) = 0;
+        virtual ~Executor() {}
+    };
+
+    virtual void run(const std::size_t count, const std::size_t blockSize, Executor &executor) = 0;
+};
+
+/**
+ * \brief Runs the whole range as one block on the calling thread
+ */
+class SequentialFor : public ParallelFor
+{
+protected:
+    virtual void run(const std::size_t count, const std::size_t /*blockSize*/, Executor &executor)
+    {
+        if (count)
+        {
+            executor.execute(0, count);
+        }
+    }
+};
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_PARALLEL_FOR_HH
@@ -141,9 +141,23 @@ class ParallelSorter
             }
         }
     }
+    // no reason to make single stretch shorter than size/threads except for
+    // when some sort quicker than others. Splitting further allows a bit of rebalancing
+    // when amount of work turns out to be inequal.
+    static const unsigned STRETCHES_PER_THREAD = 100;
+
 public:
     ParallelSorter() : partitioningJobs_(0){}
 
+    /**
+     * \brief Memory the jobs priority queue reserves when sorting on the given number of threads. Only badly
+     *        unbalanced partitioning makes the queue grow beyond that.
+     */
+    static std::size_t getMemoryRequirements(const std::size_t threads)
+    {
+        return threads * STRETCHES_PER_THREAD * 2 * sizeof(Subjob);
+    }
+
     /**
      * \brief performs in-place sort on multiple threads. Should handle well randomly distributed data and sorted data.
      *        Uses a bit of dynamic memory for jobs priority queue.
@@ -151,14 +165,13 @@ public:
 
     void sort(IteratorT begin, IteratorT end, const Compare &comp, isaac::common::ThreadVector &threads, const unsigned threadsMax)
     {
-        Subjobs subjobs(1, Subjob(begin, end));
+        Subjobs subjobs;
+        subjobs.reserve(getMemoryRequirements(threads.size()) / sizeof(Subjob));
+        subjobs.push_back(Subjob(begin, end));
         threads.execute(boost::bind(
             &ParallelSorter::thread, this,
             boost::ref(subjobs),
-            // no reason to make single stretch shorter than size/threads except for
-            // when some sort quicker than others. / 10/ allows a bit of rebalancing
-            // when amount of work turns out to be inequal.
-            std::distance(begin, end) / threads.size() / 100,
+            std::distance(begin, end) / threads.size() / STRETCHES_PER_THREAD,
             boost::ref(comp)),
                         threadsMax);
     }
@@ -0,0 +1,360 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file RadixSort.hpp
+ **
+ ** Least significant digit radix sort of 64-bit keys. Used to order bin fragment indexes by reference position
+ ** without comparing the fragments themselves.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_RADIX_SORT_HPP
+#define iSAAC_COMMON_RADIX_SORT_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "common/Debug.hh"
+#include "common/Numa.hh"
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace common
+{
+
+/**
+ * \brief Sort key and the offset of the keyed element in the sequence being sorted. Moving these around instead of
+ *        the elements keeps every pass down to 16 bytes per element.
+ */
+struct RadixSortRecord
+{
+    RadixSortRecord() : key_(0), offset_(0){}
+    RadixSortRecord(const uint64_t key, const uint64_t offset) : key_(key), offset_(offset){}
+    uint64_t key_;
+    uint64_t offset_;
+};
+
+inline uint64_t getRadixSortRecordOffset(const RadixSortRecord &record) {return record.offset_;}
+
+typedef std::vector<RadixSortRecord, NumaAllocator<RadixSortRecord, numa::defaultNodeLocal> > RadixSortRecords;
+
+class RadixSorter
+{
+public:
+    // 2048 counters per pass still fit in L1. Fewer passes matter more than fewer buckets.
+    static const unsigned DIGIT_BITS = 11;
+    static const unsigned DIGIT_VALUES = 1 << DIGIT_BITS;
+    static const unsigned DIGIT_MASK = DIGIT_VALUES - 1;
+    static const unsigned KEY_DIGITS = (sizeof(uint64_t) * 8 + DIGIT_BITS - 1) / DIGIT_BITS;
+    // distance at which gather prefetches the elements it is about to copy
+    static const unsigned GATHER_PREFETCH_DISTANCE = 16;
+    // below this it is cheaper to do the pass on one thread than to wake up the others
+    static const std::size_t MIN_RECORDS_PER_THREAD = 64 * 1024;
+
+    /**
+     * \brief stable sort of records by key_. Digits that are the same in all keys are skipped, so keys that span a
+     *        narrow range such as positions within a bin take only a few passes.
+     *
+     * \param buffer    must have room for end - begin records. Does not allocate memory.
+     */
+    static void sort(RadixSortRecord *begin, RadixSortRecord *end, RadixSortRecord *buffer)
+    {
+        if (end == begin)
+        {
+            return;
+        }
+        const uint64_t different = differentBits(begin, end, begin->key_);
+        RadixSortRecord *from = begin;
+        RadixSortRecord *to = buffer;
+        std::size_t histogram[DIGIT_VALUES];
+        for (unsigned digit = 0; KEY_DIGITS != digit; ++digit)
+        {
+            const unsigned shift = digit * DIGIT_BITS;
+            if (!((different >> shift) & DIGIT_MASK))
+            {
+                continue;
+            }
+            std::fill(histogram, histogram + DIGIT_VALUES, 0);
+            count(from, from + (end - begin), shift, histogram);
+            std::size_t offset = 0;
+            for (unsigned value = 0; DIGIT_VALUES != value; ++value)
+            {
+                const std::size_t valueCount = histogram[value];
+                histogram[value] = offset;
+                offset += valueCount;
+            }
+            scatter(from, from + (end - begin), shift, to, histogram);
+            std::swap(from, to);
+        }
+        if (from != begin)
+        {
+            std::memcpy(begin, from, (end - begin) * sizeof(RadixSortRecord));
+        }
+    }
+
+    /**
+     * \brief same as above but each pass is split between up to threadsMax threads. Each thread counts and scatters
+     *        its own contiguous chunk, so the result is identical to the single-threaded one.
+     *        Uses a bit of dynamic memory for per-thread histograms.
+     */
+    static void sort(
+        RadixSortRecord *begin, RadixSortRecord *end, RadixSortRecord *buffer,
+        ThreadVector &threads, const unsigned threadsMax)
+    {
+        const std::size_t size = std::distance(begin, end);
+        const unsigned chunks = std::max<std::size_t>(1, std::min<std::size_t>(threadsMax, size / MIN_RECORDS_PER_THREAD));
+        if (1 == chunks)
+        {
+            sort(begin, end, buffer);
+            return;
+        }
+
+        std::vector<uint64_t> chunkDifferent(chunks, 0);
+        threads.execute(
+            [&](const unsigned chunk, const std::size_t)
+            {
+                chunkDifferent[chunk] = differentBits(begin + size * chunk / chunks, begin + size * (chunk + 1) / chunks, begin->key_);
+            }, chunks);
+        uint64_t different = 0;
+        for (const uint64_t d : chunkDifferent)
+        {
+            different |= d;
+        }
+
+        // [chunk][digit value]
+        std::vector<std::size_t> histograms(chunks * DIGIT_VALUES);
+        RadixSortRecord *from = begin;
+        RadixSortRecord *to = buffer;
+        for (unsigned digit = 0; KEY_DIGITS != digit; ++digit)
+        {
+            const unsigned shift = digit * DIGIT_BITS;
+            if (!((different >> shift) & DIGIT_MASK))
+            {
+                continue;
+            }
+            threads.execute(
+                [&](const unsigned chunk, const std::size_t)
+                {
+                    std::size_t *histogram = &histograms[chunk * DIGIT_VALUES];
+                    std::fill(histogram, histogram + DIGIT_VALUES, 0);
+                    count(from + size * chunk / chunks, from + size * (chunk + 1) / chunks, shift, histogram);
+                }, chunks);
+
+            // records of a lower chunk go before records of a higher chunk with the same digit value to keep it stable
+            std::size_t offset = 0;
+            for (unsigned value = 0; DIGIT_VALUES != value; ++value)
+            {
+                for (unsigned chunk = 0; chunks != chunk; ++chunk)
+                {
+                    std::size_t &h = histograms[chunk * DIGIT_VALUES + value];
+                    const std::size_t valueCount = h;
+                    h = offset;
+                    offset += valueCount;
+                }
+            }
+
+            threads.execute(
+                [&](const unsigned chunk, const std::size_t)
+                {
+                    scatter(from + size * chunk / chunks, from + size * (chunk + 1) / chunks, shift, to,
+                            &histograms[chunk * DIGIT_VALUES]);
+                }, chunks);
+            std::swap(from, to);
+        }
+
+        if (from != begin)
+        {
+            threads.execute(
+                [&](const unsigned chunk, const std::size_t)
+                {
+                    const std::size_t chunkBegin = size * chunk / chunks;
+                    const std::size_t chunkEnd = size * (chunk + 1) / chunks;
+                    std::memcpy(begin + chunkBegin, from + chunkBegin, (chunkEnd - chunkBegin) * sizeof(RadixSortRecord));
+                }, chunks);
+        }
+    }
+
+    /**
+     * \brief orders runs of records with equal keys using less
+     */
+    template <typename LessT>
+    static void sortTies(RadixSortRecord *begin, RadixSortRecord *end, LessT less)
+    {
+        while (end != begin)
+        {
+            RadixSortRecord *runEnd = begin + 1;
+            while (end != runEnd && runEnd->key_ == begin->key_)
+            {
+                ++runEnd;
+            }
+            if (1 < std::distance(begin, runEnd))
+            {
+                std::sort(begin, runEnd, less);
+            }
+            begin = runEnd;
+        }
+    }
+
+    /**
+     * \brief Moves elements of data into the order of the sorted records. Follows the permutation cycles so that no
+     *        copy of data is required. Overwrites the record offsets. Each step waits for the previous one to arrive
+     *        from memory, so prefer gather when there is room for a copy.
+     */
+    template <typename RandomAccessIteratorT>
+    static void permute(RadixSortRecord *begin, RadixSortRecord *end, RandomAccessIteratorT data)
+    {
+        const std::size_t size = std::distance(begin, end);
+        for (std::size_t i = 0; size != i; ++i)
+        {
+            if (i == begin[i].offset_)
+            {
+                continue;
+            }
+            typename std::iterator_traits<RandomAccessIteratorT>::value_type cycleStart = data[i];
+            std::size_t j = i;
+            while (i != begin[j].offset_)
+            {
+                const std::size_t next = begin[j].offset_;
+                data[j] = data[next];
+                begin[j].offset_ = j;
+                j = next;
+            }
+            data[j] = cycleStart;
+            begin[j].offset_ = j;
+        }
+    }
+
+    /**
+     * \brief Copies elements of data to out in the order of the sorted records.
+     */
+    template <typename RandomAccessIteratorT, typename OutputIteratorT>
+    static void gather(const RadixSortRecord *begin, const RadixSortRecord *end, RandomAccessIteratorT data, OutputIteratorT out)
+    {
+        for (const RadixSortRecord *it = begin; end != it; ++it)
+        {
+            if (std::distance(it, end) > GATHER_PREFETCH_DISTANCE)
+            {
+                __builtin_prefetch(&*(data + it[GATHER_PREFETCH_DISTANCE].offset_));
+            }
+            *out++ = data[it->offset_];
+        }
+    }
+
+private:
+    static uint64_t differentBits(const RadixSortRecord *begin, const RadixSortRecord *end, const uint64_t reference)
+    {
+        uint64_t ret = 0;
+        for (; end != begin; ++begin)
+        {
+            ret |= begin->key_ ^ reference;
+        }
+        return ret;
+    }
+
+    static void count(const RadixSortRecord *begin, const RadixSortRecord *end, const unsigned shift, std::size_t *histogram)
+    {
+        for (; end != begin; ++begin)
+        {
+            ++histogram[(begin->key_ >> shift) & DIGIT_MASK];
+        }
+    }
+
+    static void scatter(
+        const RadixSortRecord *begin, const RadixSortRecord *end, const unsigned shift,
+        RadixSortRecord *to, std::size_t *offsets)
+    {
+        for (; end != begin; ++begin)
+        {
+            to[offsets[(begin->key_ >> shift) & DIGIT_MASK]++] = *begin;
+        }
+    }
+};
+
+/**
+ * \brief Fills records with the keys of [begin, end) and sorts them. Records with equal keys are ordered by less.
+ *
+ * \return end of the sorted records. The rest of the records is scratch space.
+ */
+template <typename RandomAccessIteratorT, typename KeyT, typename LessT, typename RecordsT>
+RadixSortRecord *sortRecords(RandomAccessIteratorT begin, RandomAccessIteratorT end, KeyT key, LessT less, RecordsT &records)
+{
+    const std::size_t size = std::distance(begin, end);
+    ISAAC_ASSERT_MSG(records.capacity() >= size * 2, "Not enough records reserved for " << size << " elements: " << records.capacity());
+    records.clear();
+    for (RandomAccessIteratorT it = begin; end != it; ++it)
+    {
+        records.push_back(RadixSortRecord(key(*it), std::distance(begin, it)));
+    }
+    records.resize(size * 2);
+
+    RadixSortRecord *recordsBegin = &records.front();
+    RadixSortRecord *recordsEnd = recordsBegin + size;
+    RadixSorter::sort(recordsBegin, recordsEnd, recordsEnd);
+    RadixSorter::sortTies(recordsBegin, recordsEnd,
+                          [begin, &less](const RadixSortRecord &left, const RadixSortRecord &right)
+                          {
+                              return less(begin[left.offset_], begin[right.offset_]);
+                          });
+    return recordsEnd;
+}
+
+/**
+ * \brief Sorts [begin, end) in order of key(element). Elements with equal keys are ordered by less.
+ *
+ * \param records   must have capacity for 2 * (end - begin) records. Does not allocate memory.
+ */
+template <typename RandomAccessIteratorT, typename KeyT, typename LessT, typename RecordsT>
+void radixSort(RandomAccessIteratorT begin, RandomAccessIteratorT end, KeyT key, LessT less, RecordsT &records)
+{
+    if (end == begin)
+    {
+        return;
+    }
+    RadixSortRecord *recordsEnd = sortRecords(begin, end, key, less, records);
+    RadixSorter::permute(&records.front(), recordsEnd, begin);
+    records.clear();
+}
+
+/**
+ * \brief Same as above. If the capacity of the vector allows, the sorted elements are gathered past its end and
+ *        moved to the front which is a lot quicker than permuting them in place. Does not allocate memory.
+ */
+template <typename VectorT, typename KeyT, typename LessT, typename RecordsT>
+void radixSort(VectorT &v, KeyT key, LessT less, RecordsT &records)
+{
+    const std::size_t size = v.size();
+    if (!size)
+    {
+        return;
+    }
+    RadixSortRecord *recordsEnd = sortRecords(v.begin(), v.end(), key, less, records);
+    if (v.capacity() >= size * 2)
+    {
+        RadixSorter::gather(&records.front(), recordsEnd, v.begin(), std::back_inserter(v));
+        std::copy(v.begin() + size, v.end(), v.begin());
+        v.erase(v.begin() + size, v.end());
+    }
+    else
+    {
+        RadixSorter::permute(&records.front(), recordsEnd, v.begin());
+    }
+    records.clear();
+}
+
+} //namespace common
+} //namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_RADIX_SORT_HPP
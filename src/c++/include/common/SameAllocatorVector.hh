@@ -204,6 +204,14 @@ public:
 //            ">(SameAllocatorVectorEnd &&that)" << std::endl;
     }
 
+    template<typename InputIterator>
+    SameAllocatorVectorEnd(InputIterator first, InputIterator last, const AllocatorT& a)
+    : BaseT(first, last, a)
+    {
+//        ISAAC_THREAD_CERR << "SameAllocatorVectorEnd<" <<  demangle(typeid(ValueT).name()) <<
+//            ">(InputIterator first, InputIterator last, const AllocatorT& a))" << std::endl;
+    }
+
     SameAllocatorVectorEnd & operator=(SameAllocatorVectorEnd &&that)
     {
         swap(that);
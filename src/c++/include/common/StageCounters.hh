@@ -0,0 +1,146 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file StageCounters.hh
+ **
+ ** Per-thread call counters and timers for the processing stages.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_STAGE_COUNTERS_HH
+#define iSAAC_COMMON_STAGE_COUNTERS_HH
+
+#include <atomic>
+#include <ostream>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace isaac
+{
+namespace common
+{
+
+enum Stage
+{
+    STAGE_TILE_LOAD,
+    STAGE_SEED_LOOKUP,
+    STAGE_UNGAPPED_ALIGNMENT,
+    STAGE_GAPPED_ALIGNMENT,
+    STAGE_SMITH_WATERMAN,
+    STAGE_TEMPLATE_BUILDING,
+    STAGE_BINNING,
+    STAGE_BIN_LOAD,
+    STAGE_DUPLICATE_FILTERING,
+    STAGE_REALIGNMENT,
+    STAGE_SERIALIZATION,
+    STAGE_COMPRESSION,
+    STAGES_COUNT
+};
+
+const char *getStageName(const Stage stage);
+
+/**
+ * \brief Each thread claims its own slot the first time it records anything. After that, recording is a couple
+ *        of relaxed loads and stores into memory nobody else writes. Slots stay with their threads. When all slots
+ *        are taken, the remaining threads share one slot and pay for atomic increments.
+ *
+ *        Stages nest. Smith-Waterman time is also counted in gapped alignment.
+ */
+class StageCounters
+{
+public:
+    struct Totals
+    {
+        Totals();
+        uint64_t calls_[STAGES_COUNT];
+        uint64_t nanoseconds_[STAGES_COUNT];
+    };
+
+    static void add(const Stage stage, const uint64_t nanoseconds)
+    {
+        Slot *slot = threadSlot_ ? threadSlot_ : claimSlot();
+        if (&slots_[SLOTS_MAX] == slot)
+        {
+            slot->calls_[stage].fetch_add(1, std::memory_order_relaxed);
+            slot->nanoseconds_[stage].fetch_add(nanoseconds, std::memory_order_relaxed);
+        }
+        else
+        {
+            slot->calls_[stage].store(slot->calls_[stage].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            slot->nanoseconds_[stage].store(
+                slot->nanoseconds_[stage].load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    /// monotonic time in nanoseconds
+    static uint64_t now();
+
+    /// sums up all slots. Threads may keep recording while this happens
+    static Totals collect();
+
+    /// zeroes all slots. Call between the phases when no thread records
+    static void reset();
+
+    /**
+     * \brief Stores the collected totals as a json object and as Prometheus text exposition
+     */
+    static void save(
+        const std::string &phase,
+        const boost::filesystem::path &jsonPath,
+        const boost::filesystem::path &prometheusPath);
+
+    static void serializeJson(std::ostream &os, const std::string &phase, const Totals &totals);
+    static void serializePrometheus(std::ostream &os, const std::string &phase, const Totals &totals);
+
+private:
+    static const unsigned SLOTS_MAX = 1024;
+
+    /// Cache line aligned, so that threads recording into neighbouring slots don't invalidate each other's lines
+    struct __attribute__((aligned(64))) Slot
+    {
+        std::atomic<uint64_t> calls_[STAGES_COUNT];
+        std::atomic<uint64_t> nanoseconds_[STAGES_COUNT];
+    };
+
+    // the last one is shared
+    static Slot slots_[SLOTS_MAX + 1];
+    static std::atomic<unsigned> slotsClaimed_;
+    static __thread Slot *threadSlot_;
+
+    static Slot *claimSlot();
+    static void add(Totals &totals, const Slot &slot);
+};
+
+/**
+ * \brief Records the time between construction and destruction against the stage
+ */
+class StageTimer : boost::noncopyable
+{
+    const Stage stage_;
+    const uint64_t start_;
+public:
+    explicit StageTimer(const Stage stage) : stage_(stage), start_(StageCounters::now())
+    {
+    }
+
+    ~StageTimer()
+    {
+        StageCounters::add(stage_, StageCounters::now() - start_);
+    }
+};
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_STAGE_COUNTERS_HH
@@ -36,6 +36,9 @@ uint64_t getFileSize(const char *filePath);
 /// Determine the processor time
 int64_t clock();
 
+/// Resident set size of the current process in bytes. 0 if it cannot be determined
+uint64_t getResidentSetBytes();
+
 /// Check if the architecture is little endian
 bool isLittleEndian();
 
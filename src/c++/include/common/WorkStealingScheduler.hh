@@ -0,0 +1,162 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file WorkStealingScheduler.hh
+ **
+ ** Distribution of an index range between worker threads with work stealing.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_WORK_STEALING_SCHEDULER_HH
+#define iSAAC_COMMON_WORK_STEALING_SCHEDULER_HH
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Debug.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+/**
+ * \brief Each worker starts with a contiguous share of [0, total) and takes blocks from the front of it. A worker
+ *        that runs out steals the back half of the largest remaining share. This keeps the blocks processed by a
+ *        worker mostly adjacent and lets the tail of the range get split finer than the block size instead of
+ *        leaving all but one worker idle on the last block.
+ *
+ *        Every index is handed out exactly once. Which worker gets which index is not deterministic, so the
+ *        consumers must place their results by index.
+ *
+ *        No memory gets allocated after construction.
+ */
+class WorkStealingScheduler: boost::noncopyable
+{
+public:
+    explicit WorkStealingScheduler(const unsigned workers) : shares_(workers)
+    {
+    }
+
+    unsigned workers() const {return shares_.size();}
+
+    /**
+     * \brief Not thread safe. Must not be called while any worker is inside next()
+     */
+    void reset(const std::size_t total)
+    {
+        const std::size_t workerCount = shares_.size();
+        for (std::size_t worker = 0; workerCount != worker; ++worker)
+        {
+            shares_[worker].begin_ = total * worker / workerCount;
+            shares_[worker].end_ = total * (worker + 1) / workerCount;
+        }
+    }
+
+    /**
+     * \brief Obtains up to maxBlock indexes for the worker
+     *
+     * \return false when there is nothing left for anyone
+     */
+    bool next(const unsigned worker, const std::size_t maxBlock, std::size_t &begin, std::size_t &end)
+    {
+        ISAAC_ASSERT_MSG(maxBlock, "Block size must be positive");
+        Share &ourShare = shares_.at(worker);
+        while (true)
+        {
+            {
+                boost::lock_guard<boost::mutex> lock(ourShare.mutex_);
+                if (ourShare.begin_ != ourShare.end_)
+                {
+                    begin = ourShare.begin_;
+                    end = begin + std::min(maxBlock, ourShare.end_ - begin);
+                    ourShare.begin_ = end;
+                    return true;
+                }
+            }
+
+            std::size_t stolenBegin = 0;
+            std::size_t stolenEnd = 0;
+            if (!steal(worker, stolenBegin, stolenEnd))
+            {
+                return false;
+            }
+
+            // nobody steals from an empty share, so ours is still empty and can simply be replaced
+            boost::lock_guard<boost::mutex> lock(ourShare.mutex_);
+            ourShare.begin_ = stolenBegin;
+            ourShare.end_ = stolenEnd;
+        }
+    }
+
+private:
+    // keep the shares on separate cache lines so that the workers don't invalidate each other's
+    struct Share
+    {
+        Share() : begin_(0), end_(0) {}
+        boost::mutex mutex_;
+        std::size_t begin_;
+        std::size_t end_;
+    } __attribute__ ((aligned (64)));
+
+    std::vector<Share> shares_;
+
+    /**
+     * \brief Takes the back half of the largest share of another worker. Only ever holds one lock at a time.
+     *        The largest share can change between the scan and the steal. This only makes the choice suboptimal.
+     */
+    bool steal(const unsigned thief, std::size_t &begin, std::size_t &end)
+    {
+        while (true)
+        {
+            std::size_t victim = shares_.size();
+            std::size_t victimSize = 0;
+            for (std::size_t worker = 0; shares_.size() != worker; ++worker)
+            {
+                if (thief != worker)
+                {
+                    Share &share = shares_[worker];
+                    boost::lock_guard<boost::mutex> lock(share.mutex_);
+                    if (share.end_ - share.begin_ > victimSize)
+                    {
+                        victim = worker;
+                        victimSize = share.end_ - share.begin_;
+                    }
+                }
+            }
+
+            if (shares_.size() == victim)
+            {
+                return false;
+            }
+
+            Share &share = shares_[victim];
+            boost::lock_guard<boost::mutex> lock(share.mutex_);
+            if (share.begin_ != share.end_)
+            {
+                end = share.end_;
+                begin = share.end_ - (share.end_ - share.begin_ + 1) / 2;
+                share.end_ = begin;
+                return true;
+            }
+            // the victim has finished its share meanwhile. Look again.
+        }
+    }
+};
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_WORK_STEALING_SCHEDULER_HH
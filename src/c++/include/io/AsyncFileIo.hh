@@ -0,0 +1,155 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file AsyncFileIo.hh
+ **
+ ** Positioned file reads and writes that complete in the background.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_ASYNC_FILE_IO_HH
+#define iSAAC_IO_ASYNC_FILE_IO_HH
+
+#include <sys/uio.h>
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread.hpp>
+
+namespace isaac
+{
+namespace io
+{
+
+enum AsyncFileIoBackend
+{
+    // io_uring when the kernel allows it, threads otherwise
+    AsyncFileIoAuto,
+    // Linux io_uring submission and completion rings
+    AsyncFileIoUring,
+    // pool of threads doing blocking preadv/pwritev
+    AsyncFileIoThreads
+};
+
+/**
+ * \brief Call this once at the process startup. Affects the AsyncFileIo objects constructed afterwards.
+ */
+void asyncFileIoInitialize(const AsyncFileIoBackend backend, const unsigned queueDepth);
+
+const char *getAsyncFileIoBackendName(const AsyncFileIoBackend backend);
+
+/**
+ * \brief Any number of threads can submit requests. Each submitter keeps track of its own requests with a Batch and
+ *        waits for the Batch to complete before touching the buffers it gave away. Submission blocks while
+ *        queueDepth requests are in flight.
+ *
+ *        Short reads and writes are continued until the request is complete, so a successfully completed Batch
+ *        has transferred every byte it was asked to.
+ *
+ *        The threads backend shares one pool of threads between all AsyncFileIo objects. The pool grows to the
+ *        largest queueDepth requested. An exception on a backend thread is rethrown to the submitters from wait
+ *        and from the submission calls.
+ *
+ *        No memory gets allocated after construction.
+ */
+class AsyncFileIo: boost::noncopyable
+{
+public:
+    class Batch: boost::noncopyable
+    {
+        friend class AsyncFileIo;
+        unsigned outstanding_;
+        int error_;
+    public:
+        Batch() : outstanding_(0), error_(0) {}
+        bool empty() const {return !outstanding_;}
+    };
+
+    /// uses the backend and queue depth given to asyncFileIoInitialize
+    AsyncFileIo();
+    AsyncFileIo(const AsyncFileIoBackend backend, const unsigned queueDepth);
+    ~AsyncFileIo();
+
+    /// backend in use. Never AsyncFileIoAuto
+    AsyncFileIoBackend getBackend() const {return backend_;}
+    unsigned getQueueDepth() const {return requests_.size();}
+
+    /**
+     * \brief iov array and the memory it points to must stay untouched until the batch is waited for. The
+     *        entries of the iov array are modified when a write has to be continued.
+     */
+    void writev(Batch &batch, const int fd, iovec *iov, const int iovcnt, const uint64_t offset);
+    void read(Batch &batch, const int fd, char *buffer, const std::size_t size, const uint64_t offset);
+
+    /**
+     * \brief blocks until all requests of the batch are complete. The batch can be reused afterwards.
+     *
+     * \return 0 or errno of the first failed request of the batch. ENODATA if the file ended before the read did.
+     *
+     * \throws the exception that stopped a backend thread
+     */
+    int wait(Batch &batch);
+
+private:
+    struct Request
+    {
+        Batch *batch_;
+        int fd_;
+        bool write_;
+        iovec *iov_;
+        int iovcnt_;
+        uint64_t offset_;
+        // single buffer of a read
+        iovec buffer_;
+        // AsyncFileIoThreads. Queue link in the shared pool and the object to report the completion to
+        Request *next_;
+        AsyncFileIo *owner_;
+    };
+    class Uring;
+    class ThreadPool;
+
+    AsyncFileIoBackend backend_;
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    std::vector<Request> requests_;
+    std::vector<unsigned> freeRequests_;
+    bool terminate_;
+    // set when a backend thread fails. The object can't be used afterwards
+    boost::exception_ptr failure_;
+
+    // AsyncFileIoUring
+    Uring *uring_;
+    boost::ptr_vector<boost::thread> threads_;
+
+    void start(const AsyncFileIoBackend backend, const unsigned queueDepth);
+    unsigned acquireRequest(boost::unique_lock<boost::mutex> &lock);
+    void enqueue(Batch &batch, const int fd, const uint64_t offset, Request &request);
+    static bool advance(Request &request, std::size_t transferred);
+    static int transfer(Request &request);
+    void complete(const unsigned request, const int error);
+    void fail(const boost::exception_ptr &failure);
+    void checkFailure() const;
+
+    bool startUring(const unsigned queueDepth);
+    void uringSubmit(const unsigned request);
+    void uringLoop();
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_ASYNC_FILE_IO_HH
@@ -0,0 +1,203 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file DeflateDecoder.hh
+ **
+ ** Inflater for gzip data that can start at any deflate block of the stream.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_DEFLATE_DECODER_HH
+#define iSAAC_IO_DEFLATE_DECODER_HH
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Inflates gzip members and raw deflate blocks starting at an arbitrary bit offset. Output is produced as
+ *        16 bit symbols so that back-references into the unknown 32 kilobyte window preceding the start offset can
+ *        be kept as markers and resolved once the window becomes known. This is what allows chunks of a single
+ *        gzip member to be decompressed in parallel.
+ *
+ *        Decoding advances in units that begin at a Boundary: either a gzip member header or a deflate block.
+ *        Whenever input runs out in the middle of a unit, the unit is rolled back, so the output always ends at
+ *        a Boundary.
+ */
+class DeflateDecoder
+{
+public:
+    typedef boost::uint16_t Symbol;
+    static const unsigned WINDOW_SIZE = 32768;
+    /// symbols at or above MARKER_BASE stand for the byte at (symbol - MARKER_BASE) of the unknown window
+    static const unsigned MARKER_BASE = 256;
+    /// input buffers must have this many readable bytes past the end of the data
+    static const unsigned INPUT_PADDING = 8;
+
+    struct Boundary
+    {
+        Boundary() : bit_(0), memberStart_(false) {}
+        Boundary(const boost::uint64_t bit, const bool memberStart) : bit_(bit), memberStart_(memberStart) {}
+        /// offset in the compressed data
+        boost::uint64_t bit_;
+        /// true if a gzip member header starts at bit_, false if a deflate block does
+        bool memberStart_;
+
+        bool operator ==(const Boundary &that) const {return bit_ == that.bit_ && memberStart_ == that.memberStart_;}
+        bool operator !=(const Boundary &that) const {return !(*this == that);}
+    };
+
+    /// trailer of a gzip member that ended within the decoded data
+    struct MemberEnd
+    {
+        /// offset in the decoded data, not counting the window, at which the member data ends
+        std::size_t end_;
+        boost::uint32_t crc32_;
+        boost::uint32_t isize_;
+    };
+
+    enum Status
+    {
+        /// reached a Boundary at or past the requested stop
+        Stopped,
+        /// no complete unit left in the input
+        EndOfInput,
+        /// data does not decode
+        Invalid
+    };
+
+    DeflateDecoder();
+
+    /**
+     * \brief data must be followed by INPUT_PADDING readable bytes
+     */
+    void setInput(const unsigned char *data, const std::size_t size)
+    {
+        data_ = data;
+        sizeBits_ = boost::uint64_t(size) * 8;
+    }
+
+    /**
+     * \brief discards the decoded data and sets up the window. Only the last WINDOW_SIZE bytes are used. Shorter
+     *        windows are padded with zeroes at the front.
+     */
+    void resetOutput(const char *window, const std::size_t windowSize);
+
+    /**
+     * \brief discards the decoded data and fills the window with markers
+     */
+    void resetOutput();
+
+    /**
+     * \brief decodes units starting at start until reaching a Boundary at or past stopBit
+     */
+    Status decode(const Boundary &start, const boost::uint64_t stopBit);
+
+    /**
+     * \brief finds the first bit in [fromBit, toBit) from which at least one unit decodes and continues decoding
+     *        up to stopBit. Output starts with markers. The resulting begin() is where the unit was found.
+     *
+     * \return Invalid if no such bit exists
+     */
+    Status decodeFromFirstBoundary(const boost::uint64_t fromBit, const boost::uint64_t toBit, const boost::uint64_t stopBit);
+
+    const Boundary &begin() const {return begin_;}
+    const Boundary &end() const {return end_;}
+
+    /// decoded symbols preceded by WINDOW_SIZE symbols of the window
+    const Symbol *output() const {return &output_.front();}
+    std::size_t outputSize() const {return outputSize_;}
+    /// number of decoded symbols, not counting the window
+    std::size_t decodedSize() const {return outputSize_ - WINDOW_SIZE;}
+
+    const std::vector<MemberEnd> &memberEnds() const {return memberEnds_;}
+
+private:
+    struct HuffmanTable
+    {
+        HuffmanTable() : maxLength_(0), table_(1 << MAX_CODE_LENGTH, 0) {}
+        static const unsigned MAX_CODE_LENGTH = 15;
+        unsigned maxLength_;
+        /// indexed by maxLength_ bits of input. (symbol << 4) | code length, 0 for invalid codes.
+        std::vector<boost::uint16_t> table_;
+
+        bool build(const unsigned char *lengths, const unsigned count, const bool allowIncomplete);
+    };
+
+    const unsigned char *data_;
+    boost::uint64_t sizeBits_;
+    boost::uint64_t pos_;
+
+    Boundary begin_;
+    Boundary end_;
+    std::vector<Symbol> output_;
+    std::size_t outputSize_;
+    std::vector<MemberEnd> memberEnds_;
+
+    HuffmanTable literalLengths_;
+    HuffmanTable distances_;
+    HuffmanTable codeLengths_;
+
+    static const HuffmanTable &fixedLiteralLengths();
+    static const HuffmanTable &fixedDistances();
+
+    void discardOutput();
+    bool isMemberHeader(const boost::uint64_t bit) const;
+    bool isPlausibleBoundary(const boost::uint64_t bit) const;
+
+    Status decodeMemberHeader();
+    Status decodeMemberTrailer();
+    Status decodeBlock(bool &final);
+    Status decodeStoredBlock();
+    Status decodeDynamicTables();
+    Status decodeCompressedData(const HuffmanTable &literalLengths, const HuffmanTable &distances);
+
+    bool available(const unsigned bits) const {return sizeBits_ >= pos_ + bits;}
+
+    /// requires INPUT_PADDING readable bytes past the data. bits <= 32. Relies on little-endian byte order.
+    boost::uint32_t peek(const boost::uint64_t bit, const unsigned bits) const
+    {
+        boost::uint64_t word = 0;
+        memcpy(&word, data_ + (bit >> 3), sizeof(word));
+        return (word >> (bit & 7)) & ((boost::uint64_t(1) << bits) - 1);
+    }
+
+    boost::uint32_t peek(const unsigned bits) const {return peek(pos_, bits);}
+
+    boost::uint32_t read(const unsigned bits)
+    {
+        const boost::uint32_t ret = peek(bits);
+        pos_ += bits;
+        return ret;
+    }
+
+    void reserveOutput(const std::size_t symbols)
+    {
+        if (output_.size() < outputSize_ + symbols)
+        {
+            output_.resize(std::max(output_.size() * 2, outputSize_ + symbols));
+        }
+    }
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_DEFLATE_DECODER_HH
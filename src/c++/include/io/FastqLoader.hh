@@ -34,6 +34,8 @@ namespace io
 class FastqLoader
 {
     const unsigned inputLoadersMax_;
+    // false to decompress plain gzip with zlib on a single thread
+    const bool parallelGzip_;
     std::vector<boost::shared_ptr<FastqReader> >  readReaders_;
     bool paired_;
     common::ThreadVector &threads_;
@@ -49,8 +51,10 @@ public:
         const bool allowVariableLength,
         const std::size_t maxPathLength,
         common::ThreadVector &threads,
-        const unsigned inputLoadersMax) :
+        const unsigned inputLoadersMax,
+        const bool parallelGzip) :
         inputLoadersMax_(inputLoadersMax),
+        parallelGzip_(parallelGzip),
         // notice that single-ended fastq will use only half the allowed threads to decompress bgzf.
         // That is not correct way to do it, but not particularly important. We mainly care here for
         // inputLoadersMax_=1 scenario which is important for debugging and such.
@@ -180,7 +184,8 @@ private:
 
     void initializeReaderThread(const int threadNumber, const bool allowVariableLength, const std::size_t maxPathLength)
     {
-        readReaders_.at(threadNumber).reset(new FastqReader(allowVariableLength, std::max(1U, inputLoadersMax_/2), maxPathLength));
+        readReaders_.at(threadNumber).reset(
+            new FastqReader(allowVariableLength, std::max(1U, inputLoadersMax_/2), parallelGzip_, maxPathLength));
     }
 };
 
@@ -27,14 +27,18 @@
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/type_traits/is_same.hpp>
 
 #include "../common/StaticVector.hh"
 #include "bgzf/BgzfReader.hh"
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
+#include "common/MemoryMappedFile.hh"
 #include "flowcell/ReadMetadata.hh"
 #include "io/InflateGzipDecompressor.hh"
 #include "io/FileBufCache.hh"
+#include "io/ParallelGzipReader.hh"
+#include "oligo/BclPacking.hh"
 #include "oligo/Nucleotides.hh"
 
 namespace isaac
@@ -53,6 +57,26 @@ public:
         common::IsaacException(EINVAL, message){}
 };
 
+/**
+ * \brief Random access char iterators (pointers and vector iterators) can be written through a plain pointer.
+ *        Everything else gets the bcl one byte at a time.
+ */
+template <typename InsertIt,
+    bool contiguous = boost::is_same<typename std::iterator_traits<InsertIt>::iterator_category, std::random_access_iterator_tag>::value &&
+        boost::is_same<typename std::iterator_traits<InsertIt>::value_type, char>::value>
+struct BclStorage
+{
+    static char *get(const InsertIt &) {return 0;}
+    static void advance(InsertIt &, const std::size_t) {}
+};
+
+template <typename InsertIt>
+struct BclStorage<InsertIt, true>
+{
+    static char *get(const InsertIt &it) {return &*it;}
+    static void advance(InsertIt &it, const std::size_t n) {it += n;}
+};
+
 class FastqReader
 {
 public:
@@ -61,6 +85,8 @@ public:
     // give each thread a chance to unpack a sensible number of bgzf blocks. Otherwise thread synchronization
     // slows the whole thing down
     static const unsigned BGZF_BLOCKS_PER_THREAD = 1024;
+    // mapped pages behind the current record are released in steps of this size to keep the resident set small
+    static const std::size_t MAPPED_RELEASE_BYTES = 64UL * 1024 * 1024;
 
 private:
     const std::size_t uncompressedBufferSize_;
@@ -69,8 +95,12 @@ private:
 
     FileBufWithReopen fileBuffer_;
     typedef std::vector<char> BufferType;
+    typedef const char * DataIterator;
     io::InflateGzipDecompressor<BufferType> gzReader_;
     bgzf::ParallelBgzfReader bgzfReader_;
+    // plain gzip is inflated with zlib on a single thread unless the parallel reader is allowed more threads
+    const bool parallelGz_;
+    io::ParallelGzipReader parallelGzReader_;
 
     //boost::filesystem::path forces intermediate string construction during reassignment...
     std::string fastqPath_;
@@ -79,19 +109,31 @@ private:
     bool reachedEof_;
     std::size_t filePos_;
 
+    // uncompressed fastq in regular files is parsed directly from the mapping instead of being copied into buffer_
+    common::MemoryMappedFile mappedFile_;
+    bool mapped_;
+    std::size_t releasedBytes_;
+
     BufferType buffer_;
-    BufferType::const_iterator headerBegin_;
-    BufferType::const_iterator headerEnd_;
-    BufferType::const_iterator baseCallsBegin_;
-    BufferType::const_iterator baseCallsEnd_;
-    BufferType::const_iterator qScoresBegin_;
-    BufferType::const_iterator endIt_;
+    // the data being parsed. Either the mapped file or the filled part of buffer_
+    DataIterator dataBegin_;
+    DataIterator dataEnd_;
+    DataIterator headerBegin_;
+    DataIterator headerEnd_;
+    DataIterator baseCallsBegin_;
+    DataIterator baseCallsEnd_;
+    DataIterator qScoresBegin_;
+    DataIterator endIt_;
     bool zeroLengthRead_;
 
     static const oligo::Translator<true, INCORRECT_FASTQ_BASE> translator_;
 
 public:
-    FastqReader(const bool allowVariableLength, const unsigned threadsMax, const std::size_t maxPathLength);
+    /**
+     * \param parallelGzip  false to decompress plain gzip with zlib even when more than one thread is allowed
+     */
+    FastqReader(
+        const bool allowVariableLength, const unsigned threadsMax, const bool parallelGzip, const std::size_t maxPathLength);
 
     void open(const boost::filesystem::path &fastqPath, const char q0Base);
 
@@ -115,10 +157,10 @@ public:
 
     bool hasData() const
     {
-        return (!reachedEof_ || buffer_.end() != headerBegin_);
+        return (!reachedEof_ || dataEnd_ != headerBegin_);
     }
 
-    typedef std::pair<BufferType::const_iterator, BufferType::const_iterator > IteratorPair;
+    typedef std::pair<DataIterator, DataIterator > IteratorPair;
     IteratorPair getHeader() const
     {
         return std::make_pair(headerBegin_, headerEnd_);
@@ -133,7 +175,9 @@ private:
     typedef boost::error_info<struct tag_errmsg, std::string> errmsg_info;
 
     void resetBuffer();
-    std::size_t getOffset(BufferType::const_iterator it) const;
+    void mapFile();
+    void releaseMapped();
+    std::size_t getOffset(DataIterator it) const;
     void findHeader();
     void findSequence();
     void findQScores();
@@ -149,10 +193,30 @@ template <typename InsertIt>
 InsertIt FastqReader::extractBcl(const flowcell::ReadMetadata &readMetadata, InsertIt it) const
 {
     const InsertIt start = it;
-    BufferType::const_iterator baseCallsIt = baseCallsBegin_;
-    BufferType::const_iterator qScoresIt = qScoresBegin_;
+    DataIterator baseCallsIt = baseCallsBegin_;
+    DataIterator qScoresIt = qScoresBegin_;
     std::vector<unsigned>::const_iterator cycleIterator = readMetadata.getCycles().begin();
     unsigned currentCycle = readMetadata.getFirstReadCycle();
+
+    // reads without gaps in the cycles get packed in bulk. Whatever the kernel stops at is left to the loop below
+    const std::vector<unsigned> &cycles = readMetadata.getCycles();
+    char *bcl = cycles.empty() ? 0 : BclStorage<InsertIt>::get(it);
+    if (bcl && cycles.back() - cycles.front() + 1 == cycles.size() && cycles.front() >= currentCycle)
+    {
+        const std::size_t skip = cycles.front() - currentCycle;
+        const std::size_t available = std::distance(qScoresBegin_, endIt_);
+        if (available > skip)
+        {
+            const std::size_t packed = oligo::packBcl(
+                baseCallsBegin_ + skip, qScoresBegin_ + skip, std::min(cycles.size(), available - skip), q0Base_, bcl);
+            baseCallsIt += skip + packed;
+            qScoresIt += skip + packed;
+            currentCycle += skip + packed;
+            cycleIterator += packed;
+            BclStorage<InsertIt>::advance(it, packed);
+        }
+    }
+
     for(;endIt_ != qScoresIt && readMetadata.getCycles().end() != cycleIterator; ++baseCallsIt, ++qScoresIt, ++currentCycle)
     {
 //        ISAAC_THREAD_CERR << "cycle " << *cycleIterator << std::endl;
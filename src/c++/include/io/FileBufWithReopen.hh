@@ -34,6 +34,10 @@ namespace io
 
 extern const std::vector<const char*> iosBaseToStdioOpenModesTranslationTable;
 
+/// Opened to hold on to a file handle while no real file is open in it
+// TODO: make it windows-compatible
+static const char * const fileThatAlwaysExists = "/dev/null";
+
 template<typename _CharT, typename _Traits = std::char_traits<_CharT> >
 class basic_FileBufWithReopen : public std::basic_filebuf<_CharT, _Traits>
 {
@@ -164,8 +168,6 @@ public:
      */
     bool reserve()
     {
-        // TODO: make it windows-compatible
-        static const char * const fileThatAlwaysExists = "/dev/null";
         return !!this->open(fileThatAlwaysExists, mode_);
     }
 
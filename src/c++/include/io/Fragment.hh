@@ -95,7 +95,8 @@ struct FragmentHeader
         clusterY_(POSITION_NOT_SET),
         duplicateClusterRank_(0),
         mateAnchor_(0),
-        mateStorageBin_(0)
+        mateStorageBin_(0),
+        mateDataOffset_(0)
     {
     }
 
@@ -144,7 +145,8 @@ struct FragmentHeader
         clusterY_(fragment.getCluster().getXy().isSet() ? fragment.getCluster().getXy().y_ : POSITION_NOT_SET),
         duplicateClusterRank_(getTemplateDuplicateRank(bamTemplate)),
         mateAnchor_(mate),
-        mateStorageBin_(mateStorageBin)
+        mateStorageBin_(mateStorageBin),
+        mateDataOffset_(0)
         //, magic_(magicValue_)
     {
     }
@@ -187,7 +189,8 @@ struct FragmentHeader
         clusterY_(fragment.getCluster().getXy().isSet() ? fragment.getCluster().getXy().y_ : POSITION_NOT_SET),
         duplicateClusterRank_(0),
         mateAnchor_(0),
-        mateStorageBin_(0)
+        mateStorageBin_(0),
+        mateDataOffset_(0)
         //, magic_(magicValue_)
     {
     }
@@ -420,10 +423,18 @@ struct FragmentHeader
     FragmentIndexAnchor mateAnchor_;
 
     unsigned mateStorageBin_;
+
+    /**
+     * \brief offset of the mate in the bin data buffer. Assigned when the bin is loaded for the build. Occupies what
+     *        would otherwise be the tail padding of the header. See PackedFragmentBuffer::storeMateDataOffset for
+     *        bins that don't fit 32 bit offsets.
+     */
+    unsigned mateDataOffset_;
 //    unsigned short magic_;
 //    static const unsigned short magicValue_ = 0xb1a;
 
 };
+BOOST_STATIC_ASSERT(112 == sizeof(FragmentHeader));
 
 inline std::ostream & operator <<(std::ostream &os, const FragmentHeader::Flags &headerFlags)
 {
@@ -0,0 +1,104 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ParallelGzipReader.hh
+ **
+ ** Multithreaded decompression of ordinary (non-bgzf) gzip streams.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_PARALLEL_GZIP_READER_HH
+#define iSAAC_IO_PARALLEL_GZIP_READER_HH
+
+#include <istream>
+#include <vector>
+
+#include "common/Threads.hpp"
+#include "io/DeflateDecoder.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Decompresses gzip streams that don't carry block sizes the way bgzf does.
+ *
+ *        Each pass loads up to coresMax * CHUNK_SIZE bytes of compressed data and splits them evenly between
+ *        threads. The first thread continues from the last known position with the known window. The others
+ *        look for the first gzip member or deflate block that decodes from their split point and decode it
+ *        speculatively with markers in place of the unknown window. Chunks are accepted in order for as long as
+ *        each one starts exactly where the previous one stopped. The window of each accepted chunk is then
+ *        resolved from the tail of the previous one and the chunks are resolved into the plain text in parallel.
+ *        Whatever is not accepted gets decoded again on the next pass, so a wrong guess costs time, not data.
+ *
+ *        Member CRC32 and ISIZE are verified.
+ */
+class ParallelGzipReader
+{
+public:
+    /// compressed bytes per thread per pass
+    static const std::size_t CHUNK_SIZE = 1024 * 1024;
+
+    explicit ParallelGzipReader(const unsigned coresMax);
+
+    /**
+     * \brief prepares for decompression of a new stream
+     */
+    void reset();
+
+    std::size_t readMoreData(std::istream &is, char *buffer, const std::size_t capacity);
+    bool isEof() const {return streamEnd_ && uncompressed_.size() == uncompressedPos_;}
+
+private:
+    typedef DeflateDecoder::Boundary Boundary;
+    typedef std::pair<boost::uint32_t, std::size_t> CrcSegment;
+
+    const unsigned coresMax_;
+    common::ThreadVector threads_;
+    std::vector<DeflateDecoder> decoders_;
+    std::vector<DeflateDecoder::Status> statuses_;
+    /// window preceding each of the accepted chunks plus the one following the last accepted chunk
+    std::vector<std::vector<char> > windows_;
+    /// crc and length of the data between member ends of each chunk
+    std::vector<std::vector<CrcSegment> > crcSegments_;
+    std::vector<std::size_t> uncompressedOffsets_;
+
+    std::vector<unsigned char> compressed_;
+    std::size_t compressedSize_;
+    /// offset of compressed_ in the stream
+    boost::uint64_t compressedOffset_;
+    bool inputEof_;
+    bool streamEnd_;
+    /// where the next pass starts, relative to compressed_
+    Boundary next_;
+
+    std::vector<char> uncompressed_;
+    std::size_t uncompressedPos_;
+
+    boost::uint32_t memberCrc_;
+    boost::uint64_t memberSize_;
+
+    void loadCompressed(std::istream &is);
+    void decompressMore(std::istream &is);
+    void decodeChunk(const unsigned threadNumber, const unsigned chunks);
+    unsigned acceptChunks(const unsigned chunks) const;
+    void resolveWindows(const unsigned chunks);
+    void resolveChunk(const unsigned threadNumber, const unsigned chunks);
+    void verifyMembers(const unsigned chunks);
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_PARALLEL_GZIP_READER_HH
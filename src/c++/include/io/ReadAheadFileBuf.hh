@@ -0,0 +1,90 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ReadAheadFileBuf.hh
+ **
+ ** Input streambuf that keeps reads of the following blocks in flight while the current one is consumed.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_READ_AHEAD_FILE_BUF_HH
+#define iSAAC_IO_READ_AHEAD_FILE_BUF_HH
+
+#include <streambuf>
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "io/AsyncFileIo.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Sequential reader on top of AsyncFileIo. Reads larger than a block bypass the buffer and go straight into
+ *        the destination as a number of concurrent requests. Seeking discards the read-ahead.
+ *
+ *        On failure the stream operations fail and errno is set to the error of the failed request.
+ */
+class ReadAheadFileBuf: public std::streambuf, boost::noncopyable
+{
+public:
+    static const std::size_t BLOCK_BYTES = 1024 * 1024;
+    static const unsigned BLOCKS = 4;
+    /// size of requests going straight into the destination of large reads
+    static const std::size_t DIRECT_READ_BYTES = 4 * BLOCK_BYTES;
+    static const std::size_t MEMORY_REQUIREMENTS = BLOCK_BYTES * BLOCKS;
+
+    explicit ReadAheadFileBuf(AsyncFileIo &asyncIo);
+    ~ReadAheadFileBuf();
+
+    /**
+     * \return 0 on failure, errno is set
+     */
+    ReadAheadFileBuf *open(const char *path);
+    bool is_open() const {return -1 != fd_;}
+
+protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+    virtual int_type underflow();
+    virtual std::streamsize xsgetn(char_type *s, std::streamsize n);
+
+private:
+    AsyncFileIo &asyncIo_;
+    int fd_;
+    uint64_t fileSize_;
+    std::vector<char> buffer_;
+    boost::array<AsyncFileIo::Batch, BLOCKS> batches_;
+    // file offset of block 0
+    uint64_t start_;
+    // number of the block in the get area + 1. 0 when nothing is
+    uint64_t consumed_;
+    // number of the next block to request
+    uint64_t submitted_;
+
+    uint64_t blockOffset(const uint64_t block) const {return start_ + block * BLOCK_BYTES;}
+    char *blockData(const uint64_t block) {return &buffer_[block % BLOCKS * BLOCK_BYTES];}
+    uint64_t position() const;
+    void submitAhead();
+    void discardAhead();
+    void restart(const uint64_t position);
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_READ_AHEAD_FILE_BUF_HH
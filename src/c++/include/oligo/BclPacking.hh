@@ -0,0 +1,69 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BclPacking.hh
+ **
+ ** Conversion of fastq base calls and quality scores into bcl bytes.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OLIGO_BCL_PACKING_HH
+#define iSAAC_OLIGO_BCL_PACKING_HH
+
+#include <cstddef>
+
+namespace isaac
+{
+namespace oligo
+{
+
+enum BclPackingKernel
+{
+    BclPackingScalar,
+    BclPackingSse2,
+    BclPackingAvx2,
+    BclPackingKernelCount
+};
+
+const char *getBclPackingKernelName(const BclPackingKernel kernel);
+
+bool isBclPackingKernelSupported(const BclPackingKernel kernel);
+
+/**
+ * \brief the widest kernel allowed by common::getCpuIsa()
+ */
+BclPackingKernel getBestBclPackingKernel();
+
+/**
+ * \brief Packs base calls and quality scores into bcl bytes: base in the lower two bits and quality - q0 in the
+ *        upper six. N (either case) becomes 0 regardless of its quality.
+ *
+ *        Stops at the first position that needs attention: a base other than ACGTN in either case or a quality
+ *        outside [q0, q0 + 63]. Positions past the returned one may or may not have been written to.
+ *
+ * \return number of leading positions packed
+ */
+std::size_t packBcl(
+    const BclPackingKernel kernel,
+    const char *bases, const char *qualities, const std::size_t length, const char q0, char *bcl);
+
+inline std::size_t packBcl(const char *bases, const char *qualities, const std::size_t length, const char q0, char *bcl)
+{
+    static const BclPackingKernel kernel = getBestBclPackingKernel();
+    return packBcl(kernel, bases, qualities, length, q0, bcl);
+}
+
+} // namespace oligo
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OLIGO_BCL_PACKING_HH
@@ -0,0 +1,60 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file KmerPacking.hh
+ **
+ ** Packing of bcl bytes into k-mer bits.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OLIGO_KMER_PACKING_HH
+#define iSAAC_OLIGO_KMER_PACKING_HH
+
+#include <stdint.h>
+
+#include "common/CpuIsa.hh"
+
+namespace isaac
+{
+namespace oligo
+{
+
+/// packBclKmer produces up to 64 bits of k-mer
+static const unsigned BCL_KMER_BASES_MAX = 32;
+
+/**
+ * \brief Takes the base out of each of length bcl bytes and packs them two bits per base, the first base in the
+ *        most significant bits, the way KmerGenerator does.
+ *
+ * \return false if any of the bases has quality below qualityMin. kmer is undefined in this case.
+ */
+typedef bool (*PackBclKmer)(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer);
+
+/**
+ * \return the widest implementation of packBclKmer that does not exceed isa
+ */
+PackBclKmer getPackBclKmer(const common::CpuIsa isa);
+
+/**
+ * \param length must not exceed BCL_KMER_BASES_MAX
+ */
+inline bool packBclKmer(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer)
+{
+    static const PackBclKmer kernel = getPackBclKmer(common::getCpuIsa());
+    return kernel(bcl, length, qualityMin, kmer);
+}
+
+} // namespace oligo
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OLIGO_KMER_PACKING_HH
@@ -25,7 +25,11 @@
 #include <boost/regex.hpp>
 
 #include "alignment/SeedMetadata.hh"
+#include "bgzf/BgzfDeflater.hh"
 #include "build/GapRealigner.hh"
+#include "common/CpuIsa.hh"
+#include "common/HugePages.hh"
+#include "io/AsyncFileIo.hh"
 #include "common/Program.hh"
 #include "flowcell/BarcodeMetadata.hh"
 #include "flowcell/Layout.hh"
@@ -53,6 +57,11 @@ private:
     build::GapRealignerMode parseGapRealignment();
     void parseExecutionTargets();
     void parseMemoryControl();
+    void parseHugePages();
+    void parseAsyncIo();
+    void parseCpuIsa();
+    void parseBamDeflateBackend();
+    void parseDuplicateGrouping();
     void parseGapScoring();
     void parseUseSmithWaterman();
     workflow::AlignWorkflow::OptionalFeatures parseBamExcludeTags(std::string strBamExcludeTags);
@@ -64,6 +73,7 @@ private:
     void parseStatsImageFormat();
     void parseQScoreBinValues();
     void parseBamExcludeTags();
+    void parsePipelineBuild();
     void processLegacyOptions(boost::program_options::variables_map &vm);
 
 public:
@@ -100,6 +110,13 @@ public:
     // the list of seed metadata
     unsigned jobs;
     bool enableNuma;
+    std::string hugePagesString;
+    common::HugePagesMode hugePages;
+    std::string asyncIoString;
+    io::AsyncFileIoBackend asyncIo;
+    unsigned asyncIoQueueDepth;
+    std::string cpuIsaString;
+    common::CpuIsa cpuIsa;
     unsigned seedBaseQualityMin;
     unsigned repeatThreshold;
     int mateDriftRange;
@@ -131,6 +148,7 @@ public:
     bool rescueShadows;
     unsigned gappedMismatchesMax;
     unsigned smitWatermanGapsMax;
+    unsigned smithWatermanBandWidth;
     std::string useSmithWaterman;
     bool smartSmithWaterman;
     bool noSmithWaterman;
@@ -149,6 +167,7 @@ public:
     uint64_t memoryLimit;
     static const uint64_t memoryLimitUnlimited = 0;
     unsigned inputLoadersMax;
+    bool parallelGzip;
     unsigned tempSaversMax;
     unsigned tempLoadersMax;
     unsigned outputSaversMax;
@@ -156,12 +175,16 @@ public:
     build::GapRealignerMode realignGaps;
     boost::filesystem::path knownIndelsPath;
     int bamGzipLevel;
+    std::string bamDeflateBackendString;
+    bgzf::DeflateBackend bamDeflateBackend;
     std::vector<std::string> bamHeaderTags;
     std::string bamPuFormat;
     bool bamProduceMd5;
     double expectedBgzfCompressionRatio;
     bool singleLibrarySamples;
     bool keepDuplicates;
+    std::string duplicateGroupingString;
+    build::DuplicateGroupingMode duplicateGrouping;
     bool markDuplicates;
     bool anchorMate;
     std::string binRegexString;
@@ -172,12 +195,17 @@ public:
     std::string statsImageFormatString;
     reports::AlignmentReportGenerator::ImageFileFormat statsImageFormat;
     bool bufferBins;
+    bool referenceHashCache;
+    bool referenceHashNumaReplicas;
+    bool annotationCache;
+    bool annotationNumaReplicas;
     bool qScoreBin;
     std::string qScoreBinValueString;
     boost::array<char, 256> fullBclQScoreTable;
     std::string bamExcludeTags;
     workflow::AlignWorkflow::OptionalFeatures optionalFeatures;
     bool pessimisticMapQ;
+    bool pipelineBuild;
 };
 
 } // namespace options
@@ -0,0 +1,62 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchOptions.hh
+ **
+ ** Command line options for 'isaac-bench'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OPTIONS_BENCH_OPTIONS_HH
+#define iSAAC_OPTIONS_BENCH_OPTIONS_HH
+
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+class BenchOptions : public common::Options
+{
+public:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path outputFile_;
+    unsigned threads_;
+    unsigned seed_;
+    unsigned repeats_;
+    uint64_t referenceLength_;
+    unsigned contigs_;
+    unsigned clusters_;
+    unsigned readLength_;
+    unsigned bamGzipLevel_;
+
+public:
+    BenchOptions();
+
+private:
+    std::string usagePrefix() const
+    {
+        return "isaac-bench [options]\n"
+            "isaac-bench seed-lookup|bcl-packing|radix-sort [options]";
+    }
+    void postProcess(boost::program_options::variables_map &vm);
+};
+
+} // namespace options
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OPTIONS_BENCH_OPTIONS_HH
@@ -0,0 +1,47 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkRadixSortOptions.hh
+ **
+ ** Command line options for 'isaac-bench radix-sort'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OPTIONS_BENCHMARK_RADIX_SORT_OPTIONS_HH
+#define iSAAC_OPTIONS_BENCHMARK_RADIX_SORT_OPTIONS_HH
+
+#include "common/Program.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+class BenchmarkRadixSortOptions : public isaac::common::Options
+{
+public:
+    BenchmarkRadixSortOptions();
+private:
+    std::string usagePrefix() const {return "isaac-bench radix-sort";}
+    void postProcess(boost::program_options::variables_map &vm);
+public:
+    unsigned threads;
+    uint64_t records;
+    uint64_t binLength;
+    unsigned repeats;
+};
+
+} // namespace options
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OPTIONS_BENCHMARK_RADIX_SORT_OPTIONS_HH
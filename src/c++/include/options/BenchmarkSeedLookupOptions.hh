@@ -0,0 +1,52 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkSeedLookupOptions.hh
+ **
+ ** Command line options for 'isaac-bench seed-lookup'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OPTIONS_BENCHMARK_SEED_LOOKUP_OPTIONS_HH
+#define iSAAC_OPTIONS_BENCHMARK_SEED_LOOKUP_OPTIONS_HH
+
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+class BenchmarkSeedLookupOptions : public isaac::common::Options
+{
+public:
+    BenchmarkSeedLookupOptions();
+private:
+    std::string usagePrefix() const {return "isaac-bench seed-lookup";}
+    void postProcess(boost::program_options::variables_map &vm);
+public:
+    boost::filesystem::path sortedReferenceXml;
+    unsigned threads;
+    unsigned clusters;
+    unsigned readLength;
+    unsigned rounds;
+    unsigned prefetchClustersAhead;
+};
+
+} // namespace options
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OPTIONS_BENCHMARK_SEED_LOOKUP_OPTIONS_HH
@@ -0,0 +1,55 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file FindAllNeighborsOptions.hh
+ **
+ ** \brief Command line options for findAllNeighbors
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OPTIONS_FIND_ALL_NEIGHBORS_OPTIONS_HH
+#define iSAAC_OPTIONS_FIND_ALL_NEIGHBORS_OPTIONS_HH
+
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+class FindAllNeighborsOptions : public isaac::common::Options
+{
+public:
+    FindAllNeighborsOptions();
+    common::Options::Action parse(int argc, char *argv[]);
+private:
+    std::string usagePrefix() const {return "findAllNeighbors";}
+    void postProcess(boost::program_options::variables_map &vm);
+public:
+    std::vector<unsigned> seedLengths;
+    unsigned maskWidth;
+    boost::filesystem::path referenceGenome;
+    boost::filesystem::path uniquenessFile;
+    boost::filesystem::path repeatnessFile;
+    unsigned jobs;
+    uint64_t memoryLimit;
+};
+
+} // namespace options
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OPTIONS_FIND_ALL_NEIGHBORS_OPTIONS_HH
@@ -45,6 +45,7 @@ public:
     boost::filesystem::path genomeNeighborsFile;
     boost::filesystem::path outFile;
     unsigned int repeatThreshold;
+    uint64_t memoryLimit;
 };
 
 } // namespace options
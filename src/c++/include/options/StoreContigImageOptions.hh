@@ -0,0 +1,49 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file StoreContigImageOptions.hh
+ **
+ ** Command line options for 'storeContigImage'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OPTIONS_STORE_CONTIG_IMAGE_OPTIONS_HH
+#define iSAAC_OPTIONS_STORE_CONTIG_IMAGE_OPTIONS_HH
+
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+class StoreContigImageOptions : public isaac::common::Options
+{
+public:
+    StoreContigImageOptions();
+private:
+    std::string usagePrefix() const {return "storeContigImage";}
+    void postProcess(boost::program_options::variables_map &vm);
+public:
+    boost::filesystem::path referenceGenome;
+    boost::filesystem::path outputFile;
+    unsigned jobs;
+};
+
+} // namespace options
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OPTIONS_STORE_CONTIG_IMAGE_OPTIONS_HH
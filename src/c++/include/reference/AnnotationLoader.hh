@@ -67,7 +67,13 @@ AnnotationType loadAnnotationBlob(const boost::filesystem::path &path, const std
     return ret;
 }
 
-ContigAnnotationsList loadAnnotations(const reference::SortedReferenceMetadataList &sortedReferenceMetadataList);
+/**
+ * \param annotationCache if set, the annotations are mapped read-only from a cache file so that all processes
+ *                        on the host share one copy in the page cache. The cache file is produced on first use.
+ */
+ContigAnnotationsList loadAnnotations(
+    const reference::SortedReferenceMetadataList &sortedReferenceMetadataList,
+    const bool annotationCache);
 
 
 } // namespace reference
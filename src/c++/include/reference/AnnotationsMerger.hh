@@ -21,6 +21,8 @@
 #ifndef iSAAC_REFERENCE_ANNOTATIONS_MERGER_HH
 #define iSAAC_REFERENCE_ANNOTATIONS_MERGER_HH
 
+#include <algorithm>
+
 #include <boost/iostreams/device/file.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -37,6 +39,35 @@ namespace reference
 
 namespace bfs = boost::filesystem;
 
+/**
+ * \brief 0 if merged has no neighbors and toMerge has no more than max of them. NEIGHBORS_TOO_MANY otherwise
+ */
+inline NeighborsCount zeroAndLeq(
+    const NeighborsCount merged,
+    const NeighborsCount toMerge,
+    const NeighborsCount max)
+{
+    NeighborsCount ret = (NeighborsCount(0) == merged && max >= toMerge) ?
+        NeighborsCount(0) : NEIGHBORS_TOO_MANY;
+
+    return ret;
+}
+
+/**
+ * \brief Caps the distance at mask for positions that have no neighbors at the seed length equal to mask
+ */
+inline DistanceToBeNeighborless mask(
+        const DistanceToBeNeighborless merged,
+        const NeighborsCount toMerge,
+        DistanceToBeNeighborless mask)
+{
+    if (NeighborsCount(0) == toMerge)
+    {
+        return std::min(merged, mask);
+    }
+    return merged;
+}
+
 class AnnotationsMerger: boost::noncopyable
 {
 private:
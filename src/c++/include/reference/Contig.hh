@@ -20,77 +20,226 @@
 #ifndef iSAAC_REFERENCE_CONTIG_HH
 #define iSAAC_REFERENCE_CONTIG_HH
 
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include <boost/cstdint.hpp>
+
 #include "common/Debug.hh"
 #include "common/NumaContainer.hh"
 #include "common/SameAllocatorVector.hh"
+#include "oligo/Nucleotides.hh"
 
 namespace isaac
 {
 namespace reference
 {
 
-template <typename AllocatorT>
-struct BasicContig : public std::vector<char, AllocatorT>
+namespace packedContig
 {
-    unsigned index_;
-    std::string name_;
-    typedef std::vector<char, AllocatorT> BaseT;
 
-    BasicContig(const AllocatorT &allocator) : BaseT(allocator),
-        index_(0), name_()
+typedef boost::uint64_t Word;
+/// bases stored in one Word of packed bases
+static const unsigned BASES_PER_WORD = sizeof(Word) * 8 / 2;
+/// N flags stored in one Word of the N mask
+static const unsigned N_FLAGS_PER_WORD = sizeof(Word) * 8;
+
+/**
+ * \brief anything other than ACGT is stored as N
+ */
+inline bool isPackedN(const char base)
+{
+    return 'A' != base && 'C' != base && 'G' != base && 'T' != base;
+}
+
+inline Word packBase(const char base)
+{
+    switch (base)
     {
-//        ISAAC_THREAD_CERR << "BasicContig(const AllocatorT &allocator)" << std::endl;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default: return 0;
     }
+}
 
-    ~BasicContig()
+inline char unpackBase(const Word bits)
+{
+    static const char bases[] = {'A', 'C', 'G', 'T'};
+    return bases[bits & 3];
+}
+
+/**
+ * \brief spreads the lower 32 bits of value so that bit i lands at bit 2*i. Turns N flags into 2-bit lane masks.
+ */
+inline Word spreadBits(Word value)
+{
+    value &= 0x00000000FFFFFFFFULL;
+    value = (value | (value << 16)) & 0x0000FFFF0000FFFFULL;
+    value = (value | (value << 8)) & 0x00FF00FF00FF00FFULL;
+    value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    value = (value | (value << 2)) & 0x3333333333333333ULL;
+    value = (value | (value << 1)) & 0x5555555555555555ULL;
+    return value;
+}
+
+/**
+ * \brief Packs up to BASES_PER_WORD sequence bases into the bases word and the N flags
+ */
+template <typename IteratorT>
+void packWord(IteratorT begin, const IteratorT end, Word &bases, Word &nFlags)
+{
+    bases = 0;
+    nFlags = 0;
+    for (unsigned i = 0; end != begin && BASES_PER_WORD > i; ++i, ++begin)
     {
-//        ISAAC_THREAD_CERR << "~BasicContig(" << BaseT::size() << ")" << std::endl;
+        const char base = *begin;
+        bases |= packBase(base) << (i * 2);
+        nFlags |= Word(isPackedN(base)) << i;
     }
+}
 
-    BasicContig() :
-        index_(0), name_()
+/**
+ * \brief counts mismatches between two packed words of up to BASES_PER_WORD bases following the semantics of
+ *        alignment::isMatch: N in the sequence matches anything, N in the reference matches nothing.
+ *
+ * \param validMask  2-bit lane mask of the bases to compare
+ */
+inline unsigned countMismatches(
+    const Word sequenceBases, const Word sequenceNFlags,
+    const Word referenceBases, const Word referenceNFlags,
+    const Word validMask)
+{
+    const Word diff = sequenceBases ^ referenceBases;
+    const Word mismatchLanes = ((diff | (diff >> 1)) & 0x5555555555555555ULL) | spreadBits(referenceNFlags);
+    return __builtin_popcountll(mismatchLanes & ~spreadBits(sequenceNFlags) & validMask);
+}
+
+inline Word validLanesMask(const unsigned bases)
+{
+    return BASES_PER_WORD <= bases ? 0x5555555555555555ULL : ((Word(1) << (bases * 2)) - 1) & 0x5555555555555555ULL;
+}
+
+} // namespace packedContig
+
+/**
+ * \brief Contig bases packed two bits per base. Ns are kept in a separate bit mask and read back as
+ *        REFERENCE_OLIGO_N. Takes a quarter of the memory of one byte per base plus one bit per base for the mask.
+ *
+ * Bases are read through the decoding const_iterator or unpacked into a buffer with unpack. There is no write
+ * access to individual bases.
+ */
+template <typename AllocatorT>
+class BasicContig
+{
+    typedef packedContig::Word Word;
+    typedef typename AllocatorT::template rebind<Word>::other WordAllocator;
+    typedef std::vector<Word, WordAllocator> Words;
+
+public:
+    typedef AllocatorT allocator_type;
+    typedef char value_type;
+    typedef std::size_t size_type;
+
+    /**
+     * \brief Random access iterator that decodes the base on dereference
+     */
+    class const_iterator
+    {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef char value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const char *pointer;
+        typedef char reference;
+
+        const_iterator() : contig_(0), pos_(0) {}
+        const_iterator(const BasicContig &contig, const std::size_t pos) : contig_(&contig), pos_(pos) {}
+
+        char operator *() const {return (*contig_)[pos_];}
+        char operator [](const difference_type n) const {return (*contig_)[pos_ + n];}
+
+        const_iterator &operator ++() {++pos_; return *this;}
+        const_iterator operator ++(int) {const_iterator ret(*this); ++pos_; return ret;}
+        const_iterator &operator --() {--pos_; return *this;}
+        const_iterator operator --(int) {const_iterator ret(*this); --pos_; return ret;}
+        const_iterator &operator +=(const difference_type n) {pos_ += n; return *this;}
+        const_iterator &operator -=(const difference_type n) {pos_ -= n; return *this;}
+        const_iterator operator +(const difference_type n) const {return const_iterator(*contig_, pos_ + n);}
+        const_iterator operator -(const difference_type n) const {return const_iterator(*contig_, pos_ - n);}
+        friend const_iterator operator +(const difference_type n, const const_iterator &it) {return it + n;}
+        difference_type operator -(const const_iterator &that) const {return difference_type(pos_) - difference_type(that.pos_);}
+
+        bool operator ==(const const_iterator &that) const {return pos_ == that.pos_;}
+        bool operator !=(const const_iterator &that) const {return pos_ != that.pos_;}
+        bool operator <(const const_iterator &that) const {return pos_ < that.pos_;}
+        bool operator >(const const_iterator &that) const {return pos_ > that.pos_;}
+        bool operator <=(const const_iterator &that) const {return pos_ <= that.pos_;}
+        bool operator >=(const const_iterator &that) const {return pos_ >= that.pos_;}
+
+        /// unpacks length bases starting at the iterator position
+        void unpack(const std::size_t length, char *out) const {contig_->unpack(pos_, length, out);}
+        const BasicContig &getContig() const {return *contig_;}
+        std::size_t getPosition() const {return pos_;}
+
+    private:
+        const BasicContig *contig_;
+        std::size_t pos_;
+    };
+    typedef const_iterator iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    unsigned index_;
+    std::string name_;
+
+    BasicContig(const AllocatorT &allocator) :
+        index_(0), name_(), bases_(WordAllocator(allocator)), nFlags_(WordAllocator(allocator)), length_(0)
     {
-//        ISAAC_THREAD_CERR << "BasicContig()" << std::endl;
     }
 
-    BasicContig(const BasicContig &that) : BaseT(that),
-        index_(that.index_), name_(that.name_)
+    BasicContig() : index_(0), name_(), length_(0)
     {
-//        ISAAC_THREAD_CERR << "BasicContig(const BasicContig &that)" << std::endl;
     }
 
-    BasicContig(const BasicContig &that, const AllocatorT &allocator) : BaseT(that, allocator),
-        index_(that.index_), name_(that.name_)
+    BasicContig(const BasicContig &that) :
+        index_(that.index_), name_(that.name_), bases_(that.bases_), nFlags_(that.nFlags_), length_(that.length_)
     {
-//        ISAAC_THREAD_CERR << "BasicContig(const BasicContig &that, const AllocatorT &allocator)" << std::endl;
-        ;
     }
 
-    BasicContig(BasicContig &&that) : BaseT(std::move(that)),
-        index_(that.index_), name_(that.name_)
+    BasicContig(const BasicContig &that, const AllocatorT &allocator) :
+        index_(that.index_), name_(that.name_),
+        bases_(that.bases_.begin(), that.bases_.end(), WordAllocator(allocator)),
+        nFlags_(that.nFlags_.begin(), that.nFlags_.end(), WordAllocator(allocator)),
+        length_(that.length_)
     {
-//        ISAAC_THREAD_CERR << "BasicContig(BasicContig &&that)" << std::endl;
     }
 
+    BasicContig(BasicContig &&that) :
+        index_(that.index_), name_(that.name_), bases_(std::move(that.bases_)), nFlags_(std::move(that.nFlags_)),
+        length_(that.length_)
+    {
+        that.length_ = 0;
+    }
 
-    BasicContig(const unsigned index, const std::string &name) : index_(index), name_(name){;}
+    BasicContig(const unsigned index, const std::string &name) : index_(index), name_(name), length_(0){;}
     template <typename ContainerT>
-    BasicContig(const unsigned index, const std::string &name, const ContainerT &init) : index_(index), name_(name)
+    BasicContig(const unsigned index, const std::string &name, const ContainerT &init) :
+        index_(index), name_(name), length_(0)
     {
-        BaseT::assign(init.begin(), init.end());
+        assign(init.begin(), init.end());
     }
-    size_t getLength() const {return BaseT::size();}
 
     BasicContig & operator=(const BasicContig &that)
     {
         index_ = that.index_;
         name_ = that.name_;
-        BaseT::operator = (that);
-//        ISAAC_THREAD_CERR << "operator=(const BasicContig &that)" << std::endl;
+        bases_ = that.bases_;
+        nFlags_ = that.nFlags_;
+        length_ = that.length_;
         return *this;
     }
 
@@ -98,18 +247,224 @@ struct BasicContig : public std::vector<char, AllocatorT>
     {
         index_ = that.index_;
         name_ = that.name_;
-        BaseT::swap(that);
-//        ISAAC_THREAD_CERR << "operator=(BasicContig &&that)" << std::endl;
+        swap(that);
         return *this;
     }
 
+    void swap(BasicContig &that)
+    {
+        bases_.swap(that.bases_);
+        nFlags_.swap(that.nFlags_);
+        std::swap(length_, that.length_);
+    }
+
+    template <typename IteratorT>
+    void assign(IteratorT begin, const IteratorT end)
+    {
+        clear();
+        reserve(std::distance(begin, end));
+        for (; end != begin; ++begin)
+        {
+            push_back(*begin);
+        }
+    }
+
+    void push_back(const char base)
+    {
+        if (!(length_ % packedContig::BASES_PER_WORD))
+        {
+            bases_.push_back(0);
+        }
+        if (!(length_ % packedContig::N_FLAGS_PER_WORD))
+        {
+            nFlags_.push_back(0);
+        }
+        bases_.back() |= packedContig::packBase(base) << (length_ % packedContig::BASES_PER_WORD * 2);
+        nFlags_.back() |= Word(packedContig::isPackedN(base)) << (length_ % packedContig::N_FLAGS_PER_WORD);
+        ++length_;
+    }
+
+    /**
+     * \brief New bases read as A
+     */
+    void resize(const std::size_t length)
+    {
+        if (length < length_)
+        {
+            // keep the unused bits of the last words clear so that push_back can or into them
+            for (std::size_t pos = length; std::min(length_, getWords(length, packedContig::BASES_PER_WORD) *
+                packedContig::BASES_PER_WORD) > pos; ++pos)
+            {
+                bases_[pos / packedContig::BASES_PER_WORD] &= ~(Word(3) << (pos % packedContig::BASES_PER_WORD * 2));
+            }
+            for (std::size_t pos = length; std::min(length_, getWords(length, packedContig::N_FLAGS_PER_WORD) *
+                packedContig::N_FLAGS_PER_WORD) > pos; ++pos)
+            {
+                nFlags_[pos / packedContig::N_FLAGS_PER_WORD] &= ~(Word(1) << (pos % packedContig::N_FLAGS_PER_WORD));
+            }
+        }
+        bases_.resize(getWords(length, packedContig::BASES_PER_WORD), 0);
+        nFlags_.resize(getWords(length, packedContig::N_FLAGS_PER_WORD), 0);
+        length_ = length;
+    }
+
+    void reserve(const std::size_t length)
+    {
+        bases_.reserve(getWords(length, packedContig::BASES_PER_WORD));
+        nFlags_.reserve(getWords(length, packedContig::N_FLAGS_PER_WORD));
+    }
+
+    void clear()
+    {
+        bases_.clear();
+        nFlags_.clear();
+        length_ = 0;
+    }
+
+    char operator[](const std::size_t pos) const
+    {
+        return isN(pos) ? oligo::REFERENCE_OLIGO_N :
+            packedContig::unpackBase(bases_[pos / packedContig::BASES_PER_WORD] >> (pos % packedContig::BASES_PER_WORD * 2));
+    }
+
+    char at(const std::size_t pos) const
+    {
+        ISAAC_ASSERT_MSG(length_ > pos, "Position " << pos << " is outside of contig " << *this);
+        return (*this)[pos];
+    }
+
+    char front() const {return at(0);}
+    char back() const {return at(length_ - 1);}
+
+    bool isN(const std::size_t pos) const
+    {
+        return (nFlags_[pos / packedContig::N_FLAGS_PER_WORD] >> (pos % packedContig::N_FLAGS_PER_WORD)) & 1;
+    }
+
+    /**
+     * \brief decodes length bases starting at pos into out. This is what the aligners use to get a block of
+     *        the reference for the vectorized kernels that work on one byte per base.
+     */
+    void unpack(std::size_t pos, std::size_t length, char *out) const
+    {
+        ISAAC_ASSERT_MSG(length_ >= pos + length, "Unpacking " << length << " bases at " << pos << " overshoots " << *this);
+        while (length)
+        {
+            const std::size_t nWord = pos / packedContig::N_FLAGS_PER_WORD;
+            const std::size_t wordBases = std::min<std::size_t>(length, packedContig::N_FLAGS_PER_WORD - pos % packedContig::N_FLAGS_PER_WORD);
+            if (!(nFlags_[nWord] >> (pos % packedContig::N_FLAGS_PER_WORD)))
+            {
+                // no Ns till the end of the mask word
+                for (const char *end = out + wordBases; end != out; ++out, ++pos)
+                {
+                    *out = packedContig::unpackBase(
+                        bases_[pos / packedContig::BASES_PER_WORD] >> (pos % packedContig::BASES_PER_WORD * 2));
+                }
+            }
+            else
+            {
+                for (const char *end = out + wordBases; end != out; ++out, ++pos)
+                {
+                    *out = (*this)[pos];
+                }
+            }
+            length -= wordBases;
+        }
+    }
+
+    /**
+     * \brief gathers up to BASES_PER_WORD packed bases starting at pos. Positions past the end read as A.
+     */
+    Word getBases(const std::size_t pos) const
+    {
+        const std::size_t word = pos / packedContig::BASES_PER_WORD;
+        const unsigned shift = pos % packedContig::BASES_PER_WORD * 2;
+        const Word low = word < bases_.size() ? bases_[word] >> shift : 0;
+        const Word high = (shift && word + 1 < bases_.size()) ? bases_[word + 1] << (sizeof(Word) * 8 - shift) : 0;
+        return low | high;
+    }
+
+    /**
+     * \brief gathers BASES_PER_WORD N flags starting at pos in the lower half of the result
+     */
+    Word getNFlags(const std::size_t pos) const
+    {
+        const std::size_t word = pos / packedContig::N_FLAGS_PER_WORD;
+        const unsigned shift = pos % packedContig::N_FLAGS_PER_WORD;
+        const Word low = word < nFlags_.size() ? nFlags_[word] >> shift : 0;
+        const Word high = (shift && word + 1 < nFlags_.size()) ? nFlags_[word + 1] << (sizeof(Word) * 8 - shift) : 0;
+        return (low | high) & 0x00000000FFFFFFFFULL;
+    }
+
+    /**
+     * \brief counts mismatches of the sequence placed at pos, one packed word at a time. Same result as
+     *        alignment::countMismatches. Comparison stops at the end of the contig.
+     */
+    template <typename SequenceIteratorT>
+    unsigned countMismatches(SequenceIteratorT sequenceBegin, const SequenceIteratorT sequenceEnd, std::size_t pos) const
+    {
+        unsigned ret = 0;
+        while (sequenceEnd != sequenceBegin && length_ > pos)
+        {
+            const unsigned bases = std::min<std::size_t>(
+                std::min<std::size_t>(std::distance(sequenceBegin, sequenceEnd), length_ - pos),
+                packedContig::BASES_PER_WORD);
+            Word sequenceBases = 0;
+            Word sequenceNFlags = 0;
+            packedContig::packWord(sequenceBegin, sequenceBegin + bases, sequenceBases, sequenceNFlags);
+            ret += packedContig::countMismatches(
+                sequenceBases, sequenceNFlags, getBases(pos), getNFlags(pos), packedContig::validLanesMask(bases));
+            sequenceBegin += bases;
+            pos += bases;
+        }
+        return ret;
+    }
+
+    const_iterator begin() const {return const_iterator(*this, 0);}
+    const_iterator end() const {return const_iterator(*this, length_);}
+    const_reverse_iterator rbegin() const {return const_reverse_iterator(end());}
+    const_reverse_iterator rend() const {return const_reverse_iterator(begin());}
+    std::size_t size() const {return length_;}
+    std::size_t getLength() const {return length_;}
+    bool empty() const {return !length_;}
+
+    /// packed bases, BASES_PER_WORD per word, first base in the least significant bits
+    const Word *basesData() const {return bases_.empty() ? 0 : &bases_.front();}
+    Word *basesData() {return bases_.empty() ? 0 : &bases_.front();}
+    std::size_t basesWords() const {return bases_.size();}
+    /// N mask, N_FLAGS_PER_WORD per word, first base in the least significant bit
+    const Word *nFlagsData() const {return nFlags_.empty() ? 0 : &nFlags_.front();}
+    Word *nFlagsData() {return nFlags_.empty() ? 0 : &nFlags_.front();}
+    std::size_t nFlagsWords() const {return nFlags_.size();}
+    /// memory occupied by the packed data
+    std::size_t getPackedBytes() const {return (bases_.size() + nFlags_.size()) * sizeof(Word);}
+
+    /// same bases, regardless of the index and name
+    bool operator ==(const BasicContig &that) const
+    {
+        return length_ == that.length_ &&
+            std::equal(bases_.begin(), bases_.end(), that.bases_.begin()) &&
+            std::equal(nFlags_.begin(), nFlags_.end(), that.nFlags_.begin());
+    }
+    bool operator !=(const BasicContig &that) const {return !(*this == that);}
+
     friend std::ostream &operator <<(std::ostream &os, const BasicContig<AllocatorT> &contig)
     {
         return os << "Contig(" << contig.index_ << "," << contig.name_ << "," << contig.size() << ")";
     }
+
+private:
+    Words bases_;
+    Words nFlags_;
+    std::size_t length_;
+
+    static std::size_t getWords(const std::size_t length, const std::size_t perWord)
+    {
+        return (length + perWord - 1) / perWord;
+    }
 };
 
-typedef BasicContig<common::NumaAllocator<char, 0> > Contig;
+typedef BasicContig<common::NumaAllocator<char, 0, true> > Contig;
 typedef common::SameAllocatorVector<Contig, common::NumaAllocator<Contig, 0> > ContigList;
 typedef common::SameAllocatorVector<ContigList, common::NumaAllocator<ContigList, 0> > ContigLists;
 
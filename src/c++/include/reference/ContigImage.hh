@@ -0,0 +1,106 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ContigImage.hh
+ **
+ ** \brief Binary image of the translated reference contigs.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_REFERENCE_CONTIG_IMAGE_HH
+#define iSAAC_REFERENCE_CONTIG_IMAGE_HH
+
+#include <memory>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "reference/Contig.hh"
+#include "reference/SortedReferenceMetadata.hh"
+
+namespace isaac
+{
+namespace reference
+{
+
+/**
+ * \brief Fixed-size header of the contig image file. The table of contig entries in karyotype order follows the
+ *        header. Contig bases follow the table in the same order, each contig as its packed bases words followed
+ *        by its N mask words, in host byte order.
+ */
+struct ContigImageFileHeader
+{
+    static const unsigned CURRENT_VERSION = 2;
+    char magic_[8];
+    boost::uint32_t version_;
+    boost::uint32_t reserved_;
+    boost::uint64_t referenceFingerprint_;
+    boost::uint64_t contigsCount_;
+};
+
+struct ContigImageEntry
+{
+    boost::uint64_t imageOffset_;
+    boost::uint64_t totalBases_;
+    boost::uint64_t acgtBases_;
+    boost::uint32_t crc32_;
+    boost::uint32_t reserved_;
+};
+
+/**
+ * \brief Stores the packed bases of the contigs exactly as loadContig produces them, so that the aligner can read
+ *        them back without parsing the fasta.
+ *
+ * \param contigs in karyotype order, as returned by loadContigs
+ */
+void storeContigImage(
+    const SortedReferenceMetadata &sortedReferenceMetadata,
+    const ContigList &contigs,
+    const boost::filesystem::path &path);
+
+/**
+ * \brief Reads contigs from the image with a single positioned read each. Safe to use from multiple threads.
+ *        The constructor throws IoException unless the file size matches the contig table.
+ */
+class ContigImage : boost::noncopyable
+{
+public:
+    ContigImage(const boost::filesystem::path &path, const boost::uint64_t referenceFingerprint);
+    ~ContigImage();
+
+    /**
+     * \return 0 if the reference has no image or the image does not match the reference contigs
+     */
+    static std::unique_ptr<ContigImage> open(const SortedReferenceMetadata &sortedReferenceMetadata);
+
+    /**
+     * \brief loads the contig and verifies its checksum
+     *
+     * \return false if the contig in the image is damaged. The caller is expected to load it from fasta instead.
+     */
+    bool load(const SortedReferenceMetadata::Contig &xmlContig, Contig &contig) const;
+
+private:
+    bool readContigWords(
+        char *data, const std::size_t size, const uint64_t imageOffset,
+        const SortedReferenceMetadata::Contig &xmlContig) const;
+
+    const boost::filesystem::path path_;
+    int fd_;
+    std::vector<ContigImageEntry> entries_;
+};
+
+} // namespace reference
+} // namespace isaac
+
+#endif // #ifndef iSAAC_REFERENCE_CONTIG_IMAGE_HH
@@ -24,6 +24,7 @@
 
 #include "common/Threads.hpp"
 #include "reference/Contig.hh"
+#include "reference/ContigImage.hh"
 #include "reference/SortedReferenceMetadata.hh"
 
 namespace isaac
@@ -44,6 +45,7 @@ template <typename ShouldLoadF> void loadContigsParallel(
     std::vector<reference::SortedReferenceMetadata::Contig>::const_iterator &nextContigToLoad,
     const std::vector<reference::SortedReferenceMetadata::Contig>::const_iterator contigsEnd,
     reference::ContigList &contigList,
+    const ContigImage *contigImage,
     boost::mutex &mutex)
 {
     const unsigned traceStep = pow(10, int(log10((contigList.size() + 99) / 100)));
@@ -57,7 +59,10 @@ template <typename ShouldLoadF> void loadContigsParallel(
             common::unlock_guard<boost::mutex> unlock(mutex);
             const reference::SortedReferenceMetadata::Contig &xmlContig = *ourContig;
             Contig &contig = contigList[ourContig->karyotypeIndex_];
-            loadContig(xmlContig, contig);
+            if (!contigImage || !contigImage->load(xmlContig, contig))
+            {
+                loadContig(xmlContig, contig);
+            }
             if (!(xmlContig.index_ % traceStep))
             {
                 ISAAC_THREAD_CERR << (boost::format("Contig %s (%3d:%8d): %s\n") % xmlContig.name_ % xmlContig.index_ % xmlContig.totalBases_ % xmlContig.filePath_).str();
@@ -76,11 +81,15 @@ template <typename ShouldLoadF> void loadContigsParallel(
 
 /**
  * \brief loads the fasta file contigs into memory on multiple threads unless shouldLoad(contig->index_) returns false
+ *
+ * \param contigImage if not 0, contigs are read from the image instead of the fasta. The ones that fail to load
+ *        from the image are read from the fasta.
  */
 template <typename ShouldLoadF> reference::ContigList loadContigs(
     const reference::SortedReferenceMetadata::Contigs &xmlContigs,
     ShouldLoadF shouldLoad,
-    common::ThreadVector &loadThreads)
+    common::ThreadVector &loadThreads,
+    const ContigImage *contigImage = 0)
 {
     reference::ContigList ret;
     ret.reserve(xmlContigs.size());
@@ -98,13 +107,15 @@ template <typename ShouldLoadF> reference::ContigList loadContigs(
                                     boost::ref(nextContigToLoad),
                                     xmlContigs.end(),
                                     boost::ref(ret),
+                                    contigImage,
                                     boost::ref(mutex)));
 
     return ret;
 }
 
 /**
- * \brief loads the fasta file contigs into memory on multiple threads
+ * \brief loads the fasta file contigs into memory on multiple threads. References that have a valid contig image
+ *        are loaded from the image.
  */
 template <typename FilterT> reference::ContigLists loadContigs(
     const reference::SortedReferenceMetadataList &SortedReferenceMetadataList,
@@ -118,10 +129,16 @@ template <typename FilterT> reference::ContigLists loadContigs(
     BOOST_FOREACH(const reference::SortedReferenceMetadata &SortedReferenceMetadata, SortedReferenceMetadataList)
     {
         const unsigned referenceIndex = &SortedReferenceMetadata - &SortedReferenceMetadataList.front();
+        const std::unique_ptr<ContigImage> contigImage = ContigImage::open(SortedReferenceMetadata);
+        if (contigImage)
+        {
+            ISAAC_THREAD_CERR << "Loading contigs from image " << SortedReferenceMetadata.getContigImage().path_ << std::endl;
+        }
         reference::ContigList contigList =
             loadContigs(SortedReferenceMetadata.getContigs(),
                         boost::bind(&FilterT::isMapped, loadedContigFilter, referenceIndex, _1),
-                        loadThreads);
+                        loadThreads,
+                        contigImage.get());
         ret.at(referenceIndex).swap(contigList);
     }
 
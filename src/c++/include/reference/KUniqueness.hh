@@ -21,8 +21,14 @@
 #ifndef ISAAC_REFERENCE_K_UNIQUENESS_HH
 #define ISAAC_REFERENCE_K_UNIQUENESS_HH
 
+#include <memory>
+
+#include <boost/foreach.hpp>
+
+#include "common/MemoryMappedFile.hh"
 #include "common/NumaContainer.hh"
 #include "common/SameAllocatorVector.hh"
+#include "common/SystemCompatibility.hh"
 
 namespace isaac
 {
@@ -34,7 +40,127 @@ typedef unsigned char AnnotationValue;
 //typedef std::vector<ContigAnnotation, common::NumaAllocator<ContigAnnotation, 0> > ContigAnnotations;
 //typedef std::vector<ContigAnnotations, common::NumaAllocator<ContigAnnotations, 0> > ContigAnnotationsList;
 
-typedef common::SameAllocatorVectorEnd<std::pair<AnnotationValue, AnnotationValue>, common::NumaAllocator<std::pair<AnnotationValue, AnnotationValue>, 0> > ContigAnnotation;
+/**
+ * \brief Per-position k-uniqueness and k-repeatness of a contig. Either owns its storage or is a read-only view
+ *        into a mapped annotation file. Copies of a view share the mapping. Copies made for another NUMA node
+ *        always own their storage.
+ */
+class ContigAnnotation
+{
+public:
+    typedef std::pair<AnnotationValue, AnnotationValue> value_type;
+private:
+    typedef common::SameAllocatorVectorEnd<value_type, common::NumaAllocator<value_type, 0> > StorageT;
+public:
+    typedef StorageT::allocator_type allocator_type;
+    typedef const value_type *const_iterator;
+
+    ContigAnnotation() : begin_(0), end_(0)
+    {
+    }
+
+    explicit ContigAnnotation(const std::size_t s) : storage_(s)
+    {
+        attach();
+    }
+
+    ContigAnnotation(const std::size_t s, const value_type v) : storage_(s, v)
+    {
+        attach();
+    }
+
+    ContigAnnotation(const ContigAnnotation &that)
+        : storage_(that.storage_), mapping_(that.mapping_), begin_(that.begin_), end_(that.end_)
+    {
+        if (!mapping_)
+        {
+            attach();
+        }
+    }
+
+    ContigAnnotation(const ContigAnnotation &that, const allocator_type &allocator)
+        : storage_(that.begin(), that.end(), allocator)
+    {
+        attach();
+    }
+
+    ContigAnnotation(ContigAnnotation &&that) : begin_(0), end_(0)
+    {
+        swap(that);
+    }
+
+    /**
+     * \brief view of [begin, end) which must be inside the mapping
+     */
+    ContigAnnotation(
+        const std::shared_ptr<const common::MemoryMappedFile> &mapping,
+        const value_type *begin,
+        const value_type *end)
+        : mapping_(mapping), begin_(begin), end_(end)
+    {
+    }
+
+    ContigAnnotation & operator=(ContigAnnotation &&that)
+    {
+        swap(that);
+        return *this;
+    }
+
+    void swap(ContigAnnotation &that)
+    {
+        storage_.swap(that.storage_);
+        mapping_.swap(that.mapping_);
+        std::swap(begin_, that.begin_);
+        std::swap(end_, that.end_);
+    }
+
+    bool isMapped() const {return bool(mapping_);}
+
+    std::size_t size() const {return end_ - begin_;}
+    bool empty() const {return end_ == begin_;}
+    const_iterator begin() const {return begin_;}
+    const_iterator end() const {return end_;}
+    const value_type &front() const {return *begin_;}
+    const value_type &operator[](const std::size_t pos) const {return begin_[pos];}
+    const value_type &at(const std::size_t pos) const
+    {
+        ISAAC_ASSERT_MSG(size() > pos, "Annotation position " << pos << " is out of range " << size());
+        return begin_[pos];
+    }
+
+    value_type &operator[](const std::size_t pos)
+    {
+        ISAAC_ASSERT_MSG(!mapping_, "Mapped annotation is read-only");
+        return storage_[pos];
+    }
+
+    void resize(const std::size_t s)
+    {
+        ISAAC_ASSERT_MSG(!mapping_, "Mapped annotation cannot be resized");
+        storage_.resize(s);
+        attach();
+    }
+
+    void resize(const std::size_t s, const value_type v)
+    {
+        ISAAC_ASSERT_MSG(!mapping_, "Mapped annotation cannot be resized");
+        storage_.resize(s, v);
+        attach();
+    }
+
+private:
+    StorageT storage_;
+    std::shared_ptr<const common::MemoryMappedFile> mapping_;
+    const value_type *begin_;
+    const value_type *end_;
+
+    void attach()
+    {
+        begin_ = storage_.empty() ? 0 : &storage_.front();
+        end_ = begin_ + storage_.size();
+    }
+};
+
 typedef common::SameAllocatorVector<ContigAnnotation, common::NumaAllocator<ContigAnnotation, 0> > ContigAnnotations;
 typedef common::SameAllocatorVector<ContigAnnotations, common::NumaAllocator<ContigAnnotations, 0> > ContigAnnotationsList;
 
@@ -47,11 +173,33 @@ static const DistanceToBeNeighborless K_UNIQUE_TOO_FAR = DistanceToBeNeighborles
 class NumaContigAnnotationsList
 {
     common::NumaContainerReplicas<ContigAnnotationsList> replicas_;
+
+    static bool isMapped(const ContigAnnotationsList &lists)
+    {
+        BOOST_FOREACH(const ContigAnnotations &contigAnnotations, lists)
+        {
+            BOOST_FOREACH(const ContigAnnotation &contigAnnotation, contigAnnotations)
+            {
+                if (contigAnnotation.isMapped())
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
 public:
 
-    NumaContigAnnotationsList(ContigAnnotationsList &&node0Lists) :replicas_(std::move(node0Lists))
+    /**
+     * \param replicate when false, threads on all NUMA nodes use node0Lists. Mapped annotations are never
+     *                  replicated, so that they stay shared with the other processes on the host.
+     */
+    NumaContigAnnotationsList(ContigAnnotationsList &&node0Lists, const bool replicate = true)
+        : replicas_(std::move(node0Lists), replicate && !isMapped(node0Lists))
     {
-        ISAAC_THREAD_CERR << "NumaContigAnnotationsList copy constructor" << std::endl;
+        ISAAC_THREAD_CERR << "NumaContigAnnotationsList replicas: " << replicas_.replicasCount() <<
+            " RSS: " << common::getResidentSetBytes() / 1024 / 1024 << "MB" << std::endl;
     }
 
     const ContigAnnotationsList &node0Container() const {return replicas_.node0Container();}
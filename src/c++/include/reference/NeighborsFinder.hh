@@ -47,15 +47,30 @@ public:
         const unsigned neighborhoodWidth,
         common::ThreadVector &threads);
 
+    typedef typename AnnotatorT::KmerList KmerList;
+
     template <typename ReferenceKmerT>
     const typename AnnotatorT::Annotation &annotate();
+
+    /**
+     * \brief Same as above but generates k-mers into the buffer supplied by the caller. The buffer keeps its
+     *        capacity between calls so that consecutive masks don't have to reallocate it.
+     */
+    template <typename ReferenceKmerT>
+    const typename AnnotatorT::Annotation &annotate(KmerList &kmerList);
+
+    /**
+     * \brief The k-mers are generated anew for each permutation that can't reuse the k-mers of the previous one.
+     *
+     * \return the largest number of k-mers annotate holds in memory at once
+     */
+    std::size_t countKmersMax() const;
 private:
     AnnotatorT &annotator_;
     const unsigned maskWidth_;
     const unsigned neighborhoodWidth_;
     const KmerT permutedX_;
 
-    typedef typename AnnotatorT::KmerList KmerList;
     typedef typename AnnotatorT::AnnotatedKmer AnnotatedKmer;
     common::ThreadVector &threads_;
     // permutation list for the whole genome
@@ -307,8 +322,16 @@ template <typename KmerT, typename AnnotatorT>
 template <typename ReferenceKmerT>
 const typename AnnotatorT::Annotation &NeighborsFinder<KmerT, AnnotatorT>::annotate()
 {
-    // iterate over all possible permutations
     KmerList kmerList;
+    return annotate<ReferenceKmerT>(kmerList);
+}
+
+template <typename KmerT, typename AnnotatorT>
+template <typename ReferenceKmerT>
+const typename AnnotatorT::Annotation &NeighborsFinder<KmerT, AnnotatorT>::annotate(KmerList &kmerList)
+{
+    // iterate over all possible permutations
+    kmerList.clear();
     unsigned permutation = 0;
     BOOST_FOREACH(const oligo::Permutate &permutate, permutateList_)
     {
@@ -352,6 +375,21 @@ const typename AnnotatorT::Annotation &NeighborsFinder<KmerT, AnnotatorT>::annot
     return annotator_.getAnnotation();
 }
 
+template <typename KmerT, typename AnnotatorT>
+std::size_t NeighborsFinder<KmerT, AnnotatorT>::countKmersMax() const
+{
+    std::size_t ret = 0;
+    for (std::size_t permutation = 0; permutateList_.size() != permutation; ++permutation)
+    {
+        const oligo::Permutate &permutate = permutateList_.at(permutation);
+        if (!permutation || !permutate.isSamePrefix(maskWidth_, permutateList_.at(permutation - 1)))
+        {
+            ret = std::max(ret, annotator_.countKmers(permutate, threads_));
+        }
+    }
+    return ret;
+}
+
 template <typename KmerT>
 bool isReverseComplement(const KmerT &kmer)
 {
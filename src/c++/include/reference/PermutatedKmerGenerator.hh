@@ -264,6 +264,14 @@ public:
         common::ThreadVector &threads,
         const std::size_t threadsMax = 0) const;
 
+    /**
+     * \return the number of k-mers generate would produce without allocating memory for them
+     */
+    std::size_t count(
+        const oligo::Permutate &permutate,
+        common::ThreadVector &threads,
+        const std::size_t threadsMax = 0) const;
+
 private:
 
     template <typename KmerLisT, typename ConstrucT>
@@ -286,10 +294,8 @@ private:
         const std::size_t threads,
         std::vector<std::size_t> &threadKmerOffsets) const;
 
-    template<typename KmerLisT>
     void countThread(
         const oligo::Permutate &permutate,
-        KmerLisT &kmerList,
         const unsigned threadNumber,
         const std::size_t threads,
         std::vector<std::size_t> &threadKmerCounts) const;
@@ -311,10 +317,9 @@ void PermutatedKmerListGenerator<KmerT, mode>::generate(
     std::vector<std::size_t> threadKmerCounts(threadsToUse, 0);
 
     threads.execute(boost::bind(
-        &PermutatedKmerListGenerator::countThread<KmerLisT>,
+        &PermutatedKmerListGenerator::countThread,
         this,
         boost::ref(permutate),
-        boost::ref(kmerList),
         _1, _2,
         boost::ref(threadKmerCounts)), threadsToUse);
 
@@ -323,7 +328,12 @@ void PermutatedKmerListGenerator<KmerT, mode>::generate(
     ISAAC_THREAD_CERR << " found " << estimatedKmers << " kmers on " << threadsToUse << " threads" << std::endl;
     // if we don't deallocate, resize will attempt to allocate memory separately and then copy the old contents (which we don't need)
     // in some cases this will obviously cause bad_alloc despite the total amount of ram needed being available.
-    {KmerLisT().swap(kmerList);}
+    // When the buffer is big enough already, keep it. Callers iterating over masks reuse the same buffer.
+    if (kmerList.capacity() < estimatedKmers)
+    {
+        KmerLisT().swap(kmerList);
+    }
+    kmerList.clear();
     kmerList.resize(estimatedKmers, typename KmerLisT::value_type(initV));
     ISAAC_THREAD_CERR << " reserving memory done for " << kmerList.size() << " kmers" << std::endl;
 
@@ -368,10 +378,27 @@ void PermutatedKmerListGenerator<KmerT, mode>::storeThreadKmer(
 }
 
 template <typename KmerT, permutatedKmerGenerator::Mode mode>
-template <typename KmerLisT>
+std::size_t PermutatedKmerListGenerator<KmerT, mode>::count(
+    const oligo::Permutate &permutate,
+    common::ThreadVector &threads,
+    const std::size_t threadsMax/* = 0*/) const
+{
+    const std::size_t threadsToUse = threadsMax ? threadsMax : threads.size();
+    std::vector<std::size_t> threadKmerCounts(threadsToUse, 0);
+
+    threads.execute(boost::bind(
+        &PermutatedKmerListGenerator::countThread,
+        this,
+        boost::ref(permutate),
+        _1, _2,
+        boost::ref(threadKmerCounts)), threadsToUse);
+
+    return std::accumulate(threadKmerCounts.begin(), threadKmerCounts.end(), 0UL);
+}
+
+template <typename KmerT, permutatedKmerGenerator::Mode mode>
 void PermutatedKmerListGenerator<KmerT, mode>::countThread(
     const oligo::Permutate &permutate,
-    KmerLisT &kmerList,
     const unsigned threadNumber,
     const std::size_t threads,
     std::vector<std::size_t> &threadKmerCounts) const
@@ -20,21 +20,27 @@
 #ifndef iSAAC_REFERENCE_REFERENCE_HASH_HH
 #define iSAAC_REFERENCE_REFERENCE_HASH_HH
 
+#include <memory>
 #include <string>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
 
+#include "common/HugePages.hh"
+#include "common/MD5Sum.hh"
+#include "common/MemoryMappedFile.hh"
 #include "common/NumaContainer.hh"
 #include "oligo/Kmer.hh"
 #include "PermutatedKmerGenerator.hh"
 #include "reference/ReferenceKmer.hh"
 #include "reference/ReferencePosition.hh"
+#include "reference/SortedReferenceMetadata.hh"
 
 namespace isaac
 {
 namespace reference
 {
 template <typename KmerT> class ReferenceHasher;
+template <typename KmerT> class MappedReferenceHash;
 
 template <typename KmerType, typename AllocatorT = std::allocator<void> >
 class ReferenceHash
@@ -50,7 +56,8 @@ class ReferenceHash
     typedef std::vector<Offset, OffsetAllocator > Offsets;
 public:
     typedef KmerType KmerT;
-    typedef typename Positions::const_iterator const_iterator;
+    // plain pointers allow memory-mapped and in-memory hashes to produce identical MatchRange
+    typedef const reference::ReferencePosition *const_iterator;
     typedef std::pair<const_iterator, const_iterator> MatchRange;
     typedef void value_type;// compatibility with std containers for numa replications
 
@@ -104,6 +111,44 @@ public:
         positions_.assign(that.positions_.begin(), that.positions_.end());
     }
 
+    /**
+     * \brief copies data over from the memory-mapped hash file using the currently set allocator
+     */
+    void assign(const MappedReferenceHash<KmerT> &that)
+    {
+        offsets_.assign(that.offsetsBegin(), that.offsetsEnd());
+        positions_.assign(that.positionsBegin(), that.positionsEnd());
+    }
+
+    const Offset *offsetsData() const {return offsets_.data();}
+    std::size_t offsetsCount() const {return offsets_.size();}
+    const reference::ReferencePosition *positionsData() const {return positions_.data();}
+    std::size_t positionsCount() const {return positions_.size();}
+
+    std::size_t getBytes() const
+    {
+        return offsets_.size() * sizeof(Offset) + positions_.size() * sizeof(reference::ReferencePosition);
+    }
+
+    std::size_t getHugePageBackedBytes() const
+    {
+        return common::hugePages::getHugePageBackedBytes(offsets_.data(), offsets_.size() * sizeof(Offset)) +
+            common::hugePages::getHugePageBackedBytes(positions_.data(), positions_.size() * sizeof(reference::ReferencePosition));
+    }
+
+    /**
+     * \brief brings the offset slots of the kmer into cache. Use prefetchPositions once the offsets have arrived.
+     */
+    void prefetchOffsets(const KmerT &kmer) const
+    {
+        __builtin_prefetch(offsets_.data() + (!kmer ? 0 : kmer.bits_ - 1));
+    }
+
+    void prefetchPositions(const KmerT &kmer) const
+    {
+        __builtin_prefetch(positions_.data() + (!kmer ? 0 : offsets_[kmer.bits_ - 1]));
+    }
+
     MatchRange findMatches(const KmerT &kmer) const
     {
         boost::uint32_t positionsBegin = !kmer ? 0 : offsets_[kmer.bits_ - 1];
@@ -111,7 +156,7 @@ public:
         ISAAC_ASSERT_MSG(positionsBegin <= positions_.size(), "Positions buffer overrun by positionsBegin:" << positionsBegin << " for kmer " << kmer);
         ISAAC_ASSERT_MSG(positionsBegin <= positionsEnd, "positionsEnd:" << positionsEnd << " overrun by positionsBegin:" << positionsBegin << " for kmer " << kmer);
 
-        const MatchRange ret = std::make_pair(positions_.begin() + positionsBegin, positions_.begin() + positionsEnd);
+        const MatchRange ret = std::make_pair(positions_.data() + positionsBegin, positions_.data() + positionsEnd);
 
     //    ISAAC_THREAD_CERR << "found " << std::distance(ret.first, ret.second) << " matches for " << oligo::Bases<oligo::BITS_PER_BASE, KmerT>(kmer, oligo::KmerTraits<KmerT>::KMER_BASES) << std::endl;
     //    BOOST_FOREACH(const ReferencePosition &pos, ret)
@@ -194,25 +239,196 @@ private:
     static void dumpPositions(boost::mutex& mutex, MutexBuffer& buffer, ReferenceHashT& referenceHash);
 };
 
+/**
+ * \brief Fixed-size header of the persistent reference hash file. Offsets follow the header immediately,
+ *        positions follow the offsets.
+ */
+struct ReferenceHashFileHeader
+{
+    static const unsigned CURRENT_VERSION = 1;
+    char magic_[8];
+    boost::uint32_t version_;
+    boost::uint32_t kmerBases_;
+    boost::uint64_t referenceFingerprint_;
+    boost::uint64_t offsetsCount_;
+    boost::uint64_t positionsCount_;
+};
+
+/**
+ * \brief Accumulates the fields that identify a file stored for a reference. md5 rather than boost::hash_combine,
+ *        so that the result does not change between boost versions or builds sharing the reference directory.
+ */
+class ReferenceFingerprint
+{
+public:
+    ReferenceFingerprint &add(const boost::uint64_t value);
+    ReferenceFingerprint &add(const std::string &value);
+    boost::uint64_t get() const;
+private:
+    common::MD5Sum md5_;
+};
+
+/**
+ * \brief Identifies the sorted reference contents the hash was generated from. Changes in contig names,
+ *        lengths, order or in the modification time of the contig files invalidate the stored hash.
+ */
+boost::uint64_t computeReferenceHashFingerprint(const SortedReferenceMetadata &sortedReferenceMetadata);
+
+/**
+ * \brief Returns true if the file exists, its header matches the kmer length and the reference fingerprint
+ *        and its size matches the offsets and positions counts in the header
+ */
+bool isReferenceHashFileValid(
+    const boost::filesystem::path &path,
+    const unsigned kmerBases,
+    const boost::uint64_t referenceFingerprint);
+
+/**
+ * \brief Writes the hash into a temporary file next to path and renames it into place so that concurrent
+ *        readers never see a partially written hash.
+ */
+template <typename ReferenceHashT>
+void storeReferenceHash(
+    const ReferenceHashT &referenceHash,
+    const boost::uint64_t referenceFingerprint,
+    const boost::filesystem::path &path);
+
+/**
+ * \brief Read-only view of the hash stored by storeReferenceHash. The pages are shared between all processes
+ *        mapping the same file and stay in the page cache between runs.
+ */
+template <typename KmerType>
+class MappedReferenceHash : boost::noncopyable
+{
+public:
+    typedef KmerType KmerT;
+    typedef const reference::ReferencePosition *const_iterator;
+    typedef std::pair<const_iterator, const_iterator> MatchRange;
+
+    MappedReferenceHash(const boost::filesystem::path &path, const boost::uint64_t referenceFingerprint);
+    MappedReferenceHash(MappedReferenceHash &&that);
+
+    const boost::uint32_t *offsetsBegin() const {return offsets_;}
+    const boost::uint32_t *offsetsEnd() const {return offsets_ + offsetsCount_;}
+    const reference::ReferencePosition *positionsBegin() const {return positions_;}
+    const reference::ReferencePosition *positionsEnd() const {return positions_ + positionsCount_;}
+
+    std::size_t getBytes() const {return file_.size();}
+    /// file mappings live in the page cache which does not get huge pages
+    std::size_t getHugePageBackedBytes() const {return 0;}
+
+    void prefetchOffsets(const KmerT &kmer) const
+    {
+        __builtin_prefetch(offsets_ + (!kmer ? 0 : kmer.bits_ - 1));
+    }
+
+    void prefetchPositions(const KmerT &kmer) const
+    {
+        __builtin_prefetch(positions_ + (!kmer ? 0 : offsets_[kmer.bits_ - 1]));
+    }
+
+    MatchRange findMatches(const KmerT &kmer) const
+    {
+        const boost::uint32_t positionsBegin = !kmer ? 0 : offsets_[kmer.bits_ - 1];
+        const boost::uint32_t positionsEnd = offsets_[kmer.bits_];
+        ISAAC_ASSERT_MSG(positionsBegin <= positionsCount_, "Positions buffer overrun by positionsBegin:" << positionsBegin << " for kmer " << kmer);
+        ISAAC_ASSERT_MSG(positionsBegin <= positionsEnd, "positionsEnd:" << positionsEnd << " overrun by positionsBegin:" << positionsBegin << " for kmer " << kmer);
+        return std::make_pair(positions_ + positionsBegin, positions_ + positionsEnd);
+    }
+
+private:
+    common::MemoryMappedFile file_;
+    const boost::uint32_t *offsets_;
+    std::size_t offsetsCount_;
+    const reference::ReferencePosition *positions_;
+    std::size_t positionsCount_;
+};
+
 template <typename HashType>
 class NumaReferenceHash
 {
-    common::NumaContainerReplicas<HashType> replicas_;
+    typedef MappedReferenceHash<typename HashType::KmerT> MappedHashT;
+    // either replicas_ or mapped_ is set. Mapped hash is copied into replicas only on request as the copies give up
+    // the page cache sharing between the processes that map the same file.
+    std::unique_ptr<common::NumaContainerReplicas<HashType> > replicas_;
+    std::unique_ptr<MappedHashT> mapped_;
 public:
     typedef typename HashType::KmerT KmerT;
     typedef typename HashType::MatchRange MatchRange;
     typedef typename HashType::const_iterator const_iterator;
 
-    NumaReferenceHash(HashType &&hash) :replicas_(std::move(hash))
+    NumaReferenceHash(HashType &&hash) :replicas_(new common::NumaContainerReplicas<HashType>(std::move(hash)))
     {
         ISAAC_THREAD_CERR << "NumaReferenceHash copy constructor" << std::endl;
     }
 
+    /**
+     * \brief Uses the mapped hash directly unless replicate is set, in which case the hash is copied into the
+     *        memory of each NUMA node (huge-page backed if enabled) and the mapping is released.
+     */
+    NumaReferenceHash(MappedHashT &&mapped, const bool replicate = false)
+    {
+        if (replicate)
+        {
+            HashType node0Hash;
+            node0Hash.assign(mapped);
+            replicas_.reset(new common::NumaContainerReplicas<HashType>(std::move(node0Hash)));
+        }
+        else
+        {
+            mapped_.reset(new MappedHashT(std::move(mapped)));
+        }
+    }
+
+    NumaReferenceHash(NumaReferenceHash &&that)
+        : replicas_(std::move(that.replicas_)), mapped_(std::move(that.mapped_))
+    {
+    }
+
+    void prefetchOffsets(const KmerT &kmer) const
+    {
+        mapped_ ? mapped_->prefetchOffsets(kmer) : replicas_->threadNodeContainer().prefetchOffsets(kmer);
+    }
+
+    void prefetchPositions(const KmerT &kmer) const
+    {
+        mapped_ ? mapped_->prefetchPositions(kmer) : replicas_->threadNodeContainer().prefetchPositions(kmer);
+    }
+
     MatchRange findMatches(const KmerT &kmer) const
     {
-        return replicas_.threadNodeContainer().findMatches(kmer);
+        return mapped_ ? mapped_->findMatches(kmer) : replicas_->threadNodeContainer().findMatches(kmer);
     }
+
+    /**
+     * \brief bytes taken by one copy of the hash
+     */
+    std::size_t getBytes() const
+    {
+        return mapped_ ? mapped_->getBytes() : replicas_->node0Container().getBytes();
+    }
+
+    std::size_t getHugePageBackedBytes() const
+    {
+        return mapped_ ? mapped_->getHugePageBackedBytes() : replicas_->node0Container().getHugePageBackedBytes();
+    }
+
+    bool isMapped() const {return bool(mapped_);}
 };
+
+/**
+ * \brief Maps the hash stored at path. If there is no valid stored hash, generates one and attempts to store it for
+ *        subsequent runs. Failure to store is not fatal as the reference directory might not be writable.
+ *        The mapping is used directly unless replicate is set.
+ */
+template <typename ReferenceHashT>
+NumaReferenceHash<ReferenceHashT> loadReferenceHash(
+    const boost::filesystem::path &path,
+    const SortedReferenceMetadata &sortedReferenceMetadata,
+    const ContigList &contigList,
+    common::ThreadVector &threads,
+    const unsigned threadsMax,
+    const bool replicate);
 } // namespace reference
 } // namespace isaac
 
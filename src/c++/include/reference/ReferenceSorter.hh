@@ -20,7 +20,9 @@
 #ifndef iSAAC_REFERENCE_REFERENCE_SORTER_HH
 #define iSAAC_REFERENCE_REFERENCE_SORTER_HH
 
+#include <ostream>
 #include <string>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
 
@@ -44,10 +46,14 @@ public:
         const boost::filesystem::path &contigsXmlPath,
         const boost::filesystem::path &genomeNeighborsFile,
         const boost::filesystem::path &outputFile,
-        const unsigned repeatThreshold);
+        const unsigned repeatThreshold,
+        const uint64_t memoryLimit);
     void run();
 private:
     const unsigned repeatThreshold_;
+    // 0 for no limit. Otherwise the mask is split into partitions that fit along with the contigs,
+    // neighbor flags and sort jobs
+    const uint64_t memoryLimit_;
     const unsigned int maskWidth_;
     const unsigned mask_;
 
@@ -66,10 +72,21 @@ private:
 
     std::vector<ReferenceKmer<KmerT> > reference_;
 
-    void loadReference();
+    uint64_t getKmerMemoryLimit(const std::vector<bool> &neighbors) const;
+    void sortPartition(
+        const unsigned partitionMaskWidth,
+        const unsigned partitionMask,
+        const uint64_t kmerMemoryLimit,
+        const std::vector<bool> &neighbors,
+        std::ostream &os,
+        uint64_t &kmersSaved);
+    template <permutatedKmerGenerator::Mode mode>
+    std::size_t countKmers(const unsigned partitionMaskWidth, const unsigned partitionMask);
+    void loadReference(const unsigned partitionMaskWidth, const unsigned partitionMask);
     void sortReference();
     void markRepeats();
-    void saveReference();
+    void markNeighbors(const std::vector<bool> &neighbors);
+    void saveReference(std::ostream &os);
 };
 
 } // namespace reference
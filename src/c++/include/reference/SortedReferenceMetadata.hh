@@ -98,6 +98,7 @@ public:
             Unknown,
             KUniqueness,  //number of consecutive matches required to have small number of distance-K neighbors and 0 repeats
             KRepeatness,  //number of consecutive matches required to have no neighbors
+            ContigImage,  //contig bases translated and stored in the binary form loaded by ContigLoader
         };
         AnnotationFile(): type_(Unknown), k_(0){}
         AnnotationFile(
@@ -221,6 +222,11 @@ public:
     void setKRepeatnessAnnotation(const boost::filesystem::path &path, const unsigned k)
         {setAnnotation(AnnotationFile::KRepeatness, path, k);}
 
+    bool hasContigImage() const {return hasAnnotation(AnnotationFile::ContigImage);}
+    const AnnotationFile& getContigImage() const {return getAnnotation(AnnotationFile::ContigImage);}
+    void setContigImage(const boost::filesystem::path &path)
+        {setAnnotation(AnnotationFile::ContigImage, path, 0);}
+
     void clearAnnotations() {annotationFiles_.clear();}
 
     void clearMasks() {maskFiles_.clear();}
@@ -57,20 +57,53 @@ public:
             contigOffsets_(computeContigOffsets(sortedReferenceMetadata.getContigs())),
             kmerGenerator_(maskWidth, mask, contigList, sortedReferenceMetadata.getContigs()),
             // as we're not going to try all positions against all other positions, set 0 for pairs that will never match by prefix,
-            annotation_(reference::genomeLength(sortedReferenceMetadata.getContigs()), 0)
+            ownAnnotation_(reference::genomeLength(sortedReferenceMetadata.getContigs()), 0),
+            annotation_(ownAnnotation_)
     {
     }
 
+    typedef std::vector<NeighborsCount> Annotation;
+
+    /**
+     * \brief Adds the counts to the annotation supplied by the caller instead of allocating one. This allows
+     *        accumulating the counts of all the masks in one place.
+     */
+    NeighborCounter(
+        const unsigned int maskWidth,
+        const unsigned mask,
+        const unsigned neighborhoodWidth,
+        const reference::ContigList &contigList,
+        const reference::SortedReferenceMetadata &sortedReferenceMetadata,
+        Annotation &annotation
+        ) :
+            neighborhoodWidth_(neighborhoodWidth),
+            contigList_(contigList),
+            sortedReferenceMetadata_(sortedReferenceMetadata),
+            contigOffsets_(computeContigOffsets(sortedReferenceMetadata.getContigs())),
+            kmerGenerator_(maskWidth, mask, contigList, sortedReferenceMetadata.getContigs()),
+            annotation_(annotation)
+    {
+        ISAAC_ASSERT_MSG(reference::genomeLength(sortedReferenceMetadata.getContigs()) == annotation_.size(),
+                         "Annotation size " << annotation_.size() << " does not match the genome length");
+    }
+
     typedef neighborsFinder::AnnotatedKmer<KmerT, NeighborsCount> AnnotatedKmer;
     typedef std::vector<AnnotatedKmer > KmerList;
     void getKmers(const oligo::Permutate &permutate, KmerList &kmerList, common::ThreadVector &threads);
 
+    /**
+     * \return the number of k-mers getKmers would produce for permutate before collapsing the repeats
+     */
+    std::size_t countKmers(const oligo::Permutate &permutate, common::ThreadVector &threads) const
+    {
+        return kmerGenerator_.count(permutate, threads);
+    }
+
     bool update(
         const unsigned kmerMismatchCount,
         AnnotatedKmer &one,
         AnnotatedKmer &another);
 
-    typedef std::vector<NeighborsCount> Annotation;
     template <typename ReferenceKmerT>
     void updateAnnotation(const KmerList &kmerList, const bool repeatsOnly);
     const Annotation &getAnnotation() const {return annotation_;}
@@ -82,7 +115,8 @@ private:
     const std::vector<uint64_t> contigOffsets_;
     const PermutatedKmerListGenerator<KmerT, permutatedKmerGenerator::BothStrands> kmerGenerator_;
 
-    Annotation annotation_;
+    Annotation ownAnnotation_;
+    Annotation &annotation_;
 
     void markRepeats(
         typename KmerList::iterator begin,
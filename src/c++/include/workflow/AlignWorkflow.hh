@@ -34,7 +34,9 @@
 #include "alignment/TemplateBuilder.hh"
 #include "alignment/TemplateLengthStatistics.hh"
 #include "alignment/matchFinder/TileClusterInfo.hh"
+#include "bgzf/BgzfDeflater.hh"
 #include "build/BarcodeBamMapping.hh"
+#include "build/BinQueue.hh"
 #include "build/BinSorter.hh"
 #include "common/Threads.hpp"
 #include "demultiplexing/BarcodeLoader.hh"
@@ -128,14 +130,17 @@ public:
         const int gapExtendScore,
         const int minGapExtendScore,
         const unsigned splitGapLength,
+        const unsigned smithWatermanBandWidth,
         const alignment::TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore,
         const unsigned inputLoadersMax,
+        const bool parallelGzip,
         const unsigned tempSaversMax,
         const unsigned tempLoadersMax,
         const unsigned outputSaversMax,
         const build::GapRealignerMode realignGaps,
         const boost::filesystem::path &knownIndelsPath,
         const int bamGzipLevel,
+        const bgzf::DeflateBackend bamDeflateBackend,
         const std::string &bamPuFormat,
         const bool bamProduceMd5,
         const std::vector<std::string> &bamHeaderTags,
@@ -144,16 +149,22 @@ public:
         const bool keepDuplicates,
         const bool markDuplicates,
         const bool anchorMate,
+        const build::DuplicateGroupingMode duplicateGrouping,
         const std::string &binRegexString,
         const common::ScopedMallocBlock::Mode memoryControl,
         const std::vector<std::size_t> &clusterIdList,
         const alignment::TemplateLengthStatistics &userTemplateLengthStatistics,
         const reports::AlignmentReportGenerator::ImageFileFormat statsImageFormat,
         const bool bufferBins,
+        const bool referenceHashCache,
+        const bool referenceHashNumaReplicas,
+        const bool annotationCache,
+        const bool annotationNumaReplicas,
         const bool qScoreBin,
         const boost::array<char, 256> &fullBclQScoreTable,
         const OptionalFeatures optionalFeatures,
-        const bool pessimisticMapQ);
+        const bool pessimisticMapQ,
+        const bool pipelineBuild);
 
     /**
      * \brief Runs end-to-end alignment from the beginning
@@ -252,14 +263,17 @@ private:
     const int gapExtendScore_;
     const int minGapExtendScore_;
     const unsigned splitGapLength_;
+    const unsigned smithWatermanBandWidth_;
     const alignment::TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore_;
     const unsigned inputLoadersMax_;
+    const bool parallelGzip_;
     const unsigned tempSaversMax_;
     const unsigned tempLoadersMax_;
     const unsigned outputSaversMax_;
     const build::GapRealignerMode realignGaps_;
     const boost::filesystem::path &knownIndelsPath_;
     const int bamGzipLevel_;
+    const bgzf::DeflateBackend bamDeflateBackend_;
     const std::string &bamPuFormat_;
     const bool bamProduceMd5_;
     const std::vector<std::string> &bamHeaderTags_;
@@ -268,11 +282,18 @@ private:
     const bool keepDuplicates_;
     const bool markDuplicates_;
     const bool anchorMate_;
+    const build::DuplicateGroupingMode duplicateGrouping_;
     const bool bufferBins_;
+    const bool referenceHashCache_;
+    const bool referenceHashNumaReplicas_;
+    const bool annotationCache_;
+    const bool annotationNumaReplicas_;
     const bool qScoreBin_;
     const boost::array<char, 256> &fullBclQScoreTable_;
     const OptionalFeatures optionalFeatures_;
     const bool pessimisticMapQ_;
+    // Build runs alongside alignment, taking the bins as they are done
+    const bool pipelineBuild_;
     const std::string &binRegexString_;
     const common::ScopedMallocBlock::Mode memoryControl_;
     const alignment::TemplateLengthStatistics userTemplateLengthStatistics_;
@@ -289,21 +310,27 @@ private:
     SelectedMatchesMetadata selectedMatchesMetadata_;
     std::vector<alignment::TemplateLengthStatistics> barcodeTemplateLengthStatistics_;
     build::BarcodeBamMapping barcodeBamMapping_;
+    // Build has already run alongside alignment
+    bool bamGeneratedWithAlignment_;
 
 
     static reference::SortedReferenceMetadataList loadSortedReferenceXml(
         const unsigned seedLength,
         const reference::ReferenceMetadataList &referenceMetadataList);
 
+    uint64_t getBinMemory() const;
     void findMatches(
         alignWorkflow::FoundMatchesMetadata &foundMatches,
         alignment::BinMetadataList &binMetadataList,
-        std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics) const;
+        std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
+        build::BinQueue *binQueue) const;
     void cleanupBins() const;
     void generateAlignmentReports() const;
     const build::BarcodeBamMapping generateBam(
         const SelectedMatchesMetadata &binPaths,
-        const std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics) const;
+        const std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
+        build::BinQueue *binQueue) const;
+    void findMatchesAndGenerateBam();
     void selectMatches(
         alignment::matchSelector::FragmentStorage& fragmentStorage,
         alignWorkflow::FoundMatchesMetadata& foundMatches,
@@ -0,0 +1,167 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchWorkflow.hh
+ **
+ ** \brief Benchmarks the engines of isaac-align on synthetic data.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_WORKFLOW_BENCH_WORKFLOW_HH
+#define iSAAC_WORKFLOW_BENCH_WORKFLOW_HH
+
+#include <memory>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "alignment/AlignmentCfg.hh"
+#include "alignment/BinMetadata.hh"
+#include "alignment/BclClusters.hh"
+#include "alignment/Cigar.hh"
+#include "alignment/Cluster.hh"
+#include "alignment/FragmentMetadata.hh"
+#include "alignment/SeedMetadata.hh"
+#include "alignment/TemplateLengthStatistics.hh"
+#include "alignment/matchSelector/BinIndexMap.hh"
+#include "common/Threads.hpp"
+#include "flowcell/BarcodeMetadata.hh"
+#include "flowcell/Layout.hh"
+#include "flowcell/ReadMetadata.hh"
+#include "flowcell/TileMetadata.hh"
+#include "oligo/Kmer.hh"
+#include "reference/Contig.hh"
+#include "reference/KUniqueness.hh"
+#include "reference/ReferenceHash.hh"
+#include "reference/SortedReferenceMetadata.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+
+namespace bfs = boost::filesystem;
+
+/**
+ * \brief Generates a random reference and read pairs sampled from it, then runs the engines of isaac-align one
+ *        after another, each on what the previous one produced: hashing the reference, loading fastq, seed lookup,
+ *        ungapped and Smith-Waterman alignment, template building, binning, duplicate filtering with bam
+ *        serialization and bam loading. The whole chain is repeated and the fastest run of each engine is reported.
+ *
+ *        Results are tab-separated lines in a fixed order: benchmark, items, seconds, items per second and checksum.
+ *        Items and checksums depend only on the options and the code. When they differ between two releases,
+ *        the engine produces different results, not just produces them at a different speed.
+ */
+class BenchWorkflow: boost::noncopyable
+{
+public:
+    BenchWorkflow(
+        const bfs::path &tempDirectory,
+        const bfs::path &outputFile,
+        const unsigned threads,
+        const unsigned seed,
+        const unsigned repeats,
+        const uint64_t referenceLength,
+        const unsigned contigs,
+        const unsigned clusters,
+        const unsigned readLength,
+        const unsigned bamGzipLevel);
+
+    void run();
+
+private:
+    // isaac-align hashes 16-mers which needs 16 gigabytes for the offsets table. 8-mers need 256 kilobytes and
+    // get extended to 16 bases when they hit repeats.
+    typedef oligo::VeryShortKmerType KmerT;
+    typedef reference::ReferenceHash<KmerT> ReferenceHashT;
+
+    struct Result
+    {
+        explicit Result(const std::string &name) : name_(name), items_(0), seconds_(0.0), checksum_(0) {}
+        std::string name_;
+        uint64_t items_;
+        double seconds_;
+        uint64_t checksum_;
+    };
+    typedef std::vector<Result> Results;
+
+    /// where the read comes from. Sequence is as it appears on the forward strand, with the errors
+    struct SyntheticRead
+    {
+        unsigned contigId_;
+        int64_t position_;
+        bool reverse_;
+        std::vector<char> forward_;
+    };
+
+    const bfs::path tempDirectory_;
+    const bfs::path outputFile_;
+    const unsigned threadsCount_;
+    const unsigned seed_;
+    const unsigned repeats_;
+    const uint64_t referenceLength_;
+    const unsigned contigsCount_;
+    const unsigned clustersCount_;
+    const unsigned readLength_;
+    const unsigned bamGzipLevel_;
+    const bfs::path fastqPaths_[2];
+    const bfs::path bamPath_;
+
+    common::ThreadVector threads_;
+    const flowcell::ReadMetadataList readMetadataList_;
+    const alignment::SeedMetadataList seedMetadataList_;
+    const flowcell::FlowcellLayoutList flowcellLayoutList_;
+    const flowcell::TileMetadataList tileMetadataList_;
+    flowcell::BarcodeMetadataList barcodeMetadataList_;
+    const reference::NumaContigLists contigLists_;
+    const reference::ContigList &contigList_;
+    const reference::NumaContigAnnotationsList annotations_;
+    const reference::ContigAnnotations &contigAnnotations_;
+    const reference::SortedReferenceMetadataList sortedReferenceMetadataList_;
+    const alignment::matchSelector::BinIndexMap binIndexMap_;
+    const alignment::AlignmentCfg alignmentCfg_;
+    const alignment::TemplateLengthStatistics templateLengthStatistics_;
+
+    std::vector<SyntheticRead> reads_;
+    std::string fastq0_;
+
+    // produced by one engine for the next one
+    std::unique_ptr<ReferenceHashT> referenceHash_;
+    alignment::BclClusters bclClusters_;
+    std::vector<alignment::Cluster> clusters_;
+    alignment::Cigar cigarBuffer_;
+    std::vector<alignment::FragmentMetadata> fragments_;
+    std::vector<char> packedFragments_;
+    alignment::BinMetadataList binMetadataList_;
+
+    void generateReads();
+    void runEngines(Results &results);
+
+    void hashReference(Result &result);
+    void loadFastq(Result &result);
+    void compressFastq(Result &result);
+    void findSeedMatches(Result &result);
+    void alignUngapped(Result &result);
+    void alignSmithWaterman(Result &single, Result &batch);
+    void buildTemplates(Result &result);
+    void binFragments(Result &result);
+    void sortBins(Result &result);
+    void loadBam(Result &result);
+
+    void printResults(std::ostream &os, const Results &results) const;
+};
+
+} // namespace workflow
+} // namespace isaac
+
+#endif // #ifndef iSAAC_WORKFLOW_BENCH_WORKFLOW_HH
@@ -0,0 +1,110 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file FindAllNeighborsWorkflow.hh
+ **
+ ** \brief Produces the k-uniqueness and k-repeatness annotations in one process.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_WORKFLOW_FIND_ALL_NEIGHBORS_WORKFLOW_HH
+#define iSAAC_WORKFLOW_FIND_ALL_NEIGHBORS_WORKFLOW_HH
+
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "reference/AnnotationsMerger.hh"
+#include "reference/NeighborsFinder.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+
+/**
+ * \brief Does what the chain of findNeighbors and mergeAnnotations runs in FindNeighbors.mk does without
+ *        reloading the genome for each of them and without the intermediate files.
+ *
+ *        For each seed length the 0, 1 and 2-mismatch neighbors of all masks are counted into in-memory
+ *        annotations, combined the same way zero-and-zero and zero-and-leq100 do, and folded into the
+ *        k-uniqueness and k-repeatness annotations with mask-<seed length>.
+ *
+ *        When the k-mers of a mask don't fit in the memory limit, the mask is split on the next bits of the
+ *        permuted k-mer prefix until each partition fits. Neighbors share the prefix so no pair is lost.
+ */
+class FindAllNeighborsWorkflow: boost::noncopyable
+{
+public:
+
+    FindAllNeighborsWorkflow(
+        const std::vector<unsigned> &seedLengths,
+        const boost::filesystem::path &referenceGenome,
+        const boost::filesystem::path &uniquenessFile,
+        const boost::filesystem::path &repeatnessFile,
+        const unsigned jobs,
+        const uint64_t memoryLimit);
+
+    void run(const unsigned int maskWidth);
+
+    template <typename KmerT>
+    void annotateSeedLength(const unsigned int maskWidth);
+
+private:
+    // same as zero-and-leq100 in FindNeighbors.mk
+    static const unsigned NEIGHBORS_MAX = 100;
+
+    const std::vector<unsigned> seedLengths_;
+    const boost::filesystem::path uniquenessFile_;
+    const boost::filesystem::path repeatnessFile_;
+    // bytes. 0 keeps all k-mers of a mask in memory at once
+    const uint64_t memoryLimit_;
+    // part of memoryLimit_ left for k-mers once the annotations are allocated
+    uint64_t kmerMemoryLimit_;
+    const reference::SortedReferenceMetadata sortedReferenceMetadata_;
+    common::ThreadVector threads_;
+    const reference::ContigList contigList_;
+    reference::AnnotationsMerger uniquenessMerger_;
+    reference::AnnotationsMerger repeatnessMerger_;
+
+    // two neighbor counts are enough to combine the edit distances of one seed length
+    std::vector<reference::NeighborsCount> neighbors_;
+    std::vector<reference::NeighborsCount> moreNeighbors_;
+    std::vector<reference::DistanceToBeNeighborless> uniqueness_;
+    std::vector<reference::DistanceToBeNeighborless> repeatness_;
+
+    template <typename KmerT, typename KmerListT>
+    void countNeighbors(
+        const unsigned int maskWidth,
+        const unsigned neighborhoodWidth,
+        KmerListT &kmerList,
+        std::vector<reference::NeighborsCount> &annotation);
+
+    template <typename KmerT, typename KmerListT>
+    void countPartition(
+        const unsigned partitionMaskWidth,
+        const unsigned partitionMask,
+        const unsigned neighborhoodWidth,
+        KmerListT &kmerList,
+        std::vector<reference::NeighborsCount> &annotation);
+
+    uint64_t getKmerMemoryLimit() const;
+
+    template <typename MergeT>
+    void parallelMerge(MergeT merge);
+};
+
+} // namespace workflow
+} //namespace isaac
+
+#endif // #ifndef iSAAC_WORKFLOW_FIND_ALL_NEIGHBORS_WORKFLOW_HH
@@ -52,11 +52,13 @@ public:
         const std::size_t maxBamFileLength,
         const std::size_t maxFlowcellIdLength,
         const std::size_t minClusterLength,
-        const std::size_t minReadLength) :
+        const std::size_t minReadLength,
+        const std::size_t unpairedMemoryLimit) :
         bamLoader_(maxPathLength, threads, coresMax),
         clusterExtractor_(tempDirectoryPath, maxBamFileLength, maxFlowcellIdLength, minClusterLength, cleanupIntermediary,
                           // assume each uncompressed bam record is roughly sizeof(header) + (read length * 2). Double the estimate.
-                          bamLoader_.BUFFER_SIZE / (sizeof(bam::BamBlockHeader) + minReadLength * 2) * 2)
+                          bamLoader_.BUFFER_SIZE / (sizeof(bam::BamBlockHeader) + minReadLength * 2) * 2,
+                          unpairedMemoryLimit)
     {
         flowcellId_.reserve(maxFlowcellIdLength);
     }
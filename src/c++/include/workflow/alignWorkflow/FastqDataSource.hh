@@ -53,6 +53,7 @@ public:
     FastqBaseCallsSource(
         const unsigned clustersAtATimeMax,
         const unsigned coresMax,
+        const bool parallelGzip,
         const flowcell::BarcodeMetadataList &barcodeMetadataList,
         const flowcell::Layout &fastqFlowcellLayout,
         common::ThreadVector &threads);
@@ -25,6 +25,7 @@
 #include "alignment/matchFinder/TileClusterInfo.hh"
 #include "alignment/HashMatchFinder.hh"
 #include "alignment/MatchSelector.hh"
+#include "build/BinQueue.hh"
 #include "common/Threads.hpp"
 #include "demultiplexing/BarcodeLoader.hh"
 #include "demultiplexing/BarcodeResolver.hh"
@@ -41,6 +42,7 @@
 #include "workflow/alignWorkflow/BclDataSource.hh"
 #include "workflow/alignWorkflow/DataSource.hh"
 #include "workflow/alignWorkflow/FoundMatchesMetadata.hh"
+#include "workflow/alignWorkflow/TilePipeline.hh"
 
 namespace isaac
 {
@@ -53,58 +55,77 @@ namespace bfs = boost::filesystem;
 namespace findHashMatchesTransition
 {
 
+/**
+ * \brief One BclClusters buffer per tile that can be in flight: loading, match selection and the ones loaded ahead.
+ */
+class TileBuffers : public BasicTileBuffers<alignment::BclClusters>
+{
+public:
+    TileBuffers(
+        const unsigned count,
+        const flowcell::Layout &flowcellLayout,
+        const unsigned maxTileClusters,
+        const bool extractClusterXy) :
+            BasicTileBuffers<alignment::BclClusters>(count, alignment::BclClusters(getClusterLength(flowcellLayout)))
+    {
+        for (unsigned buffer = 0; count != buffer; ++buffer)
+        {
+            get(buffer).reserveClusters(maxTileClusters, extractClusterXy);
+        }
+    }
 
+    /**
+     * \return number of bytes the buffers need to hold count tiles of maxTileClusters each
+     */
+    static std::size_t getMemoryRequirements(
+        const unsigned count,
+        const flowcell::Layout &flowcellLayout,
+        const std::size_t maxTileClusters,
+        const bool extractClusterXy)
+    {
+        return count * maxTileClusters *
+            // bcl bytes plus the pass filter flag
+            (getClusterLength(flowcellLayout) + 1 + (extractClusterXy ? sizeof(alignment::ClusterXy) : 0));
+    }
 
+private:
+    static unsigned getClusterLength(const flowcell::Layout &flowcellLayout)
+    {
+        return flowcell::getTotalReadLength(flowcellLayout.getReadMetadataList()) +
+            flowcellLayout.getBarcodeLength() + flowcellLayout.getReadNameLength();
+    }
+};
 
 class Thread
 {
 public:
     Thread(
-        boost::mutex &mutex,
-        boost::condition_variable &stateChangedCondition,
-        bool &loading,
-        bool &flushing,
-        bool &forceTermination,
         const flowcell::Layout &flowcellLayout,
-        const unsigned maxTileClusters,
-        const bool extractClusterXy,
         const bool qScoreBin,
         const boost::array<char, 256> &fullBclQScoreTable,
         alignment::MatchSelector &matchSelector,
         alignment::matchSelector::FragmentStorage &fragmentStorage):
-            mutex_(mutex),
-            stateChangedCondition_(stateChangedCondition),
-            loading_(loading),
-            flushing_(flushing),
-            forceTermination_(forceTermination),
             flowcellLayout_(flowcellLayout),
             qScoreBin_(qScoreBin),
             fullBclQScoreTable_(fullBclQScoreTable),
             matchSelector_(matchSelector),
             fragmentStorage_(fragmentStorage),
-            tileClusters_(flowcell::getTotalReadLength(flowcellLayout.getReadMetadataList()) + flowcellLayout.getBarcodeLength() + flowcellLayout.getReadNameLength()),
             bclFields_(flowcellLayout.getReadMetadataList(), flowcellLayout.getBarcodeLength())
 
     {
-        tileClusters_.reserveClusters(maxTileClusters, extractClusterXy);
     }
 
     template <typename ReferenceHashT, typename DataSourceT>
     void run(
         const flowcell::TileMetadataList &unprocessedTiles,
-        unsigned &currentTile,
-        unsigned &nextUnprocessedTile,
+        TilePipeline &tilePipeline,
+        TileBuffers &tileBuffers,
         DataSourceT &dataSource,
         alignment::SeedHashMatchFinder<ReferenceHashT> &matchFinder,
         alignment::matchFinder::TileClusterInfo &tileClusterInfo,
         std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
         common::ScopedMallocBlock &mallocBlock);
 private:
-    boost::mutex &mutex_;
-    boost::condition_variable &stateChangedCondition_;
-    bool &loading_;
-    bool &flushing_;
-    bool &forceTermination_;
     const flowcell::Layout &flowcellLayout_;
     const bool qScoreBin_;
     const boost::array<char, 256> &fullBclQScoreTable_;
@@ -112,11 +133,17 @@ private:
     alignment::MatchSelector &matchSelector_;
     alignment::matchSelector::FragmentStorage &fragmentStorage_;
 
-    alignment::BclClusters tileClusters_;
     typedef alignment::BclClusterFields<alignment::BclClusters::iterator> BclClusterFields;
     BclClusterFields bclFields_;
 
     void binQscores(alignment::BclClusters &bclData) const;
+
+    template <typename DataSourceT>
+    void load(
+        const flowcell::TileMetadata &tileMetadata,
+        alignment::BclClusters &tileClusters,
+        DataSourceT &dataSource,
+        common::ScopedMallocBlock &mallocBlock);
 };
 } // namespace findHashMatchesTransition
 
@@ -145,6 +172,7 @@ public:
         const bool ignoreNeighbors,
         const bool ignoreRepeats,
         const unsigned inputLoadersMax,
+        const bool parallelGzip,
         const unsigned tempSaversMax,
         const common::ScopedMallocBlock::Mode memoryControl,
         const std::vector<std::size_t> &clusterIdList,
@@ -176,16 +204,20 @@ public:
         const int gapExtendScore,
         const int minGapExtendScore,
         const unsigned splitGapLength,
+        const unsigned smithWatermanBandWidth,
         const alignment::TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore,
         const bool qScoreBin,
         const boost::array<char, 256> &fullBclQScoreTable,
         const bool bufferBins_,
+        const bfs::path &referenceHashDirectory,
+        const bool referenceHashNumaReplicas,
         const unsigned expectedCoverage,
         const uint64_t targetBinSize,
         const double expectedBgzfCompressionRatio,
         const bool preSortBins,
         const bool preAllocateBins,
-        const std::string &binRegexString);
+        const std::string &binRegexString,
+        build::BinQueue *binQueue);
 
     template <typename KmerT>
     void perform(
@@ -214,6 +246,7 @@ private:
     const bool ignoreNeighbors_;
     const bool ignoreRepeats_;
     const unsigned inputLoadersMax_;
+    const bool parallelGzip_;
     const unsigned tempSaversMax_;
     const common::ScopedMallocBlock::Mode memoryControl_;
     const std::vector<size_t> &clusterIdList_;
@@ -222,6 +255,10 @@ private:
     const bool extractClusterXy_;
 
     const bool bufferBins_;
+    // empty unless the reference hash is to be stored and memory-mapped from the reference directory
+    const bfs::path referenceHashDirectory_;
+    // copy the mapped reference hash into each NUMA node instead of using the mapping directly
+    const bool referenceHashNumaReplicas_;
     const unsigned expectedCoverage_;
     const uint64_t targetBinSize_;
     const double expectedBgzfCompressionRatio_;
@@ -229,6 +266,12 @@ private:
     const bool preSortBins_;
     const bool preAllocateBins_;
     const std::string &binRegexString_;
+    // 0 unless Build takes the bins as they get sealed
+    build::BinQueue *const binQueue_;
+    // bin group of each barcode. Empty unless Build takes the bins as they get sealed
+    const std::vector<unsigned> barcodeBinGroups_;
+    // bin group of each bin of the current run
+    std::vector<unsigned> binGroups_;
 
     common::ThreadVector threads_;
     common::ThreadVector ioOverlapThreads_;
@@ -241,6 +284,10 @@ private:
     const boost::array<char, 256> &fullBclQScoreTable_;
 
 
+    uint64_t getTileBuffersMemory() const;
+    uint64_t getAlignmentMemory() const;
+    void releaseAlignmentMemory(const uint64_t &bytes, const bool exceptionUnwinding) const;
+
     template <typename KmerT>
     void align(
         FoundMatchesMetadata &foundMatches,
@@ -251,6 +298,7 @@ private:
     template <typename ReferenceHashT>
     void alignFlowcells(
         const ReferenceHashT &referenceHash,
+        const alignment::BinMetadataList &binMetadataList,
         std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
         demultiplexing::DemultiplexingStats &demultiplexingStats,
         FoundMatchesMetadata &foundMatches,
@@ -299,12 +347,29 @@ private:
     void processFlowcellTiles(
         const ReferenceHashT &referenceHash,
         const flowcell::Layout& flowcell,
+        const alignment::BinMetadataList &binMetadataList,
         DataSourceT &dataSource,
         demultiplexing::DemultiplexingStats &demultiplexingStats,
         std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
         FoundMatchesMetadata &foundMatches,
         alignment::matchSelector::FragmentStorage &fragmentStorage);
 
+    std::vector<unsigned> getLaneBins(
+        const flowcell::Layout& flowcell,
+        const unsigned lane,
+        const alignment::BinMetadataList &binMetadataList) const;
+
+    void expectLanes(
+        const alignment::BinMetadataList &binMetadataList,
+        alignment::matchSelector::FragmentStorage &fragmentStorage) const;
+
+    void sealLane(
+        const flowcell::Layout& flowcell,
+        const unsigned lane,
+        const alignment::BinMetadataList &binMetadataList,
+        const flowcell::TileMetadataList &tileMetadataList,
+        alignment::matchSelector::FragmentStorage &fragmentStorage) const;
+
     void dumpStats(
         const demultiplexing::DemultiplexingStats &demultiplexingStats,
         const flowcell::TileMetadataList &tileMetadataList) const;
@@ -0,0 +1,233 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file TilePipeline.hh
+ **
+ ** \brief Moves the tiles through loading, match selection and flushing.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_WORKFLOW_ALIGN_WORKFLOW_TILE_PIPELINE_HH
+#define iSAAC_WORKFLOW_ALIGN_WORKFLOW_TILE_PIPELINE_HH
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Exceptions.hh"
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace alignWorkflow
+{
+
+/**
+ * \brief Tile data loaded ahead of the match selection. The number of buffers bounds how far the loading can run
+ *        ahead. Loads take a free buffer, loaded buffers queue up in the tile order and the match selection gives
+ *        the front one back as soon as its fragments are handed over to the fragment storage.
+ */
+template <typename BufferT>
+class BasicTileBuffers
+{
+public:
+    BasicTileBuffers(const unsigned count, const BufferT &buffer) : buffers_(count, buffer)
+    {
+        free_.reserve(count);
+        loaded_.reserve(count);
+        for (unsigned i = 0; count != i; ++i)
+        {
+            free_.push_back(i);
+        }
+    }
+
+    bool hasFree() const {return !free_.empty();}
+    bool hasLoaded() const {return !loaded_.empty();}
+
+    unsigned takeFree() {const unsigned ret = free_.back(); free_.pop_back(); return ret;}
+    /// \param buffer holds the tile that follows the ones loaded so far
+    void pushLoaded(const unsigned buffer) {loaded_.push_back(buffer);}
+    /// \return the buffer holding the earliest of the loaded tiles
+    unsigned frontLoaded() const {return loaded_.front();}
+    void releaseFrontLoaded() {free_.push_back(loaded_.front()); loaded_.erase(loaded_.begin());}
+
+    BufferT &get(const unsigned buffer) {return buffers_.at(buffer);}
+    unsigned size() const {return buffers_.size();}
+
+private:
+    std::vector<BufferT> buffers_;
+    std::vector<unsigned> free_;
+    std::vector<unsigned> loaded_;
+};
+
+/**
+ * \brief Each thread takes whatever stage has work. Match selection of the next tile in order goes first. Otherwise
+ *        the thread loads ahead as long as there is a free tile buffer. Nobody holds on to a loaded tile waiting for
+ *        its turn, so a thread done with a flush or a load picks up the match selection or the next load right away.
+ *
+ *        Loads run one at a time, so the tiles get loaded in order. Tiles go through match selection one at a time
+ *        and in order as well: unless per-tile detection is requested, template length statistics detected on a
+ *        tile carry over to the tiles after it, match selector statistics and fragment storage flush buffers hold
+ *        one tile at a time, and bin 0 keeps unaligned records in the order they are flushed. The number of tile
+ *        buffers changes the timing only, never the output.
+ */
+class TilePipeline: boost::noncopyable
+{
+public:
+    explicit TilePipeline(const unsigned tiles) :
+        tiles_(tiles), nextTile_(0), nextUnprocessedTile_(0),
+        loading_(false), computing_(false), flushing_(false), forceTermination_(false)
+    {
+    }
+
+    /**
+     * \param load          void(tile, buffer) fills the buffer with the tile data
+     * \param select        void(tile, buffer) selects the matches of the tile
+     * \param prepareFlush  void() hands the selected fragments over for flushing. Called with the pipeline locked
+     * \param flush         void() flushes the fragments handed over by prepareFlush
+     */
+    template <typename BufferT, typename LoadT, typename SelectT, typename PrepareFlushT, typename FlushT>
+    void run(
+        BasicTileBuffers<BufferT> &tileBuffers,
+        LoadT load,
+        SelectT select,
+        PrepareFlushT prepareFlush,
+        FlushT flush)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (tiles_ != nextUnprocessedTile_)
+        {
+            if (forceTermination_)
+            {
+                BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
+            }
+
+            if (!computing_ && tileBuffers.hasLoaded())
+            {
+                selectAndFlush(tileBuffers, select, prepareFlush, flush, lock);
+            }
+            else if (!loading_ && tiles_ != nextTile_ && tileBuffers.hasFree())
+            {
+                loadNext(tileBuffers, load, lock);
+            }
+            else
+            {
+                stateChangedCondition_.wait(lock);
+            }
+        }
+    }
+
+private:
+    const unsigned tiles_;
+    unsigned nextTile_;
+    unsigned nextUnprocessedTile_;
+
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    bool loading_;
+    bool computing_;
+    bool flushing_;
+    bool forceTermination_;
+
+    void wait(bool &signal, boost::unique_lock<boost::mutex> &lock)
+    {
+        if (forceTermination_)
+        {
+            BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
+        }
+
+        while (signal)
+        {
+            if (forceTermination_)
+            {
+                BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
+            }
+
+            stateChangedCondition_.wait(lock);
+        }
+        signal = true;
+    }
+
+    void release(bool &signal, const bool exceptionUnwinding)
+    {
+        if (exceptionUnwinding)
+        {
+            forceTermination_ = true;
+        }
+        signal = false;
+        stateChangedCondition_.notify_all();
+    }
+
+    template <typename BufferT, typename LoadT>
+    void loadNext(BasicTileBuffers<BufferT> &tileBuffers, LoadT &load, boost::unique_lock<boost::mutex> &lock)
+    {
+        const unsigned tile = nextTile_++;
+        const unsigned buffer = tileBuffers.takeFree();
+
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&TilePipeline::release, this, boost::ref(loading_), _1))
+        {
+            wait(loading_, lock);
+            {
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                load(tile, tileBuffers.get(buffer));
+            }
+            tileBuffers.pushLoaded(buffer);
+        }
+    }
+
+    template <typename BufferT, typename SelectT, typename PrepareFlushT, typename FlushT>
+    void selectAndFlush(
+        BasicTileBuffers<BufferT> &tileBuffers,
+        SelectT &select,
+        PrepareFlushT &prepareFlush,
+        FlushT &flush,
+        boost::unique_lock<boost::mutex> &lock)
+    {
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&TilePipeline::release, this, boost::ref(computing_), _1))
+        {
+            wait(computing_, lock);
+            {
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                select(nextUnprocessedTile_, tileBuffers.get(tileBuffers.frontLoaded()));
+            }
+
+            // swap the flush buffers while we still have compute lock
+            wait(flushing_, lock);
+            prepareFlush();
+            // the fragments are in the flush buffers now. Let the next tile load into the tile buffer
+            tileBuffers.releaseFrontLoaded();
+            ++nextUnprocessedTile_;
+        }
+
+        // flush asynchronously so that other guys can load and align at the same time
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&TilePipeline::release, this, boost::ref(flushing_), _1))
+        {
+            // flush slot already acquired when we had the compute slot but the state could have changed in between.
+            if (forceTermination_)
+            {
+                BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
+            }
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            flush();
+        }
+    }
+};
+
+} // namespace alignWorkflow
+} // namespace workflow
+} // namespace isaac
+
+#endif // #ifndef iSAAC_WORKFLOW_ALIGN_WORKFLOW_TILE_PIPELINE_HH
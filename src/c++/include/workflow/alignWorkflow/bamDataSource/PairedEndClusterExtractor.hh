@@ -21,6 +21,7 @@
 #define iSAAC_WORKFLOW_ALIGN_WORKFLOW_BAM_DATA_SOURCE_PAIRED_END_CLUSTER_EXTRACTOR_HH
 
 #include <cmath>
+#include <deque>
 
 #include <boost/crc.hpp>
 #include <boost/filesystem.hpp>
@@ -293,37 +294,63 @@ class UnpairedReadsCache
         }
     };
 
+    /**
+     * \brief Temporary file of unpaired records that have the same name hash. Partitions that don't fit into
+     *        the memory limit are split into sub-partitions on disk before pairing.
+     */
+    struct Partition
+    {
+        Partition(const std::string &path, const std::size_t size, const unsigned level) :
+            path_(path), size_(size), level_(level){}
+        std::string path_;
+        std::size_t size_;
+        // number of splits this partition is the result of
+        unsigned level_;
+    };
+
+    // each split uses the next 8 bits of the name crc32
+    static const unsigned SPLIT_LEVELS_MAX = 3;
+
+    const std::size_t memoryLimit_;
     const unsigned crcWidth_;
     const bool cleanupIntermediary_;
     const boost::filesystem::path &tempDirectoryPath_;
     std::vector<std::string> tempFilePaths_;
     std::vector<std::size_t> tempFileSizes_;
-    std::vector<std::string>::const_iterator extractorFileIterator_;
+    // sub-partitions produced by splitting oversized partitions
+    std::vector<std::string> splitFilePaths_;
+    // partitions waiting to be paired in the order of extraction
+    std::deque<Partition> pendingPartitions_;
     bool extracting_;
     std::vector<io::FileBufHolder<io::FileBufWithReopen> > tempFiles_;
     std::string tempFilePathBuffer_;
     TempFileClusterExtractor extractor_;
+public:
     // aim to have ~3 gigabyte temp files assuming none of the input reads pair
     static const std::size_t UNPAIRED_BUFFER_SIZE = 1024UL * 1024UL * 1024UL * 3UL;
-public:
+
+    /**
+     * \param memoryLimit  maximum number of bytes of unpaired records loaded at a time for pairing
+     */
     UnpairedReadsCache(
         const boost::filesystem::path &tempDirectoryPath,
         const std::size_t maxBamFileSize,
         const std::size_t maxFlowcellIdLength,
         const std::size_t minClusterLength,
-        const bool cleanupIntermediary) :
-            crcWidth_(log2(std::max<std::size_t>(1, maxBamFileSize / UNPAIRED_BUFFER_SIZE))),
+        const bool cleanupIntermediary,
+        const std::size_t memoryLimit) :
+            memoryLimit_(memoryLimit),
+            crcWidth_(std::min<unsigned>(7, log2(std::max<std::size_t>(1, maxBamFileSize / memoryLimit_)))),
             cleanupIntermediary_(cleanupIntermediary),
             tempDirectoryPath_(tempDirectoryPath),
             tempFilePaths_(1 << getEffectiveCrcWidth<7>(crcWidth_)),
             tempFileSizes_(tempFilePaths_.size(), 0),
-            extractorFileIterator_(tempFilePaths_.end()),
             extracting_(false),
             tempFiles_(
-                1 << getEffectiveCrcWidth<7>(crcWidth_),
+                tempFilePaths_.size(),
                 io::FileBufHolder<io::FileBufWithReopen>(std::ios_base::out | std::ios_base::app | std::ios_base::binary,
                                                          getMaxTempFilePathLength(maxFlowcellIdLength))),
-            extractor_(getMaxTempFilePathLength(maxFlowcellIdLength), UNPAIRED_BUFFER_SIZE, minClusterLength)
+            extractor_(getMaxTempFilePathLength(maxFlowcellIdLength), memoryLimit_, minClusterLength)
     {
         tempFilePathBuffer_.reserve(getMaxTempFilePathLength(maxFlowcellIdLength));
         BOOST_FOREACH(std::string &tempPath, tempFilePaths_)
@@ -343,6 +370,15 @@ public:
 
     bool extractingUnpaired() const {return extracting_;}
 
+    /**
+     * \return index of the top level partition the read name goes to. Unpaired clusters are extracted in the order
+     *         of these partitions.
+     */
+    unsigned getPartition(const char *name, const std::size_t nameLength) const
+    {
+        return getNameCrc<7>(crcWidth_, name, nameLength);
+    }
+
     void cleanupIntermediary()
     {
         if (cleanupIntermediary_)
@@ -359,7 +395,17 @@ public:
                     }
                 }
             }
+            BOOST_FOREACH(const std::string &splitPath, splitFilePaths_)
+            {
+                ISAAC_THREAD_CERR << "Deleting unpaired segments file " << splitPath << std::endl;
+                if (unlink(splitPath.c_str()))
+                {
+                    BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to unlink %s: %s") %
+                        splitPath % strerror(errno)).str()));
+                }
+            }
         }
+        splitFilePaths_.clear();
     }
 
     void open(const std::string &flowcellId)
@@ -375,6 +421,7 @@ public:
             tempFileSizes_[i] = 0;
             ++i;
         }
+        pendingPartitions_.clear();
         extracting_ = false;
     }
 
@@ -383,9 +430,12 @@ public:
         ISAAC_THREAD_CERR << "startExtractingUnpaired " << std::endl;
         std::for_each(tempFiles_.begin(), tempFiles_.end(), boost::bind(&io::FileBufHolder<io::FileBufWithReopen>::flush, _1));
 
-        extractorFileIterator_ = tempFilePaths_.begin();
-        extractor_.open(
-            *extractorFileIterator_, tempFileSizes_[extractorFileIterator_ - tempFilePaths_.begin()]);
+        pendingPartitions_.clear();
+        for (std::size_t i = 0; tempFilePaths_.size() != i; ++i)
+        {
+            pendingPartitions_.push_back(Partition(tempFilePaths_[i], tempFileSizes_[i], 0));
+        }
+        openNextPartition();
         extracting_ = true;
     }
 
@@ -404,18 +454,12 @@ public:
         ClusterInsertIt &clusterIt,
         PfInsertIt &pfIt)
     {
-        while (tempFilePaths_.end() != extractorFileIterator_ && clusterCount)
+        while (clusterCount)
         {
             clusterCount = extractor_.extractClusters(r1Length, r2Length, nameLengthMax, clusterCount, clusterIt, pfIt);
-            if (clusterCount)
+            if (clusterCount && !openNextPartition())
             {
-                ++extractorFileIterator_;
-                if (tempFilePaths_.end() != extractorFileIterator_)
-                {
-                    extractor_.open(
-                        *extractorFileIterator_,
-                        tempFileSizes_[extractorFileIterator_ - tempFilePaths_.begin()]);
-                }
+                break;
             }
         }
         return clusterCount;
@@ -423,6 +467,21 @@ public:
 
 
 private:
+    /**
+     * \brief Loads the next pending partition into the extractor. Partitions that don't fit into memoryLimit_
+     *        are replaced with their sub-partitions first.
+     *
+     * \return false if there are no more partitions to extract
+     */
+    bool openNextPartition();
+
+    /**
+     * \brief Redistributes the records of the partition between the sub-partition files by the name hash and
+     *        queues the sub-partitions in front of the remaining ones. Records with the same name end up in the
+     *        same sub-partition.
+     */
+    void splitPartition(const Partition &partition);
+
     const char* makeTempFilePath(const std::string &flowcellId, unsigned crc)
     {
         return makeTempFilePath(flowcellId, crc, tempFilePathBuffer_).c_str();
@@ -442,7 +501,8 @@ private:
     std::size_t getMaxTempFilePathLength(const std::size_t maxFlowcellIdLength)
     {
         std::string buffer;
-        return makeTempFilePath(std::string(maxFlowcellIdLength, 'a'), 9999, buffer).size();
+        // each split appends -<sub-partition> to the name
+        return makeTempFilePath(std::string(maxFlowcellIdLength, 'a'), 9999, buffer).size() + SPLIT_LEVELS_MAX * 4;
     }
 
     template <unsigned N>
@@ -499,14 +559,16 @@ public:
         const std::size_t maxFlowcellIdLength,
         const std::size_t minClusterLength,
         const bool cleanupIntermediary,
-        const std::size_t expectedClustersPerClusterBlock) :
+        const std::size_t expectedClustersPerClusterBlock,
+        const std::size_t unpairedMemoryLimit) :
             firstUnextracted_(end()),
             unpairedReadCache_(
                 tempDirectoryPath,
                 maxBamFileLength,
                 maxFlowcellIdLength,
                 minClusterLength,
-                cleanupIntermediary)
+                cleanupIntermediary,
+                unpairedMemoryLimit)
     {
         ISAAC_THREAD_CERR << "Reserving IndexRecord buffer for " << expectedClustersPerClusterBlock << " records" << std::endl;
         reserve(expectedClustersPerClusterBlock);
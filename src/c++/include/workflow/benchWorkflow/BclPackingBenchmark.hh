@@ -0,0 +1,38 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BclPackingBenchmark.hh
+ **
+ ** \brief Fastq to bcl conversion rate of each supported packing kernel. 'isaac-bench bcl-packing'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_WORKFLOW_BENCH_WORKFLOW_BCL_PACKING_BENCHMARK_HH
+#define iSAAC_WORKFLOW_BENCH_WORKFLOW_BCL_PACKING_BENCHMARK_HH
+
+#include "options/BenchmarkBclPackingOptions.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace benchWorkflow
+{
+
+void benchmarkBclPacking(const options::BenchmarkBclPackingOptions &options);
+
+} // namespace benchWorkflow
+} // namespace workflow
+} // namespace isaac
+
+#endif // #ifndef iSAAC_WORKFLOW_BENCH_WORKFLOW_BCL_PACKING_BENCHMARK_HH
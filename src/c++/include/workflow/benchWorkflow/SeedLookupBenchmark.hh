@@ -0,0 +1,38 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file SeedLookupBenchmark.hh
+ **
+ ** \brief Seed lookup rate of the aligner with and without prefetching the reference hash data of the upcoming clusters. 'isaac-bench seed-lookup'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_WORKFLOW_BENCH_WORKFLOW_SEED_LOOKUP_BENCHMARK_HH
+#define iSAAC_WORKFLOW_BENCH_WORKFLOW_SEED_LOOKUP_BENCHMARK_HH
+
+#include "options/BenchmarkSeedLookupOptions.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace benchWorkflow
+{
+
+void benchmarkSeedLookup(const options::BenchmarkSeedLookupOptions &options);
+
+} // namespace benchWorkflow
+} // namespace workflow
+} // namespace isaac
+
+#endif // #ifndef iSAAC_WORKFLOW_BENCH_WORKFLOW_SEED_LOOKUP_BENCHMARK_HH
@@ -25,22 +25,313 @@
 #include <cstdint>
 
 #include "alignment/BandedSmithWaterman.hh"
+#include "common/CpuIsa.hh"
 
 namespace isaac
 {
 namespace alignment
 {
 
+/**
+ * \brief The loops are written for the compiler to vectorize. Kernels below get this inlined and vectorized for the
+ *        instruction set of their target.
+ *
+ *        All arrays are [band position][lane] so that shifting the band by one position is a shift by LANES values.
+ *        With LANES == 1 this is the original single alignment fill.
+ */
+struct BandedSmithWaterman::Kernels
+{
+    template <unsigned BAND, unsigned LANES>
+    static inline __attribute__((always_inline)) void cp(const int16_t *source, int16_t *destination)
+    {
+        // AV
+        for (size_t i = 0; i < BAND * LANES; i++) {
+            destination[i] = source[i];
+        }
+    }
+
+    template <unsigned BAND, unsigned LANES>
+    static inline __attribute__((always_inline)) void fillMatrices(
+        const BandedSmithWaterman &sw,
+        const BatchItem *items, const unsigned count,
+        int16_t *lastG, int16_t *lastE, int16_t *lastF)
+    {
+        static const unsigned N = BAND * LANES;
+        int16_t *t = &sw.T_.front();
+        const int16_t initialValue = sw.initialValue_;
+        const int16_t gapOpenScore = sw.gapOpenScore_;
+        const int16_t gapExtendScore = sw.gapExtendScore_;
+
+        unsigned queryLength[LANES];
+        unsigned queryLengthMax = 0;
+        const char *database[LANES];
+        for (unsigned l = 0; l < LANES; l++) {
+            queryLength[l] = l < count ? std::distance(items[l].queryBegin, items[l].queryEnd) : 0;
+            queryLengthMax = std::max(queryLengthMax, queryLength[l]);
+            database[l] = l < count ? sw.unpackDatabase(items[l], l) : 0;
+        }
+
+        // Initialize E, F and G
+        int16_t E[N], F[N], G[N];
+        for(unsigned i = 0; i < N; i++) {
+            E[i] = initialValue;
+            F[i] = 0;
+            G[i] = initialValue;
+        }
+        for (unsigned l = 0; l < LANES; l++) {
+            G[l] = 0;
+            if (!queryLength[l]) {
+                for (size_t i = 0; i < BAND; i++) {
+                    lastG[i * LANES + l] = G[i * LANES + l];
+                    lastE[i * LANES + l] = E[i * LANES + l];
+                    lastF[i * LANES + l] = F[i * LANES + l];
+                }
+            }
+        }
+        int16_t D[N];
+        for (unsigned l = 0; l < LANES; l++) {
+            // the last position gets shifted out before it is used
+            for (size_t i = 0; i < BAND - 1; i++) {
+                D[i * LANES + l] = queryLength[l] ? database[l][BAND - i - 2] : 0;
+            }
+            D[(BAND - 1) * LANES + l] = 0;
+        }
+
+        // iterate over all bases in the query
+        int16_t F1[N + LANES];
+        int16_t cmpgtEgMask1[N + LANES], maxEg1[N + LANES];
+        for (unsigned l = 0; l < LANES; l++) {
+            F1[l] = initialValue + gapExtendScore;
+            maxEg1[l] = initialValue + gapOpenScore;
+            cmpgtEgMask1[l] = 0;
+        }
+        for (unsigned queryOffset = 0; queryLengthMax != queryOffset; ++queryOffset)
+        {
+            int16_t TE[N], TF[N], TG[N];
+            int16_t D1[N + LANES];
+            int16_t Q[N];
+            int16_t GA[N];
+
+            // get F[i-1, j] - extend
+            int16_t cmpgtGfMask[N];
+
+            int16_t *cmpgtEgMaskOff = cmpgtEgMask1 + LANES;
+            int16_t *maxEgOff = maxEg1 + LANES;
+            // AV
+            for (size_t i = 0; i < N; i++) {
+                cmpgtEgMaskOff[i] = E[i] > G[i] ? 1 : 0;
+            }
+            for (size_t i = 0; i < N; i++) {
+                maxEgOff[i] = G[i] > E[i] ? G[i] : E[i];
+            }
+            for (size_t i = 0; i < N; i++) {
+                cmpgtGfMask[i] = F[i] > maxEgOff[i] ? 2 : 0;
+            }
+            for (size_t i = 0; i < N; i++) {
+                GA[i] = maxEgOff[i] > F[i] ? maxEgOff[i] : F[i];
+            }
+            for (size_t i = 0; i < N; i++) {
+                TG[i] =
+                       cmpgtEgMaskOff[i] >
+                    cmpgtGfMask[i] ? cmpgtEgMaskOff[i] : cmpgtGfMask[i];
+            }
+
+            cp<BAND, LANES>(F, F1 + LANES);
+            int16_t GF1[N], maxEgSubGapOpen1[N],
+                cmpgtGfMask1[N];
+            // AV
+            for (size_t i = 0; i < N; i++) {
+                GF1[i] = F1[i] - gapExtendScore;
+                maxEgSubGapOpen1[i] = maxEg1[i] - gapOpenScore;
+                cmpgtGfMask1[i] = GF1[i] > maxEgSubGapOpen1[i] ? 2 : 0;
+                TF[i] =
+                    cmpgtEgMask1[i] >
+                    cmpgtGfMask1[i] ? cmpgtEgMask1[i] : cmpgtGfMask1[i];
+                F[i] =
+                    maxEgSubGapOpen1[i] > GF1[i] ? maxEgSubGapOpen1[i] : GF1[i];
+            }
+
+            // add the match/mismatch score
+            // load the query base in all band positions of the lane.
+            // shift the database by one band position and add the new base.
+            // Lanes that are past the end of their query compute garbage that nobody looks at.
+            int16_t QL[LANES];
+            for (unsigned l = 0; l < LANES; l++) {
+                const bool inQuery = queryOffset < queryLength[l];
+                QL[l] = inQuery ? *(items[l].queryBegin + queryOffset) : 0;
+                D1[l] = inQuery ? database[l][queryOffset + (BAND - 1)] : 0;
+            }
+            for (size_t i = 0; i < BAND; i++) {
+                for (unsigned l = 0; l < LANES; l++) {
+                    Q[i * LANES + l] = QL[l];
+                }
+            }
+
+            cp<BAND, LANES>(D, D1 + LANES);
+            cp<BAND, LANES>(D1, D);
+
+            // compare query and database. 0xff if different (that also the sign bits)
+            int16_t B[N], Match[N],
+            Mismatch[N], W[N];
+
+            // lea
+            for (size_t i = 0; i < N; i++) {
+                B[i] = (Q[i] == D[i]) ? 0 : 0xFFFF;
+                Match[i] = (~B[i]) & sw.matchScore_;
+                Mismatch[i] = B[i] & sw.mismatchScore_;
+                W[i] = Match[i] + Mismatch[i];
+                G[i] = GA[i] + (W[i] | (B[i] & 0xFF00));
+            }
+
+            // E[i,j] = max(G[i, j-1] - open, E[i, j-1] - extend, F[i, j-1] - open)
+            int16_t cmpgtFgMask2[N + LANES], maxFg2[N + LANES];
+            int16_t *cmpgtFgMaskOff2 = cmpgtFgMask2 + LANES;
+            int16_t *maxFgOff2 = maxFg2 + LANES;
+            // AV
+            for (size_t i = 0; i < N; i++) {
+                cmpgtFgMask2[i] = F[i] > G[i] ? 2 : 0;
+                maxFg2[i] = F[i] > G[i] ? F[i] : G[i];
+                maxFg2[i] -= gapOpenScore;
+            }
+            for (unsigned l = 0; l < LANES; l++) {
+                maxFg2[N + l] = initialValue;
+                cmpgtFgMask2[N + l] = initialValue;
+            }
+
+            // the serial part. Vectorized across the lanes
+            int16_t e[LANES], fg[LANES];
+            for (unsigned l = 0; l < LANES; l++) {
+                e[l] = initialValue;
+                fg[l] = initialValue;
+            }
+            for (size_t i = BAND; i > 0; i--) {
+                for (unsigned l = 0; l < LANES; l++) {
+                    const int16_t max = e[l] > fg[l] ? e[l] : fg[l];
+                    E[(i - 1) * LANES + l] = max;
+                    fg[l] = maxFg2[(i - 1) * LANES + l];
+                    e[l] = max - gapExtendScore;
+                }
+            }
+
+            // lea
+            int16_t cmpgtFgSueFgMask2[N];
+            for (size_t i = 0; i < N; i++) {
+                cmpgtFgSueFgMask2[i] = E[i] > maxFgOff2[i] ? 5 : 0;
+                E[i] = E[i] > maxFgOff2[i] ? E[i] : maxFgOff2[i];
+                TE[i] =
+                    (cmpgtFgSueFgMask2[i] >
+                     cmpgtFgMaskOff2[i] ? cmpgtFgSueFgMask2[i] :
+                     cmpgtFgMaskOff2[i]) & 3;
+            }
+
+            for (unsigned l = 0; l < LANES; l++) {
+                TF[l] = 0;
+            }
+
+            cp<BAND, LANES>(TG, t);
+            cp<BAND, LANES>(TE, t + N);
+            cp<BAND, LANES>(TF, t + N * 2);
+            t += N * 3;
+
+            // scores for the last query base
+            for (unsigned l = 0; l < LANES; l++) {
+                if (queryOffset + 1 == queryLength[l]) {
+                    for (size_t i = 0; i < BAND; i++) {
+                        lastG[i * LANES + l] = G[i * LANES + l];
+                        lastE[i * LANES + l] = E[i * LANES + l];
+                        lastF[i * LANES + l] = F[i * LANES + l];
+                    }
+                }
+            }
+        }
+    }
+
+    template <unsigned BAND, unsigned LANES>
+    static void fillMatricesGeneric(
+        const BandedSmithWaterman &sw, const BatchItem *items, const unsigned count,
+        int16_t *G, int16_t *E, int16_t *F)
+    {
+        fillMatrices<BAND, LANES>(sw, items, count, G, E, F);
+    }
+
+#ifdef iSAAC_CPU_ISA_X86
+    template <unsigned BAND, unsigned LANES>
+    __attribute__((target("sse4.1"))) static void fillMatricesSse41(
+        const BandedSmithWaterman &sw, const BatchItem *items, const unsigned count,
+        int16_t *G, int16_t *E, int16_t *F)
+    {
+        fillMatrices<BAND, LANES>(sw, items, count, G, E, F);
+    }
+
+    template <unsigned BAND, unsigned LANES>
+    __attribute__((target("avx2"))) static void fillMatricesAvx2(
+        const BandedSmithWaterman &sw, const BatchItem *items, const unsigned count,
+        int16_t *G, int16_t *E, int16_t *F)
+    {
+        fillMatrices<BAND, LANES>(sw, items, count, G, E, F);
+    }
+
+    template <unsigned BAND, unsigned LANES>
+    __attribute__((target("avx512f,avx512bw"))) static void fillMatricesAvx512(
+        const BandedSmithWaterman &sw, const BatchItem *items, const unsigned count,
+        int16_t *G, int16_t *E, int16_t *F)
+    {
+        fillMatrices<BAND, LANES>(sw, items, count, G, E, F);
+    }
+#endif //iSAAC_CPU_ISA_X86
+
+    template <unsigned BAND, unsigned LANES>
+    static FillMatrices select(const common::CpuIsa isa)
+    {
+        switch (isa)
+        {
+#ifdef iSAAC_CPU_ISA_X86
+        case common::CpuIsaAvx512:
+            return fillMatricesAvx512<BAND, LANES>;
+        case common::CpuIsaAvx2:
+            return fillMatricesAvx2<BAND, LANES>;
+        case common::CpuIsaSse41:
+            return fillMatricesSse41<BAND, LANES>;
+#endif //iSAAC_CPU_ISA_X86
+        default:
+            return fillMatricesGeneric<BAND, LANES>;
+        }
+    }
+
+    template <unsigned LANES>
+    static FillMatrices select(const common::CpuIsa isa, const unsigned widestGapSize)
+    {
+        switch (widestGapSize)
+        {
+        case 16:
+            return select<16, LANES>(isa);
+        case 32:
+            return select<32, LANES>(isa);
+        case 64:
+            return select<64, LANES>(isa);
+        default:
+            BOOST_THROW_EXCEPTION(isaac::common::InvalidParameterException(
+                (boost::format("BandedSmithWaterman: unsupported band width %d. Supported are 16, 32 and 64") %
+                    widestGapSize).str()));
+        }
+    }
+};
+
 BandedSmithWaterman::BandedSmithWaterman(const int matchScore, const int mismatchScore,
                                          const int gapOpenScore, const int gapExtendScore,
-                                         const int maxReadLength)
+                                         const int maxReadLength, const unsigned widestGapSize, const bool batch)
     : matchScore_(matchScore)
     , mismatchScore_(mismatchScore)
     , gapOpenScore_(gapOpenScore)
     , gapExtendScore_(gapExtendScore)
     , maxReadLength_(maxReadLength)
+    , widestGapSize_(widestGapSize)
+    , batch_(batch)
     , initialValue_(static_cast<int>(std::numeric_limits<short>::min()) + gapOpenScore_)
-    , T_(new char[maxReadLength_ * 3 * WIDEST_GAP_SIZE * sizeof(int16_t)])
+    , T_(std::size_t(maxReadLength_) * 3 * widestGapSize_ * (batch_ ? BATCH_SIZE : 1))
+    , database_(std::size_t(getDatabaseSizeMax()) * (batch_ ? BATCH_SIZE : 1))
+    , fillMatrices_(Kernels::select<1>(common::getCpuIsa(), widestGapSize_))
+    , fillMatricesBatch_(Kernels::select<BATCH_SIZE>(common::getCpuIsa(), widestGapSize_))
 {
     // check that there won't be any overflows in the matrices
     const int maxScore = std::max(std::max(std::max(abs(matchScore_), abs(mismatchScore_)), abs(gapOpenScore_)), abs(gapExtendScore_));
@@ -51,17 +342,13 @@ BandedSmithWaterman::BandedSmithWaterman(const int matchScore, const int mismatc
     }
 }
 
-BandedSmithWaterman::~BandedSmithWaterman()
+const char *BandedSmithWaterman::unpackDatabase(const BatchItem &item, const unsigned lane) const
 {
-    free(T_);
-}
-
-void BandedSmithWaterman::cp(int16_t source[WIDEST_GAP_SIZE], int16_t destination[WIDEST_GAP_SIZE]) const
-{
-    // AV
-    for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-    destination[i] = source[i];
-    }
+    const std::size_t databaseSize = std::distance(item.databaseBegin, item.databaseEnd);
+    ISAAC_ASSERT_MSG(getDatabaseSizeMax() >= databaseSize, "Database is too long: " << databaseSize);
+    char *ret = &database_.front() + std::size_t(lane) * getDatabaseSizeMax();
+    item.databaseBegin.unpack(databaseSize, ret);
+    return ret;
 }
 
 unsigned BandedSmithWaterman::align(
@@ -226,176 +513,28 @@ void BandedSmithWaterman::removeAdjacentIndels(Cigar& cigar, const size_t beginO
 }
 
 
-unsigned BandedSmithWaterman::align(
-    const std::vector<char>::const_iterator queryBegin,
-    const std::vector<char>::const_iterator queryEnd,
-    const reference::Contig::const_iterator databaseBegin,
-    const reference::Contig::const_iterator databaseEnd,
-    Cigar &cigar) const
+
+unsigned BandedSmithWaterman::traceback(
+    const unsigned querySize, const unsigned lanes, const unsigned lane,
+    const int16_t *G, const int16_t *E, const int16_t *F, Cigar &cigar) const
 {
-    assert(databaseEnd > databaseBegin);
-    const size_t querySize = std::distance(queryBegin, queryEnd);
-    ISAAC_ASSERT_MSG(querySize + WIDEST_GAP_SIZE - 1 == (unsigned long)(databaseEnd - databaseBegin), "q:" << std::string(queryBegin, queryEnd) << " db:" << std::string(databaseBegin, databaseEnd));
-    assert(querySize <= size_t(maxReadLength_));
+    const int lastBand = widestGapSize_ - 1;
     const size_t originalCigarSize = cigar.size();
-    int16_t *t = (int16_t*)T_;
-
-    int16_t GapOpenScore[WIDEST_GAP_SIZE], GapExtendScore[WIDEST_GAP_SIZE];
-    for(unsigned i = 0; i < WIDEST_GAP_SIZE; i++) {
-        GapOpenScore[i] = gapOpenScore_;
-        GapExtendScore[i] = gapExtendScore_;
-    }
-    // Initialize E, F and G
-    int16_t D[WIDEST_GAP_SIZE], E[WIDEST_GAP_SIZE], F[WIDEST_GAP_SIZE], G[WIDEST_GAP_SIZE];
-    for(unsigned i = 0; i < WIDEST_GAP_SIZE; i++) {
-        E[i] = initialValue_;
-        F[i] = 0;
-        G[i] = initialValue_;
-    }
-    G[0] = 0;
-
-    for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-        D[i] = *(databaseBegin + (WIDEST_GAP_SIZE - i - 2));
-    }
-
-    // iterate over all bases in the query
-    int16_t F1[WIDEST_GAP_SIZE + 1];
-    int16_t cmpgtEgMask1[WIDEST_GAP_SIZE + 1], maxEg1[WIDEST_GAP_SIZE + 1];
-    F1[0] = initialValue_ + gapExtendScore_;
-    maxEg1[0] = initialValue_ + gapOpenScore_;
-    cmpgtEgMask1[0] = 0;
-    std::vector<char>::const_iterator queryCurrent = queryBegin;
-    for (unsigned queryOffset = 0; queryEnd != queryCurrent; ++queryOffset, ++queryCurrent)
-    {
-        int16_t TE[WIDEST_GAP_SIZE], TF[WIDEST_GAP_SIZE], TG[WIDEST_GAP_SIZE];
-        int16_t D1[WIDEST_GAP_SIZE + 1];
-        int16_t Q[WIDEST_GAP_SIZE];
-        int16_t GA[WIDEST_GAP_SIZE];
-
-        // get F[i-1, j] - extend
-        int16_t cmpgtGfMask[WIDEST_GAP_SIZE];
-
-        int16_t *cmpgtEgMaskOff = cmpgtEgMask1 + 1;
-        int16_t *maxEgOff = maxEg1 + 1;
-        // AV
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            cmpgtEgMaskOff[i] = E[i] > G[i] ? 1 : 0;
-        }
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            maxEgOff[i] = G[i] > E[i] ? G[i] : E[i];
-        }
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            cmpgtGfMask[i] = F[i] > maxEgOff[i] ? 2 : 0;
-        }
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            GA[i] = maxEgOff[i] > F[i] ? maxEgOff[i] : F[i];
-        }
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            TG[i] =
-                   cmpgtEgMaskOff[i] >
-                cmpgtGfMask[i] ? cmpgtEgMaskOff[i] : cmpgtGfMask[i];
-        }
-
-        cp(F, F1 + 1);
-        int16_t GF1[WIDEST_GAP_SIZE], maxEgSubGapOpen1[WIDEST_GAP_SIZE],
-            cmpgtGfMask1[WIDEST_GAP_SIZE];
-        // AV
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            GF1[i] = F1[i] - GapExtendScore[i];
-            maxEgSubGapOpen1[i] = maxEg1[i] - GapOpenScore[i];
-            cmpgtGfMask1[i] = GF1[i] > maxEgSubGapOpen1[i] ? 2 : 0;
-            TF[i] =
-                cmpgtEgMask1[i] >
-                cmpgtGfMask1[i] ? cmpgtEgMask1[i] : cmpgtGfMask1[i];
-            F[i] =
-                maxEgSubGapOpen1[i] > GF1[i] ? maxEgSubGapOpen1[i] : GF1[i];
-        }
-
-        // add the match/mismatch score
-        // load the query base in all 8 values of the register
-        for(unsigned i = 0; i < WIDEST_GAP_SIZE; i++) { 
-            Q[i] = *queryCurrent;
-        }
-
-        // shift the database by 1 byte to the left and add the new base
-
-        cp(D, D1+1);
-        D1[0] = *(databaseBegin + queryOffset + (WIDEST_GAP_SIZE - 1));
-        cp(D1, D);
-
-        // compare query and database. 0xff if different (that also the sign bits)
-        int16_t B[WIDEST_GAP_SIZE], Match[WIDEST_GAP_SIZE],
-        Mismatch[WIDEST_GAP_SIZE], W[WIDEST_GAP_SIZE];
 
-        // lea
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            B[i] = (Q[i] == D[i]) ? 0 : 0xFFFF;
-            Match[i] = (~B[i]) & matchScore_;
-            Mismatch[i] = B[i] & mismatchScore_;
-            W[i] = Match[i] + Mismatch[i];
-            G[i] = GA[i] + (W[i] | (B[i] & 0xFF00));
-        }
-
-        // E[i,j] = max(G[i, j-1] - open, E[i, j-1] - extend, F[i, j-1] - open)
-         int16_t cmpgtFgMask2[WIDEST_GAP_SIZE + 1], maxFg2[WIDEST_GAP_SIZE + 1];
-           int16_t *cmpgtFgMaskOff2 = cmpgtFgMask2 + 1;
-           int16_t *maxFgOff2 = maxFg2 + 1;
-           // AV
-           for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-               cmpgtFgMask2[i] = F[i] > G[i] ? 2 : 0;
-               maxFg2[i] = F[i] > G[i] ? F[i] : G[i];
-               maxFg2[i] -= GapOpenScore[i];
-           }
-
-           E[WIDEST_GAP_SIZE - 1] = initialValue_;
-        maxFg2[WIDEST_GAP_SIZE] = initialValue_;
-
-        short e = initialValue_;
-        short fg = initialValue_;
-        for (size_t i = WIDEST_GAP_SIZE; i > 0; i--) {
-            short max = fg;
-            if (e > fg) {
-                max = e;
-            }
-           E[i - 1] = max;
-           fg = maxFg2[i - 1];
-    
-           e = max - gapExtendScore_;
-        }
-
-        // lea
-        int16_t cmpgtFgSueFgMask2[WIDEST_GAP_SIZE];
-        cmpgtFgMask2[WIDEST_GAP_SIZE] = initialValue_;
-        for (size_t i = 0; i < WIDEST_GAP_SIZE; i++) {
-            cmpgtFgSueFgMask2[i] = E[i] > maxFgOff2[i] ? 5 : 0;
-            E[i] = E[i] > maxFgOff2[i] ? E[i] : maxFgOff2[i];
-            TE[i] =
-                (cmpgtFgSueFgMask2[i] >
-                 cmpgtFgMaskOff2[i] ? cmpgtFgSueFgMask2[i] :
-                 cmpgtFgMaskOff2[i]) & 3;
-        }
-
-        TF[0] = 0;
-
-        cp(TG, t);
-        cp(TE, t + WIDEST_GAP_SIZE);
-        cp(TF, t + WIDEST_GAP_SIZE * 2);
-        t += WIDEST_GAP_SIZE * 3;
-    }
     // find the max of E, F and G at the end
-    short max = G[15] - 1;
+    short max = G[lastBand * lanes + lane] - 1;
 
     int ii = querySize - 1;
     int jj = ii;
     unsigned maxType = 0;
 
 
-    int16_t *TT[] = {G, E, F};
-    for (unsigned j = WIDEST_GAP_SIZE; j > 0; j--)
+    const int16_t *TT[] = {G, E, F};
+    for (unsigned j = widestGapSize_; j > 0; j--)
     {
         for (unsigned type = 0; 3 > type; ++type)
         {
-            const short value = TT[type][j - 1];
+            const short value = TT[type][(j - 1) * lanes + lane];
             if (value > max)
             {
                 max = value;
@@ -413,11 +552,10 @@ unsigned BandedSmithWaterman::align(
     {
         cigar.addOperation(jj, Cigar::DELETE);
     }
-    while(ii >= 0 && jj >= 0 && jj <= 15)
+    while(ii >= 0 && jj >= 0 && jj <= lastBand)
     {
         ++opLength;
-        const unsigned nextMaxType = T_[(ii * 3 + maxType)
-            * WIDEST_GAP_SIZE * sizeof(int16_t) + (jj * 2)];
+        const unsigned nextMaxType = T_[((ii * 3 + maxType) * widestGapSize_ + jj) * lanes + lane] & 0xFF;
         if (nextMaxType != maxType)
         {
             cigar.addOperation(opLength, opCodes[maxType]);
@@ -433,9 +571,9 @@ unsigned BandedSmithWaterman::align(
         cigar.addOperation(opLength, opCodes[maxType]);
         opLength = 0;
     }
-    if (15 > jj)
+    if (lastBand > jj)
     {
-        cigar.addOperation(opLength + 15 - jj, Cigar::DELETE);
+        cigar.addOperation(opLength + lastBand - jj, Cigar::DELETE);
         opLength = 0;
     }
     assert(0 == opLength);
@@ -446,5 +584,56 @@ unsigned BandedSmithWaterman::align(
     return ret;
 }
 
+unsigned BandedSmithWaterman::align(
+    const std::vector<char>::const_iterator queryBegin,
+    const std::vector<char>::const_iterator queryEnd,
+    const reference::Contig::const_iterator databaseBegin,
+    const reference::Contig::const_iterator databaseEnd,
+    Cigar &cigar) const
+{
+    assert(databaseEnd > databaseBegin);
+    const size_t querySize = std::distance(queryBegin, queryEnd);
+    ISAAC_ASSERT_MSG(querySize + widestGapSize_ - 1 == (unsigned long)(databaseEnd - databaseBegin), "q:" << std::string(queryBegin, queryEnd) << " db:" << std::string(databaseBegin, databaseEnd));
+    assert(querySize <= size_t(maxReadLength_));
+
+    // scores for the last query base
+    int16_t E[WIDEST_GAP_SIZE_MAX], F[WIDEST_GAP_SIZE_MAX], G[WIDEST_GAP_SIZE_MAX];
+    const BatchItem item = {queryBegin, queryEnd, databaseBegin, databaseEnd};
+    fillMatrices_(*this, &item, 1, G, E, F);
+
+    return traceback(querySize, 1, 0, G, E, F, cigar);
+}
+
+void BandedSmithWaterman::alignBatch(
+    const BatchItem *items, const unsigned count, Cigar *cigars, unsigned *offsets) const
+{
+    ISAAC_ASSERT_MSG(BATCH_SIZE >= count, "Too many alignments for a batch: " << count);
+    if (BATCH_SIZE_MIN > count)
+    {
+        for (unsigned i = 0; count != i; ++i)
+        {
+            offsets[i] = align(items[i].queryBegin, items[i].queryEnd, items[i].databaseBegin, items[i].databaseEnd, cigars[i]);
+        }
+        return;
+    }
+    ISAAC_ASSERT_MSG(batch_, "BandedSmithWaterman is not set up for batches");
+
+    for (unsigned i = 0; count != i; ++i)
+    {
+        ISAAC_ASSERT_MSG(std::distance(items[i].queryBegin, items[i].queryEnd) + widestGapSize_ - 1 ==
+                         (unsigned long)(items[i].databaseEnd - items[i].databaseBegin),
+                         "q:" << std::string(items[i].queryBegin, items[i].queryEnd) << " db:" << std::string(items[i].databaseBegin, items[i].databaseEnd));
+        assert(size_t(std::distance(items[i].queryBegin, items[i].queryEnd)) <= size_t(maxReadLength_));
+    }
+
+    int16_t E[WIDEST_GAP_SIZE_MAX * BATCH_SIZE], F[WIDEST_GAP_SIZE_MAX * BATCH_SIZE], G[WIDEST_GAP_SIZE_MAX * BATCH_SIZE];
+    fillMatricesBatch_(*this, items, count, G, E, F);
+
+    for (unsigned i = 0; count != i; ++i)
+    {
+        offsets[i] = traceback(std::distance(items[i].queryBegin, items[i].queryEnd), BATCH_SIZE, i, G, E, F, cigars[i]);
+    }
+}
+
 } // namespace alignment
 } // namespace isaac
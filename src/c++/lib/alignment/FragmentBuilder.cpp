@@ -55,7 +55,7 @@ FragmentBuilder::FragmentBuilder(
     , alignmentCfg_(alignmentCfg)
     , cigarBuffer_(cigarBuffer)
     , ungappedAligner_(collectMismatchCycles, alignmentCfg_)
-    , gappedAligner_(collectMismatchCycles, flowcellLayoutList, smartSmithWaterman, alignmentCfg_)
+    , gappedAligner_(collectMismatchCycles, flowcellLayoutList, smartSmithWaterman, alignmentCfg_, true)
     , splitReadAligner_(collectMismatchCycles, alignmentCfg_, splitAlignments_)
     , matches_()
     , offsetMismatches_(flowcell::getMaxReadLength(flowcellLayoutList))
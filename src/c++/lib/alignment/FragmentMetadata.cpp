@@ -289,10 +289,9 @@ unsigned FragmentMetadata::updateAlignment(
                     currentBase, arg, reverse, lastCycle, firstCycle);
             }
 
-            const unsigned matches =
-                std::inner_product(
-                sequenceBegin + currentBase, sequenceBegin + currentBase + arg, referenceBegin + currentPosition,
-                0, std::plus<unsigned>(), &isMatch);
+            const std::pair<unsigned, unsigned> matchesAndDifferences =
+                countMatchesAndDifferences(&*sequenceBegin + currentBase, referenceBegin + currentPosition, arg);
+            const unsigned matches = matchesAndDifferences.first;
 
             const unsigned mismatches = arg - matches;
 
@@ -302,9 +301,7 @@ unsigned FragmentMetadata::updateAlignment(
             matchCount += matches;
 
             // the edit distance includes all mismatches and ambiguous bases (Ns)
-            this->editDistance += std::inner_product(
-                sequenceBegin + currentBase, sequenceBegin + currentBase + arg, referenceBegin + currentPosition,
-                0, std::plus<unsigned>(), std::not_equal_to<char>());
+            this->editDistance += matchesAndDifferences.second;
 
             currentPosition += arg;
             currentBase += arg;
@@ -19,6 +19,7 @@
 
 #include "flowcell/Layout.hh"
 #include "alignment/HashMatchFinder.hh"
+#include "oligo/KmerPacking.hh"
 
 namespace isaac
 {
@@ -58,27 +59,36 @@ bool SeedHashMatchFinder<ReferenceHash>::findSeedMatches(
 
 template <typename KmerT>
 bool updateSeedKmer(
-    const Cluster& cluster,
-    const unsigned readIndex,
-    const unsigned short offset,
+    const alignment::BclClusters::const_iterator cyclesBegin,
     const unsigned short length,
     const unsigned seedBaseQualityMin,
     alignment::Seed<KmerT> &seed)
 {
-    const alignment::BclClusters::const_iterator cyclesBegin = cluster.getBclData(readIndex) + offset;
-    const alignment::BclClusters::const_iterator cyclesEnd = cyclesBegin + length;
-    for (alignment::BclClusters::const_iterator cycle = cyclesBegin; cyclesEnd != cycle; ++cycle)
+    if (oligo::KmerTraits<KmerT>::KMER_BASES == length && oligo::BCL_KMER_BASES_MAX >= length)
     {
-        const unsigned char base = *cycle;
-        if (seedBaseQualityMin > oligo::getQuality(base))
+        uint64_t bits = 0;
+        if (!oligo::packBclKmer(&*cyclesBegin, length, seedBaseQualityMin, bits))
         {
             return false;
         }
+        seed.kmer() = KmerT(typename KmerT::BitsType(bits));
+    }
+    else
+    {
+        const alignment::BclClusters::const_iterator cyclesEnd = cyclesBegin + length;
+        for (alignment::BclClusters::const_iterator cycle = cyclesBegin; cyclesEnd != cycle; ++cycle)
+        {
+            const unsigned char base = *cycle;
+            if (seedBaseQualityMin > oligo::getQuality(base))
+            {
+                return false;
+            }
 
-        const KmerT forwardBaseValue(base & oligo::BITS_PER_BASE_MASK);
+            const KmerT forwardBaseValue(base & oligo::BITS_PER_BASE_MASK);
 
-        seed.kmer() <<= oligo::BITS_PER_BASE;
-        seed.kmer() |= forwardBaseValue;
+            seed.kmer() <<= oligo::BITS_PER_BASE;
+            seed.kmer() |= forwardBaseValue;
+        }
     }
 
     if (seed.isReverse())
@@ -89,6 +99,18 @@ bool updateSeedKmer(
     return true;
 }
 
+template <typename KmerT>
+bool updateSeedKmer(
+    const Cluster& cluster,
+    const unsigned readIndex,
+    const unsigned short offset,
+    const unsigned short length,
+    const unsigned seedBaseQualityMin,
+    alignment::Seed<KmerT> &seed)
+{
+    return updateSeedKmer(cluster.getBclData(readIndex) + offset, length, seedBaseQualityMin, seed);
+}
+
 template <typename KmerT>
 bool updateSeedKmer(
     const Cluster& cluster,
@@ -102,6 +124,42 @@ bool updateSeedKmer(
         seed);
 }
 
+template <typename ReferenceHash>
+void SeedHashMatchFinder<ReferenceHash>::prefetchSeedMatches(
+    const BclClusters::const_iterator clusterBcl,
+    const flowcell::ReadMetadataList &readMetadataList,
+    const alignment::SeedMetadataList &seedMetadataList,
+    const unsigned barcodeLength,
+    const bool positions) const
+{
+    const BclClusterFields<> fieldsParser(readMetadataList, barcodeLength);
+    BOOST_FOREACH(const alignment::SeedMetadata &seedMetadata, seedMetadataList)
+    {
+        const flowcell::ReadMetadata &readMetadata = readMetadataList.at(seedMetadata.getReadIndex());
+        const BclClusters::const_iterator seedBcl =
+            fieldsParser.getBclBegin(clusterBcl, seedMetadata.getReadIndex()) + seedMetadata.getOffset();
+
+        Seed<KmerT> fwSeed(KmerT(0), SeedId(seedMetadata.getLength(), false));
+        if (!updateSeedKmer(seedBcl, seedMetadata.getLength(), seedBaseQualityMin_, fwSeed))
+        {
+            continue;
+        }
+        prefetch(fwSeed.getKmer(), positions);
+        prefetch(fwSeed.inverted().getKmer(), positions);
+
+        // extension seed is looked up as well unless it does not fit the read
+        if (unsigned(seedMetadata.getOffset() + seedMetadata.getLength() * 2) <= readMetadata.getLength())
+        {
+            Seed<KmerT> fwExtSeed(KmerT(0), SeedId(seedMetadata.getLength(), false));
+            if (updateSeedKmer(seedBcl + seedMetadata.getLength(), seedMetadata.getLength(), seedBaseQualityMin_, fwExtSeed))
+            {
+                prefetch(fwExtSeed.getKmer(), positions);
+                prefetch(fwExtSeed.inverted().getKmer(), positions);
+            }
+        }
+    }
+}
+
 template <typename ReferenceHash>
 bool SeedHashMatchFinder<ReferenceHash>::storeFwExtensionMatches(
     const typename ReferenceHash::MatchRange& oriPositions,
@@ -335,7 +393,7 @@ std::size_t ClusterHashMatchFinder<ReferenceHash>::findClusterMatches(
     return repeatSeeds;
 }
 
-template class SeedHashMatchFinder<reference::NumaReferenceHash<reference::ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0> > > >;
+template class SeedHashMatchFinder<reference::NumaReferenceHash<reference::ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0, true> > > >;
 
 template class ClusterHashMatchFinder<reference::ReferenceHash<oligo::VeryShortKmerType> >;
 } // namespace alignment
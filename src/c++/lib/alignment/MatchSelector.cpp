@@ -32,6 +32,7 @@
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
 #include "common/FastIo.hh"
+#include "common/StageCounters.hh"
 #include "reference/Contig.hh"
 #include "reference/ContigLoader.hh"
 
@@ -91,6 +92,7 @@ MatchSelector::MatchSelector(
         const int gapExtendScore,
         const int minGapExtendScore,
         const unsigned splitGapLength,
+        const unsigned smithWatermanBandWidth,
         const TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore,
         const bool reserveBuffers
     )
@@ -127,7 +129,8 @@ MatchSelector::MatchSelector(
           threadTemplateBuilders_,
           mateDriftRange,
           userTemplateLengthStatistics,
-          perTileTls)
+          perTileTls),
+      clusterScheduler_(computeThreads_.size())
 {
     while(threadTemplateBuilders_.size() < computeThreads_.size())
     {
@@ -150,11 +153,37 @@ MatchSelector::MatchSelector(
                                                               gapExtendScore,
                                                               minGapExtendScore,
                                                               splitGapLength,
+                                                              smithWatermanBandWidth,
                                                               dodgyAlignmentScore, reserveBuffers));
     }
     ISAAC_THREAD_CERR << "Constructed the match selector" << std::endl;
 }
 
+uint64_t MatchSelector::getReservedMemory() const
+{
+    uint64_t ret = threadTemplateBuilders_.size() * sizeof(TemplateBuilder) +
+        threadCluster_.capacity() * sizeof(Cluster) +
+        threadStats_.capacity() * sizeof(matchSelector::MatchSelectorStats);
+    BOOST_FOREACH(const TemplateBuilder &templateBuilder, threadTemplateBuilders_)
+    {
+        ret += templateBuilder.getReservedMemory();
+    }
+    BOOST_FOREACH(const Cluster &cluster, threadCluster_)
+    {
+        ret += cluster.capacity() * sizeof(Read);
+        BOOST_FOREACH(const Read &read, cluster)
+        {
+            ret += read.getForwardSequence().capacity() + read.getReverseSequence().capacity() +
+                read.getForwardQuality().capacity() + read.getReverseQuality().capacity();
+        }
+    }
+    BOOST_FOREACH(const matchSelector::MatchSelectorStats &threadStats, threadStats_)
+    {
+        ret += threadStats.getReservedMemory();
+    }
+    return ret;
+}
+
 void MatchSelector::dumpStats(const boost::filesystem::path &statsXmlPath)
 {
     std::for_each(allStats_.begin(), allStats_.end(), boost::bind(&matchSelector::MatchSelectorStats::finalize, _1));
@@ -197,6 +226,7 @@ matchSelector::TemplateAlignmentType MatchSelector::alignCluster(
         ISAAC_ASSERT_MSG(2 >= bamTemplate.getFragmentCount(), "only paired and single ended data supported");
 
         // build the template for the fragments
+        common::StageTimer timer(common::STAGE_TEMPLATE_BUILDING);
         if (ourThreadTemplateBuilder.buildTemplate(
             barcodeContigList, barcodeKUniqeness, restOfGenomeCorrection, tileReads,
             sequencingAdapters, cluster, templateLengthStatistics, mapqThreshold_)
@@ -212,7 +242,7 @@ matchSelector::TemplateAlignmentType MatchSelector::alignCluster(
                 threadOverlappingEndsClippers_[threadNumber].reset();
                 threadOverlappingEndsClippers_[threadNumber].clip(barcodeContigList, bamTemplate);
             }
-            fragmentStorage.store(bamTemplate, barcodeIndex);
+            fragmentStorage.store(bamTemplate, barcodeIndex, threadNumber);
         }
     }
     else
@@ -220,7 +250,7 @@ matchSelector::TemplateAlignmentType MatchSelector::alignCluster(
         bamTemplate.initialize(tileReads, cluster);
         if (keepUnaligned_)
         {
-            fragmentStorage.store(bamTemplate, barcodeIndex);
+            fragmentStorage.store(bamTemplate, barcodeIndex, threadNumber);
         }
     }
     return FragmentBuilder::Nm == res ? matchSelector::NmNm : FragmentBuilder::Rm == res ? matchSelector::Rm : matchSelector::Qc;
@@ -231,7 +261,6 @@ void MatchSelector::alignThread(
     const unsigned threadNumber,
     const flowcell::TileMetadata & tileMetadata,
     const matchFinder::ClusterInfos &clusterInfos,
-    unsigned &threadClusterId,
     const MatchFinderT &matchFinder,
     const BclClusters &bclData,
     const std::vector<TemplateLengthStatistics> & templateLengthStatistics,
@@ -248,18 +277,34 @@ void MatchSelector::alignThread(
     const std::size_t barcodeLength = flowcell.getBarcodeLength();
     const unsigned readNameLength = flowcell.getReadNameLength();
 
-    boost::unique_lock<boost::mutex> lock(mutex_);
-
-    while (tileMetadata.getClusterCount() != threadClusterId)
+    std::size_t blockBegin = 0;
+    std::size_t blockEnd = 0;
+    while (clusterScheduler_.next(threadNumber, CLUSTERS_AT_A_TIME, blockBegin, blockEnd))
     {
-        const unsigned clustersBegin = threadClusterId;
-        static const unsigned clustersAtATime = CLUSTERS_AT_A_TIME;
-        threadClusterId += std::min(clustersAtATime, tileMetadata.getClusterCount() - threadClusterId);
-        const unsigned clustersEnd = threadClusterId;
+        const unsigned clustersBegin = blockBegin;
+        const unsigned clustersEnd = blockEnd;
         {
-            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            for (unsigned clusterId = clustersBegin;
+                 clustersBegin + PREFETCH_CLUSTERS_AHEAD != clusterId && clustersEnd != clusterId; ++clusterId)
+            {
+                matchFinder.prefetchSeedMatches(bclData.cluster(clusterId), tileReads, tileSeeds, barcodeLength, false);
+            }
             for (unsigned clusterId = clustersBegin; clustersEnd != clusterId; ++clusterId)
             {
+                // Hash lookups are mostly cache misses. Request the offsets for the seeds of the clusters
+                // PREFETCH_CLUSTERS_AHEAD iterations ahead and the positions for the ones half way ahead so that the
+                // memory latency is hidden behind the alignment of the current cluster.
+                if (clustersEnd > clusterId + PREFETCH_CLUSTERS_AHEAD)
+                {
+                    matchFinder.prefetchSeedMatches(
+                        bclData.cluster(clusterId + PREFETCH_CLUSTERS_AHEAD), tileReads, tileSeeds, barcodeLength, false);
+                }
+                if (clustersEnd > clusterId + PREFETCH_CLUSTERS_AHEAD / 2)
+                {
+                    matchFinder.prefetchSeedMatches(
+                        bclData.cluster(clusterId + PREFETCH_CLUSTERS_AHEAD / 2), tileReads, tileSeeds, barcodeLength, true);
+                }
+
                 const flowcell::BarcodeMetadata &barcodeMetadata = barcodeMetadataList_[clusterInfos[clusterId].getBarcodeIndex()];
 
                 // uninitialize cluster in case it does not get stored in as storage that buffers data
@@ -336,17 +381,16 @@ void MatchSelector::parallelSelect(
         tileMetadata, tileClusterInfo.at(tileMetadata.getIndex()), matchFinder, bclData, barcodeTemplateLengthStatistics, threadStats_[0]);
 
     ISAAC_THREAD_CERR << "Selecting matches on " <<  computeThreads_.size() << " threads for " << tileMetadata << "\n" << std::endl;
-    unsigned clusterId = 0;
+    clusterScheduler_.reset(tileMetadata.getClusterCount());
     computeThreads_.execute(boost::bind(&MatchSelector::alignThread<MatchFinderT>, this, _1,
                                         boost::ref(tileMetadata),
                                         boost::ref(tileClusterInfo.at(tileMetadata.getIndex())),
-                                        boost::ref(clusterId),
                                         boost::ref(matchFinder),
                                         boost::ref(bclData),
                                         boost::cref(barcodeTemplateLengthStatistics),
                                         boost::ref(fragmentStorage)));
 
-    ISAAC_THREAD_CERR << "Selecting matches done on " <<  computeThreads_.size() << " threads for " << clusterId << " clusters of " << tileMetadata  << std::endl;
+    ISAAC_THREAD_CERR << "Selecting matches done on " <<  computeThreads_.size() << " threads for " << tileMetadata.getClusterCount() << " clusters of " << tileMetadata  << std::endl;
 
     BOOST_FOREACH(const matchSelector::MatchSelectorStats &threadStats, threadStats_)
     {
@@ -371,7 +415,7 @@ void MatchSelector::parallelSelect(
     alignment::matchFinder::TileClusterInfo &tileClusterInfo,
     std::vector<TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
     const flowcell::TileMetadata &tileMetadata,
-    const alignment::SeedHashMatchFinder<reference::NumaReferenceHash<reference::ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0> > > > &matchFinder,
+    const alignment::SeedHashMatchFinder<reference::NumaReferenceHash<reference::ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0, true> > > > &matchFinder,
     const BclClusters &bclData,
     matchSelector::FragmentStorage &fragmentStorage);
 
@@ -0,0 +1,141 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file Mismatch.cpp
+ **
+ ** Vectorized implementations of match and mismatch counting.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "common/CpuIsa.hh"
+
+#ifdef iSAAC_CPU_ISA_X86
+#include <immintrin.h>
+#endif //iSAAC_CPU_ISA_X86
+
+#include "alignment/Mismatch.hh"
+
+namespace isaac
+{
+namespace alignment
+{
+
+static std::pair<unsigned, unsigned> countMatchesAndDifferencesGeneric(
+    const char *sequence, const char *reference, const unsigned length)
+{
+    unsigned matches = 0;
+    unsigned differences = 0;
+    for (unsigned i = 0; length != i; ++i)
+    {
+        matches += isMatch(sequence[i], reference[i]);
+        differences += sequence[i] != reference[i];
+    }
+    return std::make_pair(matches, differences);
+}
+
+#ifdef iSAAC_CPU_ISA_X86
+
+static std::pair<unsigned, unsigned> countMatchesAndDifferencesSse2(
+    const char *sequence, const char *reference, const unsigned length)
+{
+    unsigned matches = 0;
+    unsigned differences = 0;
+    unsigned i = 0;
+    const __m128i sequenceN = _mm_set1_epi8(oligo::SEQUENCE_OLIGO_N);
+    const __m128i referenceN = _mm_set1_epi8(oligo::REFERENCE_OLIGO_N);
+    for (; i + sizeof(__m128i) <= length; i += sizeof(__m128i))
+    {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sequence + i));
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(reference + i));
+        const __m128i equal = _mm_cmpeq_epi8(s, r);
+        const __m128i match = _mm_or_si128(
+            _mm_cmpeq_epi8(s, sequenceN), _mm_andnot_si128(_mm_cmpeq_epi8(r, referenceN), equal));
+        matches += __builtin_popcount(_mm_movemask_epi8(match));
+        differences += sizeof(__m128i) - __builtin_popcount(_mm_movemask_epi8(equal));
+    }
+    const std::pair<unsigned, unsigned> tail =
+        countMatchesAndDifferencesGeneric(sequence + i, reference + i, length - i);
+    return std::make_pair(matches + tail.first, differences + tail.second);
+}
+
+__attribute__((target("avx2")))
+static std::pair<unsigned, unsigned> countMatchesAndDifferencesAvx2(
+    const char *sequence, const char *reference, const unsigned length)
+{
+    unsigned matches = 0;
+    unsigned differences = 0;
+    unsigned i = 0;
+    const __m256i sequenceN = _mm256_set1_epi8(oligo::SEQUENCE_OLIGO_N);
+    const __m256i referenceN = _mm256_set1_epi8(oligo::REFERENCE_OLIGO_N);
+    for (; i + sizeof(__m256i) <= length; i += sizeof(__m256i))
+    {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sequence + i));
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(reference + i));
+        const __m256i equal = _mm256_cmpeq_epi8(s, r);
+        const __m256i match = _mm256_or_si256(
+            _mm256_cmpeq_epi8(s, sequenceN), _mm256_andnot_si256(_mm256_cmpeq_epi8(r, referenceN), equal));
+        matches += __builtin_popcount(_mm256_movemask_epi8(match));
+        differences += sizeof(__m256i) - __builtin_popcount(_mm256_movemask_epi8(equal));
+    }
+    // the tail is short enough for the 16 byte kernel to finish it
+    const std::pair<unsigned, unsigned> tail =
+        countMatchesAndDifferencesSse2(sequence + i, reference + i, length - i);
+    return std::make_pair(matches + tail.first, differences + tail.second);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static std::pair<unsigned, unsigned> countMatchesAndDifferencesAvx512(
+    const char *sequence, const char *reference, const unsigned length)
+{
+    unsigned matches = 0;
+    unsigned differences = 0;
+    unsigned i = 0;
+    const __m512i sequenceN = _mm512_set1_epi8(oligo::SEQUENCE_OLIGO_N);
+    const __m512i referenceN = _mm512_set1_epi8(oligo::REFERENCE_OLIGO_N);
+    for (; i + sizeof(__m512i) <= length; i += sizeof(__m512i))
+    {
+        const __m512i s = _mm512_loadu_si512(sequence + i);
+        const __m512i r = _mm512_loadu_si512(reference + i);
+        const __mmask64 equal = _mm512_cmpeq_epi8_mask(s, r);
+        const __mmask64 match =
+            _mm512_cmpeq_epi8_mask(s, sequenceN) | (equal & ~_mm512_cmpeq_epi8_mask(r, referenceN));
+        matches += __builtin_popcountll(match);
+        differences += sizeof(__m512i) - __builtin_popcountll(equal);
+    }
+    const std::pair<unsigned, unsigned> tail =
+        countMatchesAndDifferencesAvx2(sequence + i, reference + i, length - i);
+    return std::make_pair(matches + tail.first, differences + tail.second);
+}
+
+#endif //iSAAC_CPU_ISA_X86
+
+CountMatchesAndDifferences getCountMatchesAndDifferences(const common::CpuIsa isa)
+{
+    switch (isa)
+    {
+#ifdef iSAAC_CPU_ISA_X86
+    case common::CpuIsaAvx512:
+        return countMatchesAndDifferencesAvx512;
+    case common::CpuIsaAvx2:
+        return countMatchesAndDifferencesAvx2;
+    case common::CpuIsaSse41:
+    case common::CpuIsaSse2:
+        return countMatchesAndDifferencesSse2;
+#endif //iSAAC_CPU_ISA_X86
+    default:
+        return countMatchesAndDifferencesGeneric;
+    }
+}
+
+} // namespace alignment
+} // namespace isaac
@@ -46,7 +46,8 @@ ShadowAligner::ShadowAligner(
       noSmithWaterman_(noSmithWaterman),
       flowcellLayoutList_(flowcellLayoutList),
       ungappedAligner_(collectMismatchCycles, alignmentCfg),
-      gappedAligner_(collectMismatchCycles, flowcellLayoutList, smartSmithWaterman, alignmentCfg)
+      // shadows are gap-aligned one at a time
+      gappedAligner_(collectMismatchCycles, flowcellLayoutList, smartSmithWaterman, alignmentCfg, false)
 {
     if (reserveBuffers)
     {
@@ -271,7 +272,7 @@ bool ShadowAligner::rescueShadow(
         {
             FragmentMetadataList::iterator prevCandidate = firstCandidate;
             for (FragmentMetadataList::iterator candidate = firstCandidate + 1;
-                shadowList.end() != candidate  && candidate->position - prevCandidate->position < BandedSmithWaterman::WIDEST_GAP_SIZE;)
+                shadowList.end() != candidate  && candidate->position - prevCandidate->position < gappedAligner_.getWidestGapSize();)
             {
                 ++candidate;
                 ++prevCandidate;
@@ -78,6 +78,7 @@ TemplateBuilder::TemplateBuilder(
     const int gapExtendScore,
     const int minGapExtendScore,
     const unsigned splitGapLength,
+    const unsigned smithWatermanBandWidth,
     const DodgyAlignmentScore dodgyAlignmentScore,
     const bool reserveBuffers)
     : scatterRepeats_(scatterRepeats)
@@ -86,7 +87,7 @@ TemplateBuilder::TemplateBuilder(
     , anchorMate_(anchorMate)
     , dodgyAlignmentScore_(dodgyAlignmentScore)
     , collectMismatchCycles_(collectMismatchCycles)
-    , alignmentCfg_(gapMatchScore, gapMismatchScore, gapOpenScore, gapExtendScore, minGapExtendScore, splitGapLength)
+    , alignmentCfg_(gapMatchScore, gapMismatchScore, gapOpenScore, gapExtendScore, minGapExtendScore, splitGapLength, smithWatermanBandWidth)
     // one seed generates up to repeat threshold matches
     // Assuming split read aligner in worst case will make pair each read no more than once
     //, alignmentsMax_((repeatThreshold_ * maxSeedsPerRead * READS_MAX) + (repeatThreshold_ * maxSeedsPerRead * READS_MAX + 1) / 2)
@@ -115,6 +116,21 @@ TemplateBuilder::TemplateBuilder(
     }
     trimmedAlignments_.reserve(READS_IN_A_PAIR);
 }
+
+uint64_t TemplateBuilder::getReservedMemory() const
+{
+    uint64_t ret = cigarBuffer_.capacity() * sizeof(Cigar::value_type) +
+        (shadowList_.capacity() + trimmedAlignments_.capacity()) * sizeof(FragmentMetadata) +
+        fragments_.capacity() * sizeof(FragmentMetadataList) +
+        fragmentBuilder_.getReservedMemory() + shadowAligner_.getReservedMemory() +
+        bestCombinationPairInfo_.getReservedMemory() + bestRescuedPair_.getReservedMemory();
+    BOOST_FOREACH(const FragmentMetadataList &fragments, fragments_)
+    {
+        ret += fragments.capacity() * sizeof(FragmentMetadata);
+    }
+    return ret;
+}
+
 bool TemplateBuilder::buildTemplate(
     const reference::ContigList &contigList,
     const isaac::reference::ContigAnnotations &kUniqeness,
@@ -49,10 +49,10 @@ inline isaac::reference::Contig getContig(const std::string name, const unsigned
 {
     char bases[] = {'A', 'C', 'G', 'T'};
     isaac::reference::Contig contig(0, name);
-    contig.resize(length);
-    BOOST_FOREACH(char &base, contig)
+    contig.reserve(length);
+    for (unsigned i = 0; length != i; ++i)
     {
-        base = bases[rand() % 4];
+        contig.push_back(bases[rand() % 4]);
     }
     return contig;
 }
@@ -27,6 +27,7 @@ using namespace std;
 #include "testBandedSmithWaterman.hh"
 #include "BuilderInit.hh"
 #include "alignment/Cigar.hh"
+#include "common/CpuIsa.hh"
 
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBandedSmithWaterman, registryName("BandedSmithWaterman"));
 
@@ -281,3 +282,136 @@ void TestBandedSmithWaterman::testOverflow()
     CPPUNIT_ASSERT_THROW(isaac::alignment::BandedSmithWaterman(2, -1, 17, 3, 3681), isaac::common::InvalidParameterException);
     CPPUNIT_ASSERT_THROW(isaac::alignment::BandedSmithWaterman(2, -1, 11, 3, 13681), isaac::common::InvalidParameterException);
 }
+
+void TestBandedSmithWaterman::testCpuIsa()
+{
+    // queries with random substitutions, insertions and deletions must align the same way with every kernel
+    std::vector<std::vector<char> > queries;
+    unsigned int seed = 7;
+    for (unsigned i = 0; 200 != i; ++i)
+    {
+        std::string query = genome.substr(100 + i, 100);
+        for (unsigned edit = rand_r(&seed) % 4; edit; --edit)
+        {
+            const unsigned pos = 10 + rand_r(&seed) % 80;
+            switch (rand_r(&seed) % 3)
+            {
+            case 0: query[pos] = "ACGT"[rand_r(&seed) % 4]; break;
+            case 1: query.insert(pos, std::string(1 + rand_r(&seed) % 3, 'A')); break;
+            default: query.erase(pos, 1 + rand_r(&seed) % 3); break;
+            }
+        }
+        queries.push_back(vectorFromString(query));
+    }
+    const isaac::reference::Contig database(0, "database", vectorFromString(genome));
+
+    std::vector<std::string> expectedCigars;
+    std::vector<unsigned> expectedOffsets;
+    isaac::alignment::Cigar cigar; cigar.reserve(1024);
+    isaac::common::cpuIsaInitialize(isaac::common::CpuIsaGeneric);
+    {
+        const isaac::alignment::BandedSmithWaterman generic(2, -1, 15, 3, 300);
+        for (unsigned i = 0; queries.size() != i; ++i)
+        {
+            cigar.clear();
+            expectedOffsets.push_back(generic.align(queries[i], database.begin() + 100 + i - 7, database.begin() + 100 + i - 7 + queries[i].size() + 15, cigar));
+            expectedCigars.push_back(isaac::alignment::Cigar::toString(cigar.begin(), cigar.end()));
+        }
+    }
+
+    for (int isa = isaac::common::CpuIsaGeneric + 1; isaac::common::CpuIsaCount != isa; ++isa)
+    {
+        if (!isaac::common::isCpuIsaSupported(isaac::common::CpuIsa(isa)))
+        {
+            continue;
+        }
+        isaac::common::cpuIsaInitialize(isaac::common::CpuIsa(isa));
+        const isaac::alignment::BandedSmithWaterman vectorized(2, -1, 15, 3, 300);
+        for (unsigned i = 0; queries.size() != i; ++i)
+        {
+            cigar.clear();
+            const unsigned offset = vectorized.align(queries[i], database.begin() + 100 + i - 7, database.begin() + 100 + i - 7 + queries[i].size() + 15, cigar);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(isaac::common::getCpuIsaName(isaac::common::CpuIsa(isa)), expectedOffsets[i], offset);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(isaac::common::getCpuIsaName(isaac::common::CpuIsa(isa)), expectedCigars[i],
+                                         isaac::alignment::Cigar::toString(cigar.begin(), cigar.end()));
+        }
+    }
+    isaac::common::cpuIsaInitialize(isaac::common::getBestCpuIsa());
+}
+
+void TestBandedSmithWaterman::testWideBand()
+{
+    const unsigned left = 40;
+    const unsigned right = 40;
+    const std::string leftS = genome.substr(100, left - 1) + "T";
+    const std::string deletionS = genome.substr(100 + left, 20);
+    const std::string rightS = genome.substr(100 + left + deletionS.length(), right);
+
+    // 20 bases deletion is too long for the default band
+    for (unsigned widestGapSize = 32; isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE_MAX >= widestGapSize; widestGapSize *= 2)
+    {
+        const isaac::alignment::BandedSmithWaterman wide(2, -1, 15, 3, 300, widestGapSize);
+        CPPUNIT_ASSERT_EQUAL(widestGapSize, wide.getWidestGapSize());
+        const std::vector<char> query = vectorFromString(leftS + rightS);
+        const unsigned flank = widestGapSize - 1 - deletionS.length();
+        const isaac::reference::Contig database(
+            0, "database", vectorFromString(leftS + deletionS + rightS + genome.substr(100 + left + deletionS.length() + right, flank)));
+        isaac::alignment::Cigar cigar; cigar.reserve(1024);
+        CPPUNIT_ASSERT_EQUAL(0U, wide.align(query, database.begin(), database.end(), cigar));
+        CPPUNIT_ASSERT_EQUAL(std::string("40M20D40M"), isaac::alignment::Cigar::toString(cigar.begin(), cigar.end()));
+    }
+
+    CPPUNIT_ASSERT_THROW(isaac::alignment::BandedSmithWaterman(2, -1, 15, 3, 300, 24), isaac::common::InvalidParameterException);
+}
+
+void TestBandedSmithWaterman::testBatch()
+{
+    using isaac::alignment::BandedSmithWaterman;
+    const isaac::reference::Contig database(0, "database", vectorFromString(genome));
+    for (unsigned widestGapSize = BandedSmithWaterman::WIDEST_GAP_SIZE; BandedSmithWaterman::WIDEST_GAP_SIZE_MAX >= widestGapSize; widestGapSize *= 2)
+    {
+        const BandedSmithWaterman sw(2, -1, 15, 3, 300, widestGapSize, true);
+        // queries of different lengths with gaps of up to a half of the band
+        std::vector<std::vector<char> > queries;
+        unsigned int seed = widestGapSize;
+        for (unsigned i = 0; BandedSmithWaterman::BATCH_SIZE != i; ++i)
+        {
+            std::string query = genome.substr(100 + i * 10, 60 + rand_r(&seed) % 90);
+            const unsigned pos = 10 + rand_r(&seed) % 40;
+            const unsigned gap = 1 + rand_r(&seed) % (widestGapSize / 2 - 1);
+            if (i % 2)
+            {
+                query.insert(pos, std::string(gap, 'C'));
+            }
+            else
+            {
+                query.erase(pos, gap);
+            }
+            queries.push_back(vectorFromString(query));
+        }
+
+        for (unsigned count = 1; BandedSmithWaterman::BATCH_SIZE >= count; count += BandedSmithWaterman::BATCH_SIZE_MIN - 1)
+        {
+            std::vector<BandedSmithWaterman::BatchItem> items;
+            for (unsigned i = 0; count != i; ++i)
+            {
+                const isaac::reference::Contig::const_iterator databaseBegin = database.begin() + 100 + i * 10 - widestGapSize / 2;
+                const BandedSmithWaterman::BatchItem item =
+                    {queries[i].begin(), queries[i].end(), databaseBegin, databaseBegin + queries[i].size() + widestGapSize - 1};
+                items.push_back(item);
+            }
+            std::vector<isaac::alignment::Cigar> cigars(count);
+            std::vector<unsigned> offsets(count);
+            sw.alignBatch(&items.front(), count, &cigars.front(), &offsets.front());
+
+            for (unsigned i = 0; count != i; ++i)
+            {
+                isaac::alignment::Cigar cigar; cigar.reserve(1024);
+                const unsigned offset = sw.align(items[i].queryBegin, items[i].queryEnd, items[i].databaseBegin, items[i].databaseEnd, cigar);
+                CPPUNIT_ASSERT_EQUAL(offset, offsets[i]);
+                CPPUNIT_ASSERT_EQUAL(isaac::alignment::Cigar::toString(cigar.begin(), cigar.end()),
+                                     isaac::alignment::Cigar::toString(cigars[i].begin(), cigars[i].end()));
+            }
+        }
+    }
+}
@@ -30,6 +30,9 @@ class TestBandedSmithWaterman : public CppUnit::TestFixture
     CPPUNIT_TEST( testSingleDeletion );
     CPPUNIT_TEST( testMultipleIndels );
     CPPUNIT_TEST( testOverflow );
+    CPPUNIT_TEST( testCpuIsa );
+    CPPUNIT_TEST( testWideBand );
+    CPPUNIT_TEST( testBatch );
     CPPUNIT_TEST_SUITE_END();
 private:
     const isaac::alignment::BandedSmithWaterman bsw;
@@ -44,6 +47,9 @@ public:
     void testSingleDeletion();
     void testMultipleIndels();
     void testOverflow();
+    void testCpuIsa();
+    void testWideBand();
+    void testBatch();
 };
 
 #endif // #ifndef iSAAC_ALIGNMENT_TEST_BANDED_SMITH_WATERMAN_HH
@@ -0,0 +1,441 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testFragmentBinner.cpp
+ **
+ ** Test cases for FragmentBinner. Several threads store fragments at the same time, each thread buffer gets written
+ ** out a few times. Bin files must contain every fragment exactly once, at the offsets accounted in BinMetadata.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "alignment/Cigar.hh"
+#include "alignment/MatchDistribution.hh"
+#include "alignment/matchSelector/FragmentBinner.hh"
+#include "common/Threads.hpp"
+#include "io/Fragment.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testFragmentBinner.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFragmentBinner, registryName("FragmentBinner"));
+
+static const unsigned THREADS = 4;
+// enough for every thread to fill its buffer a few times
+static const unsigned THREAD_CLUSTERS = 12000;
+static const unsigned READ_LENGTH = 100;
+static const unsigned DISTRIBUTION_BIN_SIZE = 1000;
+static const unsigned ALIGNED_BINS = 4;
+// last position at which a read still fits the contig
+static const unsigned POSITIONS = ALIGNED_BINS * DISTRIBUTION_BIN_SIZE - READ_LENGTH + 1;
+
+TestFragmentBinner::TestFragmentBinner()
+{
+}
+
+void TestFragmentBinner::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+}
+
+void TestFragmentBinner::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+static void makeFragment(
+    std::vector<char> &data,
+    const unsigned thread,
+    const unsigned cluster,
+    const bool secondRead,
+    const bool paired,
+    const bool aligned,
+    const bool mateAligned,
+    const unsigned position)
+{
+    // build the header in zeroed storage so that the padding compares equal when read back
+    const std::size_t headerOffset = data.size();
+    data.resize(headerOffset + sizeof(io::FragmentHeader), 0);
+    io::FragmentHeader &header = *new (&data.at(headerOffset)) io::FragmentHeader;
+    header.flags_ = io::FragmentHeader::Flags(
+        false, paired, !aligned, !mateAligned, aligned && secondRead, mateAligned && !secondRead, secondRead,
+        false, false, false, false);
+    // shadows are placed at the position of their mate
+    header.fStrandPosition_ = aligned || mateAligned ?
+        reference::ReferencePosition(0, position) : reference::ReferencePosition(reference::ReferencePosition::NoMatch);
+    header.observedLength_ = aligned ? READ_LENGTH : 0;
+    header.readLength_ = READ_LENGTH;
+    header.cigarLength_ = aligned ? 1 : 0;
+    header.tile_ = thread;
+    header.clusterId_ = cluster;
+    for (unsigned i = 0; READ_LENGTH != i; ++i)
+    {
+        data.push_back(char(cluster + i));
+    }
+    if (aligned)
+    {
+        const uint32_t cigar = alignment::Cigar::Encoder(READ_LENGTH, alignment::Cigar::ALIGN).getValue();
+        data.insert(data.end(), reinterpret_cast<const char*>(&cigar), reinterpret_cast<const char*>(&cigar + 1));
+    }
+    // empty name
+    data.push_back(0);
+}
+
+/**
+ * \brief Produces the same fragments for the same cluster. Aligned pairs, shadow/orphan pairs with either read
+ *        aligned, unaligned pairs and single-ended fragments, some of them crossing bin boundaries.
+ *
+ * \return offset of the second fragment or 0 for single-ended template
+ */
+static std::size_t makeTemplate(const unsigned thread, const unsigned cluster, std::vector<char> &data)
+{
+    data.clear();
+    const unsigned position = (cluster * 7919 + thread * 104729) % POSITIONS;
+    const unsigned matePosition = (position + 250) % POSITIONS;
+    switch (cluster % 6)
+    {
+    case 2:
+        makeFragment(data, thread, cluster, false, true, true, false, position);
+        makeFragment(data, thread, cluster, true, true, false, true, position);
+        return io::FragmentHeader::getTotalLength(READ_LENGTH, 1, 0);
+    case 3:
+        makeFragment(data, thread, cluster, false, true, false, true, matePosition);
+        makeFragment(data, thread, cluster, true, true, true, false, matePosition);
+        return io::FragmentHeader::getTotalLength(READ_LENGTH, 0, 0);
+    case 4:
+        makeFragment(data, thread, cluster, false, true, false, false, 0);
+        makeFragment(data, thread, cluster, true, true, false, false, 0);
+        return io::FragmentHeader::getTotalLength(READ_LENGTH, 0, 0);
+    case 5:
+    {
+        const bool aligned = (cluster / 6) % 3;
+        makeFragment(data, thread, cluster, false, false, aligned, false, position);
+        return 0;
+    }
+    default:
+        makeFragment(data, thread, cluster, false, true, true, true, position);
+        makeFragment(data, thread, cluster, true, true, true, true, matePosition);
+        return io::FragmentHeader::getTotalLength(READ_LENGTH, 1, 0);
+    }
+}
+
+static void addFragmentBins(const io::FragmentAccessor &fragment, std::vector<unsigned> &bins)
+{
+    if (fragment.isAligned())
+    {
+        bins.push_back(1 + fragment.getPosition() / DISTRIBUTION_BIN_SIZE);
+        bins.push_back(1 + (fragment.getPosition() + READ_LENGTH - 1) / DISTRIBUTION_BIN_SIZE);
+    }
+    else
+    {
+        bins.push_back(0);
+    }
+}
+
+/**
+ * \return bins the template is expected in, records in the order the bin is expected to have them
+ */
+static std::vector<unsigned> getTemplateBins(
+    const std::vector<char> &data, const std::size_t mateOffset, std::vector<std::pair<unsigned, bool> > &records)
+{
+    const io::FragmentAccessor &fragment0 = reinterpret_cast<const io::FragmentAccessor&>(data.front());
+    std::vector<unsigned> bins;
+    addFragmentBins(fragment0, bins);
+    records.clear();
+    if (mateOffset)
+    {
+        const io::FragmentAccessor &fragment1 = reinterpret_cast<const io::FragmentAccessor&>(data.at(mateOffset));
+        addFragmentBins(fragment1, bins);
+        if (fragment0.isAligned() || fragment1.isAligned())
+        {
+            bins.erase(std::remove(bins.begin(), bins.end(), 0U), bins.end());
+        }
+        // orphan comes first
+        records.push_back(std::make_pair(fragment0.clusterId_, !fragment0.isAligned()));
+        records.push_back(std::make_pair(fragment0.clusterId_, fragment0.isAligned()));
+    }
+    else
+    {
+        records.push_back(std::make_pair(fragment0.clusterId_, false));
+    }
+    std::sort(bins.begin(), bins.end());
+    bins.erase(std::unique(bins.begin(), bins.end()), bins.end());
+    return bins;
+}
+
+static void store(
+    alignment::matchSelector::FragmentBinner &binner,
+    const unsigned thread,
+    const unsigned clusterBegin,
+    const unsigned clusterEnd)
+{
+    std::vector<char> data;
+    for (unsigned cluster = clusterBegin; clusterEnd != cluster; ++cluster)
+    {
+        const std::size_t mateOffset = makeTemplate(thread, cluster, data);
+        const io::FragmentAccessor &fragment0 = reinterpret_cast<const io::FragmentAccessor&>(data.front());
+        if (mateOffset)
+        {
+            binner.storePaired(
+                fragment0, reinterpret_cast<const io::FragmentAccessor&>(data.at(mateOffset)), thread);
+        }
+        else
+        {
+            binner.storeSingle(fragment0, thread);
+        }
+    }
+}
+
+alignment::BinMetadataList TestFragmentBinner::makeBins(
+    const alignment::matchSelector::BinIndexMap &binIndexMap) const
+{
+    // same geometry as the aligner produces
+    alignment::BinMetadataList bins;
+    for (unsigned i = 0; binIndexMap.getTotalBins() != i; ++i)
+    {
+        const reference::ReferencePosition binStartPos = binIndexMap.getBinFirstPos(i);
+        bins.push_back(
+            alignment::BinMetadata(
+                1, i, binStartPos,
+                // small for bin 0 so that it has to grow
+                i ? binIndexMap.getBinFirstInvalidPos(i) - binStartPos : 1000,
+                tempDirectory_ / (boost::format("bin-%08d.dat") % i).str(),
+                i ? 0 : 16));
+    }
+    return bins;
+}
+
+static alignment::MatchDistribution makeMatchDistribution()
+{
+    alignment::MatchDistribution ret(DISTRIBUTION_BIN_SIZE);
+    // one bin per distribution bin
+    ret.push_back(std::vector<unsigned>(ALIGNED_BINS, 1));
+    return ret;
+}
+
+/**
+ * \brief Verifies that the record at the offset is a complete copy of the fragment that was stored
+ */
+static const io::FragmentAccessor &checkFragment(
+    const std::vector<char> &binData, const std::size_t offset, std::vector<char> &data)
+{
+    CPPUNIT_ASSERT(binData.size() >= offset + sizeof(io::FragmentHeader));
+    const io::FragmentAccessor &fragment = reinterpret_cast<const io::FragmentAccessor&>(binData.at(offset));
+    CPPUNIT_ASSERT(binData.size() >= offset + fragment.getTotalLength());
+
+    const std::size_t mateOffset = makeTemplate(fragment.tile_, fragment.clusterId_, data);
+    const std::size_t expectedOffset = fragment.flags_.secondRead_ ? mateOffset : 0;
+    const io::FragmentAccessor &expected = reinterpret_cast<const io::FragmentAccessor&>(data.at(expectedOffset));
+    CPPUNIT_ASSERT_EQUAL(expected.getTotalLength(), fragment.getTotalLength());
+    CPPUNIT_ASSERT(std::equal(binData.begin() + offset, binData.begin() + offset + fragment.getTotalLength(),
+                              data.begin() + expectedOffset));
+    return fragment;
+}
+
+/**
+ * \brief Reads the bin files back. Every thread must have its records in the order of storing within each tile.
+ *        Pairs must be adjacent.
+ */
+void TestFragmentBinner::checkBins(const alignment::BinMetadataList &bins, const unsigned tiles) const
+{
+    typedef std::pair<unsigned, unsigned> ThreadTile;
+    typedef std::map<ThreadTile, std::vector<std::pair<unsigned, bool> > > TileRecords;
+    std::vector<TileRecords> expected(bins.size());
+    std::vector<char> data;
+    std::vector<std::pair<unsigned, bool> > records;
+    for (unsigned thread = 0; THREADS != thread; ++thread)
+    {
+        for (unsigned cluster = 0; THREAD_CLUSTERS != cluster; ++cluster)
+        {
+            const ThreadTile threadTile(thread, cluster * tiles / THREAD_CLUSTERS);
+            const std::vector<unsigned> templateBins = getTemplateBins(data, makeTemplate(thread, cluster, data), records);
+            for (const unsigned bin : templateBins)
+            {
+                std::vector<std::pair<unsigned, bool> > &tileRecords = expected.at(bin)[threadTile];
+                tileRecords.insert(tileRecords.end(), records.begin(), records.end());
+            }
+        }
+    }
+
+    for (const alignment::BinMetadata &bin : bins)
+    {
+        std::ifstream is(bin.getPath().c_str(), std::ios_base::binary);
+        const std::vector<char> binData((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        CPPUNIT_ASSERT_EQUAL(bin.getDataSize(), uint64_t(binData.size()));
+
+        TileRecords actual;
+        std::size_t offset = 0;
+        uint64_t binRecords = 0;
+        while (binData.size() != offset)
+        {
+            const io::FragmentAccessor &fragment = checkFragment(binData, offset, data);
+            const ThreadTile threadTile(fragment.tile_, fragment.clusterId_ * tiles / THREAD_CLUSTERS);
+            actual[threadTile].push_back(std::make_pair(unsigned(fragment.clusterId_), bool(fragment.flags_.secondRead_)));
+            offset += fragment.getTotalLength();
+            ++binRecords;
+            if (fragment.flags_.paired_)
+            {
+                // the mate follows immediately
+                const io::FragmentAccessor &mate = checkFragment(binData, offset, data);
+                CPPUNIT_ASSERT_EQUAL(fragment.tile_, mate.tile_);
+                CPPUNIT_ASSERT_EQUAL(fragment.clusterId_, mate.clusterId_);
+                CPPUNIT_ASSERT(fragment.flags_.secondRead_ != mate.flags_.secondRead_);
+                actual[threadTile].push_back(std::make_pair(unsigned(mate.clusterId_), bool(mate.flags_.secondRead_)));
+                offset += mate.getTotalLength();
+                ++binRecords;
+            }
+        }
+
+        CPPUNIT_ASSERT_MESSAGE((boost::format("bin %d") % bin.getIndex()).str(), expected.at(bin.getIndex()) == actual);
+        if (bin.isUnalignedBin())
+        {
+            CPPUNIT_ASSERT_EQUAL(binRecords, bin.getNmElements());
+        }
+        else
+        {
+            CPPUNIT_ASSERT_EQUAL(binRecords, bin.getSeIdxElements() + bin.getRIdxElements() + bin.getFIdxElements());
+        }
+    }
+}
+
+void TestFragmentBinner::testThreadBuffers()
+{
+    // the way BufferingFragmentStorage uses the binner
+    const alignment::matchSelector::BinIndexMap binIndexMap(makeMatchDistribution(), 1, false);
+    alignment::BinMetadataList bins = makeBins(binIndexMap);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(ALIGNED_BINS + 1), bins.size());
+    {
+        alignment::matchSelector::FragmentBinner binner(true, bins.size(), binIndexMap, bins.size(), 0, THREADS);
+        binner.open(bins.begin(), bins.end());
+        common::ThreadVector threads(THREADS);
+        threads.execute(
+            [&binner](const unsigned threadNumber, const unsigned)
+            {
+                store(binner, threadNumber, 0, THREAD_CLUSTERS);
+                binner.flushThreadBuffer(threadNumber);
+            });
+        binner.reclaimStorage(bins.begin(), bins.end());
+    }
+    checkBins(bins, 1);
+}
+
+void TestFragmentBinner::testSealedBuffers()
+{
+    // the way BinningFragmentStorage uses the binner. Sealed buffers of a tile are written out by an extra thread
+    // while the next tile is stored
+    static const unsigned TILES = 3;
+    const alignment::matchSelector::BinIndexMap binIndexMap(makeMatchDistribution(), 1, false);
+    alignment::BinMetadataList bins = makeBins(binIndexMap);
+    {
+        alignment::matchSelector::FragmentBinner binner(true, bins.size(), binIndexMap, bins.size(), 0, THREADS);
+        binner.open(bins.begin(), bins.end());
+        common::ThreadVector threads(THREADS + 1);
+        for (unsigned tile = 0; TILES != tile; ++tile)
+        {
+            threads.execute(
+                [&binner, tile](const unsigned threadNumber, const unsigned)
+                {
+                    if (THREADS == threadNumber)
+                    {
+                        binner.flushSealedBuffers();
+                    }
+                    else
+                    {
+                        store(binner, threadNumber, tile * THREAD_CLUSTERS / TILES, (tile + 1) * THREAD_CLUSTERS / TILES);
+                    }
+                });
+            binner.sealThreadBuffers();
+        }
+        binner.flushSealedBuffers();
+        binner.reclaimStorage(bins.begin(), bins.end());
+    }
+    checkBins(bins, TILES);
+}
+
+void TestFragmentBinner::testSealLanes()
+{
+    // the first lane goes into all bins, the second one maps to the contig of the last two aligned bins only
+    const alignment::matchSelector::BinIndexMap binIndexMap(makeMatchDistribution(), 1, false);
+    alignment::BinMetadataList bins = makeBins(binIndexMap);
+    const std::vector<unsigned> lane1Bins = {0, 1, 2, 3, 4};
+    const std::vector<unsigned> lane2Bins = {0, 3, 4};
+    {
+        alignment::matchSelector::FragmentBinner binner(true, bins.size(), binIndexMap, bins.size(), 0, THREADS);
+        binner.open(bins.begin(), bins.end());
+        binner.expectLane(lane1Bins);
+        binner.expectLane(lane2Bins);
+        common::ThreadVector threads(THREADS);
+        threads.execute(
+            [&binner](const unsigned threadNumber, const unsigned)
+            {
+                store(binner, threadNumber, 0, THREAD_CLUSTERS);
+                binner.flushThreadBuffer(threadNumber);
+            });
+
+        std::vector<unsigned> sealedBins;
+        binner.sealLane(bins.begin(), lane1Bins, sealedBins);
+        CPPUNIT_ASSERT((std::vector<unsigned>{1, 2}) == sealedBins);
+        // sealed bins are complete
+        for (const unsigned binIndex : sealedBins)
+        {
+            CPPUNIT_ASSERT_EQUAL(bins.at(binIndex).getDataSize(),
+                                 uint64_t(boost::filesystem::file_size(bins.at(binIndex).getPath())));
+        }
+
+        sealedBins.clear();
+        binner.sealLane(bins.begin(), lane2Bins, sealedBins);
+        CPPUNIT_ASSERT((std::vector<unsigned>{0, 3, 4}) == sealedBins);
+        binner.reclaimStorage(bins.begin(), bins.end());
+    }
+    checkBins(bins, 1);
+}
+
+void TestFragmentBinner::testBinGroups()
+{
+    // barcodes 0 and 2 share the bins, barcode 1 gets its own ones
+    const alignment::matchSelector::BinIndexMap binIndexMap(
+        makeMatchDistribution(), 1, false, std::vector<unsigned>{0, 1, 0});
+    CPPUNIT_ASSERT_EQUAL(2U, binIndexMap.getBinGroups());
+    CPPUNIT_ASSERT_EQUAL(1 + 2 * ALIGNED_BINS, binIndexMap.getTotalBins());
+
+    const reference::ReferencePosition pos(0, DISTRIBUTION_BIN_SIZE + 10);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), binIndexMap.getBinIndex(pos, 0));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), binIndexMap.getBinIndex(pos, 2));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2 + ALIGNED_BINS), binIndexMap.getBinIndex(pos, 1));
+
+    for (unsigned bin = 1; binIndexMap.getTotalBins() != bin; ++bin)
+    {
+        const unsigned positionBin = binIndexMap.getPositionBin(bin);
+        CPPUNIT_ASSERT_EQUAL((bin - 1) / ALIGNED_BINS, binIndexMap.getBinGroup(bin));
+        CPPUNIT_ASSERT_EQUAL(bin, binIndexMap.getGroupBinIndex(positionBin, binIndexMap.getBinGroup(bin)));
+        // the groups cover the same positions
+        CPPUNIT_ASSERT_EQUAL(binIndexMap.getBinFirstPos(positionBin), binIndexMap.getBinFirstPos(bin));
+        CPPUNIT_ASSERT_EQUAL(binIndexMap.getBinFirstInvalidPos(positionBin), binIndexMap.getBinFirstInvalidPos(bin));
+    }
+    // all groups share the unaligned bin
+    CPPUNIT_ASSERT_EQUAL(0U, binIndexMap.getGroupBinIndex(0, 1));
+}
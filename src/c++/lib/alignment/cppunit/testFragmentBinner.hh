@@ -0,0 +1,50 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_ALIGNMENT_TEST_FRAGMENT_BINNER_HH
+#define iSAAC_ALIGNMENT_TEST_FRAGMENT_BINNER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "alignment/BinMetadata.hh"
+#include "alignment/matchSelector/BinIndexMap.hh"
+
+class TestFragmentBinner : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFragmentBinner );
+    CPPUNIT_TEST( testThreadBuffers );
+    CPPUNIT_TEST( testSealedBuffers );
+    CPPUNIT_TEST( testSealLanes );
+    CPPUNIT_TEST( testBinGroups );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+
+public:
+    TestFragmentBinner();
+    void setUp();
+    void tearDown();
+
+    void testThreadBuffers();
+    void testSealedBuffers();
+    void testSealLanes();
+    void testBinGroups();
+
+private:
+    isaac::alignment::BinMetadataList makeBins(const isaac::alignment::matchSelector::BinIndexMap &binIndexMap) const;
+    void checkBins(const isaac::alignment::BinMetadataList &bins, const unsigned tiles) const;
+};
+
+#endif // #ifndef iSAAC_ALIGNMENT_TEST_FRAGMENT_BINNER_HH
@@ -102,7 +102,7 @@ static const int ELAND_MIN_GAP_EXTEND_SCORE = 25;
 void TestFragmentBuilder::testEmptyMatchList()
 {
     using isaac::alignment::FragmentBuilder;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     isaac::alignment::FragmentMetadataList fragments;
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, false, alignmentCfg, cigarBuffer, false);
@@ -134,7 +134,7 @@ void TestFragmentBuilder::auxSingleSeed(const unsigned s0, const unsigned s1)
     // Create the fragment builder
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 456, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
@@ -233,7 +233,7 @@ void TestFragmentBuilder::testMultiSeed()
     // Create the fragment builder
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
@@ -316,7 +316,7 @@ void TestFragmentBuilder::testRepeats()
     // Create the fragment builder
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
@@ -412,7 +412,7 @@ void TestFragmentBuilder::testMismatches()
     // Create the fragment builder
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
@@ -485,7 +485,7 @@ void TestFragmentBuilder::testLeadingSoftClips()
     matchList.push_back(Match(Match(SeedId(tile0, 0, clusterId0, s1, true ), ReferencePosition(4, 6))));
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
@@ -534,7 +534,7 @@ void TestFragmentBuilder::testTrailingSoftClips()
     matchList.push_back(Match(Match(SeedId(tile0, 0, clusterId0, s1, true ), ReferencePosition(4, 10))));
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
@@ -583,7 +583,7 @@ void TestFragmentBuilder::testLeadingAndTrailingSoftClips()
     matchList.push_back(Match(Match(SeedId(tile0, 0, clusterId0, s1, true ), ReferencePosition(4, 11))));
     using isaac::alignment::FragmentBuilder;
     using isaac::alignment::Cigar;
-    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+    isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
     isaac::alignment::Cigar cigarBuffer;
     std::vector<isaac::alignment::FragmentMetadataList> fragments(2);
     FragmentBuilder fragmentBuilder(true, flowcells, 123, seedMetadataList.size()/2, 8, 2, false, false, true, alignmentCfg, cigarBuffer, false);
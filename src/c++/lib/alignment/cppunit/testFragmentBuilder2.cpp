@@ -188,7 +188,7 @@ void TestFragmentBuilder2::align(
     const bool gapped)
 {
     align(read, qual, reference, adapters, fragmentMetadata,
-          isaac::alignment::AlignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, -1U), gapped);
+          isaac::alignment::AlignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, -1U, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE), gapped);
 }
 
 void TestFragmentBuilder2::align(
@@ -236,7 +236,7 @@ void TestFragmentBuilder2::align(
     ungappedAligner.alignUngapped(fragmentMetadata, cigarBuffer_, readMetadataList[fragmentMetadata.getReadIndex()], adapterClipper, contigList, contigAnnotations);
     if (gapped)
     {
-        isaac::alignment::fragmentBuilder::GappedAligner gappedAligner(true, flowcells, false, alignmentCfg);
+        isaac::alignment::fragmentBuilder::GappedAligner gappedAligner(true, flowcells, false, alignmentCfg, false);
         isaac::alignment::FragmentMetadata tmp = fragmentMetadata;
         isaac::reference::ContigAnnotations contigAnnotations;
         std::transform(
@@ -368,7 +368,7 @@ void TestFragmentBuilder2::testGappedWithNs()
               "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!DGGGGFIGCGC99E?<C<++33!!!HJIHHHDHFADDAB1@?",
               "AAAACGGAATCAAATGGAATTATCAAATGCAATCGAAGAGAATCATCGAATGATGGACTCAAATGGAATCAACGTCAAACGGAATCAAATGGAATTATCAAATGCAATCGAAGAGAATCATCGAATGGACTCGAATGGAACCATCTAATGGAATGGAATGGAATAATCCATGGACTCGAATGCAATCATCATCAAATGGAATCGAATGGAATCATCGAATGGACTCAAATGGAATAATCATTGAACGGAATCAAATGGAATCATCATCGGATGGAA",
              noAdapters,
-             fragmentMetadata, isaac::alignment::AlignmentCfg(0, -4, -6, -1, 20, -1U), true, 58);
+             fragmentMetadata, isaac::alignment::AlignmentCfg(0, -4, -6, -1, 20, -1U, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE), true, 58);
 
         CPPUNIT_ASSERT_EQUAL(std::string("58S43M"), fragmentMetadata.getCigarString());
         CPPUNIT_ASSERT_EQUAL(7U, fragmentMetadata.getMismatchCount());
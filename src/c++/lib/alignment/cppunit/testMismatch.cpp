@@ -0,0 +1,121 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testMismatch.cpp
+ **
+ ** Compares the vectorized and packed mismatch counting against the scalar isMatch loop.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <string>
+#include <vector>
+
+#include "alignment/Mismatch.hh"
+#include "common/CpuIsa.hh"
+
+using namespace isaac;
+
+#include "RegistryName.hh"
+#include "testMismatch.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestMismatch, registryName("Mismatch"));
+
+static std::string makeSequence(const std::size_t length, unsigned seed, const char *bases)
+{
+    const std::size_t basesCount = std::string(bases).size();
+    std::string ret;
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        ret += bases[(seed >> 16) % basesCount];
+    }
+    return ret;
+}
+
+static std::pair<unsigned, unsigned> countMatchesAndDifferencesScalar(
+    const std::string &sequence, const std::string &reference, const std::size_t offset, const unsigned length)
+{
+    std::pair<unsigned, unsigned> ret(0, 0);
+    for (std::size_t i = offset; offset + length != i; ++i)
+    {
+        ret.first += alignment::isMatch(sequence[i], reference[i]);
+        ret.second += sequence[i] != reference[i];
+    }
+    return ret;
+}
+
+void TestMismatch::setUp()
+{
+    // longer than the 256 base unpack block and not a multiple of any vector width
+    reference_ = makeSequence(1000 + 19, 1, "ACGTACGTACGTN");
+    sequence_ = reference_;
+    const std::string noise = makeSequence(reference_.size(), 2, "ACGTNAAAAAAAAAAAAAAA");
+    for (std::size_t i = 0; sequence_.size() != i; ++i)
+    {
+        sequence_[i] = 'A' == noise[i] ? sequence_[i] : noise[i];
+    }
+}
+
+void TestMismatch::tearDown()
+{
+}
+
+void TestMismatch::testCountMatchesAndDifferencesIsa()
+{
+    for (int isa = common::CpuIsaGeneric; common::CpuIsaCount != isa; ++isa)
+    {
+        if (!common::isCpuIsaSupported(common::CpuIsa(isa)))
+        {
+            continue;
+        }
+        const alignment::CountMatchesAndDifferences kernel =
+            alignment::getCountMatchesAndDifferences(common::CpuIsa(isa));
+        for (std::size_t offset = 0; 70 > offset; offset += 3)
+        {
+            for (unsigned length = 0; reference_.size() - offset >= length; length += 13)
+            {
+                const std::pair<unsigned, unsigned> expected =
+                    countMatchesAndDifferencesScalar(sequence_, reference_, offset, length);
+                const std::pair<unsigned, unsigned> actual =
+                    kernel(sequence_.data() + offset, reference_.data() + offset, length);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(common::getCpuIsaName(common::CpuIsa(isa)), expected.first, actual.first);
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(common::getCpuIsaName(common::CpuIsa(isa)), expected.second, actual.second);
+            }
+        }
+    }
+}
+
+void TestMismatch::testPackedReference()
+{
+    reference::Contig contig(0, "test");
+    contig.assign(reference_.begin(), reference_.end());
+    const std::vector<char> sequence(sequence_.begin(), sequence_.end());
+    for (std::size_t offset = 0; 70 > offset; offset += 3)
+    {
+        for (unsigned length = 0; reference_.size() - offset >= length; length += 13)
+        {
+            const std::pair<unsigned, unsigned> expected =
+                countMatchesAndDifferencesScalar(sequence_, reference_, offset, length);
+            const std::pair<unsigned, unsigned> actual =
+                alignment::countMatchesAndDifferences(sequence_.data() + offset, contig.begin() + offset, length);
+            CPPUNIT_ASSERT_EQUAL(expected.first, actual.first);
+            CPPUNIT_ASSERT_EQUAL(expected.second, actual.second);
+
+            CPPUNIT_ASSERT_EQUAL(
+                alignment::countMismatches(sequence.begin() + offset, sequence.begin() + offset + length,
+                                           reference_.cbegin() + offset, reference_.cend()),
+                alignment::countMismatches(sequence.begin() + offset, sequence.begin() + offset + length,
+                                           contig.begin() + offset, contig.end()));
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_ALIGNMENT_TEST_MISMATCH_HH
+#define iSAAC_ALIGNMENT_TEST_MISMATCH_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+class TestMismatch : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestMismatch );
+    CPPUNIT_TEST( testCountMatchesAndDifferencesIsa );
+    CPPUNIT_TEST( testPackedReference );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    std::string reference_;
+    std::string sequence_;
+public:
+    void setUp();
+    void tearDown();
+    void testCountMatchesAndDifferencesIsa();
+    void testPackedReference();
+};
+
+#endif // #ifndef iSAAC_ALIGNMENT_TEST_MISMATCH_HH
@@ -30,6 +30,7 @@ using namespace std;
 #include "RegistryName.hh"
 #include "testSemialignedClipper.hh"
 
+#include "alignment/BandedSmithWaterman.hh"
 #include "alignment/Cluster.hh"
 #include "alignment/matchSelector/FragmentSequencingAdapterClipper.hh"
 #include "flowcell/SequencingAdapterMetadata.hh"
@@ -68,7 +69,7 @@ static const int ELAND_GAP_OPEN_SCORE = -15;
 static const int ELAND_GAP_EXTEND_SCORE = -3;
 static const int ELAND_MIN_GAP_EXTEND_SCORE = 25;
 
-static isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000);
+static isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
 
 TestSemialignedClipper::TestSemialignedClipper() :
     readMetadataList(getReadMetadataList()),
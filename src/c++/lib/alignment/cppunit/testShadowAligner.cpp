@@ -63,7 +63,7 @@ static const int ELAND_GAP_OPEN_SCORE = -15;
 static const int ELAND_GAP_EXTEND_SCORE = -3;
 static const int ELAND_MIN_GAP_EXTEND_SCORE = 25;
 
-static isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, -1U);
+static isaac::alignment::AlignmentCfg alignmentCfg(ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE, ELAND_MIN_GAP_EXTEND_SCORE, -1U, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
 
 void TestShadowAligner::testRescueShadowShortest()
 {
@@ -32,6 +32,7 @@ using namespace std;
 #include "testSplitReadAligner.hh"
 
 #include "alignment/fragmentBuilder/SplitReadAligner.hh"
+#include "alignment/BandedSmithWaterman.hh"
 #include "alignment/Cluster.hh"
 #include "oligo/Nucleotides.hh"
 
@@ -148,7 +149,7 @@ void TestSplitReadAligner::align(
     align(readAlignment1, readAlignment2, reference, std::string(), fragmentMetadataList, clusterId);
 }
 
-static isaac::alignment::AlignmentCfg alignmentCfg(MATCH_SCORE, MISMATCH_SCORE, GAP_OPEN_SCORE, GAP_EXTEND_SCORE, MIN_GAP_EXTEND_SCORE, 20000);
+static isaac::alignment::AlignmentCfg alignmentCfg(MATCH_SCORE, MISMATCH_SCORE, GAP_OPEN_SCORE, GAP_EXTEND_SCORE, MIN_GAP_EXTEND_SCORE, 20000, isaac::alignment::BandedSmithWaterman::WIDEST_GAP_SIZE);
 
 class TestAligner : public isaac::alignment::fragmentBuilder::SplitReadAligner
 {
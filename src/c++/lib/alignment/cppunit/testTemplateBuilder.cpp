@@ -166,7 +166,7 @@ void TestTemplateBuilder::testEmptyMatchList()
     using isaac::alignment::BandedSmithWaterman;
     std::auto_ptr<TemplateBuilder> templateBuilder(new TemplateBuilder(true, flowcells, 10, 4, false, true, false, false, 8, 2, false, false, false,
                                                                        ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE,
-                                                                       ELAND_MIN_GAP_EXTEND_SCORE, 20000,
+                                                                       ELAND_MIN_GAP_EXTEND_SCORE, 20000, BandedSmithWaterman::WIDEST_GAP_SIZE,
                                                                        TemplateBuilder::DODGY_ALIGNMENT_SCORE_UNALIGNED, false));
     const BamTemplate &bamTemplate = templateBuilder->getBamTemplate();
     CPPUNIT_ASSERT_EQUAL(0U, bamTemplate.getFragmentCount());
@@ -196,7 +196,7 @@ void TestTemplateBuilder::testOrphan()
     using isaac::alignment::BandedSmithWaterman;
     TemplateBuilder templateBuilder(true, flowcells, 10, 4, false, true, false, false, 8, 2, false, false, true,
                                     ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE,
-                                    ELAND_MIN_GAP_EXTEND_SCORE, 20000,
+                                    ELAND_MIN_GAP_EXTEND_SCORE, 20000, BandedSmithWaterman::WIDEST_GAP_SIZE,
                                     TemplateBuilder::DODGY_ALIGNMENT_SCORE_UNALIGNED, false);
     const BamTemplate &bamTemplate = templateBuilder.getBamTemplate();
     std::vector<isaac::alignment::FragmentMetadataList > fragments(2);
@@ -244,7 +244,7 @@ void TestTemplateBuilder::testUnique()
     using isaac::alignment::BandedSmithWaterman;
     TemplateBuilder templateBuilder(true, flowcells, 10, 4, false, true, false, false, 8, 2, false, false, true,
                                     ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE,
-                                    ELAND_MIN_GAP_EXTEND_SCORE, 20000,
+                                    ELAND_MIN_GAP_EXTEND_SCORE, 20000, BandedSmithWaterman::WIDEST_GAP_SIZE,
                                     TemplateBuilder::DODGY_ALIGNMENT_SCORE_UNALIGNED, false);
     const BamTemplate &bamTemplate = templateBuilder.getBamTemplate();
     std::vector<isaac::alignment::FragmentMetadataList > fragments(2);
@@ -295,7 +295,7 @@ void TestTemplateBuilder::testMultiple()
     using isaac::alignment::BandedSmithWaterman;
     TemplateBuilder templateBuilder(true, flowcells, 10, 4, false, true, false, false, 8, 2, false, false, true,
                                     ELAND_MATCH_SCORE, ELAND_MISMATCH_SCORE, ELAND_GAP_OPEN_SCORE, ELAND_GAP_EXTEND_SCORE,
-                                    ELAND_MIN_GAP_EXTEND_SCORE, 20000,
+                                    ELAND_MIN_GAP_EXTEND_SCORE, 20000, BandedSmithWaterman::WIDEST_GAP_SIZE,
                                     TemplateBuilder::DODGY_ALIGNMENT_SCORE_UNALIGNED, false);
     const BamTemplate &bamTemplate = templateBuilder.getBamTemplate();
 
@@ -17,6 +17,7 @@
  ** \author Come Raczy
  **/
 #include "alignment/fragmentBuilder/GappedAligner.hh"
+#include "common/StageCounters.hh"
 
 namespace isaac
 {
@@ -34,11 +35,12 @@ GappedAligner::GappedAligner(
     const bool collectMismatchCycles,
     const flowcell::FlowcellLayoutList &flowcellLayoutList,
     const bool smartSmithWaterman,
-    const AlignmentCfg &alignmentCfg)
+    const AlignmentCfg &alignmentCfg,
+    const bool batch)
     : AlignerBase(collectMismatchCycles, alignmentCfg)
     , smartSmithWaterman_(smartSmithWaterman)
     , bandedSmithWaterman_(alignmentCfg.gapMatchScore_, alignmentCfg.gapMismatchScore_, -alignmentCfg.gapOpenScore_, -alignmentCfg.gapExtendScore_,
-                           flowcell::getMaxTotalReadLength(flowcellLayoutList))
+                           flowcell::getMaxTotalReadLength(flowcellLayoutList), alignmentCfg.smithWatermanBandWidth_, batch)
     , hashedQueryTile_(2, -1U)
     , hashedQueryCluster_(2, -1U)
     , hashedQueryReadIndex_(2, -1U)
@@ -47,6 +49,26 @@ GappedAligner::GappedAligner(
 {
     queryKmerOffsets_[0].resize(oligo::MaxKmer<HASH_KMER_LENGTH, unsigned short>::value + 1, UNINITIALIZED_OFFSET_MAGIC);
     queryKmerOffsets_[1].resize(oligo::MaxKmer<HASH_KMER_LENGTH, unsigned short>::value + 1, UNINITIALIZED_OFFSET_MAGIC);
+    if (batch)
+    {
+        batchFragments_.reserve(BandedSmithWaterman::BATCH_SIZE);
+        batchCigars_.resize(BandedSmithWaterman::BATCH_SIZE);
+        BOOST_FOREACH(Cigar &cigar, batchCigars_)
+        {
+            cigar.reserve(Cigar::getMaxOpeations(flowcell::getMaxTotalReadLength(flowcellLayoutList)));
+        }
+    }
+}
+
+uint64_t GappedAligner::getReservedMemory() const
+{
+    uint64_t ret = bandedSmithWaterman_.getReservedMemory() +
+        batchFragments_.capacity() * sizeof(FragmentMetadata) + batchCigars_.capacity() * sizeof(Cigar);
+    BOOST_FOREACH(const Cigar &cigar, batchCigars_)
+    {
+        ret += cigar.capacity() * sizeof(Cigar::value_type);
+    }
+    return ret;
 }
 
 /// calculate the left and right flanks of the database WRT the query
@@ -168,15 +190,13 @@ bool GappedAligner::makesSenseToGapAlign(
     return false;
 }
 
-unsigned GappedAligner::alignGapped(
+bool GappedAligner::prepareGapped(
     FragmentMetadata &fragmentMetadata,
-    Cigar &cigarBuffer,
-    const flowcell::ReadMetadata &readMetadata,
     const matchSelector::FragmentSequencingAdapterClipper &adapterClipper,
     const reference::ContigList &contigList,
-    const isaac::reference::ContigAnnotations &kUniqenessAnnotation)
+    GappedClipping &clipping,
+    BandedSmithWaterman::BatchItem &item)
 {
-    const unsigned cigarOffset = cigarBuffer.size();
     fragmentMetadata.resetAlignment();
     fragmentMetadata.resetClipping();
 
@@ -193,27 +213,25 @@ unsigned GappedAligner::alignGapped(
 
     clipReference(contig.size(), fragmentMetadata, sequenceBegin, sequenceEnd);
 
-    const unsigned firstMappedBaseOffset = std::distance(sequence.begin(), sequenceBegin);
-    if (firstMappedBaseOffset)
-    {
-        cigarBuffer.addOperation(firstMappedBaseOffset, Cigar::SOFT_CLIP);
-    }
+    clipping.firstMappedBaseOffset = std::distance(sequence.begin(), sequenceBegin);
+    clipping.clipEndBases = std::distance(sequenceEnd, sequence.end());
 
     const unsigned sequenceLength = std::distance(sequenceBegin, sequenceEnd);
+    const unsigned widestGapSize = bandedSmithWaterman_.getWidestGapSize();
 
     // position of the fragment on the strand
-    int64_t strandPosition = fragmentMetadata.position;
+    const int64_t strandPosition = fragmentMetadata.position;
     ISAAC_ASSERT_MSG(0 <= strandPosition, "alignUngapped should have clipped reads beginning before the reference");
 
     // no gapped alignment if the reference is too short
-    if (static_cast<int64_t>(contig.size()) < sequenceLength + strandPosition + BandedSmithWaterman::WIDEST_GAP_SIZE)
+    if (static_cast<int64_t>(contig.size()) < sequenceLength + strandPosition + widestGapSize)
     {
         ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragmentMetadata.getCluster().getId(), "alignGapped: reference too short!");
-        return 0;
+        return false;
     }
     // find appropriate beginning and end for the database
-    const std::pair<unsigned, unsigned> flanks = getFlanks(strandPosition, sequenceLength, contig.size(), BandedSmithWaterman::WIDEST_GAP_SIZE);
-    assert(flanks.first + flanks.second == BandedSmithWaterman::WIDEST_GAP_SIZE - 1);
+    const std::pair<unsigned, unsigned> flanks = getFlanks(strandPosition, sequenceLength, contig.size(), widestGapSize);
+    assert(flanks.first + flanks.second == widestGapSize - 1);
     assert(flanks.first <= strandPosition);
     assert(strandPosition + sequenceLength + flanks.second <= (int64_t)contig.size());
     const reference::Contig::const_iterator databaseBegin = contig.begin() + strandPosition - flanks.first;
@@ -226,41 +244,64 @@ unsigned GappedAligner::alignGapped(
     {
         ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragmentMetadata.getCluster().getId(), "Gap-aligning does not make sense" << common::makeFastIoString(sequenceBegin, sequenceEnd) <<
             " against " << common::makeFastIoString(databaseBegin, databaseEnd));
-        return 0;
+        return false;
     }
 
 
     ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragmentMetadata.getCluster().getId(), "Gap-aligning " << common::makeFastIoString(sequenceBegin, sequenceEnd) <<
         " against " << common::makeFastIoString(databaseBegin, databaseEnd) << " strandPosition:"<<strandPosition);
-    strandPosition += bandedSmithWaterman_.align(sequenceBegin, sequenceEnd, databaseBegin, databaseEnd, cigarBuffer);
 
-    if (firstMappedBaseOffset)
+    clipping.strandPosition = strandPosition;
+    clipping.leftFlank = flanks.first;
+    item.queryBegin = sequenceBegin;
+    item.queryEnd = sequenceEnd;
+    item.databaseBegin = databaseBegin;
+    item.databaseEnd = databaseEnd;
+    return true;
+}
+
+/**
+ * \brief Turns the Smith-Waterman result into the fragment alignment. cigarBuffer must contain the soft clip of
+ *        firstMappedBaseOffset bases followed by the Smith-Waterman cigar starting at cigarOffset.
+ */
+unsigned GappedAligner::finishGapped(
+    FragmentMetadata &fragmentMetadata,
+    const GappedClipping &clipping,
+    const unsigned smithWatermanOffset,
+    const unsigned cigarOffset,
+    Cigar &cigarBuffer,
+    const flowcell::ReadMetadata &readMetadata,
+    const reference::ContigList &contigList,
+    const isaac::reference::ContigAnnotations &kUniqenessAnnotation)
+{
+    int64_t strandPosition = clipping.strandPosition + smithWatermanOffset;
+
+    if (clipping.firstMappedBaseOffset)
     {
         const Cigar::Component firstComponent = Cigar::decode(cigarBuffer.at(cigarOffset + 1));
         // avoid two softclips in a row
         if (Cigar::SOFT_CLIP == firstComponent.second)
         {
             cigarBuffer.erase(cigarBuffer.begin() + cigarOffset);
-            cigarBuffer.updateOperation(cigarOffset, firstMappedBaseOffset + firstComponent.first, Cigar::SOFT_CLIP);
+            cigarBuffer.updateOperation(cigarOffset, clipping.firstMappedBaseOffset + firstComponent.first, Cigar::SOFT_CLIP);
         }
     }
 
-    const unsigned clipEndBases = std::distance(sequenceEnd, sequence.end());
-    if (clipEndBases)
+    if (clipping.clipEndBases)
     {
         const Cigar::Component lastComponent = Cigar::decode(cigarBuffer.back());
         if (Cigar::SOFT_CLIP == lastComponent.second)
         {
-            cigarBuffer.updateOperation(cigarBuffer.size() - 1, clipEndBases + lastComponent.first, Cigar::SOFT_CLIP);
+            cigarBuffer.updateOperation(cigarBuffer.size() - 1, clipping.clipEndBases + lastComponent.first, Cigar::SOFT_CLIP);
         }
         else
         {
-            cigarBuffer.addOperation(clipEndBases, Cigar::SOFT_CLIP);
+            cigarBuffer.addOperation(clipping.clipEndBases, Cigar::SOFT_CLIP);
         }
     }
 
     // adjust the start position of the fragment
-    strandPosition -= flanks.first;
+    strandPosition -= clipping.leftFlank;
 
 //    ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragmentMetadata.getCluster().getId(), "gapped CIGAR: " <<
 //                                           alignment::Cigar::toString(cigarBuffer.begin() + cigarOffset, cigarBuffer.end()) << " strandPosition:"<<strandPosition);
@@ -272,6 +313,91 @@ unsigned GappedAligner::alignGapped(
     return matchCount;
 }
 
+unsigned GappedAligner::alignGapped(
+    FragmentMetadata &fragmentMetadata,
+    Cigar &cigarBuffer,
+    const flowcell::ReadMetadata &readMetadata,
+    const matchSelector::FragmentSequencingAdapterClipper &adapterClipper,
+    const reference::ContigList &contigList,
+    const isaac::reference::ContigAnnotations &kUniqenessAnnotation)
+{
+    GappedClipping clipping;
+    BandedSmithWaterman::BatchItem item;
+    if (!prepareGapped(fragmentMetadata, adapterClipper, contigList, clipping, item))
+    {
+        return 0;
+    }
+
+    const unsigned cigarOffset = cigarBuffer.size();
+    if (clipping.firstMappedBaseOffset)
+    {
+        cigarBuffer.addOperation(clipping.firstMappedBaseOffset, Cigar::SOFT_CLIP);
+    }
+    unsigned smithWatermanOffset = 0;
+    {
+        common::StageTimer timer(common::STAGE_SMITH_WATERMAN);
+        smithWatermanOffset = bandedSmithWaterman_.align(
+            item.queryBegin, item.queryEnd, item.databaseBegin, item.databaseEnd, cigarBuffer);
+    }
+
+    return finishGapped(fragmentMetadata, clipping, smithWatermanOffset, cigarOffset, cigarBuffer,
+                        readMetadata, contigList, kUniqenessAnnotation);
+}
+
+/**
+ * \brief gap-aligns the prepared fragments in one go and replaces the originals the gapped alignment is better for
+ */
+void GappedAligner::realignBatch(
+    const unsigned smitWatermanGapsMax,
+    const reference::ContigList &contigList,
+    const isaac::reference::ContigAnnotations &kUniqenessAnnotation,
+    const flowcell::ReadMetadata &readMetadata,
+    FragmentMetadata **originals,
+    const GappedClipping *clippings,
+    const BandedSmithWaterman::BatchItem *items,
+    Cigar &cigarBuffer)
+{
+    const unsigned count = batchFragments_.size();
+    unsigned smithWatermanOffsets[BandedSmithWaterman::BATCH_SIZE];
+    for (unsigned i = 0; count != i; ++i)
+    {
+        batchCigars_[i].clear();
+    }
+    {
+        common::StageTimer timer(common::STAGE_SMITH_WATERMAN);
+        bandedSmithWaterman_.alignBatch(items, count, &batchCigars_.front(), smithWatermanOffsets);
+    }
+
+    for (unsigned i = 0; count != i; ++i)
+    {
+        FragmentMetadata &fragmentMetadata = *originals[i];
+        FragmentMetadata &tmp = batchFragments_[i];
+
+        const unsigned cigarOffset = cigarBuffer.size();
+        if (clippings[i].firstMappedBaseOffset)
+        {
+            cigarBuffer.addOperation(clippings[i].firstMappedBaseOffset, Cigar::SOFT_CLIP);
+        }
+        cigarBuffer.addOperations(batchCigars_[i].begin(), batchCigars_[i].end());
+        const unsigned matchCount = finishGapped(tmp, clippings[i], smithWatermanOffsets[i], cigarOffset, cigarBuffer,
+                                                 readMetadata, contigList, kUniqenessAnnotation);
+        ISAAC_THREAD_CERR_DEV_TRACE("    Gap-aligned: " << tmp);
+//            if (matchCount && matchCount + BandedSmithWaterman::WIDEST_GAP_SIZE > fragmentMetadata.getObservedLength() &&
+//                (tmp.mismatchCount <= gappedMismatchesMax) &&
+//                (fragmentMetadata.mismatchCount > tmp.mismatchCount) &&
+//                ISAAC_LP_LESS(fragmentMetadata.logProbability, tmp.logProbability))
+        if (matchCount && tmp.gapCount <= smitWatermanGapsMax && (
+            tmp.smithWatermanScore < fragmentMetadata.smithWatermanScore ||
+            (tmp.smithWatermanScore == fragmentMetadata.smithWatermanScore &&
+                ISAAC_LP_LESS(fragmentMetadata.logProbability, tmp.logProbability))))
+        {
+            ISAAC_THREAD_CERR_DEV_TRACE("    Using gap-aligned: " << tmp);
+            fragmentMetadata = tmp;
+        }
+    }
+    batchFragments_.clear();
+}
+
 void GappedAligner::realignBadUngappedAlignments(
     const unsigned gappedMismatchesMax,
     const unsigned smitWatermanGapsMax,
@@ -282,6 +408,11 @@ void GappedAligner::realignBadUngappedAlignments(
     matchSelector::FragmentSequencingAdapterClipper &adapterClipper,
     Cigar &cigarBuffer)
 {
+    ISAAC_ASSERT_MSG(!batchCigars_.empty(), "GappedAligner is not set up for batches");
+    FragmentMetadata *originals[BandedSmithWaterman::BATCH_SIZE];
+    GappedClipping clippings[BandedSmithWaterman::BATCH_SIZE];
+    BandedSmithWaterman::BatchItem items[BandedSmithWaterman::BATCH_SIZE];
+    ISAAC_ASSERT_MSG(batchFragments_.empty(), "Fragments left from previous batch");
     BOOST_FOREACH(FragmentMetadata &fragmentMetadata, fragmentList)
     {
         if (!fragmentMetadata.gapCount)
@@ -292,24 +423,30 @@ void GappedAligner::realignBadUngappedAlignments(
             ISAAC_THREAD_CERR_DEV_TRACE("    Original    : " << fragmentMetadata);
             if (BandedSmithWaterman::mismatchesCutoff < fragmentMetadata.mismatchCount)
             {
-                FragmentMetadata tmp = fragmentMetadata;
-                const unsigned matchCount = alignGapped(tmp, cigarBuffer, readMetadata, adapterClipper, contigList, kUniqenessAnnotation);
-                ISAAC_THREAD_CERR_DEV_TRACE("    Gap-aligned: " << tmp);
-    //            if (matchCount && matchCount + BandedSmithWaterman::WIDEST_GAP_SIZE > fragmentMetadata.getObservedLength() &&
-    //                (tmp.mismatchCount <= gappedMismatchesMax) &&
-    //                (fragmentMetadata.mismatchCount > tmp.mismatchCount) &&
-    //                ISAAC_LP_LESS(fragmentMetadata.logProbability, tmp.logProbability))
-                if (matchCount && tmp.gapCount <= smitWatermanGapsMax && (
-                    tmp.smithWatermanScore < fragmentMetadata.smithWatermanScore ||
-                    (tmp.smithWatermanScore == fragmentMetadata.smithWatermanScore &&
-                        ISAAC_LP_LESS(fragmentMetadata.logProbability, tmp.logProbability))))
+                // clipping depends on the adapterClipper state for the strand, prepare before moving on
+                const unsigned i = batchFragments_.size();
+                batchFragments_.push_back(fragmentMetadata);
+                if (prepareGapped(batchFragments_.back(), adapterClipper, contigList, clippings[i], items[i]))
                 {
-                    ISAAC_THREAD_CERR_DEV_TRACE("    Using gap-aligned: " << tmp);
-                    fragmentMetadata = tmp;
+                    originals[i] = &fragmentMetadata;
+                    if (BandedSmithWaterman::BATCH_SIZE == batchFragments_.size())
+                    {
+                        realignBatch(smitWatermanGapsMax, contigList, kUniqenessAnnotation, readMetadata,
+                                     originals, clippings, items, cigarBuffer);
+                    }
+                }
+                else
+                {
+                    batchFragments_.pop_back();
                 }
             }
         }
     }
+    if (!batchFragments_.empty())
+    {
+        realignBatch(smitWatermanGapsMax, contigList, kUniqenessAnnotation, readMetadata,
+                     originals, clippings, items, cigarBuffer);
+    }
 }
 
 } // namespace fragmentBuilder
@@ -36,8 +36,9 @@ BinningFragmentStorage::BinningFragmentStorage(
     const bool keepUnaligned,
     const BinIndexMap &binIndexMap,
     alignment::BinMetadataList &binMetadataList,
-    const uint64_t expectedBinSize):
-        FragmentBinner(keepUnaligned, binIndexMap.getTotalBins(), binIndexMap, binMetadataList.size(), expectedBinSize),
+    const uint64_t expectedBinSize,
+    const unsigned maxThreads):
+        FragmentBinner(keepUnaligned, binIndexMap.getTotalBins(), binIndexMap, binMetadataList.size(), expectedBinSize, maxThreads),
         binIndexMap_(binIndexMap),
         binMetadataList_(binMetadataList)
 {
@@ -51,7 +52,8 @@ BinningFragmentStorage::~BinningFragmentStorage()
 
 void BinningFragmentStorage::store(
     const BamTemplate &bamTemplate,
-    const unsigned barcodeIdx)
+    const unsigned barcodeIdx,
+    const unsigned threadNumber)
 {
     common::StaticVector<char, READS_MAX * (sizeof(io::FragmentHeader) + FRAGMENT_BYTES_MAX)> buffer;
     if (2 == bamTemplate.getFragmentCount())
@@ -62,13 +64,13 @@ void BinningFragmentStorage::store(
         packPairedFragment(bamTemplate, 1, barcodeIdx, binIndexMap_, std::back_inserter(buffer));
         const io::FragmentAccessor &fragment1 = *reinterpret_cast<const io::FragmentAccessor*>(&buffer.front() + fragment0.getTotalLength());
 
-        storePaired(fragment0, fragment1);
+        storePaired(fragment0, fragment1, threadNumber);
     }
     else
     {
         packSingleFragment(bamTemplate, barcodeIdx, std::back_inserter(buffer));
         const io::FragmentAccessor &fragment = reinterpret_cast<const io::FragmentAccessor&>(buffer.front());
-        storeSingle(fragment);
+        storeSingle(fragment, threadNumber);
     }
 }
 
@@ -41,7 +41,7 @@ BufferingFragmentStorage::BufferingFragmentStorage(
     alignment::BinMetadataList &binMetadataList,
     const flowcell::FlowcellLayoutList &flowcellLayoutList,
     const uint64_t expectedBinSize)
-    : FragmentBinner(keepUnaligned, maxSavers, binIndexMap, binMetadataList.size(), expectedBinSize)
+    : FragmentBinner(keepUnaligned, maxSavers, binIndexMap, binMetadataList.size(), expectedBinSize, maxThreads)
     , keepUnaligned_(keepUnaligned)
     , binIndexMap_(binIndexMap)
     , filesAtATime_(maxSavers)
@@ -57,7 +57,7 @@ BufferingFragmentStorage::~BufferingFragmentStorage()
     FragmentBinner::reclaimStorage(binMetadataList_.begin(), binMetadataList_.end());
 }
 
-void BufferingFragmentStorage::store(const BamTemplate &bamTemplate, const unsigned barcodeIdx)
+void BufferingFragmentStorage::store(const BamTemplate &bamTemplate, const unsigned barcodeIdx, const unsigned threadNumber)
 {
     const alignment::FragmentMetadata &fragment = bamTemplate.getFragmentMetadata(0);
     if (2 == bamTemplate.getFragmentCount())
@@ -132,14 +132,16 @@ void BufferingFragmentStorage::flush()
                             ISAAC_ASSERT_MSG(flushBuffer_.dataEnd() != r2It, "Unexpected end of buffer reached");
                             const io::FragmentAccessor &fragment1 = *reinterpret_cast<const io::FragmentAccessor*>(&*r2It);
                             ISAAC_ASSERT_MSG(fragment1.flags_.initialized_, "Both reads have to be either initialized or not: " << fragment0 << " " << fragment1);
-                            storePaired(fragment0, fragment1);
+                            storePaired(fragment0, fragment1, threadNumber);
                         }
                         else
                         {
-                            storeSingle(fragment0);
+                            storeSingle(fragment0, threadNumber);
                         }
                     }
                 }
+                // the next range of bins reuses the file handles
+                flushThreadBuffer(threadNumber);
             },
             std::min(threads_.size(), flushBuffer_.getClusters())
         );
@@ -128,7 +128,8 @@ bool DebugStorage::updateMapqStats(const BamTemplate& bamTemplate)
 
 void DebugStorage::store(
     const BamTemplate &bamTemplate,
-    const unsigned barcodeIdx)
+    const unsigned barcodeIdx,
+    const unsigned threadNumber)
 {
     updateMapqStats(bamTemplate);
     BamTemplate originalTemplate = bamTemplate;
@@ -154,7 +155,7 @@ void DebugStorage::store(
 
 //    if (store)
     {
-        actualStorage_.store(originalTemplate, barcodeIdx);
+        actualStorage_.store(originalTemplate, barcodeIdx, threadNumber);
     }
 }
 
@@ -16,14 +16,18 @@
  **/
 
 #include <cerrno>
+#include <fcntl.h>
 #include <fstream>
+#include <unistd.h>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
+#include "common/SystemCompatibility.hh"
 #include "alignment/BinMetadata.hh"
 #include "alignment/matchSelector/BinningFragmentStorage.hh"
+#include "io/FileBufWithReopen.hh"
 
 namespace isaac
 {
@@ -34,23 +38,69 @@ namespace matchSelector
 
 const unsigned FragmentBinner::FRAGMENT_BINS_MAX;
 const unsigned FragmentBinner::UNMAPPED_BIN;
+const unsigned FragmentBinner::THREAD_BUFFER_BYTES;
+const unsigned FragmentBinner::IOVECS_MAX;
+
+void FragmentBinner::ThreadBuffer::reserve()
+{
+    data_.resize(THREAD_BUFFER_BYTES);
+    // each record is at least a header long
+    records_.reserve(THREAD_BUFFER_BYTES / sizeof(io::FragmentHeader));
+    order_.reserve(records_.capacity());
+    iovecs_.reserve(records_.capacity());
+}
 
 FragmentBinner::FragmentBinner(
     const bool keepUnaligned,
     const unsigned maxSavers,
     const BinIndexMap &binIndexMap,
     const std::size_t binFiles,
-    const uint64_t expectedBinSize):
+    const uint64_t expectedBinSize,
+    const unsigned maxThreads):
         keepUnaligned_(keepUnaligned),
         expectedBinSize_(expectedBinSize),
         binIndexMap_(binIndexMap),
         binZeroRecordsBinned_(0),
-        files_(maxSavers, io::FileBufWithReopen(std::ios_base::out | std::ios_base::app | std::ios_base::binary)),
-        binFiles_(binFiles)
+        binFiles_(binFiles),
+        binPendingLanes_(binFiles),
+        binSealed_(binFiles),
+        threadBuffers_(maxThreads),
+        sealedBuffers_(maxThreads)
+{
+    std::for_each(threadBuffers_.begin(), threadBuffers_.end(), boost::bind(&ThreadBuffer::reserve, _1));
+    std::for_each(sealedBuffers_.begin(), sealedBuffers_.end(), boost::bind(&ThreadBuffer::reserve, _1));
+
+    // reserve the handles now so that opening bins later does not run out of them
+    files_.reserve(maxSavers);
+    while (files_.size() != maxSavers)
+    {
+        const int fd = ::open(io::fileThatAlwaysExists, O_WRONLY);
+        if (-1 == fd)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to allocate a file handle"));
+        }
+        files_.push_back(fd);
+    }
+}
+
+FragmentBinner::~FragmentBinner()
+{
+    std::for_each(files_.begin(), files_.end(), &::close);
+}
+
+std::size_t FragmentBinner::getMemoryRequirements(const unsigned maxThreads)
 {
+    // same capacities as ThreadBuffer::reserve
+    const std::size_t records = THREAD_BUFFER_BYTES / sizeof(io::FragmentHeader);
+    const std::size_t bufferBytes =
+        THREAD_BUFFER_BYTES + records * (sizeof(BufferedRecord) + sizeof(unsigned) + sizeof(iovec));
+    return 2 * std::size_t(maxThreads) * bufferBytes;
 }
 
-void FragmentBinner::storeFragment(
+/**
+ * \brief updates the bin metadata for a fragment about to be written at the end of the bin data
+ */
+void FragmentBinner::countFragment(
     const io::FragmentAccessor &fragment,
     const bool splitRead,
     BinMetadata &binMetadata)
@@ -91,22 +141,129 @@ void FragmentBinner::storeFragment(
         }
         binMetadata.incrementCigarLength(fragment.fStrandPosition_, fragment.cigarLength_, fragment.barcode_);
     }
+}
+
+void FragmentBinner::bufferFragment(
+    ThreadBuffer &buffer,
+    const unsigned file,
+    const io::FragmentAccessor &fragment,
+    const bool splitRead)
+{
+    ISAAC_ASSERT_MSG(fragment.flags_.initialized_, "Attempt to store an uninitialized " << fragment);
+    ISAAC_ASSERT_MSG(buffer.available() >= fragment.getTotalLength(), "Insufficient thread buffer space for " << fragment);
+    const char *bytes = reinterpret_cast<const char*>(&fragment);
+    std::copy(bytes, bytes + fragment.getTotalLength(), buffer.data_.begin() + buffer.used_);
+    buffer.records_.push_back(BufferedRecord(file, buffer.used_, splitRead));
+    buffer.used_ += fragment.getTotalLength();
+}
 
-    if (fragment.getTotalLength() !=
-        files_.at(binFiles_.at(binMetadata.getIndex())).sputn(reinterpret_cast<const char*>(&fragment), fragment.getTotalLength()))
+/**
+ * \brief submits the writes of the records of a single file. Data goes at the end of what has been accounted for
+ *        the bin so far.
+ */
+void FragmentBinner::writeRecords(
+    ThreadBuffer &buffer,
+    std::vector<unsigned>::const_iterator begin,
+    const std::vector<unsigned>::const_iterator end)
+{
+    const unsigned file = buffer.records_[*begin].file_;
+    alignment::BinMetadata &bin = *(binsBegin_ + file);
+    uint64_t offset = 0;
     {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to write into " + binMetadata.getPathString()));
+        boost::lock_guard<boost::mutex> lock(binMutex_[file % binMutex_.size()]);
+        offset = bin.getDataSize();
+        for (std::vector<unsigned>::const_iterator it = begin; end != it; ++it)
+        {
+            const BufferedRecord &record = buffer.records_[*it];
+            const io::FragmentAccessor &fragment =
+                *reinterpret_cast<const io::FragmentAccessor*>(&buffer.data_[record.offset_]);
+            countFragment(fragment, record.splitRead_, bin);
+            ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "FragmentBinner::writeRecords: " << fragment);
+        }
     }
+
+    while (end != begin)
+    {
+        const std::size_t iovecsBegin = buffer.iovecs_.size();
+        std::size_t bytes = 0;
+        for (; end != begin && IOVECS_MAX != buffer.iovecs_.size() - iovecsBegin; ++begin)
+        {
+            const BufferedRecord &record = buffer.records_[*begin];
+            const io::FragmentAccessor &fragment =
+                *reinterpret_cast<const io::FragmentAccessor*>(&buffer.data_[record.offset_]);
+            const iovec iov = {&buffer.data_[record.offset_], fragment.getTotalLength()};
+            buffer.iovecs_.push_back(iov);
+            bytes += iov.iov_len;
+        }
+
+        asyncIo_.writev(buffer.batch_, files_.at(file), &buffer.iovecs_[iovecsBegin],
+                        buffer.iovecs_.size() - iovecsBegin, offset);
+        offset += bytes;
+    }
+}
+
+void FragmentBinner::flushBuffer(ThreadBuffer &buffer)
+{
+    if (buffer.empty())
+    {
+        return;
+    }
+
+    buffer.order_.clear();
+    for (unsigned i = 0; buffer.records_.size() != i; ++i)
+    {
+        buffer.order_.push_back(i);
+    }
+    // group by file. Keep the store order within the file so that the shadow/orphan pairs stay intact.
+    const std::vector<BufferedRecord> &records = buffer.records_;
+    std::sort(buffer.order_.begin(), buffer.order_.end(),
+              [&records](const unsigned left, const unsigned right)
+              {
+                  return records[left].file_ < records[right].file_ ||
+                      (records[left].file_ == records[right].file_ && left < right);
+              });
+
+    buffer.iovecs_.clear();
+    try
+    {
+        for (std::vector<unsigned>::const_iterator groupBegin = buffer.order_.begin(); buffer.order_.end() != groupBegin;)
+        {
+            const unsigned file = records[*groupBegin].file_;
+            std::vector<unsigned>::const_iterator groupEnd = groupBegin + 1;
+            while (buffer.order_.end() != groupEnd && file == records[*groupEnd].file_)
+            {
+                ++groupEnd;
+            }
+            writeRecords(buffer, groupBegin, groupEnd);
+            groupBegin = groupEnd;
+        }
+    }
+    catch (...)
+    {
+        // the buffer must not be touched while the writes already submitted are in flight
+        asyncIo_.wait(buffer.batch_);
+        throw;
+    }
+
+    if (const int error = asyncIo_.wait(buffer.batch_))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to write fragments into bin files"));
+    }
+
+    buffer.records_.clear();
+    buffer.used_ = 0;
 }
 
 void FragmentBinner::storePaired(
     const io::FragmentAccessor &fragment0,
-    const io::FragmentAccessor &fragment1)
+    const io::FragmentAccessor &fragment1,
+    const unsigned threadNumber)
 {
     FragmentBins bins;
     getFragmentStorageBins(fragment0, bins);
     getFragmentStorageBins(fragment1, bins);
 
+    ThreadBuffer &buffer = threadBuffers_.at(threadNumber);
     BOOST_FOREACH(const unsigned binIndex, bins)
     {
         if (!binIndex && (fragment0.isAligned() || fragment1.isAligned()))
@@ -114,41 +271,49 @@ void FragmentBinner::storePaired(
             // only when both reads are unaligned, the pair goes into bin 0
             continue;
         }
+        ISAAC_ASSERT_MSG(!binSealed_[binIndex], "Attempt to store into sealed bin " << binIndex << " " << fragment0);
         const unsigned fileIndex = binFiles_.at(binIndex);
         if (UNMAPPED_BIN != fileIndex)
         {
-            alignment::BinMetadata &bin = *(binsBegin_ + fileIndex);
-            boost::unique_lock<boost::mutex> lock(binMutex_[fileIndex % binMutex_.size()]);
+            // both fragments have to go in the same write out to remain adjacent in the bin
+            if (buffer.available() < fragment0.getTotalLength() + fragment1.getTotalLength() ||
+                buffer.records_.capacity() < buffer.records_.size() + READS_MAX)
+            {
+                flushBuffer(buffer);
+            }
             // make sure orphan cometh first in shadow/orphan pair
             if (fragment0.isAligned())
             {
-                storeFragment(fragment0, fragment0.flags_.splitAlignment_, bin);
-                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment0.clusterId_, "BinningFragmentStorage::storePaired: " << fragment0);
+                bufferFragment(buffer, fileIndex, fragment0, fragment0.flags_.splitAlignment_);
             }
-            storeFragment(fragment1, 0 != binIndex && fragment1.flags_.splitAlignment_, bin);
-            ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment1.clusterId_, "BinningFragmentStorage::storePaired: " << fragment1);
+            bufferFragment(buffer, fileIndex, fragment1, 0 != binIndex && fragment1.flags_.splitAlignment_);
             if (!fragment0.isAligned())
             {
-                storeFragment(fragment0, false, bin);
-                ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment0.clusterId_, "BinningFragmentStorage::storePaired: " << fragment0);
+                bufferFragment(buffer, fileIndex, fragment0, false);
             }
         }
     }
 }
 
 void FragmentBinner::storeSingle(
-    const io::FragmentAccessor &fragment)
+    const io::FragmentAccessor &fragment,
+    const unsigned threadNumber)
 {
     FragmentBins bins;
     getFragmentStorageBins(fragment, bins);
 
+    ThreadBuffer &buffer = threadBuffers_.at(threadNumber);
     BOOST_FOREACH(const unsigned binIndex, bins)
     {
+        ISAAC_ASSERT_MSG(!binSealed_[binIndex], "Attempt to store into sealed bin " << binIndex << " " << fragment);
         const unsigned fileIndex = binFiles_.at(binIndex);
         if (UNMAPPED_BIN != fileIndex)
         {
-            boost::unique_lock<boost::mutex> lock(binMutex_[fileIndex % binMutex_.size()]);
-            storeFragment(fragment, 0 != binIndex && fragment.flags_.splitAlignment_, *(binsBegin_ + fileIndex));
+            if (buffer.available() < fragment.getTotalLength() || buffer.records_.capacity() == buffer.records_.size())
+            {
+                flushBuffer(buffer);
+            }
+            bufferFragment(buffer, fileIndex, fragment, 0 != binIndex && fragment.flags_.splitAlignment_);
         }
     }
 }
@@ -167,13 +332,14 @@ void FragmentBinner::getFragmentStorageBins(const io::FragmentAccessor &fragment
         {
             if (Cigar::ALIGN == it.component().second)
             {
-                const unsigned startBinIndex = binIndexMap_.getBinIndex(it.referencePos_);
+                const unsigned startBinIndex = binIndexMap_.getBinIndex(it.referencePos_, fragment.barcode_);
                 if (bins.empty() || bins.back() != startBinIndex)
                 {
                     bins.push_back(startBinIndex);
                 }
                 // push the last position as well. This is important for duplicate detection of r-stranded alignments that end in the same bin but begin in different ones
-                const unsigned endBinIndex = binIndexMap_.getBinIndex(it.referencePos_ + it.component().first - 1);
+                const unsigned endBinIndex = binIndexMap_.getBinIndex(
+                    it.referencePos_ + it.component().first - 1, fragment.barcode_);
                 if (bins.back() != endBinIndex)
                 {
                     bins.push_back(endBinIndex);
@@ -185,32 +351,76 @@ void FragmentBinner::getFragmentStorageBins(const io::FragmentAccessor &fragment
     bins.erase(std::unique(bins.begin(), bins.end()), bins.end());
 }
 
+/**
+ * \brief points the file slot back at /dev/null and lets go of the cached pages of the bin that was open in it
+ */
+void FragmentBinner::releaseFile(const std::size_t file) noexcept
+{
+    if (posix_fadvise(files_[file], 0, 0, POSIX_FADV_DONTNEED) && errno)
+    {
+        ISAAC_THREAD_CERR << "WARNING: posix_fadvise failed for POSIX_FADV_DONTNEED with " << errno << "(" <<
+            strerror(errno) << ")" << std::endl;
+    }
+    const int fd = ::open(io::fileThatAlwaysExists, O_WRONLY);
+    if (-1 != fd)
+    {
+        dup2(fd, files_[file]);
+        ::close(fd);
+    }
+}
+
 void FragmentBinner::reopenBin(
     const BinMetadata &binMetadata,
     std::size_t file)
 {
-    if (binMetadata.isEmpty())
+    if (binSealed_.at(binMetadata.getIndex()))
+    {
+        // the bin might be getting read already
+        binFiles_.at(binMetadata.getIndex()) = UNMAPPED_BIN;
+        return;
+    }
+    // if all neededed files are open at the same time, there is no need to reopen anything.
+    if (binMetadata.isEmpty() || binFiles_.at(binMetadata.getIndex()) != file)
     {
-        // make sure file is empty first time we decide to put data in it.
-        // boost::filesystem::remove for some stupid reason needs to allocate strings for this...
-        if (unlink(binMetadata.getPath().c_str()) && ENOENT != errno)
+        if (posix_fadvise(files_[file], 0, 0, POSIX_FADV_DONTNEED) && errno)
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to unlink " + binMetadata.getPath().string()));
+            ISAAC_THREAD_CERR << "WARNING: posix_fadvise failed for POSIX_FADV_DONTNEED with " << errno << "(" <<
+                strerror(errno) << ")" << " file: " << binMetadata.getPath().c_str() << std::endl;
+        }
+        if (binMetadata.isEmpty())
+        {
+            // make sure file is empty first time we decide to put data in it.
+            // boost::filesystem::remove for some stupid reason needs to allocate strings for this...
+            if (unlink(binMetadata.getPath().c_str()) && ENOENT != errno)
+            {
+                BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to unlink " + binMetadata.getPath().string()));
+            }
         }
 
-        files_[file].reopen(binMetadata.getPath().c_str(), expectedBinSize_, io::FileBufWithReopen::SequentialOnce);
-    }
-    else
-    {
-        // if all neededed files are open at the same time, there is no need to reopen anything.
-        if (binFiles_.at(binMetadata.getIndex()) != file)
+        // data is written at the offsets accounted in binMetadata, the file is never opened for append.
+        const int fd = ::open(binMetadata.getPath().c_str(), O_WRONLY | O_CREAT, 0666);
+        if (-1 == fd || -1 == dup2(fd, files_[file]))
         {
-            files_[file].reopen(binMetadata.getPath().c_str(), io::FileBufWithReopen::SequentialOnce);
+            const int error = errno;
+            if (-1 != fd)
+            {
+                ::close(fd);
+            }
+            BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to open bin file " + binMetadata.getPathString()));
+        }
+        ::close(fd);
+
+        if (posix_fadvise(files_[file], 0, 0, POSIX_FADV_SEQUENTIAL))
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, binMetadata.getPathString()));
+        }
+        if (binMetadata.isEmpty() && expectedBinSize_)
+        {
+            // don't check for failures. If pre-allocation fails, let the application still proceed
+            // with writing into a file. It can succeed as the expectedBinSize_ is often a pessimisitic guess
+            // rather than actual number of bytes to be written.
+            common::linuxFallocate(files_[file], 0, expectedBinSize_);
         }
-    }
-    if (!files_[file].is_open())
-    {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open bin file " + binMetadata.getPathString()));
     }
     binFiles_.at(binMetadata.getIndex()) = file;
 }
@@ -272,14 +482,57 @@ void FragmentBinner::open(
     ISAAC_THREAD_CERR << "Reopening output files done for " << std::distance(binsBegin, binsEnd) << " bins" << std::endl;
 }
 
+void FragmentBinner::expectLane(const std::vector<unsigned> &laneBins)
+{
+    BOOST_FOREACH(const unsigned binIndex, laneBins)
+    {
+        ISAAC_ASSERT_MSG(!binSealed_.at(binIndex), "Lane expected to store into sealed bin " << binIndex);
+        ++binPendingLanes_.at(binIndex);
+    }
+}
+
+void FragmentBinner::sealLane(
+    const alignment::BinMetadataList::const_iterator binsBegin,
+    const std::vector<unsigned> &laneBins,
+    std::vector<unsigned> &sealedBins)
+{
+    BOOST_FOREACH(const unsigned binIndex, laneBins)
+    {
+        ISAAC_ASSERT_MSG(binPendingLanes_.at(binIndex), "Sealing a lane that was not expected in bin " << binIndex);
+        if (--binPendingLanes_[binIndex])
+        {
+            continue;
+        }
+
+        const unsigned file = binFiles_.at(binIndex);
+        if (UNMAPPED_BIN != file)
+        {
+            releaseFile(file);
+            binFiles_[binIndex] = UNMAPPED_BIN;
+        }
+        binSealed_[binIndex] = true;
+
+        const BinMetadata &binMetadata = *(binsBegin + binIndex);
+        ISAAC_ASSERT_MSG(binMetadata.getIndex() == binIndex, "Bin list does not start with bin 0 " << binMetadata);
+        // same as reclaimStorage. A failure leaves the pre-allocated tail which is never read.
+        truncate(binMetadata.getPath().c_str(), binMetadata.getDataSize());
+        sealedBins.push_back(binIndex);
+    }
+}
+
 void FragmentBinner::reclaimStorage(
     const alignment::BinMetadataList::const_iterator binsBegin,
     const alignment::BinMetadataList::const_iterator binsEnd) noexcept
 {
     ISAAC_THREAD_CERR << "truncating output files for " << std::distance(binsBegin, binsEnd) << " bins" << std::endl;
 
-    // make sure everything is written out for those that are open
-    std::for_each(files_.begin(), files_.end(), boost::bind(&io::FileBufWithReopen::close, _1));
+    for (std::size_t file = 0; files_.size() != file; ++file)
+    {
+        releaseFile(file);
+    }
+    // anything left in the buffers is only there if the storing was interrupted by a failure
+    std::for_each(threadBuffers_.begin(), threadBuffers_.end(), [](ThreadBuffer &buffer){buffer.records_.clear(); buffer.used_ = 0;});
+    std::for_each(sealedBuffers_.begin(), sealedBuffers_.end(), [](ThreadBuffer &buffer){buffer.records_.clear(); buffer.used_ = 0;});
 
     std::fill(binFiles_.begin(), binFiles_.end(), UNMAPPED_BIN);
 
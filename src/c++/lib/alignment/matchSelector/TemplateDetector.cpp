@@ -204,7 +204,18 @@ void TemplateDetector::determineTemplateLengths(
     if (userTemplateLengthStatistics_.isStable())
     {
         ISAAC_THREAD_CERR << "Using user-defined template-length statistics: " << userTemplateLengthStatistics_ << std::endl;
-        std::fill(templateLengthStatistics.begin(), templateLengthStatistics.end(), userTemplateLengthStatistics_);
+        // only the lane of the tile. Build might be reading the statistics of the lanes that are done.
+        std::for_each(
+            templateLengthStatistics.begin(), templateLengthStatistics.end(),
+            [&](TemplateLengthStatistics &btls)
+            {
+                const flowcell::BarcodeMetadata &barcodeMetadata = barcodeMetadataList_[std::distance(&templateLengthStatistics.front(), &btls)];
+                if (barcodeMetadata.getLane() == tileMetadata.getLane() &&
+                    barcodeMetadata.getFlowcellIndex() == flowcell.getIndex())
+                {
+                    btls = userTemplateLengthStatistics_;
+                }
+            });
         return;
     }
 
@@ -277,7 +288,7 @@ template
 void TemplateDetector::determineTemplateLengths(
     const flowcell::TileMetadata &tileMetadata,
     const matchFinder::ClusterInfos &clusterInfos,
-    const alignment::SeedHashMatchFinder<reference::NumaReferenceHash<reference::ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0> > > > &matchFinder,
+    const alignment::SeedHashMatchFinder<reference::NumaReferenceHash<reference::ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0, true> > > > &matchFinder,
     const BclClusters &bclData,
     std::vector<alignment::TemplateLengthStatistics> &templateLengthStatistics,
     matchSelector::MatchSelectorStats &stats);
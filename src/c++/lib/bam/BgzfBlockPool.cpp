@@ -0,0 +1,223 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BgzfBlockPool.cpp
+ **
+ ** Uncompressed bgzf blocks waiting to be compressed by any thread that has nothing better to do.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstring>
+
+#include "bam/BgzfBlockPool.hh"
+#include "common/Debug.hh"
+#include "common/StageCounters.hh"
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace bam
+{
+
+const unsigned BgzfBlockPool::NO_BLOCK;
+
+BgzfBlockPool::BgzfBlockPool(const unsigned blocks) :
+    blocks_(blocks),
+    uncompressed_(std::size_t(blocks) * bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX),
+    compressed_(std::size_t(blocks) * bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX),
+    waiting_(blocks),
+    waitingBegin_(0),
+    waitingCount_(0),
+    failed_(false)
+{
+    ISAAC_ASSERT_MSG(blocks, "At least one block is required");
+    freeBlocks_.reserve(blocks);
+    for (unsigned block = blocks; block; --block)
+    {
+        freeBlocks_.push_back(block - 1);
+    }
+}
+
+void BgzfBlockPool::open(Queue &queue, BgzfBuffer &output)
+{
+    ISAAC_ASSERT_MSG(queue.empty(), "Blocks left from previous use");
+    queue.output_ = &output;
+}
+
+void BgzfBlockPool::checkFailed() const
+{
+    if (failed_)
+    {
+        BOOST_THROW_EXCEPTION(bgzf::BgzfDeflateException("Bgzf block compression failed on another thread"));
+    }
+}
+
+void BgzfBlockPool::submit(Queue &queue, const char *data, const std::size_t size, bgzf::BgzfDeflater &deflater)
+{
+    ISAAC_ASSERT_MSG(queue.output_, "Queue is not open");
+    ISAAC_ASSERT_MSG(bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX >= size, "Too much data for a single bgzf block: " << size);
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (freeBlocks_.empty())
+    {
+        checkFailed();
+        if (!compressWaiting(lock, deflater))
+        {
+            stateChangedCondition_.wait(lock);
+        }
+    }
+    checkFailed();
+
+    const unsigned index = freeBlocks_.back();
+    freeBlocks_.pop_back();
+    {
+        // nobody else knows about the block yet
+        common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+        memcpy(uncompressed(index), data, size);
+    }
+
+    Block &block = blocks_[index];
+    block.state_ = BlockWaiting;
+    block.queue_ = &queue;
+    block.next_ = NO_BLOCK;
+    block.size_ = size;
+    if (queue.empty())
+    {
+        queue.head_ = index;
+    }
+    else
+    {
+        blocks_[queue.tail_].next_ = index;
+    }
+    queue.tail_ = index;
+
+    waiting_[(waitingBegin_ + waitingCount_) % waiting_.size()] = index;
+    ++waitingCount_;
+    stateChangedCondition_.notify_all();
+}
+
+void BgzfBlockPool::flush(Queue &queue, bgzf::BgzfDeflater &deflater)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!queue.empty())
+    {
+        checkFailed();
+        if (!compressWaiting(lock, deflater))
+        {
+            stateChangedCondition_.wait(lock);
+        }
+    }
+}
+
+void BgzfBlockPool::compress(bgzf::BgzfDeflater &deflater)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!failed_ && waitingCount_)
+    {
+        compressWaiting(lock, deflater);
+    }
+}
+
+bool BgzfBlockPool::waitForBlocks(const bool &stop)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!stop && !failed_ && !waitingCount_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    return !stop && !failed_;
+}
+
+void BgzfBlockPool::stop(bool &stop)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    stop = true;
+    stateChangedCondition_.notify_all();
+}
+
+void BgzfBlockPool::reset()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    freeBlocks_.clear();
+    for (unsigned index = blocks_.size(); index; --index)
+    {
+        Block &block = blocks_[index - 1];
+        ISAAC_ASSERT_MSG(BlockCompressing != block.state_, "Block is still being compressed");
+        if (block.queue_)
+        {
+            block.queue_->head_ = NO_BLOCK;
+            block.queue_->tail_ = NO_BLOCK;
+        }
+        block = Block();
+        freeBlocks_.push_back(index - 1);
+    }
+    waitingBegin_ = 0;
+    waitingCount_ = 0;
+    failed_ = false;
+}
+
+/**
+ * \brief compresses the oldest waiting block and appends whatever became ready to the block queue output
+ *
+ * \return false if there was nothing waiting
+ */
+bool BgzfBlockPool::compressWaiting(boost::unique_lock<boost::mutex> &lock, bgzf::BgzfDeflater &deflater)
+{
+    if (!waitingCount_)
+    {
+        return false;
+    }
+    const unsigned index = waiting_[waitingBegin_];
+    waitingBegin_ = (waitingBegin_ + 1) % waiting_.size();
+    --waitingCount_;
+
+    Block &block = blocks_[index];
+    block.state_ = BlockCompressing;
+    try
+    {
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            common::StageTimer timer(common::STAGE_COMPRESSION);
+            block.compressedSize_ = deflater.compress(uncompressed(index), block.size_, compressed(index));
+        }
+        block.state_ = BlockCompressed;
+        append(*block.queue_);
+    }
+    catch (...)
+    {
+        failed_ = true;
+        stateChangedCondition_.notify_all();
+        throw;
+    }
+    stateChangedCondition_.notify_all();
+    return true;
+}
+
+void BgzfBlockPool::append(Queue &queue)
+{
+    while (!queue.empty() && BlockCompressed == blocks_[queue.head_].state_)
+    {
+        const unsigned index = queue.head_;
+        Block &block = blocks_[index];
+        queue.output_->insert(queue.output_->end(), compressed(index), compressed(index) + block.compressedSize_);
+        queue.head_ = block.next_;
+        if (queue.empty())
+        {
+            queue.tail_ = NO_BLOCK;
+        }
+        block = Block();
+        freeBlocks_.push_back(index);
+    }
+}
+
+} // namespace bam
+} // namespace isaac
@@ -0,0 +1,229 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testBgzfBlockPool.cpp
+ **
+ ** Test cases for BgzfBlockPool. Output of every queue must be the same as if its blocks were compressed one
+ ** after another on a single thread.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread.hpp>
+
+#include "bam/BgzfBlockPool.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testBgzfBlockPool.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBgzfBlockPool, registryName("TestBgzfBlockPool"));
+
+TestBgzfBlockPool::TestBgzfBlockPool()
+{
+}
+
+void TestBgzfBlockPool::setUp()
+{
+}
+
+void TestBgzfBlockPool::tearDown()
+{
+}
+
+/**
+ * \brief Even blocks are full of noise that takes long to compress, odd blocks are short. With more than one
+ *        thread compressing, the short blocks finish before the long ones submitted ahead of them.
+ */
+static std::vector<std::string> makeBlocks(const unsigned count, unsigned seed)
+{
+    std::vector<std::string> ret;
+    while (ret.size() < count)
+    {
+        std::string block;
+        const std::size_t size = (ret.size() % 2) ? 1 + seed % 100 : bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX;
+        while (block.size() < size)
+        {
+            seed = seed * 1103515245 + 12345;
+            block += char(seed >> 16);
+        }
+        ret.push_back(block);
+    }
+    return ret;
+}
+
+static std::string compressSequentially(const std::vector<std::string> &blocks, const int level)
+{
+    bgzf::BgzfDeflater deflater(bgzf::DeflateZlib, level);
+    std::vector<char> compressed(bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    std::string ret;
+    for (const std::string &block : blocks)
+    {
+        ret.append(&compressed.front(), deflater.compress(block.data(), block.size(), &compressed.front()));
+    }
+    return ret;
+}
+
+static void produce(
+    bam::BgzfBlockPool &pool, const std::vector<std::string> &blocks, const int level, bam::BgzfBuffer &output)
+{
+    bgzf::BgzfDeflater deflater(bgzf::DeflateZlib, level);
+    bam::BgzfBlockPool::Queue queue;
+    // BgzfBuffer does not grow
+    output.reserve(blocks.size() * bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    pool.open(queue, output);
+    for (const std::string &block : blocks)
+    {
+        pool.submit(queue, block.data(), block.size(), deflater);
+    }
+    pool.flush(queue, deflater);
+}
+
+static void help(bam::BgzfBlockPool &pool, const int level, const bool &stop)
+{
+    bgzf::BgzfDeflater deflater(bgzf::DeflateZlib, level);
+    do
+    {
+        pool.compress(deflater);
+    }
+    while (pool.waitForBlocks(stop));
+}
+
+void TestBgzfBlockPool::testOutOfOrderCompletion()
+{
+    static const unsigned PRODUCERS = 2;
+    static const unsigned HELPERS = 4;
+    static const unsigned BLOCKS = 32;
+    const int level = Z_BEST_COMPRESSION;
+
+    std::vector<std::vector<std::string> > producerBlocks;
+    for (unsigned producer = 0; PRODUCERS != producer; ++producer)
+    {
+        producerBlocks.push_back(makeBlocks(BLOCKS, producer + 1));
+    }
+
+    for (unsigned poolBlocks = 1; 16 >= poolBlocks; poolBlocks *= 4)
+    {
+        bam::BgzfBlockPool pool(poolBlocks);
+        std::vector<bam::BgzfBuffer> outputs(PRODUCERS);
+        bool stop = false;
+        boost::ptr_vector<boost::thread> helpers;
+        for (unsigned helper = 0; HELPERS != helper; ++helper)
+        {
+            helpers.push_back(new boost::thread(boost::bind(&help, boost::ref(pool), level, boost::cref(stop))));
+        }
+        boost::ptr_vector<boost::thread> producers;
+        for (unsigned producer = 0; PRODUCERS != producer; ++producer)
+        {
+            producers.push_back(new boost::thread(boost::bind(
+                &produce, boost::ref(pool), boost::cref(producerBlocks.at(producer)), level,
+                boost::ref(outputs.at(producer)))));
+        }
+        for (boost::thread &producer : producers)
+        {
+            producer.join();
+        }
+        pool.stop(stop);
+        for (boost::thread &helper : helpers)
+        {
+            helper.join();
+        }
+
+        for (unsigned producer = 0; PRODUCERS != producer; ++producer)
+        {
+            const std::string expected = compressSequentially(producerBlocks.at(producer), level);
+            CPPUNIT_ASSERT_EQUAL(expected.size(), outputs.at(producer).size());
+            CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), outputs.at(producer).begin()));
+        }
+    }
+}
+
+void TestBgzfBlockPool::testPoolFull()
+{
+    // nobody helps, submit has to compress to free up the only block
+    const std::vector<std::string> blocks = makeBlocks(5, 3);
+    bam::BgzfBlockPool pool(1);
+    bam::BgzfBuffer output;
+    produce(pool, blocks, Z_DEFAULT_COMPRESSION, output);
+    const std::string expected = compressSequentially(blocks, Z_DEFAULT_COMPRESSION);
+    CPPUNIT_ASSERT_EQUAL(expected.size(), output.size());
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), output.begin()));
+}
+
+void TestBgzfBlockPool::testWaitForBlocks()
+{
+    const std::vector<std::string> blocks = makeBlocks(1, 5);
+    bam::BgzfBlockPool pool(2);
+    bgzf::BgzfDeflater deflater(bgzf::DeflateZlib, Z_DEFAULT_COMPRESSION);
+    bam::BgzfBlockPool::Queue queue;
+    bam::BgzfBuffer output;
+    output.reserve(bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    pool.open(queue, output);
+    bool stop = false;
+
+    pool.submit(queue, blocks.front().data(), blocks.front().size(), deflater);
+    CPPUNIT_ASSERT(pool.waitForBlocks(stop));
+    pool.compress(deflater);
+    CPPUNIT_ASSERT(queue.empty());
+    CPPUNIT_ASSERT_EQUAL(compressSequentially(blocks, Z_DEFAULT_COMPRESSION).size(), output.size());
+
+    boost::thread waiter(boost::bind(&bam::BgzfBlockPool::waitForBlocks, &pool, boost::cref(stop)));
+    pool.stop(stop);
+    waiter.join();
+    CPPUNIT_ASSERT(!pool.waitForBlocks(stop));
+}
+
+/**
+ * \brief blocks left in the queues of an abandoned run must not leak into the next one
+ */
+void TestBgzfBlockPool::testReset()
+{
+    const std::vector<std::string> blocks = makeBlocks(4, 7);
+    bam::BgzfBlockPool pool(2);
+    bgzf::BgzfDeflater deflater(bgzf::DeflateZlib, Z_DEFAULT_COMPRESSION);
+    bam::BgzfBlockPool::Queue queue;
+    bam::BgzfBuffer abandoned;
+    abandoned.reserve(blocks.size() * bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    pool.open(queue, abandoned);
+    pool.submit(queue, blocks.at(0).data(), blocks.at(0).size(), deflater);
+    pool.submit(queue, blocks.at(1).data(), blocks.at(1).size(), deflater);
+    CPPUNIT_ASSERT(!queue.empty());
+
+    pool.reset();
+    CPPUNIT_ASSERT(queue.empty());
+    // nothing is left waiting for compression
+    pool.compress(deflater);
+    CPPUNIT_ASSERT(abandoned.empty());
+
+    // the same queue can be reopened and all blocks are available again
+    bam::BgzfBuffer output;
+    output.reserve(blocks.size() * bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    pool.open(queue, output);
+    for (const std::string &block : blocks)
+    {
+        pool.submit(queue, block.data(), block.size(), deflater);
+    }
+    pool.flush(queue, deflater);
+    const std::string expected = compressSequentially(blocks, Z_DEFAULT_COMPRESSION);
+    CPPUNIT_ASSERT_EQUAL(expected.size(), output.size());
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), output.begin()));
+}
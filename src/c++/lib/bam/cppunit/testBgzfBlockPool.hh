@@ -0,0 +1,39 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BAM_TEST_BGZF_BLOCK_POOL_HH
+#define iSAAC_BAM_TEST_BGZF_BLOCK_POOL_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestBgzfBlockPool : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBgzfBlockPool );
+    CPPUNIT_TEST( testOutOfOrderCompletion );
+    CPPUNIT_TEST( testPoolFull );
+    CPPUNIT_TEST( testWaitForBlocks );
+    CPPUNIT_TEST( testReset );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    TestBgzfBlockPool();
+    void setUp();
+    void tearDown();
+
+    void testOutOfOrderCompletion();
+    void testPoolFull();
+    void testWaitForBlocks();
+    void testReset();
+};
+
+#endif // #ifndef iSAAC_BAM_TEST_BGZF_BLOCK_POOL_HH
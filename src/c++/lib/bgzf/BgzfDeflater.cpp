@@ -0,0 +1,207 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BgzfDeflater.cpp
+ **
+ ** Compression of complete bgzf blocks with a choice of deflate implementations.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "config.h"
+
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif //HAVE_LIBDEFLATE
+
+#include "bgzf/BgzfDeflater.hh"
+#include "common/Debug.hh"
+
+namespace isaac
+{
+namespace bgzf
+{
+
+const unsigned BgzfDeflater::UNCOMPRESSED_BLOCK_MAX;
+const unsigned BgzfDeflater::COMPRESSED_BLOCK_MAX;
+const unsigned BgzfDeflater::STORED_HEADER_BYTES;
+
+BOOST_STATIC_ASSERT(BgzfDeflater::COMPRESSED_BLOCK_MAX >=
+    sizeof(Header) + BgzfDeflater::STORED_HEADER_BYTES + BgzfDeflater::UNCOMPRESSED_BLOCK_MAX + sizeof(Footer));
+
+const char *getDeflateBackendName(const DeflateBackend backend)
+{
+    static const char *names[] = {"zlib", "libdeflate"};
+    ISAAC_ASSERT_MSG(DeflateBackendCount > backend, "Unknown deflate backend " << backend);
+    return names[backend];
+}
+
+bool isDeflateBackendSupported(const DeflateBackend backend)
+{
+    switch (backend)
+    {
+    case DeflateZlib:
+        return true;
+#ifdef HAVE_LIBDEFLATE
+    case DeflateLibdeflate:
+        return true;
+#endif //HAVE_LIBDEFLATE
+    default:
+        return false;
+    }
+}
+
+BgzfDeflater::BgzfDeflater(const DeflateBackend backend, const int level) :
+    backend_(backend), level_(level), libdeflate_(0)
+{
+    memset(&zstream_, 0, sizeof(zstream_));
+    if (DeflateZlib == backend_)
+    {
+        // raw deflate with the parameters boost::iostreams::gzip_compressor uses
+        const int ret = deflateInit2(&zstream_, level_, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        if (Z_OK != ret)
+        {
+            BOOST_THROW_EXCEPTION(BgzfDeflateException(
+                (boost::format("deflateInit2 failed with %d for level %d") % ret % level_).str()));
+        }
+    }
+#ifdef HAVE_LIBDEFLATE
+    else if (DeflateLibdeflate == backend_)
+    {
+        libdeflate_ = libdeflate_alloc_compressor(-1 == level_ ? 6 : level_);
+        if (!libdeflate_)
+        {
+            BOOST_THROW_EXCEPTION(BgzfDeflateException(
+                (boost::format("libdeflate_alloc_compressor failed for level %d") % level_).str()));
+        }
+    }
+#endif //HAVE_LIBDEFLATE
+    else
+    {
+        BOOST_THROW_EXCEPTION(BgzfDeflateException(
+            std::string("Deflate backend is not supported by this build: ") + getDeflateBackendName(backend_)));
+    }
+}
+
+BgzfDeflater::~BgzfDeflater()
+{
+    if (DeflateZlib == backend_)
+    {
+        deflateEnd(&zstream_);
+    }
+#ifdef HAVE_LIBDEFLATE
+    if (libdeflate_)
+    {
+        libdeflate_free_compressor(static_cast<libdeflate_compressor*>(libdeflate_));
+    }
+#endif //HAVE_LIBDEFLATE
+}
+
+std::size_t BgzfDeflater::deflateZlib(const char *data, const std::size_t size, char *out, const std::size_t capacity)
+{
+    deflateReset(&zstream_);
+    zstream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zstream_.avail_in = size;
+    zstream_.next_out = reinterpret_cast<Bytef*>(out);
+    zstream_.avail_out = capacity;
+    const int ret = ::deflate(&zstream_, Z_FINISH);
+    if (Z_OK == ret || (Z_BUF_ERROR == ret && !zstream_.avail_out))
+    {
+        // does not fit
+        return 0;
+    }
+    if (Z_STREAM_END != ret)
+    {
+        BOOST_THROW_EXCEPTION(BgzfDeflateException(
+            (boost::format("deflate failed with %d to compress %d bytes into %d") % ret % size % capacity).str()));
+    }
+    return capacity - zstream_.avail_out;
+}
+
+std::size_t BgzfDeflater::deflateLibdeflate(const char *data, const std::size_t size, char *out, const std::size_t capacity)
+{
+#ifdef HAVE_LIBDEFLATE
+    // 0 if does not fit
+    return libdeflate_deflate_compress(static_cast<libdeflate_compressor*>(libdeflate_), data, size, out, capacity);
+#else //HAVE_LIBDEFLATE
+    ISAAC_ASSERT_MSG(false, "libdeflate is not supported by this build");
+    return 0;
+#endif //HAVE_LIBDEFLATE
+}
+
+/**
+ * \brief Incompressible data grows a bit when deflated and UNCOMPRESSED_BLOCK_MAX of it does not fit in a bgzf
+ *        block. Such data goes into a single stored deflate block which adds only 5 bytes.
+ */
+std::size_t BgzfDeflater::store(const char *data, const std::size_t size, char *out)
+{
+    // BFINAL, BTYPE 00, LEN, NLEN
+    out[0] = 1;
+    out[1] = size;
+    out[2] = size >> 8;
+    out[3] = ~size;
+    out[4] = ~size >> 8;
+    std::copy(data, data + size, out + STORED_HEADER_BYTES);
+    return STORED_HEADER_BYTES + size;
+}
+
+std::size_t BgzfDeflater::compress(const char *data, const std::size_t size, char *out)
+{
+    ISAAC_ASSERT_MSG(UNCOMPRESSED_BLOCK_MAX >= size, "Too much data for a single bgzf block: " << size);
+
+    Header &header = *reinterpret_cast<Header*>(out);
+    header.ID1 = 31;
+    header.ID2 = 139;
+    header.CM = Z_DEFLATED;
+    // FEXTRA
+    header.FLG = 4;
+    std::fill(header.MTIME, header.MTIME + sizeof(header.MTIME), 0);
+    // same extra flags as boost::iostreams::gzip_compressor
+    header.XFL = Z_BEST_COMPRESSION == level_ ? 2 : Z_BEST_SPEED == level_ ? 4 : 0;
+    // unknown
+    header.OS = 255;
+
+    char *cdata = out + sizeof(Header);
+    const std::size_t capacity = COMPRESSED_BLOCK_MAX - sizeof(Header) - sizeof(Footer);
+    std::size_t cdataSize = DeflateZlib == backend_ ?
+        deflateZlib(data, size, cdata, capacity) : deflateLibdeflate(data, size, cdata, capacity);
+    if (!cdataSize)
+    {
+        cdataSize = store(data, size, cdata);
+    }
+
+    const boost::uint32_t crc = crc32(crc32(0, 0, 0), reinterpret_cast<const Bytef*>(data), size);
+    Footer &footer = *reinterpret_cast<Footer*>(cdata + cdataSize);
+    for (unsigned i = 0; sizeof(footer.CRC32) != i; ++i)
+    {
+        footer.CRC32[i] = crc >> (i * 8);
+        footer.ISIZE[i] = boost::uint32_t(size) >> (i * 8);
+    }
+
+    const std::size_t blockSize = sizeof(Header) + cdataSize + sizeof(Footer);
+    const BAM_XFIELD xfield =
+    {
+        {sizeof(BAM_XFIELD) - sizeof(short), 0},
+        66, 67, {2, 0}, {(unsigned char)(blockSize - 1), (unsigned char)((blockSize - 1) / 256)}
+    };
+    header.xfield = xfield;
+    return blockSize;
+}
+
+} // namespace bgzf
+} // namespace isaac
@@ -0,0 +1,285 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testBgzfDeflater.cpp
+ **
+ ** Test cases for BgzfDeflater. Every backend the build supports is checked for bgzf block layout and for
+ ** producing the same data as the BgzfCompressor filter once decompressed.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "bgzf/BgzfCompressor.hh"
+#include "bgzf/BgzfDeflater.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testBgzfDeflater.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBgzfDeflater, registryName("TestBgzfDeflater"));
+
+// end-of-file marker block samtools expects at the end of a bam file. Same bytes as bam::serializeBgzfFooter writes
+static const char BGZF_EOF[28] = "\037\213\010\4\0\0\0\0\0\377\6\0\102\103\2\0\033\0\3\0\0\0\0\0\0\0\0";
+
+static const int LEVELS[] = {Z_NO_COMPRESSION, Z_BEST_SPEED, Z_DEFAULT_COMPRESSION, 6, Z_BEST_COMPRESSION};
+
+TestBgzfDeflater::TestBgzfDeflater()
+{
+}
+
+void TestBgzfDeflater::setUp()
+{
+    // text that compresses well followed by more than a block of noise that does not compress at all and
+    // then more text so that the incompressible block sits in the middle
+    unsigned seed = 7;
+    data_.clear();
+    while (data_.size() < bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX * 3 / 2)
+    {
+        seed = seed * 1103515245 + 12345;
+        data_ += (boost::format("@read%d\n") % (seed % 100000)).str();
+        for (unsigned i = 0; 100 != i; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            data_ += "ACGT"[(seed >> 16) % 4];
+        }
+        data_ += "\n+\n";
+        data_.append(100, char('!' + (seed >> 8) % 41));
+        data_ += '\n';
+    }
+    const std::size_t noiseEnd = data_.size() + bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX + 1000;
+    while (data_.size() < noiseEnd)
+    {
+        seed = seed * 1103515245 + 12345;
+        data_ += char(seed >> 16);
+    }
+    data_ += data_.substr(0, bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX);
+}
+
+void TestBgzfDeflater::tearDown()
+{
+}
+
+static unsigned getUnsigned(const unsigned char *bytes)
+{
+    return unsigned(bytes[0]) + (unsigned(bytes[1]) << 8) + (unsigned(bytes[2]) << 16) + (unsigned(bytes[3]) << 24);
+}
+
+/**
+ * \brief Verifies the bgzf header and footer of the block and checks that it inflates into expected
+ */
+static void checkBlock(const char *block, const std::size_t length, const char *expected, const std::size_t expectedSize)
+{
+    CPPUNIT_ASSERT(sizeof(bgzf::Header) + sizeof(bgzf::Footer) <= length);
+    CPPUNIT_ASSERT(bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX >= length);
+
+    const bgzf::Header &header = *reinterpret_cast<const bgzf::Header*>(block);
+    CPPUNIT_ASSERT_EQUAL(31U, unsigned(header.ID1));
+    CPPUNIT_ASSERT_EQUAL(139U, unsigned(header.ID2));
+    CPPUNIT_ASSERT_EQUAL(unsigned(Z_DEFLATED), unsigned(header.CM));
+    CPPUNIT_ASSERT_EQUAL(4U, unsigned(header.FLG));
+    CPPUNIT_ASSERT_EQUAL(6U, header.xfield.getXLEN());
+    CPPUNIT_ASSERT_EQUAL(66U, unsigned(header.xfield.SI1));
+    CPPUNIT_ASSERT_EQUAL(67U, unsigned(header.xfield.SI2));
+    CPPUNIT_ASSERT_EQUAL(2U, unsigned(header.xfield.SLEN[0]) + header.xfield.SLEN[1] * 256);
+    CPPUNIT_ASSERT_EQUAL(length, std::size_t(header.xfield.getBSIZE() + 1));
+    CPPUNIT_ASSERT_EQUAL(length - sizeof(bgzf::Header) - sizeof(bgzf::Footer), std::size_t(header.getCDATASize()));
+
+    const bgzf::Footer &footer = *reinterpret_cast<const bgzf::Footer*>(block + length - sizeof(bgzf::Footer));
+    CPPUNIT_ASSERT_EQUAL(expectedSize, std::size_t(footer.getISIZE()));
+    const uLong crc = crc32(crc32(0, 0, 0), reinterpret_cast<const Bytef*>(expected), expectedSize);
+    CPPUNIT_ASSERT_EQUAL(unsigned(crc), getUnsigned(footer.CRC32));
+
+    // one spare byte to detect data past ISIZE
+    std::vector<char> inflated(expectedSize + 1);
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    CPPUNIT_ASSERT_EQUAL(Z_OK, inflateInit2(&zstream, -MAX_WBITS));
+    zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block + sizeof(bgzf::Header)));
+    zstream.avail_in = header.getCDATASize();
+    zstream.next_out = reinterpret_cast<Bytef*>(&inflated.front());
+    zstream.avail_out = inflated.size();
+    const int ret = inflate(&zstream, Z_FINISH);
+    const std::size_t inflatedSize = inflated.size() - zstream.avail_out;
+    const unsigned unconsumed = zstream.avail_in;
+    inflateEnd(&zstream);
+    CPPUNIT_ASSERT_EQUAL(Z_STREAM_END, ret);
+    CPPUNIT_ASSERT_EQUAL(0U, unconsumed);
+    CPPUNIT_ASSERT_EQUAL(expectedSize, inflatedSize);
+    CPPUNIT_ASSERT(std::equal(expected, expected + expectedSize, inflated.begin()));
+}
+
+/**
+ * \brief Compresses data the way BamEncoder does, checking every block on the way
+ */
+static std::string deflate(bgzf::BgzfDeflater &deflater, const std::string &data)
+{
+    std::string ret;
+    std::vector<char> block(bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    for (std::size_t offset = 0; data.size() != offset;)
+    {
+        const std::size_t size = std::min<std::size_t>(data.size() - offset, bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX);
+        const std::size_t length = deflater.compress(data.data() + offset, size, &block.front());
+        checkBlock(&block.front(), length, data.data() + offset, size);
+        ret.append(&block.front(), length);
+        offset += size;
+    }
+    return ret;
+}
+
+static std::string compressWithFilter(const std::string &data, const int level)
+{
+    std::ostringstream oss;
+    {
+        boost::iostreams::filtering_ostream bgzfStream;
+        bgzfStream.push(bgzf::BgzfCompressor(level));
+        bgzfStream.push(oss);
+        bgzfStream.write(data.data(), data.size());
+        bgzfStream.strict_sync();
+    }
+    return oss.str();
+}
+
+/**
+ * \brief Decompresses bgzf as a multi-member gzip file, the way tools that don't know about bgzf would
+ */
+static std::string gunzip(const std::string &compressed)
+{
+    std::string uncompressed;
+    std::vector<char> buffer(bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    CPPUNIT_ASSERT_EQUAL(Z_OK, inflateInit2(&zstream, MAX_WBITS + 16));
+    zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    zstream.avail_in = compressed.size();
+    while (zstream.avail_in)
+    {
+        zstream.next_out = reinterpret_cast<Bytef*>(&buffer.front());
+        zstream.avail_out = buffer.size();
+        const int ret = inflate(&zstream, Z_NO_FLUSH);
+        CPPUNIT_ASSERT_MESSAGE((boost::format("inflate returned %d") % ret).str(), Z_OK == ret || Z_STREAM_END == ret);
+        uncompressed.append(&buffer.front(), buffer.size() - zstream.avail_out);
+        if (Z_STREAM_END == ret)
+        {
+            CPPUNIT_ASSERT_EQUAL(Z_OK, inflateReset(&zstream));
+        }
+    }
+    inflateEnd(&zstream);
+    return uncompressed;
+}
+
+void TestBgzfDeflater::testBlockLayout()
+{
+    for (int backend = 0; bgzf::DeflateBackendCount != backend; ++backend)
+    {
+        if (!bgzf::isDeflateBackendSupported(bgzf::DeflateBackend(backend)))
+        {
+            continue;
+        }
+        BOOST_FOREACH(const int level, LEVELS)
+        {
+            bgzf::BgzfDeflater deflater(bgzf::DeflateBackend(backend), level);
+            const std::string compressed = deflate(deflater, data_);
+            CPPUNIT_ASSERT_MESSAGE(
+                (boost::format("%s level %d") % bgzf::getDeflateBackendName(bgzf::DeflateBackend(backend)) % level).str(),
+                data_ == gunzip(compressed));
+        }
+    }
+}
+
+void TestBgzfDeflater::testMatchesCompressor()
+{
+    for (int backend = 0; bgzf::DeflateBackendCount != backend; ++backend)
+    {
+        if (!bgzf::isDeflateBackendSupported(bgzf::DeflateBackend(backend)))
+        {
+            continue;
+        }
+        BOOST_FOREACH(const int level, LEVELS)
+        {
+            const std::string message =
+                (boost::format("%s level %d") % bgzf::getDeflateBackendName(bgzf::DeflateBackend(backend)) % level).str();
+            bgzf::BgzfDeflater deflater(bgzf::DeflateBackend(backend), level);
+            const std::string compressed = deflate(deflater, data_);
+            const std::string filtered = compressWithFilter(data_, level);
+            // same block boundaries regardless of the backend
+            CPPUNIT_ASSERT_MESSAGE(message, gunzip(filtered) == gunzip(compressed));
+            if (bgzf::DeflateZlib == backend && Z_NO_COMPRESSION != level)
+            {
+                CPPUNIT_ASSERT_MESSAGE(message, filtered == compressed);
+            }
+        }
+    }
+}
+
+void TestBgzfDeflater::testEofBlock()
+{
+    for (int backend = 0; bgzf::DeflateBackendCount != backend; ++backend)
+    {
+        if (!bgzf::isDeflateBackendSupported(bgzf::DeflateBackend(backend)))
+        {
+            continue;
+        }
+        bgzf::BgzfDeflater deflater(bgzf::DeflateBackend(backend), Z_DEFAULT_COMPRESSION);
+        std::vector<char> block(bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+        const std::size_t length = deflater.compress(0, 0, &block.front());
+        checkBlock(&block.front(), length, 0, 0);
+        if (bgzf::DeflateZlib == backend)
+        {
+            // empty zlib block is the standard end-of-file marker
+            CPPUNIT_ASSERT_EQUAL(std::string(BGZF_EOF, sizeof(BGZF_EOF)), std::string(&block.front(), length));
+        }
+    }
+
+    // the marker appended to bam files is a valid empty block too
+    checkBlock(BGZF_EOF, sizeof(BGZF_EOF), 0, 0);
+    CPPUNIT_ASSERT(gunzip(compressWithFilter(data_, Z_DEFAULT_COMPRESSION) + std::string(BGZF_EOF, sizeof(BGZF_EOF))) == data_);
+}
+
+void TestBgzfDeflater::testIncompressible()
+{
+    // a whole block of noise grows when deflated and must be stored to fit
+    unsigned seed = 11;
+    std::string noise;
+    while (noise.size() < bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX)
+    {
+        seed = seed * 1103515245 + 12345;
+        noise += char(seed >> 16);
+    }
+
+    for (int backend = 0; bgzf::DeflateBackendCount != backend; ++backend)
+    {
+        if (!bgzf::isDeflateBackendSupported(bgzf::DeflateBackend(backend)))
+        {
+            continue;
+        }
+        BOOST_FOREACH(const int level, LEVELS)
+        {
+            bgzf::BgzfDeflater deflater(bgzf::DeflateBackend(backend), level);
+            // twice to see that the deflater is good for another block after the data did not fit
+            CPPUNIT_ASSERT(noise + noise == gunzip(deflate(deflater, noise) + deflate(deflater, noise)));
+            CPPUNIT_ASSERT(data_ == gunzip(deflate(deflater, data_)));
+        }
+    }
+}
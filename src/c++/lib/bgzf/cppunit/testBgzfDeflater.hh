@@ -0,0 +1,43 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BGZF_TEST_BGZF_DEFLATER_HH
+#define iSAAC_BGZF_TEST_BGZF_DEFLATER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+class TestBgzfDeflater : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBgzfDeflater );
+    CPPUNIT_TEST( testBlockLayout );
+    CPPUNIT_TEST( testMatchesCompressor );
+    CPPUNIT_TEST( testEofBlock );
+    CPPUNIT_TEST( testIncompressible );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    std::string data_;
+
+public:
+    TestBgzfDeflater();
+    void setUp();
+    void tearDown();
+
+    void testBlockLayout();
+    void testMatchesCompressor();
+    void testEofBlock();
+    void testIncompressible();
+};
+
+#endif // #ifndef iSAAC_BGZF_TEST_BGZF_DEFLATER_HH
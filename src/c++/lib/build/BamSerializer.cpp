@@ -29,13 +29,14 @@ namespace build
  */
 void BamSerializer::splitIfNeeded(
     PackedFragmentBuffer &data,
-    PackedFragmentBuffer::Index &index,
+    PackedFragmentBuffer::CompactIndex &compactIndex,
     BinData::IndexType &splitIndexEntries,
     alignment::Cigar &splitCigars)
 {
     // update all index record positions before sorting as they may have been messed up by gap realignment
-    io::FragmentAccessor &fragment = data.getFragment(index);
-    index.pos_ = fragment.fStrandPosition_;
+    io::FragmentAccessor &fragment = data.getFragment(compactIndex);
+    compactIndex.pos_ = fragment.fStrandPosition_;
+    PackedFragmentBuffer::Index index = data.getIndex(compactIndex, splitCigars);
     alignment::CigarPosition<PackedFragmentBuffer::Index::CigarIterator> last(index.cigarBegin_, index.cigarEnd_, index.pos_, fragment.isReverse(), fragment.readLength_);
     for (alignment::CigarPosition<PackedFragmentBuffer::Index::CigarIterator> current = last;
         !current.end(); ++current)
@@ -47,13 +48,15 @@ void BamSerializer::splitIfNeeded(
                 (current.referencePos_ - last.referencePos_) > splitGapLength_))
         {
             ISAAC_ASSERT_MSG(splitIndexEntries.size() < splitIndexEntries.capacity(), "New entries must not cause buffer reallocation");
-            ISAAC_ASSERT_MSG(splitCigars.size() + std::distance(index.cigarBegin_, index.cigarEnd_) * 2 <= splitCigars.capacity(),
+            ISAAC_ASSERT_MSG(splitCigars.size() + std::distance(index.cigarBegin_, index.cigarEnd_) * 2 + 2 <= splitCigars.capacity(),
                 "New entries must not cause cigar buffer reallocation");
 
             // create new entry
             PackedFragmentBuffer::Index secondPart(index);
 
+            // CIGAR length goes in front of each part for PackedFragmentBuffer::getIndex
             const std::size_t before = splitCigars.size();
+            splitCigars.push_back(0);
             if (current.reverse_ == last.reverse_)
             {
                 // soft clip sequence that belongs to the previous part of the split
@@ -62,13 +65,16 @@ void BamSerializer::splitIfNeeded(
 
             secondPart.pos_ = current.referencePos_;
             splitCigars.addOperations(current.cigarIt_, index.cigarEnd_);
-            secondPart.cigarBegin_ = &splitCigars.front() + before;
+            secondPart.cigarBegin_ = &splitCigars.at(before) + 1;
             secondPart.cigarEnd_ = &splitCigars.back() + 1;
+            splitCigars.at(before) = std::distance(secondPart.cigarBegin_, secondPart.cigarEnd_);
             secondPart.reverse_ = current.reverse_;
-            splitIndexEntries.push_back(secondPart);
+            splitIndexEntries.push_back(data.getCompactIndex(secondPart, splitCigars));
 
             //patch the old one
             const PackedFragmentBuffer::Index::CigarIterator oldBegin = index.cigarBegin_;
+            const std::size_t patchedBefore = splitCigars.size();
+            splitCigars.push_back(0);
             index.cigarBegin_ = &splitCigars.back() + 1;
             splitCigars.addOperations(oldBegin, last.cigarIt_);
 
@@ -79,6 +85,8 @@ void BamSerializer::splitIfNeeded(
                 splitCigars.addOperation(sequenceLeftover, alignment::Cigar::SOFT_CLIP);
             }
             index.cigarEnd_ = &splitCigars.back() + 1;
+            splitCigars.at(patchedBefore) = std::distance(index.cigarBegin_, index.cigarEnd_);
+            compactIndex = data.getCompactIndex(index, splitCigars);
 
             //change iterator to travel over the CIGAR of the new entry
             current = alignment::CigarPosition<PackedFragmentBuffer::Index::CigarIterator>(secondPart.cigarBegin_, secondPart.cigarEnd_, secondPart.pos_, current.reverse_, fragment.readLength_);
@@ -96,14 +104,29 @@ void BamSerializer::splitIfNeeded(
 void BamSerializer::prepareForBam(
     PackedFragmentBuffer &data,
     BinData::IndexType &dataIndex,
-    alignment::Cigar &splitCigars)
+    alignment::Cigar &splitCigars,
+    common::RadixSortRecords &sortRecords)
 {
-    BOOST_FOREACH(PackedFragmentBuffer::Index &index, dataIndex)
+    BOOST_FOREACH(PackedFragmentBuffer::CompactIndex &index, dataIndex)
     {
         splitIfNeeded(data, index, dataIndex, splitCigars);
     }
 
-    std::sort(dataIndex.begin(), dataIndex.end(), boost::bind(&PackedFragmentBuffer::orderForBam, boost::ref(data), _1, _2));
+    if (sortRecords.capacity() >= dataIndex.size() * 2)
+    {
+        // positions decide the order of almost all records. Only the ones at the same position need to look at the fragments
+        common::radixSort(
+            dataIndex,
+            [](const PackedFragmentBuffer::CompactIndex &index){return index.pos_.getValue();},
+            boost::bind(&PackedFragmentBuffer::orderForBam<PackedFragmentBuffer::CompactIndex>, boost::ref(data), _1, _2),
+            sortRecords);
+    }
+    else
+    {
+        // more split entries than anticipated
+        std::sort(dataIndex.begin(), dataIndex.end(),
+                  boost::bind(&PackedFragmentBuffer::orderForBam<PackedFragmentBuffer::CompactIndex>, boost::ref(data), _1, _2));
+    }
 }
 
 } // namespace build
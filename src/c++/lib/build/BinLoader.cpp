@@ -151,6 +151,8 @@ void BinLoader::storeFragmentIndex(
     uint64_t offset,
     uint64_t mateOffset, BinData& binData)
 {
+    // the index kept after duplicate filtering has no room for it
+    binData.data_.storeMateDataOffset(offset, mateOffset);
     if (fragment.flags_.reverse_ || fragment.flags_.unmapped_)
     {
         RStrandOrShadowFragmentIndex rsIdx(
@@ -217,6 +219,7 @@ void BinLoader::loadAlignedData(BinData &binData)
                 SeFragmentIndex seIdx(fragment.fStrandPosition_);
                 seIdx.dataOffset_ = offset;
                 binData.seIdx_.push_back(seIdx);
+                binData.data_.storeMateDataOffset(offset, offset);
             }
             else
             {
@@ -0,0 +1,247 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BinQueue.cpp
+ **
+ ** Hand over of the bins from alignment to Build when the two run at the same time.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include "build/BinQueue.hh"
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace build
+{
+
+BinQueue::BinQueue(const uint64_t memoryBudget) :
+    memoryBudget_(memoryBudget),
+    reservedMemory_(0),
+    bins_(0),
+    lastBatch_(0),
+    takenBins_(0),
+    closed_(false),
+    terminated_(false)
+{
+}
+
+void BinQueue::checkTerminated() const
+{
+    if (terminated_)
+    {
+        BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures in alignment"));
+    }
+}
+
+void BinQueue::open(const alignment::BinMetadataList &bins)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(!bins_, "BinQueue can be opened only once");
+    tiles_.resize(bins.size());
+    batches_.resize(bins.size(), 0);
+    taken_.resize(bins.size(), false);
+    BOOST_FOREACH(const alignment::BinMetadata &bin, bins)
+    {
+        if (!bin.isUnalignedBin())
+        {
+            order_.push_back(bin.getIndex());
+        }
+    }
+    BOOST_FOREACH(const alignment::BinMetadata &bin, bins)
+    {
+        if (bin.isUnalignedBin())
+        {
+            order_.push_back(bin.getIndex());
+        }
+    }
+    bins_ = &bins;
+    stateChangedCondition_.notify_all();
+}
+
+void BinQueue::sealBins(const std::vector<unsigned> &binIndexes, const flowcell::TileMetadataList &tiles)
+{
+    const boost::shared_ptr<const flowcell::TileMetadataList> tilesSnapshot(new flowcell::TileMetadataList(tiles));
+    ++lastBatch_;
+    BOOST_FOREACH(const unsigned binIndex, binIndexes)
+    {
+        ISAAC_ASSERT_MSG(!batches_.at(binIndex), "Bin sealed twice: " << bins_->at(binIndex));
+        batches_.at(binIndex) = lastBatch_;
+        tiles_.at(binIndex) = tilesSnapshot;
+    }
+}
+
+void BinQueue::seal(const std::vector<unsigned> &binIndexes, const flowcell::TileMetadataList &tiles)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(bins_, "BinQueue must be opened before sealing bins");
+    sealBins(binIndexes, tiles);
+    BOOST_FOREACH(const unsigned binIndex, binIndexes)
+    {
+        ISAAC_THREAD_CERR << "Sealed " << bins_->at(binIndex) << std::endl;
+    }
+    stateChangedCondition_.notify_all();
+}
+
+void BinQueue::close(const flowcell::TileMetadataList &tiles)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(bins_, "BinQueue must be opened before closing");
+    std::vector<unsigned> unsealed;
+    for (unsigned binIndex = 0; batches_.size() != binIndex; ++binIndex)
+    {
+        if (!batches_[binIndex])
+        {
+            unsealed.push_back(binIndex);
+        }
+    }
+    sealBins(unsealed, tiles);
+    closed_ = true;
+    stateChangedCondition_.notify_all();
+}
+
+void BinQueue::terminate() noexcept
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    terminated_ = true;
+    stateChangedCondition_.notify_all();
+}
+
+const alignment::BinMetadataList &BinQueue::waitOpen()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!bins_)
+    {
+        checkTerminated();
+        stateChangedCondition_.wait(lock);
+    }
+    return *bins_;
+}
+
+bool BinQueue::fitsBudget(const uint64_t bytes) const
+{
+    return !memoryBudget_ || !reservedMemory_ || memoryBudget_ >= reservedMemory_ + bytes;
+}
+
+/**
+ * \return the first sealed bin that fits the budget and has no bins of its seal call waiting before it.
+ *         0 if there is no such bin.
+ */
+const alignment::BinMetadata *BinQueue::findNextBin(
+    const boost::function<uint64_t(const alignment::BinMetadata &)> &getBinMemory) const
+{
+    // seal calls that have a bin waiting
+    std::vector<unsigned> busyBatches;
+    bool alignedBinsWaiting = false;
+    BOOST_FOREACH(const unsigned binIndex, order_)
+    {
+        if (taken_[binIndex])
+        {
+            continue;
+        }
+        const alignment::BinMetadata &bin = bins_->at(binIndex);
+        if (bin.isUnalignedBin() && alignedBinsWaiting)
+        {
+            break;
+        }
+        alignedBinsWaiting = !bin.isUnalignedBin();
+
+        const unsigned batch = batches_[binIndex];
+        if (batch && busyBatches.end() == std::find(busyBatches.begin(), busyBatches.end(), batch))
+        {
+            busyBatches.push_back(batch);
+            if (fitsBudget(getBinMemory(bin)))
+            {
+                return &bin;
+            }
+        }
+    }
+    return 0;
+}
+
+const alignment::BinMetadata *BinQueue::pop(
+    const boost::function<uint64_t(const alignment::BinMetadata &)> &getBinMemory)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!bins_ || order_.size() != takenBins_)
+    {
+        const alignment::BinMetadata *bin = bins_ ? findNextBin(getBinMemory) : 0;
+        if (bin)
+        {
+            taken_.at(bin->getIndex()) = true;
+            ++takenBins_;
+            return bin;
+        }
+        checkTerminated();
+        stateChangedCondition_.wait(lock);
+    }
+    return 0;
+}
+
+const flowcell::TileMetadataList &BinQueue::getTiles(const alignment::BinMetadata &bin) const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(tiles_.at(bin.getIndex()), "Tiles requested for a bin that is not sealed: " << bin);
+    return *tiles_.at(bin.getIndex());
+}
+
+void BinQueue::waitClosed()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!closed_)
+    {
+        checkTerminated();
+        stateChangedCondition_.wait(lock);
+    }
+}
+
+void BinQueue::reserveAlignmentMemory(const uint64_t bytes)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    reservedMemory_ += bytes;
+}
+
+void BinQueue::reserveBinMemory(const uint64_t bytes)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    bool warningTraced = false;
+    while (!fitsBudget(bytes))
+    {
+        checkTerminated();
+        if (!warningTraced)
+        {
+            ISAAC_THREAD_CERR << "Waiting for " << bytes << " bytes of memory, " << reservedMemory_ << " of " <<
+                memoryBudget_ << " reserved" << std::endl;
+            warningTraced = true;
+        }
+        stateChangedCondition_.wait(lock);
+    }
+    reservedMemory_ += bytes;
+}
+
+void BinQueue::releaseMemory(const uint64_t bytes)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(reservedMemory_ >= bytes, "Releasing more memory than reserved: " << bytes << " " << reservedMemory_);
+    reservedMemory_ -= bytes;
+    stateChangedCondition_.notify_all();
+}
+
+} // namespace build
+} // namespace isaac
@@ -19,7 +19,6 @@
 
 #include <boost/foreach.hpp>
 #include <boost/function_output_iterator.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 
@@ -27,6 +26,7 @@
 
 #include "build/BinSorter.hh"
 #include "common/Memory.hh"
+#include "common/StageCounters.hh"
 
 namespace isaac
 {
@@ -35,16 +35,21 @@ namespace build
 
 uint64_t BinSorter::serialize(
     BinData &binData,
-    boost::ptr_vector<boost::iostreams::filtering_ostream> &bgzfStreams,
+    boost::ptr_vector<bam::BamEncoder> &bamEncoders,
     boost::ptr_vector<bam::BamIndexPart> &bamIndexParts)
 {
+    common::StageTimer timer(common::STAGE_SERIALIZATION);
     if (!binData.getUniqueRecordsCount())
     {
+        BOOST_FOREACH(bam::BamEncoder &bamEncoder, bamEncoders)
+        {
+            bamEncoder.close();
+        }
         return 0;
     }
     ISAAC_THREAD_CERR << "Sorting offsets for bam " << binData.bin_ << std::endl;
 
-    bamSerializer_.prepareForBam(binData.data_, binData, binData.additionalCigars_);
+    bamSerializer_.prepareForBam(binData.data_, binData, binData.additionalCigars_, binData.sortRecords_);
 
     ISAAC_THREAD_CERR << "Sorting offsets for bam done " << binData.bin_ << std::endl;
 
@@ -59,7 +64,7 @@ uint64_t BinSorter::serialize(
         {
             const io::FragmentAccessor &fragment = binData.data_.getFragment(offset);
 //            ISAAC_THREAD_CERR << "storeUnaligned: " << offset << "/" << binData.data_.size() << " " << fragment << std::endl;
-            bamSerializer_.storeUnaligned(fragment, bgzfStreams, bamIndexParts, binData.bamAdapter_(fragment));
+            bamSerializer_.storeUnaligned(fragment, bamEncoders, bamIndexParts, binData.bamAdapter_(fragment));
             offset += fragment.getTotalLength();
         }
     }
@@ -67,24 +72,25 @@ uint64_t BinSorter::serialize(
     {
         const isaac::reference::ContigLists &nodeContigs = contigLists_.threadNodeContainer();
         const isaac::reference::ContigAnnotationsList &nodeAnnotations = annotations_.threadNodeContainer();
-        BOOST_FOREACH(const PackedFragmentBuffer::Index& idx, binData)
+        BOOST_FOREACH(const PackedFragmentBuffer::CompactIndex& compactIdx, binData)
         {
             // realigning reads that don't belong to the bin is not very useful
             // also, it can move the read position and cause more than one copy of the
             // read to be stored in the bam file.
-            if (binData.bin_.hasPosition(idx.pos_))
+            if (binData.bin_.hasPosition(compactIdx.pos_))
             {
+                const PackedFragmentBuffer::Index idx = binData.data_.getIndex(compactIdx, binData.additionalCigars_);
                 downgradeAlignmentScores(nodeContigs, nodeAnnotations, idx, binData.data_);
                 const io::FragmentAccessor &fragment = binData.data_.getFragment(idx);
-                bamSerializer_.storeAligned(fragment, bgzfStreams, bamIndexParts, binData.bamAdapter_(idx, fragment));
+                bamSerializer_.storeAligned(fragment, bamEncoders, bamIndexParts, binData.bamAdapter_(idx, fragment));
             }
             //else the fragment got split into a bit that does not belong to the current bin. it will get stored by another bin BinSorter.
         }
     }
 
-    BOOST_FOREACH(boost::iostreams::filtering_ostream &bgzfStream, bgzfStreams)
+    BOOST_FOREACH(bam::BamEncoder &bamEncoder, bamEncoders)
     {
-        ISAAC_VERIFY_MSG(bgzfStream.strict_sync(), "Expecting the compressor to flush all the data");
+        bamEncoder.close();
     }
 
     std::time_t serTimeEnd = common::time();
@@ -93,41 +99,52 @@ uint64_t BinSorter::serialize(
     return binData.size();
 }
 
+template <typename FilterT, typename IndexT>
+void BinSorter::filterDuplicates(
+    const FilterT &filter,
+    IndexT &index,
+    BinData &binData,
+    BuildStats &buildStats,
+    common::ParallelFor &parallelFor)
+{
+    if (GROUP_DUPLICATES_BY_HASH != duplicateGrouping_ ||
+        !HashDuplicatePairEndFilter(keepDuplicates_, binData.sortRecords_).filterInput(
+            filter, binData.data_, index.begin(), index.end(),
+            buildStats, binData.binStatsIndex_, std::back_inserter(binData), parallelFor))
+    {
+        DuplicatePairEndFilter(keepDuplicates_, binData.sortRecords_).filterInput(
+            filter, binData.data_, index.begin(), index.end(),
+            buildStats, binData.binStatsIndex_, std::back_inserter(binData));
+    }
+}
+
 void BinSorter::resolveDuplicates(
     BinData &binData,
-    BuildStats &buildStats)
+    BuildStats &buildStats,
+    common::ParallelFor &parallelFor)
 {
+    common::StageTimer timer(common::STAGE_DUPLICATE_FILTERING);
     ISAAC_THREAD_CERR << "Resolving duplicates for bin " << binData.bin_ << std::endl;
 
-    NotAFilter().filterInput(binData.data_, binData.seIdx_.begin(), binData.seIdx_.end(), buildStats, binData.binStatsIndex_, std::back_inserter(binData));
     if (keepDuplicates_ && !markDuplicates_)
     {
+        NotAFilter().filterInput(binData.data_, binData.seIdx_.begin(), binData.seIdx_.end(), buildStats, binData.binStatsIndex_, std::back_inserter(binData));
         NotAFilter().filterInput(binData.data_, binData.rIdx_.begin(), binData.rIdx_.end(), buildStats, binData.binStatsIndex_, std::back_inserter(binData));
         NotAFilter().filterInput(binData.data_, binData.fIdx_.begin(), binData.fIdx_.end(), buildStats, binData.binStatsIndex_, std::back_inserter(binData));
     }
     else
     {
+        NotAFilter().filterInput(binData.data_, binData.seIdx_.begin(), binData.seIdx_.end(), buildStats, binData.binStatsIndex_, std::back_inserter(binData));
+
         if (singleLibrarySamples_)
         {
-            DuplicatePairEndFilter(keepDuplicates_).filterInput(
-                RSDuplicateFilter<true>(binData.barcodeBamMapping_.getSampleIndexMap()),
-                binData.data_, binData.rIdx_.begin(), binData.rIdx_.end(),
-                buildStats, binData.binStatsIndex_, std::back_inserter(binData));
-            DuplicatePairEndFilter(keepDuplicates_).filterInput(
-                FDuplicateFilter<true>(binData.barcodeBamMapping_.getSampleIndexMap()),
-                binData.data_, binData.fIdx_.begin(), binData.fIdx_.end(),
-                buildStats, binData.binStatsIndex_, std::back_inserter(binData));
+            filterDuplicates(RSDuplicateFilter<true>(binData.barcodeBamMapping_.getSampleIndexMap()), binData.rIdx_, binData, buildStats, parallelFor);
+            filterDuplicates(FDuplicateFilter<true>(binData.barcodeBamMapping_.getSampleIndexMap()), binData.fIdx_, binData, buildStats, parallelFor);
         }
         else
         {
-            DuplicatePairEndFilter(keepDuplicates_).filterInput(
-                RSDuplicateFilter<false>(binData.barcodeBamMapping_.getSampleIndexMap()),
-                binData.data_, binData.rIdx_.begin(), binData.rIdx_.end(),
-                buildStats, binData.binStatsIndex_, std::back_inserter(binData));
-            DuplicatePairEndFilter(keepDuplicates_).filterInput(
-                FDuplicateFilter<false>(binData.barcodeBamMapping_.getSampleIndexMap()),
-                binData.data_, binData.fIdx_.begin(), binData.fIdx_.end(),
-                buildStats, binData.binStatsIndex_, std::back_inserter(binData));
+            filterDuplicates(RSDuplicateFilter<false>(binData.barcodeBamMapping_.getSampleIndexMap()), binData.rIdx_, binData, buildStats, parallelFor);
+            filterDuplicates(FDuplicateFilter<false>(binData.barcodeBamMapping_.getSampleIndexMap()), binData.fIdx_, binData, buildStats, parallelFor);
         }
     }
 
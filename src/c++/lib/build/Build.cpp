@@ -37,6 +37,7 @@
 #include "build/IndelLoader.hh"
 #include "common/Debug.hh"
 #include "common/FileSystem.hh"
+#include "common/StageCounters.hh"
 #include "common/Threads.hpp"
 #include "io/Fragment.hh"
 #include "reference/ContigLoader.hh"
@@ -50,6 +51,8 @@ namespace build
 {
 
 const unsigned BuildContigMap::UNMAPPED_CONTIG;
+const unsigned Build::BGZF_BLOCKS_PER_COMPUTER;
+
 /**
  * \return Returns the total memory in bytes required to load the bin data and indexes
  */
@@ -93,6 +96,19 @@ uint64_t Build::estimateBinCompressedDataRequirements(
             binMetadata.getTotalElements() - 1) / binMetadata.getTotalElements()) * expectedBgzfCompressionRatio_;
 }
 
+/**
+ * \return bin data, index and compressed output buffers of all output files
+ */
+uint64_t Build::estimateBinMemoryRequirements(const alignment::BinMetadata & binMetadata) const
+{
+    uint64_t ret = BinData::getMemoryRequirements(binMetadata);
+    for(unsigned outputFileIndex = 0; outputFileIndex < barcodeBamMapping_.getTotalSamples(); ++outputFileIndex)
+    {
+        ret += estimateBinCompressedDataRequirements(binMetadata, outputFileIndex);
+    }
+    return ret;
+}
+
 inline boost::filesystem::path getSampleBamPath(
     const boost::filesystem::path &outputDirectory,
     const flowcell::BarcodeMetadata &barcode)
@@ -245,6 +261,30 @@ std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > Build::crea
     return ret;
 }
 
+static boost::regex makeBinRegex(const std::string &binRegexString)
+{
+    std::string regexString(binRegexString);
+    std::replace(regexString.begin(), regexString.end(), ',', '|');
+    return boost::regex(regexString);
+}
+
+/**
+ * \brief Same selection as filterBins for a single bin
+ */
+static bool isBinSelected(const alignment::BinMetadata &bin, const std::string &binRegexString)
+{
+    if ("all" == binRegexString)
+    {
+        return true;
+    }
+    if (bin.isEmpty())
+    {
+        return false;
+    }
+    return "skip-empty" == binRegexString ||
+        boost::regex_search(bin.getPath().filename().string(), makeBinRegex(binRegexString));
+}
+
 const alignment::BinMetadataCRefList filterBins(
     const alignment::BinMetadataList& bins,
     const std::string &binRegexString)
@@ -268,9 +308,7 @@ const alignment::BinMetadataCRefList filterBins(
     }
     else // use regex to filter bins by name
     {
-        std::string regexString(binRegexString);
-        std::replace(regexString.begin(), regexString.end(), ',', '|');
-        boost::regex re(regexString);
+        const boost::regex re(makeBinRegex(binRegexString));
         BOOST_FOREACH(const alignment::BinMetadata &bin, bins)
         {
             if (!bin.isEmpty() && boost::regex_search(bin.getPath().filename().string(), re))
@@ -281,7 +319,7 @@ const alignment::BinMetadataCRefList filterBins(
         if (ret.empty())
         {
             ISAAC_THREAD_CERR << "WARNING: Bam files will be empty. No bins are left after applying the following regex filter: "
-                << regexString << std::endl;
+                << re.str() << std::endl;
         }
     }
     return ret;
@@ -361,6 +399,7 @@ Build::Build(const std::vector<std::string> &argv,
              const build::GapRealignerMode realignGaps,
              const boost::filesystem::path &knownIndelsPath,
              const int bamGzipLevel,
+             const bgzf::DeflateBackend bamDeflateBackend,
              const std::string &bamPuFormat,
              const bool bamProduceMd5,
              const std::vector<std::string> &bamHeaderTags,
@@ -369,6 +408,7 @@ Build::Build(const std::vector<std::string> &argv,
              const bool keepDuplicates,
              const bool markDuplicates,
              const bool anchorMate,
+             const DuplicateGroupingMode duplicateGrouping,
              const bool realignGapsVigorously,
              const bool realignDodgyFragments,
              const unsigned realignedGapsPerFragment,
@@ -380,14 +420,15 @@ Build::Build(const std::vector<std::string> &argv,
              const bool putUnalignedInTheBack,
              const IncludeTags includeTags,
              const bool pessimisticMapQ,
-             const unsigned splitGapLength)
+             const unsigned splitGapLength,
+             BinQueue *binQueue)
     :argv_(argv),
      description_(description),
      flowcellLayoutList_(flowcellLayoutList),
      tileMetadataList_(tileMetadataList),
      barcodeMetadataList_(barcodeMetadataList),
      unalignedBinParts_(),
-     bins_(breakUpUnalignedBin(
+     bins_(binQueue ? alignment::BinMetadataCRefList() : breakUpUnalignedBin(
          filterBins(bins, binRegexString), maxComputers, keepUnaligned, putUnalignedInTheBack, unalignedBinParts_)),
      sortedReferenceMetadataList_(sortedReferenceMetadataList),
      contigMap_(barcodeMetadataList_, bins_, sortedReferenceMetadataList_, false),//!loadAllContigs && "skip-empty" == binRegexString),
@@ -406,6 +447,7 @@ Build::Build(const std::vector<std::string> &argv,
      keepDuplicates_(keepDuplicates),
      markDuplicates_(markDuplicates),
      anchorMate_(anchorMate),
+     duplicateGrouping_(duplicateGrouping),
      realignGapsVigorously_(realignGapsVigorously),
      realignDodgyFragments_(realignDodgyFragments),
      realignedGapsPerFragment_(realignedGapsPerFragment),
@@ -416,37 +458,61 @@ Build::Build(const std::vector<std::string> &argv,
      includeTags_(includeTags),
      pessimisticMapQ_(pessimisticMapQ),
      splitGapLength_(splitGapLength),
+     binQueue_(binQueue),
+     binRegexString_(binRegexString),
+     keepUnaligned_(keepUnaligned),
+     computeThreads_(maxComputers),
      forceTermination_(false),
+     binQueueWaiting_(false),
+     alignedBinsQueued_(false),
+     unalignedBin_(0),
      threads_(maxComputers_ + maxLoaders_ + maxSavers_),
      contigLists_(contigLists),
      barcodeBamMapping_(mapBarcodesToFiles(outputDirectory_, barcodeMetadataList_)),
      bamIndexes_(),
-     bamFileStreams_(createOutputFileStreams(tileMetadataList_, barcodeMetadataList_, bamIndexes_)),
+     // the tile list is not final until alignment is done
+     bamFileStreams_(binQueue_ ?
+         std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> >() :
+         createOutputFileStreams(tileMetadataList_, barcodeMetadataList_, bamIndexes_)),
      stats_(bins_, barcodeMetadataList_),
-     threadBgzfBuffers_(threads_.size(), BgzfBuffers(bamFileStreams_.size())),
-     threadBgzfStreams_(threads_.size()),
+     threadReservedMemory_(threads_.size(), 0),
+     threadBgzfBuffers_(threads_.size(), BgzfBuffers(barcodeBamMapping_.getTotalSamples())),
+     bgzfBlockPool_(maxComputers_ * BGZF_BLOCKS_PER_COMPUTER),
+     threadDeflaters_(threads_.size()),
+     threadBamEncoders_(threads_.size()),
      threadBamIndexParts_(threads_.size()),
      knownIndels_((build::GapRealignerMode::REALIGN_NONE == realignGaps_ || knownIndelsPath.empty()) ?
          gapRealigner::Gaps() : loadIndels(knownIndelsPath, sortedReferenceMetadataList_)),
      gapRealigner_(threads_.size(),
          realignGapsVigorously, realignDodgyFragments, realignedGapsPerFragment, clipSemialigned,
-         barcodeMetadataList, barcodeTemplateLengthStatistics, contigLists_),
-     binSorter_(singleLibrarySamples_, keepDuplicates_, markDuplicates_, anchorMate_,
+         barcodeMetadataList, barcodeTemplateLengthStatistics, contigLists_, !binQueue),
+     binSorter_(singleLibrarySamples_, keepDuplicates_, markDuplicates_, anchorMate_, duplicateGrouping_,
                barcodeBamMapping_, barcodeMetadataList_, contigLists_, splitGapLength_, kUniquenessAnnotations)
 {
     computeSlotWaitingBins_.reserve(threads_.size());
-    while(threadBgzfStreams_.size() < threads_.size())
+    while(threadDeflaters_.size() < threads_.size())
     {
-        threadBgzfStreams_.push_back(new boost::ptr_vector<boost::iostreams::filtering_ostream>(bamFileStreams_.size()));
+        threadDeflaters_.push_back(new bgzf::BgzfDeflater(bamDeflateBackend, bamGzipLevel_));
+        threadBamEncoders_.push_back(new boost::ptr_vector<bam::BamEncoder>(barcodeBamMapping_.getTotalSamples()));
+        while(threadBamEncoders_.back().size() < barcodeBamMapping_.getTotalSamples())
+        {
+            threadBamEncoders_.back().push_back(new bam::BamEncoder(bgzfBlockPool_));
+        }
     }
     while(threadBamIndexParts_.size() < threads_.size())
     {
-        threadBamIndexParts_.push_back(new boost::ptr_vector<bam::BamIndexPart>(bamFileStreams_.size()));
+        threadBamIndexParts_.push_back(new boost::ptr_vector<bam::BamIndexPart>(barcodeBamMapping_.getTotalSamples()));
     }
 
     threads_.execute(boost::bind(&Build::allocateThreadData, this, _1));
 
-    tasks_.reserve(bins_.size());
+    if (binQueue_)
+    {
+        // bins_ must not reallocate while the threads are iterating through it
+        bins_.reserve(bins.size());
+        stats_.resize(bins.size());
+    }
+    tasks_.reserve(binQueue_ ? bins.size() : bins_.size());
 
 //    testBinsFitInRam();
 }
@@ -466,6 +532,9 @@ void Build::allocateThreadData(const std::size_t threadNumber)
 
 void Build::run(common::ScopedMallocBlock &mallocBlock)
 {
+    // blocks and failure left behind by a run that did not complete
+    bgzfBlockPool_.reset();
+
     alignment::BinMetadataCRefList::const_iterator nextUnprocessedBinIt(bins_.begin());
     alignment::BinMetadataCRefList::const_iterator nextUnallocatedBinIt(bins_.begin());
     alignment::BinMetadataCRefList::const_iterator nextUnloadedBinIt(bins_.begin());
@@ -481,6 +550,33 @@ void Build::run(common::ScopedMallocBlock &mallocBlock)
                                 boost::ref(mallocBlock),
                                 _1));
 
+    if (binQueue_)
+    {
+        if (unalignedBin_)
+        {
+            // the aligned bins are done, the parts of the unaligned one have the threads to themselves
+            const std::size_t processedBins = bins_.size();
+            breakUpBin(*unalignedBin_, computeThreads_, unalignedBinParts_);
+            std::transform(unalignedBinParts_.begin(), unalignedBinParts_.end(), std::back_inserter(bins_),
+                           [](const alignment::BinMetadata &bm){return boost::cref(bm);});
+            stats_.resize(bins_.size());
+            unalignedBin_ = 0;
+
+            nextUnprocessedBinIt = nextUnallocatedBinIt = nextUnloadedBinIt = nextUncompressedBinIt = nextUnsavedBinIt =
+                bins_.begin() + processedBins;
+            threads_.execute(boost::bind(&Build::sortBinParallel, this,
+                                        boost::ref(nextUnprocessedBinIt),
+                                        boost::ref(nextUnallocatedBinIt),
+                                        boost::ref(nextUnloadedBinIt),
+                                        boost::ref(nextUncompressedBinIt),
+                                        boost::ref(nextUnsavedBinIt),
+                                        boost::ref(mallocBlock),
+                                        _1));
+        }
+        binQueue_->waitClosed();
+        openOutputFiles();
+    }
+
     unsigned fileIndex = 0;
     BOOST_FOREACH(const boost::filesystem::path &bamFilePath, barcodeBamMapping_.getPaths())
     {
@@ -499,6 +595,110 @@ void Build::run(common::ScopedMallocBlock &mallocBlock)
     }
 }
 
+/**
+ * \brief Creates the bam files once the tile list is final. Does nothing if the files are open already.
+ */
+void Build::openOutputFiles()
+{
+    if (bamFileStreams_.empty())
+    {
+        bamFileStreams_ = createOutputFileStreams(tileMetadataList_, barcodeMetadataList_, bamIndexes_);
+    }
+}
+
+void Build::terminateOnFailure(const bool exceptionUnwinding)
+{
+    if (exceptionUnwinding)
+    {
+        forceTermination_ = true;
+        stateChangedCondition_.notify_all();
+    }
+}
+
+/**
+ * \brief Bam headers need the final tile list. Saving can't start before alignment is done.
+ */
+void Build::waitAlignmentDone(boost::unique_lock<boost::mutex> &lock)
+{
+    if (binQueue_)
+    {
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::terminateOnFailure, this, _1))
+        {
+            {
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                binQueue_->waitClosed();
+            }
+            openOutputFiles();
+        }
+    }
+}
+
+void Build::returnBinQueue(const bool exceptionUnwinding)
+{
+    binQueueWaiting_ = false;
+    if (exceptionUnwinding)
+    {
+        forceTermination_ = true;
+    }
+    stateChangedCondition_.notify_all();
+}
+
+/**
+ * \brief One thread at a time takes the next bin from binQueue_. The others help with the compute tasks meanwhile.
+ *
+ * \return false if there are no more bins to process
+ */
+bool Build::waitForBin(
+    boost::unique_lock<boost::mutex> &lock,
+    const alignment::BinMetadataCRefList::const_iterator nextUnprocessedBinIt,
+    const std::size_t threadNumber)
+{
+    while (binQueue_ && bins_.end() == nextUnprocessedBinIt && !alignedBinsQueued_)
+    {
+        if (forceTermination_)
+        {
+            BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
+        }
+
+        if (binQueueWaiting_)
+        {
+            if (!preemptCompute(lock, threadNumber, 0))
+            {
+                stateChangedCondition_.wait(lock);
+            }
+            else
+            {
+                stateChangedCondition_.notify_all();
+            }
+            continue;
+        }
+
+        binQueueWaiting_ = true;
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::returnBinQueue, this, _1))
+        {
+            const alignment::BinMetadata *bin = 0;
+            {
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                bin = binQueue_->pop(boost::bind(&Build::estimateBinMemoryRequirements, this, _1));
+            }
+            if (!bin || bin->isUnalignedBin())
+            {
+                alignedBinsQueued_ = true;
+                if (bin && keepUnaligned_ && isBinSelected(*bin, binRegexString_))
+                {
+                    unalignedBin_ = bin;
+                }
+            }
+            else if (isBinSelected(*bin, binRegexString_))
+            {
+                ISAAC_ASSERT_MSG(bins_.capacity() > bins_.size(), "Bin list must not reallocate: " << *bin);
+                bins_.push_back(boost::cref(*bin));
+            }
+        }
+    }
+    return bins_.end() != nextUnprocessedBinIt;
+}
+
 void Build::dumpStats(const boost::filesystem::path &statsXmlPath)
 {
     BuildStatsXml statsXml(sortedReferenceMetadataList_, bins_, barcodeMetadataList_, stats_);
@@ -515,24 +715,38 @@ uint64_t Build::estimateOptimumFragmentsPerBin(
     const double expectedBgzfCompressionRatio,
     const unsigned computeThreads)
 {
-//    const size_t maxFragmentIndexBytes = std::max(sizeof(io::RStrandOrShadowFragmentIndex),
-//                                                         sizeof(io::FStrandFragmentIndex));
-
-    const std::size_t maxFragmentDedupedIndexBytes = sizeof(PackedFragmentBuffer::Index);
     const std::size_t maxFragmentCompressedBytes = estimatedFragmentSize * expectedBgzfCompressionRatio;
 
     const std::size_t fragmentMemoryRequirements =
-        // assume the initial indexes don't stay in memory for too long //maxFragmentIndexBytes              //index containing duplicates
-        + estimatedFragmentSize                 //data
-        + maxFragmentDedupedIndexBytes     //deduplicated index
-        + maxFragmentCompressedBytes       //bgzf chunk
+        + estimatedFragmentSize                             //data
+        + BinData::getFragmentIndexMemoryRequirements()     //same index reservation as BinData::getMemoryRequirements
+        + maxFragmentCompressedBytes                        //bgzf chunk
         ;
 
     // reasonable amount of bins-in-progress to allow for no-delay input/compute/output overlap
 //    const unsigned minOverlap = 3;;
     // try to increase granularity so that the CPU gets efficiently utilized.
     const unsigned minOverlap = computeThreads;
-    return availableMemory / fragmentMemoryRequirements / minOverlap;
+    // each bin in progress also holds its read-ahead buffer
+    const uint64_t binMemory =
+        std::max<uint64_t>(availableMemory / minOverlap, io::ReadAheadFileBuf::MEMORY_REQUIREMENTS) - io::ReadAheadFileBuf::MEMORY_REQUIREMENTS;
+    // CompactIndex addresses bin data with 32 bits. Leave half of that for bins that get more than the average coverage.
+    // Bins that still outgrow it fall back to PackedFragmentBuffer wide offsets.
+    const uint64_t maxFragmentsPerBin = PackedFragmentBuffer::CompactIndex::MAX_DATA_OFFSET / 2 / estimatedFragmentSize;
+    return std::min(maxFragmentsPerBin, binMemory / fragmentMemoryRequirements);
+}
+
+uint64_t Build::getBuffersMemoryRequirements(
+    const unsigned maxLoaders,
+    const unsigned maxComputers,
+    const unsigned maxSavers,
+    const unsigned outputFiles)
+{
+    const uint64_t encoders =
+        uint64_t(maxLoaders + maxComputers + maxSavers) * outputFiles * bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX;
+    const uint64_t blockPool = uint64_t(maxComputers) * BGZF_BLOCKS_PER_COMPUTER *
+        (bgzf::BgzfDeflater::UNCOMPRESSED_BLOCK_MAX + bgzf::BgzfDeflater::COMPRESSED_BLOCK_MAX);
+    return encoders + blockPool;
 }
 
 /**
@@ -549,24 +763,21 @@ void Build::reserveBuffers(
     boost::shared_ptr<BinData> &binDataPtr)
 {
     common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-    boost::ptr_vector<boost::iostreams::filtering_ostream> &bgzfStreams = threadBgzfStreams_.at(threadNumber);
     boost::ptr_vector<bam::BamIndexPart> &bamIndexParts = threadBamIndexParts_.at(threadNumber);
     const alignment::BinMetadata &bin = *thisThreadBinIt;
     // bin stats have an entry per filtered bin reference.
-    const unsigned binStatsIndex = std::distance(bins_.begin(), thisThreadBinIt);
+    const unsigned binStatsIndex = std::distance(bins_.cbegin(), thisThreadBinIt);
     common::ScopedMallocBlockUnblock unblockMalloc(mallocBlock);
     reserveBuffers(
-        bin, binStatsIndex, contigLists_.threadNodeContainer(), bgzfStreams, bamIndexParts,
+        bin, binStatsIndex, contigLists_.threadNodeContainer(), bamIndexParts,
         threadBgzfBuffers_.at(threadNumber), binDataPtr);
 }
 
 void Build::cleanupBinAllocationFailure(
     const alignment::BinMetadata& bin,
-    boost::ptr_vector<boost::iostreams::filtering_ostream>& bgzfStreams,
     boost::ptr_vector<bam::BamIndexPart>& bamIndexParts,
     boost::shared_ptr<BinData>& binDataPtr, BgzfBuffers& bgzfBuffers)
 {
-    bgzfStreams.clear();
     bamIndexParts.clear();
     // give a chance other threads to allocate what they need... TODO: this is not required anymore as allocation happens orderly
     binDataPtr.reset();
@@ -587,7 +798,6 @@ void Build::reserveBuffers(
     const alignment::BinMetadata &bin,
     const unsigned binStatsIndex,
     const reference::ContigLists &contigLists,
-    boost::ptr_vector<boost::iostreams::filtering_ostream> &bgzfStreams,
     boost::ptr_vector<bam::BamIndexPart> &bamIndexParts,
     BgzfBuffers &bgzfBuffers,
     boost::shared_ptr<BinData> &binDataPtr)
@@ -597,8 +807,12 @@ void Build::reserveBuffers(
         binDataPtr = boost::shared_ptr<BinData>(
             new BinData(realignedGapsPerFragment_,
                         barcodeBamMapping_, barcodeMetadataList_,
-                        realignGaps_, knownIndels_, bin, binStatsIndex, tileMetadataList_, contigMap_, contigLists, maxReadLength_,
-                        forcedDodgyAlignmentScore_,  flowcellLayoutList_, includeTags_, pessimisticMapQ_, splitGapLength_));
+                        realignGaps_, knownIndels_, bin, binStatsIndex,
+                        // the tile list keeps growing while alignment runs
+                        binQueue_ ? binQueue_->getTiles(bin) : tileMetadataList_,
+                        contigMap_, contigLists, maxReadLength_,
+                        forcedDodgyAlignmentScore_,  flowcellLayoutList_, includeTags_, pessimisticMapQ_, splitGapLength_,
+                        asyncIo_));
 
         unsigned outputFileIndex = 0;
         for(bam::BgzfBuffer &bgzfBuffer : bgzfBuffers)
@@ -606,26 +820,15 @@ void Build::reserveBuffers(
             bgzfBuffer.reserve(estimateBinCompressedDataRequirements(bin, outputFileIndex++));
         }
 
-        ISAAC_ASSERT_MSG(!bgzfStreams.size(), "Expecting empty pool of streams");
-        while(bgzfStreams.size() < bamFileStreams_.size())
-        {
-            bgzfStreams.push_back(new boost::iostreams::filtering_ostream);
-            bgzfStreams.back().push(bgzf::BgzfCompressor(bamGzipLevel_));
-            bgzfStreams.back().push(
-                boost::iostreams::back_insert_device<bam::BgzfBuffer >(
-                    bgzfBuffers.at(bgzfStreams.size()-1)));
-            bgzfStreams.back().exceptions(std::ios_base::badbit);
-        }
-
         ISAAC_ASSERT_MSG(!bamIndexParts.size(), "Expecting empty pool of bam index parts");
-        while(bamIndexParts.size() < bamFileStreams_.size())
+        while(bamIndexParts.size() < barcodeBamMapping_.getTotalSamples())
         {
             bamIndexParts.push_back(new bam::BamIndexPart);
         }
     }
     catch (...)
     {
-        cleanupBinAllocationFailure(bin, bgzfStreams, bamIndexParts, binDataPtr, bgzfBuffers);
+        cleanupBinAllocationFailure(bin, bamIndexParts, binDataPtr, bgzfBuffers);
         throw;
     }
 }
@@ -708,6 +911,19 @@ boost::shared_ptr<BinData> Build::allocateBin(
         stateChangedCondition_.wait(lock);
     }
 
+    if (binQueue_)
+    {
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::terminateOnFailure, this, _1))
+        {
+            const uint64_t binMemory = estimateBinMemoryRequirements(*thisThreadBinIt);
+            {
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                binQueue_->reserveBinMemory(binMemory);
+            }
+            threadReservedMemory_.at(threadNumber) = binMemory;
+        }
+    }
+
     while(true)
     {
         try
@@ -717,13 +933,8 @@ boost::shared_ptr<BinData> Build::allocateBin(
         }
         catch (std::bad_alloc &a)
         {
-            uint64_t totalBuffersNeeded = 0UL;
-            for(unsigned outputFileIndex = 0; outputFileIndex < threadBgzfStreams_.at(threadNumber).size(); ++outputFileIndex)
-            {
-                totalBuffersNeeded += estimateBinCompressedDataRequirements(*thisThreadBinIt, outputFileIndex++);
-            }
             warningTraced = handleBinAllocationFailure(
-                warningTraced, thisThreadBinIt, a, BinData::getMemoryRequirements(*thisThreadBinIt) + totalBuffersNeeded);
+                warningTraced, thisThreadBinIt, a, estimateBinMemoryRequirements(*thisThreadBinIt));
         }
         catch (boost::iostreams::zlib_error &z)
         {
@@ -947,6 +1158,38 @@ void Build::preemptComputeSlot(
     }
 }
 
+/**
+ * \brief Each block is taken by the next thread that gets into the task. Idle compute threads join until
+ *        there are no blocks left. The slot of the caller is lent to the task for the duration, otherwise
+ *        threads running resolveDuplicates on every slot would wait for each other forever.
+ */
+void Build::ComputeSlotFor::run(const std::size_t count, const std::size_t blockSize, Executor &executor)
+{
+    if (!count)
+    {
+        return;
+    }
+    boost::lock_guard<boost::unique_lock<boost::mutex> > relock(lock_);
+    build_.returnComputeSlot(false);
+    std::size_t nextBlockBegin = 0;
+    build_.preemptComputeSlot(
+        lock_, (count + blockSize - 1) / blockSize, priority_,
+        [count, blockSize, &executor, &nextBlockBegin](boost::unique_lock<boost::mutex> &l, const unsigned tn)
+        {
+            while (count != nextBlockBegin)
+            {
+                const std::size_t begin = nextBlockBegin;
+                const std::size_t end = std::min(count, begin + blockSize);
+                nextBlockBegin = end;
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(l);
+                executor.execute(begin, end);
+            }
+        },
+        threadNumber_);
+    // the caller gives the slot back on return
+    build_.waitForComputeSlot(lock_);
+}
+
 void Build::returnComputeSlot(const bool exceptionUnwinding)
 {
     ++maxComputers_;
@@ -957,6 +1200,47 @@ void Build::returnComputeSlot(const bool exceptionUnwinding)
     stateChangedCondition_.notify_all();
 }
 
+/**
+ * \brief Takes the compute slot given back with returnComputeSlot. Since the slot is not released for good,
+ *        forceTermination_ is not checked. The threads that hold slots give them back when terminating.
+ */
+void Build::waitForComputeSlot(boost::unique_lock<boost::mutex> &lock)
+{
+    while (!maxComputers_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    --maxComputers_;
+}
+
+/**
+ * \brief Helps the serializing thread by compressing its blocks. The compute slot is given back while
+ *        there is nothing to compress, so that waiting for the serializing thread to fill more blocks does not
+ *        keep other bins from getting computed.
+ */
+void Build::compressBgzfBlocks(
+    boost::unique_lock<boost::mutex> &lock,
+    const bool &serialized,
+    const unsigned threadNumber)
+{
+    bgzf::BgzfDeflater &deflater = threadDeflaters_.at(threadNumber);
+    bool moreBlocks = true;
+    while (moreBlocks)
+    {
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            bgzfBlockPool_.compress(deflater);
+        }
+        returnComputeSlot(false);
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            moreBlocks = bgzfBlockPool_.waitForBlocks(serialized);
+        }
+        // the caller gives the slot back on return
+        waitForComputeSlot(lock);
+    }
+}
+
 void Build::waitForSaveSlot(
     boost::unique_lock<boost::mutex> &lock,
     const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
@@ -993,7 +1277,7 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::const_iterator &next
                             const std::size_t threadNumber)
 {
     boost::unique_lock<boost::mutex> lock(stateMutex_);
-    while(bins_.end() != nextUnprocessedBinIt)
+    while(waitForBin(lock, nextUnprocessedBinIt, threadNumber))
     {
         alignment::BinMetadataCRefList::const_iterator thisThreadBinIt = nextUnprocessedBinIt++;
 
@@ -1005,18 +1289,21 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::const_iterator &next
         {
             {
                 common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                common::StageTimer timer(common::STAGE_BIN_LOAD);
                 BinLoader binLoader;
                 binLoader.loadData(*binDataPtr);
             }
         }
 
         {
+            const std::size_t priority = std::distance(bins_.cbegin(), thisThreadBinIt);
             preemptComputeSlot(
-                lock, 1, std::distance(bins_.begin(), thisThreadBinIt),
-                [this, &binDataPtr](boost::unique_lock<boost::mutex> &l, const unsigned tn)
+                lock, 1, priority,
+                [this, &binDataPtr, priority](boost::unique_lock<boost::mutex> &l, const unsigned tn)
                 {
                     common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(l);
-                    binSorter_.resolveDuplicates(*binDataPtr, stats_);
+                    ComputeSlotFor computeSlotFor(*this, l, priority, tn);
+                    binSorter_.resolveDuplicates(*binDataPtr, stats_, computeSlotFor);
                 },
                 threadNumber);
 
@@ -1025,7 +1312,7 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::const_iterator &next
                 BinData::iterator nextUnprocessed = binDataPtr->indexBegin();
                 int threadsIn = 0;
                 preemptComputeSlot(
-                    lock, -1, std::distance(bins_.begin(), thisThreadBinIt),
+                    lock, -1, std::distance(bins_.cbegin(), thisThreadBinIt),
                     [this, &threadsIn, &binDataPtr, &nextUnprocessed](boost::unique_lock<boost::mutex> &l, const unsigned tn)
                     {
                         ++threadsIn;
@@ -1044,15 +1331,38 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::const_iterator &next
 
             }
 
+            // First thread in serializes the bin, the rest compress its blocks. Compressing is what takes time,
+            // so large bins don't keep all but one thread waiting.
+            bool serializing = false;
+            bool serialized = false;
             preemptComputeSlot(
-                lock, 1, std::distance(bins_.begin(), thisThreadBinIt),
-                [this, &binDataPtr, threadNumber](boost::unique_lock<boost::mutex> &l, const unsigned tn)
+                lock, -1, std::distance(bins_.cbegin(), thisThreadBinIt),
+                [this, &binDataPtr, &serializing, &serialized, threadNumber](boost::unique_lock<boost::mutex> &l, const unsigned tn)
                 {
+                    if (serializing)
+                    {
+                        compressBgzfBlocks(l, serialized, tn);
+                        return;
+                    }
+                    serializing = true;
                     common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(l);
-                    // Don't use tn!!! the streams have been allocated for the threadNumber.
-                    binSorter_.serialize(
-                        *binDataPtr, threadBgzfStreams_.at(threadNumber), threadBamIndexParts_.at(threadNumber));
-                    threadBgzfStreams_.at(threadNumber).clear();
+                    try
+                    {
+                        // Don't use tn for anything other than the deflater!!! the buffers have been allocated for the threadNumber.
+                        boost::ptr_vector<bam::BamEncoder> &bamEncoders = threadBamEncoders_.at(threadNumber);
+                        for (std::size_t outputFileIndex = 0; outputFileIndex < bamEncoders.size(); ++outputFileIndex)
+                        {
+                            bamEncoders.at(outputFileIndex).open(
+                                threadBgzfBuffers_.at(threadNumber).at(outputFileIndex), threadDeflaters_.at(tn));
+                        }
+                        binSorter_.serialize(*binDataPtr, bamEncoders, threadBamIndexParts_.at(threadNumber));
+                    }
+                    catch (...)
+                    {
+                        bgzfBlockPool_.stop(serialized);
+                        throw;
+                    }
+                    bgzfBlockPool_.stop(serialized);
                 },
                 threadNumber);
         }
@@ -1064,6 +1374,7 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::const_iterator &next
         waitForSaveSlot(lock, thisThreadBinIt, nextUnsavedBinIt);
         ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::returnSaveSlot, this, boost::ref(nextUnsavedBinIt), _1))
         {
+            waitAlignmentDone(lock);
             saveAndReleaseBuffers(lock, thisThreadBinIt->get().getPath(), threadNumber);
         }
     }
@@ -1112,6 +1423,11 @@ void Build::saveAndReleaseBuffers(
     }
     --allocatedBins_;
     threadBamIndexParts_.at(threadNumber).clear();
+    if (binQueue_)
+    {
+        binQueue_->releaseMemory(threadReservedMemory_.at(threadNumber));
+        threadReservedMemory_.at(threadNumber) = 0;
+    }
 }
 
 void Build::saveBuffer(
@@ -20,6 +20,7 @@
 #include <boost/foreach.hpp>
 
 #include "build/ParallelGapRealigner.hh"
+#include "common/StageCounters.hh"
 
 namespace isaac
 {
@@ -28,9 +29,11 @@ namespace build
 
 void ParallelGapRealigner::realign(
     isaac::build::GapRealigner& realigner,
-    io::FragmentAccessor& fragment, PackedFragmentBuffer::Index &index,
+    io::FragmentAccessor& fragment, PackedFragmentBuffer::CompactIndex &compactIndex,
     BinData& binData, isaac::alignment::Cigar& cigars)
 {
+    // nothing has been stored in additionalCigars_ for this fragment yet, so no need to lock
+    PackedFragmentBuffer::Index index = binData.data_.getIndex(compactIndex, binData.additionalCigars_);
     if (realigner.realign(
         binData.getRealignerGaps(fragment.barcode_), binData.bin_.getBinStart(), binData.bin_.getBinEnd(),
         index, fragment,
@@ -39,15 +42,17 @@ void ParallelGapRealigner::realign(
     {
         boost::unique_lock<boost::mutex> lock(cigarBufferMutex_);
         {
-            const std::size_t before = binData.additionalCigars_.size();
-            binData.additionalCigars_.addOperations(index.cigarBegin_, index.cigarEnd_);
-            index.cigarBegin_ = &binData.additionalCigars_.at(before);
-            index.cigarEnd_ = &binData.additionalCigars_.back() + 1;
+            PackedFragmentBuffer::storeCigar(index, binData.additionalCigars_);
+            compactIndex = binData.data_.getCompactIndex(index, binData.additionalCigars_);
             // realignment affects both reads. We must make sure realignment updates on one read don't
             // collide with post-realignmnet pair updates from another read.
             realigner.updatePairDetails(barcodeTemplateLengthStatistics_, index, fragment, binData.data_);
         }
     }
+    else
+    {
+        compactIndex.pos_ = index.pos_;
+    }
 }
 
 void ParallelGapRealigner::threadRealignGaps(boost::unique_lock<boost::mutex> &lock, BinData &binData, BinData::iterator &nextUnprocessed, uint64_t threadNumber)
@@ -66,9 +71,10 @@ void ParallelGapRealigner::threadRealignGaps(boost::unique_lock<boost::mutex> &l
         nextUnprocessed += readsToProcess;
         {
             common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            common::StageTimer timer(common::STAGE_REALIGNMENT);
             for (const BinData::iterator ourEnd = ourBegin + readsToProcess; ourEnd != ourBegin; ++ourBegin)
             {
-                PackedFragmentBuffer::Index &index = *ourBegin;
+                PackedFragmentBuffer::CompactIndex &index = *ourBegin;
                 io::FragmentAccessor &fragment = binData.data_.getFragment(index);
                 if (binData.bin_.hasPosition(fragment.fStrandPosition_))
                 {
@@ -0,0 +1,247 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testBinQueue.cpp
+ **
+ ** Test cases for BinQueue.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <vector>
+
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include "build/BinQueue.hh"
+#include "common/Threads.hpp"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testBinQueue.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBinQueue, registryName("TestBinQueue"));
+
+static const unsigned ALIGNED_BINS = 4;
+static const unsigned BIN_LENGTH = 1000;
+
+TestBinQueue::TestBinQueue()
+{
+}
+
+void TestBinQueue::setUp()
+{
+    // unaligned bin 0 followed by the aligned ones
+    bins_.clear();
+    bins_.push_back(alignment::BinMetadata(
+        1, 0, reference::ReferencePosition(reference::ReferencePosition::TooManyMatch), BIN_LENGTH, "bin-0.dat", 0));
+    for (unsigned i = 1; ALIGNED_BINS >= i; ++i)
+    {
+        bins_.push_back(alignment::BinMetadata(
+            1, i, reference::ReferencePosition(0, (i - 1) * BIN_LENGTH), BIN_LENGTH,
+            (boost::format("bin-%d.dat") % i).str(), 0));
+    }
+}
+
+void TestBinQueue::tearDown()
+{
+}
+
+static uint64_t noMemory(const alignment::BinMetadata &)
+{
+    return 0;
+}
+
+static flowcell::TileMetadataList makeTiles(const unsigned count)
+{
+    flowcell::TileMetadataList ret;
+    for (unsigned i = 0; count != i; ++i)
+    {
+        ret.push_back(flowcell::TileMetadata("FC", 0, 1101 + i, 1, 1000, i));
+    }
+    return ret;
+}
+
+/**
+ * \brief Runs pop on a separate thread so that the test can see it block
+ */
+class Popper
+{
+    build::BinQueue &binQueue_;
+    const boost::function<uint64_t(const alignment::BinMetadata &)> getBinMemory_;
+    boost::mutex mutex_;
+    bool done_;
+    bool failed_;
+    const alignment::BinMetadata *bin_;
+    boost::thread thread_;
+
+    void run()
+    {
+        const alignment::BinMetadata *bin = 0;
+        bool failed = false;
+        try
+        {
+            bin = binQueue_.pop(getBinMemory_);
+        }
+        catch (common::ThreadingException &)
+        {
+            failed = true;
+        }
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        bin_ = bin;
+        failed_ = failed;
+        done_ = true;
+    }
+
+public:
+    Popper(
+        build::BinQueue &binQueue,
+        const boost::function<uint64_t(const alignment::BinMetadata &)> &getBinMemory = &noMemory) :
+            binQueue_(binQueue), getBinMemory_(getBinMemory), done_(false), failed_(false), bin_(0),
+            thread_(boost::bind(&Popper::run, this))
+    {
+    }
+
+    ~Popper()
+    {
+        thread_.join();
+    }
+
+    /// \return true if pop is still blocked after giving it some time
+    bool blocked()
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        return !done_;
+    }
+
+    const alignment::BinMetadata *join()
+    {
+        thread_.join();
+        CPPUNIT_ASSERT(done_);
+        return bin_;
+    }
+
+    bool failed()
+    {
+        thread_.join();
+        return failed_;
+    }
+};
+
+void TestBinQueue::testOutOfOrderSealing()
+{
+    build::BinQueue binQueue(0);
+    binQueue.open(bins_);
+    const flowcell::TileMetadataList tiles1 = makeTiles(1);
+    const flowcell::TileMetadataList tiles2 = makeTiles(2);
+
+    // bins of the last lane done are taken before the ones with lower indexes
+    binQueue.seal({3, 4}, tiles1);
+    CPPUNIT_ASSERT_EQUAL(3U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT_EQUAL(4U, binQueue.pop(&noMemory)->getIndex());
+
+    // the unaligned bin waits for all aligned bins to be taken
+    binQueue.seal({0}, tiles2);
+    {
+        Popper popper(binQueue);
+        CPPUNIT_ASSERT(popper.blocked());
+        binQueue.seal({2, 1}, tiles2);
+        CPPUNIT_ASSERT_EQUAL(1U, popper.join()->getIndex());
+    }
+    CPPUNIT_ASSERT_EQUAL(2U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT_EQUAL(0U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT(!binQueue.pop(&noMemory));
+
+    // the bins keep the tiles they were sealed with
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), binQueue.getTiles(bins_.at(3)).size());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), binQueue.getTiles(bins_.at(1)).size());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), binQueue.getTiles(bins_.at(0)).size());
+}
+
+static uint64_t getBinMemory(const alignment::BinMetadata &bin)
+{
+    static const uint64_t binMemory[] = {10, 50, 10, 30, 10};
+    return binMemory[bin.getIndex()];
+}
+
+void TestBinQueue::testBudget()
+{
+    build::BinQueue binQueue(100);
+    binQueue.open(bins_);
+    binQueue.reserveAlignmentMemory(60);
+    const flowcell::TileMetadataList tiles = makeTiles(1);
+    binQueue.seal({1, 2}, tiles);
+    binQueue.seal({3}, tiles);
+
+    // bin 1 does not fit and bin 2 has to wait for it. Bin 3 fits.
+    CPPUNIT_ASSERT_EQUAL(3U, binQueue.pop(&getBinMemory)->getIndex());
+    binQueue.reserveBinMemory(getBinMemory(bins_.at(3)));
+
+    {
+        Popper popper(binQueue, &getBinMemory);
+        CPPUNIT_ASSERT(popper.blocked());
+        // alignment is done with its memory
+        binQueue.releaseMemory(60);
+        CPPUNIT_ASSERT_EQUAL(1U, popper.join()->getIndex());
+    }
+    binQueue.reserveBinMemory(getBinMemory(bins_.at(1)));
+
+    // a bin too big for the budget goes when nothing else is reserved
+    build::BinQueue smallQueue(20);
+    smallQueue.open(bins_);
+    smallQueue.seal({1}, tiles);
+    CPPUNIT_ASSERT_EQUAL(1U, smallQueue.pop(&getBinMemory)->getIndex());
+    smallQueue.reserveBinMemory(getBinMemory(bins_.at(1)));
+    smallQueue.seal({2}, tiles);
+    {
+        Popper popper(smallQueue, &getBinMemory);
+        CPPUNIT_ASSERT(popper.blocked());
+        smallQueue.releaseMemory(getBinMemory(bins_.at(1)));
+        CPPUNIT_ASSERT_EQUAL(2U, popper.join()->getIndex());
+    }
+}
+
+void TestBinQueue::testClose()
+{
+    build::BinQueue binQueue(0);
+    binQueue.open(bins_);
+    binQueue.seal({2}, makeTiles(1));
+    CPPUNIT_ASSERT_EQUAL(2U, binQueue.pop(&noMemory)->getIndex());
+
+    // close seals whatever is left with the final tiles, in the order of bin indexes
+    binQueue.close(makeTiles(3));
+    binQueue.waitClosed();
+    CPPUNIT_ASSERT_EQUAL(1U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT_EQUAL(3U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT_EQUAL(4U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT_EQUAL(0U, binQueue.pop(&noMemory)->getIndex());
+    CPPUNIT_ASSERT(!binQueue.pop(&noMemory));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), binQueue.getTiles(bins_.at(2)).size());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(3), binQueue.getTiles(bins_.at(4)).size());
+}
+
+void TestBinQueue::testTerminate()
+{
+    build::BinQueue binQueue(0);
+    {
+        // Build waiting for the bins when alignment fails
+        Popper popper(binQueue);
+        CPPUNIT_ASSERT(popper.blocked());
+        binQueue.terminate();
+        CPPUNIT_ASSERT(popper.failed());
+    }
+    CPPUNIT_ASSERT_THROW(binQueue.waitOpen(), common::ThreadingException);
+    CPPUNIT_ASSERT_THROW(binQueue.waitClosed(), common::ThreadingException);
+}
@@ -0,0 +1,43 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BUILD_TEST_BIN_QUEUE_HH
+#define iSAAC_BUILD_TEST_BIN_QUEUE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "alignment/BinMetadata.hh"
+
+class TestBinQueue : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBinQueue );
+    CPPUNIT_TEST( testOutOfOrderSealing );
+    CPPUNIT_TEST( testBudget );
+    CPPUNIT_TEST( testClose );
+    CPPUNIT_TEST( testTerminate );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    isaac::alignment::BinMetadataList bins_;
+
+public:
+    TestBinQueue();
+    void setUp();
+    void tearDown();
+
+    void testOutOfOrderSealing();
+    void testBudget();
+    void testClose();
+    void testTerminate();
+};
+
+#endif // #ifndef iSAAC_BUILD_TEST_BIN_QUEUE_HH
@@ -22,6 +22,7 @@
 
 #include "build/DuplicatePairEndFilter.hh"
 #include "build/DuplicateFragmentIndexFiltering.hh"
+#include "build/HashDuplicatePairEndFilter.hh"
 
 using namespace std;
 using namespace isaac::io;
@@ -86,15 +87,41 @@ void testNoDifferences(std::vector<IndexT> bin, std::vector<IndexT>  expectedUni
 
     isaac::flowcell::BarcodeMetadataList barcodeMetadataList(1);
     BuildStats fakeBuildStats(binMetadataCRefList, barcodeMetadataList);
-    std::vector<PackedFragmentBuffer::Index> filteredIndex;
+    std::vector<IndexT> radixBin(bin);
+    std::vector<IndexT> hashBin(bin);
+    std::vector<PackedFragmentBuffer::CompactIndex> filteredIndex;
     filter.filterInput(
         TestDuplicateFilter<IndexT>(), fakeEmptyFragmentBuffer, bin.begin(), bin.end(), fakeBuildStats, 0, std::back_inserter(filteredIndex));
 
+    // ranking by radix sort must select the same fragments
+    isaac::common::RadixSortRecords sortRecords;
+    sortRecords.reserve(radixBin.size() * 2);
+    std::vector<PackedFragmentBuffer::CompactIndex> radixFilteredIndex;
+    DuplicatePairEndFilter(false, sortRecords).filterInput(
+        TestDuplicateFilter<IndexT>(), fakeEmptyFragmentBuffer, radixBin.begin(), radixBin.end(), fakeBuildStats, 0, std::back_inserter(radixFilteredIndex));
+    CPPUNIT_ASSERT_EQUAL(filteredIndex.size(), radixFilteredIndex.size());
+    for (std::size_t i = 0; filteredIndex.size() != i; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL(filteredIndex[i].dataOffset_, radixFilteredIndex[i].dataOffset_);
+    }
+
     std::vector<uint64_t> uniqueFragments;
     std::transform(filteredIndex.begin(), filteredIndex.end(), std::back_inserter(uniqueFragments),
-                   boost::bind(&PackedFragmentBuffer::Index::dataOffset_, _1));
+                   boost::bind(&PackedFragmentBuffer::CompactIndex::dataOffset_, _1));
     std::sort(uniqueFragments.begin(), uniqueFragments.end());
 
+    // grouping by hash must select the same fragments. The order is different
+    std::vector<PackedFragmentBuffer::CompactIndex> hashFilteredIndex;
+    isaac::common::SequentialFor sequentialFor;
+    CPPUNIT_ASSERT(HashDuplicatePairEndFilter(false, sortRecords).filterInput(
+        TestDuplicateFilter<IndexT>(), fakeEmptyFragmentBuffer, hashBin.begin(), hashBin.end(), fakeBuildStats, 0,
+        std::back_inserter(hashFilteredIndex), sequentialFor));
+    std::vector<uint64_t> hashUniqueFragments;
+    std::transform(hashFilteredIndex.begin(), hashFilteredIndex.end(), std::back_inserter(hashUniqueFragments),
+                   boost::bind(&PackedFragmentBuffer::CompactIndex::dataOffset_, _1));
+    std::sort(hashUniqueFragments.begin(), hashUniqueFragments.end());
+    CPPUNIT_ASSERT(uniqueFragments == hashUniqueFragments);
+
     std::vector<uint64_t> expectedUniqueFragments;
     std::transform(expectedUnique.begin(), expectedUnique.end(), std::back_inserter(expectedUniqueFragments),
                    boost::bind(&IndexType::dataOffset_, _1));
@@ -0,0 +1,282 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testPackedFragmentBuffer.cpp
+ **
+ ** Test cases for the PackedFragmentBuffer index conversions.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstring>
+#include <vector>
+
+#include "alignment/Cigar.hh"
+#include "build/FragmentIndex.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testPackedFragmentBuffer.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestPackedFragmentBuffer, registryName("TestPackedFragmentBuffer"));
+
+static const unsigned READ_LENGTH = 10;
+static const uint64_t BIN_LENGTH = 1000;
+
+TestPackedFragmentBuffer::TestPackedFragmentBuffer()
+{
+}
+
+void TestPackedFragmentBuffer::setUp()
+{
+    bin_ = alignment::BinMetadata(1, 1, reference::ReferencePosition(0, 0), BIN_LENGTH, "bin-1.dat", 0);
+    bin_.incrementFIdxElements(reference::ReferencePosition(0, 0), 1, 0);
+    bin_.incrementRIdxElements(reference::ReferencePosition(0, 0), 1, 0);
+    bin_.incrementSeIdxElements(reference::ReferencePosition(0, 0), 1, 0);
+    data_.unreserve();
+    offsets_.clear();
+}
+
+void TestPackedFragmentBuffer::tearDown()
+{
+}
+
+static void appendFragment(
+    std::vector<char> &buffer,
+    const reference::ReferencePosition pos,
+    const bool reverse,
+    const alignment::Cigar &cigar)
+{
+    io::FragmentHeader header;
+    header.fStrandPosition_ = pos;
+    header.readLength_ = READ_LENGTH;
+    header.cigarLength_ = cigar.size();
+    header.flags_.reverse_ = reverse;
+
+    const std::size_t offset = buffer.size();
+    buffer.resize(offset + header.getTotalLength(), 0);
+    std::memcpy(&buffer.at(offset), &header, sizeof(header));
+    std::memcpy(&buffer.at(offset + sizeof(header) + READ_LENGTH), &cigar.front(), cigar.size() * sizeof(cigar.front()));
+}
+
+static alignment::Cigar makeCigar(const unsigned softClip)
+{
+    alignment::Cigar ret;
+    if (softClip)
+    {
+        ret.addOperation(softClip, alignment::Cigar::SOFT_CLIP);
+    }
+    ret.addOperation(READ_LENGTH - softClip, alignment::Cigar::ALIGN);
+    return ret;
+}
+
+/**
+ * \brief Fills data_ with a pair and a single-ended fragment
+ */
+void TestPackedFragmentBuffer::load()
+{
+    std::vector<char> fragments;
+    offsets_.push_back(fragments.size());
+    appendFragment(fragments, reference::ReferencePosition(0, 100), false, makeCigar(0));
+    offsets_.push_back(fragments.size());
+    appendFragment(fragments, reference::ReferencePosition(0, 300), true, makeCigar(2));
+    offsets_.push_back(fragments.size());
+    appendFragment(fragments, reference::ReferencePosition(0, 500), false, makeCigar(0));
+
+    data_.resize(fragments.size());
+    std::copy(fragments.begin(), fragments.end(), data_.begin());
+}
+
+/**
+ * \brief Does what BinLoader and duplicate filtering do for the fragment at offset
+ */
+build::PackedFragmentBuffer::CompactIndex TestPackedFragmentBuffer::loadCompactIndex(
+    const uint64_t offset, const uint64_t mateOffset)
+{
+    data_.storeMateDataOffset(offset, mateOffset);
+    const io::FragmentAccessor &fragment = data_.getFragment(offset);
+    if (offset == mateOffset)
+    {
+        build::SeFragmentIndex idx(fragment.fStrandPosition_);
+        idx.dataOffset_ = offset;
+        idx.mateDataOffset_ = mateOffset;
+        return data_.getCompactIndex(idx, fragment);
+    }
+    build::FStrandFragmentIndex idx(
+        fragment.fStrandPosition_, build::FragmentIndexMate(false, false, 1, io::FragmentIndexAnchor()), 0);
+    idx.dataOffset_ = offset;
+    idx.mateDataOffset_ = mateOffset;
+    return data_.getCompactIndex(idx, fragment);
+}
+
+static void checkRoundTrip(
+    const build::PackedFragmentBuffer &data,
+    const build::PackedFragmentBuffer::CompactIndex &compactIndex,
+    const alignment::Cigar &cigars)
+{
+    const build::PackedFragmentBuffer::CompactIndex back = data.getCompactIndex(data.getIndex(compactIndex, cigars), cigars);
+    CPPUNIT_ASSERT_EQUAL(compactIndex.pos_, back.pos_);
+    CPPUNIT_ASSERT_EQUAL(compactIndex.dataOffset_, back.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(unsigned(compactIndex.cigarOffset_), unsigned(back.cigarOffset_));
+    CPPUNIT_ASSERT_EQUAL(unsigned(compactIndex.reverse_), unsigned(back.reverse_));
+}
+
+static void checkIndex(
+    const build::PackedFragmentBuffer &data,
+    const build::PackedFragmentBuffer::CompactIndex &compactIndex,
+    const alignment::Cigar &cigars,
+    const uint64_t expectedOffset,
+    const uint64_t expectedMateOffset)
+{
+    const build::PackedFragmentBuffer::Index index = data.getIndex(compactIndex, cigars);
+    const io::FragmentAccessor &fragment = data.getFragment(expectedOffset);
+    CPPUNIT_ASSERT_EQUAL(fragment.fStrandPosition_, index.pos_);
+    CPPUNIT_ASSERT_EQUAL(expectedOffset, index.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(expectedMateOffset, index.mateDataOffset_);
+    CPPUNIT_ASSERT_EQUAL(expectedOffset != expectedMateOffset, index.hasMate());
+    CPPUNIT_ASSERT_EQUAL(fragment.isReverse(), index.reverse_);
+    CPPUNIT_ASSERT(fragment.cigarBegin() == index.cigarBegin_);
+    CPPUNIT_ASSERT(fragment.cigarEnd() == index.cigarEnd_);
+    checkRoundTrip(data, compactIndex, cigars);
+}
+
+void TestPackedFragmentBuffer::testIndex()
+{
+    // the mate offset must not be replaced with the data offset
+    const alignment::Cigar cigar = makeCigar(0);
+    const build::PackedFragmentBuffer::Index index(
+        reference::ReferencePosition(0, 100), 10, 20, &cigar.front(), &cigar.back() + 1, false);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(10), index.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(20), index.mateDataOffset_);
+    CPPUNIT_ASSERT(index.hasMate());
+}
+
+void TestPackedFragmentBuffer::testNormalBin()
+{
+    load();
+    data_.reserveWideOffsets(bin_);
+    CPPUNIT_ASSERT(!data_.hasWideOffsets());
+
+    const alignment::Cigar noCigars;
+    const build::PackedFragmentBuffer::CompactIndex first = loadCompactIndex(offsets_[0], offsets_[1]);
+    const build::PackedFragmentBuffer::CompactIndex second = loadCompactIndex(offsets_[1], offsets_[0]);
+    const build::PackedFragmentBuffer::CompactIndex single = loadCompactIndex(offsets_[2], offsets_[2]);
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(offsets_[1]), second.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(unsigned(build::PackedFragmentBuffer::CompactIndex::FRAGMENT_CIGAR), unsigned(second.cigarOffset_));
+
+    checkIndex(data_, first, noCigars, offsets_[0], offsets_[1]);
+    checkIndex(data_, second, noCigars, offsets_[1], offsets_[0]);
+    checkIndex(data_, single, noCigars, offsets_[2], offsets_[2]);
+}
+
+void TestPackedFragmentBuffer::testWideOffsets()
+{
+    load();
+    // pretend the fragments are at the beginning of a bin that does not fit 32 bit offsets
+    bin_.incrementDataSize(reference::ReferencePosition(0, 0), build::PackedFragmentBuffer::CompactIndex::MAX_DATA_OFFSET + 1);
+    data_.reserveWideOffsets(bin_);
+    CPPUNIT_ASSERT(data_.hasWideOffsets());
+
+    const alignment::Cigar noCigars;
+    // the order in which BinLoader gets to the fragments determines the slots
+    const build::PackedFragmentBuffer::CompactIndex single = loadCompactIndex(offsets_[2], offsets_[2]);
+    const build::PackedFragmentBuffer::CompactIndex second = loadCompactIndex(offsets_[1], offsets_[0]);
+    const build::PackedFragmentBuffer::CompactIndex first = loadCompactIndex(offsets_[0], offsets_[1]);
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(0), single.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), second.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(2), first.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(offsets_[1], data_.getDataOffset(second));
+
+    checkIndex(data_, first, noCigars, offsets_[0], offsets_[1]);
+    checkIndex(data_, second, noCigars, offsets_[1], offsets_[0]);
+    checkIndex(data_, single, noCigars, offsets_[2], offsets_[2]);
+}
+
+void TestPackedFragmentBuffer::testRealignedCigar()
+{
+    load();
+    data_.reserveWideOffsets(bin_);
+    alignment::Cigar cigars;
+    cigars.reserve(1024);
+    // something stored before, so that the offset is not 0
+    cigars.push_back(0);
+
+    build::PackedFragmentBuffer::Index index = data_.getIndex(loadCompactIndex(offsets_[0], offsets_[1]), cigars);
+    const alignment::Cigar realigned = makeCigar(3);
+    index.pos_ += 3;
+    index.cigarBegin_ = &realigned.front();
+    index.cigarEnd_ = &realigned.back() + 1;
+    build::PackedFragmentBuffer::storeCigar(index, cigars);
+
+    const build::PackedFragmentBuffer::CompactIndex compactIndex = data_.getCompactIndex(index, cigars);
+    CPPUNIT_ASSERT_EQUAL(1U, unsigned(compactIndex.cigarOffset_));
+    CPPUNIT_ASSERT_EQUAL(index.pos_, compactIndex.pos_);
+
+    const build::PackedFragmentBuffer::Index back = data_.getIndex(compactIndex, cigars);
+    CPPUNIT_ASSERT_EQUAL(index.pos_, back.pos_);
+    CPPUNIT_ASSERT_EQUAL(offsets_[0], back.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(offsets_[1], back.mateDataOffset_);
+    CPPUNIT_ASSERT_EQUAL(alignment::Cigar::toString(realigned.begin(), realigned.end()),
+                         alignment::Cigar::toString(back.cigarBegin_, back.cigarEnd_));
+    checkRoundTrip(data_, compactIndex, cigars);
+}
+
+void TestPackedFragmentBuffer::testSplitCigar()
+{
+    load();
+    bin_.incrementDataSize(reference::ReferencePosition(0, 0), build::PackedFragmentBuffer::CompactIndex::MAX_DATA_OFFSET + 1);
+    data_.reserveWideOffsets(bin_);
+    alignment::Cigar cigars;
+    cigars.reserve(1024);
+
+    // the way BamSerializer splits an alignment into two records of the same fragment
+    build::PackedFragmentBuffer::Index firstPart =
+        data_.getIndex(loadCompactIndex(offsets_[1], offsets_[0]), cigars);
+    build::PackedFragmentBuffer::Index secondPart = firstPart;
+
+    alignment::Cigar firstCigar;
+    firstCigar.addOperation(4, alignment::Cigar::ALIGN);
+    firstCigar.addOperation(READ_LENGTH - 4, alignment::Cigar::SOFT_CLIP);
+    firstPart.cigarBegin_ = &firstCigar.front();
+    firstPart.cigarEnd_ = &firstCigar.back() + 1;
+    build::PackedFragmentBuffer::storeCigar(firstPart, cigars);
+
+    alignment::Cigar secondCigar;
+    secondCigar.addOperation(4, alignment::Cigar::SOFT_CLIP);
+    secondCigar.addOperation(READ_LENGTH - 4, alignment::Cigar::ALIGN);
+    secondPart.pos_ += 1000;
+    secondPart.cigarBegin_ = &secondCigar.front();
+    secondPart.cigarEnd_ = &secondCigar.back() + 1;
+    build::PackedFragmentBuffer::storeCigar(secondPart, cigars);
+
+    const build::PackedFragmentBuffer::CompactIndex firstCompact = data_.getCompactIndex(firstPart, cigars);
+    const build::PackedFragmentBuffer::CompactIndex secondCompact = data_.getCompactIndex(secondPart, cigars);
+    CPPUNIT_ASSERT_EQUAL(firstCompact.dataOffset_, secondCompact.dataOffset_);
+    CPPUNIT_ASSERT(firstCompact.cigarOffset_ != secondCompact.cigarOffset_);
+
+    const build::PackedFragmentBuffer::Index firstBack = data_.getIndex(firstCompact, cigars);
+    const build::PackedFragmentBuffer::Index secondBack = data_.getIndex(secondCompact, cigars);
+    CPPUNIT_ASSERT_EQUAL(firstPart.pos_, firstBack.pos_);
+    CPPUNIT_ASSERT_EQUAL(secondPart.pos_, secondBack.pos_);
+    CPPUNIT_ASSERT_EQUAL(offsets_[1], secondBack.dataOffset_);
+    CPPUNIT_ASSERT_EQUAL(offsets_[0], secondBack.mateDataOffset_);
+    CPPUNIT_ASSERT_EQUAL(alignment::Cigar::toString(firstCigar.begin(), firstCigar.end()),
+                         alignment::Cigar::toString(firstBack.cigarBegin_, firstBack.cigarEnd_));
+    CPPUNIT_ASSERT_EQUAL(alignment::Cigar::toString(secondCigar.begin(), secondCigar.end()),
+                         alignment::Cigar::toString(secondBack.cigarBegin_, secondBack.cigarEnd_));
+    checkRoundTrip(data_, firstCompact, cigars);
+    checkRoundTrip(data_, secondCompact, cigars);
+}
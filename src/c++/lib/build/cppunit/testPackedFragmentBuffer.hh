@@ -0,0 +1,54 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BUILD_TEST_PACKED_FRAGMENT_BUFFER_HH
+#define iSAAC_BUILD_TEST_PACKED_FRAGMENT_BUFFER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include "alignment/BinMetadata.hh"
+#include "build/PackedFragmentBuffer.hh"
+
+class TestPackedFragmentBuffer : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestPackedFragmentBuffer );
+    CPPUNIT_TEST( testIndex );
+    CPPUNIT_TEST( testNormalBin );
+    CPPUNIT_TEST( testWideOffsets );
+    CPPUNIT_TEST( testRealignedCigar );
+    CPPUNIT_TEST( testSplitCigar );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    isaac::alignment::BinMetadata bin_;
+    isaac::build::PackedFragmentBuffer data_;
+    // offsets of the first read, the second read and a single-ended fragment
+    std::vector<uint64_t> offsets_;
+
+    void load();
+    isaac::build::PackedFragmentBuffer::CompactIndex loadCompactIndex(const uint64_t offset, const uint64_t mateOffset);
+
+public:
+    TestPackedFragmentBuffer();
+    void setUp();
+    void tearDown();
+
+    void testIndex();
+    void testNormalBin();
+    void testWideOffsets();
+    void testRealignedCigar();
+    void testSplitCigar();
+};
+
+#endif // #ifndef iSAAC_BUILD_TEST_PACKED_FRAGMENT_BUFFER_HH
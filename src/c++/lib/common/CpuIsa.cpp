@@ -0,0 +1,94 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CpuIsa.cpp
+ **
+ ** Selection of the instruction set used by the vectorized kernels at runtime.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "common/CpuIsa.hh"
+#include "common/Debug.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+namespace cpuIsa
+{
+static CpuIsa isa = CpuIsaCount;
+} // namespace cpuIsa
+
+const char *getCpuIsaName(const CpuIsa isa)
+{
+    static const char *names[] = {"generic", "sse2", "sse4.1", "avx2", "avx512"};
+    ISAAC_ASSERT_MSG(CpuIsaCount > isa, "Unknown cpu isa " << isa);
+    return names[isa];
+}
+
+bool isCpuIsaSupported(const CpuIsa isa)
+{
+#ifdef iSAAC_CPU_ISA_X86
+    __builtin_cpu_init();
+#endif //iSAAC_CPU_ISA_X86
+    switch (isa)
+    {
+    case CpuIsaGeneric:
+        return true;
+#ifdef iSAAC_CPU_ISA_X86
+    case CpuIsaSse2:
+        return __builtin_cpu_supports("sse2");
+    case CpuIsaSse41:
+        return __builtin_cpu_supports("sse4.1");
+    case CpuIsaAvx2:
+        return __builtin_cpu_supports("avx2");
+    case CpuIsaAvx512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif //iSAAC_CPU_ISA_X86
+    default:
+        return false;
+    }
+}
+
+CpuIsa getBestCpuIsa()
+{
+    static CpuIsa best = CpuIsaCount;
+    if (CpuIsaCount == best)
+    {
+        best = CpuIsaGeneric;
+        for (int isa = CpuIsaCount - 1; CpuIsaGeneric < isa; --isa)
+        {
+            if (isCpuIsaSupported(CpuIsa(isa)))
+            {
+                best = CpuIsa(isa);
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+void cpuIsaInitialize(const CpuIsa isa)
+{
+    ISAAC_ASSERT_MSG(isCpuIsaSupported(isa), "Unsupported cpu isa " << getCpuIsaName(isa));
+    cpuIsa::isa = isa;
+}
+
+CpuIsa getCpuIsa()
+{
+    return CpuIsaCount == cpuIsa::isa ? getBestCpuIsa() : cpuIsa::isa;
+}
+
+} // namespace common
+} // namespace isaac
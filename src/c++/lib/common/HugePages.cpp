@@ -0,0 +1,203 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file HugePages.cpp
+ **
+ ** Huge page backed anonymous memory for large static data structures.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <sys/mman.h>
+
+#include <boost/thread.hpp>
+
+#include "common/Debug.hh"
+#include "common/HugePages.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+namespace hugePages
+{
+
+static HugePagesMode mode = HugePagesOff;
+static boost::mutex mappingsMutex;
+// mapping address -> mapped size. Allows telling huge page allocations apart from the regular ones on release
+static std::map<void *, std::size_t> mappings;
+
+static std::size_t roundUp(const std::size_t size)
+{
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+/**
+ * \brief maps mappedSize bytes starting at a huge page boundary, so that the whole range is eligible for
+ *        transparent huge pages.
+ */
+static void *mapAligned(const std::size_t mappedSize)
+{
+    void *unaligned = mmap(0, mappedSize + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == unaligned)
+    {
+        return MAP_FAILED;
+    }
+    char *begin = static_cast<char *>(unaligned);
+    char *ret = reinterpret_cast<char *>(roundUp(reinterpret_cast<std::size_t>(begin)));
+    if (ret != begin)
+    {
+        munmap(begin, ret - begin);
+    }
+    char *end = begin + mappedSize + HUGE_PAGE_SIZE;
+    if (ret + mappedSize != end)
+    {
+        munmap(ret + mappedSize, end - (ret + mappedSize));
+    }
+    return ret;
+}
+
+void *hugePageAllocate(const std::size_t size)
+{
+    if (HugePagesOff == mode || ALLOCATION_SIZE_MIN > size)
+    {
+        return 0;
+    }
+
+    const std::size_t mappedSize = roundUp(size);
+    void *ret = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (HugePagesExplicit == mode)
+    {
+        ret = mmap(0, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (MAP_FAILED == ret)
+        {
+            ISAAC_THREAD_CERR << "WARNING: MAP_HUGETLB failed for " << mappedSize << " bytes, falling back to transparent huge pages: " <<
+                strerror(errno) << std::endl;
+        }
+    }
+#endif //MAP_HUGETLB
+
+    if (MAP_FAILED == ret)
+    {
+        ret = mapAligned(mappedSize);
+        if (MAP_FAILED == ret)
+        {
+            ISAAC_THREAD_CERR << "WARNING: Failed to map " << mappedSize << " bytes for huge pages: " << strerror(errno) << std::endl;
+            return 0;
+        }
+#ifdef MADV_HUGEPAGE
+        if (madvise(ret, mappedSize, MADV_HUGEPAGE))
+        {
+            // the memory is still usable, just with regular pages
+            ISAAC_THREAD_CERR << "WARNING: MADV_HUGEPAGE failed for " << mappedSize << " bytes: " << strerror(errno) << std::endl;
+        }
+#endif //MADV_HUGEPAGE
+    }
+
+    boost::lock_guard<boost::mutex> lock(mappingsMutex);
+    mappings[ret] = mappedSize;
+    return ret;
+}
+
+bool hugePageDeallocate(void *p, const std::size_t size)
+{
+    // hugePageAllocate would not have mapped it
+    if (HugePagesOff == mode || ALLOCATION_SIZE_MIN > size)
+    {
+        return false;
+    }
+
+    std::size_t mappedSize = 0;
+    {
+        boost::lock_guard<boost::mutex> lock(mappingsMutex);
+        std::map<void *, std::size_t>::iterator it = mappings.find(p);
+        if (mappings.end() == it)
+        {
+            return false;
+        }
+        mappedSize = it->second;
+        mappings.erase(it);
+    }
+    ISAAC_ASSERT_MSG(roundUp(size) == mappedSize, "Huge page mapping " << p << " of " << mappedSize << " bytes released with size " << size);
+    if (munmap(p, mappedSize))
+    {
+        ISAAC_THREAD_CERR << "WARNING: Failed to unmap " << mappedSize << " bytes at " << p << ": " << strerror(errno) << std::endl;
+    }
+    return true;
+}
+
+/**
+ * \brief parses lines such as "AnonHugePages:     12288 kB"
+ */
+static std::size_t parseSmapsBytes(const std::string &line, const char *key)
+{
+    const std::size_t keyLength = strlen(key);
+    unsigned long kb = 0;
+    if (!line.compare(0, keyLength, key) && 1 == sscanf(line.c_str() + keyLength, ": %lu kB", &kb))
+    {
+        return kb * 1024;
+    }
+    return 0;
+}
+
+std::size_t getHugePageBackedBytes(const void *p, const std::size_t size)
+{
+    const std::size_t begin = reinterpret_cast<std::size_t>(p);
+    const std::size_t end = begin + size;
+    std::ifstream smaps("/proc/self/smaps");
+    std::size_t ret = 0;
+    std::size_t overlap = 0;
+    std::size_t hugeBytes = 0;
+    std::string line;
+    while (std::getline(smaps, line))
+    {
+        unsigned long vmaBegin = 0;
+        unsigned long vmaEnd = 0;
+        char dash = 0;
+        if (3 == sscanf(line.c_str(), "%lx%c%lx", &vmaBegin, &dash, &vmaEnd) && '-' == dash)
+        {
+            ret += std::min(hugeBytes, overlap);
+            hugeBytes = 0;
+            overlap = (vmaEnd > begin && end > vmaBegin) ? std::min<std::size_t>(vmaEnd, end) - std::max<std::size_t>(vmaBegin, begin) : 0;
+        }
+        else if (overlap)
+        {
+            hugeBytes += parseSmapsBytes(line, "AnonHugePages") +
+                parseSmapsBytes(line, "Shared_Hugetlb") + parseSmapsBytes(line, "Private_Hugetlb");
+        }
+    }
+    return ret + std::min(hugeBytes, overlap);
+}
+
+} // namespace hugePages
+
+void hugePagesInitialize(const HugePagesMode mode)
+{
+    hugePages::mode = mode;
+}
+
+HugePagesMode getHugePagesMode()
+{
+    return hugePages::mode;
+}
+
+} // namespace common
+} // namespace isaac
@@ -0,0 +1,155 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MemoryMappedFile.cpp
+ **
+ ** Read-only memory mapping of a whole file.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/MemoryMappedFile.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+MemoryMappedFile::MemoryMappedFile(const boost::filesystem::path &path, const Advice advice)
+    : path_(path)
+    , data_(0)
+    , size_(0)
+{
+    const int fd = ::open(path_.c_str(), O_RDONLY);
+    if (-1 == fd)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open file for mapping " + path_.string()));
+    }
+
+    struct stat s;
+    if (-1 == fstat(fd, &s))
+    {
+        const int error = errno;
+        ::close(fd);
+        BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to stat file for mapping " + path_.string()));
+    }
+
+    if (s.st_size)
+    {
+        void *data = mmap(0, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == data)
+        {
+            const int error = errno;
+            ::close(fd);
+            BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to map file " + path_.string()));
+        }
+        data_ = static_cast<const char *>(data);
+        size_ = s.st_size;
+    }
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    advise(advice);
+    ISAAC_THREAD_CERR << "Mapped " << size_ << " bytes of " << path_ << std::endl;
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile &&that)
+    : path_(that.path_)
+    , data_(that.data_)
+    , size_(that.size_)
+{
+    that.data_ = 0;
+    that.size_ = 0;
+}
+
+MemoryMappedFile &MemoryMappedFile::operator =(MemoryMappedFile &&that)
+{
+    if (this != &that)
+    {
+        unmap();
+        path_ = that.path_;
+        data_ = that.data_;
+        size_ = that.size_;
+        that.data_ = 0;
+        that.size_ = 0;
+    }
+    return *this;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    unmap();
+}
+
+void MemoryMappedFile::unmap()
+{
+    if (data_)
+    {
+        if (-1 == munmap(const_cast<char *>(data_), size_))
+        {
+            ISAAC_THREAD_CERR << "WARNING: Failed to unmap " << path_ << ": " << strerror(errno) << std::endl;
+        }
+        data_ = 0;
+        size_ = 0;
+    }
+}
+
+void MemoryMappedFile::advise(const Advice advice, const std::size_t offset, const std::size_t length) const
+{
+    if (!data_ || !length)
+    {
+        return;
+    }
+
+    static const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    const std::size_t begin = offset / pageSize * pageSize;
+    const std::size_t end = std::min(size_, offset + length);
+
+    // madvise rather than posix_madvise: glibc ignores POSIX_MADV_DONTNEED as it cannot tell whether the pages may be
+    // discarded. For a read-only file mapping they can, and they fault back in from the page cache.
+    int madvice = MADV_NORMAL;
+    switch (advice)
+    {
+    case Sequential:
+        madvice = MADV_SEQUENTIAL;
+        break;
+    case Random:
+        madvice = MADV_RANDOM;
+        break;
+    case WillNeed:
+        madvice = MADV_WILLNEED;
+        break;
+    case DontNeed:
+        madvice = MADV_DONTNEED;
+        break;
+    default:
+        break;
+    }
+
+    if (end > begin && madvise(const_cast<char *>(data_) + begin, end - begin, madvice))
+    {
+        ISAAC_THREAD_CERR << "WARNING: madvise " << madvice << " failed for " << path_ << ": " << strerror(errno) << std::endl;
+    }
+}
+
+} // namespace common
+} // namespace isaac
@@ -24,6 +24,7 @@
 #include <numaif.h>
 #endif //HAVE_NUMA
 
+#include "common/HugePages.hh"
 #include "common/Numa.hh"
 
 namespace isaac
@@ -56,8 +57,28 @@ static bool numaAvailable(bool set = false, bool enable = false)
 
 // NB: __n is permitted to be 0.  The C++ standard says nothing
 // about what the return value is when __n == 0.
-void* numaAllocate(std::size_t size, const int node)
+void* numaAllocate(std::size_t size, const int node, const bool hugePages)
 {
+    void *hugePageMemory = hugePages ? hugePages::hugePageAllocate(size) : 0;
+    if (hugePageMemory)
+    {
+#ifdef HAVE_NUMA
+        // memory is not touched yet, so the policy determines where the pages will be faulted in
+        if (isNumaAvailable())
+        {
+            if (numa::defaultNodeInterleave == node)
+            {
+                numa_interleave_memory(hugePageMemory, size, numa_all_nodes_ptr);
+            }
+            else if (numa::defaultNodeLocal != node)
+            {
+                numa_tonode_memory(hugePageMemory, size, numa::numaNodes.at(node));
+            }
+        }
+#endif //HAVE_NUMA
+        return hugePageMemory;
+    }
+
     if (!isNumaAvailable())
     {
         return ::operator new(size);
@@ -86,8 +107,13 @@ void* numaAllocate(std::size_t size, const int node)
 }
 
 // __p is not permitted to be a null pointer.
-void numaDeallocate(void * p, std::size_t size, const int node)
+void numaDeallocate(void * p, std::size_t size, const int node, const bool hugePages)
 {
+    if (hugePages && hugePages::hugePageDeallocate(p, size))
+    {
+        return;
+    }
+
     if (!isNumaAvailable())
     {
         ::operator delete(p);
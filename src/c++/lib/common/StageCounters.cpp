@@ -0,0 +1,170 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file StageCounters.cpp
+ **
+ ** \brief see StageCounters.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <fstream>
+
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/StageCounters.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+static const char *STAGE_NAMES[STAGES_COUNT] =
+{
+    "tile_load",
+    "seed_lookup",
+    "ungapped_alignment",
+    "gapped_alignment",
+    "smith_waterman",
+    "template_building",
+    "binning",
+    "bin_load",
+    "duplicate_filtering",
+    "realignment",
+    "serialization",
+    "compression"
+};
+
+const char *getStageName(const Stage stage)
+{
+    ISAAC_ASSERT_MSG(STAGES_COUNT > stage, "Invalid stage " << stage);
+    return STAGE_NAMES[stage];
+}
+
+const unsigned StageCounters::SLOTS_MAX;
+StageCounters::Slot StageCounters::slots_[StageCounters::SLOTS_MAX + 1];
+std::atomic<unsigned> StageCounters::slotsClaimed_(0);
+__thread StageCounters::Slot *StageCounters::threadSlot_ = 0;
+
+StageCounters::Totals::Totals()
+{
+    std::fill(calls_, calls_ + STAGES_COUNT, 0);
+    std::fill(nanoseconds_, nanoseconds_ + STAGES_COUNT, 0);
+}
+
+StageCounters::Slot *StageCounters::claimSlot()
+{
+    const unsigned slot = slotsClaimed_.fetch_add(1, std::memory_order_relaxed);
+    threadSlot_ = &slots_[std::min(slot, SLOTS_MAX)];
+    return threadSlot_;
+}
+
+void StageCounters::add(Totals &totals, const Slot &slot)
+{
+    for (unsigned stage = 0; STAGES_COUNT != stage; ++stage)
+    {
+        totals.calls_[stage] += slot.calls_[stage].load(std::memory_order_relaxed);
+        totals.nanoseconds_[stage] += slot.nanoseconds_[stage].load(std::memory_order_relaxed);
+    }
+}
+
+uint64_t StageCounters::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+}
+
+StageCounters::Totals StageCounters::collect()
+{
+    Totals ret;
+    const unsigned slotsUsed = std::min(slotsClaimed_.load(std::memory_order_relaxed), SLOTS_MAX);
+    for (const Slot *slot = slots_; slots_ + slotsUsed != slot; ++slot)
+    {
+        add(ret, *slot);
+    }
+    add(ret, slots_[SLOTS_MAX]);
+    return ret;
+}
+
+void StageCounters::reset()
+{
+    for (Slot *slot = slots_; slots_ + SLOTS_MAX + 1 != slot; ++slot)
+    {
+        for (unsigned stage = 0; STAGES_COUNT != stage; ++stage)
+        {
+            slot->calls_[stage].store(0, std::memory_order_relaxed);
+            slot->nanoseconds_[stage].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void StageCounters::serializeJson(std::ostream &os, const std::string &phase, const Totals &totals)
+{
+    os << "{\n  \"phase\": \"" << phase << "\",\n  \"stages\": {";
+    for (unsigned stage = 0; STAGES_COUNT != stage; ++stage)
+    {
+        os << (stage ? ",\n" : "\n") <<
+            boost::format("    \"%s\": {\"calls\": %d, \"seconds\": %.6f}") %
+                STAGE_NAMES[stage] % totals.calls_[stage] % (totals.nanoseconds_[stage] / 1000000000.0);
+    }
+    os << "\n  }\n}\n";
+}
+
+void StageCounters::serializePrometheus(std::ostream &os, const std::string &phase, const Totals &totals)
+{
+    os << "# HELP isaac_stage_calls_total Number of times the stage was entered\n"
+        "# TYPE isaac_stage_calls_total counter\n";
+    for (unsigned stage = 0; STAGES_COUNT != stage; ++stage)
+    {
+        os << boost::format("isaac_stage_calls_total{phase=\"%s\",stage=\"%s\"} %d\n") %
+            phase % STAGE_NAMES[stage] % totals.calls_[stage];
+    }
+    os << "# HELP isaac_stage_seconds_total Time spent in the stage summed over all threads\n"
+        "# TYPE isaac_stage_seconds_total counter\n";
+    for (unsigned stage = 0; STAGES_COUNT != stage; ++stage)
+    {
+        os << boost::format("isaac_stage_seconds_total{phase=\"%s\",stage=\"%s\"} %.6f\n") %
+            phase % STAGE_NAMES[stage] % (totals.nanoseconds_[stage] / 1000000000.0);
+    }
+}
+
+void StageCounters::save(
+    const std::string &phase,
+    const boost::filesystem::path &jsonPath,
+    const boost::filesystem::path &prometheusPath)
+{
+    const Totals totals = collect();
+    {
+        std::ofstream os(jsonPath.string().c_str());
+        if (!os) {
+            BOOST_THROW_EXCEPTION(IoException(errno, "ERROR: Unable to open file for writing: " + jsonPath.string()));
+        }
+        serializeJson(os, phase, totals);
+    }
+    {
+        std::ofstream os(prometheusPath.string().c_str());
+        if (!os) {
+            BOOST_THROW_EXCEPTION(IoException(errno, "ERROR: Unable to open file for writing: " + prometheusPath.string()));
+        }
+        serializePrometheus(os, phase, totals);
+    }
+    ISAAC_THREAD_CERR << "Stage counters for " << phase << " saved to " << jsonPath << " and " << prometheusPath << std::endl;
+}
+
+} // namespace common
+} // namespace isaac
@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include <new>
+#include <fstream>
 #include <iostream>
 
 #include <boost/format.hpp>
@@ -91,6 +92,19 @@ int64_t clock()
 #endif
 }
 
+uint64_t getResidentSetBytes()
+{
+    // the second field of statm is the resident set size in pages
+    std::ifstream is("/proc/self/statm");
+    uint64_t vmPages = 0;
+    uint64_t residentPages = 0;
+    if (!(is >> vmPages >> residentPages))
+    {
+        return 0;
+    }
+    return residentPages * sysconf(_SC_PAGESIZE);
+}
+
 bool isLittleEndian()
 {
     const uint64_t v = 0x0706050403020100;
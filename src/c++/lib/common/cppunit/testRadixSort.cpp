@@ -0,0 +1,121 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testRadixSort.cpp
+ **
+ ** Unit tests for RadixSort.hpp
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "testRadixSort.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestRadixSort, registryName("RadixSort"));
+
+void TestRadixSort::setUp()
+{
+}
+
+void TestRadixSort::tearDown()
+{
+}
+
+static bool keyLess(const isaac::common::RadixSortRecord &left, const isaac::common::RadixSortRecord &right)
+{
+    return left.key_ < right.key_;
+}
+
+/**
+ * \brief keys in a narrow range with plenty of repeats, the way positions of a bin look
+ */
+static std::vector<isaac::common::RadixSortRecord> generateRecords(const std::size_t count, const uint64_t base)
+{
+    std::vector<isaac::common::RadixSortRecord> ret;
+    unsigned state = 1;
+    for (std::size_t i = 0; count != i; ++i)
+    {
+        ret.push_back(isaac::common::RadixSortRecord(base + rand_r(&state) % (count / 4 + 1), i));
+    }
+    return ret;
+}
+
+void TestRadixSort::testSort()
+{
+    for (const uint64_t base : {0UL, 0x123456789abc0000UL})
+    {
+        for (const std::size_t size : {0UL, 1UL, 2UL, 101UL, 10000UL})
+        {
+            std::vector<isaac::common::RadixSortRecord> records = generateRecords(size, base);
+            std::vector<isaac::common::RadixSortRecord> expected(records);
+            std::stable_sort(expected.begin(), expected.end(), &keyLess);
+
+            std::vector<isaac::common::RadixSortRecord> buffer(size);
+            isaac::common::RadixSorter::sort(&records.front(), &records.front() + size, &buffer.front());
+            for (std::size_t i = 0; size != i; ++i)
+            {
+                CPPUNIT_ASSERT_EQUAL(expected[i].key_, records[i].key_);
+                // must be stable
+                CPPUNIT_ASSERT_EQUAL(expected[i].offset_, records[i].offset_);
+            }
+        }
+    }
+}
+
+void TestRadixSort::testThreads()
+{
+    const std::size_t size = isaac::common::RadixSorter::MIN_RECORDS_PER_THREAD * 4 + 3;
+    std::vector<isaac::common::RadixSortRecord> records = generateRecords(size, 0x1000000);
+    std::vector<isaac::common::RadixSortRecord> expected(records);
+    std::stable_sort(expected.begin(), expected.end(), &keyLess);
+
+    isaac::common::ThreadVector threads(4);
+    std::vector<isaac::common::RadixSortRecord> buffer(size);
+    isaac::common::RadixSorter::sort(&records.front(), &records.front() + size, &buffer.front(), threads, threads.size());
+    for (std::size_t i = 0; size != i; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL(expected[i].key_, records[i].key_);
+        CPPUNIT_ASSERT_EQUAL(expected[i].offset_, records[i].offset_);
+    }
+}
+
+void TestRadixSort::testTies()
+{
+    typedef std::pair<unsigned, unsigned> Element;
+    std::vector<Element> v;
+    unsigned state = 1;
+    for (unsigned i = 0; 1000 > i; ++i)
+    {
+        v.push_back(Element(rand_r(&state) % 50, rand_r(&state)));
+    }
+    std::vector<Element> expected(v);
+    std::sort(expected.begin(), expected.end());
+
+    isaac::common::RadixSortRecords records;
+    records.reserve(v.size() * 2);
+    std::vector<Element> gathered(v);
+    isaac::common::radixSort(
+        v.begin(), v.end(), [](const Element &e){return uint64_t(e.first);}, std::less<Element>(), records);
+    CPPUNIT_ASSERT(expected == v);
+
+    // enough capacity to gather past the end
+    gathered.reserve(gathered.size() * 2);
+    isaac::common::radixSort(
+        gathered, [](const Element &e){return uint64_t(e.first);}, std::less<Element>(), records);
+    CPPUNIT_ASSERT(expected == gathered);
+}
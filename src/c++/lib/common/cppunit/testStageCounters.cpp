@@ -0,0 +1,81 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testStageCounters.cpp
+ **
+ ** Unit tests for StageCounters.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <sstream>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "testStageCounters.hh"
+
+#include "common/Threads.hpp"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestStageCounters, registryName("StageCounters"));
+
+void TestStageCounters::setUp()
+{
+    isaac::common::StageCounters::reset();
+}
+
+void TestStageCounters::tearDown()
+{
+    isaac::common::StageCounters::reset();
+}
+
+void TestStageCounters::testThreads()
+{
+    isaac::common::ThreadVector threads(4);
+    threads.execute(
+        [](const unsigned threadNumber, const unsigned threadsTotal)
+        {
+            for (unsigned i = 0; 1000 != i; ++i)
+            {
+                isaac::common::StageCounters::add(isaac::common::STAGE_BIN_LOAD, 2);
+            }
+            isaac::common::StageTimer timer(isaac::common::STAGE_COMPRESSION);
+        });
+
+    const isaac::common::StageCounters::Totals totals = isaac::common::StageCounters::collect();
+    CPPUNIT_ASSERT_EQUAL(4000UL, totals.calls_[isaac::common::STAGE_BIN_LOAD]);
+    CPPUNIT_ASSERT_EQUAL(8000UL, totals.nanoseconds_[isaac::common::STAGE_BIN_LOAD]);
+    CPPUNIT_ASSERT_EQUAL(4UL, totals.calls_[isaac::common::STAGE_COMPRESSION]);
+    CPPUNIT_ASSERT_EQUAL(0UL, totals.calls_[isaac::common::STAGE_TILE_LOAD]);
+
+    isaac::common::StageCounters::reset();
+    CPPUNIT_ASSERT_EQUAL(0UL, isaac::common::StageCounters::collect().calls_[isaac::common::STAGE_BIN_LOAD]);
+}
+
+void TestStageCounters::testExport()
+{
+    isaac::common::StageCounters::add(isaac::common::STAGE_SEED_LOOKUP, 1500000000UL);
+    const isaac::common::StageCounters::Totals totals = isaac::common::StageCounters::collect();
+
+    std::ostringstream json;
+    isaac::common::StageCounters::serializeJson(json, "align", totals);
+    CPPUNIT_ASSERT(std::string::npos != json.str().find("\"phase\": \"align\""));
+    CPPUNIT_ASSERT(std::string::npos != json.str().find("\"seed_lookup\": {\"calls\": 1, \"seconds\": 1.500000}"));
+    CPPUNIT_ASSERT(std::string::npos != json.str().find("\"compression\": {\"calls\": 0, \"seconds\": 0.000000}\n  }\n}\n"));
+
+    std::ostringstream prometheus;
+    isaac::common::StageCounters::serializePrometheus(prometheus, "align", totals);
+    CPPUNIT_ASSERT(std::string::npos != prometheus.str().find(
+        "isaac_stage_calls_total{phase=\"align\",stage=\"seed_lookup\"} 1\n"));
+    CPPUNIT_ASSERT(std::string::npos != prometheus.str().find(
+        "isaac_stage_seconds_total{phase=\"align\",stage=\"seed_lookup\"} 1.500000\n"));
+}
@@ -0,0 +1,40 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testStageCounters.hh
+ **
+ ** Unit tests for StageCounters.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_CPPUNIT_TEST_STAGE_COUNTERS
+#define iSAAC_COMMON_CPPUNIT_TEST_STAGE_COUNTERS
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "common/StageCounters.hh"
+
+class TestStageCounters : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestStageCounters );
+    CPPUNIT_TEST( testThreads );
+    CPPUNIT_TEST( testExport );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+    void testThreads();
+    void testExport();
+};
+
+#endif // #ifndef iSAAC_COMMON_CPPUNIT_TEST_STAGE_COUNTERS
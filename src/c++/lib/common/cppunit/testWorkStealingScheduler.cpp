@@ -0,0 +1,111 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testWorkStealingScheduler.cpp
+ **
+ ** Unit tests for WorkStealingScheduler.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <vector>
+
+#include "RegistryName.hh"
+#include "testWorkStealingScheduler.hh"
+
+#include "common/Threads.hpp"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestWorkStealingScheduler, registryName("WorkStealingScheduler"));
+
+void TestWorkStealingScheduler::setUp()
+{
+}
+
+void TestWorkStealingScheduler::tearDown()
+{
+}
+
+void TestWorkStealingScheduler::testSingleWorker()
+{
+    isaac::common::WorkStealingScheduler scheduler(1);
+    scheduler.reset(25);
+    std::size_t begin = 0, end = 0;
+    CPPUNIT_ASSERT(scheduler.next(0, 10, begin, end));
+    CPPUNIT_ASSERT_EQUAL(0UL, begin);
+    CPPUNIT_ASSERT_EQUAL(10UL, end);
+    CPPUNIT_ASSERT(scheduler.next(0, 10, begin, end));
+    CPPUNIT_ASSERT_EQUAL(10UL, begin);
+    CPPUNIT_ASSERT_EQUAL(20UL, end);
+    CPPUNIT_ASSERT(scheduler.next(0, 10, begin, end));
+    CPPUNIT_ASSERT_EQUAL(20UL, begin);
+    CPPUNIT_ASSERT_EQUAL(25UL, end);
+    CPPUNIT_ASSERT(!scheduler.next(0, 10, begin, end));
+
+    scheduler.reset(0);
+    CPPUNIT_ASSERT(!scheduler.next(0, 10, begin, end));
+}
+
+void TestWorkStealingScheduler::testStealing()
+{
+    isaac::common::WorkStealingScheduler scheduler(2);
+    scheduler.reset(100);
+    std::size_t begin = 0, end = 0;
+    // worker 0 owns [0,50), worker 1 owns [50,100)
+    CPPUNIT_ASSERT(scheduler.next(0, 50, begin, end));
+    CPPUNIT_ASSERT_EQUAL(0UL, begin);
+    CPPUNIT_ASSERT_EQUAL(50UL, end);
+    CPPUNIT_ASSERT(scheduler.next(1, 10, begin, end));
+    CPPUNIT_ASSERT_EQUAL(50UL, begin);
+    CPPUNIT_ASSERT_EQUAL(60UL, end);
+
+    // worker 0 steals the back half of [60,100) and finer than the block size
+    CPPUNIT_ASSERT(scheduler.next(0, 30, begin, end));
+    CPPUNIT_ASSERT_EQUAL(80UL, begin);
+    CPPUNIT_ASSERT_EQUAL(100UL, end);
+    CPPUNIT_ASSERT(scheduler.next(1, 30, begin, end));
+    CPPUNIT_ASSERT_EQUAL(60UL, begin);
+    CPPUNIT_ASSERT_EQUAL(80UL, end);
+    CPPUNIT_ASSERT(!scheduler.next(0, 30, begin, end));
+    CPPUNIT_ASSERT(!scheduler.next(1, 30, begin, end));
+}
+
+void TestWorkStealingScheduler::testThreads()
+{
+    static const unsigned THREADS = 4;
+    static const std::size_t TOTAL = 100003;
+    isaac::common::WorkStealingScheduler scheduler(THREADS);
+    isaac::common::ThreadVector threads(THREADS);
+    std::vector<unsigned> hits(TOTAL, 0);
+
+    for (unsigned pass = 0; 3 != pass; ++pass)
+    {
+        scheduler.reset(TOTAL);
+        threads.execute(
+            [&](const unsigned threadNumber, const unsigned threadsTotal)
+            {
+                std::size_t begin = 0, end = 0;
+                while (scheduler.next(threadNumber, 7 + threadNumber * 13, begin, end))
+                {
+                    for (; end != begin; ++begin)
+                    {
+                        // distinct elements, no synchronization needed
+                        ++hits[begin];
+                    }
+                }
+            });
+    }
+
+    for (std::size_t i = 0; TOTAL != i; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL(3U, hits[i]);
+    }
+}
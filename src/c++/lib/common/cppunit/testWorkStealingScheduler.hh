@@ -0,0 +1,42 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testWorkStealingScheduler.hh
+ **
+ ** Unit tests for WorkStealingScheduler.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_CPPUNIT_TEST_WORK_STEALING_SCHEDULER
+#define iSAAC_COMMON_CPPUNIT_TEST_WORK_STEALING_SCHEDULER
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "common/WorkStealingScheduler.hh"
+
+class TestWorkStealingScheduler : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestWorkStealingScheduler );
+    CPPUNIT_TEST( testSingleWorker );
+    CPPUNIT_TEST( testStealing );
+    CPPUNIT_TEST( testThreads );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+    void testSingleWorker();
+    void testStealing();
+    void testThreads();
+};
+
+#endif // #ifndef iSAAC_COMMON_CPPUNIT_TEST_WORK_STEALING_SCHEDULER
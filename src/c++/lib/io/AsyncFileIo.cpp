@@ -0,0 +1,666 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file AsyncFileIo.cpp
+ **
+ ** Positioned file reads and writes that complete in the background.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define iSAAC_ASYNC_FILE_IO_URING
+#endif
+#endif
+#endif
+
+#include <boost/bind.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/Threads.hpp"
+#include "io/AsyncFileIo.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+static AsyncFileIoBackend defaultBackend = AsyncFileIoAuto;
+static unsigned defaultQueueDepth = 16;
+
+void asyncFileIoInitialize(const AsyncFileIoBackend backend, const unsigned queueDepth)
+{
+    ISAAC_ASSERT_MSG(queueDepth, "Queue depth must be positive");
+    defaultBackend = backend;
+    defaultQueueDepth = queueDepth;
+}
+
+const char *getAsyncFileIoBackendName(const AsyncFileIoBackend backend)
+{
+    static const char *names[] = {"auto", "io-uring", "threads"};
+    ISAAC_ASSERT_MSG(AsyncFileIoThreads >= backend, "Unknown async file i/o backend " << backend);
+    return names[backend];
+}
+
+#ifdef iSAAC_ASYNC_FILE_IO_URING
+
+/**
+ * \brief Rings shared with the kernel. Accessed with raw system calls so that no liburing is needed.
+ */
+class AsyncFileIo::Uring: boost::noncopyable
+{
+public:
+    /// user_data of the NOP that wakes the completion thread up for termination
+    static const uint64_t WAKEUP = ~uint64_t(0);
+
+    Uring() : fd_(-1), sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0),
+        sqes_(MAP_FAILED), sqesSize_(0)
+    {
+    }
+
+    ~Uring()
+    {
+        if (MAP_FAILED != sqes_)
+        {
+            munmap(sqes_, sqesSize_);
+        }
+        if (MAP_FAILED != cqRing_ && cqRing_ != sqRing_)
+        {
+            munmap(cqRing_, cqRingSize_);
+        }
+        if (MAP_FAILED != sqRing_)
+        {
+            munmap(sqRing_, sqRingSize_);
+        }
+        if (-1 != fd_)
+        {
+            ::close(fd_);
+        }
+    }
+
+    /**
+     * \return errno on failure
+     */
+    int setup(const unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd_ = syscall(__NR_io_uring_setup, entries, &params);
+        if (-1 == fd_)
+        {
+            return errno;
+        }
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = mmap(0, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (MAP_FAILED == sqRing_)
+        {
+            return errno;
+        }
+        cqRing_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing_ :
+            mmap(0, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == cqRing_)
+        {
+            return errno;
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = mmap(0, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (MAP_FAILED == sqes_)
+        {
+            return errno;
+        }
+
+        char *sq = static_cast<char*>(sqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char *cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return 0;
+    }
+
+    /**
+     * \brief Not thread safe. The callers never have more entries in flight than the ring holds.
+     *
+     * \return errno on failure
+     */
+    int submit(const unsigned char opcode, const int fd, const iovec *iov, const int iovcnt,
+               const uint64_t offset, const uint64_t userData)
+    {
+        const unsigned tail = *sqTail_;
+        const unsigned index = tail & sqMask_;
+        io_uring_sqe &sqe = static_cast<io_uring_sqe*>(sqes_)[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(iov);
+        sqe.len = iovcnt;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+
+        while (-1 == syscall(__NR_io_uring_enter, fd_, 1, 0, 0, 0, 0))
+        {
+            if (EINTR != errno && EAGAIN != errno && EBUSY != errno)
+            {
+                return errno;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * \brief blocks until at least one completion is available
+     */
+    void waitCompletion()
+    {
+        if (-1 == syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, 0, 0) && EINTR != errno)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "io_uring_enter failed to wait for completions"));
+        }
+    }
+
+    /**
+     * \brief Calls consume(userData, result) for each available completion. Not thread safe.
+     */
+    template <typename ConsumerT>
+    void consumeCompletions(ConsumerT consume)
+    {
+        unsigned head = *cqHead_;
+        while (__atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != head)
+        {
+            const io_uring_cqe &cqe = cqes_[head & cqMask_];
+            const uint64_t userData = cqe.user_data;
+            const int result = cqe.res;
+            __atomic_store_n(cqHead_, ++head, __ATOMIC_RELEASE);
+            consume(userData, result);
+        }
+    }
+
+private:
+    int fd_;
+    void *sqRing_;
+    std::size_t sqRingSize_;
+    void *cqRing_;
+    std::size_t cqRingSize_;
+    void *sqes_;
+    std::size_t sqesSize_;
+
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned *sqArray_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe *cqes_;
+};
+
+#else //iSAAC_ASYNC_FILE_IO_URING
+
+class AsyncFileIo::Uring
+{
+};
+
+#endif //iSAAC_ASYNC_FILE_IO_URING
+
+/**
+ * \brief Threads doing blocking preadv/pwritev for all AsyncFileIo objects of the process. Requests are queued
+ *        through their next_ link, so queueing does not allocate.
+ */
+class AsyncFileIo::ThreadPool: boost::noncopyable
+{
+public:
+    static ThreadPool &instance()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ~ThreadPool()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            terminate_ = true;
+        }
+        stateChangedCondition_.notify_all();
+        std::for_each(threads_.begin(), threads_.end(), boost::bind(&boost::thread::join, _1));
+    }
+
+    /**
+     * \brief makes sure at least threads workers are running
+     */
+    void reserve(const unsigned threads)
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        while (threads_.size() < threads)
+        {
+            threads_.push_back(new boost::thread(boost::bind(&ThreadPool::threadLoop, this)));
+        }
+    }
+
+    void push(Request &request)
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            request.next_ = 0;
+            if (tail_)
+            {
+                tail_->next_ = &request;
+            }
+            else
+            {
+                head_ = &request;
+            }
+            tail_ = &request;
+        }
+        stateChangedCondition_.notify_one();
+    }
+
+private:
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    Request *head_;
+    Request *tail_;
+    bool terminate_;
+    boost::ptr_vector<boost::thread> threads_;
+
+    ThreadPool() : head_(0), tail_(0), terminate_(false)
+    {
+    }
+
+    void threadLoop()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (true)
+        {
+            while (!terminate_ && !head_)
+            {
+                stateChangedCondition_.wait(lock);
+            }
+            if (!head_)
+            {
+                return;
+            }
+            Request &request = *head_;
+            head_ = request.next_;
+            if (!head_)
+            {
+                tail_ = 0;
+            }
+
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            AsyncFileIo &owner = *request.owner_;
+            try
+            {
+                const int error = transfer(request);
+                boost::lock_guard<boost::mutex> ownerLock(owner.mutex_);
+                owner.complete(&request - &owner.requests_.front(), error);
+            }
+            catch (...)
+            {
+                owner.fail(boost::current_exception());
+            }
+        }
+    }
+};
+
+AsyncFileIo::AsyncFileIo() : terminate_(false), uring_(0)
+{
+    start(defaultBackend, defaultQueueDepth);
+}
+
+AsyncFileIo::AsyncFileIo(const AsyncFileIoBackend backend, const unsigned queueDepth) :
+    terminate_(false), uring_(0)
+{
+    start(backend, queueDepth);
+}
+
+AsyncFileIo::~AsyncFileIo()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        // backend threads might still be completing requests of batches nobody waits for
+        while (!failure_ && freeRequests_.size() != requests_.size())
+        {
+            stateChangedCondition_.wait(lock);
+        }
+        terminate_ = true;
+#ifdef iSAAC_ASYNC_FILE_IO_URING
+        if (uring_ && uring_->submit(IORING_OP_NOP, -1, 0, 0, 0, Uring::WAKEUP))
+        {
+            ISAAC_THREAD_CERR << "ERROR: failed to wake up the io_uring completion thread" << std::endl;
+        }
+#endif //iSAAC_ASYNC_FILE_IO_URING
+    }
+    stateChangedCondition_.notify_all();
+    std::for_each(threads_.begin(), threads_.end(), boost::bind(&boost::thread::join, _1));
+    delete uring_;
+}
+
+void AsyncFileIo::start(const AsyncFileIoBackend backend, const unsigned queueDepth)
+{
+    ISAAC_ASSERT_MSG(queueDepth, "Queue depth must be positive");
+    requests_.resize(queueDepth);
+    freeRequests_.reserve(queueDepth);
+    for (unsigned request = queueDepth; request; --request)
+    {
+        freeRequests_.push_back(request - 1);
+    }
+
+    backend_ = AsyncFileIoThreads;
+    if (AsyncFileIoThreads != backend)
+    {
+        if (startUring(queueDepth))
+        {
+            backend_ = AsyncFileIoUring;
+        }
+        else if (AsyncFileIoUring == backend)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(
+                errno, "io_uring is not available. Use the threads backend instead"));
+        }
+    }
+
+    if (AsyncFileIoThreads == backend_)
+    {
+        ThreadPool::instance().reserve(queueDepth);
+    }
+    ISAAC_THREAD_CERR << "Asynchronous file i/o backend: " << getAsyncFileIoBackendName(backend_) <<
+        ", queue depth " << queueDepth << std::endl;
+}
+
+bool AsyncFileIo::startUring(const unsigned queueDepth)
+{
+#ifdef iSAAC_ASYNC_FILE_IO_URING
+    std::unique_ptr<Uring> uring(new Uring);
+    // one extra entry for the termination wakeup
+    if (const int error = uring->setup(queueDepth + 1))
+    {
+        ISAAC_THREAD_CERR << "WARNING: io_uring setup failed with " << error << "(" << strerror(error) << ")" << std::endl;
+        errno = error;
+        return false;
+    }
+    uring_ = uring.release();
+    threads_.push_back(new boost::thread(boost::bind(&AsyncFileIo::uringLoop, this)));
+    return true;
+#else //iSAAC_ASYNC_FILE_IO_URING
+    errno = ENOSYS;
+    return false;
+#endif //iSAAC_ASYNC_FILE_IO_URING
+}
+
+void AsyncFileIo::writev(Batch &batch, const int fd, iovec *iov, const int iovcnt, const uint64_t offset)
+{
+    ISAAC_ASSERT_MSG(0 < iovcnt, "At least one buffer required");
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Request &request = requests_[acquireRequest(lock)];
+    request.write_ = true;
+    request.iov_ = iov;
+    request.iovcnt_ = iovcnt;
+    enqueue(batch, fd, offset, request);
+}
+
+void AsyncFileIo::read(Batch &batch, const int fd, char *buffer, const std::size_t size, const uint64_t offset)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Request &request = requests_[acquireRequest(lock)];
+    request.write_ = false;
+    request.buffer_.iov_base = buffer;
+    request.buffer_.iov_len = size;
+    request.iov_ = &request.buffer_;
+    request.iovcnt_ = 1;
+    enqueue(batch, fd, offset, request);
+}
+
+int AsyncFileIo::wait(Batch &batch)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (batch.outstanding_ && !failure_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    checkFailure();
+    const int ret = batch.error_;
+    batch.error_ = 0;
+    return ret;
+}
+
+/**
+ * \brief blocks while all requests are in flight
+ */
+unsigned AsyncFileIo::acquireRequest(boost::unique_lock<boost::mutex> &lock)
+{
+    while (freeRequests_.empty() && !failure_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    checkFailure();
+    const unsigned ret = freeRequests_.back();
+    freeRequests_.pop_back();
+    return ret;
+}
+
+void AsyncFileIo::enqueue(Batch &batch, const int fd, const uint64_t offset, Request &request)
+{
+    request.batch_ = &batch;
+    request.fd_ = fd;
+    request.offset_ = offset;
+    ++batch.outstanding_;
+    const unsigned index = &request - &requests_.front();
+    if (AsyncFileIoUring == backend_)
+    {
+        uringSubmit(index);
+    }
+    else
+    {
+        request.owner_ = this;
+        ThreadPool::instance().push(request);
+    }
+}
+
+/**
+ * \brief moves the request past the transferred bytes
+ *
+ * \return true if nothing is left to transfer
+ */
+bool AsyncFileIo::advance(Request &request, std::size_t transferred)
+{
+    request.offset_ += transferred;
+    while (request.iovcnt_ && request.iov_->iov_len <= transferred)
+    {
+        transferred -= request.iov_->iov_len;
+        ++request.iov_;
+        --request.iovcnt_;
+    }
+    if (request.iovcnt_)
+    {
+        request.iov_->iov_base = static_cast<char*>(request.iov_->iov_base) + transferred;
+        request.iov_->iov_len -= transferred;
+    }
+    return !request.iovcnt_;
+}
+
+/**
+ * \brief Must be called under mutex_
+ */
+void AsyncFileIo::complete(const unsigned index, const int error)
+{
+    Request &request = requests_[index];
+    Batch &batch = *request.batch_;
+    if (error && !batch.error_)
+    {
+        batch.error_ = error;
+    }
+    --batch.outstanding_;
+    freeRequests_.push_back(index);
+    stateChangedCondition_.notify_all();
+}
+
+/**
+ * \brief Must be called under mutex_
+ */
+void AsyncFileIo::checkFailure() const
+{
+    if (failure_)
+    {
+        boost::rethrow_exception(failure_);
+    }
+}
+
+/**
+ * \brief Keeps the first failure. Wakes up everyone waiting as the failed thread won't complete their requests.
+ */
+void AsyncFileIo::fail(const boost::exception_ptr &failure)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_THREAD_CERR << "ERROR: asynchronous file i/o thread failed: " <<
+        boost::diagnostic_information(failure) << std::endl;
+    if (!failure_)
+    {
+        failure_ = failure;
+    }
+    stateChangedCondition_.notify_all();
+}
+
+/**
+ * \brief performs the blocking transfer of the whole request
+ *
+ * \return 0 or errno
+ */
+int AsyncFileIo::transfer(Request &request)
+{
+    while (request.iovcnt_)
+    {
+        const ssize_t transferred = request.write_ ?
+            pwritev(request.fd_, request.iov_, request.iovcnt_, request.offset_) :
+            preadv(request.fd_, request.iov_, request.iovcnt_, request.offset_);
+        if (0 > transferred)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return errno;
+        }
+        if (!transferred)
+        {
+            return request.write_ ? EIO : ENODATA;
+        }
+        advance(request, transferred);
+    }
+    return 0;
+}
+
+#ifdef iSAAC_ASYNC_FILE_IO_URING
+
+/**
+ * \brief Must be called under mutex_
+ */
+void AsyncFileIo::uringSubmit(const unsigned index)
+{
+    const Request &request = requests_[index];
+    if (const int error = uring_->submit(
+        request.write_ ? IORING_OP_WRITEV : IORING_OP_READV,
+        request.fd_, request.iov_, request.iovcnt_, request.offset_, index))
+    {
+        complete(index, error);
+    }
+}
+
+void AsyncFileIo::uringLoop()
+{
+    try
+    {
+        bool wokenUp = false;
+        while (!wokenUp)
+        {
+            uring_->waitCompletion();
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            uring_->consumeCompletions(
+                [this, &wokenUp](const uint64_t userData, const int result)
+                {
+                    if (Uring::WAKEUP == userData)
+                    {
+                        wokenUp = true;
+                        return;
+                    }
+                    const unsigned index = userData;
+                    Request &request = requests_[index];
+                    if (-EINTR == result || -EAGAIN == result)
+                    {
+                        uringSubmit(index);
+                    }
+                    else if (0 > result)
+                    {
+                        complete(index, -result);
+                    }
+                    else if (!result)
+                    {
+                        complete(index, request.write_ ? EIO : ENODATA);
+                    }
+                    else if (advance(request, result))
+                    {
+                        complete(index, 0);
+                    }
+                    else
+                    {
+                        // short transfer. Continue where it stopped
+                        uringSubmit(index);
+                    }
+                });
+        }
+    }
+    catch (...)
+    {
+        // the submitters get it from wait
+        fail(boost::current_exception());
+    }
+}
+
+#else //iSAAC_ASYNC_FILE_IO_URING
+
+void AsyncFileIo::uringSubmit(const unsigned index)
+{
+    ISAAC_ASSERT_MSG(false, "io_uring is not supported by this build");
+}
+
+void AsyncFileIo::uringLoop()
+{
+}
+
+#endif //iSAAC_ASYNC_FILE_IO_URING
+
+} // namespace io
+} // namespace isaac
@@ -0,0 +1,594 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file DeflateDecoder.cpp
+ **
+ ** Inflater for gzip data that can start at any deflate block of the stream.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "common/Debug.hh"
+#include "io/DeflateDecoder.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+static const unsigned LENGTH_BASE[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned LENGTH_EXTRA[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned DISTANCE_BASE[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned DISTANCE_EXTRA[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned CODE_LENGTH_ORDER[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+static const unsigned LENGTH_CODES = sizeof(LENGTH_BASE) / sizeof(LENGTH_BASE[0]);
+static const unsigned DISTANCE_CODES = sizeof(DISTANCE_BASE) / sizeof(DISTANCE_BASE[0]);
+static const unsigned CODE_LENGTH_CODES = sizeof(CODE_LENGTH_ORDER) / sizeof(CODE_LENGTH_ORDER[0]);
+static const unsigned END_OF_BLOCK = 256;
+// longest match plus a literal
+static const unsigned MAX_SYMBOLS_PER_CODE = 258;
+
+static const unsigned char GZIP_ID1 = 31;
+static const unsigned char GZIP_ID2 = 139;
+static const unsigned char GZIP_CM_DEFLATE = 8;
+static const unsigned char GZIP_FHCRC = 2;
+static const unsigned char GZIP_FEXTRA = 4;
+static const unsigned char GZIP_FNAME = 8;
+static const unsigned char GZIP_FCOMMENT = 16;
+static const unsigned char GZIP_RESERVED_FLAGS = 0xE0;
+
+/**
+ * \brief Builds the lookup table of a canonical Huffman code.
+ *
+ * \param allowIncomplete   same as zlib: permits an incomplete code if it consists of a single one-bit code, and
+ *                          an empty code (distances of literal-only blocks).
+ * \return false if the code is over-subscribed or incomplete
+ */
+bool DeflateDecoder::HuffmanTable::build(const unsigned char *lengths, const unsigned count, const bool allowIncomplete)
+{
+    unsigned counts[MAX_CODE_LENGTH + 1] = {0};
+    for (unsigned symbol = 0; count != symbol; ++symbol)
+    {
+        ++counts[lengths[symbol]];
+    }
+    counts[0] = 0;
+
+    maxLength_ = MAX_CODE_LENGTH;
+    while (maxLength_ && !counts[maxLength_])
+    {
+        --maxLength_;
+    }
+    if (!maxLength_)
+    {
+        table_[0] = 0;
+        return allowIncomplete;
+    }
+
+    int left = 1;
+    for (unsigned length = 1; MAX_CODE_LENGTH >= length; ++length)
+    {
+        left <<= 1;
+        left -= counts[length];
+        if (0 > left)
+        {
+            return false;
+        }
+    }
+    if (left && !(allowIncomplete && 1 == maxLength_))
+    {
+        return false;
+    }
+
+    std::fill(table_.begin(), table_.begin() + (1 << maxLength_), 0);
+    unsigned nextCode[MAX_CODE_LENGTH + 1] = {0};
+    for (unsigned length = 1, code = 0; MAX_CODE_LENGTH >= length; ++length)
+    {
+        code = (code + counts[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+
+    for (unsigned symbol = 0; count != symbol; ++symbol)
+    {
+        const unsigned length = lengths[symbol];
+        if (length)
+        {
+            // codes are stored most significant bit first while the stream is read least significant bit first
+            const unsigned code = nextCode[length]++;
+            unsigned reversed = 0;
+            for (unsigned bit = 0; length != bit; ++bit)
+            {
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            }
+            for (unsigned index = reversed; unsigned(1 << maxLength_) > index; index += 1 << length)
+            {
+                table_[index] = (symbol << 4) | length;
+            }
+        }
+    }
+    return true;
+}
+
+const DeflateDecoder::HuffmanTable &DeflateDecoder::fixedLiteralLengths()
+{
+    struct FixedTable : public HuffmanTable
+    {
+        FixedTable()
+        {
+            unsigned char lengths[288];
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            ISAAC_VERIFY_MSG(build(lengths, sizeof(lengths), false), "Failed to build fixed literal/length table");
+        }
+    };
+    static const FixedTable ret;
+    return ret;
+}
+
+const DeflateDecoder::HuffmanTable &DeflateDecoder::fixedDistances()
+{
+    struct FixedTable : public HuffmanTable
+    {
+        FixedTable()
+        {
+            unsigned char lengths[32];
+            std::fill(lengths, lengths + sizeof(lengths), 5);
+            ISAAC_VERIFY_MSG(build(lengths, sizeof(lengths), false), "Failed to build fixed distance table");
+        }
+    };
+    static const FixedTable ret;
+    return ret;
+}
+
+DeflateDecoder::DeflateDecoder() :
+    data_(0),
+    sizeBits_(0),
+    pos_(0),
+    output_(WINDOW_SIZE * 2),
+    outputSize_(0)
+{
+    // make sure fixed tables are built before threads start using them
+    fixedLiteralLengths();
+    fixedDistances();
+    resetOutput();
+}
+
+void DeflateDecoder::resetOutput(const char *window, const std::size_t windowSize)
+{
+    const std::size_t used = std::min<std::size_t>(windowSize, WINDOW_SIZE);
+    std::fill(output_.begin(), output_.begin() + WINDOW_SIZE - used, 0);
+    std::transform(window + windowSize - used, window + windowSize, output_.begin() + WINDOW_SIZE - used,
+                   [](const char c){return Symbol(static_cast<unsigned char>(c));});
+    outputSize_ = WINDOW_SIZE;
+    memberEnds_.clear();
+}
+
+void DeflateDecoder::resetOutput()
+{
+    for (unsigned i = 0; WINDOW_SIZE != i; ++i)
+    {
+        output_[i] = MARKER_BASE + i;
+    }
+    discardOutput();
+}
+
+void DeflateDecoder::discardOutput()
+{
+    outputSize_ = WINDOW_SIZE;
+    memberEnds_.clear();
+}
+
+bool DeflateDecoder::isMemberHeader(const boost::uint64_t bit) const
+{
+    if ((bit & 7) || sizeBits_ < bit + 24)
+    {
+        return false;
+    }
+    const unsigned char *p = data_ + (bit >> 3);
+    return GZIP_ID1 == p[0] && GZIP_ID2 == p[1] && GZIP_CM_DEFLATE == p[2];
+}
+
+/**
+ * \brief Cheap filter for the bit offsets worth a decoding attempt: member headers, non-final dynamic blocks
+ *        with valid table sizes and non-final stored blocks with matching LEN and NLEN. Fixed Huffman blocks have
+ *        no header that could be verified and are never used as a starting point.
+ */
+bool DeflateDecoder::isPlausibleBoundary(const boost::uint64_t bit) const
+{
+    if (isMemberHeader(bit))
+    {
+        return true;
+    }
+    if (sizeBits_ < bit + 17)
+    {
+        return false;
+    }
+    const boost::uint32_t header = peek(bit, 17);
+    if (header & 1)
+    {
+        return false;
+    }
+    const unsigned type = (header >> 1) & 3;
+    if (2 == type)
+    {
+        return 29 >= ((header >> 3) & 31) && 29 >= ((header >> 8) & 31);
+    }
+    if (0 == type)
+    {
+        const boost::uint64_t aligned = (bit + 3 + 7) & ~boost::uint64_t(7);
+        if (sizeBits_ < aligned + 32 || peek(bit + 3, aligned - bit - 3))
+        {
+            return false;
+        }
+        const boost::uint32_t lengths = peek(aligned, 32);
+        return (lengths & 0xFFFF) == (~(lengths >> 16) & 0xFFFF);
+    }
+    return false;
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeMemberHeader()
+{
+    ISAAC_ASSERT_MSG(!(pos_ & 7), "Gzip member header is expected at a byte boundary " << pos_);
+    const boost::uint64_t size = sizeBits_ >> 3;
+    boost::uint64_t byte = pos_ >> 3;
+    if (size < byte + 10)
+    {
+        return EndOfInput;
+    }
+    const unsigned char *header = data_ + byte;
+    if (GZIP_ID1 != header[0] || GZIP_ID2 != header[1] || GZIP_CM_DEFLATE != header[2] || (header[3] & GZIP_RESERVED_FLAGS))
+    {
+        return Invalid;
+    }
+    const unsigned char flags = header[3];
+    byte += 10;
+    if (flags & GZIP_FEXTRA)
+    {
+        if (size < byte + 2)
+        {
+            return EndOfInput;
+        }
+        byte += 2 + (data_[byte] | (unsigned(data_[byte + 1]) << 8));
+    }
+    if (flags & GZIP_FNAME)
+    {
+        while (size > byte && data_[byte])
+        {
+            ++byte;
+        }
+        ++byte;
+    }
+    if (flags & GZIP_FCOMMENT)
+    {
+        while (size > byte && data_[byte])
+        {
+            ++byte;
+        }
+        ++byte;
+    }
+    if (flags & GZIP_FHCRC)
+    {
+        byte += 2;
+    }
+    if (size < byte)
+    {
+        return EndOfInput;
+    }
+    pos_ = byte * 8;
+    return Stopped;
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeMemberTrailer()
+{
+    pos_ = (pos_ + 7) & ~boost::uint64_t(7);
+    if (!available(64))
+    {
+        return EndOfInput;
+    }
+    const MemberEnd memberEnd = {decodedSize(), read(32), read(32)};
+    memberEnds_.push_back(memberEnd);
+    return Stopped;
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeStoredBlock()
+{
+    pos_ = (pos_ + 7) & ~boost::uint64_t(7);
+    if (!available(32))
+    {
+        return EndOfInput;
+    }
+    const unsigned length = read(16);
+    if (length != (~read(16) & 0xFFFF))
+    {
+        return Invalid;
+    }
+    if (!available(length * 8))
+    {
+        return EndOfInput;
+    }
+    reserveOutput(length);
+    const unsigned char *p = data_ + (pos_ >> 3);
+    std::copy(p, p + length, output_.begin() + outputSize_);
+    outputSize_ += length;
+    pos_ += length * 8;
+    return Stopped;
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeDynamicTables()
+{
+    if (!available(14))
+    {
+        return EndOfInput;
+    }
+    const unsigned literalLengthCodes = read(5) + 257;
+    const unsigned distanceCodes = read(5) + 1;
+    const unsigned codeLengthCodes = read(4) + 4;
+    if (286 < literalLengthCodes || DISTANCE_CODES < distanceCodes)
+    {
+        return Invalid;
+    }
+
+    if (!available(codeLengthCodes * 3))
+    {
+        return EndOfInput;
+    }
+    unsigned char lengths[286 + 30] = {0};
+    for (unsigned i = 0; codeLengthCodes != i; ++i)
+    {
+        lengths[CODE_LENGTH_ORDER[i]] = read(3);
+    }
+    if (!codeLengths_.build(lengths, CODE_LENGTH_CODES, false))
+    {
+        return Invalid;
+    }
+
+    const unsigned total = literalLengthCodes + distanceCodes;
+    for (unsigned i = 0; total != i;)
+    {
+        const boost::uint16_t entry = codeLengths_.table_[peek(codeLengths_.maxLength_)];
+        if (!entry)
+        {
+            return Invalid;
+        }
+        if (!available(entry & 15))
+        {
+            return EndOfInput;
+        }
+        pos_ += entry & 15;
+        const unsigned symbol = entry >> 4;
+        if (16 > symbol)
+        {
+            lengths[i++] = symbol;
+            continue;
+        }
+
+        unsigned char length = 0;
+        unsigned repeat = 0;
+        if (16 == symbol)
+        {
+            if (!i)
+            {
+                return Invalid;
+            }
+            if (!available(2))
+            {
+                return EndOfInput;
+            }
+            length = lengths[i - 1];
+            repeat = 3 + read(2);
+        }
+        else if (17 == symbol)
+        {
+            if (!available(3))
+            {
+                return EndOfInput;
+            }
+            repeat = 3 + read(3);
+        }
+        else
+        {
+            if (!available(7))
+            {
+                return EndOfInput;
+            }
+            repeat = 11 + read(7);
+        }
+        if (total < i + repeat)
+        {
+            return Invalid;
+        }
+        std::fill(lengths + i, lengths + i + repeat, length);
+        i += repeat;
+    }
+
+    if (!lengths[END_OF_BLOCK] ||
+        !literalLengths_.build(lengths, literalLengthCodes, true) ||
+        !distances_.build(lengths + literalLengthCodes, distanceCodes, true))
+    {
+        return Invalid;
+    }
+    return Stopped;
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeCompressedData(
+    const HuffmanTable &literalLengths, const HuffmanTable &distances)
+{
+    const boost::uint16_t *literalLengthTable = &literalLengths.table_.front();
+    const unsigned literalLengthBits = literalLengths.maxLength_;
+    const boost::uint16_t *distanceTable = &distances.table_.front();
+    const unsigned distanceBits = distances.maxLength_;
+    while (true)
+    {
+        reserveOutput(MAX_SYMBOLS_PER_CODE);
+        const boost::uint16_t entry = literalLengthTable[peek(literalLengthBits)];
+        if (!entry)
+        {
+            return Invalid;
+        }
+        if (!available(entry & 15))
+        {
+            return EndOfInput;
+        }
+        pos_ += entry & 15;
+        unsigned symbol = entry >> 4;
+        if (END_OF_BLOCK > symbol)
+        {
+            output_[outputSize_++] = symbol;
+            continue;
+        }
+        if (END_OF_BLOCK == symbol)
+        {
+            return Stopped;
+        }
+
+        symbol -= END_OF_BLOCK + 1;
+        if (LENGTH_CODES <= symbol)
+        {
+            return Invalid;
+        }
+        if (!available(LENGTH_EXTRA[symbol]))
+        {
+            return EndOfInput;
+        }
+        const unsigned length = LENGTH_BASE[symbol] + read(LENGTH_EXTRA[symbol]);
+
+        const boost::uint16_t distanceEntry = distanceTable[peek(distanceBits)];
+        if (!distanceEntry)
+        {
+            return Invalid;
+        }
+        if (!available(distanceEntry & 15))
+        {
+            return EndOfInput;
+        }
+        pos_ += distanceEntry & 15;
+        const unsigned distanceSymbol = distanceEntry >> 4;
+        if (DISTANCE_CODES <= distanceSymbol)
+        {
+            return Invalid;
+        }
+        if (!available(DISTANCE_EXTRA[distanceSymbol]))
+        {
+            return EndOfInput;
+        }
+        const unsigned distance = DISTANCE_BASE[distanceSymbol] + read(DISTANCE_EXTRA[distanceSymbol]);
+        if (outputSize_ < distance)
+        {
+            return Invalid;
+        }
+
+        // overlapping copies are expected to repeat the pattern, so go symbol by symbol
+        Symbol *to = &output_[outputSize_];
+        const Symbol *from = to - distance;
+        for (unsigned i = 0; length != i; ++i)
+        {
+            to[i] = from[i];
+        }
+        outputSize_ += length;
+    }
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeBlock(bool &final)
+{
+    if (!available(3))
+    {
+        return EndOfInput;
+    }
+    final = read(1);
+    switch (read(2))
+    {
+    case 0:
+        return decodeStoredBlock();
+    case 1:
+        return decodeCompressedData(fixedLiteralLengths(), fixedDistances());
+    case 2:
+    {
+        const Status status = decodeDynamicTables();
+        return Stopped == status ? decodeCompressedData(literalLengths_, distances_) : status;
+    }
+    default:
+        return Invalid;
+    }
+}
+
+DeflateDecoder::Status DeflateDecoder::decode(const Boundary &start, const boost::uint64_t stopBit)
+{
+    begin_ = start;
+    end_ = start;
+    pos_ = start.bit_;
+    while (stopBit > end_.bit_)
+    {
+        const std::size_t outputMark = outputSize_;
+        const std::size_t memberEndsMark = memberEnds_.size();
+        Status status = EndOfInput;
+        bool memberStart = false;
+        if (end_.memberStart_)
+        {
+            if (available(8))
+            {
+                status = decodeMemberHeader();
+            }
+        }
+        else
+        {
+            bool final = false;
+            status = decodeBlock(final);
+            if (Stopped == status && final)
+            {
+                status = decodeMemberTrailer();
+                memberStart = true;
+            }
+        }
+
+        if (Stopped != status)
+        {
+            pos_ = end_.bit_;
+            outputSize_ = outputMark;
+            memberEnds_.resize(memberEndsMark);
+            return status;
+        }
+        end_ = Boundary(pos_, memberStart);
+    }
+    return Stopped;
+}
+
+DeflateDecoder::Status DeflateDecoder::decodeFromFirstBoundary(
+    const boost::uint64_t fromBit, const boost::uint64_t toBit, const boost::uint64_t stopBit)
+{
+    // decoding never overwrites the window, so the markers stay in place between the attempts
+    resetOutput();
+    for (boost::uint64_t bit = fromBit; toBit > bit; ++bit)
+    {
+        if (isPlausibleBoundary(bit))
+        {
+            discardOutput();
+            const Status status = decode(Boundary(bit, isMemberHeader(bit)), stopBit);
+            if (Invalid != status && end_.bit_ != bit)
+            {
+                return status;
+            }
+        }
+    }
+    discardOutput();
+    begin_ = end_ = Boundary(toBit, false);
+    return Invalid;
+}
+
+} // namespace io
+} // namespace isaac
@@ -16,7 +16,12 @@
  **
  ** \author Roman Petrovski
  **/
-//#include <xmmintrin.h>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif //__SSE2__
+
 #include <boost/bind.hpp>
 
 #include "common/Debug.hh"
@@ -28,7 +33,8 @@ namespace isaac
 namespace io
 {
 
-FastqReader::FastqReader(const bool allowVariableLength, const unsigned threadsMax, const std::size_t maxPathLength) :
+FastqReader::FastqReader(
+    const bool allowVariableLength, const unsigned threadsMax, const bool parallelGzip, const std::size_t maxPathLength) :
     // The uncompressed buffer can be fairly small for flat and gzipped fastq, however we need a decent amount of
     // space for parallel decompression to be effective with bgzf-compressed fastq.
     uncompressedBufferSize_(std::size_t(bgzf::BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE) * threadsMax * BGZF_BLOCKS_PER_THREAD),
@@ -38,11 +44,17 @@ FastqReader::FastqReader(const bool allowVariableLength, const unsigned threadsM
     gzReader_(),
     // give the threads a chance to rebalance if some of the blocks take longer to uncompress
     bgzfReader_(threadsMax, BGZF_BLOCKS_PER_THREAD / 8),
+    parallelGz_(parallelGzip && 1 < threadsMax),
+    parallelGzReader_(parallelGz_ ? threadsMax : 1),
     fastqPath_(std::string(maxPathLength, ' ')),
     compressed_(false),
     bgzfCompressed_(false),
     reachedEof_(false),
     filePos_(0),
+    mapped_(false),
+    releasedBytes_(0),
+    dataBegin_(0),
+    dataEnd_(0),
     zeroLengthRead_(false)
 {
     ISAAC_THREAD_CERR << "FastqReader uncompressedBufferSize_=" << uncompressedBufferSize_ << std::endl;
@@ -53,12 +65,47 @@ FastqReader::FastqReader(const bool allowVariableLength, const unsigned threadsM
 void FastqReader::resetBuffer()
 {
     buffer_.resize(uncompressedBufferSize_);
-    headerBegin_ = buffer_.end();
-    headerEnd_ = buffer_.end();
-    baseCallsBegin_ = buffer_.end();
-    baseCallsEnd_ = buffer_.end();
-    qScoresBegin_ = buffer_.end();
-    endIt_ = buffer_.end();
+    dataBegin_ = &buffer_.front();
+    dataEnd_ = dataBegin_ + buffer_.size();
+    headerBegin_ = dataEnd_;
+    headerEnd_ = dataEnd_;
+    baseCallsBegin_ = dataEnd_;
+    baseCallsEnd_ = dataEnd_;
+    qScoresBegin_ = dataEnd_;
+    endIt_ = dataEnd_;
+}
+
+/**
+ * \brief Makes the whole file the parsed data. fetchMore has nothing to add to it.
+ */
+void FastqReader::mapFile()
+{
+    mappedFile_ = common::MemoryMappedFile(fastqPath_, common::MemoryMappedFile::Sequential);
+    releasedBytes_ = 0;
+    filePos_ = mappedFile_.size();
+    dataBegin_ = mappedFile_.data();
+    dataEnd_ = dataBegin_ + mappedFile_.size();
+    headerBegin_ = dataBegin_;
+    headerEnd_ = dataBegin_;
+    baseCallsBegin_ = dataBegin_;
+    baseCallsEnd_ = dataBegin_;
+    qScoresBegin_ = dataBegin_;
+    endIt_ = dataBegin_;
+    reachedEof_ = true;
+}
+
+/**
+ * \brief Drops the pages the parsing has moved past. They come back from the page cache if anyone touches them.
+ */
+void FastqReader::releaseMapped()
+{
+    const std::size_t parsed = std::distance(dataBegin_, headerBegin_);
+    if (parsed >= releasedBytes_ + MAPPED_RELEASE_BYTES)
+    {
+        const std::size_t release = (parsed - releasedBytes_) / MAPPED_RELEASE_BYTES * MAPPED_RELEASE_BYTES;
+        mappedFile_.advise(common::MemoryMappedFile::DontNeed, releasedBytes_, release);
+        releasedBytes_ += release;
+    }
 }
 
 void FastqReader::open(
@@ -72,6 +119,18 @@ void FastqReader::open(
         fastqPath_ = fastqPath.c_str();
         q0Base_ = q0Base;
         compressed_ = common::isDotGzPath(fastqPath_);
+        mappedFile_ = common::MemoryMappedFile();
+        // pipes and other special files don't map
+        mapped_ = !compressed_ && boost::filesystem::is_regular_file(fastqPath);
+        if (mapped_)
+        {
+            bgzfCompressed_ = false;
+            mapFile();
+            next();
+            ISAAC_THREAD_CERR << "Opened mapped fastq on " << fastqPath_ << " and base Q0 " << q0Base_ << std::endl;
+            return;
+        }
+
         if (!fileBuffer_.reopen(fastqPath_.c_str(), FileBufWithReopen::SequentialOnce))
         {
             BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to reopen fastq file %s : %s") %
@@ -79,6 +138,7 @@ void FastqReader::open(
         }
         buffer_.resize(uncompressedBufferSize_);
         gzReader_.reset();
+        parallelGzReader_.reset();
         filePos_ = 0;
 
         if (fileBuffer_.is_open())
@@ -102,10 +162,9 @@ void FastqReader::open(
     }
 }
 
-std::size_t FastqReader::getOffset(BufferType::const_iterator it) const
+std::size_t FastqReader::getOffset(DataIterator it) const
 {
-    const BufferType::const_iterator begin = buffer_.begin();
-    return filePos_ - buffer_.size() + std::distance(begin, it);
+    return filePos_ - std::distance(dataBegin_, dataEnd_) + std::distance(dataBegin_, it);
 }
 
 template <typename IteratorT>
@@ -117,18 +176,33 @@ IteratorT findNotNewLine(IteratorT itBegin, IteratorT itEnd)
          boost::bind(std::not_equal_to<char>(), '\n', _1));
 }
 
-template <typename IteratorT>
-IteratorT findNewLine(IteratorT itBegin, IteratorT itEnd)
+/**
+ * \brief Lines are mostly long enough for the 16 bytes at a time scan to pay off
+ */
+inline const char *findNewLine(const char *itBegin, const char *const itEnd)
 {
+#ifdef __SSE2__
+    const __m128i n = _mm_set1_epi8('\n');
+    const __m128i r = _mm_set1_epi8('\r');
+    for (; itEnd - itBegin >= long(sizeof(__m128i)); itBegin += sizeof(__m128i))
+    {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(itBegin));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, n), _mm_cmpeq_epi8(chars, r)));
+        if (mask)
+        {
+            return itBegin + __builtin_ctz(mask);
+        }
+    }
+#endif //__SSE2__
     static const char *rn = "\n\r";
     return std::find_first_of(itBegin, itEnd, rn, rn+2);
 }
 
 void FastqReader::findHeader()
 {
-//    ISAAC_THREAD_CERR << "FastqReader::findHeader " << std::string(endIt_, endIt_ + std::min(300L, std::distance<BufferType::const_iterator>(endIt_, buffer_.end()))) << std::endl;
-    headerBegin_ = findNotNewLine(endIt_, BufferType::const_iterator(buffer_.end()));
-    if (buffer_.end() == headerBegin_)
+//    ISAAC_THREAD_CERR << "FastqReader::findHeader " << std::string(endIt_, endIt_ + std::min(300L, std::distance<DataIterator>(endIt_, buffer_.end()))) << std::endl;
+    headerBegin_ = findNotNewLine(endIt_, dataEnd_);
+    if (dataEnd_ == headerBegin_)
     {
         // We've reached the end of the buffer before we reached the beginning of the next record
         if (!fetchMore())
@@ -136,8 +210,8 @@ void FastqReader::findHeader()
             return;
         }
         // TODO: this allows more than one newline which is against fastq format
-        headerBegin_ = findNotNewLine(headerBegin_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == headerBegin_)
+        headerBegin_ = findNotNewLine(headerBegin_, dataEnd_);
+        if (dataEnd_ == headerBegin_)
         {
             if (reachedEof_)
             {
@@ -148,8 +222,8 @@ void FastqReader::findHeader()
                 getPath() % getOffset(headerBegin_)).str()));
         }
     }
-    headerEnd_ = findNewLine(headerBegin_, BufferType::const_iterator(buffer_.end()));
-    if (buffer_.end() == headerEnd_)
+    headerEnd_ = findNewLine(headerBegin_, dataEnd_);
+    if (dataEnd_ == headerEnd_)
     {
         // We've reached the end of the buffer before we reached the end of the header
         if (!fetchMore())
@@ -157,8 +231,8 @@ void FastqReader::findHeader()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while reading the header line: %s, offset %u") %
                 getPath() % getOffset(headerEnd_)).str()));
         }
-        headerEnd_ = findNewLine(headerEnd_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == headerEnd_)
+        headerEnd_ = findNewLine(headerEnd_, dataEnd_);
+        if (dataEnd_ == headerEnd_)
         {
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq header too long to fit in the buffer: %s, offset %u") %
                 getPath() % getOffset(baseCallsBegin_)).str()));
@@ -168,8 +242,8 @@ void FastqReader::findHeader()
 
 void FastqReader::findSequence()
 {
-    baseCallsBegin_ = findNotNewLine(headerEnd_, BufferType::const_iterator(buffer_.end()));
-    if (buffer_.end() == baseCallsBegin_)
+    baseCallsBegin_ = findNotNewLine(headerEnd_, dataEnd_);
+    if (dataEnd_ == baseCallsBegin_)
     {
         // We've reached the end of the buffer before we reached the beginning of the sequence
         if (!fetchMore())
@@ -177,8 +251,8 @@ void FastqReader::findSequence()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while looking for sequence start: %s, offset %u") %
                 getPath() % getOffset(baseCallsBegin_)).str()));
         }
-        baseCallsBegin_ = findNotNewLine(baseCallsBegin_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == baseCallsBegin_)
+        baseCallsBegin_ = findNotNewLine(baseCallsBegin_, dataEnd_);
+        if (dataEnd_ == baseCallsBegin_)
         {
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format(
                 "Too many newline characters in fastq to fit in the buffer while looking for sequence start: %s, offset %u") %
@@ -195,9 +269,9 @@ void FastqReader::findSequence()
     else
     {
         zeroLengthRead_ = false;
-        baseCallsEnd_ = findNewLine(baseCallsBegin_, BufferType::const_iterator(buffer_.end()));
+        baseCallsEnd_ = findNewLine(baseCallsBegin_, dataEnd_);
     }
-    if (buffer_.end() == baseCallsEnd_)
+    if (dataEnd_ == baseCallsEnd_)
     {
         // We've reached the end of the buffer before we reached the end of the sequence
         if (!fetchMore())
@@ -205,8 +279,8 @@ void FastqReader::findSequence()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while reading the sequence line: %s, offset %u") %
                 getPath() % getOffset(baseCallsEnd_)).str()));
         }
-        baseCallsEnd_ = findNewLine(baseCallsEnd_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == baseCallsEnd_)
+        baseCallsEnd_ = findNewLine(baseCallsEnd_, dataEnd_);
+        if (dataEnd_ == baseCallsEnd_)
         {
 //            ISAAC_THREAD_CERR << " findSequence " << std::string(buffer_.begin(), buffer_.end()) << " buffer_.size()=" << buffer_.size() << std::endl;
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq sequence too long to fit in the buffer: %s, offset %u") %
@@ -217,8 +291,8 @@ void FastqReader::findSequence()
 
 void FastqReader::findQScores()
 {
-    qScoresBegin_ = findNotNewLine(baseCallsEnd_, BufferType::const_iterator(buffer_.end()));
-    if (buffer_.end() == qScoresBegin_)
+    qScoresBegin_ = findNotNewLine(baseCallsEnd_, dataEnd_);
+    if (dataEnd_ == qScoresBegin_)
     {
         // We've reached the end of the buffer before we reached the beginning of the sequence
         if (!fetchMore())
@@ -226,8 +300,8 @@ void FastqReader::findQScores()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while looking for + sign: %s, offset %u") %
                 getPath() % getOffset(qScoresBegin_)).str()));
         }
-        qScoresBegin_ = findNotNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == qScoresBegin_)
+        qScoresBegin_ = findNotNewLine(qScoresBegin_, dataEnd_);
+        if (dataEnd_ == qScoresBegin_)
         {
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format(
                 "Too many newline characters in fastq to fit in the buffer while looking for + sign: %s, offset %u") %
@@ -242,10 +316,10 @@ void FastqReader::findQScores()
             getPath() % getOffset(qScoresBegin_)).str()));
     }
     // in some fastq files (like the ones produced by sra tools) + is followed by the header string. Just skip to the newline...
-    qScoresBegin_ = findNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
+    qScoresBegin_ = findNewLine(qScoresBegin_, dataEnd_);
 
-    qScoresBegin_ = findNotNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
-    if (buffer_.end() == qScoresBegin_)
+    qScoresBegin_ = findNotNewLine(qScoresBegin_, dataEnd_);
+    if (dataEnd_ == qScoresBegin_)
     {
         // We've reached the end of the buffer before we reached the beginning of the qscores
         if (!fetchMore())
@@ -253,8 +327,8 @@ void FastqReader::findQScores()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while looking for qscores: %s, offset %u") %
                 getPath() % getOffset(qScoresBegin_)).str()));
         }
-        qScoresBegin_ = findNotNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == qScoresBegin_)
+        qScoresBegin_ = findNotNewLine(qScoresBegin_, dataEnd_);
+        if (dataEnd_ == qScoresBegin_)
         {
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format(
                 "Too many newline characters in fastq to fit in the buffer while looking for qscores: %s, offset %u") %
@@ -271,21 +345,28 @@ void FastqReader::findQScoresEnd()
     }
     else
     {
-        endIt_ = findNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
-        if (buffer_.end() == endIt_)
+        endIt_ = findNewLine(qScoresBegin_, dataEnd_);
+        if (dataEnd_ == endIt_)
         {
             // We've reached the end of the buffer before we reached the newline...
             if (!fetchMore())
             {
                 return;
             }
-            endIt_ = findNewLine(endIt_, BufferType::const_iterator(buffer_.end()));
+            endIt_ = findNewLine(endIt_, dataEnd_);
         }
     }
 }
 
 std::size_t FastqReader::readCompressedFastq(std::istream &is, char *buffer, std::size_t amount)
 {
+    if (parallelGz_)
+    {
+        const std::size_t ret = parallelGzReader_.readMoreData(is, buffer, amount);
+        reachedEof_ = parallelGzReader_.isEof();
+        return ret;
+    }
+
     const std::size_t decompressedBytes = gzReader_.read(is, 0, buffer, amount);
     reachedEof_ = is.eof();
     return decompressedBytes;
@@ -348,10 +429,11 @@ bool FastqReader::fetchMore()
     }
 
     // move the remaining data to the start of the buffer
-    std::copy(headerBegin_, BufferType::const_iterator(buffer_.end()),  buffer_.begin());
-    const std::size_t moved = std::distance(headerBegin_, BufferType::const_iterator(buffer_.end()));
+    std::copy(headerBegin_, dataEnd_,  buffer_.begin());
+    // buffer_ never reallocates as the capacity is reserved upfront
+    const std::size_t moved = std::distance(headerBegin_, dataEnd_);
 //    ISAAC_THREAD_CERR << "fetchMore moved=" << moved << " in buffer of size " << buffer_.size() << std::endl;
-    const std::size_t distance = std::distance(BufferType::const_iterator(buffer_.begin()), headerBegin_);
+    const std::size_t distance = std::distance(dataBegin_, headerBegin_);
     if (!distance)
     {
         BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
@@ -382,6 +464,7 @@ bool FastqReader::fetchMore()
 
         filePos_ += readBytes;
         buffer_.resize(moved + readBytes);
+        dataEnd_ = dataBegin_ + buffer_.size();
     }
     catch (boost::exception &e)
     {
@@ -393,8 +476,12 @@ bool FastqReader::fetchMore()
 
 void FastqReader::next()
 {
+    if (mapped_)
+    {
+        releaseMapped();
+    }
     findHeader();
-    if (buffer_.end() == headerBegin_)
+    if (dataEnd_ == headerBegin_)
     {
         return;
     }
@@ -0,0 +1,274 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ParallelGzipReader.cpp
+ **
+ ** Multithreaded decompression of ordinary (non-bgzf) gzip streams.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <zlib.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "io/ParallelGzipReader.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+ParallelGzipReader::ParallelGzipReader(const unsigned coresMax) :
+    coresMax_(coresMax),
+    threads_(coresMax_),
+    decoders_(coresMax_),
+    statuses_(coresMax_, DeflateDecoder::Invalid),
+    windows_(coresMax_ + 1, std::vector<char>(DeflateDecoder::WINDOW_SIZE)),
+    crcSegments_(coresMax_),
+    uncompressedOffsets_(coresMax_ + 1),
+    compressedSize_(0),
+    compressedOffset_(0),
+    inputEof_(false),
+    streamEnd_(false),
+    uncompressedPos_(0),
+    memberCrc_(0),
+    memberSize_(0)
+{
+    compressed_.reserve(coresMax_ * CHUNK_SIZE + DeflateDecoder::INPUT_PADDING);
+    reset();
+}
+
+void ParallelGzipReader::reset()
+{
+    compressedSize_ = 0;
+    compressedOffset_ = 0;
+    inputEof_ = false;
+    streamEnd_ = false;
+    next_ = Boundary(0, true);
+    std::fill(windows_.front().begin(), windows_.front().end(), 0);
+    uncompressed_.clear();
+    uncompressedPos_ = 0;
+    memberCrc_ = crc32(0L, Z_NULL, 0);
+    memberSize_ = 0;
+}
+
+/**
+ * \brief drops the compressed data before next_ and tops up the buffer from the stream
+ */
+void ParallelGzipReader::loadCompressed(std::istream &is)
+{
+    const std::size_t consumed = next_.bit_ / 8;
+    std::copy(compressed_.begin() + consumed, compressed_.begin() + compressedSize_, compressed_.begin());
+    compressedSize_ -= consumed;
+    compressedOffset_ += consumed;
+    next_.bit_ -= consumed * 8;
+
+    if (!inputEof_)
+    {
+        // grow if a pass could not make progress with what is loaded
+        const std::size_t target = std::max(coresMax_ * CHUNK_SIZE, compressedSize_ + CHUNK_SIZE);
+        compressed_.resize(target + DeflateDecoder::INPUT_PADDING);
+        is.read(reinterpret_cast<char *>(&compressed_.front()) + compressedSize_, target - compressedSize_);
+        if (!is.good() && !is.eof())
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to read compressed data"));
+        }
+        compressedSize_ += is.gcount();
+        inputEof_ = is.eof();
+    }
+    std::fill(compressed_.begin() + compressedSize_, compressed_.end(), 0);
+}
+
+void ParallelGzipReader::decodeChunk(const unsigned threadNumber, const unsigned chunks)
+{
+    const boost::uint64_t dataBits = boost::uint64_t(compressedSize_) * 8;
+    const boost::uint64_t span = dataBits - next_.bit_;
+    const boost::uint64_t from = next_.bit_ + span * threadNumber / chunks;
+    const boost::uint64_t stop = chunks == threadNumber + 1 ? dataBits : next_.bit_ + span * (threadNumber + 1) / chunks;
+
+    DeflateDecoder &decoder = decoders_.at(threadNumber);
+    decoder.setInput(&compressed_.front(), compressedSize_);
+    if (!threadNumber)
+    {
+        decoder.resetOutput(&windows_.front().front(), windows_.front().size());
+        statuses_[threadNumber] = decoder.decode(next_, stop);
+    }
+    else
+    {
+        statuses_[threadNumber] = decoder.decodeFromFirstBoundary(from, stop, stop);
+    }
+}
+
+/**
+ * \return number of leading chunks in which each chunk starts where the previous one stopped
+ */
+unsigned ParallelGzipReader::acceptChunks(const unsigned chunks) const
+{
+    if (DeflateDecoder::Invalid == statuses_.front())
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+            "Invalid gzip data near compressed offset %u") %
+            (compressedOffset_ + decoders_.front().end().bit_ / 8)).str()));
+    }
+
+    unsigned ret = 1;
+    while (chunks > ret &&
+        DeflateDecoder::Stopped == statuses_[ret - 1] &&
+        DeflateDecoder::Invalid != statuses_[ret] &&
+        decoders_[ret].begin() == decoders_[ret - 1].end())
+    {
+        ++ret;
+    }
+    return ret;
+}
+
+/**
+ * \brief Each window is the last WINDOW_SIZE bytes of the data preceding the chunk. Only the tail of each chunk
+ *        needs resolving to produce the window of the next one.
+ */
+void ParallelGzipReader::resolveWindows(const unsigned chunks)
+{
+    for (unsigned chunk = 0; chunks != chunk; ++chunk)
+    {
+        const DeflateDecoder &decoder = decoders_[chunk];
+        const DeflateDecoder::Symbol *tail = decoder.output() + decoder.outputSize() - DeflateDecoder::WINDOW_SIZE;
+        const std::vector<char> &window = windows_[chunk];
+        std::vector<char> &nextWindow = windows_[chunk + 1];
+        for (unsigned i = 0; DeflateDecoder::WINDOW_SIZE != i; ++i)
+        {
+            nextWindow[i] = DeflateDecoder::MARKER_BASE > tail[i] ? tail[i] : window[tail[i] - DeflateDecoder::MARKER_BASE];
+        }
+    }
+}
+
+void ParallelGzipReader::resolveChunk(const unsigned threadNumber, const unsigned chunks)
+{
+    for (unsigned chunk = threadNumber; chunks > chunk; chunk += coresMax_)
+    {
+        const DeflateDecoder &decoder = decoders_[chunk];
+        const DeflateDecoder::Symbol *symbols = decoder.output() + DeflateDecoder::WINDOW_SIZE;
+        const std::vector<char> &window = windows_[chunk];
+        char *out = uncompressed_.data() + uncompressedOffsets_[chunk];
+        for (std::size_t i = 0; decoder.decodedSize() != i; ++i)
+        {
+            out[i] = DeflateDecoder::MARKER_BASE > symbols[i] ? symbols[i] : window[symbols[i] - DeflateDecoder::MARKER_BASE];
+        }
+
+        std::vector<CrcSegment> &segments = crcSegments_[chunk];
+        segments.clear();
+        std::size_t segmentBegin = 0;
+        BOOST_FOREACH(const DeflateDecoder::MemberEnd &memberEnd, decoder.memberEnds())
+        {
+            segments.push_back(CrcSegment(
+                crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(out + segmentBegin), memberEnd.end_ - segmentBegin),
+                memberEnd.end_ - segmentBegin));
+            segmentBegin = memberEnd.end_;
+        }
+        segments.push_back(CrcSegment(
+            crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(out + segmentBegin), decoder.decodedSize() - segmentBegin),
+            decoder.decodedSize() - segmentBegin));
+    }
+}
+
+void ParallelGzipReader::verifyMembers(const unsigned chunks)
+{
+    for (unsigned chunk = 0; chunks != chunk; ++chunk)
+    {
+        const std::vector<DeflateDecoder::MemberEnd> &memberEnds = decoders_[chunk].memberEnds();
+        const std::vector<CrcSegment> &segments = crcSegments_[chunk];
+        for (std::size_t i = 0; segments.size() != i; ++i)
+        {
+            memberCrc_ = crc32_combine(memberCrc_, segments[i].first, segments[i].second);
+            memberSize_ += segments[i].second;
+            if (memberEnds.size() != i)
+            {
+                if (memberEnds[i].crc32_ != memberCrc_ || memberEnds[i].isize_ != boost::uint32_t(memberSize_))
+                {
+                    BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+                        "Gzip member check failed near compressed offset %u. crc32 %x, expected %x, size %u, expected %u") %
+                        (compressedOffset_ + decoders_[chunk].end().bit_ / 8) %
+                        memberCrc_ % memberEnds[i].crc32_ % boost::uint32_t(memberSize_) % memberEnds[i].isize_).str()));
+                }
+                memberCrc_ = crc32(0L, Z_NULL, 0);
+                memberSize_ = 0;
+            }
+        }
+    }
+}
+
+void ParallelGzipReader::decompressMore(std::istream &is)
+{
+    loadCompressed(is);
+
+    const boost::uint64_t dataBits = boost::uint64_t(compressedSize_) * 8;
+    const boost::uint64_t chunkBits = boost::uint64_t(CHUNK_SIZE) * 8;
+    const unsigned chunks = std::min<boost::uint64_t>(
+        coresMax_, std::max<boost::uint64_t>(1, (dataBits - next_.bit_ + chunkBits - 1) / chunkBits));
+    threads_.execute(boost::bind(&ParallelGzipReader::decodeChunk, this, _1, chunks), chunks);
+
+    const unsigned accepted = acceptChunks(chunks);
+    resolveWindows(accepted);
+
+    uncompressedOffsets_[0] = 0;
+    for (unsigned chunk = 0; accepted != chunk; ++chunk)
+    {
+        uncompressedOffsets_[chunk + 1] = uncompressedOffsets_[chunk] + decoders_[chunk].decodedSize();
+    }
+    uncompressed_.resize(uncompressedOffsets_[accepted]);
+    uncompressedPos_ = 0;
+    threads_.execute(boost::bind(&ParallelGzipReader::resolveChunk, this, _1, accepted), accepted);
+    verifyMembers(accepted);
+
+    const Boundary previous = next_;
+    next_ = decoders_[accepted - 1].end();
+    windows_.front().swap(windows_[accepted]);
+
+    if (inputEof_ && next_.memberStart_ && dataBits == next_.bit_)
+    {
+        streamEnd_ = true;
+    }
+    else if (inputEof_ && previous == next_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+            "Truncated gzip data at compressed offset %u") % (compressedOffset_ + next_.bit_ / 8)).str()));
+    }
+}
+
+std::size_t ParallelGzipReader::readMoreData(std::istream &is, char *buffer, const std::size_t capacity)
+{
+    std::size_t ret = 0;
+    while (capacity != ret)
+    {
+        if (uncompressed_.size() == uncompressedPos_)
+        {
+            if (streamEnd_)
+            {
+                break;
+            }
+            decompressMore(is);
+            continue;
+        }
+        const std::size_t available = std::min(capacity - ret, uncompressed_.size() - uncompressedPos_);
+        std::copy(uncompressed_.begin() + uncompressedPos_, uncompressed_.begin() + uncompressedPos_ + available, buffer + ret);
+        uncompressedPos_ += available;
+        ret += available;
+    }
+    return ret;
+}
+
+} // namespace io
+} // namespace isaac
@@ -0,0 +1,215 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ReadAheadFileBuf.cpp
+ **
+ ** Input streambuf that keeps reads of the following blocks in flight while the current one is consumed.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "common/Debug.hh"
+#include "io/ReadAheadFileBuf.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+const std::size_t ReadAheadFileBuf::BLOCK_BYTES;
+const unsigned ReadAheadFileBuf::BLOCKS;
+const std::size_t ReadAheadFileBuf::DIRECT_READ_BYTES;
+const std::size_t ReadAheadFileBuf::MEMORY_REQUIREMENTS;
+
+ReadAheadFileBuf::ReadAheadFileBuf(AsyncFileIo &asyncIo) :
+    asyncIo_(asyncIo), fd_(-1), fileSize_(0), buffer_(MEMORY_REQUIREMENTS), start_(0), consumed_(0), submitted_(0)
+{
+}
+
+ReadAheadFileBuf::~ReadAheadFileBuf()
+{
+    discardAhead();
+    if (is_open())
+    {
+        ::close(fd_);
+    }
+}
+
+ReadAheadFileBuf *ReadAheadFileBuf::open(const char *path)
+{
+    restart(0);
+    if (is_open())
+    {
+        ::close(fd_);
+    }
+    fd_ = ::open(path, O_RDONLY);
+    if (!is_open())
+    {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd_, &st))
+    {
+        const int error = errno;
+        ::close(fd_);
+        fd_ = -1;
+        errno = error;
+        return 0;
+    }
+    fileSize_ = st.st_size;
+    if (posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL))
+    {
+        ISAAC_THREAD_CERR << "WARNING: posix_fadvise failed for POSIX_FADV_SEQUENTIAL with " << errno << "(" <<
+            strerror(errno) << ")" << " file: " << path << std::endl;
+    }
+    return this;
+}
+
+uint64_t ReadAheadFileBuf::position() const
+{
+    return consumed_ ? start_ + (consumed_ - 1) * BLOCK_BYTES + (gptr() - eback()) : start_;
+}
+
+/**
+ * \brief requests the blocks that fit into the buffer. The block in the get area must have been consumed.
+ */
+void ReadAheadFileBuf::submitAhead()
+{
+    while (consumed_ + BLOCKS != submitted_ && fileSize_ > blockOffset(submitted_))
+    {
+        const uint64_t offset = blockOffset(submitted_);
+        asyncIo_.read(batches_[submitted_ % BLOCKS], fd_, blockData(submitted_),
+                      std::min<uint64_t>(BLOCK_BYTES, fileSize_ - offset), offset);
+        ++submitted_;
+    }
+}
+
+void ReadAheadFileBuf::discardAhead()
+{
+    for (; submitted_ != consumed_; --submitted_)
+    {
+        asyncIo_.wait(batches_[(submitted_ - 1) % BLOCKS]);
+    }
+}
+
+void ReadAheadFileBuf::restart(const uint64_t position)
+{
+    discardAhead();
+    start_ = position;
+    consumed_ = 0;
+    submitted_ = 0;
+    setg(0, 0, 0);
+}
+
+ReadAheadFileBuf::int_type ReadAheadFileBuf::underflow()
+{
+    if (gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (!is_open())
+    {
+        return traits_type::eof();
+    }
+
+    submitAhead();
+    if (submitted_ == consumed_)
+    {
+        return traits_type::eof();
+    }
+
+    const uint64_t block = consumed_++;
+    if (const int error = asyncIo_.wait(batches_[block % BLOCKS]))
+    {
+        --consumed_;
+        restart(blockOffset(block));
+        errno = error;
+        return traits_type::eof();
+    }
+    char *data = blockData(block);
+    setg(data, data, data + std::min<uint64_t>(BLOCK_BYTES, fileSize_ - blockOffset(block)));
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize ReadAheadFileBuf::xsgetn(char_type *s, std::streamsize n)
+{
+    std::streamsize done = std::min<std::streamsize>(n, egptr() - gptr());
+    std::copy(gptr(), gptr() + done, s);
+    gbump(done);
+
+    if (is_open() && BLOCK_BYTES <= std::size_t(n - done))
+    {
+        const uint64_t offset = position();
+        const uint64_t wanted = std::min<uint64_t>(n - done, fileSize_ > offset ? fileSize_ - offset : 0);
+        restart(offset);
+        AsyncFileIo::Batch &batch = batches_[0];
+        for (uint64_t chunk = 0; wanted != chunk;)
+        {
+            const uint64_t size = std::min<uint64_t>(DIRECT_READ_BYTES, wanted - chunk);
+            asyncIo_.read(batch, fd_, s + done + chunk, size, offset + chunk);
+            chunk += size;
+        }
+        if (const int error = asyncIo_.wait(batch))
+        {
+            errno = error;
+            return done;
+        }
+        done += wanted;
+        restart(offset + wanted);
+    }
+
+    return done + std::streambuf::xsgetn(s + done, n - done);
+}
+
+ReadAheadFileBuf::pos_type ReadAheadFileBuf::seekoff(
+    off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if (!is_open() || !(which & std::ios_base::in))
+    {
+        return pos_type(off_type(-1));
+    }
+    const off_type target =
+        std::ios_base::beg == dir ? off :
+        std::ios_base::cur == dir ? off_type(position()) + off : off_type(fileSize_) + off;
+    if (0 > target)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    const uint64_t getAreaOffset = consumed_ ? blockOffset(consumed_ - 1) : 0;
+    if (consumed_ && getAreaOffset <= uint64_t(target) && uint64_t(target) <= getAreaOffset + (egptr() - eback()))
+    {
+        // stay within the get area, keep the read-ahead
+        setg(eback(), eback() + (target - getAreaOffset), egptr());
+    }
+    else
+    {
+        restart(target);
+    }
+    return pos_type(target);
+}
+
+ReadAheadFileBuf::pos_type ReadAheadFileBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+} // namespace io
+} // namespace isaac
@@ -0,0 +1,322 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testAsyncFileIo.cpp
+ **
+ ** Test cases for AsyncFileIo backends.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include <boost/foreach.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/AsyncFileIo.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testAsyncFileIo.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestAsyncFileIo, registryName("TestAsyncFileIo"));
+
+TestAsyncFileIo::TestAsyncFileIo()
+{
+}
+
+void TestAsyncFileIo::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+
+    backends_.clear();
+    backends_.push_back(io::AsyncFileIoThreads);
+    try
+    {
+        io::AsyncFileIo uring(io::AsyncFileIoUring, 1);
+        backends_.push_back(io::AsyncFileIoUring);
+    }
+    catch (const common::IoException &e)
+    {
+        std::cerr << "io_uring is not available, testing threads only" << std::endl;
+    }
+}
+
+void TestAsyncFileIo::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+static char patternByte(const uint64_t offset)
+{
+    return offset * 7 + offset / 251;
+}
+
+static std::vector<char> makePattern(const uint64_t offset, const std::size_t size)
+{
+    std::vector<char> ret;
+    ret.reserve(size);
+    for (uint64_t i = offset; offset + size != i; ++i)
+    {
+        ret.push_back(patternByte(i));
+    }
+    return ret;
+}
+
+static void writePattern(const boost::filesystem::path &path, const std::size_t size)
+{
+    const std::vector<char> data = makePattern(0, size);
+    std::ofstream os(path.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    CPPUNIT_ASSERT(os.write(&data.front(), data.size()));
+}
+
+static uint64_t getFileSize(const int fd)
+{
+    struct stat st;
+    CPPUNIT_ASSERT(!fstat(fd, &st));
+    return st.st_size;
+}
+
+void TestAsyncFileIo::testWriteRead()
+{
+    BOOST_FOREACH(const io::AsyncFileIoBackend backend, backends_)
+    {
+        testWriteRead(backend);
+    }
+}
+
+void TestAsyncFileIo::testWriteRead(const io::AsyncFileIoBackend backend)
+{
+    // fewer requests in flight than submitted
+    io::AsyncFileIo asyncIo(backend, 2);
+    CPPUNIT_ASSERT_EQUAL(backend, asyncIo.getBackend());
+
+    const boost::filesystem::path path = tempDirectory_ / "written";
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CPPUNIT_ASSERT(-1 != fd);
+
+    std::vector<char> data = makePattern(0, 1024 * 1024 + 13);
+    std::vector<iovec> iov;
+    for (std::size_t offset = 0, piece = 1; data.size() != offset; piece = piece * 3 + 1)
+    {
+        const std::size_t size = std::min<std::size_t>(piece % 65536 + 1, data.size() - offset);
+        const iovec buffer = {&data[offset], size};
+        iov.push_back(buffer);
+        offset += size;
+    }
+
+    // gather uneven buffers into requests of up to 5 buffers each
+    io::AsyncFileIo::Batch batch;
+    uint64_t offset = 0;
+    for (std::size_t i = 0; iov.size() != i; i += std::min<std::size_t>(5, iov.size() - i))
+    {
+        const std::size_t count = std::min<std::size_t>(5, iov.size() - i);
+        asyncIo.writev(batch, fd, &iov[i], count, offset);
+        for (std::size_t j = i; i + count != j; ++j)
+        {
+            offset += iov[j].iov_len;
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(0, asyncIo.wait(batch));
+    CPPUNIT_ASSERT(batch.empty());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(data.size()), getFileSize(fd));
+
+    std::vector<char> read(data.size());
+    for (std::size_t offset = 0; read.size() != offset;)
+    {
+        const std::size_t size = std::min<std::size_t>(100000, read.size() - offset);
+        asyncIo.read(batch, fd, &read[offset], size, offset);
+        offset += size;
+    }
+    CPPUNIT_ASSERT_EQUAL(0, asyncIo.wait(batch));
+    CPPUNIT_ASSERT(data == read);
+    close(fd);
+}
+
+void TestAsyncFileIo::testShortWrite()
+{
+    BOOST_FOREACH(const io::AsyncFileIoBackend backend, backends_)
+    {
+        testShortWrite(backend);
+    }
+}
+
+/**
+ * \brief the file size limit makes the first write short and the continuation fail
+ */
+void TestAsyncFileIo::testShortWrite(const io::AsyncFileIoBackend backend)
+{
+    static const rlim_t FILE_SIZE_LIMIT = 100000;
+    io::AsyncFileIo asyncIo(backend, 2);
+
+    const boost::filesystem::path path = tempDirectory_ / "limited";
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CPPUNIT_ASSERT(-1 != fd);
+
+    std::vector<char> data = makePattern(0, FILE_SIZE_LIMIT + 20000);
+    iovec iov[] = {{&data[0], 60000}, {&data[60000], data.size() - 60000}};
+
+    struct rlimit original;
+    CPPUNIT_ASSERT(!getrlimit(RLIMIT_FSIZE, &original));
+    struct rlimit limited = original;
+    limited.rlim_cur = FILE_SIZE_LIMIT;
+    void (*originalHandler)(int) = signal(SIGXFSZ, SIG_IGN);
+    CPPUNIT_ASSERT(!setrlimit(RLIMIT_FSIZE, &limited));
+
+    io::AsyncFileIo::Batch batch;
+    asyncIo.writev(batch, fd, iov, 2, 0);
+    const int error = asyncIo.wait(batch);
+
+    setrlimit(RLIMIT_FSIZE, &original);
+    signal(SIGXFSZ, originalHandler);
+
+    CPPUNIT_ASSERT_EQUAL(EFBIG, error);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(FILE_SIZE_LIMIT), getFileSize(fd));
+    std::vector<char> read(FILE_SIZE_LIMIT);
+    asyncIo.read(batch, fd, &read.front(), read.size(), 0);
+    CPPUNIT_ASSERT_EQUAL(0, asyncIo.wait(batch));
+    CPPUNIT_ASSERT(std::equal(read.begin(), read.end(), data.begin()));
+    close(fd);
+}
+
+void TestAsyncFileIo::testEndOfFile()
+{
+    BOOST_FOREACH(const io::AsyncFileIoBackend backend, backends_)
+    {
+        testEndOfFile(backend);
+    }
+}
+
+void TestAsyncFileIo::testEndOfFile(const io::AsyncFileIoBackend backend)
+{
+    io::AsyncFileIo asyncIo(backend, 4);
+    const boost::filesystem::path path = tempDirectory_ / "short";
+    writePattern(path, 10000);
+    const int fd = open(path.c_str(), O_RDONLY);
+    CPPUNIT_ASSERT(-1 != fd);
+
+    io::AsyncFileIo::Batch batch;
+    std::vector<char> read(15000, 0);
+    // the part before the end of file is delivered
+    asyncIo.read(batch, fd, &read.front(), read.size(), 0);
+    CPPUNIT_ASSERT_EQUAL(ENODATA, asyncIo.wait(batch));
+    const std::vector<char> expected = makePattern(0, 10000);
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), read.begin()));
+
+    asyncIo.read(batch, fd, &read.front(), 100, 20000);
+    CPPUNIT_ASSERT_EQUAL(ENODATA, asyncIo.wait(batch));
+
+    // the error does not stick to the batch
+    asyncIo.read(batch, fd, &read.front(), 10000, 0);
+    CPPUNIT_ASSERT_EQUAL(0, asyncIo.wait(batch));
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), read.begin()));
+    close(fd);
+}
+
+void TestAsyncFileIo::testErrors()
+{
+    BOOST_FOREACH(const io::AsyncFileIoBackend backend, backends_)
+    {
+        testErrors(backend);
+    }
+}
+
+void TestAsyncFileIo::testErrors(const io::AsyncFileIoBackend backend)
+{
+    io::AsyncFileIo asyncIo(backend, 4);
+    const boost::filesystem::path path = tempDirectory_ / "readonly";
+    writePattern(path, 10000);
+    const int fd = open(path.c_str(), O_RDONLY);
+    CPPUNIT_ASSERT(-1 != fd);
+    const int directoryFd = open(tempDirectory_.c_str(), O_RDONLY);
+    CPPUNIT_ASSERT(-1 != directoryFd);
+
+    std::vector<char> buffer(10000);
+    io::AsyncFileIo::Batch batch;
+    asyncIo.read(batch, -1, &buffer.front(), buffer.size(), 0);
+    CPPUNIT_ASSERT_EQUAL(EBADF, asyncIo.wait(batch));
+
+    asyncIo.read(batch, directoryFd, &buffer.front(), buffer.size(), 0);
+    CPPUNIT_ASSERT_EQUAL(EISDIR, asyncIo.wait(batch));
+
+    iovec iov = {&buffer.front(), buffer.size()};
+    asyncIo.writev(batch, fd, &iov, 1, 0);
+    CPPUNIT_ASSERT_EQUAL(EBADF, asyncIo.wait(batch));
+
+    // a failed request fails its own batch only
+    io::AsyncFileIo::Batch failing;
+    std::vector<char> other(10000);
+    asyncIo.read(batch, fd, &buffer.front(), 5000, 0);
+    asyncIo.read(failing, fd, &other.front(), 5000, 0);
+    asyncIo.read(failing, directoryFd, &other.front() + 5000, 5000, 0);
+    asyncIo.read(batch, fd, &buffer.front() + 5000, 5000, 5000);
+    CPPUNIT_ASSERT_EQUAL(EISDIR, asyncIo.wait(failing));
+    CPPUNIT_ASSERT_EQUAL(0, asyncIo.wait(batch));
+    CPPUNIT_ASSERT(makePattern(0, 10000) == buffer);
+    CPPUNIT_ASSERT_EQUAL(0, asyncIo.wait(failing));
+
+    close(directoryFd);
+    close(fd);
+}
+
+static std::size_t countProcessThreads()
+{
+    return std::distance(boost::filesystem::directory_iterator("/proc/self/task"), boost::filesystem::directory_iterator());
+}
+
+/**
+ * \brief objects using the threads backend don't start threads of their own
+ */
+void TestAsyncFileIo::testSharedThreads()
+{
+    const boost::filesystem::path path = tempDirectory_ / "shared";
+    writePattern(path, 100000);
+    const int fd = open(path.c_str(), O_RDONLY);
+    CPPUNIT_ASSERT(-1 != fd);
+
+    boost::ptr_vector<io::AsyncFileIo> asyncIos;
+    asyncIos.push_back(new io::AsyncFileIo(io::AsyncFileIoThreads, 4));
+    const std::size_t threads = countProcessThreads();
+    while (16 != asyncIos.size())
+    {
+        asyncIos.push_back(new io::AsyncFileIo(io::AsyncFileIoThreads, 4));
+    }
+    CPPUNIT_ASSERT_EQUAL(threads, countProcessThreads());
+
+    std::vector<std::vector<char> > buffers(asyncIos.size(), std::vector<char>(100000));
+    std::vector<io::AsyncFileIo::Batch> batches(asyncIos.size());
+    for (std::size_t i = 0; asyncIos.size() != i; ++i)
+    {
+        for (uint64_t offset = 0; buffers[i].size() != offset; offset += 10000)
+        {
+            asyncIos[i].read(batches[i], fd, &buffers[i][offset], 10000, offset);
+        }
+    }
+    for (std::size_t i = 0; asyncIos.size() != i; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL(0, asyncIos[i].wait(batches[i]));
+        CPPUNIT_ASSERT(makePattern(0, 100000) == buffers[i]);
+    }
+    close(fd);
+}
@@ -0,0 +1,57 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_ASYNC_FILE_IO_HH
+#define iSAAC_IO_TEST_ASYNC_FILE_IO_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "io/AsyncFileIo.hh"
+
+class TestAsyncFileIo : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestAsyncFileIo );
+    CPPUNIT_TEST( testWriteRead );
+    CPPUNIT_TEST( testShortWrite );
+    CPPUNIT_TEST( testEndOfFile );
+    CPPUNIT_TEST( testErrors );
+    CPPUNIT_TEST( testSharedThreads );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    // backends available in this environment
+    std::vector<isaac::io::AsyncFileIoBackend> backends_;
+
+    void testWriteRead(const isaac::io::AsyncFileIoBackend backend);
+    void testShortWrite(const isaac::io::AsyncFileIoBackend backend);
+    void testEndOfFile(const isaac::io::AsyncFileIoBackend backend);
+    void testErrors(const isaac::io::AsyncFileIoBackend backend);
+
+public:
+    TestAsyncFileIo();
+    void setUp();
+    void tearDown();
+
+    void testWriteRead();
+    void testShortWrite();
+    void testEndOfFile();
+    void testErrors();
+    void testSharedThreads();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_ASYNC_FILE_IO_HH
+
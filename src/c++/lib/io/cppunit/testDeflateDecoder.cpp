@@ -0,0 +1,197 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testDeflateDecoder.cpp
+ **
+ ** Test cases for DeflateDecoder.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "io/DeflateDecoder.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testDeflateDecoder.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestDeflateDecoder, registryName("TestDeflateDecoder"));
+
+TestDeflateDecoder::TestDeflateDecoder()
+{
+}
+
+void TestDeflateDecoder::setUp()
+{
+}
+
+void TestDeflateDecoder::tearDown()
+{
+}
+
+static std::string makeFastq(const std::size_t size, unsigned seed)
+{
+    std::string ret;
+    ret.reserve(size + 1024);
+    for (unsigned record = 0; size > ret.size(); ++record)
+    {
+        ret += (boost::format("@read:%u/1\n") % record).str();
+        for (unsigned i = 0; 100 != i; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            ret += "ACGT"[(seed >> 16) & 3];
+        }
+        ret += "\n+\n";
+        for (unsigned i = 0; 100 != i; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            ret += char('#' + (seed >> 16) % 40);
+        }
+        ret += '\n';
+    }
+    ret.resize(size);
+    return ret;
+}
+
+/**
+ * \return gzip member followed by DeflateDecoder::INPUT_PADDING zeroes that are not part of the data
+ */
+static std::vector<unsigned char> gzip(const std::string &text, const int level, const int strategy, std::size_t &size)
+{
+    z_stream strm = z_stream();
+    CPPUNIT_ASSERT_EQUAL(Z_OK, deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, strategy));
+    std::vector<unsigned char> ret(deflateBound(&strm, text.size()) + io::DeflateDecoder::INPUT_PADDING, 0);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    strm.avail_in = text.size();
+    strm.next_out = &ret.front();
+    strm.avail_out = ret.size() - io::DeflateDecoder::INPUT_PADDING;
+    CPPUNIT_ASSERT_EQUAL(Z_STREAM_END, deflate(&strm, Z_FINISH));
+    size = strm.total_out;
+    deflateEnd(&strm);
+    return ret;
+}
+
+/**
+ * \brief replaces markers with the bytes of window and returns the decoded data without the window
+ */
+static std::string resolve(const io::DeflateDecoder &decoder, const std::string &window)
+{
+    CPPUNIT_ASSERT_EQUAL(std::size_t(io::DeflateDecoder::WINDOW_SIZE), window.size());
+    std::string ret;
+    const io::DeflateDecoder::Symbol *output = decoder.output() + io::DeflateDecoder::WINDOW_SIZE;
+    for (std::size_t i = 0; decoder.decodedSize() != i; ++i)
+    {
+        const io::DeflateDecoder::Symbol symbol = output[i];
+        ret += io::DeflateDecoder::MARKER_BASE > symbol ?
+            char(symbol) : window.at(symbol - io::DeflateDecoder::MARKER_BASE);
+    }
+    return ret;
+}
+
+void TestDeflateDecoder::testFromStart()
+{
+    const std::string text = makeFastq(300000, 1);
+    const int strategies[] = {Z_DEFAULT_STRATEGY, Z_FIXED};
+    const int levels[] = {0, 6};
+    for (unsigned s = 0; 2 != s; ++s)
+    {
+        for (unsigned l = 0; 2 != l; ++l)
+        {
+            std::size_t size = 0;
+            const std::vector<unsigned char> compressed = gzip(text, levels[l], strategies[s], size);
+            io::DeflateDecoder decoder;
+            decoder.setInput(&compressed.front(), size);
+            decoder.resetOutput(0, 0);
+            CPPUNIT_ASSERT_EQUAL(io::DeflateDecoder::Stopped,
+                                 decoder.decode(io::DeflateDecoder::Boundary(0, true), size * 8));
+            CPPUNIT_ASSERT_EQUAL(text.size(), decoder.decodedSize());
+            CPPUNIT_ASSERT(text == resolve(decoder, std::string(io::DeflateDecoder::WINDOW_SIZE, 0)));
+            CPPUNIT_ASSERT_EQUAL(std::size_t(1), decoder.memberEnds().size());
+        }
+    }
+}
+
+/**
+ * \brief Starting at an unknown offset the back-references into the data before the start become markers.
+ */
+void TestDeflateDecoder::testFromMiddle()
+{
+    const std::string text = makeFastq(500000, 2);
+    const int levels[] = {0, 6};
+    for (unsigned l = 0; 2 != l; ++l)
+    {
+        std::size_t size = 0;
+        const std::vector<unsigned char> compressed = gzip(text, levels[l], Z_DEFAULT_STRATEGY, size);
+        io::DeflateDecoder decoder;
+        decoder.setInput(&compressed.front(), size);
+        CPPUNIT_ASSERT_EQUAL(io::DeflateDecoder::Stopped,
+                             decoder.decodeFromFirstBoundary(size * 8 / 3, size * 8, size * 8));
+        CPPUNIT_ASSERT(0 != decoder.decodedSize());
+        CPPUNIT_ASSERT(text.size() - io::DeflateDecoder::WINDOW_SIZE > decoder.decodedSize());
+        const std::size_t offset = text.size() - decoder.decodedSize();
+        CPPUNIT_ASSERT_MESSAGE((boost::format("level %d") % levels[l]).str(),
+            text.substr(offset) == resolve(decoder, text.substr(offset - io::DeflateDecoder::WINDOW_SIZE, io::DeflateDecoder::WINDOW_SIZE)));
+    }
+}
+
+void TestDeflateDecoder::testEndOfInput()
+{
+    const std::string text = makeFastq(200000, 3);
+    std::size_t size = 0;
+    std::vector<unsigned char> compressed = gzip(text, 6, Z_DEFAULT_STRATEGY, size);
+    const std::size_t truncated = size / 2;
+    std::fill(compressed.begin() + truncated, compressed.end(), 0);
+
+    io::DeflateDecoder decoder;
+    decoder.setInput(&compressed.front(), truncated);
+    decoder.resetOutput(0, 0);
+    CPPUNIT_ASSERT_EQUAL(io::DeflateDecoder::EndOfInput,
+                         decoder.decode(io::DeflateDecoder::Boundary(0, true), truncated * 8));
+    CPPUNIT_ASSERT(text.size() > decoder.decodedSize());
+    CPPUNIT_ASSERT(text.substr(0, decoder.decodedSize()) == resolve(decoder, std::string(io::DeflateDecoder::WINDOW_SIZE, 0)));
+    CPPUNIT_ASSERT(decoder.memberEnds().empty());
+}
+
+void TestDeflateDecoder::testInvalid()
+{
+    std::vector<unsigned char> garbage(4096 + io::DeflateDecoder::INPUT_PADDING, 0);
+    unsigned seed = 4;
+    for (std::size_t i = 0; garbage.size() - io::DeflateDecoder::INPUT_PADDING != i; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        garbage[i] = seed >> 16;
+    }
+    // not a gzip header
+    io::DeflateDecoder decoder;
+    decoder.setInput(&garbage.front(), garbage.size() - io::DeflateDecoder::INPUT_PADDING);
+    decoder.resetOutput(0, 0);
+    CPPUNIT_ASSERT_EQUAL(io::DeflateDecoder::Invalid, decoder.decode(io::DeflateDecoder::Boundary(0, true), 4096 * 8));
+
+    // block type 3 is reserved
+    garbage[0] = 0x07;
+    decoder.resetOutput(0, 0);
+    CPPUNIT_ASSERT_EQUAL(io::DeflateDecoder::Invalid, decoder.decode(io::DeflateDecoder::Boundary(0, false), 4096 * 8));
+
+    // stored block length does not match its complement
+    garbage[0] = 0x00;
+    garbage[1] = 0x10; garbage[2] = 0x00; garbage[3] = 0x00; garbage[4] = 0x00;
+    decoder.resetOutput(0, 0);
+    CPPUNIT_ASSERT_EQUAL(io::DeflateDecoder::Invalid, decoder.decode(io::DeflateDecoder::Boundary(0, false), 4096 * 8));
+}
@@ -0,0 +1,41 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_DEFLATE_DECODER_HH
+#define iSAAC_IO_TEST_DEFLATE_DECODER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestDeflateDecoder : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestDeflateDecoder );
+    CPPUNIT_TEST( testFromStart );
+    CPPUNIT_TEST( testFromMiddle );
+    CPPUNIT_TEST( testEndOfInput );
+    CPPUNIT_TEST( testInvalid );
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+public:
+    TestDeflateDecoder();
+    void setUp();
+    void tearDown();
+
+    void testFromStart();
+    void testFromMiddle();
+    void testEndOfInput();
+    void testInvalid();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_DEFLATE_DECODER_HH
+
@@ -0,0 +1,222 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testFastqReader.cpp
+ **
+ ** Test cases for FastqReader. Line lengths vary so that the 16 byte newline scan meets the line ends at every
+ ** position, mapped files are parsed past the release steps.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <zlib.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "flowcell/ReadMetadata.hh"
+#include "io/FastqReader.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testFastqReader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFastqReader, registryName("TestFastqReader"));
+
+static const char Q0_BASE = '!';
+static const unsigned READ_LENGTH_MAX = 160;
+
+TestFastqReader::TestFastqReader()
+{
+}
+
+void TestFastqReader::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+}
+
+void TestFastqReader::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+/**
+ * \brief Produces the same sequence of records for the same arguments, so that the file does not have to be
+ *        kept in memory for the verification
+ */
+class RecordGenerator
+{
+    unsigned seed_;
+    const unsigned lengthMin_;
+    const unsigned lengthMax_;
+    unsigned record_;
+
+    unsigned random()
+    {
+        seed_ = seed_ * 1103515245 + 12345;
+        return seed_ >> 16;
+    }
+
+public:
+    std::string header_;
+    std::string bases_;
+    std::string qualities_;
+    std::string text_;
+
+    RecordGenerator(const unsigned seed, const unsigned lengthMin, const unsigned lengthMax) :
+        seed_(seed), lengthMin_(lengthMin), lengthMax_(lengthMax), record_(0)
+    {
+    }
+
+    const std::string &next()
+    {
+        const unsigned length = lengthMin_ + random() % (lengthMax_ - lengthMin_ + 1);
+        // header lengths vary too, some have a description after the name
+        header_ = (boost::format("@r%u:%s") % record_ % std::string(random() % 17, 'x')).str();
+        if (record_ % 3)
+        {
+            header_ += " 1:N:0:1";
+        }
+        bases_.clear();
+        qualities_.clear();
+        for (unsigned i = 0; length != i; ++i)
+        {
+            bases_ += "ACGTN"[random() % 5];
+            qualities_ += char('#' + random() % 40);
+        }
+        const char *newLine = (record_ % 2) ? "\r\n" : "\n";
+        text_ = header_ + newLine + bases_ + newLine + "+" + newLine + qualities_ + newLine;
+        ++record_;
+        return text_;
+    }
+};
+
+static std::vector<char> expectedBcl(const RecordGenerator &generator)
+{
+    std::vector<char> ret(READ_LENGTH_MAX, 0);
+    for (std::size_t i = 0; generator.bases_.size() != i; ++i)
+    {
+        const std::size_t base = std::string("ACGT").find(generator.bases_[i]);
+        ret[i] = std::string::npos == base ? 0 : char(base | ((generator.qualities_[i] - Q0_BASE) << 2));
+    }
+    return ret;
+}
+
+/**
+ * \brief writes records until the file is at least size bytes
+ * \param lastNewLine   false to leave the last record without the line end
+ * \return number of records written
+ */
+static unsigned writeFastq(
+    const boost::filesystem::path &path, RecordGenerator generator, const std::size_t size, const bool lastNewLine)
+{
+    std::string data;
+    unsigned ret = 0;
+    for (; size > data.size(); ++ret)
+    {
+        data += generator.next();
+    }
+    if (!lastNewLine)
+    {
+        data.resize(data.find_last_not_of("\r\n") + 1);
+    }
+
+    if (".gz" == path.extension())
+    {
+        gzFile gz = gzopen(path.c_str(), "wb");
+        CPPUNIT_ASSERT(gz);
+        CPPUNIT_ASSERT_EQUAL(int(data.size()), gzwrite(gz, data.data(), data.size()));
+        CPPUNIT_ASSERT_EQUAL(Z_OK, gzclose(gz));
+    }
+    else
+    {
+        std::ofstream os(path.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        CPPUNIT_ASSERT(os.write(data.data(), data.size()));
+    }
+    return ret;
+}
+
+/**
+ * \brief reads all records and compares them with what generator produces
+ */
+static void checkFastq(
+    io::FastqReader &reader, const boost::filesystem::path &path, RecordGenerator generator, const unsigned records)
+{
+    const flowcell::ReadMetadata readMetadata(1, READ_LENGTH_MAX, 0, 0);
+    reader.open(path, Q0_BASE);
+    std::size_t offset = 0;
+    for (unsigned record = 0; records != record; ++record)
+    {
+        generator.next();
+        const std::string message = (boost::format("record %u of %s") % record % path).str();
+        CPPUNIT_ASSERT_MESSAGE(message, reader.hasData());
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(message, offset, reader.getRecordOffset());
+        offset += generator.text_.size();
+        const io::FastqReader::IteratorPair header = reader.getHeader();
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(message, generator.header_, std::string(header.first, header.second));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(message, unsigned(generator.bases_.size()), reader.getReadLength());
+        std::vector<char> bcl(READ_LENGTH_MAX, -1);
+        reader.extractBcl(readMetadata, bcl.begin());
+        CPPUNIT_ASSERT_MESSAGE(message, expectedBcl(generator) == bcl);
+        reader.next();
+    }
+    CPPUNIT_ASSERT(!reader.hasData());
+}
+
+void TestFastqReader::testMapped()
+{
+    const RecordGenerator generator(1, 1, 70);
+    io::FastqReader reader(true, 1, false, 0);
+
+    const boost::filesystem::path path = tempDirectory_ / "mapped.fastq";
+    unsigned records = writeFastq(path, generator, 1024 * 1024, true);
+    checkFastq(reader, path, generator, records);
+
+    // the newline scan must not read past the end of the mapping when the file does not end with a newline
+    const boost::filesystem::path noNewLinePath = tempDirectory_ / "no-newline.fastq";
+    records = writeFastq(noNewLinePath, generator, 4096 * 3 - 7, false);
+    checkFastq(reader, noNewLinePath, generator, records);
+}
+
+void TestFastqReader::testGzipped()
+{
+    const RecordGenerator generator(2, 1, 70);
+    const boost::filesystem::path path = tempDirectory_ / "compressed.fastq.gz";
+    const unsigned records = writeFastq(path, generator, 1024 * 1024, true);
+    {
+        io::FastqReader reader(true, 1, false, 0);
+        checkFastq(reader, path, generator, records);
+    }
+    {
+        io::FastqReader reader(true, 4, true, 0);
+        checkFastq(reader, path, generator, records);
+    }
+}
+
+/**
+ * \brief The pages behind the parsing position are released every MAPPED_RELEASE_BYTES. Records crossing
+ *        the release step must parse the same as any other.
+ */
+void TestFastqReader::testMappedReleaseWindow()
+{
+    const RecordGenerator generator(3, 100, READ_LENGTH_MAX);
+    const boost::filesystem::path path = tempDirectory_ / "large.fastq";
+    const unsigned records = writeFastq(path, generator, io::FastqReader::MAPPED_RELEASE_BYTES * 2 + 4096, true);
+    io::FastqReader reader(true, 1, false, 0);
+    checkFastq(reader, path, generator, records);
+}
@@ -0,0 +1,41 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_FASTQ_READER_HH
+#define iSAAC_IO_TEST_FASTQ_READER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+class TestFastqReader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFastqReader );
+    CPPUNIT_TEST( testMapped );
+    CPPUNIT_TEST( testGzipped );
+    CPPUNIT_TEST( testMappedReleaseWindow );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+
+public:
+    TestFastqReader();
+    void setUp();
+    void tearDown();
+
+    void testMapped();
+    void testGzipped();
+    void testMappedReleaseWindow();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_FASTQ_READER_HH
@@ -0,0 +1,242 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testParallelGzipReader.cpp
+ **
+ ** Test cases for ParallelGzipReader. The output is compared with what zlib inflates from the same data.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <zlib.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/ParallelGzipReader.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testParallelGzipReader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestParallelGzipReader, registryName("TestParallelGzipReader"));
+
+TestParallelGzipReader::TestParallelGzipReader()
+{
+}
+
+void TestParallelGzipReader::setUp()
+{
+}
+
+void TestParallelGzipReader::tearDown()
+{
+}
+
+/**
+ * \brief fastq-like text. Headers and separators give short back-references, bases and qualities are random.
+ */
+static std::string makeFastq(const std::size_t size, unsigned seed)
+{
+    std::string ret;
+    ret.reserve(size + 1024);
+    for (unsigned record = 0; size > ret.size(); ++record)
+    {
+        ret += (boost::format("@read:%u/1\n") % record).str();
+        for (unsigned i = 0; 100 != i; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            ret += "ACGT"[(seed >> 16) & 3];
+        }
+        ret += "\n+\n";
+        for (unsigned i = 0; 100 != i; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            ret += char('#' + (seed >> 16) % 40);
+        }
+        ret += '\n';
+    }
+    ret.resize(size);
+    return ret;
+}
+
+static std::string gzip(const std::string &text, const int level, const int strategy)
+{
+    z_stream strm = z_stream();
+    CPPUNIT_ASSERT_EQUAL(Z_OK, deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, strategy));
+    std::string ret(deflateBound(&strm, text.size()), 0);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    strm.avail_in = text.size();
+    strm.next_out = reinterpret_cast<Bytef*>(&ret[0]);
+    strm.avail_out = ret.size();
+    CPPUNIT_ASSERT_EQUAL(Z_STREAM_END, deflate(&strm, Z_FINISH));
+    ret.resize(strm.total_out);
+    deflateEnd(&strm);
+    return ret;
+}
+
+/**
+ * \brief inflates all gzip members with zlib
+ */
+static std::string gunzip(const std::string &compressed)
+{
+    z_stream strm = z_stream();
+    CPPUNIT_ASSERT_EQUAL(Z_OK, inflateInit2(&strm, 15 + 16));
+    std::string ret;
+    std::vector<char> buffer(65536);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    strm.avail_in = compressed.size();
+    while (strm.avail_in)
+    {
+        strm.next_out = reinterpret_cast<Bytef*>(&buffer.front());
+        strm.avail_out = buffer.size();
+        const int status = inflate(&strm, Z_NO_FLUSH);
+        CPPUNIT_ASSERT(Z_OK == status || Z_STREAM_END == status);
+        ret.append(&buffer.front(), buffer.size() - strm.avail_out);
+        if (Z_STREAM_END == status)
+        {
+            CPPUNIT_ASSERT_EQUAL(Z_OK, inflateReset(&strm));
+        }
+    }
+    inflateEnd(&strm);
+    return ret;
+}
+
+static std::string parallelGunzip(const std::string &compressed, const unsigned coresMax, const std::size_t readSize)
+{
+    io::ParallelGzipReader reader(coresMax);
+    std::istringstream is(compressed);
+    std::string ret;
+    std::vector<char> buffer(readSize);
+    while (!reader.isEof())
+    {
+        ret.append(&buffer.front(), reader.readMoreData(is, &buffer.front(), buffer.size()));
+    }
+    return ret;
+}
+
+/**
+ * \brief checks the parallel reader against zlib with various numbers of threads, so that the chunk boundaries
+ *        fall in different places of the blocks
+ */
+static void checkDecompression(const std::string &text, const std::string &compressed)
+{
+    const std::string expected = gunzip(compressed);
+    CPPUNIT_ASSERT(text == expected);
+    for (unsigned coresMax = 1; 8 >= coresMax; coresMax *= 2)
+    {
+        const std::string result = parallelGunzip(compressed, coresMax, 65536 + coresMax);
+        CPPUNIT_ASSERT_EQUAL(expected.size(), result.size());
+        CPPUNIT_ASSERT_MESSAGE((boost::format("%d cores") % coresMax).str(), expected == result);
+    }
+}
+
+void TestParallelGzipReader::testStoredBlocks()
+{
+    const std::string text = makeFastq(3 * io::ParallelGzipReader::CHUNK_SIZE + 12345, 1);
+    checkDecompression(text, gzip(text, 0, Z_DEFAULT_STRATEGY));
+}
+
+void TestParallelGzipReader::testFixedBlocks()
+{
+    const std::string text = makeFastq(6 * io::ParallelGzipReader::CHUNK_SIZE + 321, 2);
+    checkDecompression(text, gzip(text, 6, Z_FIXED));
+}
+
+void TestParallelGzipReader::testDynamicBlocks()
+{
+    const std::string text = makeFastq(9 * io::ParallelGzipReader::CHUNK_SIZE + 7, 3);
+    checkDecompression(text, gzip(text, 6, Z_DEFAULT_STRATEGY));
+    checkDecompression(text, gzip(text, 1, Z_HUFFMAN_ONLY));
+}
+
+void TestParallelGzipReader::testMultiMember()
+{
+    const std::string first = makeFastq(io::ParallelGzipReader::CHUNK_SIZE + 100, 4);
+    const std::string second = makeFastq(3 * io::ParallelGzipReader::CHUNK_SIZE + 200, 5);
+    const std::string third = makeFastq(1000, 6);
+    checkDecompression(
+        first + second + third + first,
+        gzip(first, 6, Z_DEFAULT_STRATEGY) + gzip(second, 0, Z_DEFAULT_STRATEGY) + gzip("", 6, Z_DEFAULT_STRATEGY) +
+            gzip(third, 9, Z_FIXED) + gzip(first, 9, Z_DEFAULT_STRATEGY));
+}
+
+/**
+ * \brief Matches 20-30 kilobytes back make every chunk depend on the window of the previous one
+ */
+void TestParallelGzipReader::testLongBackReferences()
+{
+    const std::string unit = makeFastq(20000, 7);
+    std::string text;
+    for (unsigned seed = 8; 8 * io::ParallelGzipReader::CHUNK_SIZE > text.size(); ++seed)
+    {
+        text += unit;
+        text += makeFastq(7000 + seed % 3000, seed);
+    }
+    const std::string compressed = gzip(text, 9, Z_DEFAULT_STRATEGY);
+    CPPUNIT_ASSERT(io::ParallelGzipReader::CHUNK_SIZE < compressed.size());
+    checkDecompression(text, compressed);
+}
+
+void TestParallelGzipReader::testTruncated()
+{
+    const std::string text = makeFastq(3 * io::ParallelGzipReader::CHUNK_SIZE, 9);
+    const std::string compressed = gzip(text, 6, Z_DEFAULT_STRATEGY);
+    // inside the header, inside the data, inside the trailer
+    const std::size_t cuts[] = {5, compressed.size() / 3, compressed.size() * 2 / 3, compressed.size() - 3};
+    for (unsigned coresMax = 1; 4 >= coresMax; coresMax *= 4)
+    {
+        for (std::size_t i = 0; sizeof(cuts) / sizeof(cuts[0]) != i; ++i)
+        {
+            CPPUNIT_ASSERT_THROW(parallelGunzip(compressed.substr(0, cuts[i]), coresMax, 65536), common::IoException);
+        }
+    }
+}
+
+void TestParallelGzipReader::testCorrupt()
+{
+    const std::string text = makeFastq(3 * io::ParallelGzipReader::CHUNK_SIZE, 10);
+    const std::string compressed = gzip(text, 6, Z_DEFAULT_STRATEGY);
+    const std::string stored = gzip(text, 0, Z_DEFAULT_STRATEGY);
+
+    std::vector<std::string> corrupt;
+    // magic
+    corrupt.push_back(compressed);
+    corrupt.back()[1] = 0;
+    // compressed data
+    corrupt.push_back(compressed);
+    corrupt.back()[compressed.size() / 2] ^= 0x10;
+    // data of a stored block is only caught by the crc
+    corrupt.push_back(stored);
+    corrupt.back()[stored.size() / 2] ^= 0x10;
+    // crc32
+    corrupt.push_back(compressed);
+    corrupt.back()[compressed.size() - 8] ^= 1;
+    // isize
+    corrupt.push_back(compressed);
+    corrupt.back()[compressed.size() - 4] ^= 1;
+
+    for (unsigned coresMax = 1; 4 >= coresMax; coresMax *= 4)
+    {
+        for (std::size_t i = 0; corrupt.size() != i; ++i)
+        {
+            CPPUNIT_ASSERT_THROW_MESSAGE((boost::format("case %d") % i).str(),
+                parallelGunzip(corrupt[i], coresMax, 65536), common::IoException);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_PARALLEL_GZIP_READER_HH
+#define iSAAC_IO_TEST_PARALLEL_GZIP_READER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestParallelGzipReader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestParallelGzipReader );
+    CPPUNIT_TEST( testStoredBlocks );
+    CPPUNIT_TEST( testFixedBlocks );
+    CPPUNIT_TEST( testDynamicBlocks );
+    CPPUNIT_TEST( testMultiMember );
+    CPPUNIT_TEST( testLongBackReferences );
+    CPPUNIT_TEST( testTruncated );
+    CPPUNIT_TEST( testCorrupt );
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+public:
+    TestParallelGzipReader();
+    void setUp();
+    void tearDown();
+
+    void testStoredBlocks();
+    void testFixedBlocks();
+    void testDynamicBlocks();
+    void testMultiMember();
+    void testLongBackReferences();
+    void testTruncated();
+    void testCorrupt();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_PARALLEL_GZIP_READER_HH
+
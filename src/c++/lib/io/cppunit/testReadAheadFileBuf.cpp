@@ -0,0 +1,202 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testReadAheadFileBuf.cpp
+ **
+ ** Test cases for ReadAheadFileBuf.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <vector>
+
+#include "io/ReadAheadFileBuf.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testReadAheadFileBuf.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestReadAheadFileBuf, registryName("TestReadAheadFileBuf"));
+
+static const std::size_t FILE_SIZE = io::ReadAheadFileBuf::BLOCK_BYTES * 5 + 12345;
+
+TestReadAheadFileBuf::TestReadAheadFileBuf()
+{
+}
+
+static char patternByte(const uint64_t offset)
+{
+    return offset * 7 + offset / 251;
+}
+
+static std::vector<char> makePattern(const uint64_t offset, const std::size_t size)
+{
+    std::vector<char> ret;
+    ret.reserve(size);
+    for (uint64_t i = offset; offset + size != i; ++i)
+    {
+        ret.push_back(patternByte(i));
+    }
+    return ret;
+}
+
+void TestReadAheadFileBuf::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+    filePath_ = tempDirectory_ / "pattern";
+    const std::vector<char> data = makePattern(0, FILE_SIZE);
+    std::ofstream os(filePath_.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    CPPUNIT_ASSERT(os.write(&data.front(), data.size()));
+}
+
+void TestReadAheadFileBuf::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+/**
+ * \brief reads size bytes at the current position of the stream and checks them against the pattern
+ */
+static void checkRead(std::istream &is, const uint64_t offset, const std::size_t size)
+{
+    std::vector<char> read(size);
+    CPPUNIT_ASSERT(is.read(&read.front(), read.size()));
+    CPPUNIT_ASSERT(makePattern(offset, size) == read);
+}
+
+void TestReadAheadFileBuf::testSequential()
+{
+    io::AsyncFileIo asyncIo(io::AsyncFileIoThreads, 4);
+    io::ReadAheadFileBuf buf(asyncIo);
+    CPPUNIT_ASSERT(buf.open(filePath_.c_str()));
+    std::istream is(&buf);
+
+    // odd reads cross the block boundaries
+    static const std::size_t READ_SIZE = 4097;
+    uint64_t offset = 0;
+    for (; FILE_SIZE - offset >= READ_SIZE; offset += READ_SIZE)
+    {
+        checkRead(is, offset, READ_SIZE);
+    }
+    CPPUNIT_ASSERT_EQUAL(std::streamoff(offset), std::streamoff(is.tellg()));
+
+    std::vector<char> read(READ_SIZE);
+    CPPUNIT_ASSERT(!is.read(&read.front(), read.size()));
+    CPPUNIT_ASSERT(is.eof());
+    CPPUNIT_ASSERT_EQUAL(std::streamsize(FILE_SIZE - offset), is.gcount());
+    const std::vector<char> expected = makePattern(offset, FILE_SIZE - offset);
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), read.begin()));
+}
+
+void TestReadAheadFileBuf::testSeek()
+{
+    io::AsyncFileIo asyncIo(io::AsyncFileIoThreads, 4);
+    io::ReadAheadFileBuf buf(asyncIo);
+    CPPUNIT_ASSERT(buf.open(filePath_.c_str()));
+    std::istream is(&buf);
+
+    CPPUNIT_ASSERT(is.seekg(0, std::ios_base::end));
+    CPPUNIT_ASSERT_EQUAL(std::streamoff(FILE_SIZE), std::streamoff(is.tellg()));
+
+    const uint64_t offset = io::ReadAheadFileBuf::BLOCK_BYTES * 3 + 5;
+    CPPUNIT_ASSERT(is.seekg(offset));
+    checkRead(is, offset, 100);
+
+    // backwards within the block in the get area
+    CPPUNIT_ASSERT(is.seekg(-50, std::ios_base::cur));
+    checkRead(is, offset + 50, 100);
+
+    // backwards out of the get area
+    CPPUNIT_ASSERT(is.seekg(1));
+    checkRead(is, 1, 10);
+    CPPUNIT_ASSERT_EQUAL(std::streamoff(11), std::streamoff(is.tellg()));
+
+    // forwards past the read-ahead
+    CPPUNIT_ASSERT(is.seekg(-10, std::ios_base::end));
+    checkRead(is, FILE_SIZE - 10, 10);
+    CPPUNIT_ASSERT_EQUAL(std::char_traits<char>::eof(), is.peek());
+
+    // past the end of file
+    is.clear();
+    CPPUNIT_ASSERT(is.seekg(FILE_SIZE + 100));
+    CPPUNIT_ASSERT_EQUAL(std::char_traits<char>::eof(), is.get());
+    CPPUNIT_ASSERT(is.eof());
+
+    is.clear();
+    CPPUNIT_ASSERT(!is.seekg(-1));
+}
+
+void TestReadAheadFileBuf::testLargeRead()
+{
+    io::AsyncFileIo asyncIo(io::AsyncFileIoThreads, 4);
+    io::ReadAheadFileBuf buf(asyncIo);
+    CPPUNIT_ASSERT(buf.open(filePath_.c_str()));
+    std::istream is(&buf);
+
+    checkRead(is, 0, 100);
+    // goes straight into the destination in several requests
+    checkRead(is, 100, io::ReadAheadFileBuf::DIRECT_READ_BYTES + io::ReadAheadFileBuf::BLOCK_BYTES / 2 + 7);
+    const uint64_t offset = 100 + io::ReadAheadFileBuf::DIRECT_READ_BYTES + io::ReadAheadFileBuf::BLOCK_BYTES / 2 + 7;
+    CPPUNIT_ASSERT_EQUAL(std::streamoff(offset), std::streamoff(is.tellg()));
+    checkRead(is, offset, 1000);
+
+    std::vector<char> read(io::ReadAheadFileBuf::BLOCK_BYTES * 2);
+    CPPUNIT_ASSERT(!is.read(&read.front(), read.size()));
+    CPPUNIT_ASSERT(is.eof());
+    CPPUNIT_ASSERT_EQUAL(std::streamsize(FILE_SIZE - offset - 1000), is.gcount());
+    const std::vector<char> expected = makePattern(offset + 1000, FILE_SIZE - offset - 1000);
+    CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), read.begin()));
+}
+
+void TestReadAheadFileBuf::testErrors()
+{
+    io::AsyncFileIo asyncIo(io::AsyncFileIoThreads, 4);
+    io::ReadAheadFileBuf buf(asyncIo);
+    CPPUNIT_ASSERT(!buf.open((tempDirectory_ / "missing").c_str()));
+    CPPUNIT_ASSERT_EQUAL(ENOENT, errno);
+    CPPUNIT_ASSERT(!buf.is_open());
+
+    {
+        CPPUNIT_ASSERT(buf.open(tempDirectory_.c_str()));
+        std::istream is(&buf);
+        errno = 0;
+        CPPUNIT_ASSERT_EQUAL(std::char_traits<char>::eof(), is.get());
+        // directories have non-zero st_size on most file systems
+        if (errno)
+        {
+            CPPUNIT_ASSERT_EQUAL(EISDIR, errno);
+        }
+    }
+
+    // the file gets shorter than it was when opened
+    CPPUNIT_ASSERT(buf.open(filePath_.c_str()));
+    std::istream is(&buf);
+    CPPUNIT_ASSERT(!truncate(filePath_.c_str(), io::ReadAheadFileBuf::BLOCK_BYTES + 10));
+    std::vector<char> read(1024);
+    std::size_t total = 0;
+    errno = 0;
+    while (is.read(&read.front(), read.size()))
+    {
+        total += is.gcount();
+    }
+    CPPUNIT_ASSERT_EQUAL(ENODATA, errno);
+    CPPUNIT_ASSERT_EQUAL(io::ReadAheadFileBuf::BLOCK_BYTES, total);
+}
@@ -0,0 +1,45 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_READ_AHEAD_FILE_BUF_HH
+#define iSAAC_IO_TEST_READ_AHEAD_FILE_BUF_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+class TestReadAheadFileBuf : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestReadAheadFileBuf );
+    CPPUNIT_TEST( testSequential );
+    CPPUNIT_TEST( testSeek );
+    CPPUNIT_TEST( testLargeRead );
+    CPPUNIT_TEST( testErrors );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path filePath_;
+
+public:
+    TestReadAheadFileBuf();
+    void setUp();
+    void tearDown();
+
+    void testSequential();
+    void testSeek();
+    void testLargeRead();
+    void testErrors();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_READ_AHEAD_FILE_BUF_HH
+
@@ -0,0 +1,211 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BclPacking.cpp
+ **
+ ** Conversion of fastq base calls and quality scores into bcl bytes.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#define iSAAC_BCL_PACKING_X86
+#endif
+
+#include "common/CpuIsa.hh"
+#include "common/Debug.hh"
+#include "oligo/BclPacking.hh"
+#include "oligo/Nucleotides.hh"
+
+namespace isaac
+{
+namespace oligo
+{
+
+static const unsigned INCORRECT_BASE = 5;
+
+static std::size_t packBclScalar(
+    const char *bases, const char *qualities, const std::size_t length, const char q0, char *bcl)
+{
+    static const Translator<true, INCORRECT_BASE> translator;
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        const unsigned char baseValue = translator[bases[i]];
+        if (INVALID_OLIGO == baseValue)
+        {
+            bcl[i] = 0;
+            continue;
+        }
+        const unsigned char baseQuality = qualities[i] - q0;
+        if (INCORRECT_BASE == baseValue || (1 << 6) <= baseQuality)
+        {
+            return i;
+        }
+        bcl[i] = baseValue | (baseQuality << 2);
+    }
+    return length;
+}
+
+#ifdef iSAAC_BCL_PACKING_X86
+
+/**
+ * \brief Bases are compared in uppercase: x & 0xDF equals 'A' only for 'A' and 'a' and so on. Qualities are
+ *        in range when subtracting q0 leaves the upper two bits clear. The 16 bit shift can only move bits
+ *        across the byte boundary into the lower two bits of the next byte, which the mask clears.
+ */
+static std::size_t packBclSse2(
+    const char *bases, const char *qualities, const std::size_t length, const char q0, char *bcl)
+{
+    const __m128i upper = _mm_set1_epi8(char(0xDF));
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i c = _mm_set1_epi8('C');
+    const __m128i g = _mm_set1_epi8('G');
+    const __m128i t = _mm_set1_epi8('T');
+    const __m128i n = _mm_set1_epi8('N');
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i q0s = _mm_set1_epi8(q0);
+    const __m128i qualityHigh = _mm_set1_epi8(char(0xC0));
+    const __m128i qualityMask = _mm_set1_epi8(char(0xFC));
+    const __m128i zero = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    for (; i + sizeof(__m128i) <= length; i += sizeof(__m128i))
+    {
+        const __m128i b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bases + i)), upper);
+        const __m128i q = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(qualities + i)), q0s);
+
+        const __m128i isA = _mm_cmpeq_epi8(b, a);
+        const __m128i isC = _mm_cmpeq_epi8(b, c);
+        const __m128i isG = _mm_cmpeq_epi8(b, g);
+        const __m128i isT = _mm_cmpeq_epi8(b, t);
+        const __m128i isN = _mm_cmpeq_epi8(b, n);
+        const __m128i isBase = _mm_or_si128(_mm_or_si128(isA, isC), _mm_or_si128(isG, isT));
+        const __m128i qualityOk = _mm_cmpeq_epi8(_mm_and_si128(q, qualityHigh), zero);
+
+        const __m128i value = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(isC, one), _mm_and_si128(isG, two)), _mm_and_si128(isT, three));
+        const __m128i packed = _mm_or_si128(value, _mm_and_si128(_mm_slli_epi16(q, 2), qualityMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bcl + i), _mm_andnot_si128(isN, packed));
+
+        const int good = _mm_movemask_epi8(_mm_or_si128(isN, _mm_and_si128(isBase, qualityOk)));
+        if (0xFFFF != good)
+        {
+            return i + __builtin_ctz(~good);
+        }
+    }
+    return i + packBclScalar(bases + i, qualities + i, length - i, q0, bcl + i);
+}
+
+__attribute__((target("avx2")))
+static std::size_t packBclAvx2(
+    const char *bases, const char *qualities, const std::size_t length, const char q0, char *bcl)
+{
+    const __m256i upper = _mm256_set1_epi8(char(0xDF));
+    const __m256i a = _mm256_set1_epi8('A');
+    const __m256i c = _mm256_set1_epi8('C');
+    const __m256i g = _mm256_set1_epi8('G');
+    const __m256i t = _mm256_set1_epi8('T');
+    const __m256i n = _mm256_set1_epi8('N');
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    const __m256i three = _mm256_set1_epi8(3);
+    const __m256i q0s = _mm256_set1_epi8(q0);
+    const __m256i qualityHigh = _mm256_set1_epi8(char(0xC0));
+    const __m256i qualityMask = _mm256_set1_epi8(char(0xFC));
+    const __m256i zero = _mm256_setzero_si256();
+
+    std::size_t i = 0;
+    for (; i + sizeof(__m256i) <= length; i += sizeof(__m256i))
+    {
+        const __m256i b = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bases + i)), upper);
+        const __m256i q = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(qualities + i)), q0s);
+
+        const __m256i isA = _mm256_cmpeq_epi8(b, a);
+        const __m256i isC = _mm256_cmpeq_epi8(b, c);
+        const __m256i isG = _mm256_cmpeq_epi8(b, g);
+        const __m256i isT = _mm256_cmpeq_epi8(b, t);
+        const __m256i isN = _mm256_cmpeq_epi8(b, n);
+        const __m256i isBase = _mm256_or_si256(_mm256_or_si256(isA, isC), _mm256_or_si256(isG, isT));
+        const __m256i qualityOk = _mm256_cmpeq_epi8(_mm256_and_si256(q, qualityHigh), zero);
+
+        const __m256i value = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(isC, one), _mm256_and_si256(isG, two)), _mm256_and_si256(isT, three));
+        const __m256i packed = _mm256_or_si256(value, _mm256_and_si256(_mm256_slli_epi16(q, 2), qualityMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(bcl + i), _mm256_andnot_si256(isN, packed));
+
+        const unsigned good = _mm256_movemask_epi8(_mm256_or_si256(isN, _mm256_and_si256(isBase, qualityOk)));
+        if (0xFFFFFFFFU != good)
+        {
+            return i + __builtin_ctz(~good);
+        }
+    }
+    // the tail is short enough for the 16 byte kernel to finish it
+    return i + packBclSse2(bases + i, qualities + i, length - i, q0, bcl + i);
+}
+
+#endif //iSAAC_BCL_PACKING_X86
+
+const char *getBclPackingKernelName(const BclPackingKernel kernel)
+{
+    static const char *names[] = {"scalar", "sse2", "avx2"};
+    ISAAC_ASSERT_MSG(BclPackingKernelCount > kernel, "Unknown bcl packing kernel " << kernel);
+    return names[kernel];
+}
+
+bool isBclPackingKernelSupported(const BclPackingKernel kernel)
+{
+#ifdef iSAAC_BCL_PACKING_X86
+    __builtin_cpu_init();
+#endif //iSAAC_BCL_PACKING_X86
+    switch (kernel)
+    {
+    case BclPackingScalar:
+        return true;
+#ifdef iSAAC_BCL_PACKING_X86
+    case BclPackingSse2:
+        return __builtin_cpu_supports("sse2");
+    case BclPackingAvx2:
+        return __builtin_cpu_supports("avx2");
+#endif //iSAAC_BCL_PACKING_X86
+    default:
+        return false;
+    }
+}
+
+BclPackingKernel getBestBclPackingKernel()
+{
+    const common::CpuIsa isa = common::getCpuIsa();
+    return common::CpuIsaAvx2 <= isa ? BclPackingAvx2 : common::CpuIsaSse2 <= isa ? BclPackingSse2 : BclPackingScalar;
+}
+
+std::size_t packBcl(
+    const BclPackingKernel kernel,
+    const char *bases, const char *qualities, const std::size_t length, const char q0, char *bcl)
+{
+    switch (kernel)
+    {
+#ifdef iSAAC_BCL_PACKING_X86
+    case BclPackingAvx2:
+        return packBclAvx2(bases, qualities, length, q0, bcl);
+    case BclPackingSse2:
+        return packBclSse2(bases, qualities, length, q0, bcl);
+#endif //iSAAC_BCL_PACKING_X86
+    default:
+        return packBclScalar(bases, qualities, length, q0, bcl);
+    }
+}
+
+} // namespace oligo
+} // namespace isaac
@@ -0,0 +1,159 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file KmerPacking.cpp
+ **
+ ** Vectorized implementations of bcl to k-mer packing.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "common/CpuIsa.hh"
+
+#ifdef iSAAC_CPU_ISA_X86
+#include <immintrin.h>
+#endif //iSAAC_CPU_ISA_X86
+
+#include "common/Debug.hh"
+#include "oligo/Kmer.hh"
+#include "oligo/KmerPacking.hh"
+
+namespace isaac
+{
+namespace oligo
+{
+
+/// bcl keeps 6 bits of quality
+static const unsigned BCL_QUALITY_MAX = 63;
+
+/**
+ * \brief appends length bases to kmer
+ */
+static bool appendBclKmerGeneric(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer)
+{
+    for (unsigned i = 0; length != i; ++i)
+    {
+        if (qualityMin > getQuality(bcl[i]))
+        {
+            return false;
+        }
+        kmer <<= BITS_PER_BASE;
+        kmer |= bcl[i] & BITS_PER_BASE_MASK;
+    }
+    return true;
+}
+
+static bool packBclKmerGeneric(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer)
+{
+    ISAAC_ASSERT_MSG(BCL_KMER_BASES_MAX >= length, "Too many bases for a 64 bit k-mer: " << length);
+    kmer = 0;
+    return appendBclKmerGeneric(bcl, length, qualityMin, kmer);
+}
+
+#ifdef iSAAC_CPU_ISA_X86
+
+/**
+ * \brief Joins the neighbouring 2, 4 and 8 bit fields into the next wider lanes. The field at the lower address
+ *        goes into the upper bits each time, so the 64 bit lanes end up holding 8 bases each in k-mer order.
+ *        Bytes below the quality threshold are the ones for which max(byte, threshold) differs from the byte.
+ *
+ * \return false if any of the 16 bases is below the threshold
+ */
+static bool packBclBlockSse2(const char *bcl, const __m128i threshold, uint64_t &kmer)
+{
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bcl));
+    if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(b, threshold), b)))
+    {
+        return false;
+    }
+    const __m128i bases = _mm_and_si128(b, _mm_set1_epi8(BITS_PER_BASE_MASK));
+    const __m128i pairs = _mm_or_si128(
+        _mm_slli_epi16(_mm_and_si128(bases, _mm_set1_epi16(0x00FF)), 2), _mm_srli_epi16(bases, 8));
+    const __m128i quads = _mm_or_si128(
+        _mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)), 4), _mm_srli_epi32(pairs, 16));
+    const __m128i octets = _mm_or_si128(
+        _mm_slli_epi64(_mm_and_si128(quads, _mm_set1_epi64x(0xFFFFFFFF)), 8), _mm_srli_epi64(quads, 32));
+
+    kmer <<= 16 * BITS_PER_BASE;
+    kmer |= (uint64_t(uint32_t(_mm_cvtsi128_si32(octets))) << 16) |
+        uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(octets, 8)));
+    return true;
+}
+
+static bool packBclKmerSse2(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer)
+{
+    if (BCL_QUALITY_MAX < qualityMin)
+    {
+        return packBclKmerGeneric(bcl, length, qualityMin, kmer);
+    }
+    ISAAC_ASSERT_MSG(BCL_KMER_BASES_MAX >= length, "Too many bases for a 64 bit k-mer: " << length);
+    const __m128i threshold = _mm_set1_epi8(char(qualityMin << 2));
+    kmer = 0;
+    unsigned i = 0;
+    for (; i + sizeof(__m128i) <= length; i += sizeof(__m128i))
+    {
+        if (!packBclBlockSse2(bcl + i, threshold, kmer))
+        {
+            return false;
+        }
+    }
+    return appendBclKmerGeneric(bcl + i, length - i, qualityMin, kmer);
+}
+
+__attribute__((target("avx2")))
+static bool packBclKmerAvx2(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer)
+{
+    if (sizeof(__m256i) != length || BCL_QUALITY_MAX < qualityMin)
+    {
+        // shorter k-mers are at most one 16 byte block and a tail
+        return packBclKmerSse2(bcl, length, qualityMin, kmer);
+    }
+    const __m256i threshold = _mm256_set1_epi8(char(qualityMin << 2));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bcl));
+    if (0xFFFFFFFFU != unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(b, threshold), b))))
+    {
+        return false;
+    }
+    const __m256i bases = _mm256_and_si256(b, _mm256_set1_epi8(BITS_PER_BASE_MASK));
+    const __m256i pairs = _mm256_or_si256(
+        _mm256_slli_epi16(_mm256_and_si256(bases, _mm256_set1_epi16(0x00FF)), 2), _mm256_srli_epi16(bases, 8));
+    const __m256i quads = _mm256_or_si256(
+        _mm256_slli_epi32(_mm256_and_si256(pairs, _mm256_set1_epi32(0xFFFF)), 4), _mm256_srli_epi32(pairs, 16));
+    const __m256i octets = _mm256_or_si256(
+        _mm256_slli_epi64(_mm256_and_si256(quads, _mm256_set1_epi64x(0xFFFFFFFF)), 8), _mm256_srli_epi64(quads, 32));
+
+    kmer = (uint64_t(_mm256_extract_epi64(octets, 0)) << 48) | (uint64_t(_mm256_extract_epi64(octets, 1)) << 32) |
+        (uint64_t(_mm256_extract_epi64(octets, 2)) << 16) | uint64_t(_mm256_extract_epi64(octets, 3));
+    return true;
+}
+
+#endif //iSAAC_CPU_ISA_X86
+
+PackBclKmer getPackBclKmer(const common::CpuIsa isa)
+{
+    switch (isa)
+    {
+#ifdef iSAAC_CPU_ISA_X86
+    case common::CpuIsaAvx512:
+    case common::CpuIsaAvx2:
+        return packBclKmerAvx2;
+    case common::CpuIsaSse41:
+    case common::CpuIsaSse2:
+        return packBclKmerSse2;
+#endif //iSAAC_CPU_ISA_X86
+    default:
+        return packBclKmerGeneric;
+    }
+}
+
+} // namespace oligo
+} // namespace isaac
@@ -0,0 +1,126 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "oligo/BclPacking.hh"
+#include "oligo/Nucleotides.hh"
+
+#include "testBclPacking.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBclPacking, registryName("BclPacking"));
+
+void TestBclPacking::setUp()
+{
+}
+
+void TestBclPacking::tearDown()
+{
+}
+
+/**
+ * \brief the per-base translation FastqReader::extractBcl used before the kernels existed
+ */
+static char referenceBcl(const char base, const char quality, const char q0)
+{
+    static const isaac::oligo::Translator<true, 5> translator;
+    const unsigned char baseValue = translator[base];
+    return isaac::oligo::INVALID_OLIGO == baseValue ? 0 : baseValue | ((quality - q0) << 2);
+}
+
+static const char allBases[] = "ACGTNacgtn";
+
+static void generate(const std::size_t length, const char q0, unsigned &state, std::string &bases, std::string &qualities)
+{
+    bases.resize(length);
+    qualities.resize(length);
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        bases[i] = allBases[rand_r(&state) % (sizeof(allBases) - 1)];
+        qualities[i] = q0 + rand_r(&state) % 64;
+    }
+}
+
+void TestBclPacking::testEquivalence()
+{
+    static const char q0s[] = {33, 64};
+    unsigned state = 1;
+    std::string bases;
+    std::string qualities;
+    for (unsigned kernel = 0; isaac::oligo::BclPackingKernelCount != kernel; ++kernel)
+    {
+        if (!isaac::oligo::isBclPackingKernelSupported(isaac::oligo::BclPackingKernel(kernel)))
+        {
+            continue;
+        }
+        for (const char q0 : q0s)
+        {
+            for (std::size_t length = 0; 200 != length; ++length)
+            {
+                generate(length, q0, state, bases, qualities);
+                std::vector<char> bcl(length + 1, 'x');
+                CPPUNIT_ASSERT_EQUAL(length, isaac::oligo::packBcl(
+                    isaac::oligo::BclPackingKernel(kernel), bases.data(), qualities.data(), length, q0, &bcl.front()));
+                for (std::size_t i = 0; length != i; ++i)
+                {
+                    CPPUNIT_ASSERT_EQUAL(int(referenceBcl(bases[i], qualities[i], q0)), int(bcl[i]));
+                }
+                CPPUNIT_ASSERT_EQUAL('x', bcl.back());
+            }
+        }
+    }
+}
+
+void TestBclPacking::testStops()
+{
+    static const char q0 = 33;
+    static const std::size_t length = 100;
+    unsigned state = 2;
+    std::string bases;
+    std::string qualities;
+    for (unsigned kernel = 0; isaac::oligo::BclPackingKernelCount != kernel; ++kernel)
+    {
+        const isaac::oligo::BclPackingKernel k = isaac::oligo::BclPackingKernel(kernel);
+        if (!isaac::oligo::isBclPackingKernelSupported(k))
+        {
+            continue;
+        }
+        for (std::size_t bad = 0; length != bad; ++bad)
+        {
+            std::vector<char> bcl(length);
+
+            generate(length, q0, state, bases, qualities);
+            bases[bad] = '.';
+            CPPUNIT_ASSERT_EQUAL(bad, isaac::oligo::packBcl(k, bases.data(), qualities.data(), length, q0, &bcl.front()));
+            for (std::size_t i = 0; bad != i; ++i)
+            {
+                CPPUNIT_ASSERT_EQUAL(int(referenceBcl(bases[i], qualities[i], q0)), int(bcl[i]));
+            }
+
+            generate(length, q0, state, bases, qualities);
+            bases[bad] = 'A';
+            qualities[bad] = bad % 2 ? q0 - 1 : q0 + 64;
+            CPPUNIT_ASSERT_EQUAL(bad, isaac::oligo::packBcl(k, bases.data(), qualities.data(), length, q0, &bcl.front()));
+
+            // quality of N does not matter
+            bases[bad] = 'N';
+            CPPUNIT_ASSERT_EQUAL(length, isaac::oligo::packBcl(k, bases.data(), qualities.data(), length, q0, &bcl.front()));
+            CPPUNIT_ASSERT_EQUAL(0, int(bcl[bad]));
+        }
+    }
+}
@@ -0,0 +1,32 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_OLIGO_TEST_BCL_PACKING_HH
+#define iSAAC_OLIGO_TEST_BCL_PACKING_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestBclPacking : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBclPacking );
+    CPPUNIT_TEST( testEquivalence );
+    CPPUNIT_TEST( testStops );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+    void testEquivalence();
+    void testStops();
+};
+
+#endif // #ifndef iSAAC_OLIGO_TEST_BCL_PACKING_HH
@@ -0,0 +1,90 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "common/CpuIsa.hh"
+#include "oligo/Kmer.hh"
+#include "oligo/KmerPacking.hh"
+
+#include "testKmerPacking.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestKmerPacking, registryName("KmerPacking"));
+
+void TestKmerPacking::setUp()
+{
+}
+
+void TestKmerPacking::tearDown()
+{
+}
+
+/**
+ * \brief the loop updateSeedKmer used before the kernels existed
+ */
+static bool referenceKmer(const char *bcl, const unsigned length, const unsigned qualityMin, uint64_t &kmer)
+{
+    kmer = 0;
+    for (unsigned i = 0; length != i; ++i)
+    {
+        if (qualityMin > isaac::oligo::getQuality(bcl[i]))
+        {
+            return false;
+        }
+        kmer = (kmer << isaac::oligo::BITS_PER_BASE) | (bcl[i] & isaac::oligo::BITS_PER_BASE_MASK);
+    }
+    return true;
+}
+
+void TestKmerPacking::testEquivalence()
+{
+    static const unsigned qualityMins[] = {0, 1, 5, 30, 63, 64, 100};
+    unsigned state = 1;
+    std::vector<char> bcl(isaac::oligo::BCL_KMER_BASES_MAX);
+    for (unsigned isa = 0; isaac::common::CpuIsaCount != isa; ++isa)
+    {
+        if (!isaac::common::isCpuIsaSupported(isaac::common::CpuIsa(isa)))
+        {
+            continue;
+        }
+        const isaac::oligo::PackBclKmer kernel = isaac::oligo::getPackBclKmer(isaac::common::CpuIsa(isa));
+        for (unsigned length = 0; isaac::oligo::BCL_KMER_BASES_MAX >= length; ++length)
+        {
+            for (const unsigned qualityMin : qualityMins)
+            {
+                for (unsigned attempt = 0; 100 != attempt; ++attempt)
+                {
+                    for (char &b : bcl)
+                    {
+                        // mostly good qualities so that the whole length gets packed often enough
+                        b = char(rand_r(&state) % 8 ? rand_r(&state) | 0x80 : rand_r(&state));
+                    }
+                    uint64_t expected = 0;
+                    const bool expectedResult = referenceKmer(&bcl.front(), length, qualityMin, expected);
+                    uint64_t kmer = -1UL;
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(isaac::common::getCpuIsaName(isaac::common::CpuIsa(isa)),
+                                                 expectedResult, kernel(&bcl.front(), length, qualityMin, kmer));
+                    if (expectedResult)
+                    {
+                        CPPUNIT_ASSERT_EQUAL_MESSAGE(isaac::common::getCpuIsaName(isaac::common::CpuIsa(isa)),
+                                                     expected, kmer);
+                    }
+                }
+            }
+        }
+    }
+}
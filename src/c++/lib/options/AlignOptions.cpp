@@ -101,6 +101,13 @@ AlignOptions::AlignOptions()
     , targetBinSize(0)
     , jobs(boost::thread::hardware_concurrency())
     , enableNuma(false)
+    , hugePagesString("off")
+    , hugePages(common::HugePagesOff)
+    , asyncIoString("auto")
+    , asyncIo(io::AsyncFileIoAuto)
+    , asyncIoQueueDepth(16)
+    , cpuIsaString("auto")
+    , cpuIsa(common::getBestCpuIsa())
     , seedBaseQualityMin(10)
     , repeatThreshold(10)
     , mateDriftRange(-1)
@@ -134,6 +141,7 @@ AlignOptions::AlignOptions()
     , rescueShadows(true)
     , gappedMismatchesMax(5)
     , smitWatermanGapsMax(2)
+    , smithWatermanBandWidth(16)
     , useSmithWaterman("always")
     , smartSmithWaterman(false)
     , noSmithWaterman(false)
@@ -156,6 +164,7 @@ AlignOptions::AlignOptions()
     , memoryControl(common::ScopedMallocBlock::Invalid)
     , memoryLimit(getUlimitV() / 1024 / 1024 / 1024)
     , inputLoadersMax(64) // bcl files are small, there are lots of them and at the moment they are expected to sit on a highly-parallelizable high-latency network storage
+    , parallelGzip(true)
     , tempSaversMax(1000 - 256 - inputLoadersMax)   // typical ulimit -f is 1024. Make some room for unusual temporary files (such as bam unpaired cluster cache).
     , tempLoadersMax(1) // assuming the temporary data sits on a low-latency storage (local spinning disk or ssd, reduce the competition for reading to increase the throughput.
                         // raise this number for high-latency temp storage such as network drive.
@@ -164,11 +173,15 @@ AlignOptions::AlignOptions()
     , realignGapsString("sample")
     , realignGaps(build::REALIGN_SAMPLE)
     , bamGzipLevel(boost::iostreams::gzip::best_speed)
+    , bamDeflateBackendString("zlib")
+    , bamDeflateBackend(bgzf::DeflateZlib)
     , bamPuFormat("%F:%L:%B")
     , bamProduceMd5(true)
     , expectedBgzfCompressionRatio(1)
     , singleLibrarySamples(true)
     , keepDuplicates(true)
+    , duplicateGroupingString("hash")
+    , duplicateGrouping(build::GROUP_DUPLICATES_BY_HASH)
     , markDuplicates(true)
     , anchorMate(true)
     , binRegexString("all")
@@ -176,11 +189,16 @@ AlignOptions::AlignOptions()
     , statsImageFormatString("none")
     , statsImageFormat(reports::AlignmentReportGenerator::gif)
     , bufferBins(true)
+    , referenceHashCache(false)
+    , referenceHashNumaReplicas(false)
+    , annotationCache(false)
+    , annotationNumaReplicas(true)
     , qScoreBin(false)
     , qScoreBinValueString("identity")
     , bamExcludeTags("ZX,ZY")
     , optionalFeatures(parseBamExcludeTags(bamExcludeTags))
     , pessimisticMapQ(false)
+    , pipelineBuild(false)
 {
     unnamedOptions_.add_options()
         ("base-calls-directory"   , bpo::value<std::vector<bfs::path> >(&baseCallsDirectoryList)->multitoken(),
@@ -250,6 +268,10 @@ AlignOptions::AlignOptions()
                 "\n  - all             : realign against gaps found in all samples")
         ("known-indels"           , bpo::value<bfs::path >(&knownIndelsPath),
                 "path to a VCF file containing known indels fore realignment.")
+        ("bam-deflate-backend"      , bpo::value<std::string>(&bamDeflateBackendString)->default_value(bamDeflateBackendString),
+                "Implementation of deflate used to compress BAM records."
+                "\n  - zlib       : output is identical to the one produced by earlier versions"
+                "\n  - libdeflate : faster. Only available if libdeflate was found when Isaac was built")
         ("bam-gzip-level"           , bpo::value<int>(&bamGzipLevel)->default_value(bamGzipLevel),
                 "Gzip level to use for BAM")
         ("bam-header-tag"           , bpo::value<std::vector<std::string> >(&bamHeaderTags)->multitoken(),
@@ -330,10 +352,30 @@ AlignOptions::AlignOptions()
                 "Maximum number of compute threads to run in parallel")
         ("enable-numa"                   , bpo::value<bool>(&enableNuma)->default_value(enableNuma)->implicit_value(true),
                 "Replicate static data across NUMA nodes, lock threads to their NUMA nodes, allocate thread private data on the corresponding NUMA node")
+        ("huge-pages"                   , bpo::value<std::string>(&hugePagesString)->default_value(hugePagesString),
+                "Back the reference hash and contigs with 2 megabyte pages to reduce TLB misses of random hash lookups: "
+                "\n  - off             : Use regular pages."
+                "\n  - transparent     : Request transparent huge pages with madvise."
+                "\n  - explicit        : Use the preallocated hugetlbfs pool (vm.nr_hugepages). Falls back to transparent when the pool is too small.")
+        ("async-io"                   , bpo::value<std::string>(&asyncIoString)->default_value(asyncIoString),
+                "Backend for the reads and writes of the temporary bin files: "
+                "\n  - auto            : io-uring when the kernel allows it, threads otherwise."
+                "\n  - io-uring        : Linux io_uring. Fails if not available."
+                "\n  - threads         : Pool of threads doing blocking reads and writes.")
+        ("async-io-queue-depth"       , bpo::value<unsigned>(&asyncIoQueueDepth)->default_value(asyncIoQueueDepth),
+                "Maximum number of temporary bin file reads or writes in flight at the same time per --async-io backend instance")
+        ("cpu-isa"                    , bpo::value<std::string>(&cpuIsaString)->default_value(cpuIsaString),
+                "Instruction set for the vectorized kernels such as Smith-Waterman and mismatch counting: "
+                "\n  - auto            : The most capable one the cpu supports."
+                "\n  - generic         : No explicit vectorization."
+                "\n  - sse2, sse4.1, avx2, avx512 : Fails if the cpu does not support it.")
         ("seed-base-quality-min"                   , bpo::value<unsigned int>(&seedBaseQualityMin)->default_value(seedBaseQualityMin),
                 "Minimum base quality for the seed to be used in alignment candidate search.")
         ("input-concurrent-load"            , bpo::value<unsigned>(&inputLoadersMax)->default_value(inputLoadersMax),
                 "Maximum number of concurrent file read operations for --base-calls")
+        ("parallel-gzip"            , bpo::value<bool>(&parallelGzip)->default_value(parallelGzip),
+                "Decompress gzip fastq that is not bgzf-compressed on multiple threads. When set to 0, zlib "
+                "decompresses it on a single thread")
         ("temp-concurrent-load"            , bpo::value<unsigned>(&tempLoadersMax)->default_value(tempLoadersMax),
                 "Maximum number of concurrent file read operations for --temp-directory")
         ("temp-concurrent-save"            , bpo::value<unsigned>(&tempSaversMax)->default_value(tempSaversMax),
@@ -450,6 +492,9 @@ AlignOptions::AlignOptions()
         ("smith-waterman-gaps-max"   , bpo::value<unsigned>(&smitWatermanGapsMax)->default_value(smitWatermanGapsMax),
                 "Maximum number of gaps that can be introduced into an alignment by Smith-Waterman algorithm. If the "
                 "optimum alignment has more gaps, it is simply ignored as an alignment candidate.")
+        ("smith-waterman-band-width"   , bpo::value<unsigned>(&smithWatermanBandWidth)->default_value(smithWatermanBandWidth),
+                "Width of the band around the ungapped alignment explored by Smith-Waterman. One of 16, 32 or 64. Wider "
+                "bands find longer gaps at the expense of the alignment speed.")
         ("use-smith-waterman"     , bpo::value<std::string>(&useSmithWaterman)->default_value(useSmithWaterman),
                 "One of the following:"
                 "\n - always           : Use smith-waterman to reduce the amount of mismatches in aligned reads"
@@ -487,6 +532,10 @@ AlignOptions::AlignOptions()
                 "Keep duplicate pairs in the bam file (with 0x400 flag set in all but the best one)")
         ("mark-duplicates" , bpo::value<bool>(&markDuplicates)->default_value(markDuplicates),
                 "If not set and --keep-duplicates is set, the duplicates are not discarded and not flagged.")
+        ("duplicate-grouping" , bpo::value<std::string>(&duplicateGroupingString)->default_value(duplicateGroupingString),
+                "How the candidates are grouped for duplicate detection. Both methods find the same duplicates."
+                "\n  - hash       : group on hash of position, mate and library. Uses multiple threads per bin"
+                "\n  - sort       : order the whole bin by position, mate, library and rank")
         ("anchor-mate" , bpo::value<bool>(&anchorMate)->default_value(anchorMate),
                 "Allow entire pair to be anchored by only one read if it has not been realigned. If not set, each "
                 "read is anchored individually and does not affect anchoring of its mate.")
@@ -509,7 +558,10 @@ AlignOptions::AlignOptions()
         ("memory-limit,m"           , bpo::value<uint64_t>(&memoryLimit)->default_value(memoryLimit),
                 "Limits major memory consumption operations to a set number of gigabytes. "
                 "0 means no limit, however 0 is not allowed as in such case iSAAC will most likely consume "
-                "all the memory on the system and cause it to crash. Default value is taken from ulimit -v.")
+                "all the memory on the system and cause it to crash. Default value is taken from ulimit -v. "
+                "With bam input, mates that are far apart in the file are paired in parts of at most an eighth of "
+                "the limit (3 gigabytes at most). Parts that are still larger after three rounds of splitting are "
+                "paired whole.")
         ("cluster,c"                , bpo::value<std::vector<std::size_t> >(&clusterIdList)->multitoken(),
                 "Restrict the alignment to the specified cluster Id (multiple entries allowed)")
         ("tls"                      , bpo::value<std::string>(&tlsString),
@@ -524,6 +576,26 @@ AlignOptions::AlignOptions()
                 "If set, Align will buffer bin data before writing it out. If not set, Align will keep an open "
                 "file handle per bin and write data into corresponding bins as it appears. This option requires extra RAM, but "
                 "improves performance on some file systems.")
+        ("pipeline-build"   , bpo::value<bool>(&pipelineBuild)->default_value(pipelineBuild),
+                "If set, Bam generation starts while the alignment is still running. Bins are taken for sorting as "
+                "soon as all the lanes that can store data into them are done. Alignment and Bam generation share "
+                "the --memory-limit. Requires --memory-control off, --keep-unaligned other than 'front' and "
+                "running from Start to Bam or Finish.")
+        ("reference-hash-cache"   , bpo::value<bool>(&referenceHashCache)->default_value(referenceHashCache),
+                "If set, the seed hash table is stored next to the sorted-reference.xml the first time it is "
+                "generated and memory-mapped by subsequent runs instead of being rebuilt. Concurrent runs on the "
+                "same machine share a single copy of the mapped hash in the page cache. The stored hash is rebuilt "
+                "automatically when the reference contigs change.")
+        ("reference-hash-numa-replicas"   , bpo::value<bool>(&referenceHashNumaReplicas)->default_value(referenceHashNumaReplicas),
+                "If set, the seed hash table mapped with --reference-hash-cache is copied into the memory of each "
+                "NUMA node. The copies are private to the process. When not set, the mapping is used directly.")
+        ("annotation-cache"   , bpo::value<bool>(&annotationCache)->default_value(annotationCache),
+                "If set, the k-uniqueness annotation is stored uncompressed next to the annotation file the first "
+                "time it is loaded and memory-mapped read-only by subsequent runs. Concurrent runs on the same "
+                "machine share a single copy of the mapped annotation in the page cache.")
+        ("annotation-numa-replicas"   , bpo::value<bool>(&annotationNumaReplicas)->default_value(annotationNumaReplicas),
+                "If set, the k-uniqueness annotation is copied into the memory of each NUMA node. Turn off to "
+                "save memory. Annotation mapped with --annotation-cache is never copied.")
         ("remap-qscores"   , bpo::value<std::string>(&qScoreBinValueString),
                 "Replace the base calls qscores according to the rules provided."
                 "\n - identity   : No remapping. Original qscores are preserved"
@@ -713,6 +785,115 @@ void AlignOptions::parseExecutionTargets()
                          workflow::AlignWorkflow::Last;
 }
 
+void AlignOptions::parseHugePages()
+{
+    const std::vector<std::string> allowedHugePagesStrings =
+        boost::assign::list_of("off")("transparent")("explicit");
+    std::vector<std::string>::const_iterator hugePagesIt =
+        std::find(allowedHugePagesStrings.begin(), allowedHugePagesStrings.end(), hugePagesString);
+    if (allowedHugePagesStrings.end() == hugePagesIt)
+    {
+        const boost::format message = boost::format("\n   *** Invalid value given '%s' for --huge-pages ***\n") %
+            hugePagesString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+    const std::vector<std::string>::const_iterator::difference_type hugePagesPos =
+        hugePagesIt - allowedHugePagesStrings.begin();
+    hugePages =
+        0 == hugePagesPos ? common::HugePagesOff :
+        1 == hugePagesPos ? common::HugePagesTransparent : common::HugePagesExplicit;
+}
+
+void AlignOptions::parseAsyncIo()
+{
+    const std::vector<std::string> allowedAsyncIoStrings =
+        boost::assign::list_of("auto")("io-uring")("threads");
+    std::vector<std::string>::const_iterator asyncIoIt =
+        std::find(allowedAsyncIoStrings.begin(), allowedAsyncIoStrings.end(), asyncIoString);
+    if (allowedAsyncIoStrings.end() == asyncIoIt)
+    {
+        const boost::format message = boost::format("\n   *** Invalid value given '%s' for --async-io ***\n") %
+            asyncIoString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+    const std::vector<std::string>::const_iterator::difference_type asyncIoPos =
+        asyncIoIt - allowedAsyncIoStrings.begin();
+    asyncIo =
+        0 == asyncIoPos ? io::AsyncFileIoAuto :
+        1 == asyncIoPos ? io::AsyncFileIoUring : io::AsyncFileIoThreads;
+
+    if (!asyncIoQueueDepth)
+    {
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException("\n   *** --async-io-queue-depth must be positive ***\n"));
+    }
+}
+
+void AlignOptions::parseBamDeflateBackend()
+{
+    const std::vector<std::string> allowedBamDeflateBackendStrings =
+        boost::assign::list_of("zlib")("libdeflate");
+    std::vector<std::string>::const_iterator bamDeflateBackendIt =
+        std::find(allowedBamDeflateBackendStrings.begin(), allowedBamDeflateBackendStrings.end(), bamDeflateBackendString);
+    if (allowedBamDeflateBackendStrings.end() == bamDeflateBackendIt)
+    {
+        const boost::format message = boost::format("\n   *** Invalid value given '%s' for --bam-deflate-backend ***\n") %
+            bamDeflateBackendString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+    bamDeflateBackend = 0 == bamDeflateBackendIt - allowedBamDeflateBackendStrings.begin() ?
+        bgzf::DeflateZlib : bgzf::DeflateLibdeflate;
+
+    if (!bgzf::isDeflateBackendSupported(bamDeflateBackend))
+    {
+        const boost::format message = boost::format("\n   *** --bam-deflate-backend %s is not supported by this build ***\n") %
+            bamDeflateBackendString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+}
+
+void AlignOptions::parseDuplicateGrouping()
+{
+    if ("hash" == duplicateGroupingString)
+    {
+        duplicateGrouping = build::GROUP_DUPLICATES_BY_HASH;
+    }
+    else if ("sort" == duplicateGroupingString)
+    {
+        duplicateGrouping = build::GROUP_DUPLICATES_BY_SORT;
+    }
+    else
+    {
+        const boost::format message = boost::format("\n   *** Invalid value given '%s' for --duplicate-grouping ***\n") %
+            duplicateGroupingString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+}
+
+void AlignOptions::parseCpuIsa()
+{
+    if ("auto" == cpuIsaString)
+    {
+        cpuIsa = common::getBestCpuIsa();
+        return;
+    }
+    for (int isa = common::CpuIsaGeneric; common::CpuIsaCount != isa; ++isa)
+    {
+        if (cpuIsaString == common::getCpuIsaName(common::CpuIsa(isa)))
+        {
+            if (!common::isCpuIsaSupported(common::CpuIsa(isa)))
+            {
+                const boost::format message = boost::format("\n   *** --cpu-isa %s is not supported by this cpu ***\n") %
+                    cpuIsaString;
+                BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+            }
+            cpuIsa = common::CpuIsa(isa);
+            return;
+        }
+    }
+    const boost::format message = boost::format("\n   *** Invalid value given '%s' for --cpu-isa ***\n") % cpuIsaString;
+    BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+}
+
 void AlignOptions::parseMemoryControl()
 {
     const std::vector<std::string> allowedMemoryControlStrings =
@@ -816,6 +997,13 @@ void AlignOptions::parseUseSmithWaterman()
         smartSmithWaterman = false;
         noSmithWaterman = true;
     }
+
+    if (16 != smithWatermanBandWidth && 32 != smithWatermanBandWidth && 64 != smithWatermanBandWidth)
+    {
+        const format message = format("\n   *** Unsupported --smith-waterman-band-width %d. Supported are 16, 32 and 64 ***\n") %
+            smithWatermanBandWidth;
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
 }
 
 workflow::AlignWorkflow::OptionalFeatures AlignOptions::parseBamExcludeTags(std::string strBamExcludeTags)
@@ -870,6 +1058,32 @@ void AlignOptions::parseBamExcludeTags()
     }
 }
 
+void AlignOptions::parsePipelineBuild()
+{
+    if (!pipelineBuild)
+    {
+        return;
+    }
+
+    if (common::ScopedMallocBlock::Off != memoryControl)
+    {
+        const format message = format("\n   *** The 'pipeline-build' requires 'memory-control' to be 'off' ***\n");
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+
+    if (keepUnaligned && !putUnalignedInTheBack)
+    {
+        const format message = format("\n   *** The 'pipeline-build' can't be used with 'keep-unaligned' 'front' ***\n");
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+
+    if (workflow::AlignWorkflow::Start != startFrom || workflow::AlignWorkflow::BamDone != stopAt)
+    {
+        const format message = format("\n   *** The 'pipeline-build' requires running from 'Start' to 'Bam' ***\n");
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+}
+
 void AlignOptions::parseDodgyAlignmentScore()
 {
     if ("Unknown" == dodgyAlignmentScoreString)
@@ -1376,6 +1590,11 @@ void AlignOptions::postProcess(bpo::variables_map &vm)
 
     parseExecutionTargets();
     parseMemoryControl();
+    parseHugePages();
+    parseAsyncIo();
+    parseCpuIsa();
+    parseBamDeflateBackend();
+    parseDuplicateGrouping();
     parseGapScoring();
     parseUseSmithWaterman();
     parseDodgyAlignmentScore();
@@ -1384,6 +1603,7 @@ void AlignOptions::postProcess(bpo::variables_map &vm)
     optionalFeatures = parseBamExcludeTags(bamExcludeTags);
     parseQScoreBinValues();
     parseBamExcludeTags();
+    parsePipelineBuild();
 }
 
 
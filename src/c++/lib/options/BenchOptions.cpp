@@ -0,0 +1,122 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchOptions.cpp
+ **
+ ** Command line options for 'isaac-bench'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Exceptions.hh"
+#include "options/BenchOptions.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+namespace bfs = boost::filesystem;
+using common::InvalidOptionException;
+using boost::format;
+
+BenchOptions::BenchOptions()
+    : tempDirectory_("./Temp")
+    , threads_(boost::thread::hardware_concurrency())
+    , seed_(1)
+    , repeats_(3)
+    , referenceLength_(4000000)
+    , contigs_(4)
+    , clusters_(200000)
+    , readLength_(150)
+    , bamGzipLevel_(1)
+{
+    namedOptions_.add_options()
+        ("temp-directory,t"     , bpo::value<bfs::path>(&tempDirectory_)->default_value(tempDirectory_),
+                "Directory for the synthetic fastq, bin and bam files. Created if it does not exist."
+            )
+        ("output-file,o"        , bpo::value<bfs::path>(&outputFile_),
+                "File to store the results in. Results go to the standard output if not specified."
+            )
+        ("jobs,j"               , bpo::value<unsigned>(&threads_)->default_value(threads_),
+                "Maximum number of threads used by the engines that are multithreaded in isaac-align. "
+                "The rest is measured on a single thread."
+            )
+        ("seed"                 , bpo::value<unsigned>(&seed_)->default_value(seed_),
+                "Random seed for the synthetic reference and reads. Results are only comparable between runs "
+                "that use the same seed and sizes."
+            )
+        ("repeats"              , bpo::value<unsigned>(&repeats_)->default_value(repeats_),
+                "Number of times each benchmark is run. The fastest run is reported."
+            )
+        ("reference-length"     , bpo::value<uint64_t>(&referenceLength_)->default_value(referenceLength_),
+                "Total number of bases in the synthetic reference."
+            )
+        ("contigs"              , bpo::value<unsigned>(&contigs_)->default_value(contigs_),
+                "Number of contigs the synthetic reference is split into."
+            )
+        ("clusters"             , bpo::value<unsigned>(&clusters_)->default_value(clusters_),
+                "Number of synthetic read pairs."
+            )
+        ("read-length"          , bpo::value<unsigned>(&readLength_)->default_value(readLength_),
+                "Length of each read of the synthetic pairs."
+            )
+        ("bam-gzip-level"       , bpo::value<unsigned>(&bamGzipLevel_)->default_value(bamGzipLevel_),
+                "Gzip level used for the fastq compression and the bam serialization benchmarks."
+            )
+        ;
+}
+
+void BenchOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help") ||  vm.count("version"))
+    {
+        return;
+    }
+
+    if (!threads_ || !repeats_ || !contigs_ || !clusters_)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException(
+            "\n   *** --jobs, --repeats, --contigs and --clusters must be greater than 0 ***\n"));
+    }
+
+    if (64 > readLength_ || 1000 < readLength_)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException(
+            (format("\n   *** --read-length must be between 64 and 1000: %d ***\n") % readLength_).str()));
+    }
+
+    if (referenceLength_ / contigs_ < readLength_ * 8)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException(
+            (format("\n   *** --reference-length must allow at least %d bases per contig ***\n") % (readLength_ * 8)).str()));
+    }
+
+    if (9 < bamGzipLevel_)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException(
+            (format("\n   *** --bam-gzip-level must be between 0 and 9: %d ***\n") % bamGzipLevel_).str()));
+    }
+
+    tempDirectory_ = bfs::absolute(tempDirectory_);
+    if (!outputFile_.empty())
+    {
+        outputFile_ = bfs::absolute(outputFile_);
+    }
+}
+
+} //namespace options
+} // namespace isaac
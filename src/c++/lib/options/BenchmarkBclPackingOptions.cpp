@@ -0,0 +1,61 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkBclPackingOptions.cpp
+ **
+ ** Command line options for 'isaac-bench bcl-packing'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "options/BenchmarkBclPackingOptions.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+
+BenchmarkBclPackingOptions::BenchmarkBclPackingOptions()
+    : readLength(150)
+    , reads(100000)
+    , repeats(100)
+    , q0('!')
+{
+    namedOptions_.add_options()
+        ("read-length",         bpo::value<unsigned>(&readLength)->default_value(readLength),
+                                "Number of bases in each generated read")
+        ("reads",               bpo::value<unsigned>(&reads)->default_value(reads),
+                                "Number of reads generated")
+        ("repeats",             bpo::value<unsigned>(&repeats)->default_value(repeats),
+                                "Number of times each kernel packs all the reads")
+        ("fastq-q0",            bpo::value<char>(&q0)->default_value(q0),
+                                "Character that stands for base quality 0 in the generated reads")
+        ;
+}
+
+void BenchmarkBclPackingOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help"))
+    {
+        return;
+    }
+    using isaac::common::InvalidOptionException;
+    if (!readLength || !reads || !repeats)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException("\n   *** --read-length, --reads and --repeats must be greater than 0 ***\n"));
+    }
+}
+
+} //namespace option
+} // namespace isaac
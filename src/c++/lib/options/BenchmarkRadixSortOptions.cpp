@@ -0,0 +1,63 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkRadixSortOptions.cpp
+ **
+ ** Command line options for 'isaac-bench radix-sort'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/thread.hpp>
+
+#include "options/BenchmarkRadixSortOptions.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+
+BenchmarkRadixSortOptions::BenchmarkRadixSortOptions()
+    : threads(boost::thread::hardware_concurrency())
+    , records(16000000)
+    , binLength(16 * 1024 * 1024)
+    , repeats(3)
+{
+    namedOptions_.add_options()
+        ("jobs,j",              bpo::value<unsigned>(&threads)->default_value(threads),
+                                "Number of threads available to the parallel sorts")
+        ("records",             bpo::value<uint64_t>(&records)->default_value(records),
+                                "Number of fragments in the generated bin")
+        ("bin-length",          bpo::value<uint64_t>(&binLength)->default_value(binLength),
+                                "Number of reference positions the generated fragments are spread over")
+        ("repeats",             bpo::value<unsigned>(&repeats)->default_value(repeats),
+                                "Number of times each sort is timed. The best time is reported")
+        ;
+}
+
+void BenchmarkRadixSortOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help"))
+    {
+        return;
+    }
+    using isaac::common::InvalidOptionException;
+    if (!threads || !records || !binLength || !repeats)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException("\n   *** --jobs, --records, --bin-length and --repeats must be greater than 0 ***\n"));
+    }
+}
+
+} //namespace option
+} // namespace isaac
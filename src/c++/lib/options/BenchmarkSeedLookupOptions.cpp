@@ -0,0 +1,91 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkSeedLookupOptions.cpp
+ **
+ ** Command line options for 'isaac-bench seed-lookup'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <string>
+#include <vector>
+#include <boost/assign.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+#include "oligo/Kmer.hh"
+#include "options/BenchmarkSeedLookupOptions.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+
+BenchmarkSeedLookupOptions::BenchmarkSeedLookupOptions()
+    : threads(boost::thread::hardware_concurrency())
+    , clusters(200000)
+    , readLength(150)
+    , rounds(4)
+    , prefetchClustersAhead(4)
+{
+    namedOptions_.add_options()
+        ("reference-genome,r",  bpo::value<boost::filesystem::path>(&sortedReferenceXml),
+                                "Full path to the sorted-reference.xml of the reference to build the seed hash for")
+        ("jobs,j",              bpo::value<unsigned>(&threads)->default_value(threads),
+                                "Number of threads doing the lookups")
+        ("clusters",            bpo::value<unsigned>(&clusters)->default_value(clusters),
+                                "Number of clusters each thread looks up in each mode and round")
+        ("read-length",         bpo::value<unsigned>(&readLength)->default_value(readLength),
+                                "Length of the simulated single-ended reads")
+        ("rounds",              bpo::value<unsigned>(&rounds)->default_value(rounds),
+                                "Number of rounds. Each round looks up fresh clusters in both modes, "
+                                "alternating which mode goes first")
+        ("prefetch-clusters-ahead", bpo::value<unsigned>(&prefetchClustersAhead)->default_value(prefetchClustersAhead),
+                                "Distance at which the seed matches of the upcoming clusters are prefetched")
+        ;
+}
+
+void BenchmarkSeedLookupOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help"))
+    {
+        return;
+    }
+    using isaac::common::InvalidOptionException;
+    using boost::format;
+    const std::vector<std::string> requiredOptions = boost::assign::list_of("reference-genome");
+    BOOST_FOREACH(const std::string &required, requiredOptions)
+    {
+        if(!vm.count(required))
+        {
+            const format message = format("\n   *** The '%s' option is required ***\n") % required;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+    if (!threads || !clusters || !rounds || !prefetchClustersAhead)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException(
+            "\n   *** --jobs, --clusters, --rounds and --prefetch-clusters-ahead must be greater than 0 ***\n"));
+    }
+    if (readLength < oligo::KmerTraits<oligo::ShortKmerType>::KMER_BASES * 2)
+    {
+        const format message = format("\n   *** --read-length must be at least %d ***\n") %
+            (oligo::KmerTraits<oligo::ShortKmerType>::KMER_BASES * 2);
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+}
+
+} //namespace option
+} // namespace isaac
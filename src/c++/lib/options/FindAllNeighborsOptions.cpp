@@ -0,0 +1,134 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file FindAllNeighborsOptions.cpp
+ **
+ ** \brief See FindAllNeighborsOptions.hh.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/assign.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Exceptions.hh"
+#include "oligo/Kmer.hh"
+#include "options/FindAllNeighborsOptions.hh"
+#include "reference/ReferenceKmer.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+namespace bfs = boost::filesystem;
+
+FindAllNeighborsOptions::FindAllNeighborsOptions()
+    : maskWidth(0)
+    , referenceGenome("")
+    , jobs(boost::thread::hardware_concurrency())
+    , memoryLimit(0)
+{
+    namedOptions_.add_options()
+        ("reference-genome,r",  bpo::value<bfs::path>(&referenceGenome),
+                          "The input 'sorted-reference.xml' file. Must list the mask files for all seed lengths")
+        ("jobs,j", bpo::value<unsigned>(&jobs)->default_value(jobs),
+                          "Maximum number of compute threads to run in parallel. Parallel sorting will use all cores regardless.")
+        ("mask-width,w",   bpo::value<unsigned int>(&maskWidth)->default_value(maskWidth),
+                          "Width in bits of the mask used to split the sorted files. All 2^mask-width masks are processed")
+        ("memory-limit",   bpo::value<uint64_t>(&memoryLimit)->default_value(memoryLimit),
+                          "Limits the memory used to the specified number of gigabytes. The k-mers of a mask that don't fit "
+                          "are split into partitions and the neighbors are counted one partition at a time. "
+                          "The limit includes the contigs and the annotations. "
+                          "Special value of 0 keeps all k-mers of a mask in memory at once.")
+        ("output-file,o",  bpo::value<bfs::path>(&uniquenessFile),
+                          "The output k-uniqueness annotation file path")
+        ("repeat-output-file",  bpo::value<bfs::path>(&repeatnessFile),
+                          "The output k-repeatness annotation file path")
+        ("seed-length,s",  bpo::value<std::vector<unsigned> >(&seedLengths)->multitoken(),
+                          "Lengths of reference k-mer in bases to annotate. Must be divisible by 4. Multiple entries allowed.")
+        ;
+}
+
+common::Options::Action FindAllNeighborsOptions::parse(int argc, char *argv[])
+{
+    const std::vector<std::string> allOptions(argv, argv + argc);
+    common::Options::Action ret = common::Options::parse(argc, argv);
+    if (RUN == ret)
+    {
+        ISAAC_THREAD_CERR << "argc: " << argc << " argv: " << boost::join(allOptions, " ") << std::endl;
+    }
+    return ret;
+}
+
+
+void FindAllNeighborsOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help"))
+    {
+        return;
+    }
+    using isaac::common::InvalidOptionException;
+    using boost::format;
+    const std::vector<std::string> requiredOptions = boost::assign::list_of
+        ("reference-genome")("output-file")("repeat-output-file")("seed-length");
+    BOOST_FOREACH(const std::string &required, requiredOptions)
+    {
+        if(!vm.count(required))
+        {
+            const format message = format("\n   *** The '%s' option is required ***\n") % required;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+    typedef std::pair<bfs::path *, std::string> PathOption;
+    const std::vector<PathOption> pathOptions = boost::assign::list_of
+        (PathOption(&referenceGenome, "reference-genome"))
+        ;
+    BOOST_FOREACH(const PathOption &pathOption, pathOptions)
+    {
+        if(pathOption.first->empty())
+        {
+            const format message = format("\n   *** The '%s' can't be empty (use '.' for current directory) ***\n") % pathOption.second;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+    const std::vector<PathOption> existingPaths = boost::assign::list_of
+        (PathOption(&referenceGenome, "reference-genome"))
+        ;
+    BOOST_FOREACH(const PathOption &pathOption, existingPaths)
+    {
+        if(!exists(*pathOption.first))
+        {
+            const format message = format("\n   *** The '%s' does not exist: %s ***\n") % pathOption.second % *pathOption.first;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+
+    BOOST_FOREACH(const unsigned seedLength, seedLengths)
+    {
+        if (!reference::isSupportedKmerLength(seedLength))
+        {
+            const format message = format("\n   *** The seed-length must be dividible by 4. Got: %d ***\n") % seedLength;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+}
+
+} // namespace options
+} // namespace isaac
@@ -38,6 +38,7 @@ SortReferenceOptions::SortReferenceOptions()
     , maskWidth(6)
     , mask(0)
     , repeatThreshold(1000)
+    , memoryLimit(0)
 {
      namedOptions_.add_options()
         ("reference-genome,r",  bpo::value<std::string>(&contigsXml),
@@ -52,6 +53,11 @@ SortReferenceOptions::SortReferenceOptions()
                                 "k-mers occuring more than --repeat-threshold times in the genome are considered to be repeats. "
                                 "Their positions are not stored. Special value of 0 forces inclusion the position of of every k-mer. "
                                 "Value of 1 results in only the unique k-mer positions stored.")
+        ("memory-limit",        bpo::value<uint64_t>(&memoryLimit)->default_value(memoryLimit),
+                                "Limits the memory used for k-mers to the specified number of gigabytes. The k-mers of the mask "
+                                "are split into partitions that fit and sorted one partition at a time. "
+                                "The limit includes the contigs, the neighbor flags and the sort job queue. "
+                                "Special value of 0 keeps all k-mers of the mask in memory at once.")
         ("output-file,o",       bpo::value<boost::filesystem::path>(&outFile), "Output file path.")
         ("seed-length,s",       bpo::value<unsigned int>(&seedLength)->default_value(seedLength),
                                 "Length of reference k-mer in bases. Lengths of 16,28,30,32,34,36 and 64 are supported.")
@@ -0,0 +1,76 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file StoreContigImageOptions.cpp
+ **
+ ** Command line options for 'storeContigImage'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <string>
+#include <vector>
+#include <boost/assign.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Exceptions.hh"
+#include "options/StoreContigImageOptions.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+namespace bfs = boost::filesystem;
+
+StoreContigImageOptions::StoreContigImageOptions()
+    : jobs(boost::thread::hardware_concurrency())
+{
+    namedOptions_.add_options()
+        ("reference-genome,r",  bpo::value<bfs::path>(&referenceGenome),
+                          "The input xml file listing the contigs to store")
+        ("output-file,o",  bpo::value<bfs::path>(&outputFile),
+                          "The output contig image file path")
+        ("jobs,j", bpo::value<unsigned>(&jobs)->default_value(jobs),
+                          "Maximum number of threads loading the contigs in parallel")
+        ;
+}
+
+void StoreContigImageOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help"))
+    {
+        return;
+    }
+    using isaac::common::InvalidOptionException;
+    using boost::format;
+    const std::vector<std::string> requiredOptions = boost::assign::list_of("reference-genome")("output-file");
+    BOOST_FOREACH(const std::string &required, requiredOptions)
+    {
+        if(!vm.count(required))
+        {
+            const format message = format("\n   *** The '%s' option is required ***\n") % required;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+    if (!exists(referenceGenome))
+    {
+        const format message = format("\n   *** The 'reference-genome' does not exist: %s ***\n") % referenceGenome;
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+}
+
+} // namespace options
+} // namespace isaac
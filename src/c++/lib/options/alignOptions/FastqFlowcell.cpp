@@ -154,7 +154,7 @@ FastqFlowcellInfo FastqFlowcell::parseFastqFlowcellInfo(
 
     if (!laneFilePaths.r1Path_.empty())
     {
-        io::FastqReader reader(false, 1, 0);
+        io::FastqReader reader(false, 1, false, 0);
         reader.open(laneFilePaths.r1Path_, fastqQ0);
         CasavaFastqParser parser(reader);
         ret.readLengths_.first = parser.parseReadLength();
@@ -164,7 +164,7 @@ FastqFlowcellInfo FastqFlowcell::parseFastqFlowcellInfo(
     }
     if (!laneFilePaths.r2Path_.empty())
     {
-        io::FastqReader reader(false, 1, 0);
+        io::FastqReader reader(false, 1, false, 0);
         reader.open(laneFilePaths.r2Path_, fastqQ0);
         CasavaFastqParser parser(reader);
         ret.readLengths_.second = parser.parseReadLength();
@@ -17,11 +17,18 @@
  ** \author Roman Petrovski
  **/
 #include <errno.h>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
 
 #include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "common/Exceptions.hh"
+#include "common/StageCounters.hh"
+#include "common/SystemCompatibility.hh"
 #include "reference/AnnotationLoader.hh"
+#include "reference/ReferenceHash.hh"
 
 namespace isaac
 {
@@ -88,12 +95,221 @@ ContigAnnotations loadAnnotations(const reference::SortedReferenceMetadata &sort
     return ret;
 }
 
+/**
+ * \brief Fixed-size header of the annotation cache file. The (k-uniqueness, k-repeatness) pairs of all contigs
+ *        follow the header in karyotype order.
+ */
+struct AnnotationCacheFileHeader
+{
+    static const unsigned CURRENT_VERSION = 1;
+    char magic_[8];
+    boost::uint32_t version_;
+    boost::uint32_t k_;
+    boost::uint64_t annotationFingerprint_;
+    boost::uint64_t positionsCount_;
+};
+
+static const char ANNOTATION_CACHE_MAGIC[8] = {'i', 'S', 'A', 'A', 'C', 'K', 'U', 'A'};
+
+/**
+ * \brief The uncompressed cache is stored next to the k-uniqueness annotation file
+ */
+static boost::filesystem::path getAnnotationCachePath(const reference::SortedReferenceMetadata &sortedReferenceMetadata)
+{
+    return sortedReferenceMetadata.getKUniquenessAnnotation().path_.string() + ".dat";
+}
+
+/**
+ * \brief Reference fingerprint extended with the annotation files the cache is produced from
+ */
+static boost::uint64_t computeAnnotationFingerprint(const reference::SortedReferenceMetadata &sortedReferenceMetadata)
+{
+    ReferenceFingerprint ret;
+    ret.add(computeReferenceHashFingerprint(sortedReferenceMetadata));
+    boost::system::error_code ec;
+    const SortedReferenceMetadata::AnnotationFile &kUniqueness = sortedReferenceMetadata.getKUniquenessAnnotation();
+    ret.add(kUniqueness.path_.string()).add(kUniqueness.k_).add(boost::filesystem::last_write_time(kUniqueness.path_, ec));
+    const SortedReferenceMetadata::AnnotationFile &kRepeatness = sortedReferenceMetadata.getKRepeatnessAnnotation();
+    ret.add(kRepeatness.path_.string()).add(boost::filesystem::last_write_time(kRepeatness.path_, ec));
+    return ret.get();
+}
+
+static std::size_t getTotalBases(const SortedReferenceMetadata::Contigs &contigs)
+{
+    std::size_t ret = 0;
+    BOOST_FOREACH(const SortedReferenceMetadata::Contig &contig, contigs)
+    {
+        ret += contig.totalBases_;
+    }
+    return ret;
+}
+
+/**
+ * \return false if the cache is missing, produced from different annotation files or truncated
+ */
+static bool isAnnotationCacheValid(
+    const boost::filesystem::path &path,
+    const unsigned k,
+    const boost::uint64_t annotationFingerprint,
+    const std::size_t totalBases)
+{
+    AnnotationCacheFileHeader header;
+    std::ifstream is(path.c_str(), std::ios_base::binary);
+    if (!is || !is.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic_, ANNOTATION_CACHE_MAGIC, sizeof(header.magic_)))
+    {
+        return false;
+    }
+    if (AnnotationCacheFileHeader::CURRENT_VERSION != header.version_ || k != header.k_ ||
+        annotationFingerprint != header.annotationFingerprint_)
+    {
+        ISAAC_THREAD_CERR << "WARNING: Ignoring stale annotation cache " << path << " version:" << header.version_ <<
+            " k:" << header.k_ << " fingerprint:" << header.annotationFingerprint_ << std::endl;
+        return false;
+    }
+    boost::system::error_code ec;
+    const boost::uintmax_t fileSize = boost::filesystem::file_size(path, ec);
+    if (ec || totalBases != header.positionsCount_ ||
+        sizeof(header) + header.positionsCount_ * sizeof(ContigAnnotation::value_type) != fileSize)
+    {
+        ISAAC_THREAD_CERR << "WARNING: Ignoring incomplete annotation cache " << path << " positions:" <<
+            header.positionsCount_ << " size:" << fileSize << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Writes the annotations into a temporary file next to path and renames it into place so that concurrent
+ *        readers never see a partially written cache.
+ */
+static void storeAnnotationCache(
+    const ContigAnnotations &contigAnnotations,
+    const unsigned k,
+    const boost::uint64_t annotationFingerprint,
+    const boost::filesystem::path &path)
+{
+    AnnotationCacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, ANNOTATION_CACHE_MAGIC, sizeof(header.magic_));
+    header.version_ = AnnotationCacheFileHeader::CURRENT_VERSION;
+    header.k_ = k;
+    header.annotationFingerprint_ = annotationFingerprint;
+    BOOST_FOREACH(const ContigAnnotation &contigAnnotation, contigAnnotations)
+    {
+        header.positionsCount_ += contigAnnotation.size();
+    }
+
+    const boost::filesystem::path tmpPath = path.string() + ".tmp" + boost::lexical_cast<std::string>(getpid());
+    ISAAC_THREAD_CERR << "Storing annotation cache " << path << std::endl;
+    {
+        std::ofstream os(tmpPath.c_str(), std::ios_base::binary);
+        bool written = os && os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        BOOST_FOREACH(const ContigAnnotation &contigAnnotation, contigAnnotations)
+        {
+            written = written && os.write(reinterpret_cast<const char*>(contigAnnotation.begin()),
+                                          sizeof(ContigAnnotation::value_type) * contigAnnotation.size());
+        }
+        if (!written || !os.flush())
+        {
+            const int error = errno;
+            boost::system::error_code ec;
+            boost::filesystem::remove(tmpPath, ec);
+            BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to write annotation cache into " + tmpPath.string()));
+        }
+    }
+    if (-1 == rename(tmpPath.c_str(), path.c_str()))
+    {
+        const int error = errno;
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmpPath, ec);
+        BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to rename " + tmpPath.string() + " to " + path.string()));
+    }
+    ISAAC_THREAD_CERR << "Storing annotation cache done " << path << std::endl;
+}
+
+/**
+ * \brief Contig annotations become views into the shared read-only mapping of the cache file
+ */
+static ContigAnnotations mapAnnotationCache(
+    const SortedReferenceMetadata::Contigs &contigs,
+    const unsigned k,
+    const boost::uint64_t annotationFingerprint,
+    const boost::filesystem::path &path)
+{
+    const std::shared_ptr<const common::MemoryMappedFile> mapping =
+        std::make_shared<common::MemoryMappedFile>(path, common::MemoryMappedFile::Random);
+
+    AnnotationCacheFileHeader header;
+    if (mapping->size() < sizeof(header))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Annotation cache file is too short " + path.string()));
+    }
+    memcpy(&header, mapping->data(), sizeof(header));
+    if (memcmp(header.magic_, ANNOTATION_CACHE_MAGIC, sizeof(header.magic_)) ||
+        AnnotationCacheFileHeader::CURRENT_VERSION != header.version_ || k != header.k_ ||
+        annotationFingerprint != header.annotationFingerprint_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Annotation cache file does not match the reference " + path.string()));
+    }
+    if (getTotalBases(contigs) != header.positionsCount_ ||
+        mapping->size() != sizeof(header) + header.positionsCount_ * sizeof(ContigAnnotation::value_type))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Annotation cache file is corrupt " + path.string()));
+    }
+
+    std::vector<std::size_t> contigSizes(contigs.size());
+    BOOST_FOREACH(const SortedReferenceMetadata::Contig &contig, contigs)
+    {
+        contigSizes.at(contig.karyotypeIndex_) = contig.totalBases_;
+    }
+
+    ContigAnnotations ret(contigs.size());
+    const ContigAnnotation::value_type *begin =
+        reinterpret_cast<const ContigAnnotation::value_type *>(mapping->data() + sizeof(header));
+    for (std::size_t karyotypeIndex = 0; contigSizes.size() != karyotypeIndex; ++karyotypeIndex)
+    {
+        ret.at(karyotypeIndex) = ContigAnnotation(mapping, begin, begin + contigSizes[karyotypeIndex]);
+        begin += contigSizes[karyotypeIndex];
+    }
+    return ret;
+}
+
+/**
+ * \brief Produces the cache file from the annotation files unless a valid one exists, then maps it. If the cache
+ *        cannot be stored, the annotations stay in the private memory of the process.
+ */
+static ContigAnnotations loadCachedAnnotations(const reference::SortedReferenceMetadata &sortedReferenceMetadata)
+{
+    const boost::filesystem::path cachePath = getAnnotationCachePath(sortedReferenceMetadata);
+    const unsigned k = sortedReferenceMetadata.getKUniquenessAnnotation().k_;
+    const boost::uint64_t annotationFingerprint = computeAnnotationFingerprint(sortedReferenceMetadata);
+    if (!isAnnotationCacheValid(cachePath, k, annotationFingerprint, getTotalBases(sortedReferenceMetadata.getContigs())))
+    {
+        ContigAnnotations ret = loadAnnotations(sortedReferenceMetadata);
+        try
+        {
+            storeAnnotationCache(ret, k, annotationFingerprint, cachePath);
+        }
+        catch (common::IoException &e)
+        {
+            ISAAC_THREAD_CERR << "WARNING: Annotation will not be shared between processes. " << e.what() << std::endl;
+            return ret;
+        }
+    }
+    ISAAC_THREAD_CERR << "Mapping annotation cache " << cachePath << std::endl;
+    return mapAnnotationCache(sortedReferenceMetadata.getKaryotypeOrderedContigs(), k, annotationFingerprint, cachePath);
+}
+
 /**
  * \brief load contig annotations for each reference in the list
  */
-ContigAnnotationsList loadAnnotations(const reference::SortedReferenceMetadataList &sortedReferenceMetadataList)
+ContigAnnotationsList loadAnnotations(
+    const reference::SortedReferenceMetadataList &sortedReferenceMetadataList,
+    const bool annotationCache)
 {
     ISAAC_TRACE_STAT("loadAnnotations ");
+    const boost::uint64_t start = common::StageCounters::now();
 
     ContigAnnotationsList ret(sortedReferenceMetadataList.size());
     std::size_t referenceIndex = 0;
@@ -101,7 +317,7 @@ ContigAnnotationsList loadAnnotations(const reference::SortedReferenceMetadataLi
     {
         if (ref.hasKUniquenessAnnotation())
         {
-            ret.at(referenceIndex) = reference::loadAnnotations(ref);
+            ret.at(referenceIndex) = annotationCache ? loadCachedAnnotations(ref) : reference::loadAnnotations(ref);
         }
         else
         {
@@ -112,6 +328,8 @@ ContigAnnotationsList loadAnnotations(const reference::SortedReferenceMetadataLi
     }
 
     ISAAC_TRACE_STAT("loadAnnotations done ");
+    ISAAC_THREAD_CERR << "Loading annotations done in " << (common::StageCounters::now() - start) / 1000000 <<
+        "ms RSS: " << common::getResidentSetBytes() / 1024 / 1024 << "MB" << std::endl;
 
     return ret;
 }
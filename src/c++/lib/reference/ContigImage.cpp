@@ -0,0 +1,291 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ContigImage.cpp
+ **
+ ** \brief see ContigImage.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "common/Exceptions.hh"
+#include "reference/ContigImage.hh"
+#include "reference/ReferenceHash.hh"
+
+namespace isaac
+{
+namespace reference
+{
+
+static const char CONTIG_IMAGE_MAGIC[8] = {'i', 'S', 'A', 'A', 'C', 'C', 'I', 'F'};
+
+static uint64_t getContigBasesBytes(const uint64_t totalBases)
+{
+    return (totalBases + packedContig::BASES_PER_WORD - 1) / packedContig::BASES_PER_WORD * sizeof(packedContig::Word);
+}
+
+static uint64_t getContigNFlagsBytes(const uint64_t totalBases)
+{
+    return (totalBases + packedContig::N_FLAGS_PER_WORD - 1) / packedContig::N_FLAGS_PER_WORD * sizeof(packedContig::Word);
+}
+
+static boost::uint32_t contigCrc32(boost::uint32_t crc, const void *data, const std::size_t size)
+{
+    // crc32 takes uInt length
+    static const std::size_t CRC_BLOCK = 1024 * 1024 * 1024;
+    const Bytef *bytes = reinterpret_cast<const Bytef*>(data);
+    for (std::size_t offset = 0; size != offset; offset += std::min(size - offset, CRC_BLOCK))
+    {
+        crc = crc32(crc, bytes + offset, std::min(size - offset, CRC_BLOCK));
+    }
+    return crc;
+}
+
+/**
+ * \brief checksum of the packed bases followed by the N mask
+ */
+static boost::uint32_t contigCrc32(const Contig &contig)
+{
+    const boost::uint32_t ret = contigCrc32(crc32(0L, Z_NULL, 0), contig.basesData(), getContigBasesBytes(contig.size()));
+    return contigCrc32(ret, contig.nFlagsData(), getContigNFlagsBytes(contig.size()));
+}
+
+/**
+ * \brief image bytes of the contig of totalBases: packed bases followed by the N mask
+ */
+static uint64_t getContigImageBytes(const uint64_t totalBases)
+{
+    return getContigBasesBytes(totalBases) + getContigNFlagsBytes(totalBases);
+}
+
+void storeContigImage(
+    const SortedReferenceMetadata &sortedReferenceMetadata,
+    const ContigList &contigs,
+    const boost::filesystem::path &path)
+{
+    const SortedReferenceMetadata::Contigs &xmlContigs = sortedReferenceMetadata.getContigs();
+    ISAAC_ASSERT_MSG(xmlContigs.size() == contigs.size(), "Contig list does not match the reference metadata");
+
+    ContigImageFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, CONTIG_IMAGE_MAGIC, sizeof(header.magic_));
+    header.version_ = ContigImageFileHeader::CURRENT_VERSION;
+    header.referenceFingerprint_ = computeReferenceHashFingerprint(sortedReferenceMetadata);
+    header.contigsCount_ = contigs.size();
+
+    // contigs are in karyotype order, so are the entries and the bases in the image
+    std::vector<ContigImageEntry> entries(contigs.size());
+    BOOST_FOREACH(const SortedReferenceMetadata::Contig &xmlContig, xmlContigs)
+    {
+        const Contig &contig = contigs.at(xmlContig.karyotypeIndex_);
+        ISAAC_ASSERT_MSG(xmlContig.index_ == contig.index_, "Contig order mismatch " << xmlContig << " " << contig.index_);
+        ISAAC_ASSERT_MSG(xmlContig.totalBases_ == contig.size(), "Contig size mismatch " << xmlContig << " " << contig);
+        ContigImageEntry &entry = entries.at(xmlContig.karyotypeIndex_);
+        memset(&entry, 0, sizeof(entry));
+        entry.totalBases_ = xmlContig.totalBases_;
+        entry.acgtBases_ = xmlContig.acgtBases_;
+        entry.crc32_ = contigCrc32(contig);
+    }
+
+    std::size_t imageOffset = sizeof(header) + sizeof(ContigImageEntry) * entries.size();
+    BOOST_FOREACH(ContigImageEntry &entry, entries)
+    {
+        entry.imageOffset_ = imageOffset;
+        imageOffset += getContigImageBytes(entry.totalBases_);
+    }
+
+    // readers must never see a partially written image
+    const boost::filesystem::path tmpPath = path.string() + ".tmp" + boost::lexical_cast<std::string>(getpid());
+    ISAAC_THREAD_CERR << "Storing contig image " << path << std::endl;
+    {
+        std::ofstream os(tmpPath.c_str(), std::ios_base::binary);
+        bool written = os &&
+            os.write(reinterpret_cast<const char*>(&header), sizeof(header)) &&
+            os.write(reinterpret_cast<const char*>(&entries.front()), sizeof(ContigImageEntry) * entries.size());
+        BOOST_FOREACH(const Contig &contig, contigs)
+        {
+            written = written && (contig.empty() ||
+                (os.write(reinterpret_cast<const char*>(contig.basesData()), getContigBasesBytes(contig.size())) &&
+                 os.write(reinterpret_cast<const char*>(contig.nFlagsData()), getContigNFlagsBytes(contig.size()))));
+        }
+        if (!written || !os.flush())
+        {
+            const int error = errno;
+            boost::system::error_code ec;
+            boost::filesystem::remove(tmpPath, ec);
+            BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to write contig image into " + tmpPath.string()));
+        }
+    }
+    if (-1 == rename(tmpPath.c_str(), path.c_str()))
+    {
+        const int error = errno;
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmpPath, ec);
+        BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to rename " + tmpPath.string() + " to " + path.string()));
+    }
+    ISAAC_THREAD_CERR << "Storing contig image done " << path << " " << imageOffset << " bytes" << std::endl;
+}
+
+ContigImage::ContigImage(const boost::filesystem::path &path, const boost::uint64_t referenceFingerprint)
+    : path_(path)
+    , fd_(::open(path.c_str(), O_RDONLY))
+{
+    if (-1 == fd_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open contig image " + path_.string()));
+    }
+
+    ContigImageFileHeader header;
+    if (sizeof(header) != pread(fd_, &header, sizeof(header), 0) ||
+        memcmp(header.magic_, CONTIG_IMAGE_MAGIC, sizeof(header.magic_)) ||
+        ContigImageFileHeader::CURRENT_VERSION != header.version_ ||
+        referenceFingerprint != header.referenceFingerprint_)
+    {
+        close(fd_);
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Contig image does not match the reference " + path_.string()));
+    }
+
+    struct stat fileStat;
+    if (-1 == fstat(fd_, &fileStat))
+    {
+        close(fd_);
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to get the size of contig image " + path_.string()));
+    }
+    const uint64_t fileSize = fileStat.st_size;
+    if ((fileSize - sizeof(header)) / sizeof(ContigImageEntry) < header.contigsCount_)
+    {
+        close(fd_);
+        const boost::format message = boost::format("Contig image %s of %d bytes is too short for %d contigs") %
+            path_.string() % fileSize % header.contigsCount_;
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, message.str()));
+    }
+
+    entries_.resize(header.contigsCount_);
+    const std::size_t entriesBytes = sizeof(ContigImageEntry) * entries_.size();
+    if (ssize_t(entriesBytes) != pread(fd_, &entries_.front(), entriesBytes, sizeof(header)))
+    {
+        close(fd_);
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to read contig table from " + path_.string()));
+    }
+
+    // bases of the contigs follow the table back to back up to the end of the file. Anything else means the image
+    // is truncated or the table is damaged.
+    uint64_t imageSize = sizeof(header) + entriesBytes;
+    BOOST_FOREACH(const ContigImageEntry &entry, entries_)
+    {
+        if (imageSize != entry.imageOffset_)
+        {
+            close(fd_);
+            const boost::format message = boost::format("Unexpected contig offset %d instead of %d in contig image %s") %
+                entry.imageOffset_ % imageSize % path_.string();
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, message.str()));
+        }
+        imageSize += getContigImageBytes(entry.totalBases_);
+    }
+    if (imageSize != fileSize)
+    {
+        close(fd_);
+        const boost::format message = boost::format("Contig image %s size %d does not match its contig table: %d bytes") %
+            path_.string() % fileSize % imageSize;
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, message.str()));
+    }
+}
+
+ContigImage::~ContigImage()
+{
+    close(fd_);
+}
+
+std::unique_ptr<ContigImage> ContigImage::open(const SortedReferenceMetadata &sortedReferenceMetadata)
+{
+    std::unique_ptr<ContigImage> ret;
+    if (sortedReferenceMetadata.hasContigImage())
+    {
+        const boost::filesystem::path &path = sortedReferenceMetadata.getContigImage().path_;
+        try
+        {
+            ret.reset(new ContigImage(path, computeReferenceHashFingerprint(sortedReferenceMetadata)));
+        }
+        catch (common::IoException &e)
+        {
+            ISAAC_THREAD_CERR << "WARNING: Ignoring contig image " << path << ". Contigs will be loaded from fasta. " <<
+                e.what() << std::endl;
+        }
+    }
+    return ret;
+}
+
+bool ContigImage::readContigWords(
+    char *data, const std::size_t size, const uint64_t imageOffset,
+    const SortedReferenceMetadata::Contig &xmlContig) const
+{
+    std::size_t done = 0;
+    while (size != done)
+    {
+        const ssize_t bytes = pread(fd_, data + done, size - done, imageOffset + done);
+        if (0 >= bytes)
+        {
+            ISAAC_THREAD_CERR << "WARNING: Failed to read " << size << " bytes of contig " << xmlContig <<
+                " from " << path_ << " at offset " << imageOffset + done << ": " <<
+                (bytes ? strerror(errno) : "end of file") << std::endl;
+            return false;
+        }
+        done += bytes;
+    }
+    return true;
+}
+
+bool ContigImage::load(const SortedReferenceMetadata::Contig &xmlContig, Contig &contig) const
+{
+    const ContigImageEntry &entry = entries_.at(xmlContig.karyotypeIndex_);
+    if (xmlContig.totalBases_ != entry.totalBases_ || xmlContig.acgtBases_ != entry.acgtBases_)
+    {
+        ISAAC_THREAD_CERR << "WARNING: Contig " << xmlContig << " does not match the entry in contig image " <<
+            path_ << ": " << entry.totalBases_ << " bases" << std::endl;
+        return false;
+    }
+
+    contig.clear();
+    contig.resize(entry.totalBases_);
+    if (!readContigWords(reinterpret_cast<char*>(contig.basesData()), getContigBasesBytes(entry.totalBases_),
+                         entry.imageOffset_, xmlContig) ||
+        !readContigWords(reinterpret_cast<char*>(contig.nFlagsData()), getContigNFlagsBytes(entry.totalBases_),
+                         entry.imageOffset_ + getContigBasesBytes(entry.totalBases_), xmlContig))
+    {
+        return false;
+    }
+
+    if (entry.crc32_ != contigCrc32(contig))
+    {
+        ISAAC_THREAD_CERR << "WARNING: Checksum mismatch for contig " << xmlContig << " in contig image " <<
+            path_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace reference
+} // namespace isaac
@@ -45,18 +45,26 @@ void loadContig(
     }
 //        ISAAC_THREAD_CERR << (boost::format("Contig seek %s (%3d:%8d): %s") % xmlContig.name_ % xmlContig.index_ % xmlContig.totalBases_ % xmlContig.filePath_).str() << std::endl;
     static const oligo::Translator<true> translator;
-    char base = 0;
     std::size_t acgtBases = 0;
-    while(is && (contig.size() < xmlContig.totalBases_) && is.get(base))
+    // read in blocks instead of one character at a time. The stream buffer does not help much with that.
+    static const std::size_t READ_BLOCK_SIZE = 1024 * 64;
+    std::vector<char> block(READ_BLOCK_SIZE);
+    while(is && (contig.size() < xmlContig.totalBases_))
     {
-        if ('\r' != base && '\n' != base)
+        is.read(&block.front(), block.size());
+        BOOST_FOREACH(const char base, std::make_pair(block.begin(), block.begin() + is.gcount()))
         {
-            ISAAC_ASSERT_MSG(std::isalpha(base), "Invalid base read from " << xmlContig << " : " << base);
+            if ('\r' != base && '\n' != base && contig.size() < xmlContig.totalBases_)
             {
+                ISAAC_ASSERT_MSG(std::isalpha(base), "Invalid base read from " << xmlContig << " : " << base);
                 contig.push_back(oligo::getBase(translator[base], true));
                 acgtBases += oligo::REFERENCE_OLIGO_N != contig.back();
             }
         }
+        if (!is.gcount())
+        {
+            break;
+        }
     }
     if (xmlContig.totalBases_ != contig.size())
     {
@@ -17,8 +17,14 @@
  ** \author Roman Petrovski
  **/
 
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
 #include <boost/assert.hpp>
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "common/Exceptions.hh"
 #include "common/Numa.hh"
@@ -276,11 +282,232 @@ void ReferenceHasher<ReferenceHashT>::generate(ReferenceHashT &ret)
 
     ISAAC_THREAD_CERR << " sorted " << ret.offsets_.back() << " positions" << std::endl;
 }
+static const char REFERENCE_HASH_MAGIC[8] = {'i', 'S', 'A', 'A', 'C', 'R', 'H', 'F'};
+
+ReferenceFingerprint &ReferenceFingerprint::add(const boost::uint64_t value)
+{
+    // fixed little-endian byte order regardless of the host
+    char bytes[sizeof(value)];
+    for (std::size_t i = 0; i < sizeof(value); ++i)
+    {
+        bytes[i] = char(value >> (i * 8));
+    }
+    md5_.update(bytes, sizeof(bytes));
+    return *this;
+}
+
+ReferenceFingerprint &ReferenceFingerprint::add(const std::string &value)
+{
+    // length first so that adjacent strings can't be shifted into one another
+    add(value.size());
+    md5_.update(value.data(), value.size());
+    return *this;
+}
+
+boost::uint64_t ReferenceFingerprint::get() const
+{
+    const common::MD5Sum::Digest digest = md5_.getDigest();
+    boost::uint64_t ret = 0;
+    for (std::size_t i = 0; i < sizeof(ret); ++i)
+    {
+        ret |= boost::uint64_t(digest.data[i]) << (i * 8);
+    }
+    return ret;
+}
+
+boost::uint64_t computeReferenceHashFingerprint(const SortedReferenceMetadata &sortedReferenceMetadata)
+{
+    ReferenceFingerprint ret;
+    BOOST_FOREACH(const SortedReferenceMetadata::Contig &contig, sortedReferenceMetadata.getContigs())
+    {
+        boost::system::error_code ec;
+        ret.add(contig.index_).add(contig.karyotypeIndex_).add(contig.name_).add(contig.filePath_.string())
+            .add(contig.offset_).add(contig.totalBases_).add(contig.acgtBases_).add(contig.bamM5_)
+            .add(boost::filesystem::last_write_time(contig.filePath_, ec));
+    }
+    return ret.get();
+}
+
+static bool readReferenceHashHeader(const boost::filesystem::path &path, ReferenceHashFileHeader &header)
+{
+    std::ifstream is(path.c_str(), std::ios_base::binary);
+    return is && is.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        !memcmp(header.magic_, REFERENCE_HASH_MAGIC, sizeof(header.magic_));
+}
+
+bool isReferenceHashFileValid(
+    const boost::filesystem::path &path,
+    const unsigned kmerBases,
+    const boost::uint64_t referenceFingerprint)
+{
+    ReferenceHashFileHeader header;
+    if (!readReferenceHashHeader(path, header))
+    {
+        return false;
+    }
+    if (ReferenceHashFileHeader::CURRENT_VERSION != header.version_ || kmerBases != header.kmerBases_ ||
+        referenceFingerprint != header.referenceFingerprint_)
+    {
+        ISAAC_THREAD_CERR << "WARNING: Ignoring stale reference hash " << path << " version:" << header.version_ <<
+            " kmer:" << header.kmerBases_ << " fingerprint:" << header.referenceFingerprint_ << std::endl;
+        return false;
+    }
+
+    // a truncated or partially written file gets rebuilt rather than failing the mapping
+    boost::system::error_code ec;
+    const boost::uintmax_t fileSize = boost::filesystem::file_size(path, ec);
+    if (ec || (1UL << (kmerBases * oligo::BITS_PER_BASE)) != header.offsetsCount_ ||
+        fileSize != sizeof(header) + header.offsetsCount_ * sizeof(boost::uint32_t) +
+            header.positionsCount_ * sizeof(ReferencePosition))
+    {
+        ISAAC_THREAD_CERR << "WARNING: Ignoring corrupt reference hash " << path << " size:" << fileSize <<
+            " offsets:" << header.offsetsCount_ << " positions:" << header.positionsCount_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename ReferenceHashT>
+void storeReferenceHash(
+    const ReferenceHashT &referenceHash,
+    const boost::uint64_t referenceFingerprint,
+    const boost::filesystem::path &path)
+{
+    ReferenceHashFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, REFERENCE_HASH_MAGIC, sizeof(header.magic_));
+    header.version_ = ReferenceHashFileHeader::CURRENT_VERSION;
+    header.kmerBases_ = oligo::KmerTraits<typename ReferenceHashT::KmerT>::KMER_BASES;
+    header.referenceFingerprint_ = referenceFingerprint;
+    header.offsetsCount_ = referenceHash.offsetsCount();
+    header.positionsCount_ = referenceHash.positionsCount();
+
+    const boost::filesystem::path tmpPath = path.string() + ".tmp" + boost::lexical_cast<std::string>(getpid());
+    ISAAC_THREAD_CERR << "Storing reference hash " << path << std::endl;
+    {
+        std::ofstream os(tmpPath.c_str(), std::ios_base::binary);
+        if (!os ||
+            !os.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+            !os.write(reinterpret_cast<const char*>(referenceHash.offsetsData()),
+                      sizeof(*referenceHash.offsetsData()) * header.offsetsCount_) ||
+            !os.write(reinterpret_cast<const char*>(referenceHash.positionsData()),
+                      sizeof(*referenceHash.positionsData()) * header.positionsCount_) ||
+            !os.flush())
+        {
+            const int error = errno;
+            boost::system::error_code ec;
+            boost::filesystem::remove(tmpPath, ec);
+            BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to write reference hash into " + tmpPath.string()));
+        }
+    }
+    boost::filesystem::rename(tmpPath, path);
+    ISAAC_THREAD_CERR << "Storing reference hash done " << path << std::endl;
+}
+
+template <typename KmerT>
+MappedReferenceHash<KmerT>::MappedReferenceHash(
+    const boost::filesystem::path &path,
+    const boost::uint64_t referenceFingerprint)
+    : file_(path, common::MemoryMappedFile::Random)
+    , offsets_(0)
+    , offsetsCount_(0)
+    , positions_(0)
+    , positionsCount_(0)
+{
+    ReferenceHashFileHeader header;
+    if (file_.size() < sizeof(header))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Reference hash file is too short " + path.string()));
+    }
+    memcpy(&header, file_.data(), sizeof(header));
+    if (memcmp(header.magic_, REFERENCE_HASH_MAGIC, sizeof(header.magic_)) ||
+        ReferenceHashFileHeader::CURRENT_VERSION != header.version_ ||
+        oligo::KmerTraits<KmerT>::KMER_BASES != header.kmerBases_ ||
+        referenceFingerprint != header.referenceFingerprint_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Reference hash file does not match the reference " + path.string()));
+    }
+
+    offsetsCount_ = header.offsetsCount_;
+    positionsCount_ = header.positionsCount_;
+    if (file_.size() != sizeof(header) +
+        offsetsCount_ * sizeof(*offsets_) + positionsCount_ * sizeof(*positions_) ||
+        (1UL << oligo::KmerTraits<KmerT>::KMER_BITS) != offsetsCount_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Reference hash file is corrupt " + path.string()));
+    }
+
+    offsets_ = reinterpret_cast<const boost::uint32_t *>(file_.data() + sizeof(header));
+    positions_ = reinterpret_cast<const reference::ReferencePosition *>(offsets_ + offsetsCount_);
+}
+
+template <typename KmerT>
+MappedReferenceHash<KmerT>::MappedReferenceHash(MappedReferenceHash &&that)
+    : file_(std::move(that.file_))
+    , offsets_(that.offsets_)
+    , offsetsCount_(that.offsetsCount_)
+    , positions_(that.positions_)
+    , positionsCount_(that.positionsCount_)
+{
+}
+
+template <typename ReferenceHashT>
+NumaReferenceHash<ReferenceHashT> loadReferenceHash(
+    const boost::filesystem::path &path,
+    const SortedReferenceMetadata &sortedReferenceMetadata,
+    const ContigList &contigList,
+    common::ThreadVector &threads,
+    const unsigned threadsMax,
+    const bool replicate)
+{
+    typedef typename ReferenceHashT::KmerT KmerT;
+    const boost::uint64_t fingerprint = computeReferenceHashFingerprint(sortedReferenceMetadata);
+
+    if (!isReferenceHashFileValid(path, oligo::KmerTraits<KmerT>::KMER_BASES, fingerprint))
+    {
+        ReferenceHasher<ReferenceHashT> hasher(sortedReferenceMetadata, contigList, threads, threadsMax);
+        ReferenceHashT referenceHash = hasher.generate();
+        try
+        {
+            storeReferenceHash(referenceHash, fingerprint, path);
+        }
+        catch (const std::exception &e)
+        {
+            ISAAC_THREAD_CERR << "WARNING: Unable to store reference hash " << path << ": " << e.what() << std::endl;
+            return NumaReferenceHash<ReferenceHashT>(std::move(referenceHash));
+        }
+    }
+
+    return NumaReferenceHash<ReferenceHashT>(MappedReferenceHash<KmerT>(path, fingerprint), replicate);
+}
+
+template class MappedReferenceHash<oligo::ShortKmerType>;
+template NumaReferenceHash<ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0, true> > >
+loadReferenceHash<ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0, true> > >(
+    const boost::filesystem::path &path,
+    const SortedReferenceMetadata &sortedReferenceMetadata,
+    const ContigList &contigList,
+    common::ThreadVector &threads,
+    const unsigned threadsMax,
+    const bool replicate);
+
+// cppunit
+template class MappedReferenceHash<oligo::VeryShortKmerType>;
+template NumaReferenceHash<ReferenceHash<oligo::VeryShortKmerType, common::NumaAllocator<void, 0, true> > >
+loadReferenceHash<ReferenceHash<oligo::VeryShortKmerType, common::NumaAllocator<void, 0, true> > >(
+    const boost::filesystem::path &path,
+    const SortedReferenceMetadata &sortedReferenceMetadata,
+    const ContigList &contigList,
+    common::ThreadVector &threads,
+    const unsigned threadsMax,
+    const bool replicate);
+template class ReferenceHasher<ReferenceHash<oligo::VeryShortKmerType, common::NumaAllocator<void, 0, true> > >;
+
 //
 template class ReferenceHasher<ReferenceHash<oligo::VeryShortKmerType> >;
 //template class ReferenceHasher<oligo::BasicKmerType<12> >;
 ////template class ReferenceHasher<oligo::BasicKmerType<14> >;
-template class ReferenceHasher<ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0> > >;
+template class ReferenceHasher<ReferenceHash<oligo::ShortKmerType, common::NumaAllocator<void, 0, true> > >;
 template class ReferenceHasher<ReferenceHash<oligo::ShortKmerType> >;
 ////template class ReferenceHasher<oligo::BasicKmerType<18> >;
 //template class ReferenceHasher<oligo::BasicKmerType<20> >;
@@ -20,6 +20,7 @@
 #include <boost/assert.hpp>
 #include <boost/foreach.hpp>
 #include <boost/io/ios_state.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "common/Exceptions.hh"
 #include "common/ParallelSort.hpp"
@@ -46,9 +47,11 @@ ReferenceSorter<KmerT>::ReferenceSorter (
     const boost::filesystem::path &contigsXmlPath,
     const boost::filesystem::path &genomeNeighborsFile,
     const boost::filesystem::path &outputFile,
-    const unsigned repeatThreshold
+    const unsigned repeatThreshold,
+    const uint64_t memoryLimit
     )
     : repeatThreshold_(repeatThreshold)
+    , memoryLimit_(memoryLimit)
     , maskWidth_(maskWidth)
     , mask_(mask)
     , msbMask_(~((~(KmerT(0)) >> maskWidth)))
@@ -69,6 +72,7 @@ ReferenceSorter<KmerT>::ReferenceSorter (
             " maskBits_: " << maskBits_ <<
             " genomeFile_: " << contigsXmlPath_ <<
             " outputFile_: " << outputFile_ <<
+            " memoryLimit_: " << memoryLimit_ <<
             std::endl;
 
     BOOST_ASSERT(mask_ < isaac::oligo::getMaskCount(maskWidth_) && "Mask value cannot exceed the allowed bit width");
@@ -78,14 +82,112 @@ ReferenceSorter<KmerT>::ReferenceSorter (
 template <typename KmerT>
 void ReferenceSorter<KmerT>::run()
 {
-    const std::vector<uint64_t> contigOffsets(computeContigOffsets(sortedReferenceMetadata_.getContigs()));
-
     const uint64_t genomeLength = reference::genomeLength(sortedReferenceMetadata_.getContigs());
+
+    std::vector<bool> neighbors;
+    if (!genomeNeighborsFile_.empty())
     {
-        loadReference();
-        ISAAC_THREAD_CERR << "Loaded genome from " << contigsXmlPath_ << " found " << genomeLength << " bases" << std::endl;
+        io::BitsetLoader loader(genomeNeighborsFile_);
+        const uint64_t neighborsCount = loader.load(genomeLength, neighbors);
+        ISAAC_THREAD_CERR << "Scanning " << genomeNeighborsFile_ << " found " << neighborsCount << " neighbors among " << genomeLength << " bases" << std::endl;
     }
 
+    std::ofstream os(outputFile_.c_str());
+    if (!os)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno,"Failed to create file " + outputFile_.string()));
+    }
+
+    uint64_t kmersSaved = 0;
+    sortPartition(maskWidth_, mask_, getKmerMemoryLimit(neighbors), neighbors, os, kmersSaved);
+
+    os.flush();
+    if (!os)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno,"Failed to flush " + outputFile_.string()));
+    }
+    os.close();
+
+    SortedReferenceMetadata sortedReference;
+    sortedReference.addMaskFile(oligo::KmerTraits<KmerT>::KMER_BASES, maskWidth_, mask_, outputFile_, kmersSaved);
+    saveSortedReferenceXml(std::cout, sortedReference);
+}
+
+/**
+ * \brief Part of memoryLimit_ left for the k-mers of a partition. The contigs and the neighbor flags stay loaded for
+ *        the whole run and the sort job queue is allocated on top of the k-mers.
+ *
+ * \return 0 when memoryLimit_ is 0.
+ */
+template <typename KmerT>
+uint64_t ReferenceSorter<KmerT>::getKmerMemoryLimit(const std::vector<bool> &neighbors) const
+{
+    if (!memoryLimit_)
+    {
+        return 0;
+    }
+
+    uint64_t fixedMemory = neighbors.capacity() / 8 +
+        common::ParallelSorter<typename std::vector<ReferenceKmer<KmerT> >::iterator,
+                               bool(*)(const ReferenceKmer<KmerT>&, const ReferenceKmer<KmerT>&)>::getMemoryRequirements(threads_.size());
+    BOOST_FOREACH(const reference::Contig &contig, contigList_)
+    {
+        fixedMemory += contig.getPackedBytes();
+    }
+
+    if (memoryLimit_ <= fixedMemory)
+    {
+        BOOST_THROW_EXCEPTION(common::MemoryException(
+            "Memory limit of " + boost::lexical_cast<std::string>(memoryLimit_) + " bytes does not leave room for k-mers after " +
+            boost::lexical_cast<std::string>(fixedMemory) + " bytes of contigs, neighbor flags and sort jobs"));
+    }
+
+    ISAAC_THREAD_CERR << "Using " << memoryLimit_ - fixedMemory << " bytes for k-mers, " <<
+        fixedMemory << " bytes taken by contigs, neighbor flags and sort jobs" << std::endl;
+    return memoryLimit_ - fixedMemory;
+}
+
+/**
+ * \brief When the k-mers of the partition don't fit in kmerMemoryLimit, the partition is split in two on the next
+ *        k-mer bit. Otherwise the partition is generated, sorted, annotated and appended to the output. Partitions
+ *        are visited in the k-mer order, so the output is sorted without having to merge anything.
+ */
+template <typename KmerT>
+void ReferenceSorter<KmerT>::sortPartition(
+    const unsigned partitionMaskWidth,
+    const unsigned partitionMask,
+    const uint64_t kmerMemoryLimit,
+    const std::vector<bool> &neighbors,
+    std::ostream &os,
+    uint64_t &kmersSaved)
+{
+    static const unsigned PARTITION_MASK_WIDTH_MAX =
+        std::min<unsigned>(oligo::KmerTraits<KmerT>::KMER_BITS, sizeof(partitionMask) * 8);
+    if (kmerMemoryLimit)
+    {
+        const std::size_t kmers = repeatThreshold_ ?
+            countKmers<permutatedKmerGenerator::Min>(partitionMaskWidth, partitionMask) :
+            countKmers<permutatedKmerGenerator::ForwardOnly>(partitionMaskWidth, partitionMask);
+        if (kmerMemoryLimit < kmers * sizeof(ReferenceKmer<KmerT>))
+        {
+            if (PARTITION_MASK_WIDTH_MAX == partitionMaskWidth)
+            {
+                BOOST_THROW_EXCEPTION(common::MemoryException(
+                    "Partition " + boost::lexical_cast<std::string>(partitionMask) + " of " +
+                    boost::lexical_cast<std::string>(partitionMaskWidth) + " bits cannot be split further and its " +
+                    boost::lexical_cast<std::string>(kmers) + " k-mers don't fit in " +
+                    boost::lexical_cast<std::string>(kmerMemoryLimit) + " bytes"));
+            }
+            ISAAC_THREAD_CERR << "Splitting partition " << partitionMask << " of " << partitionMaskWidth << " bits: " <<
+                kmers << " k-mers don't fit in " << kmerMemoryLimit << " bytes" << std::endl;
+            sortPartition(partitionMaskWidth + 1, partitionMask << 1, kmerMemoryLimit, neighbors, os, kmersSaved);
+            sortPartition(partitionMaskWidth + 1, (partitionMask << 1) | 1, kmerMemoryLimit, neighbors, os, kmersSaved);
+            return;
+        }
+    }
+
+    loadReference(partitionMaskWidth, partitionMask);
+
     sortReference();
 
     markRepeats();
@@ -93,25 +195,40 @@ void ReferenceSorter<KmerT>::run()
     // remove marked repeats and reverse complements
     reference_.erase(std::remove_if(reference_.begin(), reference_.end(), boost::bind(&ReferenceKmer<KmerT>::hasNeighbors, _1)), reference_.end());
 
-    std::vector<bool> neighbors;
-    if (!genomeNeighborsFile_.empty())
+    markNeighbors(neighbors);
+
+    saveReference(os);
+    kmersSaved += reference_.size();
+}
+
+template <typename KmerT>
+void ReferenceSorter<KmerT>::markNeighbors(const std::vector<bool> &neighbors)
+{
+    if (neighbors.empty())
     {
-        io::BitsetLoader loader(genomeNeighborsFile_);
-        const uint64_t neighborsCount = loader.load(genomeLength, neighbors);
-        ISAAC_THREAD_CERR << "Scanning " << genomeNeighborsFile_ << " found " << neighborsCount << " neighbors among " << genomeLength << " bases" << std::endl;
+        return;
+    }
 
-        BOOST_FOREACH(ReferenceKmer<KmerT> &referenceKmer, reference_)
+    const std::vector<uint64_t> contigOffsets(computeContigOffsets(sortedReferenceMetadata_.getContigs()));
+    BOOST_FOREACH(ReferenceKmer<KmerT> &referenceKmer, reference_)
+    {
+        const bool kmerHasNeighbors = referenceKmer.isTooManyMatch() ? false :
+            neighbors.at(contigOffsets.at(referenceKmer.getReferencePosition().getContigId()) +
+                         referenceKmer.getReferencePosition().getPosition());
+        if (kmerHasNeighbors)
         {
-            const bool kmerHasNeighbors = referenceKmer.isTooManyMatch() ? false :
-                neighbors.at(contigOffsets.at(referenceKmer.getReferencePosition().getContigId()) +
-                             referenceKmer.getReferencePosition().getPosition());
-            if (kmerHasNeighbors)
-            {
-                referenceKmer.setNeighbors(true);
-            }
+            referenceKmer.setNeighbors(true);
         }
     }
-    saveReference();
+}
+
+template <typename KmerT>
+template <permutatedKmerGenerator::Mode mode>
+std::size_t ReferenceSorter<KmerT>::countKmers(const unsigned partitionMaskWidth, const unsigned partitionMask)
+{
+    const PermutatedKmerListGenerator<KmerT, mode>
+        generator(partitionMaskWidth, partitionMask, contigList_, sortedReferenceMetadata_.getContigs());
+    return generator.count(oligo::Permutate(oligo::KmerTraits<KmerT>::KMER_BASES), threads_);
 }
 
 template <typename KmerT>
@@ -122,7 +239,7 @@ ReferenceKmer<KmerT> construct(
 }
 
 template <typename KmerT>
-void ReferenceSorter<KmerT>::loadReference()
+void ReferenceSorter<KmerT>::loadReference(const unsigned partitionMaskWidth, const unsigned partitionMask)
 {
     ISAAC_THREAD_CERR << "Loading " << oligo::KmerTraits<KmerT>::KMER_BASES << "-mers" << std::endl;
 
@@ -130,14 +247,14 @@ void ReferenceSorter<KmerT>::loadReference()
     if (!repeatThreshold_)
     {
         const PermutatedKmerListGenerator<KmerT, permutatedKmerGenerator::ForwardOnly>
-            neighborPositionGenerator(maskWidth_, mask_, contigList_, sortedReferenceMetadata_.getContigs());
+            neighborPositionGenerator(partitionMaskWidth, partitionMask, contigList_, sortedReferenceMetadata_.getContigs());
         neighborPositionGenerator.generate(oligo::Permutate(oligo::KmerTraits<KmerT>::KMER_BASES), KmerT(0), reference_,
                                            boost::bind(&construct<KmerT>, _1, _2, _3, _4), threads_);
     }
     else
     {
         const PermutatedKmerListGenerator<KmerT, permutatedKmerGenerator::Min>
-            referenceKmerGenerator(maskWidth_, mask_, contigList_, sortedReferenceMetadata_.getContigs());
+            referenceKmerGenerator(partitionMaskWidth, partitionMask, contigList_, sortedReferenceMetadata_.getContigs());
         referenceKmerGenerator.generate(oligo::Permutate(oligo::KmerTraits<KmerT>::KMER_BASES), KmerT(0), reference_,
                                         boost::bind(&construct<KmerT>, _1, _2, _3, _4), threads_);
     }
@@ -151,7 +268,7 @@ void ReferenceSorter<KmerT>::sortReference()
 {
     ISAAC_THREAD_CERR << "Sorting " << reference_.size() << " " << oligo::KmerTraits<KmerT>::KMER_BASES << "-mers" << std::endl;
     const clock_t start = clock();
-    common::parallelSort(reference_, &compareKmerThenPosition<KmerT>);
+    common::parallelSort(reference_.begin(), reference_.end(), &compareKmerThenPosition<KmerT>, threads_, threads_.size());
     ISAAC_THREAD_CERR << "Sorting " << reference_.size() << " " << oligo::KmerTraits<KmerT>::KMER_BASES << "-mers" << " done in " << (clock() - start) / 1000 << "ms" << std::endl;
 }
 
@@ -185,17 +302,11 @@ void ReferenceSorter<KmerT>::markRepeats()
 }
 
 template <typename KmerT>
-void ReferenceSorter<KmerT>::saveReference()
+void ReferenceSorter<KmerT>::saveReference(std::ostream &os)
 {
     ISAAC_THREAD_CERR << "Saving " << reference_.size() << " " << oligo::KmerTraits<KmerT>::KMER_BASES << "-mers" << std::endl;
     const clock_t start = clock();
 
-    std::ofstream os(outputFile_.c_str());
-    if (!os)
-    {
-        BOOST_THROW_EXCEPTION(common::IoException(errno,"Failed to create file " + outputFile_.string()));
-    }
-
     if (!reference_.empty())
     {
         if (!os.write(reinterpret_cast<const char*>(&reference_.front()), sizeof(reference_.front()) * reference_.size()))
@@ -204,13 +315,7 @@ void ReferenceSorter<KmerT>::saveReference()
         }
     }
 
-    os.flush();
-    os.close();
     ISAAC_THREAD_CERR << "Saving " << reference_.size() << " " << oligo::KmerTraits<KmerT>::KMER_BASES << "-mers done in " << (clock() - start) / 1000 << "ms" << std::endl;
-
-    SortedReferenceMetadata sortedReference;
-    sortedReference.addMaskFile(oligo::KmerTraits<KmerT>::KMER_BASES, maskWidth_, mask_, outputFile_, reference_.size());
-    saveSortedReferenceXml(std::cout, sortedReference);
 }
 
 template class ReferenceSorter<oligo::VeryShortKmerType>;
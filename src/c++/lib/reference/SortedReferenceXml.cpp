@@ -111,9 +111,15 @@ void serialize(xml::XmlReader &reader, SortedReferenceMetadata::AnnotationFiles
             serialize(reader, annotationFiles.back(), version);
             annotationFiles.back().type_ = SortedReferenceMetadata::AnnotationFile::KRepeatness;
         }
+        else if (reader["Type"] == "contig-image")
+        {
+            annotationFiles.resize(annotationFiles.size() + 1);
+            serialize(reader, annotationFiles.back(), version);
+            annotationFiles.back().type_ = SortedReferenceMetadata::AnnotationFile::ContigImage;
+        }
         else
         {
-            BOOST_THROW_EXCEPTION(xml::XmlReaderException(std::string("Only k-uniqueness and k-repeatness annotations are supported")));
+            BOOST_THROW_EXCEPTION(xml::XmlReaderException(std::string("Only k-uniqueness, k-repeatness and contig-image annotations are supported")));
         }
     }
 
@@ -361,7 +367,8 @@ void serialize<xml::XmlWriter>(xml::XmlWriter &writer, const SortedReferenceMeta
                     {
                         writer.writeAttribute(
                             "Type",
-                            SortedReferenceMetadata::AnnotationFile::KUniqueness == annotation.type_ ?  "k-uniqueness" : "k-repeatness");
+                            SortedReferenceMetadata::AnnotationFile::KUniqueness == annotation.type_ ?  "k-uniqueness" :
+                            SortedReferenceMetadata::AnnotationFile::KRepeatness == annotation.type_ ?  "k-repeatness" : "contig-image");
                         writer.writeAttribute("K", annotation.k_);
                         writer.writeElement("Format", "8bpb");
                         writer.writeElement("File", annotation.path_.string());
@@ -0,0 +1,175 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testAnnotationLoader.cpp
+ **
+ ** Test cases for loading the k-uniqueness annotation through the cache file.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "reference/AnnotationLoader.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testAnnotationLoader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestAnnotationLoader, registryName("AnnotationLoader"));
+
+static const unsigned K = 32;
+// karyotype order differs from the contig order
+static const unsigned CONTIG_SIZES[] = {1000, 0, 2345, 17};
+static const unsigned KARYOTYPE_INDEXES[] = {2, 3, 0, 1};
+static const unsigned CONTIGS_COUNT = sizeof(CONTIG_SIZES) / sizeof(CONTIG_SIZES[0]);
+
+TestAnnotationLoader::TestAnnotationLoader()
+{
+}
+
+/**
+ * \brief annotation file values in karyotype order
+ */
+static void writeAnnotation(const boost::filesystem::path &path, const std::size_t size, const unsigned seed)
+{
+    std::ofstream os(path.c_str(), std::ios_base::binary);
+    for (std::size_t i = 0; size != i; ++i)
+    {
+        os.put(char((i * 7 + seed) % 251));
+    }
+    CPPUNIT_ASSERT(os.flush());
+}
+
+void TestAnnotationLoader::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+    kUniquenessPath_ = tempDirectory_ / "kuniqueness.dat";
+    kRepeatnessPath_ = tempDirectory_ / "krepeatness.dat";
+
+    reference::SortedReferenceMetadata sortedReferenceMetadata;
+    std::size_t genomicOffset = 0;
+    for (unsigned contig = 0; CONTIGS_COUNT != contig; ++contig)
+    {
+        sortedReferenceMetadata.putContig(
+            genomicOffset, (boost::format("chr%d") % contig).str(), tempDirectory_ / "genome.fa", 0, 0,
+            CONTIG_SIZES[contig], CONTIG_SIZES[contig], contig, KARYOTYPE_INDEXES[contig], "", "", "");
+        genomicOffset += CONTIG_SIZES[contig];
+    }
+    writeAnnotation(kUniquenessPath_, genomicOffset, 1);
+    writeAnnotation(kRepeatnessPath_, genomicOffset, 2);
+    sortedReferenceMetadata.setKUniquenessAnnotation(kUniquenessPath_, K);
+    sortedReferenceMetadata.setKRepeatnessAnnotation(kRepeatnessPath_, K);
+    sortedReferenceMetadataList_.assign(1, sortedReferenceMetadata);
+}
+
+void TestAnnotationLoader::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+static boost::filesystem::path getCachePath(const boost::filesystem::path &kUniquenessPath)
+{
+    return kUniquenessPath.string() + ".dat";
+}
+
+static ino_t getInode(const boost::filesystem::path &path)
+{
+    struct stat s;
+    CPPUNIT_ASSERT_EQUAL(0, stat(path.c_str(), &s));
+    return s.st_ino;
+}
+
+/**
+ * \brief compares cached annotations with the ones loaded directly from the annotation files
+ */
+static void checkAnnotations(
+    const reference::SortedReferenceMetadataList &sortedReferenceMetadataList,
+    const reference::ContigAnnotationsList &cached,
+    const bool mapped)
+{
+    const reference::ContigAnnotationsList expected = reference::loadAnnotations(sortedReferenceMetadataList, false);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), cached.size());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(CONTIGS_COUNT), cached.at(0).size());
+    for (unsigned contig = 0; CONTIGS_COUNT != contig; ++contig)
+    {
+        const reference::ContigAnnotation &expectedContig = expected.at(0).at(KARYOTYPE_INDEXES[contig]);
+        const reference::ContigAnnotation &cachedContig = cached.at(0).at(KARYOTYPE_INDEXES[contig]);
+        CPPUNIT_ASSERT(!expectedContig.isMapped());
+        CPPUNIT_ASSERT_EQUAL(mapped, cachedContig.isMapped());
+        CPPUNIT_ASSERT_EQUAL(std::size_t(CONTIG_SIZES[contig]), cachedContig.size());
+        CPPUNIT_ASSERT(std::equal(expectedContig.begin(), expectedContig.end(), cachedContig.begin()));
+    }
+}
+
+void TestAnnotationLoader::testCacheHit()
+{
+    const boost::filesystem::path cachePath = getCachePath(kUniquenessPath_);
+    CPPUNIT_ASSERT(!boost::filesystem::exists(cachePath));
+    checkAnnotations(sortedReferenceMetadataList_, reference::loadAnnotations(sortedReferenceMetadataList_, true), true);
+    CPPUNIT_ASSERT(boost::filesystem::exists(cachePath));
+
+    // second load maps the existing file instead of replacing it
+    const ino_t inode = getInode(cachePath);
+    checkAnnotations(sortedReferenceMetadataList_, reference::loadAnnotations(sortedReferenceMetadataList_, true), true);
+    CPPUNIT_ASSERT_EQUAL(inode, getInode(cachePath));
+
+    // mapped annotations are shared by all NUMA nodes
+    const reference::NumaContigAnnotationsList numaAnnotations(
+        reference::loadAnnotations(sortedReferenceMetadataList_, true), true);
+    CPPUNIT_ASSERT_EQUAL(&numaAnnotations.node0Container(), &numaAnnotations.threadNodeContainer());
+}
+
+/**
+ * \brief Cache produced from an older annotation file gets replaced
+ */
+void TestAnnotationLoader::testStaleFingerprint()
+{
+    const boost::filesystem::path cachePath = getCachePath(kUniquenessPath_);
+    reference::loadAnnotations(sortedReferenceMetadataList_, true);
+    const ino_t inode = getInode(cachePath);
+
+    const std::time_t writeTime = boost::filesystem::last_write_time(kRepeatnessPath_);
+    writeAnnotation(kRepeatnessPath_, boost::filesystem::file_size(kRepeatnessPath_), 3);
+    boost::filesystem::last_write_time(kRepeatnessPath_, writeTime + 10);
+
+    checkAnnotations(sortedReferenceMetadataList_, reference::loadAnnotations(sortedReferenceMetadataList_, true), true);
+    CPPUNIT_ASSERT(inode != getInode(cachePath));
+}
+
+/**
+ * \brief Cache cut short, for example by a full disk, gets replaced
+ */
+void TestAnnotationLoader::testTruncatedCache()
+{
+    const boost::filesystem::path cachePath = getCachePath(kUniquenessPath_);
+    reference::loadAnnotations(sortedReferenceMetadataList_, true);
+    const boost::uintmax_t cacheSize = boost::filesystem::file_size(cachePath);
+
+    boost::filesystem::resize_file(cachePath, cacheSize - 100);
+    checkAnnotations(sortedReferenceMetadataList_, reference::loadAnnotations(sortedReferenceMetadataList_, true), true);
+    CPPUNIT_ASSERT_EQUAL(cacheSize, boost::filesystem::file_size(cachePath));
+
+    // header only
+    boost::filesystem::resize_file(cachePath, 40);
+    checkAnnotations(sortedReferenceMetadataList_, reference::loadAnnotations(sortedReferenceMetadataList_, true), true);
+    CPPUNIT_ASSERT_EQUAL(cacheSize, boost::filesystem::file_size(cachePath));
+}
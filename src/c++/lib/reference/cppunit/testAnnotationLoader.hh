@@ -0,0 +1,46 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_REFERENCE_TEST_ANNOTATION_LOADER_HH
+#define iSAAC_REFERENCE_TEST_ANNOTATION_LOADER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "reference/SortedReferenceMetadata.hh"
+
+class TestAnnotationLoader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestAnnotationLoader );
+    CPPUNIT_TEST( testCacheHit );
+    CPPUNIT_TEST( testStaleFingerprint );
+    CPPUNIT_TEST( testTruncatedCache );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path kUniquenessPath_;
+    boost::filesystem::path kRepeatnessPath_;
+    isaac::reference::SortedReferenceMetadataList sortedReferenceMetadataList_;
+
+public:
+    TestAnnotationLoader();
+    void setUp();
+    void tearDown();
+
+    void testCacheHit();
+    void testStaleFingerprint();
+    void testTruncatedCache();
+};
+
+#endif // #ifndef iSAAC_REFERENCE_TEST_ANNOTATION_LOADER_HH
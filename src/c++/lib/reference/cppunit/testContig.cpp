@@ -0,0 +1,159 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testContig.cpp
+ **
+ ** Test cases for the packed contig against the plain byte per base sequence.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <string>
+#include <vector>
+
+#include "reference/Contig.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testContig.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestContig, registryName("Contig"));
+
+/**
+ * \brief pseudo-random sequence with Ns. Odd length so that the last packed word is partial.
+ */
+static std::string makeSequence(const std::size_t length, unsigned seed, const char *bases = "ACGTACGTACGTN")
+{
+    const std::size_t basesCount = std::string(bases).size();
+    std::string ret;
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        ret += bases[(seed >> 16) % basesCount];
+    }
+    return ret;
+}
+
+static reference::Contig makeContig(const std::string &sequence)
+{
+    reference::Contig ret(0, "test");
+    ret.assign(sequence.begin(), sequence.end());
+    return ret;
+}
+
+/**
+ * \brief byte per base reference of alignment::isMatch: N in the sequence matches anything, N in the reference
+ *        matches nothing
+ */
+static unsigned countMismatchesScalar(const std::string &sequence, const std::string &reference, const std::size_t pos)
+{
+    unsigned ret = 0;
+    for (std::size_t i = 0; sequence.size() != i && reference.size() > pos + i; ++i)
+    {
+        ret += !('N' == sequence[i] || (sequence[i] == reference[pos + i] && 'N' != reference[pos + i]));
+    }
+    return ret;
+}
+
+void TestContig::setUp()
+{
+}
+
+void TestContig::tearDown()
+{
+}
+
+void TestContig::testPackedBases()
+{
+    const std::string sequence = makeSequence(1000 + 37, 1);
+    const reference::Contig contig = makeContig(sequence);
+    CPPUNIT_ASSERT_EQUAL(sequence.size(), contig.size());
+    CPPUNIT_ASSERT_EQUAL(sequence, std::string(contig.begin(), contig.end()));
+    for (std::size_t pos = 0; sequence.size() != pos; ++pos)
+    {
+        CPPUNIT_ASSERT_EQUAL(sequence[pos], contig[pos]);
+        CPPUNIT_ASSERT_EQUAL('N' == sequence[pos], contig.isN(pos));
+    }
+    CPPUNIT_ASSERT_EQUAL(std::ptrdiff_t(sequence.size()), std::distance(contig.begin(), contig.end()));
+    CPPUNIT_ASSERT_EQUAL(sequence[500], *(contig.begin() + 500));
+    CPPUNIT_ASSERT_EQUAL(sequence[499], *(contig.end() - (sequence.size() - 499)));
+
+    // anything other than ACGT reads back as N
+    const reference::Contig iupac = makeContig("ACRYGTkn.");
+    CPPUNIT_ASSERT_EQUAL(std::string("ACNNGTNNN"), std::string(iupac.begin(), iupac.end()));
+
+    // two bits per base plus one bit of N mask
+    CPPUNIT_ASSERT(contig.getPackedBytes() < sequence.size() / 4 + sequence.size() / 8 + 32);
+}
+
+void TestContig::testUnpack()
+{
+    const std::string sequence = makeSequence(500 + 13, 2);
+    const std::string noNs = makeSequence(500 + 13, 3, "ACGT");
+    const reference::Contig contig = makeContig(sequence);
+    const reference::Contig noNsContig = makeContig(noNs);
+    std::vector<char> unpacked(sequence.size());
+    for (std::size_t pos = 0; sequence.size() > pos; pos += 7)
+    {
+        for (std::size_t length = 0; sequence.size() - pos >= length; length += 31)
+        {
+            contig.unpack(pos, length, &unpacked.front());
+            CPPUNIT_ASSERT_EQUAL(sequence.substr(pos, length), std::string(unpacked.begin(), unpacked.begin() + length));
+            (noNsContig.begin() + pos).unpack(length, &unpacked.front());
+            CPPUNIT_ASSERT_EQUAL(noNs.substr(pos, length), std::string(unpacked.begin(), unpacked.begin() + length));
+        }
+    }
+}
+
+void TestContig::testCountMismatches()
+{
+    const std::string reference = makeSequence(700 + 5, 4);
+    const reference::Contig contig = makeContig(reference);
+    for (unsigned readSeed = 0; 10 != readSeed; ++readSeed)
+    {
+        // mostly matching reads to get both matches and mismatches
+        for (std::size_t pos = 0; reference.size() > pos; pos += 11)
+        {
+            std::string read = reference.substr(pos, 150);
+            const std::string noise = makeSequence(read.size(), readSeed + pos, "ACGTNACGTNAAAAAAAAAAAAAAAAAAAA");
+            for (std::size_t i = 0; read.size() != i; ++i)
+            {
+                read[i] = 'A' == noise[i] ? read[i] : noise[i];
+            }
+            CPPUNIT_ASSERT_EQUAL(countMismatchesScalar(read, reference, pos),
+                                 contig.countMismatches(read.begin(), read.end(), pos));
+        }
+    }
+    // comparison stops at the end of the contig
+    const std::string overhang(100, 'T');
+    CPPUNIT_ASSERT_EQUAL(countMismatchesScalar(overhang, reference, reference.size() - 40),
+                         contig.countMismatches(overhang.begin(), overhang.end(), reference.size() - 40));
+}
+
+void TestContig::testResize()
+{
+    const std::string sequence = makeSequence(200 + 3, 5);
+    reference::Contig contig = makeContig(sequence);
+    contig.resize(65);
+    CPPUNIT_ASSERT_EQUAL(sequence.substr(0, 65), std::string(contig.begin(), contig.end()));
+    // bases past the old end must not come back from the truncated words
+    contig.resize(130);
+    CPPUNIT_ASSERT_EQUAL(sequence.substr(0, 65) + std::string(65, 'A'), std::string(contig.begin(), contig.end()));
+
+    reference::Contig copy(contig);
+    CPPUNIT_ASSERT(copy == contig);
+    copy.push_back('N');
+    CPPUNIT_ASSERT(copy != contig);
+    CPPUNIT_ASSERT_EQUAL('N', copy.back());
+}
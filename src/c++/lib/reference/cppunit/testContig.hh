@@ -0,0 +1,39 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_REFERENCE_TEST_CONTIG_HH
+#define iSAAC_REFERENCE_TEST_CONTIG_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+class TestContig : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestContig );
+    CPPUNIT_TEST( testPackedBases );
+    CPPUNIT_TEST( testUnpack );
+    CPPUNIT_TEST( testCountMismatches );
+    CPPUNIT_TEST( testResize );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+
+    void testPackedBases();
+    void testUnpack();
+    void testCountMismatches();
+    void testResize();
+};
+
+#endif // #ifndef iSAAC_REFERENCE_TEST_CONTIG_HH
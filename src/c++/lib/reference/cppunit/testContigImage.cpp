@@ -0,0 +1,220 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testContigImage.cpp
+ **
+ ** Test cases for storing and loading the contig image.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "common/Threads.hpp"
+#include "reference/ContigImage.hh"
+#include "reference/ContigLoader.hh"
+#include "reference/ReferenceHash.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testContigImage.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestContigImage, registryName("ContigImage"));
+
+static const unsigned CONTIGS_COUNT = 4;
+static const unsigned FASTA_LINE_LENGTH = 60;
+
+TestContigImage::TestContigImage()
+{
+}
+
+/**
+ * \brief sequence of contig, some with Ns and lower case bases, the last one empty
+ */
+static std::string contigSequence(const unsigned contig)
+{
+    static const char bases[] = "ACGTacgtNnAC";
+    const std::size_t length = CONTIGS_COUNT - 1 == contig ? 0 : 1000 * (contig + 1) + 17;
+    std::string ret;
+    unsigned seed = contig + 1;
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        ret += bases[(seed >> 16) % (sizeof(bases) - 1)];
+    }
+    return ret;
+}
+
+void TestContigImage::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+    fastaPath_ = tempDirectory_ / "genome.fa";
+    imagePath_ = tempDirectory_ / "genome.contigs";
+
+    std::ofstream os(fastaPath_.c_str());
+    for (unsigned contig = 0; CONTIGS_COUNT != contig; ++contig)
+    {
+        os << ">chr" << contig << "\n";
+        const std::string sequence = contigSequence(contig);
+        for (std::size_t offset = 0; sequence.size() > offset; offset += FASTA_LINE_LENGTH)
+        {
+            os << sequence.substr(offset, FASTA_LINE_LENGTH) << "\n";
+        }
+    }
+    CPPUNIT_ASSERT(os.flush());
+}
+
+void TestContigImage::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+reference::SortedReferenceMetadata TestContigImage::makeReference(const std::vector<unsigned> &karyotypeIndexes) const
+{
+    reference::SortedReferenceMetadata ret;
+    uint64_t byteOffset = 0;
+    uint64_t genomicOffset = 0;
+    for (unsigned contig = 0; CONTIGS_COUNT != contig; ++contig)
+    {
+        const std::string name = (boost::format("chr%d") % contig).str();
+        const std::string sequence = contigSequence(contig);
+        byteOffset += name.size() + 2;
+        const uint64_t byteSize = sequence.size() + (sequence.size() + FASTA_LINE_LENGTH - 1) / FASTA_LINE_LENGTH;
+        const uint64_t acgtBases = sequence.size() - std::count(sequence.begin(), sequence.end(), 'N') -
+            std::count(sequence.begin(), sequence.end(), 'n');
+        ret.putContig(genomicOffset, name, fastaPath_, byteOffset, byteSize, sequence.size(), acgtBases,
+                      contig, karyotypeIndexes.at(contig), "", "", "");
+        byteOffset += byteSize;
+        genomicOffset += sequence.size();
+    }
+    ret.setContigImage(imagePath_);
+    return ret;
+}
+
+/**
+ * \brief every contig loaded from the image must equal the one loaded from the fasta
+ */
+void TestContigImage::checkRoundTrip(const reference::SortedReferenceMetadata &sortedReferenceMetadata)
+{
+    common::ThreadVector threads(2);
+    const reference::ContigList contigs = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    reference::storeContigImage(sortedReferenceMetadata, contigs, imagePath_);
+
+    const std::unique_ptr<reference::ContigImage> image = reference::ContigImage::open(sortedReferenceMetadata);
+    CPPUNIT_ASSERT(image.get());
+    BOOST_FOREACH(const reference::SortedReferenceMetadata::Contig &xmlContig, sortedReferenceMetadata.getContigs())
+    {
+        reference::Contig expected;
+        reference::loadContig(xmlContig, expected);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(xmlContig.totalBases_), expected.size());
+        reference::Contig loaded;
+        image->load(xmlContig, loaded);
+        CPPUNIT_ASSERT_MESSAGE(xmlContig.name_, expected == loaded);
+    }
+
+    // and the same through loadContigs
+    const reference::ContigList loaded =
+        reference::loadContigs(sortedReferenceMetadata.getContigs(), [](unsigned){return true;}, threads, image.get());
+    CPPUNIT_ASSERT_EQUAL(contigs.size(), loaded.size());
+    for (std::size_t i = 0; contigs.size() != i; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL(contigs.at(i).index_, loaded.at(i).index_);
+        CPPUNIT_ASSERT(contigs.at(i) == loaded.at(i));
+    }
+}
+
+void TestContigImage::testRoundTrip()
+{
+    const std::vector<unsigned> karyotypeIndexes = {0, 1, 2, 3};
+    checkRoundTrip(makeReference(karyotypeIndexes));
+}
+
+/**
+ * \brief karyotype order differs from the order of the contigs in the fasta
+ */
+void TestContigImage::testReorderedReference()
+{
+    const std::vector<unsigned> karyotypeIndexes = {2, 0, 3, 1};
+    checkRoundTrip(makeReference(karyotypeIndexes));
+}
+
+void TestContigImage::testMismatch()
+{
+    const std::vector<unsigned> karyotypeIndexes = {1, 3, 0, 2};
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference(karyotypeIndexes);
+    common::ThreadVector threads(1);
+    reference::storeContigImage(
+        sortedReferenceMetadata, reference::loadContigs(sortedReferenceMetadata.getContigs(), threads), imagePath_);
+
+    // image of a different reference is ignored
+    reference::SortedReferenceMetadata otherReference = makeReference(std::vector<unsigned>{0, 1, 2, 3});
+    CPPUNIT_ASSERT(!reference::ContigImage::open(otherReference).get());
+
+    // corrupt base fails the checksum
+    {
+        std::fstream fs(imagePath_.c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        fs.seekp(-5, std::ios_base::end);
+        CPPUNIT_ASSERT(fs.put('Z'));
+    }
+    const std::unique_ptr<reference::ContigImage> image = reference::ContigImage::open(sortedReferenceMetadata);
+    CPPUNIT_ASSERT(image.get());
+    // the last contig in karyotype order, which is the last in the image, is not empty
+    const reference::SortedReferenceMetadata::Contig &xmlContig = sortedReferenceMetadata.getContigs().at(1);
+    CPPUNIT_ASSERT_EQUAL(CONTIGS_COUNT - 1, xmlContig.karyotypeIndex_);
+    reference::Contig contig;
+    CPPUNIT_ASSERT(!image->load(xmlContig, contig));
+
+    // loadContigs reads the damaged contig from the fasta instead
+    const reference::ContigList expected = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    const reference::ContigList loaded = reference::loadContigs(
+        sortedReferenceMetadata.getContigs(), [](unsigned){return true;}, threads, image.get());
+    CPPUNIT_ASSERT_EQUAL(expected.size(), loaded.size());
+    for (std::size_t i = 0; expected.size() != i; ++i)
+    {
+        CPPUNIT_ASSERT(expected.at(i) == loaded.at(i));
+    }
+}
+
+/**
+ * \brief an image that is shorter or longer than its contig table says is not used. Storing leaves nothing
+ *        but the image behind.
+ */
+void TestContigImage::testTruncated()
+{
+    const std::vector<unsigned> karyotypeIndexes = {0, 1, 2, 3};
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference(karyotypeIndexes);
+    common::ThreadVector threads(1);
+    reference::storeContigImage(
+        sortedReferenceMetadata, reference::loadContigs(sortedReferenceMetadata.getContigs(), threads), imagePath_);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), std::size_t(std::distance(
+        boost::filesystem::directory_iterator(tempDirectory_), boost::filesystem::directory_iterator())));
+    CPPUNIT_ASSERT(reference::ContigImage::open(sortedReferenceMetadata).get());
+
+    const uintmax_t size = boost::filesystem::file_size(imagePath_);
+    boost::filesystem::resize_file(imagePath_, size - 1);
+    CPPUNIT_ASSERT(!reference::ContigImage::open(sortedReferenceMetadata).get());
+
+    boost::filesystem::resize_file(imagePath_, size + 1);
+    CPPUNIT_ASSERT(!reference::ContigImage::open(sortedReferenceMetadata).get());
+
+    // header and the first table entry only
+    boost::filesystem::resize_file(imagePath_, sizeof(reference::ContigImageFileHeader) + sizeof(reference::ContigImageEntry));
+    CPPUNIT_ASSERT(!reference::ContigImage::open(sortedReferenceMetadata).get());
+}
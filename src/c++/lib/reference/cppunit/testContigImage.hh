@@ -0,0 +1,51 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_REFERENCE_TEST_CONTIG_IMAGE_HH
+#define iSAAC_REFERENCE_TEST_CONTIG_IMAGE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "reference/SortedReferenceMetadata.hh"
+
+class TestContigImage : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestContigImage );
+    CPPUNIT_TEST( testRoundTrip );
+    CPPUNIT_TEST( testReorderedReference );
+    CPPUNIT_TEST( testMismatch );
+    CPPUNIT_TEST( testTruncated );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path fastaPath_;
+    boost::filesystem::path imagePath_;
+
+public:
+    TestContigImage();
+    void setUp();
+    void tearDown();
+
+    void testRoundTrip();
+    void testReorderedReference();
+    void testMismatch();
+    void testTruncated();
+
+private:
+    isaac::reference::SortedReferenceMetadata makeReference(const std::vector<unsigned> &karyotypeIndexes) const;
+    void checkRoundTrip(const isaac::reference::SortedReferenceMetadata &sortedReferenceMetadata);
+};
+
+#endif // #ifndef iSAAC_REFERENCE_TEST_CONTIG_IMAGE_HH
@@ -0,0 +1,216 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testReferenceHash.cpp
+ **
+ ** Test cases for storing, mapping and rebuilding the persistent reference hash.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <fstream>
+#include <string>
+
+#include "common/Exceptions.hh"
+#include "common/Threads.hpp"
+#include "reference/ContigLoader.hh"
+#include "reference/ReferenceHash.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testReferenceHash.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestReferenceHash, registryName("ReferenceHash"));
+
+typedef oligo::VeryShortKmerType KmerT;
+typedef reference::ReferenceHash<KmerT, common::NumaAllocator<void, 0, true> > ReferenceHashT;
+
+static const std::size_t CONTIG_LENGTH = 5000;
+static const unsigned FASTA_LINE_LENGTH = 60;
+
+TestReferenceHash::TestReferenceHash()
+{
+}
+
+static std::string contigSequence()
+{
+    static const char bases[] = "ACGT";
+    std::string ret;
+    unsigned seed = 1;
+    for (std::size_t i = 0; CONTIG_LENGTH != i; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        ret += bases[(seed >> 16) % (sizeof(bases) - 1)];
+    }
+    return ret;
+}
+
+void TestReferenceHash::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+    fastaPath_ = tempDirectory_ / "genome.fa";
+    hashPath_ = tempDirectory_ / "ReferenceHash-8.dat";
+
+    std::ofstream os(fastaPath_.c_str());
+    os << ">chr0\n";
+    const std::string sequence = contigSequence();
+    for (std::size_t offset = 0; sequence.size() > offset; offset += FASTA_LINE_LENGTH)
+    {
+        os << sequence.substr(offset, FASTA_LINE_LENGTH) << "\n";
+    }
+    CPPUNIT_ASSERT(os.flush());
+}
+
+void TestReferenceHash::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+reference::SortedReferenceMetadata TestReferenceHash::makeReference() const
+{
+    reference::SortedReferenceMetadata ret;
+    const uint64_t byteSize = CONTIG_LENGTH + (CONTIG_LENGTH + FASTA_LINE_LENGTH - 1) / FASTA_LINE_LENGTH;
+    ret.putContig(0, "chr0", fastaPath_, 6, byteSize, CONTIG_LENGTH, CONTIG_LENGTH, 0, 0, "", "", "");
+    return ret;
+}
+
+/**
+ * \brief every kmer must find the same positions in both hashes
+ */
+template <typename ExpectedT, typename ActualT>
+static void checkSameMatches(const ExpectedT &expected, const ActualT &actual)
+{
+    for (std::size_t bits = 0; (1UL << oligo::KmerTraits<KmerT>::KMER_BITS) != bits; ++bits)
+    {
+        const KmerT kmer(bits);
+        const typename ExpectedT::MatchRange expectedRange = expected.findMatches(kmer);
+        const typename ActualT::MatchRange actualRange = actual.findMatches(kmer);
+        CPPUNIT_ASSERT_EQUAL(std::distance(expectedRange.first, expectedRange.second),
+                             std::distance(actualRange.first, actualRange.second));
+        CPPUNIT_ASSERT(std::equal(expectedRange.first, expectedRange.second, actualRange.first));
+    }
+}
+
+void TestReferenceHash::testFingerprint()
+{
+    // md5 of the little-endian fields, must not change between builds
+    CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0xf9da4697e39fade0UL),
+                         reference::ReferenceFingerprint().add(boost::uint64_t(1)).add(std::string("chr1")).get());
+
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference();
+    const boost::uint64_t fingerprint = reference::computeReferenceHashFingerprint(sortedReferenceMetadata);
+    CPPUNIT_ASSERT_EQUAL(fingerprint, reference::computeReferenceHashFingerprint(makeReference()));
+
+    reference::SortedReferenceMetadata renamed;
+    renamed.putContig(0, "chr1", fastaPath_, 6, 0, CONTIG_LENGTH, CONTIG_LENGTH, 0, 0, "", "", "");
+    CPPUNIT_ASSERT(fingerprint != reference::computeReferenceHashFingerprint(renamed));
+}
+
+void TestReferenceHash::testStoreAndMap()
+{
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference();
+    common::ThreadVector threads(2);
+    const reference::ContigList contigList = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    reference::ReferenceHasher<ReferenceHashT> hasher(sortedReferenceMetadata, contigList, threads, threads.size());
+    const ReferenceHashT expected = hasher.generate();
+
+    // first load generates and stores
+    CPPUNIT_ASSERT(!boost::filesystem::exists(hashPath_));
+    const reference::NumaReferenceHash<ReferenceHashT> generated = reference::loadReferenceHash<ReferenceHashT>(
+        hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+    const boost::uint64_t fingerprint = reference::computeReferenceHashFingerprint(sortedReferenceMetadata);
+    CPPUNIT_ASSERT(reference::isReferenceHashFileValid(hashPath_, KmerT::KMER_BASES, fingerprint));
+    CPPUNIT_ASSERT(generated.isMapped());
+    checkSameMatches(expected, generated);
+
+    // second load maps the stored file without rewriting it
+    const std::time_t stored = boost::filesystem::last_write_time(hashPath_);
+    boost::filesystem::last_write_time(hashPath_, stored - 100);
+    const reference::NumaReferenceHash<ReferenceHashT> mapped = reference::loadReferenceHash<ReferenceHashT>(
+        hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+    CPPUNIT_ASSERT_EQUAL(stored - 100, boost::filesystem::last_write_time(hashPath_));
+    CPPUNIT_ASSERT(mapped.isMapped());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(boost::filesystem::file_size(hashPath_)), mapped.getBytes());
+    checkSameMatches(expected, mapped);
+
+    const reference::MappedReferenceHash<KmerT> direct(hashPath_, fingerprint);
+    checkSameMatches(expected, direct);
+}
+
+void TestReferenceHash::testReplicate()
+{
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference();
+    common::ThreadVector threads(1);
+    const reference::ContigList contigList = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    reference::loadReferenceHash<ReferenceHashT>(hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+
+    const reference::NumaReferenceHash<ReferenceHashT> replicated = reference::loadReferenceHash<ReferenceHashT>(
+        hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), true);
+    CPPUNIT_ASSERT(!replicated.isMapped());
+    const reference::MappedReferenceHash<KmerT> direct(
+        hashPath_, reference::computeReferenceHashFingerprint(sortedReferenceMetadata));
+    checkSameMatches(direct, replicated);
+}
+
+void TestReferenceHash::testStaleFingerprint()
+{
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference();
+    common::ThreadVector threads(1);
+    const reference::ContigList contigList = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    reference::loadReferenceHash<ReferenceHashT>(hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+    const boost::uint64_t oldFingerprint = reference::computeReferenceHashFingerprint(sortedReferenceMetadata);
+
+    // touching the fasta makes the stored hash stale
+    boost::filesystem::last_write_time(fastaPath_, boost::filesystem::last_write_time(fastaPath_) + 100);
+    const boost::uint64_t newFingerprint = reference::computeReferenceHashFingerprint(sortedReferenceMetadata);
+    CPPUNIT_ASSERT(oldFingerprint != newFingerprint);
+    CPPUNIT_ASSERT(!reference::isReferenceHashFileValid(hashPath_, KmerT::KMER_BASES, newFingerprint));
+    CPPUNIT_ASSERT_THROW(reference::MappedReferenceHash<KmerT>(hashPath_, newFingerprint).getBytes(), common::IoException);
+
+    // and the next load rebuilds it
+    const reference::NumaReferenceHash<ReferenceHashT> rebuilt = reference::loadReferenceHash<ReferenceHashT>(
+        hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+    CPPUNIT_ASSERT(rebuilt.isMapped());
+    CPPUNIT_ASSERT(reference::isReferenceHashFileValid(hashPath_, KmerT::KMER_BASES, newFingerprint));
+    CPPUNIT_ASSERT(!reference::isReferenceHashFileValid(hashPath_, KmerT::KMER_BASES, oldFingerprint));
+
+    reference::ReferenceHasher<ReferenceHashT> hasher(sortedReferenceMetadata, contigList, threads, threads.size());
+    checkSameMatches(hasher.generate(), rebuilt);
+}
+
+void TestReferenceHash::testTruncatedFile()
+{
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = makeReference();
+    common::ThreadVector threads(1);
+    const reference::ContigList contigList = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    reference::loadReferenceHash<ReferenceHashT>(hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+    const boost::uint64_t fingerprint = reference::computeReferenceHashFingerprint(sortedReferenceMetadata);
+    const boost::uintmax_t storedSize = boost::filesystem::file_size(hashPath_);
+
+    // header intact, positions cut short as if the writer died
+    boost::filesystem::resize_file(hashPath_, storedSize - sizeof(reference::ReferencePosition));
+    CPPUNIT_ASSERT(!reference::isReferenceHashFileValid(hashPath_, KmerT::KMER_BASES, fingerprint));
+    CPPUNIT_ASSERT_THROW(reference::MappedReferenceHash<KmerT>(hashPath_, fingerprint).getBytes(), common::IoException);
+
+    // the next load rebuilds it instead of failing
+    const reference::NumaReferenceHash<ReferenceHashT> rebuilt = reference::loadReferenceHash<ReferenceHashT>(
+        hashPath_, sortedReferenceMetadata, contigList, threads, threads.size(), false);
+    CPPUNIT_ASSERT(rebuilt.isMapped());
+    CPPUNIT_ASSERT_EQUAL(storedSize, boost::filesystem::file_size(hashPath_));
+    CPPUNIT_ASSERT(reference::isReferenceHashFileValid(hashPath_, KmerT::KMER_BASES, fingerprint));
+
+    reference::ReferenceHasher<ReferenceHashT> hasher(sortedReferenceMetadata, contigList, threads, threads.size());
+    checkSameMatches(hasher.generate(), rebuilt);
+}
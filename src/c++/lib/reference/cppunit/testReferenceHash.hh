@@ -0,0 +1,52 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_REFERENCE_TEST_REFERENCE_HASH_HH
+#define iSAAC_REFERENCE_TEST_REFERENCE_HASH_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "reference/SortedReferenceMetadata.hh"
+
+class TestReferenceHash : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestReferenceHash );
+    CPPUNIT_TEST( testFingerprint );
+    CPPUNIT_TEST( testStoreAndMap );
+    CPPUNIT_TEST( testReplicate );
+    CPPUNIT_TEST( testStaleFingerprint );
+    CPPUNIT_TEST( testTruncatedFile );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path fastaPath_;
+    boost::filesystem::path hashPath_;
+
+public:
+    TestReferenceHash();
+    void setUp();
+    void tearDown();
+
+    void testFingerprint();
+    void testStoreAndMap();
+    void testReplicate();
+    void testStaleFingerprint();
+    void testTruncatedFile();
+
+private:
+    isaac::reference::SortedReferenceMetadata makeReference() const;
+};
+
+#endif // #ifndef iSAAC_REFERENCE_TEST_REFERENCE_HASH_HH
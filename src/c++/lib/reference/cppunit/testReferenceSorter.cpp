@@ -0,0 +1,154 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testReferenceSorter.cpp
+ **
+ ** Test cases for sorting the reference k-mers under a memory limit.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/BitsetSaver.hh"
+#include "reference/ReferenceSorter.hh"
+#include "reference/SortedReferenceXml.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testReferenceSorter.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestReferenceSorter, registryName("ReferenceSorter"));
+
+typedef oligo::VeryShortKmerType KmerT;
+
+static const std::size_t CONTIG_LENGTHS[] = {300000, 200000};
+static const unsigned FASTA_LINE_LENGTH = 60;
+// k-mers of the genome take 5 megabytes. Enough to force several partitions for anything but the
+// sort job queue of hundreds of threads
+static const uint64_t MEMORY_LIMIT = 2 * 1024 * 1024;
+
+TestReferenceSorter::TestReferenceSorter()
+{
+}
+
+static std::string contigSequence(const std::size_t length, unsigned seed)
+{
+    static const char bases[] = "ACGT";
+    std::string ret;
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        ret += bases[(seed >> 16) % (sizeof(bases) - 1)];
+    }
+    return ret;
+}
+
+void TestReferenceSorter::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+    const boost::filesystem::path fastaPath = tempDirectory_ / "genome.fa";
+    xmlPath_ = tempDirectory_ / "genome.xml";
+    neighborsPath_ = tempDirectory_ / "neighbors.dat";
+
+    reference::SortedReferenceMetadata sortedReferenceMetadata;
+    std::ofstream os(fastaPath.c_str());
+    uint64_t genomicOffset = 0;
+    for (unsigned index = 0; sizeof(CONTIG_LENGTHS) / sizeof(CONTIG_LENGTHS[0]) != index; ++index)
+    {
+        const std::string name = "chr" + boost::lexical_cast<std::string>(index);
+        os << ">" << name << "\n";
+        const uint64_t byteOffset = os.tellp();
+        const std::string sequence = contigSequence(CONTIG_LENGTHS[index], index + 1);
+        for (std::size_t offset = 0; sequence.size() > offset; offset += FASTA_LINE_LENGTH)
+        {
+            os << sequence.substr(offset, FASTA_LINE_LENGTH) << "\n";
+        }
+        sortedReferenceMetadata.putContig(
+            genomicOffset, name, fastaPath, byteOffset, uint64_t(os.tellp()) - byteOffset,
+            sequence.size(), sequence.size(), index, index, "", "", "");
+        genomicOffset += sequence.size();
+    }
+    CPPUNIT_ASSERT(os.flush());
+    reference::saveSortedReferenceXml(xmlPath_, sortedReferenceMetadata);
+
+    // every third base has neighbors
+    std::vector<bool> neighbors(genomicOffset, false);
+    for (std::size_t position = 0; neighbors.size() > position; position += 3)
+    {
+        neighbors[position] = true;
+    }
+    io::BitsetSaver saver(neighborsPath_);
+    saver.save(neighbors.begin(), neighbors.end(), true);
+}
+
+void TestReferenceSorter::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+/**
+ * \brief run() reports the mask file metadata on std::cout. Keep it out of the test output.
+ */
+struct CoutRedirect
+{
+    std::ostringstream os_;
+    std::streambuf *original_;
+    CoutRedirect() : original_(std::cout.rdbuf(os_.rdbuf())) {}
+    ~CoutRedirect() {std::cout.rdbuf(original_);}
+};
+
+std::string TestReferenceSorter::sort(const unsigned repeatThreshold, const uint64_t memoryLimit, const std::string &name) const
+{
+    const boost::filesystem::path outputPath = tempDirectory_ / name;
+    {
+        CoutRedirect redirect;
+        reference::ReferenceSorter<KmerT>(
+            0, 0, xmlPath_, neighborsPath_, outputPath, repeatThreshold, memoryLimit).run();
+    }
+    std::ifstream is(outputPath.c_str());
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+void TestReferenceSorter::testMemoryLimit()
+{
+    // 0 is what FindNeighbors.mk uses, 40 is low enough to mark some of the 8-mers as repeats
+    const unsigned repeatThresholds[] = {0, 40};
+    BOOST_FOREACH(const unsigned repeatThreshold, repeatThresholds)
+    {
+        const std::string uncapped = sort(repeatThreshold, 0, "uncapped.dat");
+        const std::string capped = sort(repeatThreshold, MEMORY_LIMIT, "capped.dat");
+        if (!repeatThreshold)
+        {
+            // nothing is dropped, so the output is as big as the k-mers were in memory
+            CPPUNIT_ASSERT(MEMORY_LIMIT < uncapped.size());
+        }
+        CPPUNIT_ASSERT_EQUAL(uncapped.size(), capped.size());
+        CPPUNIT_ASSERT(uncapped == capped);
+    }
+}
+
+void TestReferenceSorter::testMemoryLimitTooLow()
+{
+    // contigs alone take more than that
+    CPPUNIT_ASSERT_THROW(sort(40, 1024, "capped.dat"), common::MemoryException);
+}
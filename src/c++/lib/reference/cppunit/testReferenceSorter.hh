@@ -0,0 +1,44 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_REFERENCE_TEST_REFERENCE_SORTER_HH
+#define iSAAC_REFERENCE_TEST_REFERENCE_SORTER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+class TestReferenceSorter : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestReferenceSorter );
+    CPPUNIT_TEST( testMemoryLimit );
+    CPPUNIT_TEST( testMemoryLimitTooLow );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path xmlPath_;
+    boost::filesystem::path neighborsPath_;
+
+public:
+    TestReferenceSorter();
+    void setUp();
+    void tearDown();
+
+    void testMemoryLimit();
+    void testMemoryLimitTooLow();
+
+private:
+    std::string sort(const unsigned repeatThreshold, const uint64_t memoryLimit, const std::string &name) const;
+};
+
+#endif // #ifndef iSAAC_REFERENCE_TEST_REFERENCE_SORTER_HH
@@ -33,6 +33,7 @@
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
 #include "common/FileSystem.hh"
+#include "common/StageCounters.hh"
 #include "flowcell/Layout.hh"
 #include "flowcell/ReadMetadata.hh"
 #include "reference/ContigLoader.hh"
@@ -101,14 +102,17 @@ AlignWorkflow::AlignWorkflow(
     const int gapExtendScore,
     const int minGapExtendScore,
     const unsigned splitGapLength,
+    const unsigned smithWatermanBandWidth,
     const alignment::TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore,
     const unsigned inputLoadersMax,
+    const bool parallelGzip,
     const unsigned tempSaversMax,
     const unsigned tempLoadersMax,
     const unsigned outputSaversMax,
     const build::GapRealignerMode realignGaps,
     const boost::filesystem::path &knownIndelsPath,
     const int bamGzipLevel,
+    const bgzf::DeflateBackend bamDeflateBackend,
     const std::string &bamPuFormat,
     const bool bamProduceMd5,
     const std::vector<std::string> &bamHeaderTags,
@@ -117,16 +121,22 @@ AlignWorkflow::AlignWorkflow(
     const bool keepDuplicates,
     const bool markDuplicates,
     const bool anchorMate,
+    const build::DuplicateGroupingMode duplicateGrouping,
     const std::string &binRegexString,
     const common::ScopedMallocBlock::Mode memoryControl,
     const std::vector<std::size_t> &clusterIdList,
     const alignment::TemplateLengthStatistics &userTemplateLengthStatistics,
     const reports::AlignmentReportGenerator::ImageFileFormat statsImageFormat,
     const bool bufferBins,
+    const bool referenceHashCache,
+    const bool referenceHashNumaReplicas,
+    const bool annotationCache,
+    const bool annotationNumaReplicas,
     const bool qScoreBin,
     const boost::array<char, 256> &fullBclQScoreTable,
     const OptionalFeatures optionalFeatures,
-    const bool pessimisticMapQ)
+    const bool pessimisticMapQ,
+    const bool pipelineBuild)
     : argv_(argv)
     , description_(description)
     , flowcellLayoutList_(flowcellLayoutList)
@@ -179,14 +189,17 @@ AlignWorkflow::AlignWorkflow(
     , gapExtendScore_(gapExtendScore)
     , minGapExtendScore_(minGapExtendScore)
     , splitGapLength_(splitGapLength)
+    , smithWatermanBandWidth_(smithWatermanBandWidth)
     , dodgyAlignmentScore_(dodgyAlignmentScore)
     , inputLoadersMax_(inputLoadersMax)
+    , parallelGzip_(parallelGzip)
     , tempSaversMax_(tempSaversMax)
     , tempLoadersMax_(tempLoadersMax)
     , outputSaversMax_(outputSaversMax)
     , realignGaps_(realignGaps)
     , knownIndelsPath_(knownIndelsPath)
     , bamGzipLevel_(bamGzipLevel)
+    , bamDeflateBackend_(bamDeflateBackend)
     , bamPuFormat_(bamPuFormat)
     , bamProduceMd5_(bamProduceMd5)
     , bamHeaderTags_(bamHeaderTags)
@@ -195,11 +208,17 @@ AlignWorkflow::AlignWorkflow(
     , keepDuplicates_(keepDuplicates)
     , markDuplicates_(markDuplicates)
     , anchorMate_(anchorMate)
+    , duplicateGrouping_(duplicateGrouping)
     , bufferBins_(bufferBins)
+    , referenceHashCache_(referenceHashCache)
+    , referenceHashNumaReplicas_(referenceHashNumaReplicas)
+    , annotationCache_(annotationCache)
+    , annotationNumaReplicas_(annotationNumaReplicas)
     , qScoreBin_(qScoreBin)
     , fullBclQScoreTable_(fullBclQScoreTable)
     , optionalFeatures_(optionalFeatures)
     , pessimisticMapQ_(pessimisticMapQ)
+    , pipelineBuild_(pipelineBuild)
     , binRegexString_(binRegexString)
     , memoryControl_(memoryControl)
     , userTemplateLengthStatistics_(userTemplateLengthStatistics)
@@ -208,11 +227,13 @@ AlignWorkflow::AlignWorkflow(
     , referenceMetadataList_(referenceMetadataList)
     , sortedReferenceMetadataList_(loadSortedReferenceXml(seedLength, referenceMetadataList))
     , contigLists_(reference::loadContigs(sortedReferenceMetadataList_, AllowAllContigFilter(), common::ThreadVector(inputLoadersMax_)))
-    , kUniquenessAnnotations_(reference::loadAnnotations(sortedReferenceMetadataList_))
+    , kUniquenessAnnotations_(
+        reference::loadAnnotations(sortedReferenceMetadataList_, annotationCache_), annotationNumaReplicas_)
     , state_(Start)
       // dummy initialization. Will be replaced with real object once match finding is over
     , foundMatchesMetadata_(tempDirectory_, barcodeMetadataList_, 0, sortedReferenceMetadataList_)
     , barcodeTemplateLengthStatistics_(barcodeMetadataList_.size())
+    , bamGeneratedWithAlignment_(false)
 {
     const std::vector<bfs::path> createList = boost::assign::list_of
         (tempDirectory_)(outputDirectory)(statsDirectory_)(reportsDirectory_)(projectsDirectory_);
@@ -238,11 +259,24 @@ reference::SortedReferenceMetadataList AlignWorkflow::loadSortedReferenceXml(
     return ret;
 }
 
+/**
+ * \brief Memory the bins can have once Build has allocated its fixed buffers
+ */
+uint64_t AlignWorkflow::getBinMemory() const
+{
+    const uint64_t buildBuffersMemory = build::Build::getBuffersMemoryRequirements(
+        tempLoadersMax_, coresMax_, outputSaversMax_,
+        build::mapBarcodesToFiles(projectsDirectory_, barcodeMetadataList_).getTotalSamples());
+    return availableMemory_ > buildBuffersMemory ? availableMemory_ - buildBuffersMemory : 0;
+}
+
 void AlignWorkflow::findMatches(
     alignWorkflow::FoundMatchesMetadata &foundMatches,
     alignment::BinMetadataList &binMetadataList,
-    std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics) const
+    std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
+    build::BinQueue *binQueue) const
 {
+    common::StageCounters::reset();
     alignWorkflow::FindHashMatchesTransition findMatchesTransition(
         flowcellLayoutList_,
         barcodeMetadataList_,
@@ -250,7 +284,7 @@ void AlignWorkflow::findMatches(
         bclTilesPerChunk_,
         ignoreMissingBcls_,
         ignoreMissingFilters_,
-        availableMemory_,
+        getBinMemory(),
         clustersAtATimeMax_,
         tempDirectory_,
         demultiplexingStatsXmlPath_,
@@ -261,6 +295,7 @@ void AlignWorkflow::findMatches(
         ignoreNeighbors_,
         ignoreRepeats_,
         inputLoadersMax_,
+        parallelGzip_,
         tempSaversMax_,
         memoryControl_,
         clusterIdList_,
@@ -274,17 +309,20 @@ void AlignWorkflow::findMatches(
         baseQualityCutoff_,
         keepUnaligned_, clipSemialigned_, clipOverlapping_,
         scatterRepeats_, rescueShadows_, anchorMate_, gappedMismatchesMax_, smitWatermanGapsMax_, smartSmithWaterman_, noSmithWaterman_, splitAlignments_,
-        gapMatchScore_, gapMismatchScore_, gapOpenScore_, gapExtendScore_, minGapExtendScore_, splitGapLength_,
+        gapMatchScore_, gapMismatchScore_, gapOpenScore_, gapExtendScore_, minGapExtendScore_, splitGapLength_, smithWatermanBandWidth_,
         dodgyAlignmentScore_,
         qScoreBin_,
         fullBclQScoreTable_,
         bufferBins_,
+        referenceHashCache_ ? referenceMetadataList_.front().getXmlPath().parent_path() : bfs::path(),
+        referenceHashNumaReplicas_,
         expectedCoverage_,
         targetBinSize_,
         expectedBgzfCompressionRatio_,
         preSortBins_,
         preAllocateBins_,
-        binRegexString_);
+        binRegexString_,
+        binQueue);
 
     if (16 == seedLength_)
     {
@@ -319,6 +357,8 @@ void AlignWorkflow::findMatches(
     {
         ISAAC_ASSERT_MSG(false, "Unexpected seed length " << seedLength_);
     }
+    common::StageCounters::save(
+        "align", statsDirectory_ / "AlignmentStages.json", statsDirectory_ / "AlignmentStages.prom");
 }
 
 void AlignWorkflow::cleanupBins() const
@@ -345,9 +385,15 @@ void AlignWorkflow::generateAlignmentReports() const
 
 const build::BarcodeBamMapping AlignWorkflow::generateBam(
     const SelectedMatchesMetadata &binPaths,
-    const std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics) const
+    const std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
+    build::BinQueue *binQueue) const
 {
     ISAAC_THREAD_CERR << "Generating the BAM files" << std::endl;
+    if (!binQueue)
+    {
+        // alignment counts its stages at the same time otherwise
+        common::StageCounters::reset();
+    }
 
     build::Build build(argv_, description_,
                        flowcellLayoutList_, foundMatchesMetadata_.tileMetadataList_, barcodeMetadataList_,
@@ -359,8 +405,8 @@ const build::BarcodeBamMapping AlignWorkflow::generateBam(
                        kUniquenessAnnotations_,
                        projectsDirectory_,
                        tempLoadersMax_, coresMax_, outputSaversMax_, realignGaps_, knownIndelsPath_,
-                       bamGzipLevel_, bamPuFormat_, bamProduceMd5_, bamHeaderTags_, expectedBgzfCompressionRatio_, singleLibrarySamples_,
-                       keepDuplicates_, markDuplicates_, anchorMate_,
+                       bamGzipLevel_, bamDeflateBackend_, bamPuFormat_, bamProduceMd5_, bamHeaderTags_, expectedBgzfCompressionRatio_, singleLibrarySamples_,
+                       keepDuplicates_, markDuplicates_, anchorMate_, duplicateGrouping_,
                        realignGapsVigorously_, realignDodgyFragments_, realignedGapsPerFragment_,
                        clipSemialigned_, 
                        // when splitting reads, the bin regex cannot be used to decide which 
@@ -378,16 +424,50 @@ const build::BarcodeBamMapping AlignWorkflow::generateBam(
                            optionalFeatures_ & BamSM,
                            optionalFeatures_ & BamZX,
                            optionalFeatures_ & BamZY),
-                       pessimisticMapQ_, splitGapLength_);
+                       pessimisticMapQ_, splitGapLength_, binQueue);
     {
         common::ScopedMallocBlock  mallocBlock(memoryControl_);
         build.run(mallocBlock);
     }
     build.dumpStats(statsDirectory_ / "BuildStats.xml");
+    common::StageCounters::save(
+        "build", statsDirectory_ / "BuildStages.json", statsDirectory_ / "BuildStages.prom");
     ISAAC_THREAD_CERR << "Generating the BAM files done" << std::endl;
     return build.getBarcodeBamMapping();
 }
 
+/**
+ * \brief Runs Build alongside alignment. Build takes the bins as soon as the lanes storing into them are done
+ *        and gets the memory alignment does not hold.
+ */
+void AlignWorkflow::findMatchesAndGenerateBam()
+{
+    build::BinQueue binQueue(getBinMemory());
+    common::ThreadVector threads(2);
+    threads.execute(
+        [this, &binQueue](const unsigned threadNumber, const unsigned threadsTotal)
+        {
+            if (!threadNumber)
+            {
+                try
+                {
+                    findMatches(foundMatchesMetadata_, selectedMatchesMetadata_, barcodeTemplateLengthStatistics_, &binQueue);
+                }
+                catch (...)
+                {
+                    binQueue.terminate();
+                    throw;
+                }
+                binQueue.close(foundMatchesMetadata_.tileMetadataList_);
+            }
+            else
+            {
+                barcodeBamMapping_ = generateBam(binQueue.waitOpen(), barcodeTemplateLengthStatistics_, &binQueue);
+            }
+        });
+    bamGeneratedWithAlignment_ = true;
+}
+
 void AlignWorkflow::run()
 {
     ISAAC_ASSERT_MSG(Start == state_, "Unexpected state");
@@ -434,7 +514,14 @@ AlignWorkflow::State AlignWorkflow::step()
     {
     case Start:
     {
-        findMatches(foundMatchesMetadata_, selectedMatchesMetadata_, barcodeTemplateLengthStatistics_);
+        if (pipelineBuild_)
+        {
+            findMatchesAndGenerateBam();
+        }
+        else
+        {
+            findMatches(foundMatchesMetadata_, selectedMatchesMetadata_, barcodeTemplateLengthStatistics_, 0);
+        }
         state_ = getNextState();
         break;
     }
@@ -446,7 +533,10 @@ AlignWorkflow::State AlignWorkflow::step()
     }
     case AlignmentReportsDone:
     {
-        barcodeBamMapping_ = generateBam(selectedMatchesMetadata_, barcodeTemplateLengthStatistics_);
+        if (!bamGeneratedWithAlignment_)
+        {
+            barcodeBamMapping_ = generateBam(selectedMatchesMetadata_, barcodeTemplateLengthStatistics_, 0);
+        }
         state_ = getNextState();
         break;
     }
@@ -493,6 +583,8 @@ void AlignWorkflow::cleanupIntermediary()
 AlignWorkflow::State AlignWorkflow::rewind(AlignWorkflow::State to)
 {
     AlignWorkflow::State ret = state_;
+    // the steps after the rewind target run again
+    bamGeneratedWithAlignment_ = false;
     switch (to)
     {
     case Last:
@@ -0,0 +1,865 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchWorkflow.cpp
+ **
+ ** \brief see BenchWorkflow.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <boost/format.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/tuple/tuple.hpp>
+
+#include "alignment/BandedSmithWaterman.hh"
+#include "alignment/HashMatchFinder.hh"
+#include "alignment/MatchDistribution.hh"
+#include "alignment/TemplateBuilder.hh"
+#include "alignment/fragmentBuilder/UngappedAligner.hh"
+#include "alignment/matchSelector/FragmentBinner.hh"
+#include "alignment/matchSelector/FragmentSequencingAdapterClipper.hh"
+#include "bam/Bam.hh"
+#include "bam/BamEncoder.hh"
+#include "bam/BamIndexer.hh"
+#include "bam/BgzfBlockPool.hh"
+#include "bgzf/BgzfCompressor.hh"
+#include "bgzf/BgzfDeflater.hh"
+#include "build/BarcodeBamMapping.hh"
+#include "build/BinData.hh"
+#include "build/BinLoader.hh"
+#include "build/BinSorter.hh"
+#include "build/BuildContigMap.hh"
+#include "build/BuildStats.hh"
+#include "build/gapRealigner/Gap.hh"
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/FileSystem.hh"
+#include "common/ParallelFor.hh"
+#include "common/Program.hh"
+#include "common/StageCounters.hh"
+#include "io/AsyncFileIo.hh"
+#include "io/BamLoader.hh"
+#include "io/FastqReader.hh"
+#include "oligo/Nucleotides.hh"
+#include "workflow/BenchWorkflow.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+
+static const uint64_t CHECKSUM_INIT = 0xcbf29ce484222325UL;
+static const unsigned SEED_LENGTH = 8;
+static const unsigned SEED_STEP = 32;
+static const unsigned REPEAT_THRESHOLD = 10;
+static const unsigned SPLIT_GAP_LENGTH = 10000;
+static const unsigned BGZF_BLOCKS = 64;
+// same allowance Build makes for the bgzf blocks of an empty bin
+static const uint64_t EMPTY_BGZF_BLOCK_SIZE = 1234UL;
+// per mille
+static const unsigned DUPLICATE_RATE = 20;
+static const unsigned SUBSTITUTION_RATE = 5;
+// one in so many reads has a deletion
+static const unsigned DELETION_EVERY = 20;
+static const unsigned DELETION_LENGTH = 2;
+
+static const int MATCH_SCORE = 2;
+static const int MISMATCH_SCORE = -1;
+static const int GAP_OPEN_SCORE = -15;
+static const int GAP_EXTEND_SCORE = -3;
+static const int MIN_GAP_EXTEND_SCORE = 25;
+
+static uint64_t fold(const uint64_t checksum, const uint64_t value)
+{
+    return (checksum ^ value) * 0x100000001b3UL;
+}
+
+static double seconds(const uint64_t nanoseconds)
+{
+    return nanoseconds / 1000000000.0;
+}
+
+static char randomBase(unsigned &state)
+{
+    return "ACGT"[rand_r(&state) % 4];
+}
+
+static reference::ContigLists generateContigs(
+    const unsigned seed, const uint64_t referenceLength, const unsigned contigsCount)
+{
+    unsigned state = seed;
+    reference::ContigList contigList;
+    for (unsigned i = 0; contigsCount != i; ++i)
+    {
+        reference::Contig contig(i, (boost::format("bench%d") % i).str());
+        contig.reserve(referenceLength / contigsCount);
+        for (uint64_t pos = 0; referenceLength / contigsCount != pos; ++pos)
+        {
+            contig.push_back(randomBase(state));
+        }
+        contigList.push_back(contig);
+    }
+    return reference::ContigLists(1, contigList);
+}
+
+/**
+ * \brief k-uniqueness of 1 everywhere makes all alignments well anchored. Random sequence of this size
+ *        is close enough to that.
+ */
+static reference::ContigAnnotationsList generateAnnotations(const reference::ContigList &contigList)
+{
+    reference::ContigAnnotations contigAnnotations(contigList.size());
+    for (std::size_t i = 0; contigList.size() != i; ++i)
+    {
+        contigAnnotations[i].resize(contigList[i].size(), std::make_pair<ushort, ushort>(1, 1));
+    }
+    return reference::ContigAnnotationsList(1, contigAnnotations);
+}
+
+static reference::SortedReferenceMetadataList generateSortedReference(const reference::ContigList &contigList)
+{
+    reference::SortedReferenceMetadata sortedReferenceMetadata;
+    uint64_t genomicOffset = 0;
+    for (const reference::Contig &contig : contigList)
+    {
+        sortedReferenceMetadata.putContig(
+            genomicOffset, contig.name_, "bench.fa", 0, contig.size(), contig.size(), contig.size(),
+            contig.index_, contig.index_, "", "", "");
+        genomicOffset += contig.size();
+    }
+    return reference::SortedReferenceMetadataList(1, sortedReferenceMetadata);
+}
+
+static flowcell::ReadMetadataList makeReadMetadataList(const unsigned readLength)
+{
+    flowcell::ReadMetadataList ret;
+    ret.push_back(flowcell::ReadMetadata(1, readLength, 0, 0));
+    ret.push_back(flowcell::ReadMetadata(readLength + 1, readLength * 2, 1, readLength));
+    return ret;
+}
+
+static alignment::SeedMetadataList makeSeedMetadataList(const flowcell::ReadMetadataList &readMetadataList)
+{
+    alignment::SeedMetadataList ret;
+    for (const flowcell::ReadMetadata &readMetadata : readMetadataList)
+    {
+        for (unsigned offset = 0; readMetadata.getLength() >= offset + SEED_LENGTH; offset += SEED_STEP)
+        {
+            ret.push_back(alignment::SeedMetadata(offset, SEED_LENGTH, readMetadata.getIndex(), ret.size()));
+        }
+    }
+    return ret;
+}
+
+static flowcell::BarcodeMetadataList makeBarcodeMetadataList()
+{
+    flowcell::BarcodeMetadataList ret(1, flowcell::BarcodeMetadata::constructNoIndexBarcode(
+        "bench", 0, 1, 0, flowcell::SequencingAdapterMetadataList()));
+    ret.front().setIndex(0);
+    return ret;
+}
+
+/**
+ * \brief Enough of SortedReferenceXmlBamHeaderAdapter to produce the bam header for the synthetic reference
+ */
+class BenchBamHeader
+{
+    const reference::SortedReferenceMetadata &sortedReferenceMetadata_;
+public:
+    explicit BenchBamHeader(const reference::SortedReferenceMetadata &sortedReferenceMetadata) :
+        sortedReferenceMetadata_(sortedReferenceMetadata)
+    {
+    }
+
+    struct RefSeqType : public reference::SortedReferenceMetadata::Contig
+    {
+        RefSeqType(const reference::SortedReferenceMetadata::Contig &contig) :
+            reference::SortedReferenceMetadata::Contig(contig)
+        {
+        }
+        const std::string &name() const {return name_;}
+        uint64_t length() const {return totalBases_;}
+        const std::string &bamSqAs() const {return bamSqAs_;}
+        const std::string &bamSqUr() const {return bamSqUr_;}
+        const std::string &bamM5() const {return bamM5_;}
+    };
+    typedef std::vector<RefSeqType> RefSeqsType;
+
+    struct ReadGroupType
+    {
+        std::string getValue() const {return std::string();}
+    };
+
+    RefSeqsType getRefSequences() const
+    {
+        const reference::SortedReferenceMetadata::Contigs contigs = sortedReferenceMetadata_.getKaryotypeOrderedContigs();
+        return RefSeqsType(contigs.begin(), contigs.end());
+    }
+
+    std::vector<ReadGroupType> getReadGroups(const std::string &) const
+    {
+        return std::vector<ReadGroupType>();
+    }
+};
+
+BenchWorkflow::BenchWorkflow(
+    const bfs::path &tempDirectory,
+    const bfs::path &outputFile,
+    const unsigned threads,
+    const unsigned seed,
+    const unsigned repeats,
+    const uint64_t referenceLength,
+    const unsigned contigs,
+    const unsigned clusters,
+    const unsigned readLength,
+    const unsigned bamGzipLevel)
+    : tempDirectory_(tempDirectory)
+    , outputFile_(outputFile)
+    , threadsCount_(threads)
+    , seed_(seed)
+    , repeats_(repeats)
+    , referenceLength_(referenceLength)
+    , contigsCount_(contigs)
+    , clustersCount_(clusters)
+    , readLength_(readLength)
+    , bamGzipLevel_(bamGzipLevel)
+    , fastqPaths_{tempDirectory / "bench-R1.fastq", tempDirectory / "bench-R2.fastq"}
+    , bamPath_(tempDirectory / "bench.bam")
+    , threads_(threads)
+    , readMetadataList_(makeReadMetadataList(readLength))
+    , seedMetadataList_(makeSeedMetadataList(readMetadataList_))
+    , flowcellLayoutList_(1, flowcell::Layout(
+        "", flowcell::Layout::Fastq, flowcell::FastqFlowcellData(false, '!', false), 8, 0, std::vector<unsigned>(),
+        readMetadataList_, seedMetadataList_, "bench"))
+    , tileMetadataList_(std::vector<flowcell::TileMetadata>(1, flowcell::TileMetadata("bench", 0, 0, 1, clusters, 0)))
+    , barcodeMetadataList_(makeBarcodeMetadataList())
+    , contigLists_(generateContigs(seed, referenceLength, contigs))
+    , contigList_(contigLists_.node0Container().front())
+    , annotations_(generateAnnotations(contigList_))
+    , contigAnnotations_(annotations_.node0Container().front())
+    , sortedReferenceMetadataList_(generateSortedReference(contigList_))
+    , binIndexMap_(
+        alignment::EstimatedMatchDistribution(
+            std::max<uint64_t>(1, uint64_t(clusters) * readLength * 2 / referenceLength), readLength, sortedReferenceMetadataList_),
+        std::max(1U, clusters * 2 / 16), false)
+    , alignmentCfg_(MATCH_SCORE, MISMATCH_SCORE, GAP_OPEN_SCORE, GAP_EXTEND_SCORE, MIN_GAP_EXTEND_SCORE,
+                    SPLIT_GAP_LENGTH, alignment::BandedSmithWaterman::WIDEST_GAP_SIZE)
+    , templateLengthStatistics_(
+        readLength * 2, readLength * 3, readLength * 5 / 2, readLength / 6, readLength / 6,
+        alignment::TemplateLengthStatistics::FRp, alignment::TemplateLengthStatistics::RFm, -1, true)
+    , bclClusters_(readLength * 2)
+    , clusters_(clusters, alignment::Cluster(readLength))
+{
+}
+
+void BenchWorkflow::run()
+{
+    common::createDirectories(std::vector<bfs::path>(1, tempDirectory_));
+    ISAAC_THREAD_CERR << "Generating " << clustersCount_ << " read pairs in " << tempDirectory_ << std::endl;
+    generateReads();
+
+    Results best;
+    for (unsigned repeat = 0; repeats_ != repeat; ++repeat)
+    {
+        Results results;
+        runEngines(results);
+        if (best.empty())
+        {
+            best = results;
+        }
+        for (std::size_t i = 0; results.size() != i; ++i)
+        {
+            ISAAC_ASSERT_MSG(best[i].checksum_ == results[i].checksum_,
+                             "Results differ between the runs for " << results[i].name_);
+            best[i].seconds_ = std::min(best[i].seconds_, results[i].seconds_);
+        }
+        ISAAC_THREAD_CERR << "Benchmark run " << repeat + 1 << " of " << repeats_ << " done" << std::endl;
+    }
+
+    if (outputFile_.empty())
+    {
+        printResults(std::cout, best);
+    }
+    else
+    {
+        std::ofstream os(outputFile_.string().c_str());
+        if (!os)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "ERROR: Unable to open file for writing: " + outputFile_.string()));
+        }
+        printResults(os, best);
+        if (!os)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "ERROR: Unable to write into " + outputFile_.string()));
+        }
+    }
+}
+
+/**
+ * \brief Pairs come from templates of 2 to 3 read lengths. Half of them are FR+ and half are RF-. Some clusters
+ *        repeat an earlier template to give duplicate filtering something to do. Some reads have a short deletion
+ *        for Smith-Waterman to find.
+ */
+void BenchWorkflow::generateReads()
+{
+    unsigned state = seed_ + 1;
+    reads_.clear();
+    reads_.reserve(clustersCount_ * 2);
+    std::string fastq[2];
+    for (unsigned cluster = 0; clustersCount_ != cluster; ++cluster)
+    {
+        if (cluster && unsigned(rand_r(&state) % 1000) < DUPLICATE_RATE)
+        {
+            const unsigned original = rand_r(&state) % cluster;
+            reads_.push_back(reads_[original * 2]);
+            reads_.push_back(reads_[original * 2 + 1]);
+        }
+        else
+        {
+            const unsigned contigId = rand_r(&state) % contigList_.size();
+            const uint64_t templateLength = readLength_ * 2 + rand_r(&state) % readLength_;
+            const int64_t position = rand_r(&state) % (contigList_[contigId].size() - templateLength - DELETION_LENGTH);
+            const bool swapped = rand_r(&state) % 2;
+            for (unsigned read = 0; 2 != read; ++read)
+            {
+                SyntheticRead r;
+                r.contigId_ = contigId;
+                r.reverse_ = swapped ? !read : read;
+                r.position_ = r.reverse_ ? position + templateLength - readLength_ : position;
+                reads_.push_back(r);
+            }
+        }
+
+        for (unsigned read = 0; 2 != read; ++read)
+        {
+            SyntheticRead &r = reads_[cluster * 2 + read];
+            const reference::Contig &contig = contigList_[r.contigId_];
+            const bool deletion = !(rand_r(&state) % DELETION_EVERY);
+            r.forward_.clear();
+            for (unsigned offset = 0; readLength_ != offset; ++offset)
+            {
+                r.forward_.push_back(contig[r.position_ + offset + (deletion && offset >= readLength_ / 2 ? DELETION_LENGTH : 0)]);
+            }
+
+            std::string sequence(r.forward_.begin(), r.forward_.end());
+            if (r.reverse_)
+            {
+                std::reverse(sequence.begin(), sequence.end());
+                std::transform(sequence.begin(), sequence.end(), sequence.begin(), &oligo::reverseBase);
+            }
+            std::string quality(readLength_, '?');
+            for (unsigned offset = 0; readLength_ != offset; ++offset)
+            {
+                if (unsigned(rand_r(&state) % 1000) < SUBSTITUTION_RATE)
+                {
+                    const char *bases = "ACGT";
+                    const unsigned base = std::strchr(bases, sequence[offset]) - bases;
+                    sequence[offset] = bases[(base + 1 + rand_r(&state) % 3) % 4];
+                    quality[offset] = '+';
+                }
+            }
+
+            fastq[read] += (boost::format("@bench:%d/%d\n") % cluster % (read + 1)).str();
+            fastq[read] += sequence;
+            fastq[read] += "\n+\n";
+            fastq[read] += quality;
+            fastq[read] += "\n";
+        }
+    }
+
+    for (unsigned read = 0; 2 != read; ++read)
+    {
+        std::ofstream os(fastqPaths_[read].string().c_str());
+        if (!os)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "ERROR: Unable to open file for writing: " + fastqPaths_[read].string()));
+        }
+        if (!os.write(fastq[read].c_str(), fastq[read].size()))
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "ERROR: Unable to write into " + fastqPaths_[read].string()));
+        }
+    }
+    fastq0_.swap(fastq[0]);
+}
+
+void BenchWorkflow::runEngines(Results &results)
+{
+    results.clear();
+    results.push_back(Result("reference_hasher"));
+    results.push_back(Result("fastq_reader"));
+    results.push_back(Result("bgzf_compressor"));
+    results.push_back(Result("seed_hash_match_finder"));
+    results.push_back(Result("ungapped_aligner"));
+    results.push_back(Result("banded_smith_waterman"));
+    results.push_back(Result("banded_smith_waterman_batch"));
+    results.push_back(Result("template_builder"));
+    results.push_back(Result("fragment_binner"));
+    results.push_back(Result("bin_sorter"));
+    results.push_back(Result("bam_loader"));
+
+    const uint64_t start = common::StageCounters::now();
+    Results::iterator result = results.begin();
+    hashReference(*result++);
+    loadFastq(*result++);
+    compressFastq(*result++);
+    findSeedMatches(*result++);
+    alignUngapped(*result++);
+    Result &single = *result++;
+    alignSmithWaterman(single, *result++);
+    buildTemplates(*result++);
+    binFragments(*result++);
+    sortBins(*result++);
+    loadBam(*result++);
+
+    Result endToEnd("end_to_end");
+    endToEnd.items_ = clustersCount_;
+    endToEnd.seconds_ = seconds(common::StageCounters::now() - start);
+    endToEnd.checksum_ = CHECKSUM_INIT;
+    for (const Result &r : results)
+    {
+        endToEnd.checksum_ = fold(endToEnd.checksum_, r.checksum_);
+    }
+    results.push_back(endToEnd);
+}
+
+void BenchWorkflow::hashReference(Result &result)
+{
+    referenceHash_.reset();
+    const uint64_t start = common::StageCounters::now();
+    reference::ReferenceHasher<ReferenceHashT> hasher(
+        sortedReferenceMetadataList_.front(), contigList_, threads_, threadsCount_);
+    referenceHash_.reset(new ReferenceHashT(hasher.generate()));
+    result.seconds_ = seconds(common::StageCounters::now() - start);
+    result.items_ = reference::genomeLength(contigList_);
+
+    result.checksum_ = fold(CHECKSUM_INIT, referenceHash_->positionsCount());
+    const std::size_t step = std::max<std::size_t>(1, referenceHash_->offsetsCount() / 4096);
+    for (std::size_t i = 0; referenceHash_->offsetsCount() > i; i += step)
+    {
+        result.checksum_ = fold(result.checksum_, referenceHash_->offsetsData()[i]);
+    }
+}
+
+void BenchWorkflow::loadFastq(Result &result)
+{
+    bclClusters_.reset(readLength_ * 2, clustersCount_);
+    const uint64_t start = common::StageCounters::now();
+    for (unsigned read = 0; 2 != read; ++read)
+    {
+        const flowcell::ReadMetadata &readMetadata = readMetadataList_[read];
+        io::FastqReader reader(false, 1, false, fastqPaths_[read].string().size());
+        reader.open(fastqPaths_[read], '!');
+        for (std::size_t cluster = 0; reader.hasData(); ++cluster)
+        {
+            ISAAC_ASSERT_MSG(clustersCount_ > cluster, "Too many records in " << fastqPaths_[read]);
+            reader.extractBcl(readMetadata, bclClusters_.cluster(cluster) + readMetadata.getOffset());
+            reader.next();
+        }
+    }
+    result.seconds_ = seconds(common::StageCounters::now() - start);
+    result.items_ = clustersCount_ * 2;
+
+    result.checksum_ = CHECKSUM_INIT;
+    for (std::size_t cluster = 0; clustersCount_ != cluster; ++cluster)
+    {
+        clusters_[cluster].init(readMetadataList_, bclClusters_.cluster(cluster), 0, cluster, alignment::ClusterXy(0, 0), true, 0, 0);
+        result.checksum_ = fold(result.checksum_, *bclClusters_.cluster(cluster));
+    }
+}
+
+void BenchWorkflow::compressFastq(Result &result)
+{
+    std::vector<char> compressed;
+    compressed.reserve(fastq0_.size());
+    const uint64_t start = common::StageCounters::now();
+    {
+        boost::iostreams::filtering_ostream bgzfStream;
+        bgzfStream.push(bgzf::BgzfCompressor(bamGzipLevel_));
+        bgzfStream.push(boost::iostreams::back_inserter(compressed));
+        bgzfStream.write(fastq0_.c_str(), fastq0_.size());
+        bgzfStream.strict_sync();
+    }
+    result.seconds_ = seconds(common::StageCounters::now() - start);
+    result.items_ = fastq0_.size();
+    result.checksum_ = fold(CHECKSUM_INIT, compressed.size());
+}
+
+void BenchWorkflow::findSeedMatches(Result &result)
+{
+    const alignment::ClusterHashMatchFinder<ReferenceHashT> matchFinder(
+        *referenceHash_, 0, REPEAT_THRESHOLD, seedMetadataList_);
+    alignment::Matches matches;
+    matches.reserve(seedMetadataList_.size() * REPEAT_THRESHOLD);
+    result.checksum_ = CHECKSUM_INIT;
+    uint64_t nanoseconds = 0;
+    for (const alignment::Cluster &cluster : clusters_)
+    {
+        matches.clear();
+        const uint64_t start = common::StageCounters::now();
+        matchFinder.findClusterMatches(cluster, readMetadataList_, matches);
+        nanoseconds += common::StageCounters::now() - start;
+        for (const alignment::Match &match : matches)
+        {
+            result.checksum_ = fold(result.checksum_, match.location_.getValue());
+        }
+    }
+    result.seconds_ = seconds(nanoseconds);
+    result.items_ = clusters_.size() * seedMetadataList_.size();
+}
+
+/**
+ * \brief Places each read where it was sampled from, the way a seed match would have placed it.
+ */
+void BenchWorkflow::alignUngapped(Result &result)
+{
+    const alignment::matchSelector::SequencingAdapterList sequencingAdapters;
+    const alignment::fragmentBuilder::UngappedAligner aligner(false, alignmentCfg_);
+    fragments_.clear();
+    fragments_.reserve(reads_.size());
+    cigarBuffer_.clear();
+    cigarBuffer_.reserve(alignment::Cigar::getMaxOpeations(readLength_) * reads_.size());
+    result.checksum_ = CHECKSUM_INIT;
+    uint64_t nanoseconds = 0;
+    for (std::size_t i = 0; reads_.size() != i; ++i)
+    {
+        const SyntheticRead &read = reads_[i];
+        const flowcell::ReadMetadata &readMetadata = readMetadataList_[i % 2];
+        const reference::Contig &contig = contigList_[read.contigId_];
+        const uint64_t start = common::StageCounters::now();
+        alignment::FragmentMetadata fragment(&clusters_[i / 2], readMetadata.getIndex(), 0, 0, read.reverse_, read.contigId_, read.position_);
+        const alignment::SeedMetadata &seedMetadata = *std::find_if(
+            seedMetadataList_.begin(), seedMetadataList_.end(),
+            [&readMetadata](const alignment::SeedMetadata &s){return s.getReadIndex() == readMetadata.getIndex();});
+        fragment.setSeedAnchor(readMetadata, seedMetadata, alignment::SeedId(SEED_LENGTH, read.reverse_));
+        alignment::matchSelector::FragmentSequencingAdapterClipper adapterClipper(sequencingAdapters);
+        adapterClipper.checkInitStrand(fragment, contig);
+        aligner.alignUngapped(fragment, cigarBuffer_, readMetadata, adapterClipper, contigList_, contigAnnotations_);
+        nanoseconds += common::StageCounters::now() - start;
+        fragments_.push_back(fragment);
+        result.checksum_ = fold(result.checksum_, fragment.getPosition());
+        result.checksum_ = fold(result.checksum_, fragment.getMismatchCount());
+        result.checksum_ = fold(result.checksum_, fragment.getCigarLength());
+    }
+    result.seconds_ = seconds(nanoseconds);
+    result.items_ = reads_.size();
+}
+
+/**
+ * \brief Gap-aligns every read in the band around its true position, one at a time and in batches of
+ *        BandedSmithWaterman::BATCH_SIZE. The two checksums must be the same.
+ */
+void BenchWorkflow::alignSmithWaterman(Result &single, Result &batch)
+{
+    const alignment::BandedSmithWaterman bandedSmithWaterman(
+        MATCH_SCORE, MISMATCH_SCORE, -GAP_OPEN_SCORE, -GAP_EXTEND_SCORE, readLength_,
+        alignment::BandedSmithWaterman::WIDEST_GAP_SIZE, true);
+    const unsigned widestGapSize = bandedSmithWaterman.getWidestGapSize();
+
+    std::vector<alignment::BandedSmithWaterman::BatchItem> items;
+    items.reserve(reads_.size());
+    for (std::size_t i = 0; reads_.size() != i; ++i)
+    {
+        const SyntheticRead &read = reads_[i];
+        const reference::Contig &contig = contigList_[read.contigId_];
+        if (read.position_ < widestGapSize / 2 ||
+            int64_t(contig.size()) < read.position_ + readLength_ + widestGapSize + DELETION_LENGTH)
+        {
+            continue;
+        }
+        const std::vector<char> &query = clusters_[i / 2][i % 2].getStrandSequence(read.reverse_);
+        alignment::BandedSmithWaterman::BatchItem item;
+        item.queryBegin = query.begin();
+        item.queryEnd = query.end();
+        item.databaseBegin = contig.begin() + read.position_ - widestGapSize / 2;
+        item.databaseEnd = item.databaseBegin + query.size() + widestGapSize - 1;
+        items.push_back(item);
+    }
+
+    alignment::Cigar cigar(alignment::Cigar::getMaxOpeations(readLength_));
+    single.checksum_ = CHECKSUM_INIT;
+    uint64_t nanoseconds = 0;
+    for (const alignment::BandedSmithWaterman::BatchItem &item : items)
+    {
+        cigar.clear();
+        const uint64_t start = common::StageCounters::now();
+        const unsigned offset = bandedSmithWaterman.align(item.queryBegin, item.queryEnd, item.databaseBegin, item.databaseEnd, cigar);
+        nanoseconds += common::StageCounters::now() - start;
+        single.checksum_ = fold(single.checksum_, offset);
+        for (const uint32_t component : cigar)
+        {
+            single.checksum_ = fold(single.checksum_, component);
+        }
+    }
+    single.seconds_ = seconds(nanoseconds);
+    single.items_ = items.size();
+
+    // copies of a Cigar don't keep its capacity, reserve each one in place
+    std::vector<alignment::Cigar> cigars(alignment::BandedSmithWaterman::BATCH_SIZE);
+    for (alignment::Cigar &batchCigar : cigars)
+    {
+        batchCigar.reserve(alignment::Cigar::getMaxOpeations(readLength_));
+    }
+    unsigned offsets[alignment::BandedSmithWaterman::BATCH_SIZE];
+    batch.checksum_ = CHECKSUM_INIT;
+    nanoseconds = 0;
+    for (std::size_t first = 0; items.size() > first; first += alignment::BandedSmithWaterman::BATCH_SIZE)
+    {
+        const unsigned count = std::min<std::size_t>(alignment::BandedSmithWaterman::BATCH_SIZE, items.size() - first);
+        for (unsigned i = 0; count != i; ++i)
+        {
+            cigars[i].clear();
+        }
+        const uint64_t start = common::StageCounters::now();
+        bandedSmithWaterman.alignBatch(&items[first], count, &cigars.front(), offsets);
+        nanoseconds += common::StageCounters::now() - start;
+        for (unsigned i = 0; count != i; ++i)
+        {
+            batch.checksum_ = fold(batch.checksum_, offsets[i]);
+            for (const uint32_t component : cigars[i])
+            {
+                batch.checksum_ = fold(batch.checksum_, component);
+            }
+        }
+    }
+    batch.seconds_ = seconds(nanoseconds);
+    batch.items_ = items.size();
+}
+
+void BenchWorkflow::buildTemplates(Result &result)
+{
+    const alignment::matchSelector::SequencingAdapterList sequencingAdapters;
+    const alignment::RestOfGenomeCorrection restOfGenomeCorrection(contigList_, readMetadataList_);
+    alignment::TemplateBuilder templateBuilder(
+        false, flowcellLayoutList_, REPEAT_THRESHOLD, seedMetadataList_.size() / 2, true, true, false, true, 5, 2,
+        false, false, false, MATCH_SCORE, MISMATCH_SCORE, GAP_OPEN_SCORE, GAP_EXTEND_SCORE, MIN_GAP_EXTEND_SCORE,
+        SPLIT_GAP_LENGTH, alignment::BandedSmithWaterman::WIDEST_GAP_SIZE,
+        alignment::TemplateBuilder::DODGY_ALIGNMENT_SCORE_UNALIGNED, true);
+
+    std::vector<alignment::FragmentMetadataList> fragments(2);
+    packedFragments_.clear();
+    result.checksum_ = CHECKSUM_INIT;
+    uint64_t nanoseconds = 0;
+    for (std::size_t cluster = 0; clusters_.size() != cluster; ++cluster)
+    {
+        for (unsigned read = 0; 2 != read; ++read)
+        {
+            fragments[read].clear();
+            if (fragments_[cluster * 2 + read].isAligned())
+            {
+                fragments[read].push_back(fragments_[cluster * 2 + read]);
+            }
+        }
+
+        const uint64_t start = common::StageCounters::now();
+        templateBuilder.buildTemplate(
+            contigList_, contigAnnotations_, restOfGenomeCorrection, readMetadataList_, sequencingAdapters,
+            fragments, clusters_[cluster], templateLengthStatistics_);
+        nanoseconds += common::StageCounters::now() - start;
+
+        const alignment::BamTemplate &bamTemplate = templateBuilder.getBamTemplate();
+        result.checksum_ = fold(result.checksum_, bamTemplate.getAlignmentScore());
+        for (unsigned read = 0; 2 != read; ++read)
+        {
+            result.checksum_ = fold(result.checksum_, bamTemplate.getFragmentMetadata(read).getPosition());
+            alignment::matchSelector::FragmentPacker::packPairedFragment(
+                bamTemplate, read, 0, binIndexMap_, std::back_inserter(packedFragments_));
+        }
+    }
+    result.seconds_ = seconds(nanoseconds);
+    result.items_ = clusters_.size();
+}
+
+void BenchWorkflow::binFragments(Result &result)
+{
+    binMetadataList_.clear();
+    for (unsigned i = 0; binIndexMap_.getTotalBins() != i; ++i)
+    {
+        const reference::ReferencePosition binStartPos = binIndexMap_.getBinFirstPos(i);
+        binMetadataList_.push_back(
+            alignment::BinMetadata(
+                barcodeMetadataList_.size(), i, binStartPos,
+                i ? binIndexMap_.getBinFirstInvalidPos(i) - binStartPos : clustersCount_ * 2,
+                tempDirectory_ / (boost::format("bench-bin-%08d.dat") % i).str(), 0));
+    }
+
+    const uint64_t start = common::StageCounters::now();
+    {
+        alignment::matchSelector::FragmentBinner binner(
+            false, binIndexMap_.getTotalBins(), binIndexMap_, binMetadataList_.size(), 0, 1);
+        binner.open(binMetadataList_.begin(), binMetadataList_.end());
+        for (std::vector<char>::const_iterator it = packedFragments_.begin(); packedFragments_.end() != it;)
+        {
+            const io::FragmentAccessor &fragment0 = reinterpret_cast<const io::FragmentAccessor&>(*it);
+            it += fragment0.getTotalLength();
+            const io::FragmentAccessor &fragment1 = reinterpret_cast<const io::FragmentAccessor&>(*it);
+            it += fragment1.getTotalLength();
+            binner.storePaired(fragment0, fragment1, 0);
+        }
+        binner.flushThreadBuffer(0);
+        binner.reclaimStorage(binMetadataList_.begin(), binMetadataList_.end());
+    }
+    result.seconds_ = seconds(common::StageCounters::now() - start);
+    result.items_ = clustersCount_ * 2;
+
+    result.checksum_ = CHECKSUM_INIT;
+    for (const alignment::BinMetadata &bin : binMetadataList_)
+    {
+        result.checksum_ = fold(result.checksum_, bin.getDataSize());
+    }
+}
+
+/**
+ * \brief Resolves duplicates and serializes the bins into a single bam file the same way isaac-align does,
+ *        except that everything happens on one thread.
+ */
+void BenchWorkflow::sortBins(Result &result)
+{
+    alignment::BinMetadataCRefList bins;
+    // unaligned bin goes last, same as in isaac-align output
+    std::transform(binMetadataList_.begin() + 1, binMetadataList_.end(), std::back_inserter(bins),
+                   [](const alignment::BinMetadata &bin){return boost::cref(bin);});
+    bins.push_back(boost::cref(binMetadataList_.front()));
+
+    const build::BuildContigMap contigMap(barcodeMetadataList_, bins, sortedReferenceMetadataList_, false);
+    build::BuildStats stats(bins, barcodeMetadataList_);
+    const build::BarcodeBamMapping barcodeBamMapping(
+        std::vector<unsigned>(1, 0), std::vector<unsigned>(1, 0), std::vector<bfs::path>(1, bamPath_));
+    build::BinSorter binSorter(
+        true, true, true, true, build::GROUP_DUPLICATES_BY_HASH, barcodeBamMapping, barcodeMetadataList_,
+        contigLists_, SPLIT_GAP_LENGTH, annotations_);
+
+    io::AsyncFileIo asyncIo;
+    bam::BgzfBlockPool bgzfBlockPool(BGZF_BLOCKS);
+    bgzf::BgzfDeflater deflater(bgzf::DeflateZlib, bamGzipLevel_);
+    boost::ptr_vector<bam::BamEncoder> bamEncoders;
+    bamEncoders.push_back(new bam::BamEncoder(bgzfBlockPool));
+    // BgzfBuffer does not grow. Like Build, expect the compressed output to be no bigger than the bin data.
+    uint64_t bgzfBufferSize = 0;
+    for (const alignment::BinMetadata &bin : bins)
+    {
+        bgzfBufferSize += EMPTY_BGZF_BLOCK_SIZE +
+            bin.getDataSize() +
+            bin.getFIdxElements() * sizeof(build::FStrandFragmentIndex) +
+            bin.getRIdxElements() * sizeof(build::RStrandOrShadowFragmentIndex) +
+            bin.getSeIdxElements() * sizeof(build::SeFragmentIndex);
+    }
+    bam::BgzfBuffer bgzfBuffer;
+    bgzfBuffer.reserve(bgzfBufferSize);
+    common::SequentialFor sequentialFor;
+
+    result.checksum_ = CHECKSUM_INIT;
+    result.items_ = 0;
+    uint64_t nanoseconds = 0;
+    for (const alignment::BinMetadata &bin : bins)
+    {
+        if (bin.isEmpty())
+        {
+            continue;
+        }
+
+        build::BinData binData(
+            2, barcodeBamMapping, barcodeMetadataList_, build::REALIGN_NONE, build::gapRealigner::Gaps(), bin,
+            bin.getIndex(), tileMetadataList_, contigMap, contigLists_.node0Container(), readLength_, 0,
+            flowcellLayoutList_, build::IncludeTags(true, false, true, false, false, false, false, false), false,
+            SPLIT_GAP_LENGTH, asyncIo);
+        build::BinLoader().loadData(binData);
+
+        boost::ptr_vector<bam::BamIndexPart> bamIndexParts;
+        bamIndexParts.push_back(new bam::BamIndexPart);
+
+        const uint64_t start = common::StageCounters::now();
+        binSorter.resolveDuplicates(binData, stats, sequentialFor);
+        bamEncoders.front().open(bgzfBuffer, deflater);
+        result.items_ += binSorter.serialize(binData, bamEncoders, bamIndexParts);
+        nanoseconds += common::StageCounters::now() - start;
+    }
+    result.seconds_ = seconds(nanoseconds);
+    result.checksum_ = fold(result.checksum_, bgzfBuffer.size());
+
+    std::string compressedHeader;
+    {
+        std::ostringstream oss;
+        boost::iostreams::filtering_ostream bgzfStream;
+        bgzfStream.push(bgzf::BgzfCompressor(bamGzipLevel_));
+        bgzfStream.push(oss);
+        bam::serializeHeader(bgzfStream, std::vector<std::string>(1, "isaac-bench"), "", std::vector<std::string>(),
+                             "%F:%L:%B", BenchBamHeader(sortedReferenceMetadataList_.front()));
+        bgzfStream.strict_sync();
+        compressedHeader = oss.str();
+    }
+
+    std::ofstream os(bamPath_.string().c_str(), std::ios_base::binary);
+    if (!os)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open output BAM file " + bamPath_.string()));
+    }
+    if (!os.write(compressedHeader.c_str(), compressedHeader.size()) ||
+        !os.write(&bgzfBuffer.front(), bgzfBuffer.size()))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to write into " + bamPath_.string()));
+    }
+    bam::serializeBgzfFooter(os);
+}
+
+/**
+ * \brief Only the bgzf decompression runs on several threads. BamLoader hands the records to the callback one parse
+ *        slot at a time in the file order, so the checksum folds them in that order.
+ */
+void BenchWorkflow::loadBam(Result &result)
+{
+    uint64_t records = 0;
+    uint64_t checksum = CHECKSUM_INIT;
+    const uint64_t start = common::StageCounters::now();
+    {
+        io::BamLoader bamLoader(bamPath_.string().size(), threads_, threadsCount_);
+        bamLoader.open(bamPath_);
+        bamLoader.load(
+            boost::make_tuple(
+                [&records, &checksum](const bam::BamBlockHeader &block, const bool lastBlock)
+                {
+                    ++records;
+                    checksum = fold(checksum, block.getRefId());
+                    checksum = fold(checksum, block.getPos());
+                    checksum = fold(checksum, block.isReverse());
+                    return true;
+                },
+                [](const char *begin, const char *end){}));
+    }
+    result.seconds_ = seconds(common::StageCounters::now() - start);
+    result.items_ = records;
+    result.checksum_ = fold(checksum, records);
+}
+
+void BenchWorkflow::printResults(std::ostream &os, const Results &results) const
+{
+    os << "#isaac-bench\t" << iSAAC_VERSION_FULL << "\tformat 1\n";
+    os << boost::format("#seed %d\treference_length %d\tcontigs %d\tclusters %d\tread_length %d\tbam_gzip_level %d\n") %
+        seed_ % referenceLength_ % contigsCount_ % clustersCount_ % readLength_ % bamGzipLevel_;
+    os << "#benchmark\titems\tseconds\titems_per_second\tchecksum\n";
+    for (const Result &result : results)
+    {
+        os << boost::format("%s\t%d\t%.6f\t%.0f\t%016x\n") %
+            result.name_ % result.items_ % result.seconds_ %
+            (result.seconds_ ? result.items_ / result.seconds_ : 0.0) % result.checksum_;
+    }
+}
+
+} // namespace workflow
+} // namespace isaac
@@ -0,0 +1,266 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file FindAllNeighborsWorkflow.cpp
+ **
+ ** \brief See FindAllNeighborsWorkflow.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "common/Exceptions.hh"
+#include "common/ParallelSort.hpp"
+#include "reference/SortedReferenceXml.hh"
+#include "reference/neighborsFinder/NeighborCounter.hh"
+#include "workflow/FindAllNeighborsWorkflow.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+
+namespace bfs = boost::filesystem;
+
+const unsigned FindAllNeighborsWorkflow::NEIGHBORS_MAX;
+
+FindAllNeighborsWorkflow::FindAllNeighborsWorkflow(
+    const std::vector<unsigned> &seedLengths,
+    const bfs::path &referenceGenome,
+    const bfs::path &uniquenessFile,
+    const bfs::path &repeatnessFile,
+    const unsigned jobs,
+    const uint64_t memoryLimit)
+    : seedLengths_(seedLengths)
+    , uniquenessFile_(uniquenessFile)
+    , repeatnessFile_(repeatnessFile)
+    , memoryLimit_(memoryLimit)
+    , kmerMemoryLimit_(0)
+    , sortedReferenceMetadata_(reference::loadSortedReferenceXml(referenceGenome))
+    , threads_(jobs)
+    , contigList_(reference::loadContigs(sortedReferenceMetadata_.getContigs(), threads_))
+    , uniquenessMerger_(referenceGenome, uniquenessFile_, false)
+    , repeatnessMerger_(referenceGenome, repeatnessFile_, false)
+{
+}
+
+template <typename MergeT>
+void FindAllNeighborsWorkflow::parallelMerge(MergeT merge)
+{
+    const std::size_t genomeLength = neighbors_.size();
+    threads_.execute(
+        [genomeLength, &merge](const std::size_t threadNum, const std::size_t threadsTotal)
+        {
+            const std::size_t blockLength = (genomeLength + threadsTotal - 1) / threadsTotal;
+            const std::size_t begin = std::min(genomeLength, blockLength * threadNum);
+            const std::size_t end = std::min(genomeLength, begin + blockLength);
+            for (std::size_t offset = begin; end != offset; ++offset)
+            {
+                merge(offset);
+            }
+        });
+}
+
+/**
+ * \brief Counts into annotation the same as summing up the per-mask findNeighbors outputs would.
+ *        Genome and k-mer buffer are shared by all masks.
+ */
+template <typename KmerT, typename KmerListT>
+void FindAllNeighborsWorkflow::countNeighbors(
+    const unsigned int maskWidth,
+    const unsigned neighborhoodWidth,
+    KmerListT &kmerList,
+    std::vector<reference::NeighborsCount> &annotation)
+{
+    std::fill(annotation.begin(), annotation.end(), reference::NeighborsCount(0));
+    for (unsigned mask = 0; (1U << maskWidth) != mask; ++mask)
+    {
+        ISAAC_THREAD_CERR << "Counting " << neighborhoodWidth << "-mismatch neighbors for seed length " <<
+            oligo::KmerTraits<KmerT>::KMER_BASES << " mask " << mask << std::endl;
+        countPartition<KmerT>(maskWidth, mask, neighborhoodWidth, kmerList, annotation);
+    }
+}
+
+/**
+ * \brief When the k-mers of the partition don't fit in kmerMemoryLimit_, the partition is split in two on the next
+ *        bit of the permuted k-mer. Neighbors are only looked for among the k-mers that share the permuted prefix,
+ *        so splitting within the prefix does not change the counts.
+ */
+template <typename KmerT, typename KmerListT>
+void FindAllNeighborsWorkflow::countPartition(
+    const unsigned partitionMaskWidth,
+    const unsigned partitionMask,
+    const unsigned neighborhoodWidth,
+    KmerListT &kmerList,
+    std::vector<reference::NeighborsCount> &annotation)
+{
+    static const unsigned PARTITION_MASK_WIDTH_MAX =
+        oligo::KmerTraits<KmerT>::KMER_BITS - oligo::KmerTraits<KmerT>::SUFFIX_BITS;
+
+    typedef reference::neighborsFinder::NeighborCounter<KmerT> NeighborCounterT;
+    NeighborCounterT neighborCounter(
+        partitionMaskWidth, partitionMask, neighborhoodWidth, contigList_, sortedReferenceMetadata_, annotation);
+    reference::NeighborsFinder<KmerT, NeighborCounterT> neighborsFinder(
+        neighborCounter, partitionMaskWidth, neighborhoodWidth, threads_);
+
+    if (kmerMemoryLimit_)
+    {
+        const std::size_t kmers = neighborsFinder.countKmersMax();
+        if (kmerMemoryLimit_ < kmers * sizeof(typename KmerListT::value_type))
+        {
+            if (PARTITION_MASK_WIDTH_MAX == partitionMaskWidth)
+            {
+                BOOST_THROW_EXCEPTION(common::MemoryException(
+                    "Partition " + boost::lexical_cast<std::string>(partitionMask) + " of " +
+                    boost::lexical_cast<std::string>(partitionMaskWidth) + " bits cannot be split further and its " +
+                    boost::lexical_cast<std::string>(kmers) + " k-mers don't fit in " +
+                    boost::lexical_cast<std::string>(kmerMemoryLimit_) + " bytes"));
+            }
+            ISAAC_THREAD_CERR << "Splitting partition " << partitionMask << " of " << partitionMaskWidth << " bits: " <<
+                kmers << " k-mers don't fit in " << kmerMemoryLimit_ << " bytes" << std::endl;
+            countPartition<KmerT>(partitionMaskWidth + 1, partitionMask << 1, neighborhoodWidth, kmerList, annotation);
+            countPartition<KmerT>(partitionMaskWidth + 1, (partitionMask << 1) | 1, neighborhoodWidth, kmerList, annotation);
+            return;
+        }
+    }
+
+    neighborsFinder.template annotate<KmerT>(kmerList);
+}
+
+/**
+ * \brief Part of memoryLimit_ left for the k-mers of a partition. The contigs, the annotations and the sort job
+ *        queue stay allocated for the whole run.
+ *
+ * \return 0 when memoryLimit_ is 0.
+ */
+uint64_t FindAllNeighborsWorkflow::getKmerMemoryLimit() const
+{
+    if (!memoryLimit_)
+    {
+        return 0;
+    }
+
+    uint64_t fixedMemory =
+        (neighbors_.capacity() + moreNeighbors_.capacity()) * sizeof(reference::NeighborsCount) +
+        (uniqueness_.capacity() + repeatness_.capacity()) * sizeof(reference::DistanceToBeNeighborless) +
+        // NeighborsFinder sorts on all cores. The sort jobs hold iterators, whatever the k-mer type
+        common::ParallelSorter<std::vector<uint64_t>::iterator,
+                               bool(*)(const uint64_t&, const uint64_t&)>::getMemoryRequirements(
+                                   boost::thread::hardware_concurrency());
+    BOOST_FOREACH(const reference::Contig &contig, contigList_)
+    {
+        fixedMemory += contig.getPackedBytes();
+    }
+
+    if (memoryLimit_ <= fixedMemory)
+    {
+        BOOST_THROW_EXCEPTION(common::MemoryException(
+            "Memory limit of " + boost::lexical_cast<std::string>(memoryLimit_) + " bytes does not leave room for k-mers after " +
+            boost::lexical_cast<std::string>(fixedMemory) + " bytes of contigs, annotations and sort jobs"));
+    }
+
+    ISAAC_THREAD_CERR << "Using " << memoryLimit_ - fixedMemory << " bytes for k-mers, " <<
+        fixedMemory << " bytes taken by contigs, annotations and sort jobs" << std::endl;
+    return memoryLimit_ - fixedMemory;
+}
+
+template <typename KmerT>
+void FindAllNeighborsWorkflow::annotateSeedLength(const unsigned int maskWidth)
+{
+    const reference::DistanceToBeNeighborless seedLength(oligo::KmerTraits<KmerT>::KMER_BASES);
+    typename reference::neighborsFinder::NeighborCounter<KmerT>::KmerList kmerList;
+
+    countNeighbors<KmerT>(maskWidth, 1, kmerList, neighbors_);
+    countNeighbors<KmerT>(maskWidth, 2, kmerList, moreNeighbors_);
+    // repeatness uses zero-and-zero of 1 and 2. Then neighbors_ becomes 1+2
+    parallelMerge(
+        [this, seedLength](const std::size_t offset)
+        {
+            repeatness_[offset] = reference::mask(
+                repeatness_[offset], reference::zeroAndLeq(neighbors_[offset], moreNeighbors_[offset], 0), seedLength);
+            neighbors_[offset] = reference::zeroAndLeq(neighbors_[offset], moreNeighbors_[offset], NEIGHBORS_MAX);
+        });
+
+    countNeighbors<KmerT>(maskWidth, 0, kmerList, moreNeighbors_);
+    parallelMerge(
+        [this, seedLength](const std::size_t offset)
+        {
+            uniqueness_[offset] = reference::mask(
+                uniqueness_[offset], reference::zeroAndLeq(moreNeighbors_[offset], neighbors_[offset], NEIGHBORS_MAX), seedLength);
+        });
+}
+
+template <typename It,typename End, bool endTrueFalse>
+struct FindAllNeighborsWorkflowSeedLengthResolver
+{
+    FindAllNeighborsWorkflowSeedLengthResolver(
+        const unsigned seedLength,
+        const unsigned int maskWidth,
+        const reference::SortedReferenceMetadata &sortedReferenceMetadata,
+        FindAllNeighborsWorkflow &workflow)
+    {
+        if (boost::mpl::deref<It>::type::value == seedLength)
+        {
+            ISAAC_ASSERT_MSG(sortedReferenceMetadata.supportsSeedLength(seedLength), "Sorted reference does not support seedLength " << seedLength);
+            workflow.annotateSeedLength<isaac::oligo::BasicKmerType<boost::mpl::deref<It>::type::value> >(maskWidth);
+        }
+        else
+        {
+            typedef typename boost::mpl::next<It>::type Next;
+            FindAllNeighborsWorkflowSeedLengthResolver<Next, End, boost::is_same<Next,End>::type::value>(
+                seedLength, maskWidth, sortedReferenceMetadata, workflow);
+        }
+    }
+};
+
+template <typename It,typename End>
+struct FindAllNeighborsWorkflowSeedLengthResolver<It, End, true>
+{
+    FindAllNeighborsWorkflowSeedLengthResolver(
+        const unsigned seedLength,
+        const unsigned int maskWidth,
+        const reference::SortedReferenceMetadata &sortedReferenceMetadata,
+        FindAllNeighborsWorkflow &workflow)
+    {
+        ISAAC_ASSERT_MSG(false, "Unexpected seedLength requested: " << seedLength);
+    }
+};
+
+void FindAllNeighborsWorkflow::run(const unsigned int maskWidth)
+{
+    // Skip first supported kmer. It does not have suffix type defined
+    typedef boost::mpl::next<boost::mpl::begin<reference::SUPPORTED_KMERS>::type>::type Begin;
+    typedef boost::mpl::end<reference::SUPPORTED_KMERS>::type End;
+
+    uniquenessMerger_.start("init-kul-65535", uniqueness_);
+    repeatnessMerger_.start("init-kul-65535", repeatness_);
+    neighbors_.resize(uniqueness_.size(), reference::NeighborsCount(0));
+    moreNeighbors_.resize(uniqueness_.size(), reference::NeighborsCount(0));
+    kmerMemoryLimit_ = getKmerMemoryLimit();
+
+    BOOST_FOREACH(const unsigned seedLength, seedLengths_)
+    {
+        FindAllNeighborsWorkflowSeedLengthResolver<Begin, End, boost::is_same<Begin,End>::type::value>(
+            seedLength, maskWidth, sortedReferenceMetadata_, *this);
+    }
+
+    std::vector<reference::NeighborsCount>().swap(neighbors_);
+    std::vector<reference::NeighborsCount>().swap(moreNeighbors_);
+
+    uniquenessMerger_.finish(uniqueness_);
+    repeatnessMerger_.finish(repeatness_);
+}
+
+} // namespace workflow
+} //namespace isaac
@@ -73,17 +73,6 @@ reference::NeighborsCount minNeighborsCount(
     return std::min(merged, toMerge);
 }
 
-reference::NeighborsCount zeroAndLeq(
-    const reference::NeighborsCount merged,
-    const reference::NeighborsCount toMerge,
-    const reference::NeighborsCount max)
-{
-    reference::NeighborsCount ret = (reference::NeighborsCount(0) == merged && max >= toMerge) ?
-        reference::NeighborsCount(0) : reference::NEIGHBORS_TOO_MANY;
-
-    return ret;
-}
-
 reference::DistanceToBeNeighborless mask32(
         const reference::DistanceToBeNeighborless merged,
         const reference::NeighborsCount toMerge)
@@ -95,18 +84,6 @@ reference::DistanceToBeNeighborless mask32(
     return merged;
 }
 
-reference::DistanceToBeNeighborless mask(
-        const reference::DistanceToBeNeighborless merged,
-        const reference::NeighborsCount toMerge,
-        reference::DistanceToBeNeighborless mask)
-{
-    if (reference::NeighborsCount(0) == toMerge)
-    {
-        return std::min(merged, mask);
-    }
-    return merged;
-}
-
 reference::DistanceToBeNeighborless mask64(
         const reference::DistanceToBeNeighborless merged,
         const reference::NeighborsCount toMerge)
@@ -150,7 +127,7 @@ void MergeAnnotationsWorkflow::run()
                 const int value = atoi(agIt->substr(5, 2).c_str());
                 ISAAC_ASSERT_MSG(value, "Unexpected mask value in " << *agIt);
                 merger.merge<reference::NeighborsCount>(
-                    *it, boost::bind(&mask, _1, _2, value), annotation);
+                    *it, boost::bind(&reference::mask, _1, _2, value), annotation);
             }
             else
             {
@@ -177,17 +154,17 @@ void MergeAnnotationsWorkflow::run()
             else if ("zero-and-zero" == *agIt)
             {
                 merger.merge<reference::NeighborsCount>(
-                    *it, boost::bind(&zeroAndLeq, _1, _2, 0), annotation);
+                    *it, boost::bind(&reference::zeroAndLeq, _1, _2, 0), annotation);
             }
             else if ("zero-and-leq10" == *agIt)
             {
                 merger.merge<reference::NeighborsCount>(
-                    *it, boost::bind(&zeroAndLeq, _1, _2, 10), annotation);
+                    *it, boost::bind(&reference::zeroAndLeq, _1, _2, 10), annotation);
             }
             else if ("zero-and-leq100" == *agIt)
             {
                 merger.merge<reference::NeighborsCount>(
-                    *it, boost::bind(&zeroAndLeq, _1, _2, 100), annotation);
+                    *it, boost::bind(&reference::zeroAndLeq, _1, _2, 100), annotation);
             }
             else
             {
@@ -146,6 +146,16 @@ inline std::size_t getBamFileSize(const flowcell::Layout &flowcell)
     return common::getFileSize(flowcell.getAttribute<flowcell::Layout::Bam, flowcell::BamFilePathAttributeTag>().c_str());
 }
 
+/**
+ * \brief Unpaired records are paired one temporary file at a time. Don't let a single file take more than a
+ *        fraction of the memory available for the data loading.
+ */
+static std::size_t getUnpairedMemoryLimit(const uint64_t availableMemory)
+{
+    return std::max<std::size_t>(
+        1, std::min<std::size_t>(bamDataSource::UnpairedReadsCache::UNPAIRED_BUFFER_SIZE, availableMemory / 8));
+}
+
 BamBaseCallsSource::BamBaseCallsSource(
     const boost::filesystem::path &tempDirectoryPath,
     const uint64_t availableMemory,
@@ -165,7 +175,8 @@ BamBaseCallsSource::BamBaseCallsSource(
             cleanupIntermediary, 0, threads, coresMax, tempDirectoryPath,
             getBamFileSize(bamFlowcellLayout_), bamFlowcellLayout.getFlowcellId().length(),
             flowcell::getTotalReadLength(bamFlowcellLayout.getReadMetadataList()),
-            flowcell::getMinReadLength(bamFlowcellLayout.getReadMetadataList()))
+            flowcell::getMinReadLength(bamFlowcellLayout.getReadMetadataList()),
+            getUnpairedMemoryLimit(availableMemory))
 {
 }
 
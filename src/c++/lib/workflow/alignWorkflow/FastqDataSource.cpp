@@ -29,6 +29,7 @@ namespace alignWorkflow
 FastqBaseCallsSource::FastqBaseCallsSource(
     const unsigned clustersAtATimeMax,
     const unsigned coresMax,
+    const bool parallelGzip,
     const flowcell::BarcodeMetadataList &barcodeMetadataList,
     const flowcell::Layout &fastqFlowcellLayout,
     common::ThreadVector &threads) :
@@ -41,7 +42,7 @@ FastqBaseCallsSource::FastqBaseCallsSource(
         lanes_(fastqFlowcellLayout.getLaneIds()),
         currentLaneIterator_(lanes_.begin()),
         currentTile_(1),
-        fastqLoader_(fastqFlowcellLayout_.getAttribute<flowcell::Layout::Fastq, flowcell::FastqVariableLengthOk>(), 0, threads, coresMax_)
+        fastqLoader_(fastqFlowcellLayout_.getAttribute<flowcell::Layout::Fastq, flowcell::FastqVariableLengthOk>(), 0, threads, coresMax_, parallelGzip)
 
 {
 }
@@ -17,6 +17,7 @@
  ** \author Roman Petrovski
  **/
 
+#include <boost/lexical_cast.hpp>
 #include <boost/ref.hpp>
 
 #include "alignment/HashMatchFinder.hh"
@@ -28,6 +29,7 @@
 #include "common/Exceptions.hh"
 #include "common/Numa.hh"
 #include "common/ParallelSort.hpp"
+#include "common/StageCounters.hh"
 #include "demultiplexing/DemultiplexingStatsXml.hh"
 #include "flowcell/Layout.hh"
 #include "flowcell/ReadMetadata.hh"
@@ -50,43 +52,6 @@ namespace alignWorkflow
 namespace findHashMatchesTransition
 {
 
-void wait(
-    bool &signal,
-    boost::condition_variable &condition,
-    boost::unique_lock<boost::mutex> &lock,
-    bool &forceTermination)
-{
-    if (forceTermination)
-    {
-        BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
-    }
-
-    while (signal)
-    {
-        if (forceTermination)
-        {
-            BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
-        }
-
-        condition.wait(lock);
-    }
-    signal = true;
-}
-
-void release(
-    bool &signal,
-    boost::condition_variable &condition,
-    bool &forceTermination,
-    const bool exceptionUnwinding)
-{
-    if (exceptionUnwinding)
-    {
-        forceTermination = true;
-    }
-    signal = false;
-    condition.notify_all();
-}
-
 void Thread::binQscores(alignment::BclClusters &bclData) const
 {
     ISAAC_THREAD_CERR << "Binning qscores" << std::endl;
@@ -104,93 +69,115 @@ void Thread::binQscores(alignment::BclClusters &bclData) const
     ISAAC_THREAD_CERR << "Binning qscores done" << std::endl;
 }
 
+template <typename DataSourceT>
+void Thread::load(
+    const flowcell::TileMetadata &tileMetadata,
+    alignment::BclClusters &tileClusters,
+    DataSourceT &dataSource,
+    common::ScopedMallocBlock &mallocBlock)
+{
+    common::ScopedMallocBlockUnblock unblockMalloc(mallocBlock);
+    common::StageTimer timer(common::STAGE_TILE_LOAD);
+
+    dataSource.resetBclData(tileMetadata, tileClusters);
+    dataSource.loadClusters(tileMetadata, tileClusters);
+    if(qScoreBin_)
+    {
+        binQscores(tileClusters);
+    }
+}
+
 /**
  * \brief Finds matches for the lane. Updates foundMatches with match information and tile metadata identified during
- *        the processing.
+ *        the processing. Load balancing of the match selection happens inside parallelSelect at cluster block
+ *        granularity.
  */
 template <typename ReferenceHashT, typename DataSourceT>
 void Thread::run(
     const flowcell::TileMetadataList &unprocessedTiles,
-    unsigned &nextTile,
-    unsigned &nextUnprocessedTile,
+    TilePipeline &tilePipeline,
+    TileBuffers &tileBuffers,
     DataSourceT &dataSource,
     alignment::SeedHashMatchFinder<ReferenceHashT> &matchFinder,
     alignment::matchFinder::TileClusterInfo &tileClusterInfo,
     std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
     common::ScopedMallocBlock &mallocBlock)
 {
-    boost::unique_lock<boost::mutex> lock(mutex_);
-    while(unprocessedTiles.size() != nextTile)
-    {
-        const unsigned ourTile = nextTile++;
-        const flowcell::TileMetadata &tileMetadata = unprocessedTiles.at(ourTile);
-
-        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&release, boost::ref(loading_), boost::ref(stateChangedCondition_), boost::ref(forceTermination_), _1))
-//        ISAAC_BLOCK_WITH_CLENAUP([this](bool){release(loading_, stateChangedCondition_);})
+    tilePipeline.run(
+        tileBuffers,
+        [&](const unsigned tile, alignment::BclClusters &tileClusters)
         {
-            wait(loading_, stateChangedCondition_, lock, forceTermination_);
-            {
-                common::ScopedMallocBlockUnblock unblockMalloc(mallocBlock);
-                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-
-                dataSource.resetBclData(tileMetadata, tileClusters_);
-                dataSource.loadClusters(tileMetadata, tileClusters_);
-                if(qScoreBin_)
-                {
-                    binQscores(tileClusters_);
-                }
-            }
-        }
-
-        ISAAC_BLOCK_WITH_CLENAUP([&](bool exceptionUnwinding)
-                                 {
-                                    if (exceptionUnwinding) {forceTermination_ = true;}
-                                    stateChangedCondition_.notify_all();
-                                 })
+            load(unprocessedTiles.at(tile), tileClusters, dataSource, mallocBlock);
+        },
+        [&](const unsigned tile, alignment::BclClusters &tileClusters)
         {
-            // make sure the order in which tiles are processed is same between different runs.
-            while (nextUnprocessedTile != ourTile)
-            {
-                if (forceTermination_)
-                {
-                    BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
-                }
+            matchSelector_.parallelSelect(
+                tileClusterInfo, barcodeTemplateLengthStatistics, unprocessedTiles.at(tile), matchFinder,
+                tileClusters, fragmentStorage_);
+        },
+        [this](){fragmentStorage_.prepareFlush();},
+        [this]()
+        {
+            common::StageTimer timer(common::STAGE_BINNING);
+            fragmentStorage_.flush();
+        });
+}
 
-                stateChangedCondition_.wait(lock);
-            }
+} // namespace findHashMatchesTransition
 
-            {
-                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-                matchSelector_.parallelSelect(tileClusterInfo, barcodeTemplateLengthStatistics, tileMetadata, matchFinder, tileClusters_, fragmentStorage_);
-            }
+/**
+ * \brief Barcodes of the same lane and barcodes of the same sample end up in the same group. The bins of a group
+ *        don't receive fragments from the lanes of other groups, so they are complete as soon as the lanes of the
+ *        group are done. No bam file gets data from more than one group.
+ *
+ * \return group of each barcode
+ */
+static std::vector<unsigned> groupBarcodesBySample(const flowcell::BarcodeMetadataList &barcodeMetadataList)
+{
+    std::vector<unsigned> root(barcodeMetadataList.size());
+    for (unsigned i = 0; root.size() != i; ++i)
+    {
+        ISAAC_ASSERT_MSG(barcodeMetadataList[i].getIndex() == i, "Barcode index mismatch " << barcodeMetadataList[i]);
+        root[i] = i;
+    }
+    const auto findRoot = [&root](unsigned i)
+    {
+        while (root[i] != i)
+        {
+            i = root[i] = root[root[i]];
+        }
+        return i;
+    };
 
-            // swap the flush buffers while we still have compute lock
-            wait(flushing_, stateChangedCondition_, lock, forceTermination_);
+    for (unsigned i = 0; root.size() != i; ++i)
+    {
+        const flowcell::BarcodeMetadata &left = barcodeMetadataList[i];
+        for (unsigned j = i + 1; root.size() != j; ++j)
+        {
+            const flowcell::BarcodeMetadata &right = barcodeMetadataList[j];
+            if ((left.getFlowcellId() == right.getFlowcellId() && left.getLane() == right.getLane()) ||
+                (left.getProject() == right.getProject() && left.getSampleName() == right.getSampleName()))
             {
-                fragmentStorage_.prepareFlush();
+                root[findRoot(j)] = findRoot(i);
             }
-            ++nextUnprocessedTile;
         }
+    }
 
-        // flush asynchronously so that other guys can load and align at the same time
-        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&release, boost::ref(flushing_), boost::ref(stateChangedCondition_), boost::ref(forceTermination_), _1))
-//        ISAAC_BLOCK_WITH_CLENAUP([&](bool){release(flushing_, stateChangedCondition_);})
+    std::vector<unsigned> groupRoots;
+    std::vector<unsigned> ret(root.size());
+    for (unsigned i = 0; root.size() != i; ++i)
+    {
+        const unsigned barcodeRoot = findRoot(i);
+        const std::vector<unsigned>::const_iterator it = std::find(groupRoots.begin(), groupRoots.end(), barcodeRoot);
+        ret[i] = std::distance<std::vector<unsigned>::const_iterator>(groupRoots.begin(), it);
+        if (groupRoots.end() == it)
         {
-            // flush slot already acquired when we had the compute slot but the state could have changed in between.
-            if (forceTermination_)
-            {
-                BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
-            }
-            {
-                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-                fragmentStorage_.flush();
-            }
+            groupRoots.push_back(barcodeRoot);
         }
     }
+    return ret;
 }
 
-} // namespace findHashMatchesTransition
-
 FindHashMatchesTransition::FindHashMatchesTransition(
     const flowcell::FlowcellLayoutList &flowcellLayoutList,
     const flowcell::BarcodeMetadataList &barcodeMetadataList,
@@ -209,6 +196,7 @@ FindHashMatchesTransition::FindHashMatchesTransition(
     const bool ignoreNeighbors,
     const bool ignoreRepeats,
     const unsigned inputLoadersMax,
+    const bool parallelGzip,
     const unsigned tempSaversMax,
     const common::ScopedMallocBlock::Mode memoryControl,
     const std::vector<std::size_t> &clusterIdList,
@@ -240,16 +228,20 @@ FindHashMatchesTransition::FindHashMatchesTransition(
     const int gapExtendScore,
     const int minGapExtendScore,
     const unsigned splitGapLength,
+    const unsigned smithWatermanBandWidth,
     const alignment::TemplateBuilder::DodgyAlignmentScore dodgyAlignmentScore,
     const bool qScoreBin,
     const boost::array<char, 256> &fullBclQScoreTable,
     const bool bufferBins,
+    const bfs::path &referenceHashDirectory,
+    const bool referenceHashNumaReplicas,
     const unsigned expectedCoverage,
     const uint64_t targetBinSize,
     const double expectedBgzfCompressionRatio,
     const bool preSortBins,
     const bool preAllocateBins,
-    const std::string &binRegexString
+    const std::string &binRegexString,
+    build::BinQueue *binQueue
     )
     : flowcellLayoutList_(flowcellLayoutList)
     , tempDirectory_(tempDirectory)
@@ -268,12 +260,15 @@ FindHashMatchesTransition::FindHashMatchesTransition(
     , ignoreNeighbors_(ignoreNeighbors)
     , ignoreRepeats_(ignoreRepeats)
     , inputLoadersMax_(inputLoadersMax)
+    , parallelGzip_(parallelGzip)
     , tempSaversMax_(tempSaversMax)
     , memoryControl_(memoryControl)
     , clusterIdList_(clusterIdList)
     , sortedReferenceMetadataList_(sortedReferenceMetadataList)
     , extractClusterXy_(extractClusterXy)
     , bufferBins_(bufferBins)
+    , referenceHashDirectory_(referenceHashDirectory)
+    , referenceHashNumaReplicas_(referenceHashNumaReplicas)
     , expectedCoverage_(expectedCoverage)
     , targetBinSize_(targetBinSize)
     , expectedBgzfCompressionRatio_(expectedBgzfCompressionRatio)
@@ -281,15 +276,19 @@ FindHashMatchesTransition::FindHashMatchesTransition(
     , preSortBins_(preSortBins)
     , preAllocateBins_(preAllocateBins)
     , binRegexString_(binRegexString)
+    , binQueue_(binQueue)
+    , barcodeBinGroups_(binQueue_ ? groupBarcodesBySample(barcodeMetadataList_) : std::vector<unsigned>())
 
     // Have thread pool for the maximum number of threads we may potentially need.
     , threads_(std::max(inputLoadersMax_, coresMax_))
 
-    , ioOverlapThreads_(bufferBins_ ? 3 : 2) //bin buffering needs an extra thread to flush the buffers
+    // one thread loads ahead while another selects matches and a third flushes.
+    // bin buffering needs an extra thread to flush the buffers
+    , ioOverlapThreads_(bufferBins_ ? 4 : 3)
     , contigLists_(contigLists)
     , kUniquenessAnnotations_(kUniquenessAnnotations)
 
-    , alignmentCfg_(gapMatchScore, gapMismatchScore, gapOpenScore, gapExtendScore, minGapExtendScore, splitGapLength)
+    , alignmentCfg_(gapMatchScore, gapMismatchScore, gapOpenScore, gapExtendScore, minGapExtendScore, splitGapLength, smithWatermanBandWidth)
     , matchSelector_(
         coresMax_,
         barcodeMetadataList_,
@@ -321,6 +320,7 @@ FindHashMatchesTransition::FindHashMatchesTransition(
         gapExtendScore,
         minGapExtendScore,
         splitGapLength,
+        smithWatermanBandWidth,
         dodgyAlignmentScore,
         common::ScopedMallocBlock::Strict == memoryControl_),
         qScoreBin_(qScoreBin),
@@ -340,32 +340,37 @@ static alignment::BinMetadataList buildBinPathList(
     alignment::BinMetadataList binPathList;
     ISAAC_ASSERT_MSG(!binIndexMap.empty(), "Empty binIndexMap is illegal");
     ISAAC_ASSERT_MSG(!binIndexMap.back().empty(), "Empty binIndexMap entry is illegal" << binIndexMap);
-    binPathList.reserve(1 + binIndexMap.back().back());
-    size_t contigIndex = 0;
-    BOOST_FOREACH(const std::vector<unsigned> &contigBins, binIndexMap)
+    binPathList.reserve(binIndexMap.getTotalBins());
+    for (unsigned group = 0; binIndexMap.getBinGroups() != group; ++group)
     {
-        ISAAC_ASSERT_MSG(!contigBins.empty(), "Unexpected empty contigBins");
-        // matchDistribution contig 0 is the first contig
-        // binIndexMap contig 0  is unaligned bin
-        for (unsigned i = contigBins.front(); contigBins.back() >= i; ++i)
+        size_t contigIndex = 0;
+        BOOST_FOREACH(const std::vector<unsigned> &contigBins, binIndexMap)
         {
-            ISAAC_ASSERT_MSG(binPathList.size() == i, "Basic sanity checking for bin numbering failed");
-            const reference::ReferencePosition binStartPos = binIndexMap.getBinFirstPos(i);
-            ISAAC_ASSERT_MSG(!i || binIndexMap.getBinIndex(binStartPos) == i, "BinIndexMap is broken");
-            binPathList.push_back(
-                alignment::BinMetadata(
-                    barcodeMetadataList.size(),
-                    binPathList.size(),
-                    binStartPos,
-                    // bin zero has length of totalReads as it contains unaligned records which are chunked by the number of reads stored
-                    i ? binIndexMap.getBinFirstInvalidPos(i) - binStartPos : expectedTotalReads,
-                        // Pad file names well, so that we don't have to worry about them becoming of different length.
-                        // This is important for memory reservation to be stable
-                    binDirectory / (boost::format("bin-%08d-%08d.dat") % contigIndex % i).str(),
-                    // don't pre-sort normal bins. Seems to have no effect and causes trouble with genomes having large number of contigs
-                    i ? 0 : preSortBins ? 1024 : 0));
+            ISAAC_ASSERT_MSG(!contigBins.empty(), "Unexpected empty contigBins");
+            // matchDistribution contig 0 is the first contig
+            // binIndexMap contig 0  is unaligned bin. All groups share it.
+            for (unsigned positionBin = (contigIndex || !group) ? contigBins.front() : 1;
+                contigBins.back() >= positionBin; ++positionBin)
+            {
+                const unsigned i = binIndexMap.getGroupBinIndex(positionBin, group);
+                ISAAC_ASSERT_MSG(binPathList.size() == i, "Basic sanity checking for bin numbering failed");
+                const reference::ReferencePosition binStartPos = binIndexMap.getBinFirstPos(i);
+                ISAAC_ASSERT_MSG(!i || binIndexMap.getBinIndex(binStartPos) == positionBin, "BinIndexMap is broken");
+                binPathList.push_back(
+                    alignment::BinMetadata(
+                        barcodeMetadataList.size(),
+                        binPathList.size(),
+                        binStartPos,
+                        // bin zero has length of totalReads as it contains unaligned records which are chunked by the number of reads stored
+                        i ? binIndexMap.getBinFirstInvalidPos(i) - binStartPos : expectedTotalReads,
+                            // Pad file names well, so that we don't have to worry about them becoming of different length.
+                            // This is important for memory reservation to be stable
+                        binDirectory / (boost::format("bin-%08d-%08d.dat") % contigIndex % i).str(),
+                        // don't pre-sort normal bins. Seems to have no effect and causes trouble with genomes having large number of contigs
+                        i ? 0 : preSortBins ? 1024 : 0));
+            }
+            ++contigIndex;
         }
-        ++contigIndex;
     }
     return binPathList;
 }
@@ -479,39 +484,31 @@ void FindHashMatchesTransition::findLaneMatches(
 
         matchSelector_.reserveMemory(unprocessedTiles);
 
-        boost::mutex mutex;
-        boost::condition_variable stateChangedCondition;
-        bool loading(false);
-        bool flushing(false);
-        bool forceTermination(false);
+        TilePipeline tilePipeline(unprocessedTiles.size());
+
+        // one buffer per thread: while one tile is selected and another flushed, the rest can be loaded ahead
+        findHashMatchesTransition::TileBuffers tileBuffers(
+            ioOverlapThreads_.size(), flowcell, maxTileClusters,
+            DataSourceTraits<DataSourceT>::SUPPORTS_XY && extractClusterXy_);
 
         std::vector<findHashMatchesTransition::Thread> threads(
             ioOverlapThreads_.size(),
             findHashMatchesTransition::Thread(
-                mutex,
-                stateChangedCondition,
-                loading,
-                flushing,
-                forceTermination,
                 flowcell,
-                maxTileClusters,
-                DataSourceTraits<DataSourceT>::SUPPORTS_XY && extractClusterXy_,
                 qScoreBin_,
                 fullBclQScoreTable_,
                 matchSelector_,
                 fragmentStorage));
 
         {
-            unsigned current = 0;
-            unsigned nextUnprocessed = 0;
             common::ScopedMallocBlock  mallocBlock(memoryControl_);
             ioOverlapThreads_.execute
             (
                 [&](const unsigned threadNumber, const unsigned threadsTotal)
                 {
                     threads.at(threadNumber).run(
-                        unprocessedTiles, current, nextUnprocessed, dataSource, matchFinder, tileClusterInfo,
-                        barcodeTemplateLengthStatistics, mallocBlock);
+                        unprocessedTiles, tilePipeline, tileBuffers, dataSource, matchFinder,
+                        tileClusterInfo, barcodeTemplateLengthStatistics, mallocBlock);
                 }
             );
         }
@@ -562,10 +559,102 @@ static flowcell::BarcodeMetadataList findFlowcellLaneBarcodes(
 }
 
 
+/**
+ * \return lanes of the flowcell that have at least one barcode mapped to a reference, same as the ones for which
+ *         findFlowcellLaneBarcodes returns a non-empty list
+ */
+static std::vector<unsigned> findFlowcellMappedLanes(
+    const flowcell::BarcodeMetadataList &barcodeMetadataList,
+    const flowcell::Layout& flowcell)
+{
+    std::vector<unsigned> ret;
+    BOOST_FOREACH(const flowcell::BarcodeMetadata &barcode, barcodeMetadataList)
+    {
+        if (barcode.getFlowcellId() == flowcell.getFlowcellId() && !barcode.isUnmappedReference())
+        {
+            ret.push_back(barcode.getLane());
+        }
+    }
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
+
+/**
+ * \return the unaligned bin and the bins of the lane group for the contigs of the references the lane barcodes map to
+ */
+std::vector<unsigned> FindHashMatchesTransition::getLaneBins(
+    const flowcell::Layout& flowcell,
+    const unsigned lane,
+    const alignment::BinMetadataList &binMetadataList) const
+{
+    std::vector<unsigned> karyotypeIndexes;
+    // all barcodes of the lane are in the same group
+    unsigned laneBinGroup = 0;
+    BOOST_FOREACH(const flowcell::BarcodeMetadata &barcode, barcodeMetadataList_)
+    {
+        if (barcode.getFlowcellId() == flowcell.getFlowcellId() && barcode.getLane() == lane &&
+            !barcode.isUnmappedReference())
+        {
+            laneBinGroup = barcodeBinGroups_.empty() ? 0 : barcodeBinGroups_.at(barcode.getIndex());
+            BOOST_FOREACH(const reference::SortedReferenceMetadata::Contig &contig,
+                          sortedReferenceMetadataList_.at(barcode.getReferenceIndex()).getContigs())
+            {
+                karyotypeIndexes.push_back(contig.karyotypeIndex_);
+            }
+        }
+    }
+    std::sort(karyotypeIndexes.begin(), karyotypeIndexes.end());
+    karyotypeIndexes.erase(std::unique(karyotypeIndexes.begin(), karyotypeIndexes.end()), karyotypeIndexes.end());
+
+    std::vector<unsigned> ret;
+    BOOST_FOREACH(const alignment::BinMetadata &bin, binMetadataList)
+    {
+        if (bin.isUnalignedBin() ||
+            ((binGroups_.empty() || laneBinGroup == binGroups_.at(bin.getIndex())) &&
+             std::binary_search(karyotypeIndexes.begin(), karyotypeIndexes.end(), bin.getBinStart().getContigId())))
+        {
+            ret.push_back(bin.getIndex());
+        }
+    }
+    return ret;
+}
+
+void FindHashMatchesTransition::expectLanes(
+    const alignment::BinMetadataList &binMetadataList,
+    alignment::matchSelector::FragmentStorage &fragmentStorage) const
+{
+    BOOST_FOREACH(const flowcell::Layout& flowcell, flowcellLayoutList_)
+    {
+        BOOST_FOREACH(const unsigned lane, findFlowcellMappedLanes(barcodeMetadataList_, flowcell))
+        {
+            fragmentStorage.expectLane(getLaneBins(flowcell, lane, binMetadataList));
+        }
+    }
+}
+
+/**
+ * \brief Lets Build have the bins that will not receive any more fragments
+ */
+void FindHashMatchesTransition::sealLane(
+    const flowcell::Layout& flowcell,
+    const unsigned lane,
+    const alignment::BinMetadataList &binMetadataList,
+    const flowcell::TileMetadataList &tileMetadataList,
+    alignment::matchSelector::FragmentStorage &fragmentStorage) const
+{
+    std::vector<unsigned> sealedBins;
+    fragmentStorage.sealLane(getLaneBins(flowcell, lane, binMetadataList), sealedBins);
+    ISAAC_THREAD_CERR << "Flowcell " << flowcell.getFlowcellId() << " lane " << lane << " done. Bins sealed: " <<
+        sealedBins.size() << std::endl;
+    binQueue_->seal(sealedBins, tileMetadataList);
+}
+
 template <typename ReferenceHashT, typename DataSourceT>
 void FindHashMatchesTransition::processFlowcellTiles(
     const ReferenceHashT &referenceHash,
     const flowcell::Layout& flowcell,
+    const alignment::BinMetadataList &binMetadataList,
     DataSourceT &dataSource,
     demultiplexing::DemultiplexingStats &demultiplexingStats,
     std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
@@ -574,10 +663,19 @@ void FindHashMatchesTransition::processFlowcellTiles(
 {
     fragmentStorage.reserve(dataSource.getMaxTileClusters());
 
+    // the lanes expectLanes has declared for the flowcell. Only tracked when Build runs along with the alignment.
+    std::vector<unsigned> unsealedLanes =
+        binQueue_ ? findFlowcellMappedLanes(barcodeMetadataList_, flowcell) : std::vector<unsigned>();
     for (flowcell::TileMetadataList laneTiles = dataSource.discoverTiles(); !laneTiles.empty();
         laneTiles = dataSource.discoverTiles())
     {
         const unsigned lane = laneTiles[0].getLane();
+        // the tiles of a lane come together. The lanes before this one are done.
+        while (!unsealedLanes.empty() && unsealedLanes.front() < lane)
+        {
+            sealLane(flowcell, unsealedLanes.front(), binMetadataList, foundMatches.tileMetadataList_, fragmentStorage);
+            unsealedLanes.erase(unsealedLanes.begin());
+        }
         flowcell::BarcodeMetadataList laneBarcodes = findFlowcellLaneBarcodes(barcodeMetadataList_, flowcell, lane);
         if (laneBarcodes.empty())
         {
@@ -593,16 +691,52 @@ void FindHashMatchesTransition::processFlowcellTiles(
                 // statistics properly
                 tileMetadata = foundMatches.tileMetadataList_.back();
             }
+            ISAAC_ASSERT_MSG(!binQueue_ || (!unsealedLanes.empty() && unsealedLanes.front() == lane),
+                             "Tiles of lane " << lane << " after the lane is done, flowcell " << flowcell.getFlowcellId());
             findLaneMatches(
                 referenceHash, flowcell, lane, laneBarcodes, laneTiles, dataSource, dataSource.getMaxTileClusters(),
                 demultiplexingStats, barcodeTemplateLengthStatistics, fragmentStorage);
         }
     }
+
+    // including the lanes that have no tiles to process
+    BOOST_FOREACH(const unsigned lane, unsealedLanes)
+    {
+        sealLane(flowcell, lane, binMetadataList, foundMatches.tileMetadataList_, fragmentStorage);
+    }
+}
+
+/**
+ * \brief Tile buffers of the load-ahead. Bam and fastq chunks are limited by clustersAtATimeMax_. Bcl tile sizes are
+ *        only known once the data source is open, so they are assumed to be within the same limit.
+ */
+uint64_t FindHashMatchesTransition::getTileBuffersMemory() const
+{
+    uint64_t ret = 0;
+    BOOST_FOREACH(const flowcell::Layout &flowcell, flowcellLayoutList_)
+    {
+        ret = std::max<uint64_t>(
+            ret, findHashMatchesTransition::TileBuffers::getMemoryRequirements(
+                ioOverlapThreads_.size(), flowcell, clustersAtATimeMax_, extractClusterXy_));
+    }
+    return ret;
+}
+
+/**
+ * \brief Memory left for alignment once the fragment storage thread buffers and the tile buffers are accounted for.
+ *        The buffers are allocated up front and stay for the whole match selection.
+ */
+uint64_t FindHashMatchesTransition::getAlignmentMemory() const
+{
+    const uint64_t buffersMemory =
+        alignment::matchSelector::FragmentBinner::getMemoryRequirements(coresMax_) + getTileBuffersMemory();
+    return availableMemory_ > buffersMemory ? availableMemory_ - buffersMemory : 0;
 }
 
 template <typename ReferenceHashT>
 void FindHashMatchesTransition::alignFlowcells(
     const ReferenceHashT &referenceHash,
+    const alignment::BinMetadataList &binMetadataList,
     std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics,
     demultiplexing::DemultiplexingStats &demultiplexingStats,
     FoundMatchesMetadata &foundMatches,
@@ -617,7 +751,7 @@ void FindHashMatchesTransition::alignFlowcells(
             {
                 BamBaseCallsSource dataSource(
                     tempDirectory_,
-                    availableMemory_,
+                    getAlignmentMemory(),
                     clustersAtATimeMax_,
                     cleanupIntermediary_,
                     // the loading itself occurs on one thread at a time only. So, the real limit is to avoid using
@@ -626,7 +760,7 @@ void FindHashMatchesTransition::alignFlowcells(
                     // for the multithreaded processing of other cpu-demanding things.
                     std::min(inputLoadersMax_, coresMax_),
                     flowcell, threads_);
-                processFlowcellTiles(referenceHash, flowcell, dataSource, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
+                processFlowcellTiles(referenceHash, flowcell, binMetadataList, dataSource, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
                 break;
             }
 
@@ -635,11 +769,12 @@ void FindHashMatchesTransition::alignFlowcells(
                 FastqBaseCallsSource dataSource(
                     clustersAtATimeMax_,
                     coresMax_,
+                    parallelGzip_,
                     barcodeMetadataList_,
                     flowcell,
                     threads_);
 
-                processFlowcellTiles(referenceHash, flowcell, dataSource, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
+                processFlowcellTiles(referenceHash, flowcell, binMetadataList, dataSource, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
                 break;
             }
 
@@ -651,7 +786,7 @@ void FindHashMatchesTransition::alignFlowcells(
                 MultiTileBaseCallsSource<BclBaseCallsSource> multitileBaseCalls(bclTilesPerChunk_, flowcell, baseCalls);
 
                 processFlowcellTiles(
-                    referenceHash, flowcell, multitileBaseCalls, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
+                    referenceHash, flowcell, binMetadataList, multitileBaseCalls, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
                 break;
             }
 
@@ -662,7 +797,7 @@ void FindHashMatchesTransition::alignFlowcells(
                 MultiTileBaseCallsSource<BclBgzfBaseCallsSource> multitileBaseCalls(
                     bclTilesPerChunk_, flowcell, baseCalls);
 
-                processFlowcellTiles(referenceHash, flowcell, multitileBaseCalls, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
+                processFlowcellTiles(referenceHash, flowcell, binMetadataList, multitileBaseCalls, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
                 break;
             }
 
@@ -691,7 +826,7 @@ void FindHashMatchesTransition::alignFlowcells(
     const uint64_t fragmentsPerBin = targetBinSize_
         ? targetBinSize_ / estimatedFragmentSize
         : build::Build::estimateOptimumFragmentsPerBin(
-            estimatedFragmentSize, availableMemory_, expectedBgzfCompressionRatio_,
+            estimatedFragmentSize, getAlignmentMemory(), expectedBgzfCompressionRatio_,
             coresMax_);
 
     const uint64_t expectedBinSize = targetBinSize_? targetBinSize_ : fragmentsPerBin * estimatedFragmentSize;
@@ -700,39 +835,76 @@ void FindHashMatchesTransition::alignFlowcells(
 
     alignment::EstimatedMatchDistribution matchDistribution(
         expectedCoverage_, flowcell::getMaxReadLength(flowcellLayoutList_), sortedReferenceMetadataList_);
+    // each sample group gets its own bins so that they can be sealed when the lanes of the group are done
+    const unsigned binGroups = barcodeBinGroups_.empty() ?
+        1 : *std::max_element(barcodeBinGroups_.begin(), barcodeBinGroups_.end()) + 1;
     alignment::matchSelector::BinIndexMap binIndexMap(
-        matchDistribution, fragmentsPerBin, "skip-empty" == binRegexString_);
+        matchDistribution, fragmentsPerBin * binGroups, "skip-empty" == binRegexString_, barcodeBinGroups_);
 
     binMetadataList =
         buildBinPathList(binIndexMap, tempDirectory_, barcodeMetadataList_,
                          binIndexMap.getTotalBins() * fragmentsPerBin,
                          preSortBins_);
 
-    ISAAC_THREAD_CERR << "Selecting matches using " << fragmentsPerBin << " fragments per bin limit. expectedBinSize: " << expectedBinSize << " bytes" << std::endl;
+    binGroups_.clear();
+    if (!barcodeBinGroups_.empty())
+    {
+        BOOST_FOREACH(const alignment::BinMetadata &bin, binMetadataList)
+        {
+            binGroups_.push_back(binIndexMap.getBinGroup(bin.getIndex()));
+        }
+    }
+
+    ISAAC_THREAD_CERR << "Selecting matches using " << fragmentsPerBin << " fragments per bin limit. expectedBinSize: " << expectedBinSize << " bytes" <<
+        " fragment storage buffers: " << alignment::matchSelector::FragmentBinner::getMemoryRequirements(coresMax_) << " bytes" <<
+        " tile buffers: " << getTileBuffersMemory() << " bytes" <<
+        " match selector buffers: " << matchSelector_.getReservedMemory() << " bytes" << std::endl;
 
 
     std::unique_ptr<alignment::matchSelector::FragmentStorage> storagePtr(!bufferBins_ ?
         static_cast<alignment::matchSelector::FragmentStorage*>(new alignment::matchSelector::BinningFragmentStorage(
                             keepUnaligned_,
                             binIndexMap, binMetadataList,
-                            preAllocateBins_ ? expectedBinSize : 0)) :
+                            preAllocateBins_ ? expectedBinSize : 0,
+                            coresMax_)) :
         static_cast<alignment::matchSelector::FragmentStorage*>(new alignment::matchSelector::BufferingFragmentStorage(
                         keepUnaligned_, coresMax_, tempSaversMax_,
                         binIndexMap, binMetadataList,
                         flowcellLayoutList_,
                         preAllocateBins_ ? expectedBinSize : 0)));
 
+    if (binQueue_)
+    {
+        binQueue_->open(binMetadataList);
+    }
+
 #ifdef ISAAC_DEV_STATS_ENABLED
         alignment::matchSelector::DebugStorage debugStorage(
             contigLists_.node0Container(), kUniquenessAnnotations_.node0Container(),
             alignmentCfg_, flowcellLayoutList_, demultiplexingStatsXmlPath_.parent_path(), *storagePtr);
-        alignFlowcells(referenceHash, barcodeTemplateLengthStatistics, demultiplexingStats, ret, debugStorage);
+        if (binQueue_)
+        {
+            expectLanes(binMetadataList, debugStorage);
+        }
+        alignFlowcells(referenceHash, binMetadataList, barcodeTemplateLengthStatistics, demultiplexingStats, ret, debugStorage);
 #else
-        alignFlowcells(referenceHash, barcodeTemplateLengthStatistics, demultiplexingStats, ret, *storagePtr);
+        if (binQueue_)
+        {
+            expectLanes(binMetadataList, *storagePtr);
+        }
+        alignFlowcells(referenceHash, binMetadataList, barcodeTemplateLengthStatistics, demultiplexingStats, ret, *storagePtr);
 #endif
 
 }
 
+void FindHashMatchesTransition::releaseAlignmentMemory(const uint64_t &bytes, const bool exceptionUnwinding) const
+{
+    if (bytes)
+    {
+        binQueue_->releaseMemory(bytes);
+    }
+}
+
 template <typename KmerT>
 void FindHashMatchesTransition::align(
     FoundMatchesMetadata &foundMatches,
@@ -741,20 +913,44 @@ void FindHashMatchesTransition::align(
     const boost::filesystem::path &matchSelectorStatsXmlPath)
 {
 
-    typedef reference::ReferenceHash<KmerT, common::NumaAllocator<void, 0> > ReferenceHashT;
-    const reference::NumaReferenceHash<ReferenceHashT> referenceHash(
-        buildReferenceHash<ReferenceHashT>(
-            sortedReferenceMetadataList_.front(), contigLists_.node0Container().front(), threads_, coresMax_));
-
-    FoundMatchesMetadata ret(tempDirectory_, barcodeMetadataList_, 1, sortedReferenceMetadataList_);
-    demultiplexing::DemultiplexingStats demultiplexingStats(flowcellLayoutList_, barcodeMetadataList_);
+    // memory Build can't have while alignment is running. Given back once the reference hash is gone.
+    uint64_t alignmentMemory = 0;
+    ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&FindHashMatchesTransition::releaseAlignmentMemory, this, boost::cref(alignmentMemory), _1))
+    {
+        typedef reference::ReferenceHash<KmerT, common::NumaAllocator<void, 0, true> > ReferenceHashT;
+        const reference::NumaReferenceHash<ReferenceHashT> referenceHash(
+            referenceHashDirectory_.empty() ?
+                reference::NumaReferenceHash<ReferenceHashT>(
+                    buildReferenceHash<ReferenceHashT>(
+                        sortedReferenceMetadataList_.front(), contigLists_.node0Container().front(), threads_, coresMax_)) :
+                reference::loadReferenceHash<ReferenceHashT>(
+                    referenceHashDirectory_ / ("ReferenceHash-" + boost::lexical_cast<std::string>(
+                        oligo::KmerTraits<KmerT>::KMER_BASES) + ".dat"),
+                    sortedReferenceMetadataList_.front(), contigLists_.node0Container().front(), threads_, coresMax_,
+                    referenceHashNumaReplicas_));
+
+        const std::size_t referenceHashBytes = referenceHash.getBytes();
+        const std::size_t referenceHashHugePageBytes = referenceHash.getHugePageBackedBytes();
+        ISAAC_THREAD_CERR << "Reference hash: " << referenceHashHugePageBytes << " of " << referenceHashBytes <<
+            " bytes huge-page backed (" << (referenceHashBytes ? referenceHashHugePageBytes * 100 / referenceHashBytes : 0) << "%)" << std::endl;
+
+        if (binQueue_)
+        {
+            alignmentMemory = referenceHashBytes + matchSelector_.getReservedMemory() +
+                alignment::matchSelector::FragmentBinner::getMemoryRequirements(coresMax_) + getTileBuffersMemory();
+            binQueue_->reserveAlignmentMemory(alignmentMemory);
+        }
 
-    alignFlowcells(referenceHash, binMetadataList, barcodeTemplateLengthStatistics, demultiplexingStats, ret);
+        FoundMatchesMetadata ret(tempDirectory_, barcodeMetadataList_, 1, sortedReferenceMetadataList_);
+        demultiplexing::DemultiplexingStats demultiplexingStats(flowcellLayoutList_, barcodeMetadataList_);
 
-    dumpStats(demultiplexingStats, ret.tileMetadataList_);
-    foundMatches.swap(ret);
+        alignFlowcells(referenceHash, binMetadataList, barcodeTemplateLengthStatistics, demultiplexingStats, ret);
 
-    matchSelector_.unreserve();
+        dumpStats(demultiplexingStats, ret.tileMetadataList_);
+        foundMatches.swap(ret);
+        // free the per-thread buffers before their memory goes back to Build
+        matchSelector_.unreserve();
+    }
 
     matchSelector_.dumpStats(matchSelectorStatsXmlPath);
 }
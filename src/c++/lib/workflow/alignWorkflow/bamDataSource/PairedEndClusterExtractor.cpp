@@ -17,6 +17,8 @@
  ** \author Roman Petrovski
  **/
 
+#include <fstream>
+
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/integer/static_min_max.hpp>
@@ -91,7 +93,7 @@ void UnpairedReadsCache::storeUnpaired(
 
         const bam::BamBlockHeader &block = idx.getBlock();
 
-        const unsigned nameCrc = getNameCrc<7>(crcWidth_, block.nameBegin(), block.getReadNameLength());
+        const unsigned nameCrc = getPartition(block.nameBegin(), block.getReadNameLength());
         std::ostream os(tempFiles_[nameCrc].get());
 
         const unsigned nameLength = block.getReadNameLength();
@@ -132,6 +134,103 @@ void UnpairedReadsCache::storeUnpaired(
     }
 }
 
+bool UnpairedReadsCache::openNextPartition()
+{
+    while (!pendingPartitions_.empty())
+    {
+        const Partition partition = pendingPartitions_.front();
+        pendingPartitions_.pop_front();
+        if (partition.size_ > memoryLimit_ && SPLIT_LEVELS_MAX > partition.level_)
+        {
+            splitPartition(partition);
+        }
+        else
+        {
+            if (partition.size_ > memoryLimit_)
+            {
+                ISAAC_THREAD_CERR << "WARNING: unpaired segments file " << partition.path_ << " of " << partition.size_ <<
+                    " bytes exceeds the memory limit of " << memoryLimit_ << " bytes after " << partition.level_ << " splits" << std::endl;
+            }
+            extractor_.open(partition.path_, partition.size_);
+            return true;
+        }
+    }
+    return false;
+}
+
+void UnpairedReadsCache::splitPartition(const Partition &partition)
+{
+    std::size_t fanout = 2;
+    while (fanout < tempFiles_.size() && fanout * memoryLimit_ < partition.size_)
+    {
+        fanout *= 2;
+    }
+
+    ISAAC_THREAD_CERR << "Splitting unpaired segments file " << partition.path_ << " of " << partition.size_ <<
+        " bytes into " << fanout << " parts" << std::endl;
+
+    std::vector<Partition> parts;
+    const std::string basePath = partition.path_.substr(0, partition.path_.size() - std::strlen(".tmp"));
+    for (std::size_t sub = 0; fanout != sub; ++sub)
+    {
+        std::string subPath = basePath;
+        subPath += '-';
+        common::appendUnsignedInteger(subPath, sub);
+        subPath += ".tmp";
+        unlink(subPath.c_str());
+        tempFiles_[sub].reopen(subPath.c_str(), io::FileBufWithReopen::SequentialOnce);
+        splitFilePaths_.push_back(subPath);
+        parts.push_back(Partition(subPath, 0, partition.level_ + 1));
+    }
+
+    std::ifstream is(partition.path_.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!is)
+    {
+        BOOST_THROW_EXCEPTION(isaac::common::IoException(
+            errno, (boost::format("Unable to open file for reading %s") % partition.path_).str()));
+    }
+
+    // records are [recordLength][flags][zero-terminated name][bcl]
+    std::vector<char> record;
+    unsigned recordLength = 0;
+    while (is.read(reinterpret_cast<char*>(&recordLength), sizeof(recordLength)))
+    {
+        record.resize(recordLength);
+        std::copy(reinterpret_cast<const char*>(&recordLength),
+                  reinterpret_cast<const char*>(&recordLength) + sizeof(recordLength), record.begin());
+        if (!is.read(&record.front() + sizeof(recordLength), recordLength - sizeof(recordLength)))
+        {
+            BOOST_THROW_EXCEPTION(isaac::common::IoException(
+                errno, (boost::format("Unable to read %d bytes from %s") % recordLength % partition.path_).str()));
+        }
+
+        const char *name = &record.front() + sizeof(recordLength) + sizeof(TempFileClusterExtractor::FlagsType);
+        boost::crc_32_type crc;
+        crc.process_bytes(name, std::strlen(name));
+        // Top level partitions come from the 5-7 bit name crc, which crc32 does not depend on. Each split takes the
+        // next 8 bits of crc32 as all records of a sub-partition agree on the bits taken by the splits before.
+        const std::size_t sub = (crc.checksum() >> (partition.level_ * 8)) & (fanout - 1);
+
+        std::ostream os(tempFiles_[sub].get());
+        if (!os.write(&record.front(), record.size()))
+        {
+            BOOST_THROW_EXCEPTION(isaac::common::IoException(
+                errno, (boost::format("Failed to write: %d bytes into %s") % record.size() % parts[sub].path_).str()));
+        }
+        parts[sub].size_ += record.size();
+    }
+    if (!is.eof())
+    {
+        BOOST_THROW_EXCEPTION(isaac::common::IoException(
+            errno, (boost::format("Failed to read %s") % partition.path_).str()));
+    }
+
+    std::for_each(tempFiles_.begin(), tempFiles_.begin() + fanout,
+                  boost::bind(&io::FileBufHolder<io::FileBufWithReopen>::flush, _1));
+
+    pendingPartitions_.insert(pendingPartitions_.begin(), parts.begin(), parts.end());
+}
+
 void PairedEndClusterExtractor::reset()
 {
     firstUnextracted_ = end();
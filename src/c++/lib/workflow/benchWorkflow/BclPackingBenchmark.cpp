@@ -0,0 +1,106 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BclPackingBenchmark.cpp
+ **
+ ** Measures the fastq to bcl conversion rate of each supported packing kernel.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstdlib>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "oligo/BclPacking.hh"
+#include "workflow/benchWorkflow/BclPackingBenchmark.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace benchWorkflow
+{
+
+/**
+ * \brief Mostly ACGT with the occasional N, uniform qualities
+ */
+static void generateReads(
+    const options::BenchmarkBclPackingOptions &options,
+    std::vector<char> &bases,
+    std::vector<char> &qualities)
+{
+    static const char acgt[] = {'A', 'C', 'G', 'T'};
+    const std::size_t length = std::size_t(options.readLength) * options.reads;
+    bases.resize(length);
+    qualities.resize(length);
+    unsigned state = 1;
+    for (std::size_t i = 0; length != i; ++i)
+    {
+        const unsigned r = rand_r(&state);
+        bases[i] = r % 100 ? acgt[r % 4] : 'N';
+        qualities[i] = options.q0 + (r >> 8) % 42;
+    }
+}
+
+void benchmarkBclPacking(const options::BenchmarkBclPackingOptions &options)
+{
+    std::vector<char> bases;
+    std::vector<char> qualities;
+    generateReads(options, bases, qualities);
+
+    std::vector<char> scalarBcl;
+    double scalarRate = 0.0;
+    for (unsigned k = 0; oligo::BclPackingKernelCount != k; ++k)
+    {
+        const oligo::BclPackingKernel kernel = oligo::BclPackingKernel(k);
+        if (!oligo::isBclPackingKernelSupported(kernel))
+        {
+            std::cout << (boost::format("%-8s not supported") % oligo::getBclPackingKernelName(kernel)).str() << std::endl;
+            continue;
+        }
+
+        std::vector<char> bcl(bases.size());
+        const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        for (unsigned repeat = 0; options.repeats != repeat; ++repeat)
+        {
+            // one call per read the way FastqReader::extractBcl does it
+            for (std::size_t offset = 0; bases.size() != offset; offset += options.readLength)
+            {
+                const std::size_t packed = oligo::packBcl(
+                    kernel, &bases[offset], &qualities[offset], options.readLength, options.q0, &bcl[offset]);
+                ISAAC_ASSERT_MSG(options.readLength == packed, "Unexpected stop at " << offset + packed);
+            }
+        }
+        const double seconds =
+            (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+        const double rate = double(bases.size()) * options.repeats / std::max(seconds, 0.000001);
+
+        if (scalarBcl.empty())
+        {
+            scalarBcl.swap(bcl);
+            scalarRate = rate;
+        }
+        else
+        {
+            ISAAC_ASSERT_MSG(scalarBcl == bcl, oligo::getBclPackingKernelName(kernel) << " kernel produced different bcl from the scalar one");
+        }
+        std::cout << (boost::format("%-8s %12.0f bases/s (%.2fx)") %
+            oligo::getBclPackingKernelName(kernel) % rate % (rate / scalarRate)).str() << std::endl;
+    }
+}
+
+} // namespace benchWorkflow
+} // namespace workflow
+} // namespace isaac
@@ -0,0 +1,195 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file RadixSortBenchmark.cpp
+ **
+ ** Compares ParallelSorter against the radix sort on bin-like sets of reference positions.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstdlib>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/ParallelSort.hpp"
+#include "common/RadixSort.hpp"
+#include "reference/ReferencePosition.hh"
+#include "workflow/benchWorkflow/RadixSortBenchmark.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace benchWorkflow
+{
+
+/**
+ * \brief Same size as PackedFragmentBuffer::Index. The position goes first, the rest is payload.
+ */
+struct Element
+{
+    reference::ReferencePosition pos_;
+    uint64_t payload_[5];
+    bool operator <(const Element &that) const {return pos_ < that.pos_;}
+};
+
+static bool recordLess(const common::RadixSortRecord &left, const common::RadixSortRecord &right)
+{
+    return left.key_ < right.key_;
+}
+
+/**
+ * \brief Positions uniformly spread over a bin somewhere in the middle of a chromosome, both strands
+ */
+static std::vector<Element> generateElements(const options::BenchmarkRadixSortOptions &options)
+{
+    std::vector<Element> ret(options.records);
+    const uint64_t binStart = 100000000;
+    unsigned state = 1;
+    for (std::size_t i = 0; ret.size() != i; ++i)
+    {
+        const uint64_t offset = (uint64_t(rand_r(&state)) * RAND_MAX + rand_r(&state)) % options.binLength;
+        ret[i].pos_ = reference::ReferencePosition(3, binStart + offset, false, rand_r(&state) % 2);
+        ret[i].payload_[0] = i;
+    }
+    return ret;
+}
+
+template <typename F>
+static double bestSeconds(const unsigned repeats, F f)
+{
+    double ret = 0.0;
+    for (unsigned repeat = 0; repeats != repeat; ++repeat)
+    {
+        const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        f();
+        const double seconds =
+            (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+        ret = repeat ? std::min(ret, seconds) : seconds;
+    }
+    return std::max(ret, 0.000001);
+}
+
+static void report(const char *name, const std::size_t records, const double seconds, const double referenceSeconds)
+{
+    std::cout << (boost::format("%-40s %8.3fs %12.0f records/s (%.2fx)") %
+        name % seconds % (records / seconds) % (referenceSeconds / seconds)).str() << std::endl;
+}
+
+void benchmarkRadixSort(const options::BenchmarkRadixSortOptions &options)
+{
+    common::ThreadVector threads(options.threads);
+    const std::vector<Element> elements = generateElements(options);
+
+    std::vector<common::RadixSortRecord> unsortedRecords;
+    unsortedRecords.reserve(elements.size());
+    for (const Element &element : elements)
+    {
+        unsortedRecords.push_back(common::RadixSortRecord(element.pos_.getValue(), element.payload_[0]));
+    }
+
+    // keys only
+    std::vector<common::RadixSortRecord> expectedRecords;
+    const double parallelSorterSeconds = bestSeconds(
+        options.repeats,
+        [&]()
+        {
+            expectedRecords = unsortedRecords;
+            common::parallelSort(expectedRecords.begin(), expectedRecords.end(), &recordLess, threads, threads.size());
+        });
+    report("ParallelSorter records", elements.size(), parallelSorterSeconds, parallelSorterSeconds);
+
+    std::vector<common::RadixSortRecord> records;
+    std::vector<common::RadixSortRecord> buffer(elements.size());
+    const double radixSeconds = bestSeconds(
+        options.repeats,
+        [&]()
+        {
+            records = unsortedRecords;
+            common::RadixSorter::sort(&records.front(), &records.front() + records.size(), &buffer.front());
+        });
+    for (std::size_t i = 0; records.size() != i; ++i)
+    {
+        ISAAC_ASSERT_MSG(expectedRecords[i].key_ == records[i].key_, "Radix sort produced different order at " << i);
+    }
+    report("RadixSorter records, 1 thread", elements.size(), radixSeconds, parallelSorterSeconds);
+
+    const double radixThreadsSeconds = bestSeconds(
+        options.repeats,
+        [&]()
+        {
+            records = unsortedRecords;
+            common::RadixSorter::sort(
+                &records.front(), &records.front() + records.size(), &buffer.front(), threads, threads.size());
+        });
+    for (std::size_t i = 0; records.size() != i; ++i)
+    {
+        ISAAC_ASSERT_MSG(expectedRecords[i].key_ == records[i].key_, "Threaded radix sort produced different order at " << i);
+    }
+    report((boost::format("RadixSorter records, %d threads") % options.threads).str().c_str(),
+           elements.size(), radixThreadsSeconds, parallelSorterSeconds);
+
+    // whole index entries the way BamSerializer::prepareForBam sorts them
+    std::vector<Element> expectedElements;
+    const double parallelSorterElementsSeconds = bestSeconds(
+        options.repeats,
+        [&]()
+        {
+            expectedElements = elements;
+            common::parallelSort(expectedElements.begin(), expectedElements.end(), std::less<Element>(), threads, threads.size());
+        });
+    report("ParallelSorter elements", elements.size(), parallelSorterElementsSeconds, parallelSorterElementsSeconds);
+
+    common::RadixSortRecords sortRecords;
+    sortRecords.reserve(elements.size() * 2);
+    std::vector<Element> sortedElements;
+    const double radixElementsSeconds = bestSeconds(
+        options.repeats,
+        [&]()
+        {
+            sortedElements = elements;
+            common::radixSort(
+                sortedElements.begin(), sortedElements.end(),
+                [](const Element &element){return element.pos_.getValue();},
+                std::less<Element>(), sortRecords);
+        });
+    for (std::size_t i = 0; sortedElements.size() != i; ++i)
+    {
+        ISAAC_ASSERT_MSG(expectedElements[i].pos_ == sortedElements[i].pos_, "radixSort produced different order at " << i);
+    }
+    report("radixSort elements in place, 1 thread", elements.size(), radixElementsSeconds, parallelSorterElementsSeconds);
+
+    // BinData reserves twice the index size which leaves room for gathering
+    sortedElements.reserve(elements.size() * 2);
+    const double radixGatherSeconds = bestSeconds(
+        options.repeats,
+        [&]()
+        {
+            sortedElements.assign(elements.begin(), elements.end());
+            common::radixSort(
+                sortedElements,
+                [](const Element &element){return element.pos_.getValue();},
+                std::less<Element>(), sortRecords);
+        });
+    for (std::size_t i = 0; sortedElements.size() != i; ++i)
+    {
+        ISAAC_ASSERT_MSG(expectedElements[i].pos_ == sortedElements[i].pos_, "Gathering radixSort produced different order at " << i);
+    }
+    report("radixSort elements gathered, 1 thread", elements.size(), radixGatherSeconds, parallelSorterElementsSeconds);
+}
+
+} // namespace benchWorkflow
+} // namespace workflow
+} // namespace isaac
@@ -0,0 +1,244 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file SeedLookupBenchmark.cpp
+ **
+ ** Measures the seed lookup rate of the aligner with and without prefetching the reference hash data of the
+ ** upcoming clusters, the way MatchSelector does it.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "alignment/BclClusters.hh"
+#include "alignment/Cluster.hh"
+#include "alignment/HashMatchFinder.hh"
+#include "common/Threads.hpp"
+#include "oligo/Kmer.hh"
+#include "oligo/Nucleotides.hh"
+#include "reference/ContigLoader.hh"
+#include "reference/ReferenceHash.hh"
+#include "reference/SortedReferenceXml.hh"
+#include "workflow/benchWorkflow/SeedLookupBenchmark.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace benchWorkflow
+{
+
+typedef oligo::ShortKmerType KmerT;
+typedef reference::ReferenceHash<KmerT, common::NumaAllocator<void, 0, true> > ReferenceHashT;
+typedef reference::NumaReferenceHash<ReferenceHashT> NumaReferenceHashT;
+typedef alignment::SeedHashMatchFinder<NumaReferenceHashT> MatchFinderT;
+
+// same as the isaac-align defaults
+static const unsigned SEED_BASE_QUALITY_MIN = 10;
+static const unsigned REPEAT_THRESHOLD = 10;
+static const unsigned BASE_QUALITY = 30;
+
+/**
+ * \brief Fills clusters with reads taken at random reference positions on either strand so that most seeds hit,
+ *        the way the seeds of real reads do
+ */
+static void generateClusters(
+    const reference::ContigList &contigList,
+    const unsigned readLength,
+    unsigned &state,
+    alignment::BclClusters &clusters)
+{
+    static const oligo::Translator<> translator;
+    for (std::size_t cluster = 0; clusters.getClusterCount() != cluster;)
+    {
+        const reference::Contig &contig = contigList.at(rand_r(&state) % contigList.size());
+        if (contig.size() < readLength)
+        {
+            continue;
+        }
+        const std::size_t pos = (std::size_t(rand_r(&state)) * RAND_MAX + rand_r(&state)) % (contig.size() - readLength + 1);
+        const bool reverse = rand_r(&state) % 2;
+        alignment::BclClusters::iterator bcl = clusters.cluster(cluster);
+        bool valid = true;
+        for (unsigned i = 0; readLength != i && valid; ++i, ++bcl)
+        {
+            const unsigned value = translator[contig[reverse ? pos + readLength - 1 - i : pos + i]];
+            valid = oligo::INVALID_OLIGO != value;
+            *bcl = char((BASE_QUALITY << 2) | ((reverse ? ~value : value) & oligo::BITS_PER_BASE_MASK));
+        }
+        cluster += valid;
+    }
+}
+
+/**
+ * \brief one seed followed by its extension per each 32 bases of the read, as the auto seed descriptor does it
+ */
+static alignment::SeedMetadataList makeSeeds(const unsigned readLength)
+{
+    static const unsigned SEED_LENGTH = oligo::KmerTraits<KmerT>::KMER_BASES;
+    alignment::SeedMetadataList ret;
+    for (unsigned offset = 0; readLength >= offset + SEED_LENGTH * 2; offset += SEED_LENGTH * 2)
+    {
+        ret.push_back(alignment::SeedMetadata(offset, SEED_LENGTH, 0, ret.size()));
+    }
+    return ret;
+}
+
+/**
+ * \brief Looks up the seeds of every cluster. With prefetchClustersAhead set, prefetches the hash data the same way
+ *        MatchSelector::alignThread does: offsets for the cluster prefetchClustersAhead iterations ahead and
+ *        positions for the one half way ahead.
+ *
+ * \return number of matches found
+ */
+static std::size_t findMatches(
+    const MatchFinderT &matchFinder,
+    const alignment::BclClusters &clusters,
+    const flowcell::ReadMetadataList &readMetadataList,
+    const alignment::SeedMetadataList &seedMetadataList,
+    const unsigned prefetchClustersAhead,
+    alignment::Cluster &cluster,
+    alignment::Matches &matches)
+{
+    const std::size_t clustersEnd = clusters.getClusterCount();
+    for (std::size_t clusterId = 0; prefetchClustersAhead != clusterId && clustersEnd != clusterId; ++clusterId)
+    {
+        matchFinder.prefetchSeedMatches(clusters.cluster(clusterId), readMetadataList, seedMetadataList, 0, false);
+    }
+
+    std::size_t ret = 0;
+    std::size_t repeatSeeds = 0;
+    for (std::size_t clusterId = 0; clustersEnd != clusterId; ++clusterId)
+    {
+        if (prefetchClustersAhead && clustersEnd > clusterId + prefetchClustersAhead)
+        {
+            matchFinder.prefetchSeedMatches(
+                clusters.cluster(clusterId + prefetchClustersAhead), readMetadataList, seedMetadataList, 0, false);
+        }
+        if (prefetchClustersAhead && clustersEnd > clusterId + prefetchClustersAhead / 2)
+        {
+            matchFinder.prefetchSeedMatches(
+                clusters.cluster(clusterId + prefetchClustersAhead / 2), readMetadataList, seedMetadataList, 0, true);
+        }
+
+        cluster.init(readMetadataList, clusters.cluster(clusterId), 0, clusterId,
+                     alignment::ClusterXy(0, 0), true, 0, 0);
+        matches.clear();
+        for (const alignment::SeedMetadata &seedMetadata : seedMetadataList)
+        {
+            matchFinder.findSeedMatches(
+                cluster, seedMetadata, readMetadataList.at(seedMetadata.getReadIndex()), matches, repeatSeeds);
+        }
+        ret += matches.size();
+    }
+    return ret;
+}
+
+static NumaReferenceHashT loadHash(
+    const boost::filesystem::path &sortedReferenceXml,
+    const reference::SortedReferenceMetadata &sortedReferenceMetadata,
+    const reference::ContigList &contigList,
+    common::ThreadVector &threads)
+{
+    const boost::filesystem::path hashPath = sortedReferenceXml.parent_path() /
+        ("ReferenceHash-" + boost::lexical_cast<std::string>(oligo::KmerTraits<KmerT>::KMER_BASES) + ".dat");
+    const boost::uint64_t fingerprint = reference::computeReferenceHashFingerprint(sortedReferenceMetadata);
+    if (reference::isReferenceHashFileValid(hashPath, oligo::KmerTraits<KmerT>::KMER_BASES, fingerprint))
+    {
+        return NumaReferenceHashT(reference::MappedReferenceHash<KmerT>(hashPath, fingerprint));
+    }
+    reference::ReferenceHasher<ReferenceHashT> hasher(sortedReferenceMetadata, contigList, threads, threads.size());
+    return NumaReferenceHashT(hasher.generate());
+}
+
+void benchmarkSeedLookup(const options::BenchmarkSeedLookupOptions &options)
+{
+    const reference::SortedReferenceMetadata sortedReferenceMetadata =
+        reference::loadSortedReferenceXml(options.sortedReferenceXml);
+    common::ThreadVector threads(options.threads);
+    const reference::ContigList contigList =
+        reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+
+    const NumaReferenceHashT referenceHash = loadHash(options.sortedReferenceXml, sortedReferenceMetadata, contigList, threads);
+    const MatchFinderT matchFinder(referenceHash, SEED_BASE_QUALITY_MIN, REPEAT_THRESHOLD);
+
+    std::vector<unsigned> cycles;
+    while (cycles.size() != options.readLength)
+    {
+        cycles.push_back(cycles.size() + 1);
+    }
+    const flowcell::ReadMetadataList readMetadataList(
+        1, flowcell::ReadMetadata(1, cycles, 0, 0, cycles.front()));
+    const alignment::SeedMetadataList seedMetadataList = makeSeeds(options.readLength);
+
+    enum {PLAIN, PREFETCHED, MODES};
+    std::vector<std::vector<double> > threadSeconds(options.threads, std::vector<double>(MODES, 0.0));
+    std::vector<std::vector<std::size_t> > threadMatches(options.threads, std::vector<std::size_t>(MODES, 0));
+
+    threads.execute(
+        [&](const unsigned threadNumber, const std::size_t)
+        {
+            unsigned state = threadNumber + 1;
+            alignment::Cluster cluster(options.readLength);
+            alignment::Matches matches;
+            matches.reserve(seedMetadataList.size() * REPEAT_THRESHOLD * 2);
+            std::vector<alignment::BclClusters> modeClusters(MODES, alignment::BclClusters(options.readLength));
+
+            for (unsigned round = 0; options.rounds != round; ++round)
+            {
+                // Fresh clusters for each mode so that neither finds the hash data brought in by the other.
+                // The mode that goes first alternates to cancel out whatever the first pass leaves behind.
+                for (alignment::BclClusters &clusters : modeClusters)
+                {
+                    clusters.reset(options.readLength, options.clusters);
+                    generateClusters(contigList, options.readLength, state, clusters);
+                }
+                for (unsigned i = 0; MODES != i; ++i)
+                {
+                    const unsigned mode = (i + round) % MODES;
+                    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+                    threadMatches[threadNumber][mode] += findMatches(
+                        matchFinder, modeClusters[mode], readMetadataList, seedMetadataList,
+                        PREFETCHED == mode ? options.prefetchClustersAhead : 0, cluster, matches);
+                    threadSeconds[threadNumber][mode] +=
+                        (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000000.0;
+                }
+            }
+        }, options.threads);
+
+    const double clusters = double(options.clusters) * options.rounds;
+    std::vector<double> totals(MODES, 0.0);
+    for (unsigned threadNumber = 0; options.threads != threadNumber; ++threadNumber)
+    {
+        const std::vector<double> &seconds = threadSeconds[threadNumber];
+        const std::vector<std::size_t> &matches = threadMatches[threadNumber];
+        std::cout << (boost::format("thread %3d: plain %10.0f clusters/s prefetched %10.0f clusters/s (%.2fx) "
+                                    "matches per cluster %.2f/%.2f") %
+            threadNumber % (clusters / std::max(seconds[PLAIN], 0.000001)) %
+            (clusters / std::max(seconds[PREFETCHED], 0.000001)) %
+            (seconds[PLAIN] / std::max(seconds[PREFETCHED], 0.000001)) %
+            (matches[PLAIN] / clusters) % (matches[PREFETCHED] / clusters)).str() << std::endl;
+        totals[PLAIN] += seconds[PLAIN];
+        totals[PREFETCHED] += seconds[PREFETCHED];
+    }
+    std::cout << (boost::format("per thread: plain %10.0f clusters/s prefetched %10.0f clusters/s (%.2fx)") %
+        (clusters * options.threads / std::max(totals[PLAIN], 0.000001)) %
+        (clusters * options.threads / std::max(totals[PREFETCHED], 0.000001)) %
+        (totals[PLAIN] / std::max(totals[PREFETCHED], 0.000001))).str() << std::endl;
+}
+
+} // namespace benchWorkflow
+} // namespace workflow
+} // namespace isaac
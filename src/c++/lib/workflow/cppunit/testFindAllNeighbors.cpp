@@ -0,0 +1,303 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testFindAllNeighbors.cpp
+ **
+ ** Test cases for FindAllNeighborsWorkflow. The annotations must be the same as the ones produced by the chain of
+ ** findNeighbors and mergeAnnotations runs FindNeighbors.mk used to have.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "common/Exceptions.hh"
+#include "reference/ReferenceSorter.hh"
+#include "reference/SortedReferenceXml.hh"
+#include "reference/neighborsFinder/NeighborCounter.hh"
+#include "workflow/FindAllNeighborsWorkflow.hh"
+#include "workflow/MergeAnnotationsWorkflow.hh"
+#include "workflow/NeighborsFinderWorkflow.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testFindAllNeighbors.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFindAllNeighbors, registryName("TestFindAllNeighbors"));
+
+static const unsigned MASK_WIDTH = 1;
+static const unsigned JOBS = 2;
+static const std::vector<unsigned> SEED_LENGTHS = {16, 20};
+
+TestFindAllNeighbors::TestFindAllNeighbors()
+{
+}
+
+static std::string randomBases(const std::size_t length, unsigned &state)
+{
+    std::string ret;
+    while (ret.size() < length)
+    {
+        ret += "ACGT"[rand_r(&state) % 4];
+    }
+    return ret;
+}
+
+/**
+ * \brief copy of the sequence with every mismatchStep-th base changed
+ */
+static std::string mutate(std::string sequence, const std::size_t mismatchStep)
+{
+    for (std::size_t pos = mismatchStep - 1; sequence.size() > pos; pos += mismatchStep)
+    {
+        sequence[pos] = 'A' == sequence[pos] ? 'C' : 'A';
+    }
+    return sequence;
+}
+
+/**
+ * \brief Sorts the k-mers of every mask the way sortReference does and returns the mask files sortReference
+ *        prints on its standard output
+ */
+template <typename KmerT>
+static reference::SortedReferenceMetadata::MaskFiles sortMasks(
+    const boost::filesystem::path &contigsXml,
+    const boost::filesystem::path &tempDirectory)
+{
+    const unsigned seedLength = oligo::KmerTraits<KmerT>::KMER_BASES;
+    reference::SortedReferenceMetadata::MaskFiles ret;
+    for (unsigned mask = 0; (1U << MASK_WIDTH) != mask; ++mask)
+    {
+        const boost::filesystem::path maskFile = tempDirectory /
+            ("neighbor-positions-" + boost::lexical_cast<std::string>(seedLength) + "-" +
+                boost::lexical_cast<std::string>(mask) + ".dat");
+        reference::ReferenceSorter<KmerT> referenceSorter(
+            MASK_WIDTH, mask, contigsXml, boost::filesystem::path(), maskFile, 0, 0);
+
+        std::ostringstream xml;
+        std::streambuf *coutBuf = std::cout.rdbuf(xml.rdbuf());
+        referenceSorter.run();
+        std::cout.rdbuf(coutBuf);
+
+        std::istringstream is(xml.str());
+        const reference::SortedReferenceMetadata sorted = reference::loadSortedReferenceXml(is);
+        const reference::SortedReferenceMetadata::MaskFiles &maskFiles = sorted.getMaskFileList(seedLength);
+        ret.insert(ret.end(), maskFiles.begin(), maskFiles.end());
+    }
+    return ret;
+}
+
+void TestFindAllNeighbors::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+
+    // chr2 has a near copy of a piece of chr1 that 16-mers see with 0 or 1 mismatches and 20-mers with 1 or 2,
+    // and an exact copy of another piece
+    unsigned state = 1;
+    const std::string chr1 = randomBases(1200, state);
+    const std::string chr2 = randomBases(200, state) + mutate(chr1.substr(100, 300), 17) +
+        randomBases(200, state) + chr1.substr(700, 100) + randomBases(100, state);
+
+    const boost::filesystem::path fastaPath = tempFile("genome.fa");
+    std::ofstream fasta(fastaPath.c_str());
+    fasta << ">chr1\n" << chr1 << "\n>chr2\n" << chr2 << "\n";
+    fasta.close();
+    CPPUNIT_ASSERT(fasta);
+
+    reference::SortedReferenceMetadata sortedReferenceMetadata;
+    sortedReferenceMetadata.putContig(
+        0, "chr1", fastaPath, 6, chr1.size(), chr1.size(), chr1.size(), 0, 0, "", "", "");
+    sortedReferenceMetadata.putContig(
+        chr1.size(), "chr2", fastaPath, 6 + chr1.size() + 7, chr2.size(), chr2.size(), chr2.size(), 1, 1, "", "", "");
+    const boost::filesystem::path contigsXml = tempFile("contigs.xml");
+    reference::saveSortedReferenceXml(contigsXml, sortedReferenceMetadata);
+
+    sortedReferenceMetadata.getMaskFileList(16) = sortMasks<oligo::BasicKmerType<16> >(contigsXml, tempDirectory_);
+    sortedReferenceMetadata.getMaskFileList(20) = sortMasks<oligo::BasicKmerType<20> >(contigsXml, tempDirectory_);
+    sortedReferenceXml_ = tempFile("sorted-reference.xml");
+    reference::saveSortedReferenceXml(sortedReferenceXml_, sortedReferenceMetadata);
+}
+
+void TestFindAllNeighbors::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+static void mergeAnnotations(
+    const boost::filesystem::path &sortedReferenceXml,
+    const std::vector<boost::filesystem::path> &filesToMerge,
+    const boost::filesystem::path &outputFile,
+    const std::vector<std::string> &aggregateFunctions,
+    const std::string &mergedType)
+{
+    workflow::MergeAnnotationsWorkflow workflow(
+        sortedReferenceXml, filesToMerge, outputFile, aggregateFunctions, mergedType);
+    workflow.run();
+}
+
+/**
+ * \brief Runs the findNeighbors and mergeAnnotations steps FindNeighbors.mk had before findAllNeighbors
+ */
+void TestFindAllNeighbors::mergeChain(
+    const boost::filesystem::path &uniquenessFile,
+    const boost::filesystem::path &repeatnessFile) const
+{
+    std::vector<boost::filesystem::path> uniquenessParts(1, "init-kul-65535");
+    std::vector<boost::filesystem::path> repeatnessParts(1, "init-kul-65535");
+    std::vector<std::string> masks;
+    BOOST_FOREACH(const unsigned seedLength, SEED_LENGTHS)
+    {
+        const std::string s = boost::lexical_cast<std::string>(seedLength);
+        for (unsigned editDistance = 0; 3 != editDistance; ++editDistance)
+        {
+            const std::string d = boost::lexical_cast<std::string>(editDistance);
+            std::vector<boost::filesystem::path> maskParts;
+            for (unsigned mask = 0; (1U << MASK_WIDTH) != mask; ++mask)
+            {
+                maskParts.push_back(tempFile(
+                    "neighbors-" + d + "-" + s + "-" + boost::lexical_cast<std::string>(mask) + ".gz"));
+                workflow::NeighborsFinderWorkflow workflow(seedLength, sortedReferenceXml_, maskParts.back(), JOBS);
+                workflow.run(MASK_WIDTH, mask, editDistance);
+            }
+            mergeAnnotations(sortedReferenceXml_, maskParts, tempFile("neighbors-" + d + "-" + s + ".gz"),
+                             std::vector<std::string>(maskParts.size() - 1, "sum"), "neighbor-counts");
+        }
+
+        const std::vector<boost::filesystem::path> oneAndTwo =
+            {tempFile("neighbors-1-" + s + ".gz"), tempFile("neighbors-2-" + s + ".gz")};
+        mergeAnnotations(sortedReferenceXml_, oneAndTwo, tempFile("neighbors-1+2-" + s + ".gz"),
+                         {"zero-and-leq100"}, "neighbor-counts");
+        mergeAnnotations(sortedReferenceXml_, oneAndTwo, tempFile("neighbors-1+2-" + s + "-rep.gz"),
+                         {"zero-and-zero"}, "neighbor-counts");
+        mergeAnnotations(sortedReferenceXml_,
+                         {tempFile("neighbors-0-" + s + ".gz"), tempFile("neighbors-1+2-" + s + ".gz")},
+                         tempFile("neighbors-0+1+2-" + s + ".gz"), {"zero-and-leq100"}, "neighbor-counts");
+
+        uniquenessParts.push_back(tempFile("neighbors-0+1+2-" + s + ".gz"));
+        repeatnessParts.push_back(tempFile("neighbors-1+2-" + s + "-rep.gz"));
+        masks.push_back("mask-" + s);
+    }
+
+    mergeAnnotations(sortedReferenceXml_, uniquenessParts, uniquenessFile, masks, "kul");
+    mergeAnnotations(sortedReferenceXml_, repeatnessParts, repeatnessFile, masks, "kul");
+}
+
+static std::vector<reference::DistanceToBeNeighborless> loadAnnotation(const boost::filesystem::path &path)
+{
+    boost::iostreams::filtering_istream is;
+    is.push(boost::iostreams::gzip_decompressor());
+    is.push(boost::iostreams::file_source(path.string()));
+    std::vector<reference::DistanceToBeNeighborless> ret;
+    reference::DistanceToBeNeighborless value = 0;
+    while (is.read(reinterpret_cast<char*>(&value), sizeof(value)))
+    {
+        ret.push_back(value);
+    }
+    return ret;
+}
+
+void TestFindAllNeighbors::testSameAsMergeChain()
+{
+    mergeChain(tempFile("chain-uniqueness.gz"), tempFile("chain-repeatness.gz"));
+
+    workflow::FindAllNeighborsWorkflow workflow(
+        SEED_LENGTHS, sortedReferenceXml_, tempFile("all-uniqueness.gz"), tempFile("all-repeatness.gz"), JOBS, 0);
+    workflow.run(MASK_WIDTH);
+
+    const std::vector<reference::DistanceToBeNeighborless> expectedUniqueness = loadAnnotation(tempFile("chain-uniqueness.gz"));
+    const std::vector<reference::DistanceToBeNeighborless> expectedRepeatness = loadAnnotation(tempFile("chain-repeatness.gz"));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1200 + 900), expectedUniqueness.size());
+    CPPUNIT_ASSERT(expectedUniqueness == loadAnnotation(tempFile("all-uniqueness.gz")));
+    CPPUNIT_ASSERT(expectedRepeatness == loadAnnotation(tempFile("all-repeatness.gz")));
+
+    // the copies in chr2 must leave positions unique only at 20 and longer than any seed length, or the
+    // comparison above says little
+    const std::set<reference::DistanceToBeNeighborless> uniquenessValues(expectedUniqueness.begin(), expectedUniqueness.end());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), uniquenessValues.count(16));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), uniquenessValues.count(20));
+    CPPUNIT_ASSERT(SEED_LENGTHS.back() < *uniquenessValues.rbegin());
+}
+
+/**
+ * \brief Counts the neighbors of the k-mers that match partitionMask of partitionMaskWidth bits of the permuted k-mer
+ */
+template <typename KmerT>
+static void countNeighbors(
+    const unsigned partitionMaskWidth,
+    const unsigned partitionMask,
+    const unsigned neighborhoodWidth,
+    const reference::ContigList &contigList,
+    const reference::SortedReferenceMetadata &sortedReferenceMetadata,
+    common::ThreadVector &threads,
+    std::vector<reference::NeighborsCount> &annotation)
+{
+    typedef reference::neighborsFinder::NeighborCounter<KmerT> NeighborCounterT;
+    NeighborCounterT neighborCounter(
+        partitionMaskWidth, partitionMask, neighborhoodWidth, contigList, sortedReferenceMetadata, annotation);
+    reference::NeighborsFinder<KmerT, NeighborCounterT> neighborsFinder(
+        neighborCounter, partitionMaskWidth, neighborhoodWidth, threads);
+    neighborsFinder.template annotate<KmerT>();
+}
+
+void TestFindAllNeighbors::testPartitions()
+{
+    typedef oligo::BasicKmerType<16> KmerT;
+    static const unsigned PARTITION_BITS = 3;
+
+    const reference::SortedReferenceMetadata sortedReferenceMetadata = reference::loadSortedReferenceXml(sortedReferenceXml_);
+    common::ThreadVector threads(JOBS);
+    const reference::ContigList contigList = reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    const std::size_t genomeLength = reference::genomeLength(sortedReferenceMetadata.getContigs());
+
+    for (unsigned neighborhoodWidth = 0; 3 != neighborhoodWidth; ++neighborhoodWidth)
+    {
+        std::vector<reference::NeighborsCount> expected(genomeLength, 0);
+        std::vector<reference::NeighborsCount> partitioned(genomeLength, 0);
+        for (unsigned mask = 0; (1U << MASK_WIDTH) != mask; ++mask)
+        {
+            countNeighbors<KmerT>(MASK_WIDTH, mask, neighborhoodWidth, contigList, sortedReferenceMetadata, threads, expected);
+            for (unsigned partition = 0; (1U << PARTITION_BITS) != partition; ++partition)
+            {
+                countNeighbors<KmerT>(MASK_WIDTH + PARTITION_BITS, (mask << PARTITION_BITS) | partition, neighborhoodWidth,
+                                      contigList, sortedReferenceMetadata, threads, partitioned);
+            }
+        }
+        CPPUNIT_ASSERT(expected == partitioned);
+        // the near copies in chr2 must be seen or the comparison says little
+        CPPUNIT_ASSERT(expected.end() != std::find_if(
+            expected.begin(), expected.end(), [](const reference::NeighborsCount c){return 0 != c;}));
+    }
+}
+
+void TestFindAllNeighbors::testMemoryLimitTooLow()
+{
+    workflow::FindAllNeighborsWorkflow workflow(
+        SEED_LENGTHS, sortedReferenceXml_, tempFile("all-uniqueness.gz"), tempFile("all-repeatness.gz"), JOBS, 1);
+    CPPUNIT_ASSERT_THROW(workflow.run(MASK_WIDTH), common::MemoryException);
+}
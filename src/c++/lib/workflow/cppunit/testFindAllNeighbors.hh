@@ -0,0 +1,49 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_WORKFLOW_TEST_FIND_ALL_NEIGHBORS_HH
+#define iSAAC_WORKFLOW_TEST_FIND_ALL_NEIGHBORS_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+class TestFindAllNeighbors : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFindAllNeighbors );
+    CPPUNIT_TEST( testSameAsMergeChain );
+    CPPUNIT_TEST( testPartitions );
+    CPPUNIT_TEST( testMemoryLimitTooLow );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    // reference with the mask files of all seed lengths
+    boost::filesystem::path sortedReferenceXml_;
+
+    boost::filesystem::path tempFile(const std::string &name) const {return tempDirectory_ / name;}
+    void mergeChain(const boost::filesystem::path &uniquenessFile, const boost::filesystem::path &repeatnessFile) const;
+
+public:
+    TestFindAllNeighbors();
+    void setUp();
+    void tearDown();
+
+    void testSameAsMergeChain();
+    void testPartitions();
+    void testMemoryLimitTooLow();
+};
+
+#endif // #ifndef iSAAC_WORKFLOW_TEST_FIND_ALL_NEIGHBORS_HH
@@ -0,0 +1,312 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testPairedEndClusterExtractor.cpp
+ **
+ ** Test cases for pairing of bam records that don't meet in memory.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "workflow/alignWorkflow/bamDataSource/PairedEndClusterExtractor.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testPairedEndClusterExtractor.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestPairedEndClusterExtractor, registryName("TestPairedEndClusterExtractor"));
+
+static const unsigned TEMPLATES = 3000;
+// templates that have both reads in the first buffer
+static const unsigned PAIRED_IN_MEMORY = 100;
+static const unsigned READ_LENGTH = 32;
+static const unsigned NAME_LENGTH_MAX = 16;
+static const unsigned CLUSTER_LENGTH = READ_LENGTH * 2 + NAME_LENGTH_MAX;
+// about 4.4 kilobytes of unpaired records go to each of the 64 top level partitions
+static const std::size_t SMALL_MEMORY_LIMIT = 4096;
+static const std::size_t LARGE_MEMORY_LIMIT = 1024 * 1024;
+
+static const flowcell::ReadMetadataList readMetadataList =
+    {flowcell::ReadMetadata(1, READ_LENGTH, 0, 0), flowcell::ReadMetadata(READ_LENGTH + 1, READ_LENGTH * 2, 1, 1)};
+
+TestPairedEndClusterExtractor::TestPairedEndClusterExtractor()
+{
+}
+
+template <typename T>
+static void appendValue(std::vector<char> &buffer, const T value)
+{
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&value), reinterpret_cast<const char*>(&value) + sizeof(value));
+}
+
+static std::string makeReadName(const unsigned templateIndex)
+{
+    return (boost::format("read-%06d") % templateIndex).str();
+}
+
+/**
+ * \brief appends a bam record without the block_size
+ */
+static void appendRecord(
+    std::vector<char> &buffer, std::vector<std::size_t> &offsets, const unsigned templateIndex, const bool readOne)
+{
+    static const unsigned char BAM_BASES[] = {1, 2, 4, 8};
+    const std::string name = makeReadName(templateIndex);
+    offsets.push_back(buffer.size());
+    appendValue<int>(buffer, -1);
+    appendValue<int>(buffer, -1);
+    appendValue<unsigned>(buffer, name.size() + 1);
+    appendValue<unsigned>(buffer, bam::BamBlockHeader::MULTI_SEGMENT | bam::BamBlockHeader::UNMAPPED_SEGMENT |
+        bam::BamBlockHeader::NEXT_UNMAPPED_SEGMENT |
+        (readOne ? bam::BamBlockHeader::FIRST_SEGMENT : bam::BamBlockHeader::LAST_SEGMENT));
+    appendValue<int>(buffer, READ_LENGTH);
+    appendValue<int>(buffer, -1);
+    appendValue<int>(buffer, -1);
+    appendValue<int>(buffer, 0);
+    buffer.insert(buffer.end(), name.c_str(), name.c_str() + name.size() + 1);
+    for (unsigned i = 0; READ_LENGTH > i; i += 2)
+    {
+        buffer.push_back((BAM_BASES[(templateIndex + i + readOne) % 4] << 4) | BAM_BASES[(templateIndex + i + 1) % 4]);
+    }
+    for (unsigned i = 0; READ_LENGTH > i; ++i)
+    {
+        buffer.push_back(2 + (templateIndex + i * (readOne + 1)) % 40);
+    }
+    buffer.resize((buffer.size() + sizeof(int) - 1) / sizeof(int) * sizeof(int), 0);
+}
+
+static const bam::BamBlockHeader &getBlock(const std::vector<char> &buffer, const std::size_t offset)
+{
+    return *reinterpret_cast<const bam::BamBlockHeader*>(&buffer.at(offset));
+}
+
+void TestPairedEndClusterExtractor::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("isaac-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDirectory_);
+
+    firstBuffer_.clear();
+    secondBuffer_.clear();
+    firstOffsets_.clear();
+    secondOffsets_.clear();
+    for (unsigned templateIndex = 0; TEMPLATES != templateIndex; ++templateIndex)
+    {
+        appendRecord(firstBuffer_, firstOffsets_, templateIndex, true);
+    }
+    for (unsigned templateIndex = 0; PAIRED_IN_MEMORY != templateIndex; ++templateIndex)
+    {
+        appendRecord(firstBuffer_, firstOffsets_, templateIndex, false);
+    }
+    for (unsigned templateIndex = PAIRED_IN_MEMORY; TEMPLATES != templateIndex; ++templateIndex)
+    {
+        appendRecord(secondBuffer_, secondOffsets_, templateIndex, false);
+    }
+}
+
+void TestPairedEndClusterExtractor::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+static void appendBuffer(
+    workflow::alignWorkflow::bamDataSource::PairedEndClusterExtractor &extractor,
+    const std::vector<char> &buffer,
+    const std::vector<std::size_t> &offsets,
+    unsigned &clusterCount,
+    std::vector<char>::iterator &clusterIt,
+    std::vector<bool>::iterator &pfIt)
+{
+    for (std::vector<std::size_t>::const_iterator it = offsets.begin(); offsets.end() != it; ++it)
+    {
+        extractor.append(getBlock(buffer, *it), offsets.end() == it + 1, NAME_LENGTH_MAX,
+                         clusterCount, readMetadataList, clusterIt, pfIt);
+    }
+    // the buffer is about to be reused, the mates that did not meet go to the temporary files
+    extractor.removeOld(&buffer.front(), &buffer.front() + buffer.size(), readMetadataList);
+}
+
+void TestPairedEndClusterExtractor::extract(
+    const std::string &flowcellId,
+    const std::size_t memoryLimit,
+    std::vector<char> &clusters,
+    std::vector<bool> &pf)
+{
+    clusters.resize(TEMPLATES * CLUSTER_LENGTH);
+    pf.resize(TEMPLATES);
+    // keep the temporary files for inspection
+    workflow::alignWorkflow::bamDataSource::PairedEndClusterExtractor extractor(
+        tempDirectory_, memoryLimit * 64, flowcellId.size(), READ_LENGTH * 2, false, TEMPLATES * 2, memoryLimit);
+    extractor.open(flowcellId);
+
+    std::vector<char>::iterator clusterIt = clusters.begin();
+    std::vector<bool>::iterator pfIt = pf.begin();
+    unsigned clusterCount = TEMPLATES;
+    appendBuffer(extractor, firstBuffer_, firstOffsets_, clusterCount, clusterIt, pfIt);
+    CPPUNIT_ASSERT_EQUAL(TEMPLATES - PAIRED_IN_MEMORY, clusterCount);
+    appendBuffer(extractor, secondBuffer_, secondOffsets_, clusterCount, clusterIt, pfIt);
+    CPPUNIT_ASSERT_EQUAL(TEMPLATES - PAIRED_IN_MEMORY, clusterCount);
+
+    extractor.startExtractingUnpaired();
+    CPPUNIT_ASSERT_EQUAL(0U, extractor.extractUnpaired(READ_LENGTH, READ_LENGTH, NAME_LENGTH_MAX, clusterCount, clusterIt, pfIt));
+    CPPUNIT_ASSERT(clusters.end() == clusterIt);
+    CPPUNIT_ASSERT(pf.end() == pfIt);
+    // nothing is left
+    CPPUNIT_ASSERT_EQUAL(1U, extractor.extractUnpaired(READ_LENGTH, READ_LENGTH, NAME_LENGTH_MAX, 1, clusterIt, pfIt));
+}
+
+static std::string getClusterName(const std::vector<char> &clusters, const unsigned cluster)
+{
+    return std::string(&clusters.at(cluster * CLUSTER_LENGTH + READ_LENGTH * 2));
+}
+
+typedef std::vector<unsigned> PartitionPath;
+
+/**
+ * \brief finds the deepest temporary file each read name was stored in. Sub-partition files are named after the
+ *        partition file they were split from with -<sub-partition> appended.
+ */
+static std::map<std::string, PartitionPath> getReadPartitions(
+    const boost::filesystem::path &tempDirectory,
+    const std::string &flowcellId)
+{
+    const std::string prefix = flowcellId + "-unpaired-";
+    std::map<std::string, PartitionPath> ret;
+    for (boost::filesystem::directory_iterator it(tempDirectory); boost::filesystem::directory_iterator() != it; ++it)
+    {
+        const std::string fileName = it->path().filename().string();
+        if (!boost::starts_with(fileName, prefix) || !boost::ends_with(fileName, ".tmp"))
+        {
+            continue;
+        }
+        std::vector<std::string> parts;
+        const std::string partitionPath = fileName.substr(prefix.size(), fileName.size() - prefix.size() - std::strlen(".tmp"));
+        boost::split(parts, partitionPath, boost::is_any_of("-"));
+        PartitionPath path;
+        BOOST_FOREACH(const std::string &part, parts)
+        {
+            path.push_back(boost::lexical_cast<unsigned>(part));
+        }
+
+        // records are [recordLength][flags][zero-terminated name][bcl]
+        std::ifstream is(it->path().c_str(), std::ios_base::in | std::ios_base::binary);
+        unsigned recordLength = 0;
+        std::vector<char> record;
+        while (is.read(reinterpret_cast<char*>(&recordLength), sizeof(recordLength)))
+        {
+            record.resize(recordLength - sizeof(recordLength));
+            CPPUNIT_ASSERT(is.read(&record.front(), record.size()));
+            PartitionPath &readPath = ret[std::string(&record.front() + 1)];
+            if (readPath.size() < path.size())
+            {
+                readPath = path;
+            }
+        }
+        CPPUNIT_ASSERT(is.eof());
+    }
+    return ret;
+}
+
+/**
+ * \brief checks that each template is extracted exactly once with both reads in place. Pairs that met in memory come
+ *        first, the rest follow in the order of partitions and sub-partitions, sorted by name within each.
+ *
+ * \return number of read names that went into sub-partitions
+ */
+static unsigned checkClusters(
+    const std::vector<char> &clusters,
+    const std::vector<bool> &pf,
+    const std::map<std::string, std::vector<char> > &expectedClusters,
+    const std::map<std::string, PartitionPath> &readPartitions)
+{
+    std::set<std::string> seen;
+    unsigned ret = 0;
+    std::pair<PartitionPath, std::string> last;
+    for (unsigned cluster = 0; TEMPLATES != cluster; ++cluster)
+    {
+        const std::string name = getClusterName(clusters, cluster);
+        CPPUNIT_ASSERT_MESSAGE(name, seen.insert(name).second);
+        CPPUNIT_ASSERT(expectedClusters.end() != expectedClusters.find(name));
+        const std::vector<char> &expected = expectedClusters.find(name)->second;
+        CPPUNIT_ASSERT_MESSAGE(name, std::equal(expected.begin(), expected.end(), clusters.begin() + cluster * CLUSTER_LENGTH));
+        CPPUNIT_ASSERT(pf.at(cluster));
+
+        const std::map<std::string, PartitionPath>::const_iterator partition = readPartitions.find(name);
+        if (PAIRED_IN_MEMORY > cluster)
+        {
+            CPPUNIT_ASSERT_MESSAGE(name, readPartitions.end() == partition);
+            continue;
+        }
+        CPPUNIT_ASSERT_MESSAGE(name, readPartitions.end() != partition);
+        const std::pair<PartitionPath, std::string> current(partition->second, name);
+        CPPUNIT_ASSERT_MESSAGE(name, PAIRED_IN_MEMORY == cluster || last < current);
+        last = current;
+        ret += 1 < partition->second.size();
+    }
+    CPPUNIT_ASSERT_EQUAL(std::size_t(TEMPLATES), seen.size());
+    return ret;
+}
+
+static std::vector<std::vector<char> > getSortedClusters(const std::vector<char> &clusters)
+{
+    std::vector<std::vector<char> > ret;
+    for (std::vector<char>::const_iterator it = clusters.begin(); clusters.end() != it; it += CLUSTER_LENGTH)
+    {
+        ret.push_back(std::vector<char>(it, it + CLUSTER_LENGTH));
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+void TestPairedEndClusterExtractor::testSplitPartitions()
+{
+    std::map<std::string, std::vector<char> > expectedClusters;
+    for (unsigned templateIndex = 0; TEMPLATES != templateIndex; ++templateIndex)
+    {
+        std::vector<char> &cluster = expectedClusters[makeReadName(templateIndex)];
+        cluster.resize(CLUSTER_LENGTH);
+        const bam::BamBlockHeader &r1 = getBlock(firstBuffer_, firstOffsets_.at(templateIndex));
+        const bam::BamBlockHeader &r2 = PAIRED_IN_MEMORY > templateIndex ?
+            getBlock(firstBuffer_, firstOffsets_.at(TEMPLATES + templateIndex)) :
+            getBlock(secondBuffer_, secondOffsets_.at(templateIndex - PAIRED_IN_MEMORY));
+        std::vector<char>::iterator it = bam::extractBcl(r1, cluster.begin(), readMetadataList.at(0));
+        it = bam::extractBcl(r2, it, readMetadataList.at(1));
+        bam::extractReadName(r1, NAME_LENGTH_MAX, it);
+    }
+
+    std::vector<char> largeLimitClusters;
+    std::vector<bool> largeLimitPf;
+    extract("large", LARGE_MEMORY_LIMIT, largeLimitClusters, largeLimitPf);
+    CPPUNIT_ASSERT_EQUAL(0U, checkClusters(
+        largeLimitClusters, largeLimitPf, expectedClusters, getReadPartitions(tempDirectory_, "large")));
+
+    std::vector<char> smallLimitClusters;
+    std::vector<bool> smallLimitPf;
+    extract("small", SMALL_MEMORY_LIMIT, smallLimitClusters, smallLimitPf);
+    // some of the partitions must have been split
+    CPPUNIT_ASSERT(checkClusters(
+        smallLimitClusters, smallLimitPf, expectedClusters, getReadPartitions(tempDirectory_, "small")));
+
+    CPPUNIT_ASSERT(getSortedClusters(largeLimitClusters) == getSortedClusters(smallLimitClusters));
+}
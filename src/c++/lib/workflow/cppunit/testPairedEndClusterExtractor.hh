@@ -0,0 +1,54 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_WORKFLOW_TEST_PAIRED_END_CLUSTER_EXTRACTOR_HH
+#define iSAAC_WORKFLOW_TEST_PAIRED_END_CLUSTER_EXTRACTOR_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+class TestPairedEndClusterExtractor : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestPairedEndClusterExtractor );
+    CPPUNIT_TEST( testSplitPartitions );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    // bam records without block_size, r1 of all templates followed by r2 of the first few
+    std::vector<char> firstBuffer_;
+    // r2 of the remaining templates
+    std::vector<char> secondBuffer_;
+    // record offsets in the order of the buffers
+    std::vector<std::size_t> firstOffsets_;
+    std::vector<std::size_t> secondOffsets_;
+
+    void extract(
+        const std::string &flowcellId,
+        const std::size_t memoryLimit,
+        std::vector<char> &clusters,
+        std::vector<bool> &pf);
+
+public:
+    TestPairedEndClusterExtractor();
+    void setUp();
+    void tearDown();
+
+    void testSplitPartitions();
+};
+
+#endif // #ifndef iSAAC_WORKFLOW_TEST_PAIRED_END_CLUSTER_EXTRACTOR_HH
+
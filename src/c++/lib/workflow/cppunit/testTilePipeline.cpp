@@ -0,0 +1,135 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file testTilePipeline.cpp
+ **
+ ** Test cases for the tile load-ahead.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "common/Exceptions.hh"
+#include "common/Threads.hpp"
+#include "workflow/alignWorkflow/TilePipeline.hh"
+
+using namespace isaac;
+
+
+#include "RegistryName.hh"
+#include "testTilePipeline.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestTilePipeline, registryName("TestTilePipeline"));
+
+static const unsigned TILES = 40;
+static const unsigned TILE_CLUSTERS = 100;
+static const unsigned NO_FAILURE = TILES;
+
+TestTilePipeline::TestTilePipeline()
+{
+}
+
+void TestTilePipeline::setUp()
+{
+}
+
+void TestTilePipeline::tearDown()
+{
+}
+
+/**
+ * \brief Runs the fake stages through the pipeline. Selection depends on the tiles selected before, the way
+ *        template length statistics carry over between tiles, so any change in the order shows in the output.
+ *
+ * \param failTile  load of this tile throws
+ */
+std::vector<unsigned> TestTilePipeline::process(
+    const unsigned buffers, const unsigned threads, const unsigned failTile) const
+{
+    typedef std::vector<unsigned> TileData;
+    workflow::alignWorkflow::BasicTileBuffers<TileData> tileBuffers(buffers, TileData());
+    workflow::alignWorkflow::TilePipeline tilePipeline(TILES);
+
+    unsigned carry = 0;
+    std::vector<unsigned> selected;
+    std::vector<unsigned> flushBuffer;
+    std::vector<unsigned> output;
+
+    common::ThreadVector threadVector(threads);
+    threadVector.execute(
+        [&](const unsigned threadNumber, const unsigned threadsTotal)
+        {
+            tilePipeline.run(
+                tileBuffers,
+                [&](const unsigned tile, TileData &tileData)
+                {
+                    if (failTile == tile)
+                    {
+                        BOOST_THROW_EXCEPTION(common::IoException(EIO, "Failed to load tile"));
+                    }
+                    tileData.clear();
+                    for (unsigned cluster = 0; TILE_CLUSTERS != cluster; ++cluster)
+                    {
+                        tileData.push_back(tile * TILE_CLUSTERS + cluster);
+                    }
+                    // give the other threads a chance to get ahead
+                    boost::this_thread::yield();
+                },
+                [&](const unsigned tile, TileData &tileData)
+                {
+                    for (const unsigned cluster : tileData)
+                    {
+                        carry = carry * 31 + cluster;
+                        selected.push_back(carry);
+                    }
+                },
+                [&](){flushBuffer.swap(selected); selected.clear();},
+                [&]()
+                {
+                    output.insert(output.end(), flushBuffer.begin(), flushBuffer.end());
+                    flushBuffer.clear();
+                });
+        });
+
+    return output;
+}
+
+void TestTilePipeline::testLoadAhead()
+{
+    // one buffer and one thread don't overlap anything
+    const std::vector<unsigned> expected = process(1, 1, NO_FAILURE);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(TILES * TILE_CLUSTERS), expected.size());
+
+    for (unsigned buffers = 1; 4 >= buffers; ++buffers)
+    {
+        for (unsigned threads = 1; 4 >= threads; ++threads)
+        {
+            for (unsigned repeat = 0; 10 != repeat; ++repeat)
+            {
+                CPPUNIT_ASSERT(expected == process(buffers, threads, NO_FAILURE));
+            }
+        }
+    }
+}
+
+void TestTilePipeline::testFailure()
+{
+    for (unsigned threads = 1; 4 >= threads; ++threads)
+    {
+        // other threads terminate without waiting for the tiles that will never load. Depending on timing, their
+        // ThreadingException can be the first one ThreadVector gets to rethrow.
+        CPPUNIT_ASSERT_THROW(process(4, threads, TILES / 2), common::ExceptionData);
+    }
+}
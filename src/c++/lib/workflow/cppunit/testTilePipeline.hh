@@ -0,0 +1,39 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_WORKFLOW_TEST_TILE_PIPELINE_HH
+#define iSAAC_WORKFLOW_TEST_TILE_PIPELINE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+class TestTilePipeline : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestTilePipeline );
+    CPPUNIT_TEST( testLoadAhead );
+    CPPUNIT_TEST( testFailure );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    std::vector<unsigned> process(const unsigned buffers, const unsigned threads, const unsigned failTile) const;
+
+public:
+    TestTilePipeline();
+    void setUp();
+    void tearDown();
+
+    void testLoadAhead();
+    void testFailure();
+};
+
+#endif // #ifndef iSAAC_WORKFLOW_TEST_TILE_PIPELINE_HH
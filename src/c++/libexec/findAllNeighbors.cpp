@@ -0,0 +1,40 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file findAllNeighbors.cpp
+ **
+ ** \brief Computes k-uniqueness and k-repeatness annotations for all seed lengths and masks in one process
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "options/FindAllNeighborsOptions.hh"
+#include "workflow/FindAllNeighborsWorkflow.hh"
+
+
+void findAllNeighbors(const isaac::options::FindAllNeighborsOptions &options)
+{
+    isaac::workflow::FindAllNeighborsWorkflow workflow(
+        options.seedLengths,
+        options.referenceGenome,
+        options.uniquenessFile,
+        options.repeatnessFile,
+        options.jobs,
+        options.memoryLimit * 1024 * 1024 * 1024);
+    workflow.run(options.maskWidth);
+}
+
+int main(int argc, char *argv[])
+{
+    isaac::common::configureMemoryManagement(true, true);
+    isaac::common::run(findAllNeighbors, argc, argv);
+}
@@ -30,7 +30,8 @@ void sortReferenceT(const isaac::options::SortReferenceOptions &options)
         options.contigsXml,
         options.genomeNeighborsFile,
         options.outFile,
-        options.repeatThreshold);
+        options.repeatThreshold,
+        options.memoryLimit * 1024 * 1024 * 1024);
     referenceSorter.run();
 }
 
@@ -0,0 +1,40 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2014 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file storeContigImage.cpp
+ **
+ ** \brief Stores the translated contigs of a reference in the binary form loaded by isaac-align.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "options/StoreContigImageOptions.hh"
+#include "reference/ContigImage.hh"
+#include "reference/ContigLoader.hh"
+#include "reference/SortedReferenceXml.hh"
+
+void storeContigImage(const isaac::options::StoreContigImageOptions &options);
+
+int main(int argc, char *argv[])
+{
+    isaac::common::run(storeContigImage, argc, argv);
+}
+
+void storeContigImage(const isaac::options::StoreContigImageOptions &options)
+{
+    const isaac::reference::SortedReferenceMetadata sortedReferenceMetadata =
+        isaac::reference::loadSortedReferenceXml(options.referenceGenome);
+    isaac::common::ThreadVector threads(options.jobs);
+    const isaac::reference::ContigList contigs =
+        isaac::reference::loadContigs(sortedReferenceMetadata.getContigs(), threads);
+    isaac::reference::storeContigImage(sortedReferenceMetadata, contigs, options.outputFile);
+}
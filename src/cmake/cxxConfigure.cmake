@@ -101,6 +101,16 @@ else  (HAVE_ZLIB)
     message(FATAL_ERROR "No support for gzip compression")
 endif (HAVE_ZLIB)
 
+# optional faster deflate implementation for bam compression
+isaac_find_library(LIBDEFLATE libdeflate.h deflate)
+if    (HAVE_LIBDEFLATE)
+    include_directories(BEFORE SYSTEM ${LIBDEFLATE_INCLUDE_DIR})
+    set  (iSAAC_ADDITIONAL_LIB ${iSAAC_ADDITIONAL_LIB} "${LIBDEFLATE_LIBRARY}")
+    message(STATUS "libdeflate bam compression supported")
+else  (HAVE_LIBDEFLATE)
+    message(STATUS "No support for libdeflate bam compression")
+endif (HAVE_LIBDEFLATE)
+
 isaac_find_library(RT time.h rt)
 if    (HAVE_RT)
     set  (iSAAC_ADDITIONAL_LIB ${iSAAC_ADDITIONAL_LIB} rt)
@@ -107,12 +107,14 @@ TEMP_DIR:=Temp
 
 BPB_TO_WIG:=$(LIBEXEC_DIR)/bpbToWig
 EXTRACT_NEIGHBORS_FROM_ANNOTATION:=$(LIBEXEC_DIR)/extractNeighborsFromAnnotation
+FIND_ALL_NEIGHBORS:=$(LIBEXEC_DIR)/findAllNeighbors
 FIND_NEIGHBORS:=$(LIBEXEC_DIR)/findNeighbors
 MERGE_ANNOTATIONS:=$(LIBEXEC_DIR)/mergeAnnotations
 MERGE_REFERENCES:=$(LIBEXEC_DIR)/mergeReferences
 PRINT_CONTIGS:=$(LIBEXEC_DIR)/printContigs
 REORDER_REFERENCE:=$(BIN_DIR)/isaac-reorder-reference
 SORT_REFERENCE:=$(LIBEXEC_DIR)/sortReference
+STORE_CONTIG_IMAGE:=$(LIBEXEC_DIR)/storeContigImage
 GET_FORMAT_VERSION_XSL:=$(DATA_DIR)/xsl/reference/GetFormatVersion.xsl
 GET_ANY_FASTA_PATH_XSL:=$(DATA_DIR)/xsl/reference/GetAnyFastaPath.xsl
 GET_ANNOTATION_FILE_PATHS_XSL:=$(DATA_DIR)/xsl/reference/GetAnnotationFilePaths.xsl
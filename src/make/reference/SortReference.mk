@@ -70,7 +70,28 @@ $(ANNOTATION_XML) : $(ANNOTATION_FILE) $(ANNOTATION_REPEAT_FILE)
 	</SortedReference>\
 	" >$(SAFEPIPETARGET)
 
-$(SORTED_REFERENCE_XML): $(CONTIGS_XML) $(ANNOTATION_XML)
+# binary image of the translated contigs. Allows isaac-align to load the reference without parsing the fasta
+CONTIG_IMAGE?=no
+CONTIG_IMAGE_FILE:=contigs.dat
+CONTIG_IMAGE_XML:=$(TEMP_DIR)/contig-image.xml
+
+$(CONTIG_IMAGE_FILE): $(CONTIGS_XML)
+	$(CMDPREFIX) $(STORE_CONTIG_IMAGE) -r $(CONTIGS_XML) -o $(SAFEPIPETARGET)
+
+$(CONTIG_IMAGE_XML) : $(CONTIG_IMAGE_FILE)
+	$(CMDPREFIX) echo "\
+	<SortedReference>\
+		<FormatVersion>$(CURRENT_REFERENCE_FORMAT_VERSION)</FormatVersion>\
+		<Annotations>\
+			<Annotation Type='contig-image' K='0'>\
+				<Format>8bpb</Format>\
+				<File>$(CURDIR)/$(CONTIG_IMAGE_FILE)</File>\
+			</Annotation>\
+		</Annotations>\
+	</SortedReference>\
+	" >$(SAFEPIPETARGET)
+
+$(SORTED_REFERENCE_XML): $(CONTIGS_XML) $(ANNOTATION_XML) $(if $(filter yes,$(CONTIG_IMAGE)),$(CONTIG_IMAGE_XML))
 	$(CMDPREFIX) $(MERGE_REFERENCES) $(foreach part, $^, -i '$(part)') -o $(SAFEPIPETARGET)
 
 all: $(SORTED_REFERENCE_XML)